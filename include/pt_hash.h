@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_HASH_H
+#define PT_HASH_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Hash table helpers.
+ *
+ * Hash tables hash their keys with pt_hash_u64() and pt_hash_str().  They
+ * have a power of two number of slots and use the top bits of a key's hash
+ * for indexing.  They double in size before adding an entry would exceed a
+ * load factor of 3/4.
+ *
+ * Tables that chain their entries may use struct pt_hash_table.  Tables
+ * using open addressing manage their slots themselves.
+ */
+
+enum {
+	/* The initial size of a chained hash table as a power of two. */
+	pt_hash_min_bits	= 6,
+
+	/* The maximal size of a hash table as a power of two. */
+	pt_hash_max_bits	= 31
+};
+
+/* Mix all bits of @hash. */
+static inline uint64_t pt_hash_mix(uint64_t hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+
+	return hash;
+}
+
+/* Add @value to @hash. */
+static inline uint64_t pt_hash_u64(uint64_t hash, uint64_t value)
+{
+	return pt_hash_mix(hash ^ (value + 0x9e3779b97f4a7c15ull));
+}
+
+/* Add the zero-terminated string @str to @hash. */
+static inline uint64_t pt_hash_str(uint64_t hash, const char *str)
+{
+	/* FNV-1a. */
+	hash ^= 0xcbf29ce484222325ull;
+	for (; *str; ++str) {
+		hash ^= (uint8_t) *str;
+		hash *= 0x100000001b3ull;
+	}
+
+	return pt_hash_mix(hash);
+}
+
+/* Compute the slot for @hash in a table of 2^@bits slots.
+ *
+ * The @bits argument must be between one and pt_hash_max_bits.
+ */
+static inline size_t pt_hash_index(uint64_t hash, uint8_t bits)
+{
+	return (size_t) (hash >> (64 - bits));
+}
+
+/* Check whether a table of 2^@bits slots holding @nentries entries needs to
+ * grow before adding another entry.
+ */
+static inline int pt_hash_full(uint64_t nentries, uint8_t bits)
+{
+	return (3ull << bits) <= ((nentries + 1ull) * 4ull);
+}
+
+
+/* A node in a chained hash table.
+ *
+ * Embed this into the table's entries.
+ */
+struct pt_hash_node {
+	/* The next node in the same bucket. */
+	struct pt_hash_node *next;
+
+	/* The hash of this node's key. */
+	uint64_t hash;
+};
+
+/* A chained hash table. */
+struct pt_hash_table {
+	/* The buckets - nodes are chained via their @next field. */
+	struct pt_hash_node **buckets;
+
+	/* The number of nodes in the table. */
+	uint64_t nnodes;
+
+	/* The number of buckets as a power of two or zero if there are no
+	 * buckets, yet.
+	 */
+	uint8_t bits;
+};
+
+static inline void pt_hash_table_init(struct pt_hash_table *table)
+{
+	memset(table, 0, sizeof(*table));
+}
+
+/* Free @table's buckets and all nodes using @release. */
+static inline void pt_hash_table_fini(struct pt_hash_table *table,
+				      void (*release)(struct pt_hash_node *))
+{
+	size_t bucket, nbuckets;
+
+	if (!table)
+		return;
+
+	nbuckets = table->bits ? ((size_t) 1 << table->bits) : 0;
+	for (bucket = 0; bucket < nbuckets; ++bucket) {
+		struct pt_hash_node *node;
+
+		node = table->buckets[bucket];
+		while (node) {
+			struct pt_hash_node *trash;
+
+			trash = node;
+			node = trash->next;
+
+			if (release)
+				release(trash);
+		}
+	}
+
+	free(table->buckets);
+	memset(table, 0, sizeof(*table));
+}
+
+/* Resize @table to 2^@bits buckets.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static inline int pt_hash_table_rehash(struct pt_hash_table *table,
+				       uint8_t bits)
+{
+	struct pt_hash_node **buckets;
+	size_t bucket, nbuckets;
+
+	if (!table || !bits || (pt_hash_max_bits < bits))
+		return -pte_internal;
+
+	buckets = calloc((size_t) 1 << bits, sizeof(*buckets));
+	if (!buckets)
+		return -pte_nomem;
+
+	nbuckets = table->bits ? ((size_t) 1 << table->bits) : 0;
+	for (bucket = 0; bucket < nbuckets; ++bucket) {
+		struct pt_hash_node *node;
+
+		node = table->buckets[bucket];
+		while (node) {
+			struct pt_hash_node *next;
+			size_t idx;
+
+			next = node->next;
+
+			idx = pt_hash_index(node->hash, bits);
+			node->next = buckets[idx];
+			buckets[idx] = node;
+
+			node = next;
+		}
+	}
+
+	free(table->buckets);
+	table->buckets = buckets;
+	table->bits = bits;
+
+	return 0;
+}
+
+/* Add @node with its hash already set to @table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static inline int pt_hash_table_insert(struct pt_hash_table *table,
+				       struct pt_hash_node *node)
+{
+	size_t idx;
+
+	if (!table || !node)
+		return -pte_internal;
+
+	if (!table->bits) {
+		int errcode;
+
+		errcode = pt_hash_table_rehash(table, pt_hash_min_bits);
+		if (errcode < 0)
+			return errcode;
+	} else if (pt_hash_full(table->nnodes, table->bits) &&
+		   (table->bits < pt_hash_max_bits))
+		/* If we fail to grow the table, we continue with longer
+		 * chains.
+		 */
+		(void) pt_hash_table_rehash(table, table->bits + 1);
+
+	idx = pt_hash_index(node->hash, table->bits);
+	node->next = table->buckets[idx];
+	table->buckets[idx] = node;
+	table->nnodes += 1;
+
+	return 0;
+}
+
+/* Get the first node in @table's bucket for @hash.
+ *
+ * Nodes in that bucket are chained via their @next field.  Their hash may
+ * differ from @hash.
+ *
+ * Returns NULL if the bucket is empty.
+ */
+static inline struct pt_hash_node *
+pt_hash_table_first(const struct pt_hash_table *table, uint64_t hash)
+{
+	if (!table || !table->bits)
+		return NULL;
+
+	return table->buckets[pt_hash_index(hash, table->bits)];
+}
+
+/* Remove @node from @table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @node is not in @table.
+ */
+static inline int pt_hash_table_remove(struct pt_hash_table *table,
+				       struct pt_hash_node *node)
+{
+	struct pt_hash_node **pnext, *it;
+
+	if (!table || !node || !table->bits)
+		return -pte_internal;
+
+	pnext = &table->buckets[pt_hash_index(node->hash, table->bits)];
+	for (it = *pnext; it; pnext = &it->next, it = *pnext) {
+		if (it != node)
+			continue;
+
+		*pnext = node->next;
+		node->next = NULL;
+		table->nnodes -= 1;
+
+		return 0;
+	}
+
+	return -pte_internal;
+}
+
+#endif /* PT_HASH_H */
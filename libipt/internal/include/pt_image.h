@@ -35,6 +35,12 @@
 
 #include <stdint.h>
 
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif /* defined(FEATURE_THREADS) */
+
+struct pt_image_pool;
+
 
 /* A list of sections. */
 struct pt_section_list {
@@ -48,21 +54,92 @@ struct pt_section_list {
 	int isid;
 };
 
+/* A list of sections shared copy-on-write by one or more images.
+ *
+ * The list must not be modified while it is shared.
+ */
+struct pt_image_shared {
+	/* The shared list of sections. */
+	struct pt_section_list *sections;
+
+	/* The optional pool from which @sections and this object were
+	 * allocated.
+	 *
+	 * The shared list holds a reference to @pool so images from other
+	 * pools may share it.
+	 */
+	struct pt_image_pool *pool;
+
+	/* The number of images sharing @sections. */
+	uint32_t ucount;
+
+#if defined(FEATURE_THREADS)
+	/* A lock protecting @ucount.
+	 *
+	 * This is only used if @pool is NULL.  Otherwise, @ucount is
+	 * protected by @pool's lock so pooled lists don't need a lock of
+	 * their own.
+	 */
+	mtx_t lock;
+#endif /* defined(FEATURE_THREADS) */
+};
+
 /* A traced image consisting of a collection of sections. */
 struct pt_image {
 	/* The optional image name. */
 	char *name;
 
-	/* The list of sections. */
+	/* The list of sections.
+	 *
+	 * If @shared is not NULL, this is @shared->sections.
+	 */
 	struct pt_section_list *sections;
 
+	/* The optional shared section list.
+	 *
+	 * While the image shares its sections with other images, @sections is
+	 * not modified; the image creates its own copy of the list before it
+	 * adds or removes sections.
+	 */
+	struct pt_image_shared *shared;
+
+	/* The most recently found section in a shared section list.
+	 *
+	 * Sections in a shared list are not moved to the front when they are
+	 * found, so we remember the last one for validation and check it
+	 * first on the next lookup.
+	 */
+	struct pt_section_list *last;
+
+	/* An optional pool from which the image and its section list elements
+	 * are allocated.
+	 *
+	 * The image holds a reference to @pool.
+	 */
+	struct pt_image_pool *pool;
+
 	/* An optional read memory callback. */
 	struct {
 		/* The callback function. */
 		read_memory_callback_t *callback;
 
+		/* The memory window callback function.
+		 *
+		 * At most one of @callback and @window_callback is set.
+		 */
+		read_memory_window_callback_t *window_callback;
+
 		/* The callback context. */
 		void *context;
+
+		/* The most recent window provided by @window_callback.
+		 *
+		 * An empty window (size zero) is invalid.
+		 */
+		struct pt_memory_window window;
+
+		/* The address space of @window. */
+		struct pt_asid wasid;
 	} readmem;
 };
 
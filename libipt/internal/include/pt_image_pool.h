@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_IMAGE_POOL_H
+#define PT_IMAGE_POOL_H
+
+#include <stdint.h>
+
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif /* defined(FEATURE_THREADS) */
+
+
+/* The number of slots in a pool chunk. */
+enum {
+	pt_image_pool_chunk_slots	= 64
+};
+
+union pt_image_pool_slot;
+struct pt_image_pool_chunk;
+struct pt_section_list;
+
+/* A pool of fixed-size slots for image objects.
+ *
+ * The pool hands out slots large enough to hold a struct pt_image, a struct
+ * pt_section_list, or a struct pt_image_shared.  Slots are carved out of
+ * larger chunks and are recycled via a free list.  All chunks are freed in
+ * bulk when the pool is finalized.
+ *
+ * The pool is reference-counted.  The pool owner holds one reference and each
+ * image allocated from the pool holds another.  The pool is freed when the
+ * last reference is put.
+ */
+struct pt_image_pool {
+	/* The list of chunks. */
+	struct pt_image_pool_chunk *chunks;
+
+	/* The list of free slots. */
+	union pt_image_pool_slot *free;
+
+	/* The number of slots in use. */
+	uint64_t used;
+
+	/* The number of chunks. */
+	uint32_t nchunks;
+
+	/* A reference count. */
+	uint32_t ucount;
+
+#if defined(FEATURE_THREADS)
+	/* A lock protecting this pool. */
+	mtx_t lock;
+#endif /* defined(FEATURE_THREADS) */
+};
+
+/* Initialize a pool.
+ *
+ * The pool starts out with a reference count of one.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pool is NULL.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_image_pool_init(struct pt_image_pool *pool);
+
+/* Finalize a pool.
+ *
+ * This frees all chunks irrespective of their slots being in use.
+ */
+extern void pt_image_pool_fini(struct pt_image_pool *pool);
+
+/* Get a reference to a pool.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pool is NULL.
+ * Returns -pte_overflow if the reference count would overflow.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_image_pool_get(struct pt_image_pool *pool);
+
+/* Put a reference to a pool.
+ *
+ * If this was the last reference, @pool is finalized and freed.  The @pool
+ * must have been allocated with pt_image_pool_alloc() in that case.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pool is NULL or has no references.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_image_pool_put(struct pt_image_pool *pool);
+
+/* Lock a pool.
+ *
+ * Images use the lock of their pool also for protecting pooled objects that
+ * do not have a lock of their own.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pool is NULL.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_image_pool_lock(struct pt_image_pool *pool);
+
+/* Unlock a pool.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @pool is NULL.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_image_pool_unlock(struct pt_image_pool *pool);
+
+/* Allocate a slot from a pool.
+ *
+ * The slot is large enough to hold a struct pt_image, a struct
+ * pt_section_list, or a struct pt_image_shared.  Its content is undefined.
+ *
+ * Returns a pointer to the slot on success, NULL otherwise.
+ */
+extern void *pt_image_pool_alloc_slot(struct pt_image_pool *pool);
+
+/* Return a slot to a pool.
+ *
+ * The @slot must have been allocated from @pool.
+ */
+extern void pt_image_pool_free_slot(struct pt_image_pool *pool, void *slot);
+
+/* Return a section list to a pool.
+ *
+ * All elements of @list must have been allocated from @pool.  They are
+ * returned to @pool in one go.  The caller is responsible for releasing the
+ * sections the elements refer to.
+ */
+extern void pt_image_pool_free_list(struct pt_image_pool *pool,
+				    struct pt_section_list *list);
+
+#endif /* PT_IMAGE_POOL_H */
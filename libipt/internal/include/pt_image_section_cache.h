@@ -70,7 +70,8 @@ struct pt_iscache_lru_entry {
  * virtual address.
  *
  * Internally, the section object will be shared if it is loaded at different
- * addresses in the cache.
+ * addresses in the cache.  Optionally, it will also be shared if the same file
+ * is added via different file names.
  *
  * The cache does not consider the address-space the section is mapped into.
  * This is not relevant for reading from the section.
@@ -91,6 +92,11 @@ struct pt_image_section_cache {
 	/* The current size of our LRU cache. */
 	uint64_t used;
 
+	/* A non-zero value if sections backed by the same file are shared
+	 * even if they were added via different file names.
+	 */
+	uint32_t share;
+
 #if defined(FEATURE_THREADS)
 	/* A lock protecting this image section cache. */
 	mtx_t lock;
@@ -139,6 +139,14 @@ struct pt_section {
 	mtx_t alock;
 #endif /* defined(FEATURE_THREADS) */
 
+	/* A non-zero value if an image section cache shares this section
+	 * between different file names that are backed by the same file.
+	 *
+	 * The flag is set when the section is first shared that way and never
+	 * cleared.  It is protected by @lock.
+	 */
+	uint32_t aliased;
+
 	/* The number of current users.  The last user destroys the section. */
 	uint16_t ucount;
 
@@ -318,6 +326,41 @@ pt_section_bcache(const struct pt_section *section)
 extern int pt_section_mk_status(void **pstatus, uint64_t *psize,
 				const char *filename);
 
+/* Check whether two sections are backed by the same file.
+ *
+ * Files are identified by their OS-specific file status rather than by their
+ * name, so the same file may be accessed via different paths, e.g. via hard
+ * links or via different sysroots.
+ *
+ * This function is implemented in the OS-specific section implementation.
+ *
+ * Returns a positive integer if @lhs and @rhs are backed by the same file.
+ * Returns zero if they are not or if this cannot be determined.
+ * Returns -pte_internal if @lhs or @rhs is NULL.
+ */
+extern int pt_section_same_file(const struct pt_section *lhs,
+				const struct pt_section *rhs);
+
+/* Mark a section as shared between different file names.
+ *
+ * The image section cache calls this when it shares @section for a file name
+ * other than the one @section was created with.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_section_set_aliased(struct pt_section *section);
+
+/* Check whether a section is shared between different file names.
+ *
+ * Returns a positive integer if @section has been marked by
+ * pt_section_set_aliased(), zero if it has not.
+ * Returns -pte_internal if @section is NULL.
+ * Returns -pte_bad_lock on any locking error.
+ */
+extern int pt_section_aliased(struct pt_section *section);
+
 /* Perform on-map maintenance work.
  *
  * Notifies an attached image section cache about the mapping of @section.
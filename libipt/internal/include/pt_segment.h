@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SEGMENT_H
+#define PT_SEGMENT_H
+
+#include "pt_packet_decoder.h"
+
+#include "intel-pt.h"
+
+
+/* An Intel PT segment iterator. */
+struct pt_segment_iterator {
+	/* The packet decoder used for searching PSB packets. */
+	struct pt_packet_decoder decoder;
+
+	/* The end offset of the next segment to provide. */
+	uint64_t end;
+};
+
+
+/* Initialize the segment iterator.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_seg_iterator_init(struct pt_segment_iterator *,
+				const struct pt_config *);
+
+/* Finalize the segment iterator. */
+extern void pt_seg_iterator_fini(struct pt_segment_iterator *);
+
+#endif /* PT_SEGMENT_H */
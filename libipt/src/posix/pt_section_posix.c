@@ -70,6 +70,34 @@ int pt_section_mk_status(void **pstatus, uint64_t *psize, const char *filename)
 	return 0;
 }
 
+int pt_section_same_file(const struct pt_section *lhs,
+			 const struct pt_section *rhs)
+{
+	const struct pt_sec_posix_status *lstatus, *rstatus;
+
+	if (!lhs || !rhs)
+		return -pte_internal;
+
+	lstatus = lhs->status;
+	rstatus = rhs->status;
+	if (!lstatus || !rstatus)
+		return 0;
+
+	if (lstatus->stat.st_dev != rstatus->stat.st_dev)
+		return 0;
+
+	if (lstatus->stat.st_ino != rstatus->stat.st_ino)
+		return 0;
+
+	if (lstatus->stat.st_size != rstatus->stat.st_size)
+		return 0;
+
+	if (lstatus->stat.st_mtime != rstatus->stat.st_mtime)
+		return 0;
+
+	return 1;
+}
+
 static int check_file_status(struct pt_section *section, int fd)
 {
 	struct pt_sec_posix_status *status;
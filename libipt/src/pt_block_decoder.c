@@ -1695,6 +1695,29 @@ enum {
 	bcache_fill_steps	= 0x400
 };
 
+/* Check whether we may proceed after the near direct branch @insn.
+ *
+ * This is what we do at ptbq_decode block cache entries.  The cache filling
+ * flow uses it, as well, so the blocks we provide do not depend on whether the
+ * block cache has already been filled.
+ *
+ * Returns a positive integer if we may proceed, zero otherwise.
+ */
+static int pt_blk_may_proceed(const struct pt_block_decoder *decoder,
+			      const struct pt_insn *insn,
+			      const struct pt_mapped_section *msec)
+{
+	/* End the block if the user asked us to. */
+	if ((decoder->flags.variant.block.end_on_call &&
+	     (insn->iclass == ptic_call)) ||
+	    (decoder->flags.variant.block.end_on_jump &&
+	     (insn->iclass == ptic_jump)))
+		return 0;
+
+	/* We're done if we switch sections. */
+	return pt_blk_is_in_section(msec, decoder->ip);
+}
+
 /* Proceed to the next instruction and fill the block cache for @decoder->ip.
  *
  * Tracing is enabled and we don't have an event pending.  The current IP is not
@@ -1707,7 +1730,11 @@ enum {
  * that the recursion is bounded by @steps and ultimately by the maximum number
  * of instructions in a block.
  *
- * Returns zero on success, a negative error code otherwise.
+ * We stop at cache entries that require decoding the instruction.  If the
+ * cached flow would proceed beyond such an entry, so must our caller.
+ *
+ * Returns a positive integer if the caller may proceed further in @block, zero
+ * if @block is complete, a negative error code otherwise.
  */
 static int
 pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
@@ -1721,7 +1748,7 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 	struct pt_insn insn;
 	uint64_t nip, dip, ioff, noff;
 	int64_t disp;
-	int status;
+	int status, proceed;
 
 	if (!decoder || !steps)
 		return -pte_internal;
@@ -1871,7 +1898,11 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 	 */
 	switch (insn.iclass) {
 	case ptic_call:
-		return pt_blk_add_decode(bcache, ioff, insn.mode);
+		status = pt_blk_add_decode(bcache, ioff, insn.mode);
+		if (status < 0)
+			return status;
+
+		return pt_blk_may_proceed(decoder, &insn, msec);
 
 	case ptic_jump:
 		/* An indirect branch requires trace and should have been
@@ -1881,8 +1912,13 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 			return -pte_internal;
 
 		if (iext.variant.branch.displacement < 0 ||
-		    decoder->flags.variant.block.end_on_jump)
-			return pt_blk_add_decode(bcache, ioff, insn.mode);
+		    decoder->flags.variant.block.end_on_jump) {
+			status = pt_blk_add_decode(bcache, ioff, insn.mode);
+			if (status < 0)
+				return status;
+
+			return pt_blk_may_proceed(decoder, &insn, msec);
+		}
 
 		fallthrough;
 	default:
@@ -1894,7 +1930,10 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 
 	/* We proceeded one instruction.  Let's see if we have a cache entry for
 	 * the next instruction.
+	 *
+	 * If we do, the cached flow proceeds from there.
 	 */
+	proceed = 1;
 	status = pt_bcache_lookup(&bce, bcache, noff);
 	if (status < 0)
 		return status;
@@ -1913,9 +1952,14 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 		 * and continue from there.
 		 */
 		steps -= 1;
-		if (!steps)
-			return pt_blk_add_trampoline(bcache, ioff, noff,
-						     insn.mode);
+		if (!steps) {
+			status = pt_blk_add_trampoline(bcache, ioff, noff,
+						       insn.mode);
+			if (status < 0)
+				return status;
+
+			return 1;
+		}
 
 		status = pt_blk_proceed_no_event_fill_cache(decoder, block,
 							    bcache, msec,
@@ -1923,6 +1967,8 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 		if (status < 0)
 			return status;
 
+		proceed = status;
+
 		/* Let's see if we have more luck this time. */
 		status = pt_bcache_lookup(&bce, bcache, noff);
 		if (status < 0)
@@ -1956,7 +2002,7 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 	 * We will instead take the slow path until the end of the section.
 	 */
 	if (!pt_blk_is_in_section(msec, dip))
-		return 0;
+		return proceed;
 
 	/* Let's try to reach @nip's decision point from @insn.ip.
 	 *
@@ -1971,8 +2017,13 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 	 * If one or both overflowed, let's try to insert a trampoline, i.e. we
 	 * try to reach @dip via a ptbq_again entry to @nip.
 	 */
-	if (!bce.ninsn || ((int64_t) bce.displacement != disp))
-		return pt_blk_add_trampoline(bcache, ioff, noff, insn.mode);
+	if (!bce.ninsn || ((int64_t) bce.displacement != disp)) {
+		status = pt_blk_add_trampoline(bcache, ioff, noff, insn.mode);
+		if (status < 0)
+			return status;
+
+		return proceed;
+	}
 
 	/* We're done.  Add the cache entry.
 	 *
@@ -1983,7 +2034,11 @@ pt_blk_proceed_no_event_fill_cache(struct pt_block_decoder *decoder,
 	 * Cache updates are atomic so even if the two versions were not
 	 * identical, we wouldn't care because they are both correct.
 	 */
-	return pt_bcache_add(bcache, ioff, bce);
+	status = pt_bcache_add(bcache, ioff, bce);
+	if (status < 0)
+		return status;
+
+	return proceed;
 }
 
 /* Proceed at a potentially truncated instruction.
@@ -2082,11 +2137,21 @@ static int pt_blk_proceed_no_event_cached(struct pt_block_decoder *decoder,
 	if (status < 0)
 		return status;
 
-	/* If we don't find a valid cache entry, fill the cache. */
-	if (!pt_bce_is_valid(bce))
-		return pt_blk_proceed_no_event_fill_cache(decoder, block,
-							  bcache, msec,
-							  bcache_fill_steps);
+	/* If we don't find a valid cache entry, fill the cache.
+	 *
+	 * Filling the cache stops early in some places.  Proceed from there
+	 * the way we would have had the cache been filled.
+	 */
+	if (!pt_bce_is_valid(bce)) {
+		status = pt_blk_proceed_no_event_fill_cache(decoder, block,
+							    bcache, msec,
+							    bcache_fill_steps);
+		if (status <= 0)
+			return status;
+
+		return pt_blk_proceed_no_event_cached(decoder, block, bcache,
+						      msec);
+	}
 
 	/* If we switched sections, the origianl section must have been split
 	 * underneath us.  A split preserves the block cache of the original
@@ -2258,24 +2323,14 @@ static int pt_blk_proceed_no_event_cached(struct pt_block_decoder *decoder,
 			return pt_blk_proceed_with_trace(decoder, &insn, &iext);
 		}
 
-		/* End the block if the user asked us to.
+		/* If we can proceed without trace and we stay in @msec we may
+		 * proceed further unless the user asked us to end the block.
 		 *
 		 * We only need to take care about direct near branches.
 		 * Indirect and far branches require trace and will naturally
 		 * end a block.
 		 */
-		if ((decoder->flags.variant.block.end_on_call &&
-		     (insn.iclass == ptic_call)) ||
-		    (decoder->flags.variant.block.end_on_jump &&
-		     (insn.iclass == ptic_jump)))
-			return 0;
-
-		/* If we can proceed without trace and we stay in @msec we may
-		 * proceed further.
-		 *
-		 * We're done if we switch sections, though.
-		 */
-		if (!pt_blk_is_in_section(msec, decoder->ip))
+		if (!pt_blk_may_proceed(decoder, &insn, msec))
 			return 0;
 
 		return pt_blk_proceed_no_event_cached(decoder, block, bcache,
@@ -30,6 +30,7 @@
 #include "pt_section.h"
 #include "pt_asid.h"
 #include "pt_image_section_cache.h"
+#include "pt_image_pool.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -55,7 +56,33 @@ static char *dupstr(const char *str)
 	return memcpy(dup, str, len);
 }
 
-static struct pt_section_list *pt_mk_section_list(struct pt_section *section,
+/* Allocate @size bytes of memory for @image.
+ *
+ * If @image uses a pool, the memory is taken from that pool.  The pool slot
+ * size limits @size to the image objects the pool was designed for.
+ */
+static void *pt_image_alloc_mem(struct pt_image *image, size_t size)
+{
+	if (!image)
+		return NULL;
+
+	if (image->pool)
+		return pt_image_pool_alloc_slot(image->pool);
+
+	return malloc(size);
+}
+
+/* Free @mem allocated from the optional @pool. */
+static void pt_image_free_mem(struct pt_image_pool *pool, void *mem)
+{
+	if (pool)
+		pt_image_pool_free_slot(pool, mem);
+	else
+		free(mem);
+}
+
+static struct pt_section_list *pt_mk_section_list(struct pt_image *image,
+						  struct pt_section *section,
 						  const struct pt_asid *asid,
 						  uint64_t vaddr,
 						  uint64_t offset,
@@ -64,7 +91,7 @@ static struct pt_section_list *pt_mk_section_list(struct pt_section *section,
 	struct pt_section_list *list;
 	int errcode;
 
-	list = malloc(sizeof(*list));
+	list = pt_image_alloc_mem(image, sizeof(*list));
 	if (!list)
 		return NULL;
 
@@ -80,30 +107,288 @@ static struct pt_section_list *pt_mk_section_list(struct pt_section *section,
 	return list;
 
 out_mem:
-	free(list);
+	pt_image_free_mem(image->pool, list);
 	return NULL;
 }
 
-static void pt_section_list_free(struct pt_section_list *list)
+/* Free @list allocated from the optional @pool. */
+static void pt_section_list_free(struct pt_image_pool *pool,
+				 struct pt_section_list *list)
 {
 	if (!list)
 		return;
 
 	pt_section_put(list->section.section);
 	pt_msec_fini(&list->section);
-	free(list);
+	pt_image_free_mem(pool, list);
 }
 
-static void pt_section_list_free_tail(struct pt_section_list *list)
+static void pt_section_list_free_tail(struct pt_image_pool *pool,
+				      struct pt_section_list *list)
 {
+	if (pool) {
+		struct pt_section_list *elem;
+
+		/* Release the sections and return the entire list to @pool
+		 * in one go rather than taking the pool lock per element.
+		 */
+		for (elem = list; elem; elem = elem->next) {
+			pt_section_put(elem->section.section);
+			pt_msec_fini(&elem->section);
+		}
+
+		pt_image_pool_free_list(pool, list);
+		return;
+	}
+
 	while (list) {
 		struct pt_section_list *trash;
 
 		trash = list;
 		list = list->next;
 
-		pt_section_list_free(trash);
+		pt_section_list_free(pool, trash);
+	}
+}
+
+static inline int pt_image_shared_lock(struct pt_image_shared *shared)
+{
+	if (!shared)
+		return -pte_internal;
+
+	if (shared->pool)
+		return pt_image_pool_lock(shared->pool);
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_lock(&shared->lock);
+		if (errcode != thrd_success)
+			return -pte_bad_lock;
 	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+static inline int pt_image_shared_unlock(struct pt_image_shared *shared)
+{
+	if (!shared)
+		return -pte_internal;
+
+	if (shared->pool)
+		return pt_image_pool_unlock(shared->pool);
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_unlock(&shared->lock);
+		if (errcode != thrd_success)
+			return -pte_bad_lock;
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+/* Start sharing @image's sections.
+ *
+ * If @image does not already share its sections, move them into a new shared
+ * section list with a single user.  The shared list holds a reference to the
+ * pool from which its elements were allocated.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_mk_shared(struct pt_image *image)
+{
+	struct pt_image_shared *shared;
+	int errcode;
+
+	if (!image)
+		return -pte_internal;
+
+	if (image->shared)
+		return 0;
+
+	if (image->pool) {
+		errcode = pt_image_pool_get(image->pool);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	errcode = -pte_nomem;
+	shared = pt_image_alloc_mem(image, sizeof(*shared));
+	if (!shared)
+		goto out_pool;
+
+	memset(shared, 0, sizeof(*shared));
+
+#if defined(FEATURE_THREADS)
+	if (!image->pool) {
+		errcode = mtx_init(&shared->lock, mtx_plain);
+		if (errcode != thrd_success) {
+			pt_image_free_mem(image->pool, shared);
+			errcode = -pte_bad_lock;
+			goto out_pool;
+		}
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	shared->pool = image->pool;
+	shared->sections = image->sections;
+	shared->ucount = 1;
+
+	image->shared = shared;
+	image->last = NULL;
+
+	return 0;
+
+out_pool:
+	if (image->pool)
+		(void) pt_image_pool_put(image->pool);
+
+	return errcode;
+}
+
+static void pt_image_free_shared(struct pt_image_shared *shared)
+{
+	struct pt_image_pool *pool;
+
+	if (!shared)
+		return;
+
+	pool = shared->pool;
+
+#if defined(FEATURE_THREADS)
+
+	if (!pool)
+		mtx_destroy(&shared->lock);
+
+#endif /* defined(FEATURE_THREADS) */
+
+	pt_image_free_mem(pool, shared);
+
+	if (pool)
+		(void) pt_image_pool_put(pool);
+}
+
+/* Stop sharing @image's sections.
+ *
+ * Drop @image's reference to its shared section list and free the list if
+ * this was the last reference.  This leaves @image without sections.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_put_shared(struct pt_image *image)
+{
+	struct pt_image_shared *shared;
+	uint32_t ucount;
+	int errcode;
+
+	if (!image)
+		return -pte_internal;
+
+	shared = image->shared;
+	if (!shared)
+		return -pte_internal;
+
+	errcode = pt_image_shared_lock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	ucount = shared->ucount;
+	if (ucount)
+		shared->ucount = --ucount;
+
+	errcode = pt_image_shared_unlock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	image->sections = NULL;
+	image->shared = NULL;
+	image->last = NULL;
+
+	if (!ucount) {
+		pt_section_list_free_tail(shared->pool, shared->sections);
+		pt_image_free_shared(shared);
+	}
+
+	return 0;
+}
+
+/* Make @image's section list private so it can be modified.
+ *
+ * If @image is the only user of its shared section list and the list was
+ * allocated from @image's pool, it takes over the list.  Otherwise, it creates
+ * its own copy.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_unshare(struct pt_image *image)
+{
+	struct pt_section_list *list, *copy, **tail;
+	struct pt_image_shared *shared;
+	uint32_t ucount;
+	int errcode;
+
+	if (!image)
+		return -pte_internal;
+
+	shared = image->shared;
+	if (!shared)
+		return 0;
+
+	errcode = pt_image_shared_lock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	ucount = shared->ucount;
+
+	errcode = pt_image_shared_unlock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	/* Nobody else can obtain a new reference if we're the only user. */
+	if ((ucount == 1) && (shared->pool == image->pool)) {
+		image->shared = NULL;
+		image->last = NULL;
+
+		pt_image_free_shared(shared);
+		return 0;
+	}
+
+	copy = NULL;
+	tail = &copy;
+	for (list = shared->sections; list; list = list->next) {
+		const struct pt_mapped_section *msec;
+		struct pt_section_list *elem;
+
+		msec = &list->section;
+		elem = pt_mk_section_list(image, pt_msec_section(msec),
+					  pt_msec_asid(msec),
+					  pt_msec_begin(msec),
+					  pt_msec_offset(msec),
+					  pt_msec_size(msec), list->isid);
+		if (!elem) {
+			pt_section_list_free_tail(image->pool, copy);
+			return -pte_nomem;
+		}
+
+		*tail = elem;
+		tail = &elem->next;
+	}
+
+	errcode = pt_image_put_shared(image);
+	if (errcode < 0) {
+		pt_section_list_free_tail(image->pool, copy);
+		return errcode;
+	}
+
+	image->sections = copy;
+
+	return 0;
 }
 
 void pt_image_init(struct pt_image *image, const char *name)
@@ -121,7 +406,11 @@ void pt_image_fini(struct pt_image *image)
 	if (!image)
 		return;
 
-	pt_section_list_free_tail(image->sections);
+	if (image->shared)
+		(void) pt_image_put_shared(image);
+	else
+		pt_section_list_free_tail(image->pool, image->sections);
+
 	free(image->name);
 
 	memset(image, 0, sizeof(*image));
@@ -138,10 +427,47 @@ struct pt_image *pt_image_alloc(const char *name)
 	return image;
 }
 
+struct pt_image *pt_image_alloc_pooled(const char *name,
+				       struct pt_image_pool *pool)
+{
+	struct pt_image *image;
+	int errcode;
+
+	if (!pool)
+		return pt_image_alloc(name);
+
+	errcode = pt_image_pool_get(pool);
+	if (errcode < 0)
+		return NULL;
+
+	image = pt_image_pool_alloc_slot(pool);
+	if (!image) {
+		(void) pt_image_pool_put(pool);
+		return NULL;
+	}
+
+	pt_image_init(image, name);
+	image->pool = pool;
+
+	return image;
+}
+
 void pt_image_free(struct pt_image *image)
 {
+	struct pt_image_pool *pool;
+
+	if (!image)
+		return;
+
+	pool = image->pool;
+
 	pt_image_fini(image);
-	free(image);
+
+	if (pool) {
+		pt_image_pool_free_slot(pool, image);
+		(void) pt_image_pool_put(pool);
+	} else
+		free(image);
 }
 
 const char *pt_image_name(const struct pt_image *image)
@@ -162,11 +488,16 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 	if (!image || !section)
 		return -pte_internal;
 
+	errcode = pt_image_unshare(image);
+	if (errcode < 0)
+		return errcode;
+
 	size = pt_section_size(section);
 	begin = vaddr;
 	end = begin + size;
 
-	next = pt_mk_section_list(section, asid, begin, 0ull, size, isid);
+	next = pt_mk_section_list(image, section, asid, begin, 0ull, size,
+				  isid);
 	if (!next)
 		return -pte_nomem;
 
@@ -221,8 +552,9 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 
 		/* Add a section covering the remaining bytes at the front. */
 		if (lbegin < begin) {
-			new = pt_mk_section_list(lsec, masid, lbegin, loff,
-						 begin - lbegin, current->isid);
+			new = pt_mk_section_list(image, lsec, masid, lbegin,
+						 loff, begin - lbegin,
+						 current->isid);
 			if (!new) {
 				errcode = -pte_nomem;
 				break;
@@ -234,7 +566,7 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 
 		/* Add a section covering the remaining bytes at the back. */
 		if (end < lend) {
-			new = pt_mk_section_list(lsec, masid, end,
+			new = pt_mk_section_list(image, lsec, masid, end,
 						 loff + (end - lbegin),
 						 lend - end, current->isid);
 			if (!new) {
@@ -248,7 +580,7 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 	}
 
 	if (errcode < 0) {
-		pt_section_list_free_tail(next);
+		pt_section_list_free_tail(image->pool, next);
 
 		/* Re-add removed sections to the tail of the section list. */
 		for (; *list; list = &((*list)->next))
@@ -258,7 +590,7 @@ int pt_image_add(struct pt_image *image, struct pt_section *section,
 		return errcode;
 	}
 
-	pt_section_list_free_tail(removed);
+	pt_section_list_free_tail(image->pool, removed);
 
 	*list = next;
 	return 0;
@@ -268,17 +600,21 @@ int pt_image_remove(struct pt_image *image, struct pt_section *section,
 		    const struct pt_asid *asid, uint64_t vaddr)
 {
 	struct pt_section_list **list;
+	int errcode;
 
 	if (!image || !section)
 		return -pte_internal;
 
+	errcode = pt_image_unshare(image);
+	if (errcode < 0)
+		return errcode;
+
 	for (list = &image->sections; *list; list = &((*list)->next)) {
 		struct pt_mapped_section *msec;
 		const struct pt_section *sec;
 		const struct pt_asid *masid;
 		struct pt_section_list *trash;
 		uint64_t begin;
-		int errcode;
 
 		trash = *list;
 		msec = &trash->section;
@@ -295,7 +631,7 @@ int pt_image_remove(struct pt_image *image, struct pt_section *section,
 		sec = pt_msec_section(msec);
 		if (sec == section && begin == vaddr) {
 			*list = trash->next;
-			pt_section_list_free(trash);
+			pt_section_list_free(image->pool, trash);
 
 			return 0;
 		}
@@ -369,12 +705,62 @@ int pt_image_copy(struct pt_image *image, const struct pt_image *src)
 	return ignored;
 }
 
+int pt_image_share(struct pt_image *image, struct pt_image *src)
+{
+	struct pt_image_shared *shared;
+	uint32_t ucount;
+	int errcode;
+
+	if (!image || !src)
+		return -pte_invalid;
+
+	if (image == src)
+		return 0;
+
+	errcode = pt_image_mk_shared(src);
+	if (errcode < 0)
+		return errcode;
+
+	shared = src->shared;
+	if (image->shared == shared)
+		return 0;
+
+	errcode = pt_image_shared_lock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	ucount = shared->ucount + 1;
+	if (ucount)
+		shared->ucount = ucount;
+
+	errcode = pt_image_shared_unlock(shared);
+	if (errcode < 0)
+		return errcode;
+
+	if (!ucount)
+		return -pte_overflow;
+
+	if (image->shared) {
+		errcode = pt_image_put_shared(image);
+		if (errcode < 0)
+			return errcode;
+	} else
+		pt_section_list_free_tail(image->pool, image->sections);
+
+	image->sections = shared->sections;
+	image->shared = shared;
+	image->last = NULL;
+
+	return 0;
+}
+
 int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 				const struct pt_asid *uasid)
 {
 	struct pt_section_list **list;
+	struct pt_section *probe;
 	struct pt_asid asid;
-	int errcode, removed;
+	int errcode, removed, probed;
 
 	if (!image || !filename)
 		return -pte_invalid;
@@ -383,13 +769,20 @@ int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 	if (errcode < 0)
 		return errcode;
 
+	errcode = pt_image_unshare(image);
+	if (errcode < 0)
+		return errcode;
+
+	probe = NULL;
+	probed = 0;
 	removed = 0;
 	for (list = &image->sections; *list;) {
 		struct pt_mapped_section *msec;
-		const struct pt_section *sec;
+		struct pt_section *sec;
 		const struct pt_asid *masid;
 		struct pt_section_list *trash;
 		const char *tname;
+		int match;
 
 		trash = *list;
 		msec = &trash->section;
@@ -397,7 +790,7 @@ int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 
 		errcode = pt_asid_match(masid, &asid);
 		if (errcode < 0)
-			return errcode;
+			break;
 
 		if (!errcode) {
 			list = &trash->next;
@@ -407,15 +800,53 @@ int pt_image_remove_by_filename(struct pt_image *image, const char *filename,
 		sec = pt_msec_section(msec);
 		tname = pt_section_filename(sec);
 
-		if (tname && (strcmp(tname, filename) == 0)) {
+		match = tname && (strcmp(tname, filename) == 0);
+		if (!match) {
+			int aliased;
+
+			/* A section that an image section cache shares between
+			 * different file names keeps the file name it was
+			 * first added with.  We match those sections if they
+			 * are backed by the same file as @filename.
+			 *
+			 * Other sections only match by file name.
+			 */
+			aliased = pt_section_aliased(sec);
+			if (aliased < 0) {
+				errcode = aliased;
+				break;
+			}
+
+			if (aliased && !probed) {
+				int status;
+
+				status = pt_mk_section(&probe, filename, 0ull,
+						       1ull);
+				if (status < 0)
+					probe = NULL;
+
+				probed = 1;
+			}
+
+			if (aliased && probe)
+				match = (pt_section_same_file(probe, sec) > 0);
+		}
+
+		if (match) {
 			*list = trash->next;
-			pt_section_list_free(trash);
+			pt_section_list_free(image->pool, trash);
 
 			removed += 1;
 		} else
 			list = &trash->next;
 	}
 
+	if (probe)
+		(void) pt_section_put(probe);
+
+	if (errcode < 0)
+		return errcode;
+
 	return removed;
 }
 
@@ -433,6 +864,10 @@ int pt_image_remove_by_asid(struct pt_image *image,
 	if (errcode < 0)
 		return errcode;
 
+	errcode = pt_image_unshare(image);
+	if (errcode < 0)
+		return errcode;
+
 	removed = 0;
 	for (list = &image->sections; *list;) {
 		struct pt_mapped_section *msec;
@@ -453,7 +888,7 @@ int pt_image_remove_by_asid(struct pt_image *image,
 		}
 
 		*list = trash->next;
-		pt_section_list_free(trash);
+		pt_section_list_free(image->pool, trash);
 
 		removed += 1;
 	}
@@ -467,12 +902,101 @@ int pt_image_set_callback(struct pt_image *image,
 	if (!image)
 		return -pte_invalid;
 
+	memset(&image->readmem, 0, sizeof(image->readmem));
+
 	image->readmem.callback = callback;
 	image->readmem.context = context;
 
 	return 0;
 }
 
+int pt_image_set_window_callback(struct pt_image *image,
+				 read_memory_window_callback_t *callback,
+				 void *context)
+{
+	if (!image)
+		return -pte_invalid;
+
+	memset(&image->readmem, 0, sizeof(image->readmem));
+
+	image->readmem.window_callback = callback;
+	image->readmem.context = context;
+
+	return 0;
+}
+
+/* Check whether a memory window contains an address.
+ *
+ * Returns non-zero if @window contains @vaddr, zero otherwise.
+ */
+static inline int
+pt_image_window_contains(const struct pt_memory_window *window, uint64_t vaddr)
+{
+	if (!window || !window->content)
+		return 0;
+
+	if (vaddr < window->vaddr)
+		return 0;
+
+	return (vaddr - window->vaddr) < window->size;
+}
+
+/* Read memory from the memory window callback.
+ *
+ * Serves the read from the cached memory window, if possible.  Otherwise,
+ * requests a new window containing @addr from the callback and caches it.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_nomap if the callback does not provide @addr.
+ */
+static int pt_image_read_window(struct pt_image *image, uint8_t *buffer,
+				uint16_t size, const struct pt_asid *asid,
+				uint64_t addr)
+{
+	read_memory_window_callback_t *callback;
+	struct pt_memory_window *window;
+	struct pt_asid *wasid;
+	uint64_t offset, left;
+
+	if (!image || !buffer || !asid)
+		return -pte_internal;
+
+	callback = image->readmem.window_callback;
+	if (!callback)
+		return -pte_internal;
+
+	window = &image->readmem.window;
+	wasid = &image->readmem.wasid;
+
+	if (!pt_image_window_contains(window, addr) ||
+	    (wasid->cr3 != asid->cr3) || (wasid->vmcs != asid->vmcs)) {
+		struct pt_memory_window fetched;
+		int errcode;
+
+		memset(&fetched, 0, sizeof(fetched));
+
+		errcode = callback(&fetched, asid, addr,
+				   image->readmem.context);
+		if (errcode < 0)
+			return errcode;
+
+		if (!pt_image_window_contains(&fetched, addr))
+			return -pte_nomap;
+
+		*window = fetched;
+		*wasid = *asid;
+	}
+
+	offset = addr - window->vaddr;
+	left = window->size - offset;
+	if (left < size)
+		size = (uint16_t) left;
+
+	memcpy(buffer, window->content + offset, size);
+
+	return (int) size;
+}
+
 static int pt_image_read_callback(struct pt_image *image, int *isid,
 				  uint8_t *buffer, uint16_t size,
 				  const struct pt_asid *asid, uint64_t addr)
@@ -482,6 +1006,12 @@ static int pt_image_read_callback(struct pt_image *image, int *isid,
 	if (!image || !isid)
 		return -pte_internal;
 
+	if (image->readmem.window_callback) {
+		*isid = 0;
+
+		return pt_image_read_window(image, buffer, size, asid, addr);
+	}
+
 	callback = image->readmem.callback;
 	if (!callback)
 		return -pte_nomap;
@@ -527,19 +1057,37 @@ static inline int pt_image_check_msec(const struct pt_mapped_section *msec,
 
 /* Find the section containing a given address in a given address space.
  *
- * On success, the found section is moved to the front of the section list.
- * If caching is enabled, maps the section.
+ * On success, the found section is moved to the front of the section list
+ * unless the list is shared, and provided in @pelem.
  *
  * Returns zero on success, a negative error code otherwise.
  */
 static int pt_image_fetch_section(struct pt_image *image,
+				  struct pt_section_list **pelem,
 				  const struct pt_asid *asid, uint64_t vaddr)
 {
 	struct pt_section_list **start, **list;
 
-	if (!image)
+	if (!image || !pelem)
 		return -pte_internal;
 
+	/* Shared lists are not reordered.  Try the most recently found
+	 * section before we walk the list.
+	 */
+	if (image->shared && image->last) {
+		int errcode;
+
+		errcode = pt_image_check_msec(&image->last->section, asid,
+					      vaddr);
+		if (errcode != -pte_nomap) {
+			if (errcode < 0)
+				return errcode;
+
+			*pelem = image->last;
+			return 0;
+		}
+	}
+
 	start = &image->sections;
 	for (list = start; *list;) {
 		struct pt_mapped_section *msec;
@@ -558,6 +1106,16 @@ static int pt_image_fetch_section(struct pt_image *image,
 			continue;
 		}
 
+		*pelem = elem;
+
+		/* We must not modify a shared list.  Remember the section for
+		 * pt_image_validate(), instead.
+		 */
+		if (image->shared) {
+			image->last = elem;
+			return 0;
+		}
+
 		/* Move the section to the front if it isn't already. */
 		if (list != start) {
 			*list = elem->next;
@@ -582,7 +1140,8 @@ int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
 	if (!image || !isid)
 		return -pte_internal;
 
-	errcode = pt_image_fetch_section(image, asid, addr);
+	slist = NULL;
+	errcode = pt_image_fetch_section(image, &slist, asid, addr);
 	if (errcode < 0) {
 		if (errcode != -pte_nomap)
 			return errcode;
@@ -591,7 +1150,6 @@ int pt_image_read(struct pt_image *image, int *isid, uint8_t *buffer,
 					      addr);
 	}
 
-	slist = image->sections;
 	if (!slist)
 		return -pte_internal;
 
@@ -664,11 +1222,11 @@ int pt_image_find(struct pt_image *image, struct pt_mapped_section *usec,
 	if (!image || !usec)
 		return -pte_internal;
 
-	errcode = pt_image_fetch_section(image, asid, vaddr);
+	slist = NULL;
+	errcode = pt_image_fetch_section(image, &slist, asid, vaddr);
 	if (errcode < 0)
 		return errcode;
 
-	slist = image->sections;
 	if (!slist)
 		return -pte_internal;
 
@@ -707,8 +1265,11 @@ int pt_image_validate(const struct pt_image *image,
 	 *
 	 * A failed validation requires decoders to re-fetch the section so it
 	 * only results in a (relatively small) performance loss.
+	 *
+	 * Shared section lists are not reordered.  We check the most recently
+	 * found section, instead.
 	 */
-	slist = image->sections;
+	slist = image->shared ? image->last : image->sections;
 	if (!slist)
 		return -pte_nomap;
 
@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_image_pool.h"
+#include "pt_image.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A pool slot. */
+union pt_image_pool_slot {
+	/* The next free slot while the slot is not in use. */
+	union pt_image_pool_slot *next;
+
+	/* The objects a slot may hold while in use. */
+	struct pt_image image;
+	struct pt_section_list list;
+	struct pt_image_shared shared;
+};
+
+/* A chunk of pool slots. */
+struct pt_image_pool_chunk {
+	/* The next chunk. */
+	struct pt_image_pool_chunk *next;
+
+	/* The slots. */
+	union pt_image_pool_slot slots[pt_image_pool_chunk_slots];
+};
+
+
+int pt_image_pool_init(struct pt_image_pool *pool)
+{
+	if (!pool)
+		return -pte_internal;
+
+	memset(pool, 0, sizeof(*pool));
+
+	pool->ucount = 1;
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_init(&pool->lock, mtx_plain);
+		if (errcode != thrd_success)
+			return -pte_bad_lock;
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+void pt_image_pool_fini(struct pt_image_pool *pool)
+{
+	struct pt_image_pool_chunk *chunk;
+
+	if (!pool)
+		return;
+
+	chunk = pool->chunks;
+	while (chunk) {
+		struct pt_image_pool_chunk *trash;
+
+		trash = chunk;
+		chunk = chunk->next;
+
+		free(trash);
+	}
+
+#if defined(FEATURE_THREADS)
+
+	mtx_destroy(&pool->lock);
+
+#endif /* defined(FEATURE_THREADS) */
+
+	memset(pool, 0, sizeof(*pool));
+}
+
+struct pt_image_pool *pt_image_pool_alloc(void)
+{
+	struct pt_image_pool *pool;
+	int errcode;
+
+	pool = malloc(sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	errcode = pt_image_pool_init(pool);
+	if (errcode < 0) {
+		free(pool);
+		return NULL;
+	}
+
+	return pool;
+}
+
+void pt_image_pool_free(struct pt_image_pool *pool)
+{
+	(void) pt_image_pool_put(pool);
+}
+
+int pt_image_pool_lock(struct pt_image_pool *pool)
+{
+	if (!pool)
+		return -pte_internal;
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_lock(&pool->lock);
+		if (errcode != thrd_success)
+			return -pte_bad_lock;
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+int pt_image_pool_unlock(struct pt_image_pool *pool)
+{
+	if (!pool)
+		return -pte_internal;
+
+#if defined(FEATURE_THREADS)
+	{
+		int errcode;
+
+		errcode = mtx_unlock(&pool->lock);
+		if (errcode != thrd_success)
+			return -pte_bad_lock;
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+int pt_image_pool_get(struct pt_image_pool *pool)
+{
+	uint32_t ucount;
+	int errcode;
+
+	errcode = pt_image_pool_lock(pool);
+	if (errcode < 0)
+		return errcode;
+
+	ucount = pool->ucount + 1;
+	if (!ucount) {
+		(void) pt_image_pool_unlock(pool);
+		return -pte_overflow;
+	}
+
+	pool->ucount = ucount;
+
+	return pt_image_pool_unlock(pool);
+}
+
+int pt_image_pool_put(struct pt_image_pool *pool)
+{
+	uint32_t ucount;
+	int errcode;
+
+	errcode = pt_image_pool_lock(pool);
+	if (errcode < 0)
+		return errcode;
+
+	ucount = pool->ucount;
+	if (!ucount) {
+		(void) pt_image_pool_unlock(pool);
+		return -pte_internal;
+	}
+
+	pool->ucount = --ucount;
+
+	errcode = pt_image_pool_unlock(pool);
+	if (errcode < 0)
+		return errcode;
+
+	if (!ucount) {
+		pt_image_pool_fini(pool);
+		free(pool);
+	}
+
+	return 0;
+}
+
+/* Add a new chunk to @pool.
+ *
+ * The caller must hold @pool's lock.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_image_pool_expand(struct pt_image_pool *pool)
+{
+	struct pt_image_pool_chunk *chunk;
+	union pt_image_pool_slot *head;
+	int slot;
+
+	if (!pool)
+		return -pte_internal;
+
+	chunk = malloc(sizeof(*chunk));
+	if (!chunk)
+		return -pte_nomem;
+
+	head = pool->free;
+	for (slot = pt_image_pool_chunk_slots - 1; 0 <= slot; --slot) {
+		chunk->slots[slot].next = head;
+		head = &chunk->slots[slot];
+	}
+
+	chunk->next = pool->chunks;
+	pool->chunks = chunk;
+	pool->free = head;
+	pool->nchunks += 1;
+
+	return 0;
+}
+
+void *pt_image_pool_alloc_slot(struct pt_image_pool *pool)
+{
+	union pt_image_pool_slot *slot;
+	int errcode;
+
+	errcode = pt_image_pool_lock(pool);
+	if (errcode < 0)
+		return NULL;
+
+	if (!pool->free) {
+		errcode = pt_image_pool_expand(pool);
+		if (errcode < 0) {
+			(void) pt_image_pool_unlock(pool);
+			return NULL;
+		}
+	}
+
+	slot = pool->free;
+	pool->free = slot->next;
+	pool->used += 1;
+
+	errcode = pt_image_pool_unlock(pool);
+	if (errcode < 0)
+		return NULL;
+
+	return slot;
+}
+
+void pt_image_pool_free_slot(struct pt_image_pool *pool, void *slot)
+{
+	union pt_image_pool_slot *pslot;
+	int errcode;
+
+	if (!slot)
+		return;
+
+	errcode = pt_image_pool_lock(pool);
+	if (errcode < 0)
+		return;
+
+	pslot = (union pt_image_pool_slot *) slot;
+	pslot->next = pool->free;
+	pool->free = pslot;
+	pool->used -= 1;
+
+	(void) pt_image_pool_unlock(pool);
+}
+
+void pt_image_pool_free_list(struct pt_image_pool *pool,
+			     struct pt_section_list *list)
+{
+	int errcode;
+
+	if (!list)
+		return;
+
+	errcode = pt_image_pool_lock(pool);
+	if (errcode < 0)
+		return;
+
+	while (list) {
+		union pt_image_pool_slot *pslot;
+
+		pslot = (union pt_image_pool_slot *) list;
+		list = list->next;
+
+		pslot->next = pool->free;
+		pool->free = pslot;
+		pool->used -= 1;
+	}
+
+	(void) pt_image_pool_unlock(pool);
+}
@@ -455,6 +455,9 @@ static int pt_iscache_lru_clear(struct pt_image_section_cache *iscache)
 /* Search @iscache for a partial or exact match of @section loaded at @laddr and
  * return the corresponding index or @iscache->size if no match is found.
  *
+ * If @iscache shares sections by file and @like is not NULL, sections backed by
+ * the same file as @like match, as well, independent of their filename.
+ *
  * The caller must lock @iscache.
  *
  * Returns a non-zero index on success, a negative pt_error_code otherwise.
@@ -462,7 +465,8 @@ static int pt_iscache_lru_clear(struct pt_image_section_cache *iscache)
 static int
 pt_iscache_find_section_locked(const struct pt_image_section_cache *iscache,
 			       const char *filename, uint64_t offset,
-			       uint64_t size, uint64_t laddr)
+			       uint64_t size, uint64_t laddr,
+			       const struct pt_section *like)
 {
 	const struct pt_section *section;
 	uint16_t idx, end;
@@ -502,8 +506,19 @@ pt_iscache_find_section_locked(const struct pt_image_section_cache *iscache,
 			if (!sec_filename)
 				return -pte_internal;
 
-			if (strcmp(filename, sec_filename) != 0)
-				continue;
+			if (strcmp(filename, sec_filename) != 0) {
+				int same;
+
+				if (!iscache->share || !like)
+					continue;
+
+				same = pt_section_same_file(like, sec);
+				if (same < 0)
+					return same;
+
+				if (!same)
+					continue;
+			}
 
 			/* Use the cached section instead. */
 			section = sec;
@@ -599,7 +614,8 @@ int pt_iscache_add(struct pt_image_section_cache *iscache,
 		 * rather than adding @section.
 		 */
 		match = pt_iscache_find_section_locked(iscache, filename,
-						       offset, size, laddr);
+						       offset, size, laddr,
+						       section);
 		if (match < 0) {
 			errcode = match;
 			goto out_unlock_detach;
@@ -666,6 +682,20 @@ int pt_iscache_add(struct pt_image_section_cache *iscache,
 			goto out_lru;
 		}
 
+		/* If we share @sec by file, it will be used for @filename,
+		 * as well.  Remember that so users can still find it by that
+		 * name.
+		 */
+		if (strcmp(filename, pt_section_filename(sec)) != 0) {
+			errcode = pt_section_set_aliased(sec);
+			if (errcode < 0) {
+				(void) pt_section_put(section);
+				/* Complete the swap for cleanup. */
+				section = sec;
+				goto out_detach;
+			}
+		}
+
 		errcode = pt_iscache_lock(iscache);
 		if (errcode < 0) {
 			(void) pt_section_put(section);
@@ -913,6 +943,22 @@ int pt_iscache_set_limit(struct pt_image_section_cache *iscache, uint64_t limit)
 	return pt_iscache_lru_free(tail);
 }
 
+int pt_iscache_set_share(struct pt_image_section_cache *iscache, int share)
+{
+	int errcode;
+
+	if (!iscache)
+		return -pte_invalid;
+
+	errcode = pt_iscache_lock(iscache);
+	if (errcode < 0)
+		return errcode;
+
+	iscache->share = share ? 1 : 0;
+
+	return pt_iscache_unlock(iscache);
+}
+
 const char *pt_iscache_name(const struct pt_image_section_cache *iscache)
 {
 	if (!iscache)
@@ -936,7 +982,7 @@ int pt_iscache_add_file(struct pt_image_section_cache *iscache,
 		return errcode;
 
 	match = pt_iscache_find_section_locked(iscache, filename, offset,
-					       size, vaddr);
+					       size, vaddr, NULL);
 	if (match < 0) {
 		(void) pt_iscache_unlock(iscache);
 		return match;
@@ -1047,6 +1093,39 @@ int pt_iscache_read(struct pt_image_section_cache *iscache, uint8_t *buffer,
 	return status;
 }
 
+int pt_iscache_get_file(struct pt_image_section_cache *iscache, int isid,
+			const char **filename, uint64_t *offset, uint64_t *size,
+			uint64_t *vaddr)
+{
+	struct pt_section *section;
+	uint64_t laddr;
+	int errcode;
+
+	if (!iscache)
+		return -pte_invalid;
+
+	errcode = pt_iscache_lookup(iscache, &section, &laddr, isid);
+	if (errcode < 0)
+		return errcode;
+
+	/* The section's file name lives as long as the section and @iscache
+	 * holds a reference to it.
+	 */
+	if (filename)
+		*filename = pt_section_filename(section);
+
+	if (offset)
+		*offset = pt_section_offset(section);
+
+	if (size)
+		*size = pt_section_size(section);
+
+	if (vaddr)
+		*vaddr = laddr;
+
+	return pt_section_put(section);
+}
+
 int pt_iscache_notify_map(struct pt_image_section_cache *iscache,
 			  struct pt_section *section)
 {
@@ -355,6 +355,43 @@ const char *pt_section_filename(const struct pt_section *section)
 	return section->filename;
 }
 
+int pt_section_set_aliased(struct pt_section *section)
+{
+	int errcode;
+
+	if (!section)
+		return -pte_internal;
+
+	errcode = pt_section_lock(section);
+	if (errcode < 0)
+		return errcode;
+
+	section->aliased = 1;
+
+	return pt_section_unlock(section);
+}
+
+int pt_section_aliased(struct pt_section *section)
+{
+	uint32_t aliased;
+	int errcode;
+
+	if (!section)
+		return -pte_internal;
+
+	errcode = pt_section_lock(section);
+	if (errcode < 0)
+		return errcode;
+
+	aliased = section->aliased;
+
+	errcode = pt_section_unlock(section);
+	if (errcode < 0)
+		return errcode;
+
+	return aliased ? 1 : 0;
+}
+
 uint64_t pt_section_size(const struct pt_section *section)
 {
 	if (!section)
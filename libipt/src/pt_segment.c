@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_segment.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+
+int pt_seg_iterator_init(struct pt_segment_iterator *iterator,
+			 const struct pt_config *config)
+{
+	const struct pt_config *pconfig;
+	int errcode;
+
+	if (!iterator || !config)
+		return -pte_invalid;
+
+	memset(iterator, 0, sizeof(*iterator));
+
+	errcode = pt_pkt_decoder_init(&iterator->decoder, config);
+	if (errcode < 0)
+		return errcode;
+
+	pconfig = pt_pkt_config(&iterator->decoder);
+	if (!pconfig)
+		return -pte_internal;
+
+	iterator->end = (uint64_t) (pconfig->end - pconfig->begin);
+
+	return 0;
+}
+
+struct pt_segment_iterator *
+pt_seg_alloc_iterator(const struct pt_config *config)
+{
+	struct pt_segment_iterator *iterator;
+	int errcode;
+
+	iterator = malloc(sizeof(*iterator));
+	if (!iterator)
+		return NULL;
+
+	errcode = pt_seg_iterator_init(iterator, config);
+	if (errcode < 0) {
+		free(iterator);
+		return NULL;
+	}
+
+	return iterator;
+}
+
+void pt_seg_iterator_fini(struct pt_segment_iterator *iterator)
+{
+	if (!iterator)
+		return;
+
+	pt_pkt_decoder_fini(&iterator->decoder);
+}
+
+void pt_seg_free_iterator(struct pt_segment_iterator *iterator)
+{
+	pt_seg_iterator_fini(iterator);
+	free(iterator);
+}
+
+int pt_seg_prev(struct pt_segment_iterator *iterator,
+		struct pt_segment *usegment, size_t size)
+{
+	struct pt_segment segment;
+	uint64_t begin;
+	int errcode;
+
+	if (!iterator || !usegment)
+		return -pte_invalid;
+
+	/* We search backwards from the PSB packet that started the previously
+	 * provided segment.  On the first call, we search from the end of the
+	 * trace buffer.
+	 */
+	errcode = pt_pkt_sync_backward(&iterator->decoder);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_pkt_get_sync_offset(&iterator->decoder, &begin);
+	if (errcode < 0)
+		return errcode;
+
+	if (iterator->end < begin)
+		return -pte_internal;
+
+	segment.begin = begin;
+	segment.end = iterator->end;
+
+	iterator->end = begin;
+
+	/* Zero-initialize fields the user may expect that we do not know. */
+	if (sizeof(segment) < size) {
+		memset((uint8_t *) usegment + sizeof(segment), 0,
+		       size - sizeof(segment));
+
+		size = sizeof(segment);
+	}
+
+	memcpy(usegment, &segment, size);
+
+	return 0;
+}
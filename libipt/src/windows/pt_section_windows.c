@@ -87,6 +87,18 @@ int pt_section_mk_status(void **pstatus, uint64_t *psize, const char *filename)
 	return 0;
 }
 
+int pt_section_same_file(const struct pt_section *lhs,
+			 const struct pt_section *rhs)
+{
+	if (!lhs || !rhs)
+		return -pte_internal;
+
+	/* The file status does not provide a file index on Windows so we
+	 * can't tell whether two different paths refer to the same file.
+	 */
+	return 0;
+}
+
 static int check_file_status(struct pt_section *section, int fd)
 {
 	struct pt_sec_windows_status *status;
@@ -29,11 +29,14 @@
 #include "ptunit.h"
 
 #include "pt_image.h"
+#include "pt_image_pool.h"
 #include "pt_section.h"
 #include "pt_mapped_section.h"
 
 #include "intel-pt.h"
 
+#include <stdlib.h>
+
 
 struct image_fixture;
 
@@ -208,16 +211,63 @@ uint64_t pt_section_size(const struct pt_section *section)
 	return section->size;
 }
 
+/* A section for probing file identity in pt_image_remove_by_filename(). */
+static struct pt_section ifix_probe;
+static struct ifix_status ifix_probe_status;
+
 int pt_mk_section(struct pt_section **psection, const char *filename,
 		  uint64_t offset, uint64_t size)
 {
-	(void) psection;
-	(void) filename;
-	(void) offset;
-	(void) size;
+	if (!psection || !filename)
+		return -pte_internal;
+
+	/* This function is only used for probing file identity. */
+	if (ifix_probe.ucount)
+		return -pte_internal;
+
+	memset(&ifix_probe, 0, sizeof(ifix_probe));
+	memset(&ifix_probe_status, 0, sizeof(ifix_probe_status));
+
+	ifix_probe.filename = (char *) filename;
+	ifix_probe.status = &ifix_probe_status;
+	ifix_probe.offset = offset;
+	ifix_probe.size = size;
+	ifix_probe.ucount = 1;
+
+	*psection = &ifix_probe;
+	return 0;
+}
+
+static const char *basename_of(const char *filename)
+{
+	const char *sep;
+
+	sep = strrchr(filename, '/');
+	if (sep)
+		return sep + 1;
+
+	return filename;
+}
+
+int pt_section_same_file(const struct pt_section *lhs,
+			 const struct pt_section *rhs)
+{
+	if (!lhs || !rhs)
+		return -pte_internal;
+
+	/* We identify test files by their basename.  This allows us to test
+	 * the same file accessed via different directories.
+	 */
+	return strcmp(basename_of(lhs->filename),
+		      basename_of(rhs->filename)) == 0;
+}
+
+int pt_section_aliased(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
 
-	/* This function is not used by our tests. */
-	return -pte_not_supported;
+	return section->aliased ? 1 : 0;
 }
 
 int pt_section_get(struct pt_section *section)
@@ -418,6 +468,46 @@ static int image_readmem_callback(uint8_t *buffer, size_t size,
 	return (int) idx;
 }
 
+/* A test memory window provider. */
+struct image_window_provider {
+	/* The memory. */
+	const uint8_t *memory;
+
+	/* The size of @memory in bytes. */
+	uint64_t size;
+
+	/* The virtual address of @memory. */
+	uint64_t vaddr;
+
+	/* The number of callback invocations. */
+	int calls;
+};
+
+/* A test read memory window callback. */
+static int image_readmem_window_callback(struct pt_memory_window *window,
+					 const struct pt_asid *asid,
+					 uint64_t ip, void *context)
+{
+	struct image_window_provider *provider;
+
+	(void) asid;
+
+	provider = (struct image_window_provider *) context;
+	if (!window || !provider)
+		return -pte_internal;
+
+	provider->calls += 1;
+
+	if (ip < provider->vaddr)
+		return -pte_nomap;
+
+	window->content = provider->memory;
+	window->vaddr = provider->vaddr;
+	window->size = provider->size;
+
+	return 0;
+}
+
 static struct ptunit_result init(void)
 {
 	struct pt_image image;
@@ -427,7 +517,9 @@ static struct ptunit_result init(void)
 	pt_image_init(&image, NULL);
 	ptu_null(image.name);
 	ptu_null(image.sections);
+	ptu_null(image.pool);
 	ptu_null((void *) (uintptr_t) image.readmem.callback);
+	ptu_null((void *) (uintptr_t) image.readmem.window_callback);
 	ptu_null(image.readmem.context);
 
 	return ptu_passed();
@@ -1107,6 +1199,166 @@ static struct ptunit_result read_callback(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result read_window(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02, 0x03, 0x04, 0xdd };
+	struct image_window_provider provider;
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	provider.memory = memory;
+	provider.size = sizeof(memory);
+	provider.vaddr = 0x3000ull;
+	provider.calls = 0;
+
+	status = pt_image_set_window_callback(&ifix->image,
+					      image_readmem_window_callback,
+					      &provider);
+	ptu_int_eq(status, 0);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 2, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 0);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_uint_eq(buffer[1], 0x02);
+	ptu_uint_eq(buffer[2], 0xcc);
+	ptu_int_eq(provider.calls, 1);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 2, &ifix->asid[0],
+			       0x3003ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 0);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+	ptu_int_eq(provider.calls, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_window_asid(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02, 0xdd };
+	struct image_window_provider provider;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	provider.memory = memory;
+	provider.size = sizeof(memory);
+	provider.vaddr = 0x3000ull;
+	provider.calls = 0;
+
+	status = pt_image_set_window_callback(&ifix->image,
+					      image_readmem_window_callback,
+					      &provider);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x01);
+	ptu_int_eq(provider.calls, 1);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[2],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_int_eq(provider.calls, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_window_truncated(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02 };
+	struct image_window_provider provider;
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	provider.memory = memory;
+	provider.size = sizeof(memory);
+	provider.vaddr = 0x3000ull;
+	provider.calls = 0;
+
+	status = pt_image_set_window_callback(&ifix->image,
+					      image_readmem_window_callback,
+					      &provider);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 3, &ifix->asid[0],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_window_nomap(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02 };
+	struct image_window_provider provider;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	provider.memory = memory;
+	provider.size = sizeof(memory);
+	provider.vaddr = 0x3000ull;
+	provider.calls = 0;
+
+	status = pt_image_set_window_callback(&ifix->image,
+					      image_readmem_window_callback,
+					      &provider);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x3003ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x2fffull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_uint_eq(buffer[0], 0xcc);
+	ptu_int_eq(provider.calls, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_window_replace(struct image_fixture *ifix)
+{
+	uint8_t memory[] = { 0xdd, 0x01, 0x02, 0xdd };
+	struct image_window_provider provider;
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	provider.memory = memory;
+	provider.size = sizeof(memory);
+	provider.vaddr = 0x4000ull;
+	provider.calls = 0;
+
+	status = pt_image_set_window_callback(&ifix->image,
+					      image_readmem_window_callback,
+					      &provider);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_set_callback(&ifix->image, image_readmem_callback,
+				       memory);
+	ptu_int_eq(status, 0);
+	ptu_null((void *) (uintptr_t) ifix->image.readmem.window_callback);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x3002ull);
+	ptu_int_eq(status, 1);
+	ptu_uint_eq(buffer[0], 0x02);
+	ptu_int_eq(provider.calls, 0);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read_nomem(struct image_fixture *ifix)
 {
 	uint8_t buffer[] = { 0xcc, 0xcc };
@@ -1350,6 +1602,72 @@ static struct ptunit_result remove_by_filename(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result
+remove_by_filename_alias(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	/* Pretend the section is shared between file names. */
+	ifix->section[0].aliased = 1;
+
+	status = pt_image_remove_by_filename(&ifix->image, "alias/file-0",
+					     &ifix->asid[0]);
+	ptu_int_eq(status, 1);
+
+	ptu_int_ne(ifix->status[0].deleted, 0);
+	ptu_int_eq(ifix->status[1].deleted, 0);
+	ptu_int_eq(ifix_probe.ucount, 0);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, sizeof(buffer),
+			       &ifix->asid[0], 0x1003ull);
+	ptu_int_eq(status, -pte_nomap);
+	ptu_int_eq(isid, -1);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 2, &ifix->asid[1],
+			       0x2003ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 11);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+remove_by_filename_no_alias(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	/* Sections that are not shared between file names only match by
+	 * file name.  We do not even look at the file.
+	 */
+	ifix_probe.filename = NULL;
+
+	status = pt_image_remove_by_filename(&ifix->image, "alias/file-0",
+					     &ifix->asid[0]);
+	ptu_int_eq(status, 0);
+
+	ptu_int_eq(ifix->status[0].deleted, 0);
+	ptu_int_eq(ifix->status[1].deleted, 0);
+	ptu_null(ifix_probe.filename);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 2, &ifix->asid[0],
+			       0x1003ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result
 remove_by_filename_bad_asid(struct image_fixture *ifix)
 {
@@ -1791,6 +2109,477 @@ static struct ptunit_result copy_replace(struct image_fixture *ifix)
 	return ptu_passed();
 }
 
+static struct ptunit_result share_null(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_share(NULL, &ifix->image);
+	ptu_int_eq(status, -pte_invalid);
+
+	status = pt_image_share(&ifix->copy, NULL);
+	ptu_int_eq(status, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+	ptu_ptr(ifix->copy.shared);
+	ptu_ptr_eq(ifix->copy.shared, ifix->image.shared);
+	ptu_ptr_eq(ifix->copy.sections, ifix->image.sections);
+	ptu_uint_eq(ifix->copy.shared->ucount, 2);
+
+	/* Sharing does not take additional section references. */
+	ptu_int_eq(ifix->section[0].ucount, 1);
+	ptu_int_eq(ifix->section[1].ucount, 1);
+
+	isid = -1;
+	status = pt_image_read(&ifix->copy, &isid, buffer, 2, &ifix->asid[1],
+			       0x2003ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 11);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_self(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_share(&ifix->image, &ifix->image);
+	ptu_int_eq(status, 0);
+	ptu_null(ifix->image.shared);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_twice(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(ifix->copy.shared->ucount, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_replace(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	status = pt_image_add(&ifix->copy, &ifix->section[2], &ifix->asid[0],
+			      0x3000ull, 12);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+	ptu_int_eq(ifix->section[2].ucount, 0);
+
+	status = pt_image_read(&ifix->copy, &isid, buffer, 1, &ifix->asid[0],
+			       0x3000ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_add(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->copy, &ifix->section[2], &ifix->asid[0],
+			      0x3000ull, 12);
+	ptu_int_eq(status, 0);
+	ptu_null(ifix->copy.shared);
+	ptu_ptr(ifix->image.shared);
+	ptu_uint_eq(ifix->image.shared->ucount, 1);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+	ptu_int_eq(ifix->section[1].ucount, 2);
+
+	isid = -1;
+	status = pt_image_read(&ifix->copy, &isid, buffer, 1, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 12);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	isid = -1;
+	status = pt_image_read(&ifix->copy, &isid, buffer, 1, &ifix->asid[0],
+			       0x1001ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x3001ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	/* The last user takes over the shared list. */
+	status = pt_image_add(&ifix->image, &ifix->section[2], &ifix->asid[1],
+			      0x4000ull, 13);
+	ptu_int_eq(status, 0);
+	ptu_null(ifix->image.shared);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_remove(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_remove(&ifix->image, &ifix->section[0],
+				 &ifix->asid[0], 0x1000ull);
+	ptu_int_eq(status, 0);
+	ptu_null(ifix->image.shared);
+
+	isid = -1;
+	status = pt_image_read(&ifix->copy, &isid, buffer, 1, &ifix->asid[0],
+			       0x1001ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x01);
+
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1001ull);
+	ptu_int_eq(status, -pte_nomap);
+
+	status = pt_image_remove_by_asid(&ifix->copy, &ifix->asid[1]);
+	ptu_int_eq(status, 1);
+	ptu_null(ifix->copy.shared);
+
+	status = pt_image_remove_by_filename(&ifix->copy, "file-0",
+					     &ifix->asid[0]);
+	ptu_int_eq(status, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_split(struct image_fixture *ifix)
+{
+	uint8_t buffer[] = { 0xcc, 0xcc };
+	int status, isid;
+
+	ifix->section[2].size = 0x2;
+	ifix->mapping[2].size = 0x2;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_add(&ifix->copy, &ifix->section[2], &ifix->asid[0],
+			      0x1004ull, 12);
+	ptu_int_eq(status, 0);
+
+	isid = -1;
+	status = pt_image_read(&ifix->copy, &isid, buffer, 1, &ifix->asid[0],
+			       0x1006ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x06);
+
+	isid = -1;
+	status = pt_image_read(&ifix->image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1004ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 10);
+	ptu_uint_eq(buffer[0], 0x04);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_validate(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	int isid, status;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	isid = pt_image_find(&ifix->copy, &msec, &ifix->asid[1], 0x2003ull);
+	ptu_int_eq(isid, 11);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	/* The shared list is not reordered. */
+	ptu_ptr_eq(ifix->copy.sections, ifix->image.sections);
+	ptu_ptr_eq(ifix->copy.last, ifix->copy.sections->next);
+
+	status = pt_image_validate(&ifix->copy, &msec, 0x2004ull, isid);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_validate(&ifix->image, &msec, 0x2004ull, isid);
+	ptu_int_eq(status, -pte_nomap);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_find_last(struct image_fixture *ifix)
+{
+	struct pt_mapped_section msec;
+	int isid, status;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	isid = pt_image_find(&ifix->copy, &msec, &ifix->asid[1], 0x2003ull);
+	ptu_int_eq(isid, 11);
+	ptu_ptr_eq(ifix->copy.last, ifix->copy.sections->next);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	/* We find the most recently found section again. */
+	isid = pt_image_find(&ifix->copy, &msec, &ifix->asid[1], 0x2007ull);
+	ptu_int_eq(isid, 11);
+	ptu_ptr_eq(ifix->copy.last, ifix->copy.sections->next);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	/* We do not find it in a different address space. */
+	isid = pt_image_find(&ifix->copy, &msec, &ifix->asid[0], 0x2003ull);
+	ptu_int_eq(isid, -pte_nomap);
+	ptu_ptr_eq(ifix->copy.last, ifix->copy.sections->next);
+
+	/* We fall back to searching the list. */
+	isid = pt_image_find(&ifix->copy, &msec, &ifix->asid[0], 0x1003ull);
+	ptu_int_eq(isid, 10);
+	ptu_ptr_eq(ifix->copy.last, ifix->copy.sections);
+
+	status = pt_section_put(msec.section);
+	ptu_int_eq(status, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_fini(struct image_fixture *ifix)
+{
+	int status;
+
+	status = pt_image_share(&ifix->copy, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	pt_image_fini(&ifix->image);
+	ptu_int_eq(ifix->section[0].ucount, 1);
+	ptu_uint_eq(ifix->copy.shared->ucount, 1);
+
+	pt_image_init(&ifix->image, NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result share_pooled(struct image_fixture *ifix)
+{
+	struct pt_image_pool *pool;
+	struct pt_image *parent, *child;
+	int status;
+
+	pool = pt_image_pool_alloc();
+	ptu_ptr(pool);
+
+	parent = pt_image_alloc_pooled(NULL, pool);
+	ptu_ptr(parent);
+
+	child = pt_image_alloc_pooled(NULL, pool);
+	ptu_ptr(child);
+
+	status = pt_image_copy(parent, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	status = pt_image_share(child, parent);
+	ptu_int_eq(status, 0);
+	ptu_ptr_eq(child->shared, parent->shared);
+
+	/* We also share with images from other pools. */
+	status = pt_image_share(&ifix->copy, parent);
+	ptu_int_eq(status, 0);
+	ptu_ptr_eq(ifix->copy.shared, parent->shared);
+	ptu_uint_eq(ifix->copy.shared->ucount, 3);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+
+	pt_image_free(parent);
+	pt_image_pool_free(pool);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+
+	/* The shared sections keep the pool alive. */
+	pt_image_free(child);
+	ptu_uint_eq(ifix->copy.shared->ucount, 1);
+	ptu_ptr_eq(ifix->copy.shared->pool, pool);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+
+	/* The last user copies the sections out of a foreign pool. */
+	status = pt_image_remove_by_asid(&ifix->copy, &ifix->asid[1]);
+	ptu_int_eq(status, 1);
+	ptu_null(ifix->copy.shared);
+	ptu_int_eq(ifix->section[0].ucount, 2);
+	ptu_int_eq(ifix->section[1].ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pooled_null(struct image_fixture *ifix)
+{
+	struct pt_image *image;
+	int status;
+
+	image = pt_image_alloc_pooled("unpooled", NULL);
+	ptu_ptr(image);
+	ptu_null(image->pool);
+	ptu_str_eq(pt_image_name(image), "unpooled");
+
+	status = pt_image_copy(image, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	pt_image_free(image);
+
+	pt_image_pool_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pooled(struct image_fixture *ifix)
+{
+	struct pt_image_pool *pool;
+	struct pt_image *image;
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	pool = pt_image_pool_alloc();
+	ptu_ptr(pool);
+
+	image = pt_image_alloc_pooled("pooled", pool);
+	ptu_ptr(image);
+	ptu_ptr_eq(image->pool, pool);
+	ptu_str_eq(pt_image_name(image), "pooled");
+
+	status = pt_image_copy(image, &ifix->image);
+	ptu_int_eq(status, 0);
+
+	/* The image keeps the pool alive. */
+	pt_image_pool_free(pool);
+
+	isid = -1;
+	status = pt_image_read(image, &isid, buffer, 2, &ifix->asid[1],
+			       0x2003ull);
+	ptu_int_eq(status, 2);
+	ptu_int_eq(isid, 11);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0x04);
+	ptu_uint_eq(buffer[2], 0xcc);
+
+	pt_image_free(image);
+
+	ptu_int_eq(ifix->section[0].ucount, 1);
+	ptu_int_eq(ifix->section[1].ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pooled_many(void)
+{
+	struct pt_image_pool *pool;
+	struct pt_image **images;
+	size_t idx, nimages;
+
+	/* Each pooled image holds a pool reference.  Let's make sure we
+	 * support more than 2^16 of them.
+	 */
+	nimages = 0x10010;
+	images = malloc(nimages * sizeof(*images));
+	ptu_ptr(images);
+
+	pool = pt_image_pool_alloc();
+	ptu_ptr(pool);
+
+	for (idx = 0; idx < nimages; ++idx) {
+		images[idx] = pt_image_alloc_pooled(NULL, pool);
+		if (!images[idx])
+			break;
+	}
+
+	ptu_uint_eq(idx, nimages);
+	ptu_uint_eq(pool->ucount, nimages + 1);
+
+	pt_image_pool_free(pool);
+
+	while (idx)
+		pt_image_free(images[--idx]);
+
+	free(images);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pooled_split(struct image_fixture *ifix)
+{
+	struct pt_image_pool *pool;
+	struct pt_image *image;
+	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
+	int status, isid;
+
+	pool = pt_image_pool_alloc();
+	ptu_ptr(pool);
+
+	image = pt_image_alloc_pooled(NULL, pool);
+	ptu_ptr(image);
+
+	status = pt_image_add(image, &ifix->section[0], &ifix->asid[0],
+			      0x1000ull, 1);
+	ptu_int_eq(status, 0);
+
+	ifix->section[1].size = 0x2;
+	ifix->mapping[1].size = 0x2;
+
+	status = pt_image_add(image, &ifix->section[1], &ifix->asid[0],
+			      0x1004ull, 2);
+	ptu_int_eq(status, 0);
+
+	isid = -1;
+	status = pt_image_read(image, &isid, buffer, 3, &ifix->asid[0],
+			       0x1003ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 1);
+	ptu_uint_eq(buffer[0], 0x03);
+	ptu_uint_eq(buffer[1], 0xcc);
+
+	isid = -1;
+	status = pt_image_read(image, &isid, buffer, 1, &ifix->asid[0],
+			       0x1006ull);
+	ptu_int_eq(status, 1);
+	ptu_int_eq(isid, 1);
+	ptu_uint_eq(buffer[0], 0x06);
+
+	status = pt_image_remove(image, &ifix->section[1], &ifix->asid[0],
+				 0x1004ull);
+	ptu_int_eq(status, 0);
+
+	pt_image_free(image);
+	pt_image_pool_free(pool);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result add_cached_null(void)
 {
 	struct pt_image_section_cache iscache;
@@ -2242,6 +3031,11 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, read_bad_asid, rfix);
 	ptu_run_f(suite, read_null_asid, rfix);
 	ptu_run_f(suite, read_callback, rfix);
+	ptu_run_f(suite, read_window, rfix);
+	ptu_run_f(suite, read_window_asid, rfix);
+	ptu_run_f(suite, read_window_truncated, rfix);
+	ptu_run_f(suite, read_window_nomap, rfix);
+	ptu_run_f(suite, read_window_replace, rfix);
 	ptu_run_f(suite, read_nomem, rfix);
 	ptu_run_f(suite, read_truncated, rfix);
 	ptu_run_f(suite, read_error, rfix);
@@ -2251,6 +3045,8 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, remove_bad_vaddr, rfix);
 	ptu_run_f(suite, remove_bad_asid, rfix);
 	ptu_run_f(suite, remove_by_filename, rfix);
+	ptu_run_f(suite, remove_by_filename_alias, rfix);
+	ptu_run_f(suite, remove_by_filename_no_alias, rfix);
 	ptu_run_f(suite, remove_by_filename_bad_asid, rfix);
 	ptu_run_f(suite, remove_none_by_filename, rfix);
 	ptu_run_f(suite, remove_all_by_filename, ifix);
@@ -2265,6 +3061,24 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, copy_overlap, ifix);
 	ptu_run_f(suite, copy_replace, ifix);
 
+	ptu_run_f(suite, share_null, rfix);
+	ptu_run_f(suite, share, rfix);
+	ptu_run_f(suite, share_self, rfix);
+	ptu_run_f(suite, share_twice, rfix);
+	ptu_run_f(suite, share_replace, rfix);
+	ptu_run_f(suite, share_add, rfix);
+	ptu_run_f(suite, share_remove, rfix);
+	ptu_run_f(suite, share_split, rfix);
+	ptu_run_f(suite, share_validate, rfix);
+	ptu_run_f(suite, share_find_last, rfix);
+	ptu_run_f(suite, share_fini, rfix);
+	ptu_run_f(suite, share_pooled, rfix);
+
+	ptu_run_f(suite, pooled_null, rfix);
+	ptu_run_f(suite, pooled, rfix);
+	ptu_run(suite, pooled_many);
+	ptu_run_f(suite, pooled_split, ifix);
+
 	ptu_run(suite, add_cached_null);
 	ptu_run_f(suite, add_cached, ifix);
 	ptu_run_f(suite, add_cached_null_asid, ifix);
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_image_pool.h"
+#include "pt_image.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture providing an initialized pool. */
+struct pool_fixture {
+	/* The pool. */
+	struct pt_image_pool pool;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct pool_fixture *);
+	struct ptunit_result (*fini)(struct pool_fixture *);
+};
+
+static struct ptunit_result pfix_init(struct pool_fixture *pfix)
+{
+	int errcode;
+
+	memset(&pfix->pool, 0xcd, sizeof(pfix->pool));
+
+	errcode = pt_image_pool_init(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pfix_fini(struct pool_fixture *pfix)
+{
+	pt_image_pool_fini(&pfix->pool);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result init_null(void)
+{
+	int errcode;
+
+	errcode = pt_image_pool_init(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fini_null(void)
+{
+	pt_image_pool_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_null(void)
+{
+	int errcode;
+
+	errcode = pt_image_pool_get(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result put_null(void)
+{
+	int errcode;
+
+	errcode = pt_image_pool_put(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lock_null(void)
+{
+	int errcode;
+
+	errcode = pt_image_pool_lock(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_image_pool_unlock(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_slot_null(void)
+{
+	void *slot;
+
+	slot = pt_image_pool_alloc_slot(NULL);
+	ptu_null(slot);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_slot_null(struct pool_fixture *pfix)
+{
+	pt_image_pool_free_slot(&pfix->pool, NULL);
+	ptu_uint_eq(pfix->pool.used, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_free(void)
+{
+	struct pt_image_pool *pool;
+
+	pool = pt_image_pool_alloc();
+	ptu_ptr(pool);
+	ptu_uint_eq(pool->ucount, 1);
+
+	pt_image_pool_free(pool);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result initially_empty(struct pool_fixture *pfix)
+{
+	ptu_null(pfix->pool.chunks);
+	ptu_null(pfix->pool.free);
+	ptu_uint_eq(pfix->pool.used, 0);
+	ptu_uint_eq(pfix->pool.nchunks, 0);
+	ptu_uint_eq(pfix->pool.ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_put(struct pool_fixture *pfix)
+{
+	int errcode;
+
+	errcode = pt_image_pool_get(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(pfix->pool.ucount, 2);
+
+	errcode = pt_image_pool_put(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(pfix->pool.ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lock_unlock(struct pool_fixture *pfix)
+{
+	int errcode;
+
+	errcode = pt_image_pool_lock(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_image_pool_unlock(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+
+	/* The pool is usable after it has been unlocked. */
+	errcode = pt_image_pool_get(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_image_pool_put(&pfix->pool);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result put_underflow(struct pool_fixture *pfix)
+{
+	int errcode;
+
+	pfix->pool.ucount = 0;
+
+	errcode = pt_image_pool_put(&pfix->pool);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_overflow(struct pool_fixture *pfix)
+{
+	int errcode;
+
+	pfix->pool.ucount = UINT32_MAX;
+
+	errcode = pt_image_pool_get(&pfix->pool);
+	ptu_int_eq(errcode, -pte_overflow);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_many(struct pool_fixture *pfix)
+{
+	uint32_t idx;
+	int errcode;
+
+	/* Each pooled image holds a slot and a pool reference.  Let's make sure
+	 * we support more than 2^16 of them.
+	 */
+	for (idx = 0; idx < 0x10010; ++idx) {
+		void *slot;
+
+		errcode = pt_image_pool_get(&pfix->pool);
+		ptu_int_eq(errcode, 0);
+
+		slot = pt_image_pool_alloc_slot(&pfix->pool);
+		ptu_ptr(slot);
+	}
+
+	ptu_uint_eq(pfix->pool.ucount, 0x10011);
+	ptu_uint_eq(pfix->pool.used, 0x10010);
+
+	for (idx = 0; idx < 0x10010; ++idx) {
+		errcode = pt_image_pool_put(&pfix->pool);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_uint_eq(pfix->pool.ucount, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_slot(struct pool_fixture *pfix)
+{
+	void *slot[3];
+
+	slot[0] = pt_image_pool_alloc_slot(&pfix->pool);
+	ptu_ptr(slot[0]);
+	ptu_uint_eq(pfix->pool.used, 1);
+	ptu_uint_eq(pfix->pool.nchunks, 1);
+
+	slot[1] = pt_image_pool_alloc_slot(&pfix->pool);
+	ptu_ptr(slot[1]);
+	ptu_ptr_ne(slot[1], slot[0]);
+	ptu_uint_eq(pfix->pool.used, 2);
+
+	pt_image_pool_free_slot(&pfix->pool, slot[0]);
+	ptu_uint_eq(pfix->pool.used, 1);
+
+	/* Freed slots are recycled. */
+	slot[2] = pt_image_pool_alloc_slot(&pfix->pool);
+	ptu_ptr_eq(slot[2], slot[0]);
+	ptu_uint_eq(pfix->pool.used, 2);
+	ptu_uint_eq(pfix->pool.nchunks, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_slot_expand(struct pool_fixture *pfix)
+{
+	int idx;
+
+	for (idx = 0; idx < pt_image_pool_chunk_slots; ++idx) {
+		void *slot;
+
+		slot = pt_image_pool_alloc_slot(&pfix->pool);
+		ptu_ptr(slot);
+	}
+
+	ptu_uint_eq(pfix->pool.nchunks, 1);
+	ptu_null(pfix->pool.free);
+
+	for (idx = 0; idx < pt_image_pool_chunk_slots + 1; ++idx) {
+		void *slot;
+
+		slot = pt_image_pool_alloc_slot(&pfix->pool);
+		ptu_ptr(slot);
+	}
+
+	ptu_uint_eq(pfix->pool.nchunks, 3);
+	ptu_uint_eq(pfix->pool.used, (2 * pt_image_pool_chunk_slots) + 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_list_null(struct pool_fixture *pfix)
+{
+	pt_image_pool_free_list(&pfix->pool, NULL);
+	ptu_uint_eq(pfix->pool.used, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_list(struct pool_fixture *pfix)
+{
+	struct pt_section_list *list, *elem[3];
+	void *slot;
+	int idx;
+
+	list = NULL;
+	for (idx = 0; idx < 3; ++idx) {
+		elem[idx] = pt_image_pool_alloc_slot(&pfix->pool);
+		ptu_ptr(elem[idx]);
+
+		elem[idx]->next = list;
+		list = elem[idx];
+	}
+
+	slot = pt_image_pool_alloc_slot(&pfix->pool);
+	ptu_ptr(slot);
+	ptu_uint_eq(pfix->pool.used, 4);
+
+	pt_image_pool_free_list(&pfix->pool, list);
+	ptu_uint_eq(pfix->pool.used, 1);
+
+	/* The list elements are recycled. */
+	for (idx = 0; idx < 3; ++idx) {
+		void *recycled;
+
+		recycled = pt_image_pool_alloc_slot(&pfix->pool);
+		ptu_ptr_eq(recycled, elem[idx]);
+	}
+
+	ptu_uint_eq(pfix->pool.used, 4);
+	ptu_uint_eq(pfix->pool.nchunks, 1);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct pool_fixture pfix;
+	struct ptunit_suite suite;
+
+	pfix.init = pfix_init;
+	pfix.fini = pfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, init_null);
+	ptu_run(suite, fini_null);
+	ptu_run(suite, get_null);
+	ptu_run(suite, put_null);
+	ptu_run(suite, lock_null);
+	ptu_run(suite, alloc_slot_null);
+	ptu_run_f(suite, free_slot_null, pfix);
+
+	ptu_run(suite, alloc_free);
+
+	ptu_run_f(suite, initially_empty, pfix);
+	ptu_run_f(suite, get_put, pfix);
+	ptu_run_f(suite, lock_unlock, pfix);
+	ptu_run_f(suite, put_underflow, pfix);
+	ptu_run_f(suite, get_overflow, pfix);
+	ptu_run_f(suite, get_many, pfix);
+	ptu_run_f(suite, alloc_slot, pfix);
+	ptu_run_f(suite, alloc_slot_expand, pfix);
+	ptu_run_f(suite, free_list_null, pfix);
+	ptu_run_f(suite, free_list, pfix);
+
+	return ptunit_report(&suite);
+}
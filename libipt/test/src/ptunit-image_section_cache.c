@@ -61,6 +61,9 @@ struct pt_section {
 	/* The map count. */
 	int mcount;
 
+	/* A flag saying whether the section is shared between file names. */
+	int aliased;
+
 #if defined(FEATURE_THREADS)
 	/* A lock protecting this section. */
 	mtx_t lock;
@@ -91,6 +94,9 @@ extern int pt_section_memsize(struct pt_section *section, uint64_t *size);
 
 extern int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 			   uint16_t size, uint64_t offset);
+extern int pt_section_same_file(const struct pt_section *lhs,
+				const struct pt_section *rhs);
+extern int pt_section_set_aliased(struct pt_section *section);
 
 
 int pt_mk_section(struct pt_section **psection, const char *filename,
@@ -516,6 +522,39 @@ int pt_section_read(const struct pt_section *section, uint8_t *buffer,
 	return (int) (end - begin);
 }
 
+/* Return the last path component of @filename. */
+static const char *basename_of(const char *filename)
+{
+	const char *slash;
+
+	slash = strrchr(filename, '/');
+
+	return slash ? slash + 1 : filename;
+}
+
+int pt_section_same_file(const struct pt_section *lhs,
+			 const struct pt_section *rhs)
+{
+	if (!lhs || !rhs)
+		return -pte_internal;
+
+	/* We identify test files by their basename.  This allows us to test
+	 * the same file accessed via different directories.
+	 */
+	return strcmp(basename_of(lhs->filename),
+		      basename_of(rhs->filename)) == 0;
+}
+
+int pt_section_set_aliased(struct pt_section *section)
+{
+	if (!section)
+		return -pte_internal;
+
+	section->aliased = 1;
+
+	return 0;
+}
+
 enum {
 	/* The number of test sections. */
 	num_sections	= 8,
@@ -724,6 +763,16 @@ static struct ptunit_result add_file_null(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result set_share_null(void)
+{
+	int errcode;
+
+	errcode = pt_iscache_set_share(NULL, 1);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read_null(void)
 {
 	struct pt_image_section_cache iscache;
@@ -742,6 +791,16 @@ static struct ptunit_result read_null(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result get_file_null(void)
+{
+	int errcode;
+
+	errcode = pt_iscache_get_file(NULL, 1, NULL, NULL, NULL, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result init_fini(struct iscache_fixture *cfix)
 {
 	(void) cfix;
@@ -1161,6 +1220,127 @@ add_file_different_same_laddr(struct iscache_fixture *cfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result add_file_share(struct iscache_fixture *cfix)
+{
+	int isid[2], errcode;
+
+	errcode = pt_iscache_set_share(&cfix->iscache, 1);
+	ptu_int_eq(errcode, 0);
+
+	isid[0] = pt_iscache_add_file(&cfix->iscache, "root-a/name", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[0], 0);
+
+	isid[1] = pt_iscache_add_file(&cfix->iscache, "root-b/name", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[1], 0);
+
+	/* The second add should be ignored. */
+	ptu_int_eq(isid[1], isid[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+add_file_share_different_laddr(struct iscache_fixture *cfix)
+{
+	struct pt_section *section[2];
+	uint64_t laddr;
+	int isid[2], errcode;
+
+	errcode = pt_iscache_set_share(&cfix->iscache, 1);
+	ptu_int_eq(errcode, 0);
+
+	isid[0] = pt_iscache_add_file(&cfix->iscache, "root-a/name", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[0], 0);
+
+	isid[1] = pt_iscache_add_file(&cfix->iscache, "root-b/name", 0ull, 1ull,
+				      1ull);
+	ptu_int_gt(isid[1], 0);
+
+	/* We must get different identifiers. */
+	ptu_int_ne(isid[1], isid[0]);
+
+	/* We must share the section. */
+	errcode = pt_iscache_lookup(&cfix->iscache, &section[0], &laddr,
+				    isid[0]);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(laddr, 0ull);
+
+	errcode = pt_iscache_lookup(&cfix->iscache, &section[1], &laddr,
+				    isid[1]);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(laddr, 1ull);
+
+	ptu_ptr_eq(section[1], section[0]);
+	ptu_str_eq(pt_section_filename(section[1]), "root-a/name");
+	ptu_int_ne(section[0]->aliased, 0);
+
+	errcode = pt_section_put(section[0]);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_section_put(section[1]);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result
+add_file_share_different_file(struct iscache_fixture *cfix)
+{
+	int isid[2], errcode;
+
+	errcode = pt_iscache_set_share(&cfix->iscache, 1);
+	ptu_int_eq(errcode, 0);
+
+	isid[0] = pt_iscache_add_file(&cfix->iscache, "root/name-a", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[0], 0);
+
+	isid[1] = pt_iscache_add_file(&cfix->iscache, "root/name-b", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[1], 0);
+
+	/* We must get different identifiers. */
+	ptu_int_ne(isid[1], isid[0]);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_file_no_share(struct iscache_fixture *cfix)
+{
+	int isid[2], idx;
+
+	isid[0] = pt_iscache_add_file(&cfix->iscache, "root-a/name", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[0], 0);
+
+	isid[1] = pt_iscache_add_file(&cfix->iscache, "root-b/name", 0ull, 1ull,
+				      0ull);
+	ptu_int_gt(isid[1], 0);
+
+	/* Without sharing, we must get different identifiers. */
+	ptu_int_ne(isid[1], isid[0]);
+
+	/* Neither section is shared between file names. */
+	for (idx = 0; idx < 2; ++idx) {
+		struct pt_section *section;
+		uint64_t laddr;
+		int errcode;
+
+		errcode = pt_iscache_lookup(&cfix->iscache, &section, &laddr,
+					    isid[idx]);
+		ptu_int_eq(errcode, 0);
+		ptu_int_eq(section->aliased, 0);
+
+		errcode = pt_section_put(section);
+		ptu_int_eq(errcode, 0);
+	}
+
+	return ptu_passed();
+}
+
 static struct ptunit_result read(struct iscache_fixture *cfix)
 {
 	uint8_t buffer[] = { 0xcc, 0xcc, 0xcc };
@@ -1226,6 +1406,67 @@ static struct ptunit_result read_bad_isid(struct iscache_fixture *cfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result get_file(struct iscache_fixture *cfix)
+{
+	const char *filename;
+	uint64_t offset, size, vaddr;
+	int status, isid;
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[1], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	status = pt_iscache_get_file(&cfix->iscache, isid, &filename, &offset,
+				     &size, &vaddr);
+	ptu_int_eq(status, 0);
+	ptu_str_eq(filename, cfix->section[1]->filename);
+	ptu_uint_eq(offset, cfix->section[1]->offset);
+	ptu_uint_eq(size, cfix->section[1]->size);
+	ptu_uint_eq(vaddr, 0xa000ull);
+
+	/* We must not keep a reference. */
+	ptu_int_eq(cfix->section[1]->ucount, 2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_file_partial(struct iscache_fixture *cfix)
+{
+	uint64_t size;
+	int status, isid;
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[0], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	status = pt_iscache_get_file(&cfix->iscache, isid, NULL, NULL, &size,
+				     NULL);
+	ptu_int_eq(status, 0);
+	ptu_uint_eq(size, cfix->section[0]->size);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_file_bad_isid(struct iscache_fixture *cfix)
+{
+	const char *filename;
+	int status, isid;
+
+	isid = pt_iscache_add(&cfix->iscache, cfix->section[0], 0xa000ull);
+	ptu_int_gt(isid, 0);
+
+	filename = NULL;
+	status = pt_iscache_get_file(&cfix->iscache, isid + 1, &filename, NULL,
+				     NULL, NULL);
+	ptu_int_eq(status, -pte_bad_image);
+	ptu_null(filename);
+
+	status = pt_iscache_get_file(&cfix->iscache, 0, &filename, NULL, NULL,
+				     NULL);
+	ptu_int_eq(status, -pte_bad_image);
+	ptu_null(filename);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result lru_map(struct iscache_fixture *cfix)
 {
 	int status, isid;
@@ -1969,7 +2210,9 @@ int main(int argc, char **argv)
 	ptu_run(suite, clear_null);
 	ptu_run(suite, free_null);
 	ptu_run(suite, add_file_null);
+	ptu_run(suite, set_share_null);
 	ptu_run(suite, read_null);
+	ptu_run(suite, get_file_null);
 
 	ptu_run_f(suite, name, dfix);
 	ptu_run_f(suite, name_none, dfix);
@@ -2003,12 +2246,20 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, add_file_same, cfix);
 	ptu_run_f(suite, add_file_same_different_laddr, cfix);
 	ptu_run_f(suite, add_file_different_same_laddr, cfix);
+	ptu_run_f(suite, add_file_share, cfix);
+	ptu_run_f(suite, add_file_share_different_laddr, cfix);
+	ptu_run_f(suite, add_file_share_different_file, cfix);
+	ptu_run_f(suite, add_file_no_share, cfix);
 
 	ptu_run_f(suite, read, cfix);
 	ptu_run_f(suite, read_truncate, cfix);
 	ptu_run_f(suite, read_bad_vaddr, cfix);
 	ptu_run_f(suite, read_bad_isid, cfix);
 
+	ptu_run_f(suite, get_file, cfix);
+	ptu_run_f(suite, get_file_partial, cfix);
+	ptu_run_f(suite, get_file_bad_isid, cfix);
+
 	ptu_run_f(suite, lru_map, cfix);
 	ptu_run_f(suite, lru_read, cfix);
 	ptu_run_f(suite, lru_map_nodup, cfix);
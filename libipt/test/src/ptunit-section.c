@@ -361,6 +361,19 @@ static struct ptunit_result cache_null(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result aliased_null(void)
+{
+	int errcode;
+
+	errcode = pt_section_set_aliased(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pt_section_aliased(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result get_overflow(struct section_fixture *sfix)
 {
 	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
@@ -532,6 +545,29 @@ static struct ptunit_result get_put(struct section_fixture *sfix)
 	return ptu_passed();
 }
 
+static struct ptunit_result aliased(struct section_fixture *sfix)
+{
+	uint8_t bytes[] = { 0xcc, 0x2, 0x4, 0x6 };
+	int status;
+
+	sfix_write(sfix, bytes);
+
+	status = pt_mk_section(&sfix->section, sfix->name, 0x1ull, 0x3ull);
+	ptu_int_eq(status, 0);
+	ptu_ptr(sfix->section);
+
+	status = pt_section_aliased(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_set_aliased(sfix->section);
+	ptu_int_eq(status, 0);
+
+	status = pt_section_aliased(sfix->section);
+	ptu_int_gt(status, 0);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result attach_detach(struct section_fixture *sfix)
 {
 	struct pt_image_section_cache iscache;
@@ -1420,6 +1456,7 @@ int main(int argc, char **argv)
 	ptu_run(suite, map_null);
 	ptu_run(suite, unmap_null);
 	ptu_run(suite, cache_null);
+	ptu_run(suite, aliased_null);
 
 	ptu_run_f(suite, get_overflow, sfix);
 	ptu_run_f(suite, attach_overflow, sfix);
@@ -1429,6 +1466,7 @@ int main(int argc, char **argv)
 	ptu_run_f(suite, unmap_nomap, sfix);
 	ptu_run_f(suite, map_overflow, sfix);
 	ptu_run_f(suite, get_put, sfix);
+	ptu_run_f(suite, aliased, sfix);
 	ptu_run_f(suite, attach_detach, sfix);
 	ptu_run_f(suite, attach_bad_iscache, sfix);
 	ptu_run_f(suite, detach_bad_iscache, sfix);
@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_segment.h"
+#include "pt_encoder.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture providing a segment iterator operating on a small buffer. */
+struct test_fixture {
+	/* The segment iterator. */
+	struct pt_segment_iterator iterator;
+
+	/* The encoder used for preparing the trace. */
+	struct pt_encoder encoder;
+
+	/* The configuration. */
+	struct pt_config config;
+
+	/* The buffer it operates on. */
+	uint8_t buffer[256];
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct test_fixture *tfix);
+	struct ptunit_result (*fini)(struct test_fixture *tfix);
+};
+
+static struct ptunit_result tfix_init(struct test_fixture *tfix)
+{
+	struct pt_config *config;
+	uint8_t *buffer;
+	int errcode;
+
+	config = &tfix->config;
+	buffer = tfix->buffer;
+
+	memset(buffer, 0, sizeof(tfix->buffer));
+
+	pt_config_init(config);
+	config->begin = buffer;
+	config->end = buffer + sizeof(tfix->buffer);
+
+	errcode = pt_encoder_init(&tfix->encoder, config);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tfix_fini(struct test_fixture *tfix)
+{
+	pt_seg_iterator_fini(&tfix->iterator);
+	pt_encoder_fini(&tfix->encoder);
+
+	return ptu_passed();
+}
+
+/* Finish encoding and initialize the iterator on the encoded trace. */
+static struct ptunit_result tfix_start(struct test_fixture *tfix)
+{
+	struct pt_config *config;
+	uint64_t offset;
+	int errcode;
+
+	errcode = pt_enc_get_offset(&tfix->encoder, &offset);
+	ptu_int_eq(errcode, 0);
+
+	config = &tfix->config;
+	config->end = config->begin + offset;
+
+	errcode = pt_seg_iterator_init(&tfix->iterator, config);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Encode a small PSB+ and provide its offset in @offset. */
+static struct ptunit_result tfix_psb(struct test_fixture *tfix,
+				     uint64_t *offset)
+{
+	struct pt_encoder *encoder;
+	int errcode;
+
+	encoder = &tfix->encoder;
+
+	errcode = pt_enc_get_offset(encoder, offset);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_encode_psb(encoder);
+	ptu_int_ge(errcode, 0);
+
+	errcode = pt_encode_mode_exec(encoder, ptem_64bit);
+	ptu_int_ge(errcode, 0);
+
+	errcode = pt_encode_psbend(encoder);
+	ptu_int_ge(errcode, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result iterator_init_null(void)
+{
+	struct pt_segment_iterator iterator;
+	struct pt_config config;
+	int errcode;
+
+	memset(&config, 0, sizeof(config));
+
+	errcode = pt_seg_iterator_init(NULL, &config);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_seg_iterator_init(&iterator, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result iterator_fini_null(void)
+{
+	pt_seg_iterator_fini(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_iterator_null(void)
+{
+	struct pt_segment_iterator *iterator;
+
+	iterator = pt_seg_alloc_iterator(NULL);
+	ptu_null(iterator);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_iterator_null(void)
+{
+	pt_seg_free_iterator(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev_null(void)
+{
+	struct pt_segment_iterator iterator;
+	struct pt_segment segment;
+	int errcode;
+
+	errcode = pt_seg_prev(NULL, &segment, sizeof(segment));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_seg_prev(&iterator, NULL, sizeof(segment));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev_small_size(struct test_fixture *tfix)
+{
+	struct pt_segment segment;
+	uint64_t sync;
+	int errcode;
+
+	ptu_test(tfix_psb, tfix, &sync);
+	ptu_test(tfix_start, tfix);
+
+	segment.end = 0xcdull;
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment,
+			      sizeof(segment.begin));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(segment.begin, sync);
+	ptu_uint_eq(segment.end, 0xcdull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev_big_size(struct test_fixture *tfix)
+{
+	struct {
+		struct pt_segment segment;
+		uint64_t extra;
+	} buffer;
+	uint64_t sync, end;
+	int errcode;
+
+	ptu_test(tfix_psb, tfix, &sync);
+	ptu_test(tfix_start, tfix);
+
+	end = (uint64_t) (tfix->config.end - tfix->config.begin);
+
+	memset(&buffer, 0xcd, sizeof(buffer));
+
+	errcode = pt_seg_prev(&tfix->iterator, &buffer.segment,
+			      sizeof(buffer));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(buffer.segment.begin, sync);
+	ptu_uint_eq(buffer.segment.end, end);
+	ptu_uint_eq(buffer.extra, 0ull);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev_empty(struct test_fixture *tfix)
+{
+	struct pt_segment segment;
+	int errcode;
+
+	ptu_test(tfix_start, tfix);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev_nosync(struct test_fixture *tfix)
+{
+	struct pt_segment segment;
+	int errcode;
+
+	errcode = pt_encode_pad(&tfix->encoder);
+	ptu_int_ge(errcode, 0);
+
+	errcode = pt_encode_mode_exec(&tfix->encoder, ptem_64bit);
+	ptu_int_ge(errcode, 0);
+
+	ptu_test(tfix_start, tfix);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result prev(struct test_fixture *tfix)
+{
+	struct pt_segment segment;
+	uint64_t sync[3], end;
+	int errcode;
+
+	/* Put some trace before the first PSB.  It is not provided. */
+	errcode = pt_encode_mode_exec(&tfix->encoder, ptem_64bit);
+	ptu_int_ge(errcode, 0);
+
+	ptu_test(tfix_psb, tfix, &sync[0]);
+	ptu_test(tfix_psb, tfix, &sync[1]);
+
+	errcode = pt_encode_pad(&tfix->encoder);
+	ptu_int_ge(errcode, 0);
+
+	ptu_test(tfix_psb, tfix, &sync[2]);
+
+	errcode = pt_encode_pad(&tfix->encoder);
+	ptu_int_ge(errcode, 0);
+
+	ptu_test(tfix_start, tfix);
+
+	end = (uint64_t) (tfix->config.end - tfix->config.begin);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(segment.begin, sync[2]);
+	ptu_uint_eq(segment.end, end);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(segment.begin, sync[1]);
+	ptu_uint_eq(segment.end, sync[2]);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(segment.begin, sync[0]);
+	ptu_uint_eq(segment.end, sync[1]);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = pt_seg_prev(&tfix->iterator, &segment, sizeof(segment));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct test_fixture tfix;
+	struct ptunit_suite suite;
+
+	tfix.init = tfix_init;
+	tfix.fini = tfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, iterator_init_null);
+	ptu_run(suite, iterator_fini_null);
+	ptu_run(suite, alloc_iterator_null);
+	ptu_run(suite, free_iterator_null);
+	ptu_run(suite, prev_null);
+
+	ptu_run_f(suite, prev_small_size, tfix);
+	ptu_run_f(suite, prev_big_size, tfix);
+	ptu_run_f(suite, prev_empty, tfix);
+	ptu_run_f(suite, prev_nosync, tfix);
+	ptu_run_f(suite, prev, tfix);
+
+	return ptunit_report(&suite);
+}
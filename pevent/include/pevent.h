@@ -140,6 +140,71 @@ struct pev_record_switch_cpu_wide {
 	uint32_t next_prev_tid;
 };
 
+/* Record types synthesized by perf in perf.data files.
+ *
+ * They are not part of the perf_event ABI and do not carry samples.
+ */
+enum {
+	PEV_RECORD_USER_TYPE_START	= 64,
+	PEV_RECORD_FINISHED_ROUND	= 68,
+	PEV_RECORD_AUXTRACE_INFO	= 70,
+	PEV_RECORD_AUXTRACE		= 71,
+	PEV_RECORD_TIME_CONV		= 79
+};
+
+/* The AUXTRACE_INFO perf.data record. */
+struct pev_record_auxtrace_info {
+	uint32_t type;
+	uint32_t reserved;
+	uint64_t priv[];
+};
+
+/* The AUXTRACE_INFO type for Intel PT. */
+enum {
+	PEV_AUXTRACE_INTEL_PT		= 1
+};
+
+/* The entries in the @priv array of an Intel PT AUXTRACE_INFO record. */
+enum pev_intel_pt_info {
+	pev_intel_pt_pmu_type,
+	pev_intel_pt_time_shift,
+	pev_intel_pt_time_mult,
+	pev_intel_pt_time_zero,
+	pev_intel_pt_cap_user_time_zero,
+	pev_intel_pt_tsc_bit,
+	pev_intel_pt_noretcomp_bit,
+	pev_intel_pt_have_sched_switch,
+	pev_intel_pt_snapshot_mode,
+	pev_intel_pt_per_cpu_mmaps,
+	pev_intel_pt_mtc_bit,
+	pev_intel_pt_mtc_freq_bits,
+	pev_intel_pt_tsc_ctc_n,
+	pev_intel_pt_tsc_ctc_d,
+	pev_intel_pt_cyc_bit,
+	pev_intel_pt_max_nonturbo_ratio
+};
+
+/* The AUXTRACE perf.data record.
+ *
+ * It is followed by @size bytes of AUX area data.
+ */
+struct pev_record_auxtrace {
+	uint64_t size;
+	uint64_t offset;
+	uint64_t reference;
+	uint32_t idx;
+	uint32_t tid;
+	uint32_t cpu;
+	uint32_t reserved;
+};
+
+/* The TIME_CONV perf.data record. */
+struct pev_record_time_conv {
+	uint64_t time_shift;
+	uint64_t time_mult;
+	uint64_t time_zero;
+};
+
 /* A perf event record. */
 struct pev_event {
 	/* The record type (enum perf_event_type). */
@@ -182,6 +247,15 @@ struct pev_event {
 
 		/* @type = PERF_RECORD_SWITCH_CPU_WIDE. */
 		const struct pev_record_switch_cpu_wide *switch_cpu_wide;
+
+		/* @type = PEV_RECORD_AUXTRACE_INFO. */
+		const struct pev_record_auxtrace_info *auxtrace_info;
+
+		/* @type = PEV_RECORD_AUXTRACE. */
+		const struct pev_record_auxtrace *auxtrace;
+
+		/* @type = PEV_RECORD_TIME_CONV. */
+		const struct pev_record_time_conv *time_conv;
 	} record;
 
 	/* The additional samples. */
@@ -243,18 +317,81 @@ extern int pev_time_from_tsc(uint64_t *time, uint64_t tsc,
  *
  * Reads one perf_event record from [@begin; @end[ into @event.
  *
+ * Records synthesized by perf in perf.data files are read without samples.  The
+ * size of an AUXTRACE record includes the AUX area data following it.
+ *
  * Returns the number of bytes read on success, a negative error code otherwise.
  * Returns -pte_bad_config if @config->size is too small.
  * Returns -pte_eos if the event does not fit into [@begin; @end[.
  * Returns -pte_internal if @event, @config, @begin, or @end is NULL.
+ * Returns -pte_overflow if the AUX area data of an AUXTRACE record is too big.
  */
 extern int pev_read(struct pev_event *event, const uint8_t *begin,
 		    const uint8_t *end, const struct pev_config *config);
 
+/* A perf_event sample reader plan.
+ *
+ * The layout of the samples attached to each record is fixed by the
+ * configuration's sample_type.  A plan holds the layout and the time
+ * conversion parameters so they need not be derived again for each record.
+ */
+struct pev_plan {
+	/* The offset of each sample field from the beginning of the samples
+	 * in bytes or -1 if the field is not sampled.
+	 */
+	int8_t tid;
+	int8_t time;
+	int8_t id;
+	int8_t stream_id;
+	int8_t cpu;
+	int8_t identifier;
+
+	/* The size of all samples in bytes. */
+	uint8_t size;
+
+	/* The respective fields in struct pev_config. */
+	uint16_t time_shift;
+	uint32_t time_mult;
+	uint64_t time_zero;
+
+	/* Relative times below this limit can be shifted without overflow
+	 * and converted to TSC using a single division.
+	 */
+	uint64_t time_limit;
+};
+
+/* Initialize a perf_event sample reader plan.
+ *
+ * Compiles @config into @plan for use with pev_read_plan().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_config if @config->size is too small.
+ * Returns -pte_bad_config if time is sampled and @config->time_mult is zero.
+ * Returns -pte_internal if @plan or @config is NULL.
+ */
+extern int pev_plan_init(struct pev_plan *plan,
+			 const struct pev_config *config);
+
+/* Read a perf_event record using a precompiled plan.
+ *
+ * Same as pev_read() but reads samples according to @plan.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ * Returns -pte_eos if the event does not fit into [@begin; @end[.
+ * Returns -pte_internal if @event, @plan, @begin, or @end is NULL.
+ */
+extern int pev_read_plan(struct pev_event *event, const uint8_t *begin,
+			 const uint8_t *end, const struct pev_plan *plan);
+
 /* Write a perf_event record.
  *
  * Writes @event into [@begin; @end[.
  *
+ * Records synthesized by perf are written without samples.  For AUXTRACE
+ * records, the caller writes the AUX area data following the record.
+ * AUXTRACE_INFO records are written with the private data entries in enum
+ * pev_intel_pt_info for Intel PT and without private data for other types.
+ *
  * Returns the number of bytes written on success, a negative error code
  * otherwise.
  * Returns -pte_bad_config if @config->size is too small.
@@ -265,4 +402,67 @@ extern int pev_read(struct pev_event *event, const uint8_t *begin,
 extern int pev_write(const struct pev_event *event, uint8_t *begin,
 		     uint8_t *end, const struct pev_config *config);
 
+
+/* The perf.data file format.
+ *
+ * A perf.data file starts with a header that describes the location of its
+ * sections.  The attrs section holds the perf_event_attr of each recorded
+ * event.  The data section holds the perf event records, including records
+ * synthesized by perf and the AUX area trace in AUXTRACE records.
+ */
+#define PEV_FILE_MAGIC	0x32454c4946524550ull
+
+/* A section in a perf.data file. */
+struct pev_file_section {
+	uint64_t offset;
+	uint64_t size;
+};
+
+/* The perf.data file header. */
+struct pev_file_header {
+	uint64_t magic;
+	uint64_t size;
+	uint64_t attr_size;
+	struct pev_file_section attrs;
+	struct pev_file_section data;
+	struct pev_file_section event_types;
+	uint64_t features[4];
+};
+
+/* A perf.data file in memory. */
+struct pev_file {
+	/* The perf event records in the file's data section. */
+	const uint8_t *begin, *end;
+
+	/* The perf event configuration shared by all recorded events.
+	 *
+	 * This provides the sample_type and the time conversion parameters.
+	 */
+	struct pev_config config;
+
+	/* The Intel PT AUXTRACE_INFO record or NULL if there is none. */
+	const struct pev_record_auxtrace_info *auxtrace_info;
+
+	/* The number of entries in @auxtrace_info->priv. */
+	uint32_t auxtrace_info_size;
+};
+
+/* Initialize a perf.data file.
+ *
+ * Parses the perf.data file in [@begin; @end[ into @file.
+ *
+ * The sample_type is taken from the recorded events' perf_event_attr.  The
+ * time conversion parameters are taken from the TIME_CONV or the Intel PT
+ * AUXTRACE_INFO record preceding the first perf event record.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_file if [@begin; @end[ is not a perf.data file.
+ * Returns -pte_eos if a section does not fit into [@begin; @end[.
+ * Returns -pte_internal if @file, @begin, or @end is NULL.
+ * Returns -pte_not_supported if recorded events use different sample_id
+ *                            layouts.
+ */
+extern int pev_file_init(struct pev_file *file, const uint8_t *begin,
+			 const uint8_t *end);
+
 #endif /* PEVENT_H */
@@ -28,6 +28,8 @@
 
 #include "pevent.h"
 
+#include <limits.h>
+
 
 #define pev_config_has(config, field) \
 	(config->size >= (offsetof(struct pev_config, field) + \
@@ -118,73 +120,204 @@ static int pev_strlen(const char *begin, const void *end_arg)
 	return -pte_bad_packet;
 }
 
-static int pev_read_samples(struct pev_event *event, const uint8_t *begin,
-			    const uint8_t *end, const struct pev_config *config)
+static int8_t pev_plan_field(int8_t *poffset, uint64_t sample_type,
+			     uint64_t field)
+{
+	int8_t offset;
+
+	if (!(sample_type & field))
+		return -1;
+
+	offset = *poffset;
+	*poffset += 8;
+
+	return offset;
+}
+
+int pev_plan_init(struct pev_plan *plan, const struct pev_config *config)
 {
-	const uint8_t *pos;
 	uint64_t sample_type;
+	int8_t offset;
 
-	if (!event || !begin || !config)
+	if (!plan || !config)
 		return -pte_internal;
 
 	if (!pev_config_has(config, sample_type))
 		return -pte_bad_config;
 
+	memset(plan, 0, sizeof(*plan));
+
 	sample_type = config->sample_type;
-	pos = begin;
+	offset = 0;
+
+	/* The order of fields is defined by the perf_event ABI. */
+	plan->tid = pev_plan_field(&offset, sample_type, PERF_SAMPLE_TID);
+	plan->time = pev_plan_field(&offset, sample_type, PERF_SAMPLE_TIME);
+	plan->id = pev_plan_field(&offset, sample_type, PERF_SAMPLE_ID);
+	plan->stream_id = pev_plan_field(&offset, sample_type,
+					 PERF_SAMPLE_STREAM_ID);
+	plan->cpu = pev_plan_field(&offset, sample_type, PERF_SAMPLE_CPU);
+	plan->identifier = pev_plan_field(&offset, sample_type,
+					  PERF_SAMPLE_IDENTIFIER);
+	plan->size = (uint8_t) offset;
+
+	if (plan->time < 0)
+		return 0;
 
-	if (sample_type & PERF_SAMPLE_TID) {
-		event->sample.pid = (const uint32_t *) &pos[0];
-		event->sample.tid = (const uint32_t *) &pos[4];
-		pos += 8;
-	}
+	if (!pev_config_has(config, time_zero))
+		return -pte_bad_config;
 
-	if (sample_type & PERF_SAMPLE_TIME) {
-		int errcode;
+	if (!config->time_mult)
+		return -pte_bad_config;
 
-		event->sample.time = (const uint64_t *) pos;
-		pos += 8;
+	plan->time_shift = config->time_shift;
+	plan->time_mult = config->time_mult;
+	plan->time_zero = config->time_zero;
 
-		/* We're reading the time.  Let's make sure the pointer lies
-		 * inside the buffer.
-		 */
-		if (end < pos)
-			return -pte_nosync;
+	if (plan->time_shift < 64)
+		plan->time_limit = UINT64_MAX >> plan->time_shift;
 
-		errcode = pev_time_to_tsc(&event->sample.tsc,
-					  *event->sample.time, config);
-		if (errcode < 0)
-			return errcode;
-	}
+	return 0;
+}
 
-	if (sample_type & PERF_SAMPLE_ID) {
-		event->sample.id = (const uint64_t *) pos;
-		pos += 8;
-	}
+static uint64_t pev_plan_time_to_tsc(const struct pev_plan *plan,
+				     uint64_t time)
+{
+	uint64_t quot, rem;
 
-	if (sample_type & PERF_SAMPLE_STREAM_ID) {
-		event->sample.stream_id = (const uint64_t *) pos;
-		pos += 8;
+	time -= plan->time_zero;
+
+	/* This gives the same result as pev_time_to_tsc() as long as we do
+	 * not lose bits when shifting.
+	 */
+	if (time < plan->time_limit)
+		return (time << plan->time_shift) / plan->time_mult;
+
+	quot = time / plan->time_mult;
+	rem = time % plan->time_mult;
+
+	quot <<= plan->time_shift;
+	rem <<= plan->time_shift;
+	rem /= plan->time_mult;
+
+	return quot + rem;
+}
+
+static int pev_read_samples(struct pev_event *event, const uint8_t *begin,
+			    const uint8_t *end, const struct pev_plan *plan)
+{
+	if (!event || !begin || !end || !plan)
+		return -pte_internal;
+
+	/* The samples must fit into the remainder of the record. */
+	if ((end < begin) || ((size_t) (end - begin) < plan->size))
+		return -pte_nosync;
+
+	if (plan->tid >= 0) {
+		event->sample.pid = (const uint32_t *) &begin[plan->tid];
+		event->sample.tid = (const uint32_t *) &begin[plan->tid + 4];
 	}
 
-	if (sample_type & PERF_SAMPLE_CPU) {
-		event->sample.cpu = (const uint32_t *) pos;
-		pos += 8;
+	if (plan->time >= 0) {
+		event->sample.time = (const uint64_t *) &begin[plan->time];
+		event->sample.tsc = pev_plan_time_to_tsc(plan,
+							 *event->sample.time);
 	}
 
-	if (sample_type & PERF_SAMPLE_IDENTIFIER) {
-		event->sample.identifier = (const uint64_t *) pos;
-		pos += 8;
+	if (plan->id >= 0)
+		event->sample.id = (const uint64_t *) &begin[plan->id];
+
+	if (plan->stream_id >= 0)
+		event->sample.stream_id =
+			(const uint64_t *) &begin[plan->stream_id];
+
+	if (plan->cpu >= 0)
+		event->sample.cpu = (const uint32_t *) &begin[plan->cpu];
+
+	if (plan->identifier >= 0)
+		event->sample.identifier =
+			(const uint64_t *) &begin[plan->identifier];
+
+	return (int) plan->size;
+}
+
+/* Read a record synthesized by perf.
+ *
+ * The record @header at @begin has been validated against @end.  The AUX area
+ * data following an AUXTRACE record must fit into [@begin; @limit[.
+ *
+ * Returns the number of bytes read on success, a negative error code otherwise.
+ */
+static int pev_read_user_event(struct pev_event *event, const uint8_t *begin,
+			       const uint8_t *limit)
+{
+	const struct perf_event_header *header;
+	const uint8_t *pos, *end;
+
+	if (!event || !begin || limit < begin)
+		return -pte_internal;
+
+	header = (const struct perf_event_header *) begin;
+	if (header->size < sizeof(*header))
+		return -pte_bad_packet;
+
+	pos = begin + sizeof(*header);
+	end = begin + header->size;
+
+	switch (event->type) {
+	default:
+		break;
+
+	case PEV_RECORD_AUXTRACE_INFO:
+		if (end < (pos + sizeof(*event->record.auxtrace_info)))
+			return -pte_bad_packet;
+
+		event->record.auxtrace_info =
+			(const struct pev_record_auxtrace_info *) pos;
+		break;
+
+	case PEV_RECORD_TIME_CONV:
+		if (end < (pos + sizeof(*event->record.time_conv)))
+			return -pte_bad_packet;
+
+		event->record.time_conv =
+			(const struct pev_record_time_conv *) pos;
+		break;
+
+	case PEV_RECORD_AUXTRACE: {
+		const struct pev_record_auxtrace *auxtrace;
+		uint64_t size;
+
+		if (end < (pos + sizeof(*auxtrace)))
+			return -pte_bad_packet;
+
+		auxtrace = (const struct pev_record_auxtrace *) pos;
+
+		/* The AUX area data follows the record. */
+		size = auxtrace->size;
+		if ((uint64_t) (INT_MAX - header->size) < size)
+			return -pte_overflow;
+
+		size += header->size;
+		if ((uint64_t) (limit - begin) < size)
+			return -pte_eos;
+
+		event->record.auxtrace = auxtrace;
+
+		return (int) size;
+	}
 	}
 
-	return (int) (pos - begin);
+	return (int) header->size;
 }
 
-int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
-	     const struct pev_config *config)
+static int pev_read_event(struct pev_event *event, const uint8_t *begin,
+			  const uint8_t *end, const struct pev_config *config,
+			  const struct pev_plan *plan)
 {
 	const struct perf_event_header *header;
-	const uint8_t *pos;
+	struct pev_plan local;
+	const uint8_t *pos, *limit;
 	int size;
 
 	if (!event || !begin || end < begin)
@@ -201,6 +334,7 @@ int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 		return -pte_eos;
 
 	/* Stay within the packet. */
+	limit = end;
 	end = begin + header->size;
 
 	memset(event, 0, sizeof(*event));
@@ -208,6 +342,9 @@ int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 	event->type = header->type;
 	event->misc = header->misc;
 
+	if (PEV_RECORD_USER_TYPE_START <= event->type)
+		return pev_read_user_event(event, begin, limit);
+
 	switch (event->type) {
 	default:
 		/* We don't provide samples.
@@ -314,7 +451,18 @@ int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 		break;
 	}
 
-	size = pev_read_samples(event, pos, end, config);
+	/* Compile @config on the fly if we were not given a plan. */
+	if (!plan) {
+		int errcode;
+
+		errcode = pev_plan_init(&local, config);
+		if (errcode < 0)
+			return errcode;
+
+		plan = &local;
+	}
+
+	size = pev_read_samples(event, pos, end, plan);
 	if (size < 0)
 		return size;
 
@@ -329,6 +477,21 @@ int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
 	return size;
 }
 
+int pev_read(struct pev_event *event, const uint8_t *begin, const uint8_t *end,
+	     const struct pev_config *config)
+{
+	return pev_read_event(event, begin, end, config, NULL);
+}
+
+int pev_read_plan(struct pev_event *event, const uint8_t *begin,
+		  const uint8_t *end, const struct pev_plan *plan)
+{
+	if (!plan)
+		return -pte_internal;
+
+	return pev_read_event(event, begin, end, NULL, plan);
+}
+
 static size_t sample_size(const struct pev_event *event)
 {
 	size_t size;
@@ -452,6 +615,77 @@ static int write_samples(uint8_t **stream, const struct pev_event *event,
 	return 0;
 }
 
+/* Write a record synthesized by perf.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ */
+static int pev_write_user_event(const struct pev_event *event, uint8_t *begin,
+				uint8_t *end)
+{
+	struct perf_event_header header;
+	const void *record;
+	uint8_t *pos;
+	size_t size;
+
+	if (!event || !begin || end < begin)
+		return -pte_internal;
+
+	header.type = event->type;
+	header.misc = event->misc;
+
+	switch (header.type) {
+	default:
+		return -pte_bad_opc;
+
+	case PEV_RECORD_FINISHED_ROUND:
+		record = NULL;
+		size = 0;
+		break;
+
+	case PEV_RECORD_AUXTRACE_INFO: {
+		const struct pev_record_auxtrace_info *info;
+
+		info = event->record.auxtrace_info;
+
+		record = info;
+		size = sizeof(*info);
+
+		/* We only know the size of the Intel PT private data. */
+		if (info && (info->type == PEV_AUXTRACE_INTEL_PT))
+			size += (pev_intel_pt_max_nonturbo_ratio + 1) *
+				sizeof(info->priv[0]);
+	}
+		break;
+
+	case PEV_RECORD_AUXTRACE:
+		record = event->record.auxtrace;
+		size = sizeof(*event->record.auxtrace);
+		break;
+
+	case PEV_RECORD_TIME_CONV:
+		record = event->record.time_conv;
+		size = sizeof(*event->record.time_conv);
+		break;
+	}
+
+	if (size && !record)
+		return -pte_bad_packet;
+
+	size += sizeof(header);
+	header.size = (uint16_t) size;
+
+	pos = begin;
+	if (end < pos + header.size)
+		return -pte_eos;
+
+	write(&pos, &header, sizeof(header));
+	if (record)
+		write(&pos, record, size - sizeof(header));
+
+	return (int) (pos - begin);
+}
+
 int pev_write(const struct pev_event *event, uint8_t *begin, uint8_t *end,
 	      const struct pev_config *config)
 {
@@ -463,6 +697,9 @@ int pev_write(const struct pev_event *event, uint8_t *begin, uint8_t *end,
 	if (!event || !begin || end < begin)
 		return -pte_internal;
 
+	if (PEV_RECORD_USER_TYPE_START <= event->type)
+		return pev_write_user_event(event, begin, end);
+
 	pos = begin;
 	size = sizeof(header) + sample_size(event);
 	if (UINT16_MAX < size)
@@ -674,3 +911,202 @@ int pev_write(const struct pev_event *event, uint8_t *begin, uint8_t *end,
 
 	return (int) (pos - begin);
 }
+
+/* The sample types that determine the layout of sample_id. */
+#define PEV_SAMPLE_ID_MASK						\
+	((uint64_t) (PERF_SAMPLE_TID | PERF_SAMPLE_TIME |		\
+		     PERF_SAMPLE_ID | PERF_SAMPLE_STREAM_ID |		\
+		     PERF_SAMPLE_CPU | PERF_SAMPLE_IDENTIFIER))
+
+static int pev_file_section(const uint8_t **pbegin, const uint8_t **pend,
+			    const struct pev_file_section *section,
+			    const uint8_t *begin, const uint8_t *end)
+{
+	uint64_t size;
+
+	if (!pbegin || !pend || !section || !begin || end < begin)
+		return -pte_internal;
+
+	size = (uint64_t) (end - begin);
+	if ((size < section->offset) || ((size - section->offset) <
+					 section->size))
+		return -pte_eos;
+
+	*pbegin = begin + section->offset;
+	*pend = *pbegin + section->size;
+
+	return 0;
+}
+
+static int pev_file_sample_type(uint64_t *sample_type,
+				const struct pev_file_header *header,
+				const uint8_t *begin, const uint8_t *end)
+{
+	const uint8_t *pos, *last;
+	uint64_t attr_size;
+	int errcode, found;
+
+	if (!sample_type || !header)
+		return -pte_internal;
+
+	errcode = pev_file_section(&pos, &last, &header->attrs, begin, end);
+	if (errcode < 0)
+		return errcode;
+
+	attr_size = header->attr_size;
+	if (attr_size < (PERF_ATTR_SIZE_VER0 + sizeof(struct pev_file_section)))
+		return -pte_bad_file;
+
+	*sample_type = 0ull;
+
+	/* Only events with sample_id_all contribute samples to the sideband
+	 * records.  They must all agree on the layout since we can't tell
+	 * which event a record belongs to before reading its samples.
+	 */
+	found = 0;
+	for (; attr_size <= (uint64_t) (last - pos); pos += attr_size) {
+		struct perf_event_attr attr;
+		uint64_t size, type;
+
+		size = attr_size - sizeof(struct pev_file_section);
+		if (sizeof(attr) < size)
+			size = sizeof(attr);
+
+		memset(&attr, 0, sizeof(attr));
+		memcpy(&attr, pos, (size_t) size);
+
+		if (!attr.sample_id_all)
+			continue;
+
+		type = attr.sample_type & PEV_SAMPLE_ID_MASK;
+		if (found && (type != *sample_type))
+			return -pte_not_supported;
+
+		*sample_type = type;
+		found = 1;
+	}
+
+	return 0;
+}
+
+static void pev_file_time_conv(struct pev_config *config, uint64_t time_shift,
+			       uint64_t time_mult, uint64_t time_zero)
+{
+	config->time_shift = (uint16_t) time_shift;
+	config->time_mult = (uint32_t) time_mult;
+	config->time_zero = time_zero;
+}
+
+int pev_file_init(struct pev_file *file, const uint8_t *begin,
+		  const uint8_t *end)
+{
+	const struct pev_file_header *header;
+	const uint8_t *pos;
+	int errcode, time_conv;
+
+	if (!file || !begin || end < begin)
+		return -pte_internal;
+
+	if ((size_t) (end - begin) < sizeof(*header))
+		return -pte_bad_file;
+
+	header = (const struct pev_file_header *) begin;
+	if ((header->magic != PEV_FILE_MAGIC) ||
+	    (header->size < sizeof(*header)))
+		return -pte_bad_file;
+
+	memset(file, 0, sizeof(*file));
+	pev_config_init(&file->config);
+
+	errcode = pev_file_sample_type(&file->config.sample_type, header,
+				       begin, end);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pev_file_section(&file->begin, &file->end, &header->data,
+				   begin, end);
+	if (errcode < 0)
+		return errcode;
+
+	/* Perf synthesizes the records describing the recording before the
+	 * first round of perf event records.  We prefer TIME_CONV over the
+	 * copy in the Intel PT AUXTRACE_INFO.
+	 */
+	time_conv = 0;
+	for (pos = file->begin; pos < file->end;) {
+		const struct perf_event_header *record;
+		struct pev_event event;
+		int size;
+
+		if ((size_t) (file->end - pos) < sizeof(*record))
+			break;
+
+		record = (const struct perf_event_header *) pos;
+		if ((record->type == PEV_RECORD_FINISHED_ROUND) ||
+		    (record->type == PEV_RECORD_AUXTRACE))
+			break;
+
+		/* Skip perf event records without reading their samples; we
+		 * don't know how to convert their time, yet.
+		 */
+		if (record->type < PEV_RECORD_USER_TYPE_START) {
+			if (!record->size)
+				return -pte_bad_packet;
+
+			pos += record->size;
+			continue;
+		}
+
+		size = pev_read(&event, pos, file->end, &file->config);
+		if (size < 0)
+			return size;
+
+		pos += size;
+
+		switch (event.type) {
+		case PEV_RECORD_TIME_CONV: {
+			const struct pev_record_time_conv *conv;
+
+			conv = event.record.time_conv;
+			pev_file_time_conv(&file->config, conv->time_shift,
+					   conv->time_mult, conv->time_zero);
+
+			time_conv = 1;
+		}
+			break;
+
+		case PEV_RECORD_AUXTRACE_INFO: {
+			const struct pev_record_auxtrace_info *info;
+			uint32_t nprivs;
+
+			info = event.record.auxtrace_info;
+			if (info->type != PEV_AUXTRACE_INTEL_PT)
+				break;
+
+			nprivs = (uint32_t) ((size - sizeof(*record) -
+					      sizeof(*info)) /
+					     sizeof(info->priv[0]));
+
+			file->auxtrace_info = info;
+			file->auxtrace_info_size = nprivs;
+
+			if (time_conv || (nprivs <= pev_intel_pt_time_zero))
+				break;
+
+			pev_file_time_conv(&file->config,
+					   info->priv[pev_intel_pt_time_shift],
+					   info->priv[pev_intel_pt_time_mult],
+					   info->priv[pev_intel_pt_time_zero]);
+		}
+			break;
+
+		default:
+			break;
+		}
+
+		if (time_conv && file->auxtrace_info)
+			break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pevent.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+
+/* The benchmark configuration. */
+struct bench_options {
+	/* The number of records in the synthetic stream. */
+	uint32_t nrecords;
+
+	/* The number of times the stream is read. */
+	uint32_t nrounds;
+};
+
+/* The samples attached to each synthetic record. */
+struct bench_samples {
+	uint32_t pid, tid;
+	uint64_t time;
+	uint32_t cpu;
+	uint64_t identifier;
+};
+
+/* A synthetic perf_event stream. */
+struct bench_stream {
+	/* The stream in memory. */
+	uint8_t *begin, *end;
+
+	/* The number of records in the stream. */
+	uint32_t nrecords;
+};
+
+static int usage(const char *prog)
+{
+	printf("usage: %s [<options>]\n\n", prog);
+	printf("options:\n");
+	printf("  --help|-h            this text.\n");
+	printf("  --records <n>        generate <n> records.\n");
+	printf("                       (default: 1000000)\n");
+	printf("  --rounds <n>         read the stream <n> times.\n");
+	printf("                       (default: 10)\n");
+
+	return 1;
+}
+
+static int parse_uint32(uint32_t *value, const char *arg)
+{
+	char *rest;
+	unsigned long val;
+
+	if (!value || !arg)
+		return -pte_internal;
+
+	errno = 0;
+	val = strtoul(arg, &rest, 0);
+	if (errno || *rest || !val || (UINT32_MAX < val))
+		return -pte_invalid;
+
+	*value = (uint32_t) val;
+	return 0;
+}
+
+static void bench_config(struct pev_config *config)
+{
+	pev_config_init(config);
+	config->sample_type |= (uint64_t) PERF_SAMPLE_TID;
+	config->sample_type |= (uint64_t) PERF_SAMPLE_TIME;
+	config->sample_type |= (uint64_t) PERF_SAMPLE_CPU;
+	config->sample_type |= (uint64_t) PERF_SAMPLE_IDENTIFIER;
+	config->time_shift = 10;
+	config->time_mult = 643;
+	config->time_zero = 0x1000ull;
+}
+
+static int bench_mk_event(struct pev_event *event, uint32_t index,
+			  uint8_t *scratch)
+{
+	if (!event || !scratch)
+		return -pte_internal;
+
+	/* Mimic a typical system-wide trace: mostly context switches with
+	 * the occasional process creation and exec.
+	 */
+	switch (index % 16) {
+	case 0: {
+		struct pev_record_mmap2 *mmap2;
+
+		mmap2 = (struct pev_record_mmap2 *) scratch;
+		memset(mmap2, 0, sizeof(*mmap2));
+		mmap2->pid = index;
+		mmap2->tid = index;
+		mmap2->addr = 0x400000ull;
+		mmap2->len = 0x1000ull;
+		strcpy(mmap2->filename, "/usr/lib/libbench.so");
+
+		event->type = PERF_RECORD_MMAP2;
+		event->record.mmap2 = mmap2;
+	}
+		return 0;
+
+	case 1: {
+		struct pev_record_comm *comm;
+
+		comm = (struct pev_record_comm *) scratch;
+		memset(comm, 0, sizeof(*comm));
+		comm->pid = index;
+		comm->tid = index;
+		strcpy(comm->comm, "bench");
+
+		event->type = PERF_RECORD_COMM;
+		event->record.comm = comm;
+	}
+		return 0;
+
+	case 2: {
+		struct pev_record_fork *fork;
+
+		fork = (struct pev_record_fork *) scratch;
+		memset(fork, 0, sizeof(*fork));
+		fork->pid = index;
+		fork->tid = index;
+
+		event->type = PERF_RECORD_FORK;
+		event->record.fork = fork;
+	}
+		return 0;
+
+	case 3: {
+		struct pev_record_itrace_start *itrace_start;
+
+		itrace_start = (struct pev_record_itrace_start *) scratch;
+		memset(itrace_start, 0, sizeof(*itrace_start));
+		itrace_start->pid = index;
+		itrace_start->tid = index;
+
+		event->type = PERF_RECORD_ITRACE_START;
+		event->record.itrace_start = itrace_start;
+	}
+		return 0;
+
+	default: {
+		struct pev_record_switch_cpu_wide *switch_cpu_wide;
+
+		switch_cpu_wide = (struct pev_record_switch_cpu_wide *) scratch;
+		memset(switch_cpu_wide, 0, sizeof(*switch_cpu_wide));
+		switch_cpu_wide->next_prev_pid = index;
+		switch_cpu_wide->next_prev_tid = index;
+
+		event->type = PERF_RECORD_SWITCH_CPU_WIDE;
+		event->misc = (index & 1) ? PERF_RECORD_MISC_SWITCH_OUT : 0;
+		event->record.switch_cpu_wide = switch_cpu_wide;
+	}
+		return 0;
+	}
+}
+
+static int bench_mk_stream(struct bench_stream *stream, uint32_t nrecords,
+			   const struct pev_config *config)
+{
+	struct bench_samples samples;
+	uint64_t scratch[16];
+	uint8_t *begin, *pos, *end;
+	size_t size;
+	uint32_t index;
+
+	if (!stream || !config)
+		return -pte_internal;
+
+	/* No record we generate is bigger than this. */
+	size = (size_t) nrecords * 128;
+
+	begin = malloc(size);
+	if (!begin)
+		return -pte_nomem;
+
+	pos = begin;
+	end = begin + size;
+
+	for (index = 0; index < nrecords; ++index) {
+		struct pev_event event;
+		int errcode;
+
+		pev_event_init(&event);
+
+		errcode = bench_mk_event(&event, index, (uint8_t *) scratch);
+		if (errcode < 0) {
+			free(begin);
+			return errcode;
+		}
+
+		samples.pid = index;
+		samples.tid = index;
+		samples.time = config->time_zero + ((uint64_t) index * 1000);
+		samples.cpu = index % 8;
+		samples.identifier = 1;
+
+		event.sample.pid = &samples.pid;
+		event.sample.tid = &samples.tid;
+		event.sample.time = &samples.time;
+		event.sample.cpu = &samples.cpu;
+		event.sample.identifier = &samples.identifier;
+
+		errcode = pev_write(&event, pos, end, config);
+		if (errcode < 0) {
+			free(begin);
+			return errcode;
+		}
+
+		pos += errcode;
+	}
+
+	stream->begin = begin;
+	stream->end = pos;
+	stream->nrecords = nrecords;
+
+	return 0;
+}
+
+/* Read @stream once either using @config or using @plan.
+ *
+ * Provides the sum of all TSC samples in @sum.
+ */
+static int bench_read(uint64_t *sum, const struct bench_stream *stream,
+		      const struct pev_config *config,
+		      const struct pev_plan *plan)
+{
+	const uint8_t *pos;
+	uint64_t tsc;
+
+	if (!sum || !stream)
+		return -pte_internal;
+
+	tsc = 0ull;
+	for (pos = stream->begin; pos < stream->end;) {
+		struct pev_event event;
+		int size;
+
+		if (plan)
+			size = pev_read_plan(&event, pos, stream->end, plan);
+		else
+			size = pev_read(&event, pos, stream->end, config);
+		if (size < 0)
+			return size;
+
+		tsc += event.sample.tsc;
+		pos += size;
+	}
+
+	*sum = tsc;
+	return 0;
+}
+
+static int bench_run(const char *name, const struct bench_stream *stream,
+		     const struct pev_config *config,
+		     const struct pev_plan *plan,
+		     const struct bench_options *options)
+{
+	clock_t begin, end;
+	uint64_t sum;
+	double seconds, nrecords;
+	uint32_t round;
+
+	if (!stream || !options)
+		return -pte_internal;
+
+	sum = 0ull;
+	begin = clock();
+	for (round = 0; round < options->nrounds; ++round) {
+		int errcode;
+
+		errcode = bench_read(&sum, stream, config, plan);
+		if (errcode < 0)
+			return errcode;
+	}
+	end = clock();
+
+	seconds = (double) (end - begin) / CLOCKS_PER_SEC;
+	nrecords = (double) stream->nrecords * options->nrounds;
+
+	printf("%-10s %8.3f s  %8.2f ns/record  (sum: %" PRIx64 ")\n", name,
+	       seconds, seconds ? ((seconds * 1e9) / nrecords) : 0.0, sum);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options options;
+	struct bench_stream stream;
+	struct pev_config config;
+	struct pev_plan plan;
+	int idx, errcode;
+
+	options.nrecords = 1000000;
+	options.nrounds = 10;
+
+	for (idx = 1; idx < argc; ++idx) {
+		const char *arg;
+
+		arg = argv[idx];
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+			return usage(argv[0]);
+
+		if (strcmp(arg, "--records") == 0) {
+			if (argc <= ++idx)
+				return usage(argv[0]);
+
+			errcode = parse_uint32(&options.nrecords, argv[idx]);
+			if (errcode < 0)
+				return usage(argv[0]);
+
+			continue;
+		}
+
+		if (strcmp(arg, "--rounds") == 0) {
+			if (argc <= ++idx)
+				return usage(argv[0]);
+
+			errcode = parse_uint32(&options.nrounds, argv[idx]);
+			if (errcode < 0)
+				return usage(argv[0]);
+
+			continue;
+		}
+
+		fprintf(stderr, "%s: unknown option: %s.\n", argv[0], arg);
+		return 1;
+	}
+
+	bench_config(&config);
+
+	errcode = pev_plan_init(&plan, &config);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to compile plan: %d.\n", argv[0],
+			errcode);
+		return 1;
+	}
+
+	errcode = bench_mk_stream(&stream, options.nrecords, &config);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to generate stream: %d.\n",
+			argv[0], errcode);
+		return 1;
+	}
+
+	printf("%" PRIu32 " records, %zu bytes, %" PRIu32 " rounds\n",
+	       stream.nrecords, (size_t) (stream.end - stream.begin),
+	       options.nrounds);
+
+	errcode = bench_run("pev_read", &stream, &config, NULL, &options);
+	if (errcode >= 0)
+		errcode = bench_run("pev_plan", &stream, NULL, &plan,
+				    &options);
+
+	free(stream.begin);
+
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to read stream: %d.\n", argv[0],
+			errcode);
+		return 1;
+	}
+
+	return 0;
+}
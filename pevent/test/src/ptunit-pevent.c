@@ -369,6 +369,194 @@ static struct ptunit_result write_bad_config(void)
 	return ptu_passed();
 }
 
+static struct ptunit_result plan_init_null(void)
+{
+	struct pev_config config;
+	struct pev_plan plan;
+	int errcode;
+
+	pev_config_init(&config);
+
+	errcode = pev_plan_init(NULL, &config);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pev_plan_init(&plan, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result plan_init_bad_config(void)
+{
+	struct pev_config config;
+	struct pev_plan plan;
+	int errcode;
+
+	memset(&config, 0, sizeof(config));
+	config.sample_type |= (uint64_t) PERF_SAMPLE_CPU;
+
+	errcode = pev_plan_init(&plan, &config);
+	ptu_int_eq(errcode, -pte_bad_config);
+
+	config.size = sizeof(config);
+	config.sample_type |= (uint64_t) PERF_SAMPLE_TIME;
+	config.time_mult = 0;
+
+	errcode = pev_plan_init(&plan, &config);
+	ptu_int_eq(errcode, -pte_bad_config);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result plan_init(void)
+{
+	struct pev_config config;
+	struct pev_plan plan;
+	int errcode;
+
+	pev_config_init(&config);
+	config.sample_type |= (uint64_t) PERF_SAMPLE_TID;
+	config.sample_type |= (uint64_t) PERF_SAMPLE_TIME;
+	config.sample_type |= (uint64_t) PERF_SAMPLE_CPU;
+	config.sample_type |= (uint64_t) PERF_SAMPLE_IDENTIFIER;
+	config.time_shift = 4;
+	config.time_mult = 3;
+	config.time_zero = 0xa00b00ull;
+
+	errcode = pev_plan_init(&plan, &config);
+	ptu_int_eq(errcode, 0);
+	ptu_int_eq(plan.tid, 0);
+	ptu_int_eq(plan.time, 8);
+	ptu_int_eq(plan.id, -1);
+	ptu_int_eq(plan.stream_id, -1);
+	ptu_int_eq(plan.cpu, 16);
+	ptu_int_eq(plan.identifier, 24);
+	ptu_uint_eq(plan.size, 32);
+	ptu_uint_eq(plan.time_shift, config.time_shift);
+	ptu_uint_eq(plan.time_mult, config.time_mult);
+	ptu_uint_eq(plan.time_zero, config.time_zero);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_plan_null(void)
+{
+	struct pev_event event;
+	uint8_t buffer[16];
+	int errcode;
+
+	memset(buffer, 0, sizeof(buffer));
+
+	errcode = pev_read_plan(&event, buffer, buffer + sizeof(buffer),
+				NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_plan_time(uint64_t time)
+{
+	struct pev_record_exit exit;
+	struct pev_config config;
+	struct pev_event event[2];
+	struct pev_plan plan;
+	uint8_t buffer[128];
+	uint64_t tsc;
+	int size, errcode;
+
+	pev_config_init(&config);
+	config.sample_type |= (uint64_t) PERF_SAMPLE_TIME;
+	config.time_shift = 10;
+	config.time_mult = 643;
+	config.time_zero = 0x1000ull;
+
+	memset(&exit, 0, sizeof(exit));
+
+	pev_event_init(&event[0]);
+	event[0].type = PERF_RECORD_EXIT;
+	event[0].record.exit = &exit;
+	event[0].sample.time = &time;
+
+	size = pev_write(&event[0], buffer, buffer + sizeof(buffer), &config);
+	ptu_int_gt(size, 0);
+
+	errcode = pev_plan_init(&plan, &config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pev_read_plan(&event[1], buffer, buffer + sizeof(buffer),
+				&plan);
+	ptu_int_eq(errcode, size);
+
+	errcode = pev_time_to_tsc(&tsc, time, &config);
+	ptu_int_eq(errcode, 0);
+
+	ptu_ptr(event[1].sample.time);
+	ptu_uint_eq(*event[1].sample.time, time);
+	ptu_uint_eq(event[1].sample.tsc, tsc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_plan(struct pev_fixture *pfix)
+{
+	struct pev_record_fork fork;
+	struct pev_event event;
+	struct pev_plan plan;
+	uint8_t *begin, *end;
+	int size, errcode;
+
+	memset(&fork, 0xab, sizeof(fork));
+
+	pfix->event[0].record.fork = &fork;
+	pfix->event[0].type = PERF_RECORD_FORK;
+
+	ptu_test(pfix_read_write, pfix);
+	ptu_test(pfix_check_sample, pfix);
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	errcode = pev_plan_init(&plan, &pfix->config);
+	ptu_int_eq(errcode, 0);
+
+	size = pev_read_plan(&event, begin, end, &plan);
+	ptu_int_gt(size, 0);
+
+	ptu_int_eq(memcmp(&event, &pfix->event[1], sizeof(event)), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_plan_nosync(void)
+{
+	union {
+		struct perf_event_header header;
+		uint8_t buffer[128];
+	} input;
+	struct pev_config config;
+	struct pev_event event;
+	struct pev_plan plan;
+	int errcode;
+
+	memset(input.buffer, 0, sizeof(input.buffer));
+	input.header.type = PERF_RECORD_ITRACE_START;
+	input.header.size = sizeof(input.header) +
+		sizeof(*event.record.itrace_start) + 0x8;
+
+	pev_config_init(&config);
+	config.sample_type |= (uint64_t) PERF_SAMPLE_TID;
+	config.sample_type |= (uint64_t) PERF_SAMPLE_CPU;
+
+	errcode = pev_plan_init(&plan, &config);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pev_read_plan(&event, input.buffer,
+				input.buffer + sizeof(input.buffer), &plan);
+	ptu_int_eq(errcode, -pte_nosync);
+
+	return ptu_passed();
+}
+
 static struct ptunit_result bad_string(uint16_t type)
 {
 	union {
@@ -735,6 +923,400 @@ static struct ptunit_result switch_cpu_wide(struct pev_fixture *pfix,
 	return ptu_passed();
 }
 
+static struct ptunit_result time_conv(struct pev_fixture *pfix)
+{
+	struct pev_record_time_conv conv;
+
+	conv.time_shift = 0xaull;
+	conv.time_mult = 0x1234ull;
+	conv.time_zero = 0xa0b0c0d0ull;
+
+	pfix->event[0].record.time_conv = &conv;
+	pfix->event[0].type = PEV_RECORD_TIME_CONV;
+
+	ptu_test(pfix_read_write, pfix);
+
+	ptu_int_eq(pfix->event[1].type, pfix->event[0].type);
+	ptu_null(pfix->event[1].sample.time);
+	ptu_null(pfix->event[1].sample.pid);
+	ptu_null(pfix->event[1].sample.cpu);
+	ptu_ptr(pfix->event[1].record.time_conv);
+	ptu_uint_eq(pfix->event[1].record.time_conv->time_shift,
+		    conv.time_shift);
+	ptu_uint_eq(pfix->event[1].record.time_conv->time_mult,
+		    conv.time_mult);
+	ptu_uint_eq(pfix->event[1].record.time_conv->time_zero,
+		    conv.time_zero);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result auxtrace_info(struct pev_fixture *pfix)
+{
+	const struct pev_record_auxtrace_info *info;
+	struct {
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t priv[pev_intel_pt_max_nonturbo_ratio + 1];
+	} buffer;
+	uint8_t *begin, *end;
+	int size;
+
+	memset(&buffer, 0, sizeof(buffer));
+	buffer.type = PEV_AUXTRACE_INTEL_PT;
+	buffer.priv[pev_intel_pt_time_mult] = 0x1234ull;
+	buffer.priv[pev_intel_pt_max_nonturbo_ratio] = 0x28ull;
+
+	pfix->event[0].record.auxtrace_info =
+		(const struct pev_record_auxtrace_info *) &buffer;
+	pfix->event[0].type = PEV_RECORD_AUXTRACE_INFO;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) + sizeof(buffer));
+
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) + sizeof(buffer));
+
+	ptu_int_eq(pfix->event[1].type, pfix->event[0].type);
+	ptu_null(pfix->event[1].sample.time);
+
+	info = pfix->event[1].record.auxtrace_info;
+	ptu_ptr(info);
+	ptu_uint_eq(info->type, PEV_AUXTRACE_INTEL_PT);
+	ptu_uint_eq(info->priv[pev_intel_pt_time_mult], 0x1234ull);
+	ptu_uint_eq(info->priv[pev_intel_pt_max_nonturbo_ratio], 0x28ull);
+
+	/* We do not know the private data of other types. */
+	buffer.type = PEV_AUXTRACE_INTEL_PT + 1;
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) +
+		   sizeof(struct pev_record_auxtrace_info));
+
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) +
+		   sizeof(struct pev_record_auxtrace_info));
+
+	info = pfix->event[1].record.auxtrace_info;
+	ptu_ptr(info);
+	ptu_uint_eq(info->type, PEV_AUXTRACE_INTEL_PT + 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result finished_round(struct pev_fixture *pfix)
+{
+	pfix->event[0].type = PEV_RECORD_FINISHED_ROUND;
+
+	ptu_test(pfix_read_write, pfix);
+
+	ptu_int_eq(pfix->event[1].type, pfix->event[0].type);
+	ptu_null(pfix->event[1].sample.time);
+	ptu_null(pfix->event[1].sample.pid);
+	ptu_null(pfix->event[1].sample.cpu);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result auxtrace(struct pev_fixture *pfix)
+{
+	struct pev_record_auxtrace auxtrace;
+	uint8_t *begin, *end;
+	int size;
+
+	memset(&auxtrace, 0, sizeof(auxtrace));
+	auxtrace.size = 0x10ull;
+	auxtrace.offset = 0x2000ull;
+	auxtrace.reference = 0xf00ull;
+	auxtrace.idx = 2;
+	auxtrace.tid = 0xa1;
+	auxtrace.cpu = 3;
+
+	pfix->event[0].record.auxtrace = &auxtrace;
+	pfix->event[0].type = PEV_RECORD_AUXTRACE;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) + sizeof(auxtrace));
+
+	/* The AUX area data follows the record. */
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, sizeof(struct perf_event_header) + sizeof(auxtrace) +
+		   auxtrace.size);
+
+	ptu_int_eq(pfix->event[1].type, pfix->event[0].type);
+	ptu_null(pfix->event[1].sample.time);
+	ptu_ptr(pfix->event[1].record.auxtrace);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->size, auxtrace.size);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->offset, auxtrace.offset);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->reference,
+		    auxtrace.reference);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->idx, auxtrace.idx);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->tid, auxtrace.tid);
+	ptu_uint_eq(pfix->event[1].record.auxtrace->cpu, auxtrace.cpu);
+
+	/* The AUX area data must fit, as well. */
+	end = begin + size - 1;
+
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result auxtrace_overflow(struct pev_fixture *pfix)
+{
+	struct pev_record_auxtrace auxtrace;
+	uint8_t *begin, *end;
+	int size;
+
+	memset(&auxtrace, 0, sizeof(auxtrace));
+	auxtrace.size = UINT64_MAX;
+
+	pfix->event[0].record.auxtrace = &auxtrace;
+	pfix->event[0].type = PEV_RECORD_AUXTRACE;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = pev_write(&pfix->event[0], begin, end, &pfix->config);
+	ptu_int_gt(size, 0);
+
+	size = pev_read(&pfix->event[1], begin, end, &pfix->config);
+	ptu_int_eq(size, -pte_overflow);
+
+	return ptu_passed();
+}
+
+/* A perf.data file for testing. */
+struct pev_test_file {
+	/* The file header. */
+	struct pev_file_header header;
+
+	/* Two attrs, each followed by an empty ids section. */
+	struct {
+		struct perf_event_attr attr;
+		struct pev_file_section ids;
+	} attrs[2];
+
+	/* An Intel PT AUXTRACE_INFO record. */
+	struct {
+		struct perf_event_header header;
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t priv[pev_intel_pt_max_nonturbo_ratio + 1];
+	} info;
+
+	/* A TIME_CONV record. */
+	struct {
+		struct perf_event_header header;
+		struct pev_record_time_conv conv;
+	} conv;
+
+	/* A FINISHED_ROUND record. */
+	struct perf_event_header round;
+};
+
+static void pev_test_file_init(struct pev_test_file *file)
+{
+	uint64_t offset;
+
+	memset(file, 0, sizeof(*file));
+
+	file->header.magic = PEV_FILE_MAGIC;
+	file->header.size = sizeof(file->header);
+	file->header.attr_size = sizeof(file->attrs[0]);
+
+	offset = offsetof(struct pev_test_file, attrs);
+	file->header.attrs.offset = offset;
+	file->header.attrs.size = sizeof(file->attrs);
+
+	offset = offsetof(struct pev_test_file, info);
+	file->header.data.offset = offset;
+	file->header.data.size = sizeof(*file) - offset;
+
+	file->attrs[0].attr.size = sizeof(file->attrs[0].attr);
+	file->attrs[0].attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+		PERF_SAMPLE_TIME | PERF_SAMPLE_CPU;
+	file->attrs[0].attr.sample_id_all = 1;
+
+	file->attrs[1].attr.size = sizeof(file->attrs[1].attr);
+	file->attrs[1].attr.sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
+		PERF_SAMPLE_CPU;
+	file->attrs[1].attr.sample_id_all = 1;
+
+	file->info.header.type = PEV_RECORD_AUXTRACE_INFO;
+	file->info.header.size = sizeof(file->info);
+	file->info.type = PEV_AUXTRACE_INTEL_PT;
+	file->info.priv[pev_intel_pt_time_shift] = 0xa;
+	file->info.priv[pev_intel_pt_time_mult] = 0x123;
+	file->info.priv[pev_intel_pt_time_zero] = 0xfedcull;
+	file->info.priv[pev_intel_pt_tsc_ctc_n] = 0x2;
+
+	file->conv.header.type = PEV_RECORD_TIME_CONV;
+	file->conv.header.size = sizeof(file->conv);
+	file->conv.conv.time_shift = 0xb;
+	file->conv.conv.time_mult = 0x456;
+	file->conv.conv.time_zero = 0xa0b0ull;
+
+	file->round.type = PEV_RECORD_FINISHED_ROUND;
+	file->round.size = sizeof(file->round);
+}
+
+static struct ptunit_result file_init_null(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	errcode = pev_file_init(NULL, begin, end);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pev_file_init(&file, NULL, end);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = pev_file_init(&file, end, begin);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_init_bad_file(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	errcode = pev_file_init(&file, begin, begin + 8);
+	ptu_int_eq(errcode, -pte_bad_file);
+
+	buffer.header.magic += 1;
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, -pte_bad_file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_init_eos(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	buffer.header.data.size += 1;
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_init_sample_type(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	/* Events without sample_id_all don't matter. */
+	buffer.attrs[1].attr.sample_type = PERF_SAMPLE_TIME;
+	buffer.attrs[1].attr.sample_id_all = 0;
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(file.config.sample_type, PERF_SAMPLE_TID |
+		    PERF_SAMPLE_TIME | PERF_SAMPLE_CPU);
+
+	buffer.attrs[1].attr.sample_id_all = 1;
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, -pte_not_supported);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_init(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr_eq(file.begin, &buffer.info);
+	ptu_ptr_eq(file.end, end);
+	ptu_uint_eq(file.config.sample_type, PERF_SAMPLE_TID |
+		    PERF_SAMPLE_TIME | PERF_SAMPLE_CPU);
+	ptu_uint_eq(file.config.time_shift, buffer.conv.conv.time_shift);
+	ptu_uint_eq(file.config.time_mult, buffer.conv.conv.time_mult);
+	ptu_uint_eq(file.config.time_zero, buffer.conv.conv.time_zero);
+	ptu_ptr_eq(file.auxtrace_info, &buffer.info.type);
+	ptu_uint_eq(file.auxtrace_info_size,
+		    pev_intel_pt_max_nonturbo_ratio + 1);
+	ptu_uint_eq(file.auxtrace_info->priv[pev_intel_pt_tsc_ctc_n], 0x2);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result file_init_auxtrace_info(void)
+{
+	struct pev_test_file buffer;
+	struct pev_file file;
+	const uint8_t *begin, *end;
+	int errcode;
+
+	pev_test_file_init(&buffer);
+
+	begin = (const uint8_t *) &buffer;
+	end = begin + sizeof(buffer);
+
+	/* Without TIME_CONV, we use the AUXTRACE_INFO's time conversion. */
+	buffer.conv.header.type = PEV_RECORD_USER_TYPE_START;
+
+	errcode = pev_file_init(&file, begin, end);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(file.config.time_shift, 0xa);
+	ptu_uint_eq(file.config.time_mult, 0x123);
+	ptu_uint_eq(file.config.time_zero, 0xfedcull);
+
+	return ptu_passed();
+}
+
 int main(int argc, char **argv)
 {
 	struct pev_fixture pfix, pfix_time, pfix_who;
@@ -762,6 +1344,17 @@ int main(int argc, char **argv)
 	ptu_run(suite, read_bad_config);
 	ptu_run(suite, write_bad_config);
 
+	ptu_run(suite, plan_init_null);
+	ptu_run(suite, plan_init_bad_config);
+	ptu_run(suite, plan_init);
+	ptu_run(suite, read_plan_null);
+	ptu_run_p(suite, read_plan_time, 0x1234ull);
+	ptu_run_p(suite, read_plan_time, 0xfedcba9876543210ull);
+	ptu_run(suite, read_plan_nosync);
+	ptu_run_f(suite, read_plan, pfix);
+	ptu_run_f(suite, read_plan, pfix_time);
+	ptu_run_f(suite, read_plan, pfix_who);
+
 	ptu_run_p(suite, bad_string, PERF_RECORD_MMAP);
 	ptu_run_p(suite, bad_string, PERF_RECORD_COMM);
 	ptu_run_p(suite, bad_string, PERF_RECORD_MMAP2);
@@ -814,5 +1407,20 @@ int main(int argc, char **argv)
 	ptu_run_fp(suite, switch_cpu_wide, pfix_who, 0);
 	ptu_run_fp(suite, switch_cpu_wide, pfix_who, 1);
 
+	ptu_run_f(suite, time_conv, pfix);
+	ptu_run_f(suite, time_conv, pfix_who);
+	ptu_run_f(suite, auxtrace_info, pfix_time);
+	ptu_run_f(suite, finished_round, pfix_time);
+	ptu_run_f(suite, auxtrace, pfix);
+	ptu_run_f(suite, auxtrace, pfix_who);
+	ptu_run_f(suite, auxtrace_overflow, pfix);
+
+	ptu_run(suite, file_init_null);
+	ptu_run(suite, file_init_bad_file);
+	ptu_run(suite, file_init_eos);
+	ptu_run(suite, file_init_sample_type);
+	ptu_run(suite, file_init);
+	ptu_run(suite, file_init_auxtrace_info);
+
 	return ptunit_report(&suite);
 }
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PTDB_H
+#define PTDB_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+/* The ptdump binary packet stream.
+ *
+ * The stream starts with an eight-byte header:
+ *
+ *   "ptdb"         the magic
+ *   version        one byte, ptdb_version
+ *   reserved       three zero bytes
+ *
+ * followed by one record per packet or diagnostic.  Each record consists of:
+ *
+ *   offset         varint, the zig-zag encoded difference to the previous
+ *                  record's trace offset
+ *   type           one byte, the packet type (enum pt_packet_type)
+ *   flags          one byte, a bit-vector of enum ptdb_flag
+ *
+ * For a diagnostic, i.e. if ptdb_diag is set in flags, this is followed by:
+ *
+ *   errcode        varint, the zig-zag encoded error code
+ *
+ * For a packet, this is followed by:
+ *
+ *   size           one byte, the size of the packet in the trace
+ *   payload        the type-specific packet payload, see ptdb_write()
+ *
+ * Both are followed by the tracking information given in flags:
+ *
+ *   last-ip        varint, the last IP if ptdb_last_ip is set
+ *   tsc            varint, the zig-zag encoded difference to the previous
+ *                  record's TSC if ptdb_tsc is set
+ *
+ * A varint is an unsigned integer in little-endian base 128, i.e. seven bits
+ * per byte with the most significant bit set on all but the last byte.
+ */
+
+enum {
+	/* The size of the stream header in bytes. */
+	ptdb_header_size	= 8,
+
+	/* The format version. */
+	ptdb_version		= 1,
+
+	/* The maximal size of a record in bytes. */
+	ptdb_max_record_size	= 64
+};
+
+/* The record flags. */
+enum ptdb_flag {
+	/* The record is a diagnostic rather than a packet. */
+	ptdb_diag			= 1 << 0,
+
+	/* The record gives the last IP. */
+	ptdb_last_ip			= 1 << 1,
+
+	/* The last IP has been suppressed. */
+	ptdb_last_ip_suppressed		= 1 << 2,
+
+	/* The record gives the estimated TSC. */
+	ptdb_tsc			= 1 << 3
+};
+
+/* A packet or diagnostic record. */
+struct ptdb_record {
+	/* The trace offset. */
+	uint64_t offset;
+
+	/* The packet, unless ptdb_diag is set in @flags. */
+	struct pt_packet packet;
+
+	/* The error code of a diagnostic.  Zero for a warning. */
+	int errcode;
+
+	/* The last IP if ptdb_last_ip is set in @flags. */
+	uint64_t last_ip;
+
+	/* The estimated TSC if ptdb_tsc is set in @flags. */
+	uint64_t tsc;
+
+	/* A bit-vector of enum ptdb_flag. */
+	uint8_t flags;
+};
+
+static inline void ptdb_record_init(struct ptdb_record *record)
+{
+	memset(record, 0, sizeof(*record));
+}
+
+/* The delta encoding state.
+ *
+ * Records are encoded relative to their predecessor.  Reading and writing
+ * a stream each need a state that is passed to consecutive calls.
+ */
+struct ptdb_state {
+	/* The trace offset of the previous record. */
+	uint64_t offset;
+
+	/* The TSC of the last record that gave one. */
+	uint64_t tsc;
+};
+
+static inline void ptdb_state_init(struct ptdb_state *state)
+{
+	memset(state, 0, sizeof(*state));
+}
+
+/* Write the stream header.
+ *
+ * Writes the header into [@begin; @end[.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ * Returns -pte_eos if the header does not fit into [@begin; @end[.
+ * Returns -pte_internal if @begin or @end is NULL.
+ */
+extern int ptdb_write_header(uint8_t *begin, uint8_t *end);
+
+/* Read the stream header.
+ *
+ * Checks the header at @begin.
+ *
+ * Returns the number of bytes read on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_file if [@begin; @end[ does not start with a header.
+ * Returns -pte_eos if the header does not fit into [@begin; @end[.
+ * Returns -pte_internal if @begin or @end is NULL.
+ * Returns -pte_not_supported if the format version is not supported.
+ */
+extern int ptdb_read_header(const uint8_t *begin, const uint8_t *end);
+
+/* Write a record.
+ *
+ * Writes @record into [@begin; @end[ relative to @state and updates @state.
+ * At most ptdb_max_record_size bytes are written.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_packet if @record's packet type is not supported.
+ * Returns -pte_eos if the record does not fit into [@begin; @end[.
+ * Returns -pte_internal if @record, @begin, @end, or @state is NULL.
+ */
+extern int ptdb_write(const struct ptdb_record *record, uint8_t *begin,
+		      uint8_t *end, struct ptdb_state *state);
+
+/* Read a record.
+ *
+ * Reads one record from [@begin; @end[ relative to @state into @record and
+ * updates @state.
+ *
+ * Returns the number of bytes read on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_packet if the record is corrupt.
+ * Returns -pte_eos if the record does not fit into [@begin; @end[.
+ * Returns -pte_internal if @record, @begin, @end, or @state is NULL.
+ */
+extern int ptdb_read(struct ptdb_record *record, const uint8_t *begin,
+		     const uint8_t *end, struct ptdb_state *state);
+
+#endif /* PTDB_H */
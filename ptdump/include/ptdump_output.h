@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PTDUMP_OUTPUT_H
+#define PTDUMP_OUTPUT_H
+
+#include "ptdb.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#if defined(_MSC_VER) && (_MSC_VER < 1900)
+#  define snprintf _snprintf_c
+#endif
+
+
+enum {
+	/* The size of the output buffer. */
+	ptdump_output_size = 1 << 20,
+
+	/* The maximal size of one line of packet output. */
+	ptdump_max_line = 256
+};
+
+/* The output is formatted into a large buffer and written to the output
+ * stream in big chunks instead of going through stdio for every field.
+ */
+struct ptdump_output {
+	/* The output buffer. */
+	char *begin;
+
+	/* The current position in the output buffer. */
+	char *pos;
+
+	/* The end of the output buffer. */
+	char *end;
+
+	/* The stream to which the output buffer is flushed. */
+	FILE *stream;
+
+	/* The number of bytes written to @stream so far. */
+	uint64_t written;
+
+	/* The delta encoding state of the binary packet stream. */
+	struct ptdb_state bin;
+
+	/* Write ptdb records instead of text. */
+	uint32_t binary:1;
+};
+
+/* The text fields of one line of packet output. */
+struct ptdump_buffer {
+	/* The trace offset. */
+	char offset[17];
+
+	/* The raw packet bytes. */
+	char raw[33];
+
+	/* The packet opcode. */
+	char opcode[10];
+
+	union {
+		/* The standard packet payload. */
+		char standard[25];
+
+		/* An extended packet payload. */
+		char extended[48];
+	} payload;
+
+	/* The tracking information. */
+	struct {
+		/* The tracking identifier. */
+		char id[5];
+
+		/* The tracking information. */
+		char payload[17];
+	} tracking;
+
+	/* A flag telling whether an extended payload is used. */
+	uint32_t use_ext_payload:1;
+
+	/* A flag telling whether to skip printing this buffer. */
+	uint32_t skip:1;
+
+	/* A flag telling whether to skip printing the time. */
+	uint32_t skip_time:1;
+
+	/* A flag telling whether to skip printing the calibration. */
+	uint32_t skip_tcal:1;
+};
+
+
+/* Initialize @output for writing to @stream.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int ptdump_output_init(struct ptdump_output *output, FILE *stream);
+
+/* Flush @output and free its buffer.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int ptdump_output_fini(struct ptdump_output *output);
+
+/* Write the buffered output to @output->stream.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int ptdump_flush(struct ptdump_output *output);
+
+/* Make room for at least @size bytes of output.
+ *
+ * The caller writes at most @size bytes starting at the returned position and
+ * then advances @output->pos past what it wrote.
+ *
+ * Returns a pointer to the current output position.
+ */
+extern char *ptdump_reserve(struct ptdump_output *output, size_t size);
+
+/* Format a line of output.
+ *
+ * Lines that do not fit into the output buffer bypass it.
+ */
+extern void ptdump_printf(struct ptdump_output *output, const char *format,
+			  ...);
+
+/* Print @buffer as one line of output.
+ *
+ * Start with the trace offset if @show_offset is set.  This does not look at
+ * the skip flags.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int ptdump_print_buffer(struct ptdump_output *output,
+			       const struct ptdump_buffer *buffer,
+			       int show_offset);
+
+
+/* The lower-case hexadecimal digits. */
+extern const char ptdump_hex_digits[];
+
+/* Format @value in lower-case hexadecimal at @pos.
+ *
+ * Pad the value with leading zeros to @width digits.  There must be room for
+ * 16 digits at @pos.
+ *
+ * Returns a pointer to the end of the formatted value.
+ */
+extern char *fmt_hex(char *pos, uint64_t value, int width);
+
+/* Copy @str to @pos without the terminating zero.
+ *
+ * Returns a pointer to the end of the copied string.
+ */
+extern char *fmt_str(char *pos, const char *str);
+
+/* Copy @field of at most @size characters to @pos and pad it with blanks to
+ * @width characters.
+ *
+ * Returns a pointer to the end of the copied field.
+ */
+extern char *fmt_field(char *pos, const char *field, size_t size,
+		       size_t width);
+
+/* Copy the text in [@begin; @end[ into @field of @size bytes.
+ *
+ * Like snprintf(), truncate the text to fit and zero-terminate @field.
+ */
+extern void set_field(char *field, size_t size, const char *begin,
+		      const char *end);
+
+/* Copy @str into @field of @size bytes like set_field(). */
+extern void set_field_str(char *field, size_t size, const char *str);
+
+/* Format @value into @field of @size bytes like fmt_hex() and set_field(). */
+extern void set_field_hex(char *field, size_t size, uint64_t value,
+			  int width);
+
+#define print_field(field, ...)					\
+	do {							\
+		/* Avoid partial overwrites. */			\
+		memset(field, 0, sizeof(field));		\
+		snprintf(field, sizeof(field), __VA_ARGS__);	\
+	} while (0)
+
+#define print_field_str(field, str)				\
+	set_field_str(field, sizeof(field), str)
+
+#define print_field_hex(field, value, width)			\
+	set_field_hex(field, sizeof(field), value, width)
+
+#define print_field_text(field, text, end)			\
+	set_field(field, sizeof(field), text, end)
+
+#endif /* PTDUMP_OUTPUT_H */
@@ -0,0 +1,554 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptdb.h"
+
+
+static const uint8_t ptdb_magic[4] = { 'p', 't', 'd', 'b' };
+
+static uint64_t ptdb_zigzag(int64_t value)
+{
+	return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static int64_t ptdb_unzigzag(uint64_t value)
+{
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+/* Write @value as varint at *@pos and advance *@pos.
+ *
+ * The caller makes sure there is room for ten bytes.
+ */
+static void ptdb_put_varint(uint8_t **pos, uint64_t value)
+{
+	uint8_t *out;
+
+	out = *pos;
+	while (0x80 <= value) {
+		*out++ = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+
+	*out++ = (uint8_t) value;
+	*pos = out;
+}
+
+static int ptdb_get_varint(uint64_t *value, const uint8_t **pos,
+			   const uint8_t *end)
+{
+	const uint8_t *in;
+	uint64_t result;
+	uint8_t shift;
+
+	in = *pos;
+	result = 0ull;
+	for (shift = 0; shift < 64; shift += 7) {
+		uint8_t byte;
+
+		if (end <= in)
+			return -pte_eos;
+
+		byte = *in++;
+		result |= (uint64_t) (byte & 0x7f) << shift;
+
+		if (!(byte & 0x80)) {
+			*value = result;
+			*pos = in;
+			return 0;
+		}
+	}
+
+	return -pte_bad_packet;
+}
+
+static int ptdb_get_byte(uint8_t *value, const uint8_t **pos,
+			 const uint8_t *end)
+{
+	if (end <= *pos)
+		return -pte_eos;
+
+	*value = *(*pos)++;
+	return 0;
+}
+
+int ptdb_write_header(uint8_t *begin, uint8_t *end)
+{
+	if (!begin || !end)
+		return -pte_internal;
+
+	if ((end - begin) < ptdb_header_size)
+		return -pte_eos;
+
+	memset(begin, 0, ptdb_header_size);
+	memcpy(begin, ptdb_magic, sizeof(ptdb_magic));
+	begin[sizeof(ptdb_magic)] = ptdb_version;
+
+	return ptdb_header_size;
+}
+
+int ptdb_read_header(const uint8_t *begin, const uint8_t *end)
+{
+	if (!begin || !end)
+		return -pte_internal;
+
+	if ((end - begin) < ptdb_header_size)
+		return -pte_eos;
+
+	if (memcmp(begin, ptdb_magic, sizeof(ptdb_magic)) != 0)
+		return -pte_bad_file;
+
+	if (begin[sizeof(ptdb_magic)] != ptdb_version)
+		return -pte_not_supported;
+
+	return ptdb_header_size;
+}
+
+static int ptdb_write_payload(uint8_t **pos, const struct pt_packet *packet)
+{
+	uint8_t *out;
+
+	out = *pos;
+	switch (packet->type) {
+	case ppt_invalid:
+	case ppt_unknown:
+	case ppt_pad:
+	case ppt_psb:
+	case ppt_psbend:
+	case ppt_stop:
+	case ppt_ovf:
+		return 0;
+
+	case ppt_fup:
+	case ppt_tip:
+	case ppt_tip_pge:
+	case ppt_tip_pgd:
+		*out++ = (uint8_t) packet->payload.ip.ipc;
+		ptdb_put_varint(&out, packet->payload.ip.ip);
+		break;
+
+	case ppt_tnt_8:
+	case ppt_tnt_64:
+		*out++ = packet->payload.tnt.bit_size;
+		ptdb_put_varint(&out, packet->payload.tnt.payload);
+		break;
+
+	case ppt_mode:
+		*out++ = (uint8_t) packet->payload.mode.leaf;
+		switch (packet->payload.mode.leaf) {
+		case pt_mol_exec:
+			*out++ = (uint8_t) (packet->payload.mode.bits.exec.csl |
+					    (packet->payload.mode.bits.exec.csd
+					     << 1));
+			break;
+
+		case pt_mol_tsx:
+			*out++ = (uint8_t) (packet->payload.mode.bits.tsx.intx |
+					    (packet->payload.mode.bits.tsx.abrt
+					     << 1));
+			break;
+
+		default:
+			*out++ = 0;
+			break;
+		}
+		break;
+
+	case ppt_pip:
+		*out++ = (uint8_t) packet->payload.pip.nr;
+		ptdb_put_varint(&out, packet->payload.pip.cr3);
+		break;
+
+	case ppt_vmcs:
+		ptdb_put_varint(&out, packet->payload.vmcs.base);
+		break;
+
+	case ppt_cbr:
+		*out++ = packet->payload.cbr.ratio;
+		break;
+
+	case ppt_tsc:
+		ptdb_put_varint(&out, packet->payload.tsc.tsc);
+		break;
+
+	case ppt_tma:
+		ptdb_put_varint(&out, packet->payload.tma.ctc);
+		ptdb_put_varint(&out, packet->payload.tma.fc);
+		break;
+
+	case ppt_mtc:
+		*out++ = packet->payload.mtc.ctc;
+		break;
+
+	case ppt_cyc:
+		ptdb_put_varint(&out, packet->payload.cyc.value);
+		break;
+
+	case ppt_mnt:
+		ptdb_put_varint(&out, packet->payload.mnt.payload);
+		break;
+
+	case ppt_exstop:
+		*out++ = (uint8_t) packet->payload.exstop.ip;
+		break;
+
+	case ppt_mwait:
+		ptdb_put_varint(&out, packet->payload.mwait.hints);
+		ptdb_put_varint(&out, packet->payload.mwait.ext);
+		break;
+
+	case ppt_pwre:
+		*out++ = packet->payload.pwre.state;
+		*out++ = packet->payload.pwre.sub_state;
+		*out++ = (uint8_t) packet->payload.pwre.hw;
+		break;
+
+	case ppt_pwrx:
+		*out++ = packet->payload.pwrx.last;
+		*out++ = packet->payload.pwrx.deepest;
+		*out++ = (uint8_t) (packet->payload.pwrx.interrupt |
+				    (packet->payload.pwrx.store << 1) |
+				    (packet->payload.pwrx.autonomous << 2));
+		break;
+
+	case ppt_ptw:
+		*out++ = packet->payload.ptw.plc;
+		*out++ = (uint8_t) packet->payload.ptw.ip;
+		ptdb_put_varint(&out, packet->payload.ptw.payload);
+		break;
+
+	default:
+		return -pte_bad_packet;
+	}
+
+	*pos = out;
+	return 0;
+}
+
+int ptdb_write(const struct ptdb_record *record, uint8_t *begin,
+	       uint8_t *end, struct ptdb_state *state)
+{
+	uint8_t buffer[ptdb_max_record_size], *pos;
+	size_t size;
+	int errcode;
+
+	if (!record || !begin || !end || !state)
+		return -pte_internal;
+
+	/* We encode into a local buffer so we only need to check for room
+	 * once.
+	 */
+	pos = buffer;
+	ptdb_put_varint(&pos, ptdb_zigzag((int64_t) (record->offset -
+						     state->offset)));
+
+	if (record->flags & ptdb_diag) {
+		*pos++ = 0;
+		*pos++ = record->flags;
+
+		ptdb_put_varint(&pos, ptdb_zigzag(record->errcode));
+	} else {
+		*pos++ = (uint8_t) record->packet.type;
+		*pos++ = record->flags;
+		*pos++ = record->packet.size;
+
+		errcode = ptdb_write_payload(&pos, &record->packet);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (record->flags & ptdb_last_ip)
+		ptdb_put_varint(&pos, record->last_ip);
+
+	if (record->flags & ptdb_tsc)
+		ptdb_put_varint(&pos, ptdb_zigzag((int64_t) (record->tsc -
+							     state->tsc)));
+
+	size = (size_t) (pos - buffer);
+	if ((size_t) (end - begin) < size)
+		return -pte_eos;
+
+	memcpy(begin, buffer, size);
+
+	state->offset = record->offset;
+	if (record->flags & ptdb_tsc)
+		state->tsc = record->tsc;
+
+	return (int) size;
+}
+
+static int ptdb_read_payload(struct pt_packet *packet, const uint8_t **pos,
+			     const uint8_t *end)
+{
+	uint64_t value;
+	uint8_t byte;
+	int errcode;
+
+	switch (packet->type) {
+	case ppt_invalid:
+	case ppt_unknown:
+	case ppt_pad:
+	case ppt_psb:
+	case ppt_psbend:
+	case ppt_stop:
+	case ppt_ovf:
+		return 0;
+
+	case ppt_fup:
+	case ppt_tip:
+	case ppt_tip_pge:
+	case ppt_tip_pgd:
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.ip.ipc = (enum pt_ip_compression) byte;
+
+		return ptdb_get_varint(&packet->payload.ip.ip, pos, end);
+
+	case ppt_tnt_8:
+	case ppt_tnt_64:
+		errcode = ptdb_get_byte(&packet->payload.tnt.bit_size, pos,
+					end);
+		if (errcode < 0)
+			return errcode;
+
+		return ptdb_get_varint(&packet->payload.tnt.payload, pos, end);
+
+	case ppt_mode:
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.mode.leaf = (enum pt_mode_leaf) byte;
+
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		switch (packet->payload.mode.leaf) {
+		case pt_mol_exec:
+			packet->payload.mode.bits.exec.csl = byte & 1;
+			packet->payload.mode.bits.exec.csd = (byte >> 1) & 1;
+			break;
+
+		case pt_mol_tsx:
+			packet->payload.mode.bits.tsx.intx = byte & 1;
+			packet->payload.mode.bits.tsx.abrt = (byte >> 1) & 1;
+			break;
+		}
+
+		return 0;
+
+	case ppt_pip:
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.pip.nr = byte & 1;
+
+		return ptdb_get_varint(&packet->payload.pip.cr3, pos, end);
+
+	case ppt_vmcs:
+		return ptdb_get_varint(&packet->payload.vmcs.base, pos, end);
+
+	case ppt_cbr:
+		return ptdb_get_byte(&packet->payload.cbr.ratio, pos, end);
+
+	case ppt_tsc:
+		return ptdb_get_varint(&packet->payload.tsc.tsc, pos, end);
+
+	case ppt_tma:
+		errcode = ptdb_get_varint(&value, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.tma.ctc = (uint16_t) value;
+
+		errcode = ptdb_get_varint(&value, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.tma.fc = (uint16_t) value;
+		return 0;
+
+	case ppt_mtc:
+		return ptdb_get_byte(&packet->payload.mtc.ctc, pos, end);
+
+	case ppt_cyc:
+		return ptdb_get_varint(&packet->payload.cyc.value, pos, end);
+
+	case ppt_mnt:
+		return ptdb_get_varint(&packet->payload.mnt.payload, pos, end);
+
+	case ppt_exstop:
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.exstop.ip = byte & 1;
+		return 0;
+
+	case ppt_mwait:
+		errcode = ptdb_get_varint(&value, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.mwait.hints = (uint32_t) value;
+
+		errcode = ptdb_get_varint(&value, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.mwait.ext = (uint32_t) value;
+		return 0;
+
+	case ppt_pwre:
+		errcode = ptdb_get_byte(&packet->payload.pwre.state, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_get_byte(&packet->payload.pwre.sub_state, pos,
+					end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.pwre.hw = byte & 1;
+		return 0;
+
+	case ppt_pwrx:
+		errcode = ptdb_get_byte(&packet->payload.pwrx.last, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_get_byte(&packet->payload.pwrx.deepest, pos,
+					end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.pwrx.interrupt = byte & 1;
+		packet->payload.pwrx.store = (byte >> 1) & 1;
+		packet->payload.pwrx.autonomous = (byte >> 2) & 1;
+		return 0;
+
+	case ppt_ptw:
+		errcode = ptdb_get_byte(&packet->payload.ptw.plc, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_get_byte(&byte, pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		packet->payload.ptw.ip = byte & 1;
+
+		return ptdb_get_varint(&packet->payload.ptw.payload, pos, end);
+	}
+
+	return -pte_bad_packet;
+}
+
+int ptdb_read(struct ptdb_record *record, const uint8_t *begin,
+	      const uint8_t *end, struct ptdb_state *state)
+{
+	const uint8_t *pos;
+	uint64_t value;
+	uint8_t type;
+	int errcode;
+
+	if (!record || !begin || !end || !state)
+		return -pte_internal;
+
+	ptdb_record_init(record);
+
+	pos = begin;
+	errcode = ptdb_get_varint(&value, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	record->offset = state->offset + (uint64_t) ptdb_unzigzag(value);
+
+	errcode = ptdb_get_byte(&type, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = ptdb_get_byte(&record->flags, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	if (record->flags & ptdb_diag) {
+		int64_t diag;
+
+		errcode = ptdb_get_varint(&value, &pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		diag = ptdb_unzigzag(value);
+		if ((diag < INT32_MIN) || (INT32_MAX < diag))
+			return -pte_bad_packet;
+
+		record->errcode = (int) diag;
+	} else {
+		record->packet.type = (enum pt_packet_type) type;
+
+		errcode = ptdb_get_byte(&record->packet.size, &pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = ptdb_read_payload(&record->packet, &pos, end);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (record->flags & ptdb_last_ip) {
+		errcode = ptdb_get_varint(&record->last_ip, &pos, end);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (record->flags & ptdb_tsc) {
+		errcode = ptdb_get_varint(&value, &pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		record->tsc = state->tsc + (uint64_t) ptdb_unzigzag(value);
+		state->tsc = record->tsc;
+	}
+
+	state->offset = record->offset;
+
+	return (int) (pos - begin);
+}
@@ -34,10 +34,17 @@
 
 #include "intel-pt.h"
 
+#include "ptdb.h"
+#include "ptdump_output.h"
+
 #if defined(FEATURE_SIDEBAND)
 #  include "libipt-sb.h"
 #endif
 
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif
+
 #include <stdlib.h>
 #include <stdarg.h>
 #include <inttypes.h>
@@ -104,50 +111,23 @@ struct ptdump_options {
 	/* Don't show CYC packets and ignore them when tracking time. */
 	uint32_t no_cyc:1;
 
+	/* Write the binary packet stream instead of text. */
+	uint32_t binary:1;
+
 #if defined(FEATURE_SIDEBAND)
 	/* Print sideband warnings. */
 	uint32_t print_sb_warnings:1;
-#endif
-};
-
-struct ptdump_buffer {
-	/* The trace offset. */
-	char offset[17];
-
-	/* The raw packet bytes. */
-	char raw[33];
 
-	/* The packet opcode. */
-	char opcode[10];
-
-	union {
-		/* The standard packet payload. */
-		char standard[25];
-
-		/* An extended packet payload. */
-		char extended[48];
-	} payload;
-
-	/* The tracking information. */
-	struct {
-		/* The tracking identifier. */
-		char id[5];
-
-		/* The tracking information. */
-		char payload[17];
-	} tracking;
-
-	/* A flag telling whether an extended payload is used. */
-	uint32_t use_ext_payload:1;
-
-	/* A flag telling whether to skip printing this buffer. */
-	uint32_t skip:1;
-
-	/* A flag telling whether to skip printing the time. */
-	uint32_t skip_time:1;
+	/* Sideband decoders have been added to the session. */
+	uint32_t has_sideband:1;
+#endif
 
-	/* A flag telling whether to skip printing the calibration. */
-	uint32_t skip_tcal:1;
+#if defined(FEATURE_THREADS)
+	/* The number of threads for dumping the trace in parallel - zero or
+	 * one to dump the trace sequentially.
+	 */
+	uint32_t threads;
+#endif
 };
 
 struct ptdump_tracking {
@@ -175,6 +155,148 @@ struct ptdump_tracking {
 	uint32_t in_header:1;
 };
 
+#if defined(FEATURE_THREADS)
+
+enum {
+	/* The number of chunks per thread into which we split the trace for
+	 * parallel dump.
+	 */
+	ptdump_chunks_per_thread	= 8,
+
+	/* The number of checkpoints we record at the beginning of a chunk. */
+	ptdump_max_checkpoints		= 8,
+
+	/* The size of the buffer for copying a chunk's output. */
+	ptdump_copy_size		= 64 * 1024
+};
+
+/* The dump state following a PSB+ header. */
+struct ptdump_checkpoint {
+	/* The trace offset following the psbend packet. */
+	uint64_t offset;
+
+	/* The position in the chunk's output at @offset. */
+	uint64_t outpos;
+
+	/* The tracking state at @offset. */
+	struct ptdump_tracking tracking;
+
+	/* The binary packet stream state at @offset. */
+	struct ptdb_state bin;
+};
+
+/* A chunk of trace that is dumped on one of the dump threads.
+ *
+ * A chunk consists of one or more adjacent trace segments.  It is dumped
+ * starting with a fresh tracking state, which need not be the state a
+ * sequential dump has at that point.  From the first checkpoint whose state
+ * matches the sequential dump's state onwards, the chunk's output is the same
+ * as the sequential dump's.
+ */
+struct ptdump_chunk {
+	/* The trace offset at which to start dumping. */
+	uint64_t begin;
+
+	/* The trace offset of the next chunk's first PSB packet or UINT64_MAX
+	 * for the last chunk.
+	 */
+	uint64_t end;
+
+	/* The checkpoints after the chunk's first PSB+ headers. */
+	struct ptdump_checkpoint checkpoint[ptdump_max_checkpoints];
+
+	/* The number of @checkpoint entries. */
+	uint32_t ncheckpoints;
+
+	/* The trace offset of the first PSB packet at or beyond @end. */
+	uint64_t stop;
+
+	/* The tracking state at @stop. */
+	struct ptdump_tracking tracking;
+
+	/* The binary packet stream state at @stop. */
+	struct ptdb_state bin;
+
+	/* The position in the chunk's output at @stop or at the end of the
+	 * chunk's output if the dump ended in this chunk.
+	 */
+	uint64_t outpos;
+
+	/* A flag saying whether we stopped dumping at @stop.  Otherwise, the
+	 * dump ended in this chunk.
+	 */
+	uint32_t stopped:1;
+
+	/* The temporary file holding the chunk's output. */
+	FILE *stream;
+
+	/* The dump status if the dump ended in this chunk. */
+	int status;
+
+	/* A flag saying whether the chunk has been dumped. */
+	uint32_t done:1;
+};
+
+/* The state shared between the dump threads.
+ *
+ * The lock protects @next, @errcode, and the @done flags of @chunks.  Each
+ * chunk's remaining fields are owned by the thread that dumps it until it
+ * sets the chunk's @done flag.
+ */
+struct ptdump_parallel {
+	/* The trace configuration. */
+	const struct pt_config *config;
+
+	/* The options. */
+	const struct ptdump_options *options;
+
+	/* The program name for error messages. */
+	const char *prog;
+
+	/* The chunks in trace order. */
+	struct ptdump_chunk *chunks;
+
+	/* The number of @chunks. */
+	uint32_t nchunks;
+
+	/* The index of the next chunk to dump. */
+	uint32_t next;
+
+	/* The first error encountered by a dump thread. */
+	int errcode;
+
+	/* The lock protecting @next, @errcode, and the @done flags. */
+	mtx_t lock;
+
+	/* Signaled when a chunk has been dumped or an error occurred. */
+	cnd_t dumped;
+};
+
+/* Watch a dump at PSB+ headers.
+ *
+ * A dump thread watches for the end of its chunk and records checkpoints.
+ * The main thread watches for a checkpoint of a later chunk that matches its
+ * own state.
+ */
+struct ptdump_watch {
+	/* Stop before the first PSB packet at or beyond this trace offset. */
+	uint64_t end;
+
+	/* The chunk that is being dumped or NULL. */
+	struct ptdump_chunk *chunk;
+
+	/* The parallel dump whose checkpoints to match or NULL. */
+	struct ptdump_parallel *parallel;
+
+	/* The index of the first chunk that may have a matching checkpoint. */
+	uint32_t next;
+
+	/* The output position in the @next chunk of the matching checkpoint. */
+	uint64_t outpos;
+};
+
+#endif /* defined(FEATURE_THREADS) */
+
 static int usage(const char *name)
 {
 	fprintf(stderr,
@@ -218,6 +340,10 @@ static int help(const char *name)
 	printf("                            this will result in errors when CYC packets are encountered.\n");
 	printf("  --no-wall-clock           suppress the no-time error and print relative time.\n");
 	printf("  --keep-tcal-on-ovf        preserve timing calibration on overflow.\n");
+	printf("  --format=text|bin         write text (default) or a binary packet stream.\n");
+#if defined(FEATURE_THREADS)
+	printf("  --threads <n>             dump trace segments on <n> threads in parallel.\n");
+#endif /* defined(FEATURE_THREADS) */
 #if defined(FEATURE_SIDEBAND)
 	printf("  --sb:compact | --sb       show sideband records in compact format.\n");
 	printf("  --sb:verbose              show sideband records in verbose format.\n");
@@ -240,6 +366,9 @@ static int help(const char *name)
 	printf("  --pevent:vdso-x64 <file>    ignored.\n");
 	printf("  --pevent:vdso-x32 <file>    ignored.\n");
 	printf("  --pevent:vdso-ia32 <file>   ignored.\n");
+#if defined(FEATURE_THREADS)
+	printf("  --pevent:prefetch           parse perf_event sideband streams on a separate thread.\n");
+#endif /* defined(FEATURE_THREADS) */
 #endif /* defined(FEATURE_PEVENT) */
 #endif /* defined(FEATURE_SIDEBAND) */
 	printf("  --cpu none|f/m[/s]        set cpu to the given value and decode according to:\n");
@@ -466,13 +595,38 @@ static int load_pt(struct pt_config *config, const char *filename,
 	return 0;
 }
 
-static int diag(const char *errstr, uint64_t offset, int errcode)
+static void bin_diag(struct ptdump_output *output, uint64_t offset,
+		     int errcode)
+{
+	struct ptdb_record record;
+	char *pos;
+	int size;
+
+	ptdb_record_init(&record);
+	record.offset = offset;
+	record.errcode = errcode;
+	record.flags = ptdb_diag;
+
+	pos = ptdump_reserve(output, ptdb_max_record_size);
+	size = ptdb_write(&record, (uint8_t *) pos, (uint8_t *) output->end,
+			  &output->bin);
+	if (size < 0)
+		return;
+
+	output->pos = pos + size;
+}
+
+static int diag(struct ptdump_output *output, const char *errstr,
+		uint64_t offset, int errcode)
 {
-	if (errcode)
-		printf("[%" PRIx64 ": %s: %s]\n", offset, errstr,
-		       pt_errstr(pt_errcode(errcode)));
+	/* The binary packet stream only gives the error code. */
+	if (output->binary)
+		bin_diag(output, offset, errcode);
+	else if (errcode)
+		ptdump_printf(output, "[%" PRIx64 ": %s: %s]\n", offset,
+			      errstr, pt_errstr(pt_errcode(errcode)));
 	else
-		printf("[%" PRIx64 ": %s]\n", offset, errstr);
+		ptdump_printf(output, "[%" PRIx64 ": %s]\n", offset, errstr);
 
 	return errcode;
 }
@@ -518,98 +672,63 @@ static void ptdump_tracking_fini(struct ptdump_tracking *tracking)
 #endif
 }
 
-#define print_field(field, ...)					\
-	do {							\
-		/* Avoid partial overwrites. */			\
-		memset(field, 0, sizeof(field));		\
-		snprintf(field, sizeof(field), __VA_ARGS__);	\
-	} while (0)
-
-
-static int print_buffer(struct ptdump_buffer *buffer, uint64_t offset,
+static int print_buffer(struct ptdump_output *output,
+			const struct ptdump_buffer *buffer, uint64_t offset,
 			const struct ptdump_options *options)
 {
-	const char *sep;
+	int errcode;
 
 	if (!buffer)
-		return diag("error printing buffer", offset, -pte_internal);
+		return diag(output, "error printing buffer", offset,
+			    -pte_internal);
 
 	if (buffer->skip || options->quiet)
 		return 0;
 
-	/* Make sure the first column starts at the beginning of the line - no
-	 * matter what column is first.
-	 */
-	sep = "";
-
-	if (options->show_offset) {
-		printf("%-*s", (int) sizeof(buffer->offset), buffer->offset);
-		sep = " ";
-	}
-
-	if (buffer->raw[0]) {
-		printf("%s%-*s", sep, (int) sizeof(buffer->raw), buffer->raw);
-		sep = " ";
-	}
-
-	if (buffer->payload.standard[0])
-		printf("%s%-*s", sep, (int) sizeof(buffer->opcode),
-		       buffer->opcode);
-	else
-		printf("%s%s", sep, buffer->opcode);
-
-	/* We printed at least one column.  From this point on, we don't need
-	 * the separator any longer.
-	 */
-
-	if (buffer->use_ext_payload)
-		printf(" %s", buffer->payload.extended);
-	else if (buffer->tracking.id[0]) {
-		printf(" %-*s", (int) sizeof(buffer->payload.standard),
-		       buffer->payload.standard);
-
-		printf(" %-*s", (int) sizeof(buffer->tracking.id),
-		       buffer->tracking.id);
-		printf("%s", buffer->tracking.payload);
-	} else if (buffer->payload.standard[0])
-		printf(" %s", buffer->payload.standard);
+	errcode = ptdump_print_buffer(output, buffer, options->show_offset);
+	if (errcode < 0)
+		return diag(output, "error printing buffer", offset, errcode);
 
-	printf("\n");
 	return 0;
 }
 
-static int print_raw(struct ptdump_buffer *buffer, uint64_t offset,
+static int print_raw(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer, uint64_t offset,
 		     const struct pt_packet *packet,
 		     const struct pt_config *config)
 {
 	const uint8_t *begin, *end;
 	char *bbegin, *bend;
-	int len;
 
 	if (!buffer || !packet)
-		return diag("error printing packet", offset, -pte_internal);
+		return diag(output, "error printing packet", offset,
+			    -pte_internal);
 
 	begin = config->begin + offset;
 	end = begin + packet->size;
 
 	if (config->end < end)
-		return diag("bad packet size", offset, -pte_bad_packet);
+		return diag(output, "bad packet size", offset,
+			    -pte_bad_packet);
 
 	bbegin = buffer->raw;
 	bend = bbegin + sizeof(buffer->raw);
 
-	for (; begin < end; ++begin, bbegin += len) {
-		size_t size = (size_t) ((uintptr_t) bend - (uintptr_t) bbegin);
+	for (; begin < end; ++begin) {
+		/* Leave room for the terminating zero. */
+		if ((bend - bbegin) < 3)
+			return diag(output, "truncating raw packet", offset,
+				    0);
 
-		len = snprintf(bbegin, size, "%02x", *begin);
-		if (len != 2)
-			return diag("truncating raw packet", offset, 0);
+		*bbegin++ = ptdump_hex_digits[*begin >> 4];
+		*bbegin++ = ptdump_hex_digits[*begin & 0xf];
 	}
 
 	return 0;
 }
 
-static int track_last_ip(struct ptdump_buffer *buffer,
+static int track_last_ip(struct ptdump_output *output,
+			 struct ptdump_buffer *buffer,
 			 struct pt_last_ip *last_ip, uint64_t offset,
 			 const struct pt_packet_ip *packet,
 			 const struct ptdump_options *options,
@@ -619,34 +738,39 @@ static int track_last_ip(struct ptdump_buffer *buffer,
 	int errcode;
 
 	if (!buffer || !options)
-		return diag("error tracking last-ip", offset, -pte_internal);
+		return diag(output, "error tracking last-ip", offset,
+			    -pte_internal);
 
-	print_field(buffer->tracking.id, "ip");
+	print_field_str(buffer->tracking.id, "ip");
 
 	errcode = pt_last_ip_update_ip(last_ip, packet, config);
 	if (errcode < 0) {
-		print_field(buffer->tracking.payload, "<unavailable>");
+		print_field_str(buffer->tracking.payload, "<unavailable>");
 
-		return diag("error tracking last-ip", offset, errcode);
+		return diag(output, "error tracking last-ip", offset, errcode);
 	}
 
 	errcode = pt_last_ip_query(&ip, last_ip);
 	if (errcode < 0) {
 		if (errcode == -pte_ip_suppressed)
-			print_field(buffer->tracking.payload, "<suppressed>");
+			print_field_str(buffer->tracking.payload,
+					"<suppressed>");
 		else {
-			print_field(buffer->tracking.payload, "<unavailable>");
+			print_field_str(buffer->tracking.payload,
+					"<unavailable>");
 
-			return diag("error tracking last-ip", offset, errcode);
+			return diag(output, "error tracking last-ip", offset,
+				    errcode);
 		}
 	} else
-		print_field(buffer->tracking.payload, "%016" PRIx64, ip);
+		print_field_hex(buffer->tracking.payload, ip, 16);
 
 	return 0;
 }
 
 
-static int print_time(struct ptdump_buffer *buffer,
+static int print_time(struct ptdump_output *output,
+		      struct ptdump_buffer *buffer,
 		      struct ptdump_tracking *tracking, uint64_t offset,
 		      const struct ptdump_options *options)
 {
@@ -654,9 +778,10 @@ static int print_time(struct ptdump_buffer *buffer,
 	int errcode;
 
 	if (!tracking || !options)
-		return diag("error printing time", offset, -pte_internal);
+		return diag(output, "error printing time", offset,
+			    -pte_internal);
 
-	print_field(buffer->tracking.id, "tsc");
+	print_field_str(buffer->tracking.id, "tsc");
 
 	errcode = pt_time_query_tsc(&tsc, NULL, NULL, &tracking->time);
 	if (errcode < 0) {
@@ -667,31 +792,38 @@ static int print_time(struct ptdump_buffer *buffer,
 
 			fallthrough;
 		default:
-			diag("error printing time", offset, errcode);
-			print_field(buffer->tracking.payload, "<unavailable>");
+			diag(output, "error printing time", offset, errcode);
+			print_field_str(buffer->tracking.payload,
+					"<unavailable>");
 			return errcode;
 		}
 	}
 
 	if (options->show_time_as_delta) {
+		char text[24], *pos;
 		uint64_t old_tsc;
 
+		pos = text;
 		old_tsc = tracking->tsc;
-		if (old_tsc <= tsc)
-			print_field(buffer->tracking.payload, "+%" PRIx64,
-				    tsc - old_tsc);
-		else
-			print_field(buffer->tracking.payload, "-%" PRIx64,
-				    old_tsc - tsc);
+		if (old_tsc <= tsc) {
+			*pos++ = '+';
+			pos = fmt_hex(pos, tsc - old_tsc, 0);
+		} else {
+			*pos++ = '-';
+			pos = fmt_hex(pos, old_tsc - tsc, 0);
+		}
+
+		print_field_text(buffer->tracking.payload, text, pos);
 
 		tracking->tsc = tsc;
 	} else
-		print_field(buffer->tracking.payload, "%016" PRIx64, tsc);
+		print_field_hex(buffer->tracking.payload, tsc, 16);
 
 	return 0;
 }
 
-static int print_tcal(struct ptdump_buffer *buffer,
+static int print_tcal(struct ptdump_output *output,
+		      struct ptdump_buffer *buffer,
 		      struct ptdump_tracking *tracking, uint64_t offset,
 		      const struct ptdump_options *options)
 {
@@ -700,14 +832,15 @@ static int print_tcal(struct ptdump_buffer *buffer,
 	int errcode;
 
 	if (!tracking || !options)
-		return diag("error printing time", offset, -pte_internal);
+		return diag(output, "error printing time", offset,
+			    -pte_internal);
 
-	print_field(buffer->tracking.id, "fcr");
+	print_field_str(buffer->tracking.id, "fcr");
 
 	errcode = pt_tcal_fcr(&fcr, &tracking->tcal);
 	if (errcode < 0) {
-		print_field(buffer->tracking.payload, "<unavailable>");
-		return diag("error printing time", offset, errcode);
+		print_field_str(buffer->tracking.payload, "<unavailable>");
+		return diag(output, "error printing time", offset, errcode);
 	}
 
 	/* We print fcr as double to account for the shift. */
@@ -734,185 +867,284 @@ static int print_tcal(struct ptdump_buffer *buffer,
 	return 0;
 }
 
-static int sb_track_time(struct ptdump_tracking *tracking,
+static int sb_track_time(struct ptdump_output *output,
+			 struct ptdump_tracking *tracking,
 			 const struct ptdump_options *options, uint64_t offset)
 {
 	uint64_t tsc;
 	int errcode;
 
 	if (!tracking || !options)
-		return diag("time tracking error", offset, -pte_internal);
+		return diag(output, "time tracking error", offset,
+			    -pte_internal);
 
 	errcode = pt_time_query_tsc(&tsc, NULL, NULL, &tracking->time);
 	if ((errcode < 0) && (errcode != -pte_no_time))
-		return diag("time tracking error", offset, errcode);
+		return diag(output, "time tracking error", offset, errcode);
 
 #if defined(FEATURE_SIDEBAND)
-	errcode = pt_sb_dump(tracking->session, stdout, options->sb_dump_flags,
-			     tsc);
-	if (errcode < 0)
-		return diag("sideband dump error", offset, errcode);
+	if (options->has_sideband) {
+		/* Sideband records are printed directly to the stream. */
+		(void) ptdump_flush(output);
+
+		errcode = pt_sb_dump(tracking->session, output->stream,
+				     options->sb_dump_flags, tsc);
+		if (errcode < 0)
+			return diag(output, "sideband dump error", offset,
+				    errcode);
+	}
 #endif
 	return 0;
 }
 
-static int track_time(struct ptdump_buffer *buffer,
+static int track_time(struct ptdump_output *output,
+		      struct ptdump_buffer *buffer,
 		      struct ptdump_tracking *tracking, uint64_t offset,
 		      const struct ptdump_options *options)
 {
 	if (!tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
 
 	if (options->show_tcal && !buffer->skip_tcal)
-		print_tcal(buffer, tracking, offset, options);
+		print_tcal(output, buffer, tracking, offset, options);
 
 	if (options->show_time && !buffer->skip_time)
-		print_time(buffer, tracking, offset, options);
+		print_time(output, buffer, tracking, offset, options);
 
-	return sb_track_time(tracking, options, offset);
+	return sb_track_time(output, tracking, options, offset);
 }
 
-static int track_tsc(struct ptdump_buffer *buffer,
-		     struct ptdump_tracking *tracking,  uint64_t offset,
-		     const struct pt_packet_tsc *packet,
-		     const struct ptdump_options *options,
-		     const struct pt_config *config)
+static void update_tsc(struct ptdump_output *output,
+		       struct ptdump_tracking *tracking, uint64_t offset,
+		       const struct pt_packet_tsc *packet,
+		       const struct ptdump_options *options,
+		       const struct pt_config *config)
 {
 	int errcode;
 
-	if (!buffer || !tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
-
 	if (!options->no_tcal) {
 		errcode = tracking->in_header ?
 			pt_tcal_header_tsc(&tracking->tcal, packet, config) :
 			pt_tcal_update_tsc(&tracking->tcal, packet, config);
 		if (errcode < 0)
-			diag("error calibrating time", offset, errcode);
+			diag(output, "error calibrating time", offset, errcode);
 	}
 
 	errcode = pt_time_update_tsc(&tracking->time, packet, config);
 	if (errcode < 0)
-		diag("error updating time", offset, errcode);
-
-	return track_time(buffer, tracking, offset, options);
+		diag(output, "error updating time", offset, errcode);
 }
 
-static int track_cbr(struct ptdump_buffer *buffer,
+static int track_tsc(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer,
 		     struct ptdump_tracking *tracking,  uint64_t offset,
-		     const struct pt_packet_cbr *packet,
+		     const struct pt_packet_tsc *packet,
 		     const struct ptdump_options *options,
 		     const struct pt_config *config)
 {
-	int errcode;
-
 	if (!buffer || !tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
+
+	update_tsc(output, tracking, offset, packet, options, config);
+
+	return track_time(output, buffer, tracking, offset, options);
+}
+
+static void update_cbr(struct ptdump_output *output,
+		       struct ptdump_tracking *tracking, uint64_t offset,
+		       const struct pt_packet_cbr *packet,
+		       const struct ptdump_options *options,
+		       const struct pt_config *config)
+{
+	int errcode;
 
 	if (!options->no_tcal) {
 		errcode = tracking->in_header ?
 			pt_tcal_header_cbr(&tracking->tcal, packet, config) :
 			pt_tcal_update_cbr(&tracking->tcal, packet, config);
 		if (errcode < 0)
-			diag("error calibrating time", offset, errcode);
+			diag(output, "error calibrating time", offset, errcode);
 	}
 
 	errcode = pt_time_update_cbr(&tracking->time, packet, config);
 	if (errcode < 0)
-		diag("error updating time", offset, errcode);
+		diag(output, "error updating time", offset, errcode);
+}
+
+static int track_cbr(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer,
+		     struct ptdump_tracking *tracking,  uint64_t offset,
+		     const struct pt_packet_cbr *packet,
+		     const struct ptdump_options *options,
+		     const struct pt_config *config)
+{
+	if (!buffer || !tracking || !options)
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
+
+	update_cbr(output, tracking, offset, packet, options, config);
 
 	/* There is no timing update at this packet. */
 	buffer->skip_time = 1;
 
-	return track_time(buffer, tracking, offset, options);
+	return track_time(output, buffer, tracking, offset, options);
 }
 
-static int track_tma(struct ptdump_buffer *buffer,
-		     struct ptdump_tracking *tracking,  uint64_t offset,
-		     const struct pt_packet_tma *packet,
-		     const struct ptdump_options *options,
-		     const struct pt_config *config)
+static void update_tma(struct ptdump_output *output,
+		       struct ptdump_tracking *tracking, uint64_t offset,
+		       const struct pt_packet_tma *packet,
+		       const struct ptdump_options *options,
+		       const struct pt_config *config)
 {
 	int errcode;
 
-	if (!buffer || !tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
-
 	if (!options->no_tcal) {
 		errcode = pt_tcal_update_tma(&tracking->tcal, packet, config);
 		if (errcode < 0)
-			diag("error calibrating time", offset, errcode);
+			diag(output, "error calibrating time", offset, errcode);
 	}
 
 	errcode = pt_time_update_tma(&tracking->time, packet, config);
 	if (errcode < 0)
-		diag("error updating time", offset, errcode);
+		diag(output, "error updating time", offset, errcode);
+}
+
+static int track_tma(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer,
+		     struct ptdump_tracking *tracking,  uint64_t offset,
+		     const struct pt_packet_tma *packet,
+		     const struct ptdump_options *options,
+		     const struct pt_config *config)
+{
+	if (!buffer || !tracking || !options)
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
+
+	update_tma(output, tracking, offset, packet, options, config);
 
 	/* There is no calibration update at this packet. */
 	buffer->skip_tcal = 1;
 
-	return track_time(buffer, tracking, offset, options);
+	return track_time(output, buffer, tracking, offset, options);
 }
 
-static int track_mtc(struct ptdump_buffer *buffer,
-		     struct ptdump_tracking *tracking,  uint64_t offset,
-		     const struct pt_packet_mtc *packet,
-		     const struct ptdump_options *options,
-		     const struct pt_config *config)
+static void update_mtc(struct ptdump_output *output,
+		       struct ptdump_tracking *tracking, uint64_t offset,
+		       const struct pt_packet_mtc *packet,
+		       const struct ptdump_options *options,
+		       const struct pt_config *config)
 {
 	int errcode;
 
-	if (!buffer || !tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
-
 	if (!options->no_tcal) {
 		errcode = pt_tcal_update_mtc(&tracking->tcal, packet, config);
 		if (errcode < 0)
-			diag("error calibrating time", offset, errcode);
+			diag(output, "error calibrating time", offset, errcode);
 	}
 
 	errcode = pt_time_update_mtc(&tracking->time, packet, config);
 	if (errcode < 0)
-		diag("error updating time", offset, errcode);
-
-	return track_time(buffer, tracking, offset, options);
+		diag(output, "error updating time", offset, errcode);
 }
 
-static int track_cyc(struct ptdump_buffer *buffer,
+static int track_mtc(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer,
 		     struct ptdump_tracking *tracking,  uint64_t offset,
-		     const struct pt_packet_cyc *packet,
+		     const struct pt_packet_mtc *packet,
 		     const struct ptdump_options *options,
 		     const struct pt_config *config)
+{
+	if (!buffer || !tracking || !options)
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
+
+	update_mtc(output, tracking, offset, packet, options, config);
+
+	return track_time(output, buffer, tracking, offset, options);
+}
+
+static void update_cyc(struct ptdump_output *output,
+		       struct ptdump_tracking *tracking, uint64_t offset,
+		       const struct pt_packet_cyc *packet,
+		       const struct ptdump_options *options,
+		       const struct pt_config *config)
 {
 	uint64_t fcr;
 	int errcode;
 
-	if (!buffer || !tracking || !options)
-		return diag("error tracking time", offset, -pte_internal);
-
 	/* Initialize to zero in case of calibration errors. */
 	fcr = 0ull;
 
 	if (!options->no_tcal) {
 		errcode = pt_tcal_fcr(&fcr, &tracking->tcal);
 		if (errcode < 0)
-			diag("calibration error", offset, errcode);
+			diag(output, "calibration error", offset, errcode);
 
 		errcode = pt_tcal_update_cyc(&tracking->tcal, packet, config);
 		if (errcode < 0)
-			diag("error calibrating time", offset, errcode);
+			diag(output, "error calibrating time", offset, errcode);
 	}
 
 	errcode = pt_time_update_cyc(&tracking->time, packet, config, fcr);
 	if (errcode < 0)
-		diag("error updating time", offset, errcode);
+		diag(output, "error updating time", offset, errcode);
 	else if (!fcr)
-		diag("error updating time: no calibration", offset, 0);
+		diag(output, "error updating time: no calibration", offset, 0);
+}
+
+static int track_cyc(struct ptdump_output *output,
+		     struct ptdump_buffer *buffer,
+		     struct ptdump_tracking *tracking,  uint64_t offset,
+		     const struct pt_packet_cyc *packet,
+		     const struct ptdump_options *options,
+		     const struct pt_config *config)
+{
+	if (!buffer || !tracking || !options)
+		return diag(output, "error tracking time", offset,
+			    -pte_internal);
+
+	update_cyc(output, tracking, offset, packet, options, config);
 
 	/* There is no calibration update at this packet. */
 	buffer->skip_tcal = 1;
 
-	return track_time(buffer, tracking, offset, options);
+	return track_time(output, buffer, tracking, offset, options);
+}
+
+static void track_psb(struct ptdump_output *output,
+		      struct ptdump_tracking *tracking, uint64_t offset,
+		      const struct ptdump_options *options,
+		      const struct pt_config *config)
+{
+	if (options->track_time) {
+		int errcode;
+
+		errcode = pt_tcal_update_psb(&tracking->tcal, config);
+		if (errcode < 0)
+			diag(output, "error calibrating time", offset, errcode);
+	}
+
+	tracking->in_header = 1;
+}
+
+static void track_ovf(struct ptdump_output *output,
+		      struct ptdump_tracking *tracking, uint64_t offset,
+		      const struct ptdump_options *options,
+		      const struct pt_config *config)
+{
+	if (!options->track_time)
+		return;
+
+	if (options->keep_tcal_on_ovf) {
+		int errcode;
+
+		errcode = pt_tcal_update_ovf(&tracking->tcal, config);
+		if (errcode < 0)
+			diag(output, "error calibrating time", offset, errcode);
+	} else
+		pt_tcal_init(&tracking->tcal);
 }
 
 static uint64_t sext(uint64_t val, uint8_t sign)
@@ -925,50 +1157,62 @@ static uint64_t sext(uint64_t val, uint8_t sign)
 	return val & signbit ? val | mask : val & ~mask;
 }
 
-static int print_ip_payload(struct ptdump_buffer *buffer, uint64_t offset,
+static int print_ip_payload(struct ptdump_output *output,
+			    struct ptdump_buffer *buffer, uint64_t offset,
 			    const struct pt_packet_ip *packet)
 {
+	char text[64], *pos;
+
 	if (!buffer || !packet)
-		return diag("error printing payload", offset, -pte_internal);
+		return diag(output, "error printing payload", offset,
+			    -pte_internal);
+
+	/* This is the most frequent payload; avoid snprintf(). */
+	pos = fmt_hex(text, packet->ipc, 1);
+	pos = fmt_str(pos, ": ");
 
 	switch (packet->ipc) {
 	case pt_ipc_suppressed:
-		print_field(buffer->payload.standard, "%x: ????????????????",
-			    pt_ipc_suppressed);
+		pos = fmt_str(pos, "????????????????");
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 
 	case pt_ipc_update_16:
-		print_field(buffer->payload.standard, "%x: ????????????%04"
-			    PRIx64, pt_ipc_update_16, packet->ip);
+		pos = fmt_str(pos, "????????????");
+		pos = fmt_hex(pos, packet->ip, 4);
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 
 	case pt_ipc_update_32:
-		print_field(buffer->payload.standard, "%x: ????????%08"
-			    PRIx64, pt_ipc_update_32, packet->ip);
+		pos = fmt_str(pos, "????????");
+		pos = fmt_hex(pos, packet->ip, 8);
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 
 	case pt_ipc_update_48:
-		print_field(buffer->payload.standard, "%x: ????%012"
-			    PRIx64, pt_ipc_update_48, packet->ip);
+		pos = fmt_str(pos, "????");
+		pos = fmt_hex(pos, packet->ip, 12);
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 
 	case pt_ipc_sext_48:
-		print_field(buffer->payload.standard, "%x: %016" PRIx64,
-			    pt_ipc_sext_48, sext(packet->ip, 48));
+		pos = fmt_hex(pos, sext(packet->ip, 48), 16);
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 
 	case pt_ipc_full:
-		print_field(buffer->payload.standard, "%x: %016" PRIx64,
-			    pt_ipc_full, packet->ip);
+		pos = fmt_hex(pos, packet->ip, 16);
+		print_field_text(buffer->payload.standard, text, pos);
 		return 0;
 	}
 
-	print_field(buffer->payload.standard, "%x: %016" PRIx64,
-		    packet->ipc, packet->ip);
-	return diag("bad ipc", offset, -pte_bad_packet);
+	pos = fmt_hex(pos, packet->ip, 16);
+	print_field_text(buffer->payload.standard, text, pos);
+	return diag(output, "bad ipc", offset, -pte_bad_packet);
 }
 
-static int print_tnt_payload(struct ptdump_buffer *buffer, uint64_t offset,
+static int print_tnt_payload(struct ptdump_output *output,
+			     struct ptdump_buffer *buffer, uint64_t offset,
 			     const struct pt_packet_tnt *packet)
 {
 	uint64_t tnt;
@@ -976,7 +1220,8 @@ static int print_tnt_payload(struct ptdump_buffer *buffer, uint64_t offset,
 	char *begin, *end;
 
 	if (!buffer || !packet)
-		return diag("error printing payload", offset, -pte_internal);
+		return diag(output, "error printing payload", offset,
+			    -pte_internal);
 
 	bits = packet->bit_size;
 	tnt = packet->payload;
@@ -985,7 +1230,7 @@ static int print_tnt_payload(struct ptdump_buffer *buffer, uint64_t offset,
 	end = begin + bits;
 
 	if (sizeof(buffer->payload.extended) < bits) {
-		diag("truncating tnt payload", offset, 0);
+		diag(output, "truncating tnt payload", offset, 0);
 
 		end = begin + sizeof(buffer->payload.extended);
 	}
@@ -996,7 +1241,8 @@ static int print_tnt_payload(struct ptdump_buffer *buffer, uint64_t offset,
 	return 0;
 }
 
-static const char *print_exec_mode(const struct pt_packet_mode_exec *packet,
+static const char *print_exec_mode(struct ptdump_output *output,
+				   const struct pt_packet_mode_exec *packet,
 				   uint64_t offset)
 {
 	enum pt_exec_mode mode;
@@ -1016,7 +1262,7 @@ static const char *print_exec_mode(const struct pt_packet_mode_exec *packet,
 		return "unknown";
 	}
 
-	diag("bad exec mode", offset, -pte_bad_packet);
+	diag(output, "bad exec mode", offset, -pte_bad_packet);
 	return "invalid";
 }
 
@@ -1049,137 +1295,125 @@ static const char *print_pwrx_wr(const struct pt_packet_pwrx *packet)
 	return wr;
 }
 
-static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
+static int print_packet(struct ptdump_output *output,
+			struct ptdump_buffer *buffer, uint64_t offset,
 			const struct pt_packet *packet,
 			struct ptdump_tracking *tracking,
 			const struct ptdump_options *options,
 			const struct pt_config *config)
 {
 	if (!buffer || !packet || !tracking || !options)
-		return diag("error printing packet", offset, -pte_internal);
+		return diag(output, "error printing packet", offset,
+			    -pte_internal);
 
 	switch (packet->type) {
 	case ppt_unknown:
-		print_field(buffer->opcode, "<unknown>");
+		print_field_str(buffer->opcode, "<unknown>");
 		return 0;
 
 	case ppt_invalid:
-		print_field(buffer->opcode, "<invalid>");
+		print_field_str(buffer->opcode, "<invalid>");
 		return 0;
 
 	case ppt_psb:
-		print_field(buffer->opcode, "psb");
-
-		if (options->track_time) {
-			int errcode;
+		print_field_str(buffer->opcode, "psb");
 
-			errcode = pt_tcal_update_psb(&tracking->tcal, config);
-			if (errcode < 0)
-				diag("error calibrating time", offset, errcode);
-		}
-
-		tracking->in_header = 1;
+		track_psb(output, tracking, offset, options, config);
 		return 0;
 
 	case ppt_psbend:
-		print_field(buffer->opcode, "psbend");
+		print_field_str(buffer->opcode, "psbend");
 
 		tracking->in_header = 0;
 		return 0;
 
 	case ppt_pad:
-		print_field(buffer->opcode, "pad");
+		print_field_str(buffer->opcode, "pad");
 
 		if (options->no_pad)
 			buffer->skip = 1;
 		return 0;
 
 	case ppt_ovf:
-		print_field(buffer->opcode, "ovf");
-
-		if (options->track_time) {
-			if (options->keep_tcal_on_ovf) {
-				int errcode;
-
-				errcode = pt_tcal_update_ovf(&tracking->tcal,
-							     config);
-				if (errcode < 0)
-					diag("error calibrating time",
-					     offset, errcode);
-			} else
-				pt_tcal_init(&tracking->tcal);
-		}
+		print_field_str(buffer->opcode, "ovf");
 
+		track_ovf(output, tracking, offset, options, config);
 		return 0;
 
 	case ppt_stop:
-		print_field(buffer->opcode, "stop");
+		print_field_str(buffer->opcode, "stop");
 		return 0;
 
 	case ppt_fup:
-		print_field(buffer->opcode, "fup");
-		print_ip_payload(buffer, offset, &packet->payload.ip);
+		print_field_str(buffer->opcode, "fup");
+		print_ip_payload(output, buffer, offset, &packet->payload.ip);
 
 		if (options->show_last_ip)
-			track_last_ip(buffer, &tracking->last_ip, offset,
-				      &packet->payload.ip, options, config);
+			track_last_ip(output, buffer, &tracking->last_ip,
+				      offset, &packet->payload.ip, options,
+				      config);
 		return 0;
 
 	case ppt_tip:
-		print_field(buffer->opcode, "tip");
-		print_ip_payload(buffer, offset, &packet->payload.ip);
+		print_field_str(buffer->opcode, "tip");
+		print_ip_payload(output, buffer, offset, &packet->payload.ip);
 
 		if (options->show_last_ip)
-			track_last_ip(buffer, &tracking->last_ip, offset,
-				      &packet->payload.ip, options, config);
+			track_last_ip(output, buffer, &tracking->last_ip,
+				      offset, &packet->payload.ip, options,
+				      config);
 		return 0;
 
 	case ppt_tip_pge:
-		print_field(buffer->opcode, "tip.pge");
-		print_ip_payload(buffer, offset, &packet->payload.ip);
+		print_field_str(buffer->opcode, "tip.pge");
+		print_ip_payload(output, buffer, offset, &packet->payload.ip);
 
 		if (options->show_last_ip)
-			track_last_ip(buffer, &tracking->last_ip, offset,
-				      &packet->payload.ip, options, config);
+			track_last_ip(output, buffer, &tracking->last_ip,
+				      offset, &packet->payload.ip, options,
+				      config);
 		return 0;
 
 	case ppt_tip_pgd:
-		print_field(buffer->opcode, "tip.pgd");
-		print_ip_payload(buffer, offset, &packet->payload.ip);
+		print_field_str(buffer->opcode, "tip.pgd");
+		print_ip_payload(output, buffer, offset, &packet->payload.ip);
 
 		if (options->show_last_ip)
-			track_last_ip(buffer, &tracking->last_ip, offset,
-				      &packet->payload.ip, options, config);
+			track_last_ip(output, buffer, &tracking->last_ip,
+				      offset, &packet->payload.ip, options,
+				      config);
 		return 0;
 
 	case ppt_pip:
-		print_field(buffer->opcode, "pip");
+		print_field_str(buffer->opcode, "pip");
 		print_field(buffer->payload.standard, "%" PRIx64 "%s",
 			    packet->payload.pip.cr3,
 			    packet->payload.pip.nr ? ", nr" : "");
 
-		print_field(buffer->tracking.id, "cr3");
-		print_field(buffer->tracking.payload, "%016" PRIx64,
-			    packet->payload.pip.cr3);
+		print_field_str(buffer->tracking.id, "cr3");
+		print_field_hex(buffer->tracking.payload,
+				packet->payload.pip.cr3, 16);
 		return 0;
 
 	case ppt_vmcs:
-		print_field(buffer->opcode, "vmcs");
-		print_field(buffer->payload.standard, "%" PRIx64,
-			    packet->payload.vmcs.base);
+		print_field_str(buffer->opcode, "vmcs");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.vmcs.base, 0);
 
-		print_field(buffer->tracking.id, "vmcs");
-		print_field(buffer->tracking.payload, "%016" PRIx64,
-			    packet->payload.vmcs.base);
+		print_field_str(buffer->tracking.id, "vmcs");
+		print_field_hex(buffer->tracking.payload,
+				packet->payload.vmcs.base, 16);
 		return 0;
 
 	case ppt_tnt_8:
-		print_field(buffer->opcode, "tnt.8");
-		return print_tnt_payload(buffer, offset, &packet->payload.tnt);
+		print_field_str(buffer->opcode, "tnt.8");
+		return print_tnt_payload(output, buffer, offset,
+					 &packet->payload.tnt);
 
 	case ppt_tnt_64:
-		print_field(buffer->opcode, "tnt.64");
-		return print_tnt_payload(buffer, offset, &packet->payload.tnt);
+		print_field_str(buffer->opcode, "tnt.64");
+		return print_tnt_payload(output, buffer, offset,
+					 &packet->payload.tnt);
 
 	case ppt_mode: {
 		const struct pt_packet_mode *mode;
@@ -1194,16 +1428,17 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 
 			sep = csd[0] && csl[0] ? ", " : "";
 
-			print_field(buffer->opcode, "mode.exec");
+			print_field_str(buffer->opcode, "mode.exec");
 			print_field(buffer->payload.standard, "%s%s%s",
 				    csd, sep, csl);
 
 			if (options->show_exec_mode) {
 				const char *em;
 
-				em = print_exec_mode(&mode->bits.exec, offset);
-				print_field(buffer->tracking.id, "em");
-				print_field(buffer->tracking.payload, "%s", em);
+				em = print_exec_mode(output, &mode->bits.exec,
+						     offset);
+				print_field_str(buffer->tracking.id, "em");
+				print_field_str(buffer->tracking.payload, em);
 			}
 		}
 			return 0;
@@ -1216,26 +1451,26 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 
 			sep = intx[0] && abrt[0] ? ", " : "";
 
-			print_field(buffer->opcode, "mode.tsx");
+			print_field_str(buffer->opcode, "mode.tsx");
 			print_field(buffer->payload.standard, "%s%s%s",
 				    intx, sep, abrt);
 		}
 			return 0;
 		}
 
-		print_field(buffer->opcode, "mode");
+		print_field_str(buffer->opcode, "mode");
 		print_field(buffer->payload.standard, "leaf: %x", mode->leaf);
 
-		return diag("unknown mode leaf", offset, 0);
+		return diag(output, "unknown mode leaf", offset, 0);
 	}
 
 	case ppt_tsc:
-		print_field(buffer->opcode, "tsc");
-		print_field(buffer->payload.standard, "%" PRIx64,
-			    packet->payload.tsc.tsc);
+		print_field_str(buffer->opcode, "tsc");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.tsc.tsc, 0);
 
 		if (options->track_time)
-			track_tsc(buffer, tracking, offset,
+			track_tsc(output, buffer, tracking, offset,
 				  &packet->payload.tsc, options, config);
 
 		if (options->no_timing)
@@ -1244,12 +1479,12 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 
 	case ppt_cbr:
-		print_field(buffer->opcode, "cbr");
-		print_field(buffer->payload.standard, "%x",
-			    packet->payload.cbr.ratio);
+		print_field_str(buffer->opcode, "cbr");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.cbr.ratio, 0);
 
 		if (options->track_time)
-			track_cbr(buffer, tracking, offset,
+			track_cbr(output, buffer, tracking, offset,
 				  &packet->payload.cbr, options, config);
 
 		if (options->no_timing)
@@ -1258,12 +1493,12 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 
 	case ppt_tma:
-		print_field(buffer->opcode, "tma");
+		print_field_str(buffer->opcode, "tma");
 		print_field(buffer->payload.standard, "%x, %x",
 			    packet->payload.tma.ctc, packet->payload.tma.fc);
 
 		if (options->track_time)
-			track_tma(buffer, tracking, offset,
+			track_tma(output, buffer, tracking, offset,
 				  &packet->payload.tma, options, config);
 
 		if (options->no_timing)
@@ -1272,12 +1507,12 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 
 	case ppt_mtc:
-		print_field(buffer->opcode, "mtc");
-		print_field(buffer->payload.standard, "%x",
-			    packet->payload.mtc.ctc);
+		print_field_str(buffer->opcode, "mtc");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.mtc.ctc, 0);
 
 		if (options->track_time)
-			track_mtc(buffer, tracking, offset,
+			track_mtc(output, buffer, tracking, offset,
 				  &packet->payload.mtc, options, config);
 
 		if (options->no_timing)
@@ -1286,12 +1521,12 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 
 	case ppt_cyc:
-		print_field(buffer->opcode, "cyc");
-		print_field(buffer->payload.standard, "%" PRIx64,
-			    packet->payload.cyc.value);
+		print_field_str(buffer->opcode, "cyc");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.cyc.value, 0);
 
 		if (options->track_time && !options->no_cyc)
-			track_cyc(buffer, tracking, offset,
+			track_cyc(output, buffer, tracking, offset,
 				  &packet->payload.cyc, options, config);
 
 		if (options->no_timing || options->no_cyc)
@@ -1300,26 +1535,26 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 
 	case ppt_mnt:
-		print_field(buffer->opcode, "mnt");
-		print_field(buffer->payload.standard, "%" PRIx64,
-			    packet->payload.mnt.payload);
+		print_field_str(buffer->opcode, "mnt");
+		print_field_hex(buffer->payload.standard,
+				packet->payload.mnt.payload, 0);
 		return 0;
 
 	case ppt_exstop:
-		print_field(buffer->opcode, "exstop");
+		print_field_str(buffer->opcode, "exstop");
 		print_field(buffer->payload.standard, "%s",
 			    packet->payload.exstop.ip ? "ip" : "");
 		return 0;
 
 	case ppt_mwait:
-		print_field(buffer->opcode, "mwait");
+		print_field_str(buffer->opcode, "mwait");
 		print_field(buffer->payload.standard, "%08x, %08x",
 			    packet->payload.mwait.hints,
 			    packet->payload.mwait.ext);
 		return 0;
 
 	case ppt_pwre:
-		print_field(buffer->opcode, "pwre");
+		print_field_str(buffer->opcode, "pwre");
 		print_field(buffer->payload.standard, "c%u.%u%s",
 			    (packet->payload.pwre.state + 1) & 0xf,
 			    (packet->payload.pwre.sub_state + 1) & 0xf,
@@ -1333,7 +1568,7 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		if (!wr)
 			wr = "bad";
 
-		print_field(buffer->opcode, "pwrx");
+		print_field_str(buffer->opcode, "pwrx");
 		print_field(buffer->payload.standard, "%s: c%u, c%u", wr,
 			    (packet->payload.pwrx.last + 1) & 0xf,
 			    (packet->payload.pwrx.deepest + 1) & 0xf);
@@ -1341,7 +1576,7 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 	}
 
 	case ppt_ptw:
-		print_field(buffer->opcode, "ptw");
+		print_field_str(buffer->opcode, "ptw");
 		print_field(buffer->payload.standard, "%x: %" PRIx64 "%s",
 			    packet->payload.ptw.plc,
 			    packet->payload.ptw.payload,
@@ -1350,110 +1585,515 @@ static int print_packet(struct ptdump_buffer *buffer, uint64_t offset,
 		return 0;
 	}
 
-	return diag("unknown packet", offset, -pte_bad_opc);
+	return diag(output, "unknown packet", offset, -pte_bad_opc);
 }
 
-static int dump_one_packet(uint64_t offset, const struct pt_packet *packet,
-			   struct ptdump_tracking *tracking,
-			   const struct ptdump_options *options,
-			   const struct pt_config *config)
+static void bin_last_ip(struct ptdump_output *output,
+			struct ptdb_record *record,
+			struct pt_last_ip *last_ip,
+			const struct pt_packet_ip *packet,
+			const struct pt_config *config)
 {
-	struct ptdump_buffer buffer;
+	uint64_t ip;
 	int errcode;
 
-	memset(&buffer, 0, sizeof(buffer));
-
-	print_field(buffer.offset, "%016" PRIx64, offset);
-
-	if (options->show_raw_bytes) {
-		errcode = print_raw(&buffer, offset, packet, config);
-		if (errcode < 0)
-			return errcode;
+	errcode = pt_last_ip_update_ip(last_ip, packet, config);
+	if (errcode < 0) {
+		diag(output, "error tracking last-ip", record->offset,
+		     errcode);
+		return;
 	}
 
-	errcode = print_packet(&buffer, offset, packet, tracking, options,
-			       config);
-	if (errcode < 0)
-		return errcode;
+	errcode = pt_last_ip_query(&ip, last_ip);
+	if (errcode < 0) {
+		if (errcode == -pte_ip_suppressed)
+			record->flags |= ptdb_last_ip_suppressed;
+		else
+			diag(output, "error tracking last-ip", record->offset,
+			     errcode);
+		return;
+	}
 
-	return print_buffer(&buffer, offset, options);
+	record->last_ip = ip;
+	record->flags |= ptdb_last_ip;
 }
 
-static int dump_packets(struct pt_packet_decoder *decoder,
-			struct ptdump_tracking *tracking,
-			const struct ptdump_options *options,
-			const struct pt_config *config)
+static void bin_time(struct ptdump_output *output,
+		     struct ptdb_record *record,
+		     const struct ptdump_tracking *tracking,
+		     const struct ptdump_options *options)
 {
-	uint64_t offset;
+	uint64_t tsc;
 	int errcode;
 
-	offset = 0ull;
-	for (;;) {
-		struct pt_packet packet;
-
-		errcode = pt_pkt_get_offset(decoder, &offset);
-		if (errcode < 0)
-			return diag("error getting offset", offset, errcode);
-
-		errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
-		if (errcode < 0) {
-			if (errcode == -pte_eos)
-				return 0;
-
-			return diag("error decoding packet", offset, errcode);
+	errcode = pt_time_query_tsc(&tsc, NULL, NULL, &tracking->time);
+	if (errcode < 0) {
+		if ((errcode != -pte_no_time) || !options->no_wall_clock) {
+			diag(output, "error printing time", record->offset,
+			     errcode);
+			return;
 		}
-
-		errcode = dump_one_packet(offset, &packet, tracking, options,
-					  config);
-		if (errcode < 0)
-			return errcode;
 	}
+
+	record->tsc = tsc;
+	record->flags |= ptdb_tsc;
 }
 
-static int dump_sync(struct pt_packet_decoder *decoder,
-		     struct ptdump_tracking *tracking,
-		     const struct ptdump_options *options,
-		     const struct pt_config *config)
+/* Track @packet and write it as ptdb record.
+ *
+ * This follows print_packet() but skips all the text formatting.
+ */
+static int bin_one_packet(struct ptdump_output *output, uint64_t offset,
+			  const struct pt_packet *packet,
+			  struct ptdump_tracking *tracking,
+			  const struct ptdump_options *options,
+			  const struct pt_config *config)
 {
-	int errcode;
-
-	if (!options)
-		return diag("setup error", 0ull, -pte_internal);
+	struct ptdb_record record;
+	int skip, show_time, size;
+	char *pos;
 
-	if (options->no_sync) {
-		errcode = pt_pkt_sync_set(decoder, 0ull);
-		if (errcode < 0)
-			return diag("sync error", 0ull, errcode);
-	} else {
-		errcode = pt_pkt_sync_forward(decoder);
-		if (errcode < 0) {
-			if (errcode == -pte_eos)
-				return 0;
+	ptdb_record_init(&record);
+	record.offset = offset;
+	record.packet = *packet;
 
-			return diag("sync error", 0ull, errcode);
+	skip = 0;
+	show_time = 0;
+	switch (packet->type) {
+	case ppt_psb:
+		track_psb(output, tracking, offset, options, config);
+		break;
+
+	case ppt_psbend:
+		tracking->in_header = 0;
+		break;
+
+	case ppt_pad:
+		skip = options->no_pad;
+		break;
+
+	case ppt_ovf:
+		track_ovf(output, tracking, offset, options, config);
+		break;
+
+	case ppt_fup:
+	case ppt_tip:
+	case ppt_tip_pge:
+	case ppt_tip_pgd:
+		if (options->show_last_ip)
+			bin_last_ip(output, &record, &tracking->last_ip,
+				    &packet->payload.ip, config);
+		break;
+
+	case ppt_mode:
+		if ((packet->payload.mode.leaf != pt_mol_exec) &&
+		    (packet->payload.mode.leaf != pt_mol_tsx))
+			diag(output, "unknown mode leaf", offset, 0);
+		break;
+
+	case ppt_tsc:
+		if (options->track_time) {
+			update_tsc(output, tracking, offset,
+				   &packet->payload.tsc, options, config);
+			show_time = 1;
+		}
+
+		skip = options->no_timing;
+		break;
+
+	case ppt_cbr:
+		/* There is no timing update at this packet. */
+		if (options->track_time)
+			update_cbr(output, tracking, offset,
+				   &packet->payload.cbr, options, config);
+
+		skip = options->no_timing;
+		break;
+
+	case ppt_tma:
+		if (options->track_time) {
+			update_tma(output, tracking, offset,
+				   &packet->payload.tma, options, config);
+			show_time = 1;
 		}
+
+		skip = options->no_timing;
+		break;
+
+	case ppt_mtc:
+		if (options->track_time) {
+			update_mtc(output, tracking, offset,
+				   &packet->payload.mtc, options, config);
+			show_time = 1;
+		}
+
+		skip = options->no_timing;
+		break;
+
+	case ppt_cyc:
+		if (options->track_time && !options->no_cyc) {
+			update_cyc(output, tracking, offset,
+				   &packet->payload.cyc, options, config);
+			show_time = 1;
+		}
+
+		skip = options->no_timing || options->no_cyc;
+		break;
+
+	default:
+		break;
+	}
+
+	if (show_time && options->show_time)
+		bin_time(output, &record, tracking, options);
+
+	if (skip || options->quiet)
+		return 0;
+
+	pos = ptdump_reserve(output, ptdb_max_record_size);
+	size = ptdb_write(&record, (uint8_t *) pos, (uint8_t *) output->end,
+			  &output->bin);
+	if (size < 0) {
+		if (size == -pte_bad_packet)
+			return diag(output, "unknown packet", offset,
+				    -pte_bad_opc);
+
+		return diag(output, "error writing packet", offset, size);
+	}
+
+	output->pos = pos + size;
+	return 0;
+}
+
+static int dump_one_packet(struct ptdump_output *output, uint64_t offset,
+			   const struct pt_packet *packet,
+			   struct ptdump_tracking *tracking,
+			   const struct ptdump_options *options,
+			   const struct pt_config *config)
+{
+	struct ptdump_buffer buffer;
+	int errcode;
+
+	if (options->binary)
+		return bin_one_packet(output, offset, packet, tracking,
+				      options, config);
+
+	memset(&buffer, 0, sizeof(buffer));
+
+	print_field_hex(buffer.offset, offset, 16);
+
+	if (options->show_raw_bytes) {
+		errcode = print_raw(output, &buffer, offset, packet, config);
+		if (errcode < 0)
+			return errcode;
 	}
 
+	errcode = print_packet(output, &buffer, offset, packet, tracking,
+			       options, config);
+	if (errcode < 0)
+		return errcode;
+
+	return print_buffer(output, &buffer, offset, options);
+}
+
+#if defined(FEATURE_THREADS)
+
+/* The position in the output stream at which the next output will appear. */
+static uint64_t ptdump_tell(const struct ptdump_output *output)
+{
+	return output->written + (uint64_t) (output->pos - output->begin);
+}
+
+/* Check whether two tracking states result in the same output.
+ *
+ * Returns non-zero if they do, zero otherwise.
+ */
+static int ptdump_tracking_equal(const struct ptdump_tracking *lhs,
+				 const struct ptdump_tracking *rhs)
+{
+	if ((lhs->last_ip.ip != rhs->last_ip.ip) ||
+	    (lhs->last_ip.have_ip != rhs->last_ip.have_ip) ||
+	    (lhs->last_ip.suppressed != rhs->last_ip.suppressed))
+		return 0;
+
+	if ((lhs->tsc != rhs->tsc) || (lhs->fcr != rhs->fcr) ||
+	    (lhs->in_header != rhs->in_header))
+		return 0;
+
+	/* Both are cleared on initialization.  Should padding differ, we miss
+	 * a match but we never report a wrong one.
+	 */
+	if (memcmp(&lhs->tcal, &rhs->tcal, sizeof(lhs->tcal)) != 0)
+		return 0;
+
+	return memcmp(&lhs->time, &rhs->time, sizeof(lhs->time)) == 0;
+}
+
+/* Wait until @chunk has been dumped.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptdump_wait_chunk(struct ptdump_parallel *parallel,
+			     const struct ptdump_chunk *chunk)
+{
+	int errcode;
+
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	while (!chunk->done && !parallel->errcode)
+		(void) cnd_wait(&parallel->dumped, &parallel->lock);
+
+	errcode = parallel->errcode;
+	(void) mtx_unlock(&parallel->lock);
+
+	return errcode;
+}
+
+/* Look for a checkpoint at @offset with @tracking state in a later chunk.
+ *
+ * The binary packet stream is delta encoded so @output's state must match,
+ * as well.
+ *
+ * Returns a positive value if one is found, zero otherwise.
+ */
+static int ptdump_match_checkpoint(struct ptdump_watch *watch, uint64_t offset,
+				   const struct ptdump_output *output,
+				   const struct ptdump_tracking *tracking)
+{
+	struct ptdump_parallel *parallel;
+
+	parallel = watch->parallel;
+	for (; watch->next < parallel->nchunks; watch->next += 1) {
+		const struct ptdump_chunk *chunk;
+		uint32_t idx;
+
+		chunk = &parallel->chunks[watch->next];
+		if (offset < chunk->begin)
+			return 0;
+
+		/* If we can't wait, we keep dumping ourselves. */
+		if (ptdump_wait_chunk(parallel, chunk) < 0)
+			return 0;
+
+		for (idx = 0; idx < chunk->ncheckpoints; ++idx) {
+			const struct ptdump_checkpoint *checkpoint;
+
+			checkpoint = &chunk->checkpoint[idx];
+			if (checkpoint->offset < offset)
+				continue;
+
+			if (offset < checkpoint->offset)
+				return 0;
+
+			if (!ptdump_tracking_equal(&checkpoint->tracking,
+						   tracking))
+				return 0;
+
+			if ((checkpoint->bin.offset != output->bin.offset) ||
+			    (checkpoint->bin.tsc != output->bin.tsc))
+				return 0;
+
+			watch->outpos = checkpoint->outpos;
+			return 1;
+		}
+
+		/* We passed @chunk's checkpoints.  We will dump the rest of
+		 * @chunk ourselves.
+		 */
+	}
+
+	return 0;
+}
+
+/* Notify @watch of a PSB packet at @offset.
+ *
+ * Returns a positive value to stop dumping, zero otherwise.
+ */
+static int ptdump_watch_psb(struct ptdump_watch *watch, uint64_t offset,
+			    const struct ptdump_output *output,
+			    const struct ptdump_tracking *tracking)
+{
+	struct ptdump_chunk *chunk;
+
+	if (offset < watch->end)
+		return 0;
+
+	chunk = watch->chunk;
+	if (!chunk)
+		return 0;
+
+	chunk->stop = offset;
+	chunk->tracking = *tracking;
+	chunk->bin = output->bin;
+	chunk->outpos = ptdump_tell(output);
+	chunk->stopped = 1;
+
+	return 1;
+}
+
+/* Notify @watch of the end of a PSB+ header at @offset.
+ *
+ * Returns a positive value to stop dumping, zero otherwise.
+ */
+static int ptdump_watch_psbend(struct ptdump_watch *watch, uint64_t offset,
+			       const struct ptdump_output *output,
+			       const struct ptdump_tracking *tracking)
+{
+	struct ptdump_checkpoint *checkpoint;
+	struct ptdump_chunk *chunk;
+
+	if (watch->parallel)
+		return ptdump_match_checkpoint(watch, offset, output,
+					       tracking);
+
+	chunk = watch->chunk;
+	if (!chunk || (ptdump_max_checkpoints <= chunk->ncheckpoints))
+		return 0;
+
+	checkpoint = &chunk->checkpoint[chunk->ncheckpoints++];
+	checkpoint->offset = offset;
+	checkpoint->outpos = ptdump_tell(output);
+	checkpoint->tracking = *tracking;
+	checkpoint->bin = output->bin;
+
+	return 0;
+}
+
+#endif /* defined(FEATURE_THREADS) */
+
+struct ptdump_watch;
+
+/* Dump packets until the end of the trace or until an error.
+ *
+ * If @watch is not NULL, also stop when @watch says so.
+ *
+ * Returns zero at the end of the trace, a positive value if @watch stopped the
+ * dump, a negative error code otherwise.
+ */
+static int dump_packets(struct ptdump_output *output,
+			struct pt_packet_decoder *decoder,
+			struct ptdump_tracking *tracking,
+			const struct ptdump_options *options,
+			const struct pt_config *config,
+			struct ptdump_watch *watch)
+{
+	uint64_t offset;
+	int errcode;
+
+#if !defined(FEATURE_THREADS)
+	(void) watch;
+#endif
+
+	offset = 0ull;
 	for (;;) {
-		errcode = dump_packets(decoder, tracking, options, config);
-		if (!errcode)
-			break;
+		struct pt_packet packet;
+
+		errcode = pt_pkt_get_offset(decoder, &offset);
+		if (errcode < 0)
+			return diag(output, "error getting offset", offset,
+				    errcode);
+
+		errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
+		if (errcode < 0) {
+			if (errcode == -pte_eos)
+				return 0;
+
+			return diag(output, "error decoding packet", offset,
+				    errcode);
+		}
+
+#if defined(FEATURE_THREADS)
+		if (watch && (packet.type == ppt_psb)) {
+			errcode = ptdump_watch_psb(watch, offset, output,
+						   tracking);
+			if (errcode)
+				return errcode;
+		}
+#endif
+
+		errcode = dump_one_packet(output, offset, &packet, tracking,
+					  options, config);
+		if (errcode < 0)
+			return errcode;
+
+#if defined(FEATURE_THREADS)
+		if (watch && (packet.type == ppt_psbend)) {
+			offset += packet.size;
+
+			errcode = ptdump_watch_psbend(watch, offset, output,
+						      tracking);
+			if (errcode)
+				return errcode;
+		}
+#endif
+	}
+}
+
+/* Dump the trace from the current decoder position.
+ *
+ * Resynchronize and reset @tracking on errors.
+ *
+ * Returns zero at the end of the trace, a positive value if @watch stopped the
+ * dump, a negative error code otherwise.
+ */
+static int dump_trace(struct ptdump_output *output,
+		      struct pt_packet_decoder *decoder,
+		      struct ptdump_tracking *tracking,
+		      const struct ptdump_options *options,
+		      const struct pt_config *config,
+		      struct ptdump_watch *watch)
+{
+	int errcode;
+
+	for (;;) {
+		errcode = dump_packets(output, decoder, tracking, options,
+				       config, watch);
+		if (0 <= errcode)
+			return errcode;
 
 		errcode = pt_pkt_sync_forward(decoder);
 		if (errcode < 0) {
 			if (errcode == -pte_eos)
 				return 0;
 
-			return diag("sync error", 0ull, errcode);
+			return diag(output, "sync error", 0ull, errcode);
 		}
 
 		ptdump_tracking_reset(tracking);
 	}
+}
 
-	return errcode;
+static int dump_sync(struct ptdump_output *output,
+		     struct pt_packet_decoder *decoder,
+		     struct ptdump_tracking *tracking,
+		     const struct ptdump_options *options,
+		     const struct pt_config *config)
+{
+	int errcode;
+
+	if (!options)
+		return diag(output, "setup error", 0ull, -pte_internal);
+
+	if (options->no_sync) {
+		errcode = pt_pkt_sync_set(decoder, 0ull);
+		if (errcode < 0)
+			return diag(output, "sync error", 0ull, errcode);
+	} else {
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode < 0) {
+			if (errcode == -pte_eos)
+				return 0;
+
+			return diag(output, "sync error", 0ull, errcode);
+		}
+	}
+
+	return dump_trace(output, decoder, tracking, options, config, NULL);
 }
 
-static int dump(struct ptdump_tracking *tracking,
+static int dump(struct ptdump_output *output,
+		struct ptdump_tracking *tracking,
 		const struct pt_config *config,
 		const struct ptdump_options *options)
 {
@@ -1462,9 +2102,9 @@ static int dump(struct ptdump_tracking *tracking,
 
 	decoder = pt_pkt_alloc_decoder(config);
 	if (!decoder)
-		return diag("failed to allocate decoder", 0ull, 0);
+		return diag(output, "failed to allocate decoder", 0ull, 0);
 
-	errcode = dump_sync(decoder, tracking, options, config);
+	errcode = dump_sync(output, decoder, tracking, options, config);
 
 	pt_pkt_free_decoder(decoder);
 
@@ -1472,15 +2112,456 @@ static int dump(struct ptdump_tracking *tracking,
 		return errcode;
 
 #if defined(FEATURE_SIDEBAND)
-	errcode = pt_sb_dump(tracking->session, stdout, options->sb_dump_flags,
-			     UINT64_MAX);
-	if (errcode < 0)
-		return diag("sideband dump error", UINT64_MAX, errcode);
+	if (options->has_sideband) {
+		(void) ptdump_flush(output);
+
+		errcode = pt_sb_dump(tracking->session, output->stream,
+				     options->sb_dump_flags, UINT64_MAX);
+		if (errcode < 0)
+			return diag(output, "sideband dump error", UINT64_MAX,
+				    errcode);
+	}
 #endif
 
 	return 0;
 }
 
+#if defined(FEATURE_THREADS)
+
+/* Split the trace into chunks of adjacent trace segments.
+ *
+ * The first chunk starts at the beginning of the trace if @options->no_sync is
+ * set and at the first PSB packet, otherwise.  Chunks are at least @size bytes
+ * big, except for the last.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no trace segment.
+ */
+static int ptdump_split_chunks(struct ptdump_parallel *parallel,
+			       const struct pt_config *config,
+			       const struct ptdump_options *options,
+			       uint32_t nthreads)
+{
+	struct pt_packet_decoder *decoder;
+	struct ptdump_chunk *chunks;
+	uint64_t begin, size, offset;
+	uint32_t nchunks, capacity;
+	int errcode;
+
+	if (!parallel || !config || !options || !nthreads)
+		return -pte_internal;
+
+	decoder = pt_pkt_alloc_decoder(config);
+	if (!decoder)
+		return -pte_nomem;
+
+	if (options->no_sync)
+		errcode = pt_pkt_sync_set(decoder, 0ull);
+	else
+		errcode = pt_pkt_sync_forward(decoder);
+	if (errcode < 0)
+		goto out_decoder;
+
+	errcode = pt_pkt_get_sync_offset(decoder, &begin);
+	if (errcode < 0)
+		goto out_decoder;
+
+	size = (uint64_t) (config->end - config->begin) - begin;
+	size /= (uint64_t) nthreads * ptdump_chunks_per_thread;
+
+	chunks = NULL;
+	nchunks = 0;
+	capacity = 0;
+	for (;;) {
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				break;
+
+			offset = UINT64_MAX;
+		} else {
+			errcode = pt_pkt_get_sync_offset(decoder, &offset);
+			if (errcode < 0)
+				break;
+
+			if ((offset - begin) < size)
+				continue;
+		}
+
+		if (nchunks == capacity) {
+			struct ptdump_chunk *grown;
+
+			capacity = capacity ? capacity * 2 : nthreads;
+
+			grown = realloc(chunks, capacity * sizeof(*chunks));
+			if (!grown) {
+				errcode = -pte_nomem;
+				break;
+			}
+
+			chunks = grown;
+		}
+
+		memset(&chunks[nchunks], 0, sizeof(chunks[nchunks]));
+		chunks[nchunks].begin = begin;
+		chunks[nchunks].end = offset;
+		nchunks += 1;
+
+		if (offset == UINT64_MAX) {
+			errcode = 0;
+			break;
+		}
+
+		begin = offset;
+	}
+
+	if (errcode < 0) {
+		free(chunks);
+		goto out_decoder;
+	}
+
+	parallel->chunks = chunks;
+	parallel->nchunks = nchunks;
+
+out_decoder:
+	pt_pkt_free_decoder(decoder);
+	return errcode;
+}
+
+/* Claim the next chunk to dump.
+ *
+ * Returns the chunk on success, NULL if there are no more chunks to dump or
+ * if another thread failed.
+ */
+static struct ptdump_chunk *ptdump_next_chunk(struct ptdump_parallel *parallel)
+{
+	struct ptdump_chunk *chunk;
+
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return NULL;
+
+	chunk = NULL;
+	if (!parallel->errcode && (parallel->next < parallel->nchunks))
+		chunk = &parallel->chunks[parallel->next++];
+
+	(void) mtx_unlock(&parallel->lock);
+
+	return chunk;
+}
+
+/* Mark @chunk dumped or, if @errcode is negative, report an error. */
+static void ptdump_chunk_done(struct ptdump_parallel *parallel,
+			      struct ptdump_chunk *chunk, int errcode)
+{
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return;
+
+	if (errcode < 0) {
+		if (!parallel->errcode)
+			parallel->errcode = errcode;
+	} else if (chunk)
+		chunk->done = 1;
+
+	(void) cnd_broadcast(&parallel->dumped);
+	(void) mtx_unlock(&parallel->lock);
+}
+
+/* Dump @chunk into a temporary file.
+ *
+ * We start with a fresh tracking state and stop before the first PSB packet at
+ * or beyond the end of @chunk.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptdump_dump_chunk(struct pt_packet_decoder *decoder,
+			     struct ptdump_chunk *chunk,
+			     const struct ptdump_parallel *parallel)
+{
+	struct ptdump_tracking tracking;
+	struct ptdump_output output;
+	struct ptdump_watch watch;
+	int errcode, status;
+
+	if (!chunk || !parallel)
+		return -pte_internal;
+
+	chunk->stream = tmpfile();
+	if (!chunk->stream) {
+		fprintf(stderr, "%s: failed to create temporary file: %s.\n",
+			parallel->prog, strerror(errno));
+		return -pte_nomem;
+	}
+
+	errcode = ptdump_output_init(&output, chunk->stream);
+	if (errcode < 0)
+		return errcode;
+
+	output.binary = parallel->options->binary;
+
+	ptdump_tracking_init(&tracking);
+
+	memset(&watch, 0, sizeof(watch));
+	watch.end = chunk->end;
+	watch.chunk = chunk;
+
+	/* We only get here with a bad offset for the first chunk when not
+	 * syncing, where the sequential dump reports the same error.
+	 */
+	status = pt_pkt_sync_set(decoder, chunk->begin);
+	if (status < 0)
+		status = diag(&output, "sync error", 0ull, status);
+	else
+		status = dump_trace(&output, decoder, &tracking,
+				    parallel->options, parallel->config,
+				    &watch);
+
+	if (!chunk->stopped) {
+		chunk->outpos = ptdump_tell(&output);
+		chunk->status = status;
+	}
+
+	ptdump_tracking_fini(&tracking);
+
+	return ptdump_output_fini(&output);
+}
+
+static int ptdump_dump_thread(void *arg)
+{
+	struct ptdump_parallel *parallel;
+	struct pt_packet_decoder *decoder;
+	struct ptdump_chunk *chunk;
+	int errcode;
+
+	parallel = (struct ptdump_parallel *) arg;
+	if (!parallel)
+		return -pte_internal;
+
+	decoder = pt_pkt_alloc_decoder(parallel->config);
+	if (!decoder) {
+		ptdump_chunk_done(parallel, NULL, -pte_nomem);
+		return -pte_nomem;
+	}
+
+	errcode = 0;
+	for (;;) {
+		chunk = ptdump_next_chunk(parallel);
+		if (!chunk)
+			break;
+
+		errcode = ptdump_dump_chunk(decoder, chunk, parallel);
+		if (errcode < 0)
+			break;
+
+		ptdump_chunk_done(parallel, chunk, 0);
+	}
+
+	if (errcode < 0)
+		ptdump_chunk_done(parallel, NULL, errcode);
+
+	pt_pkt_free_decoder(decoder);
+
+	return errcode;
+}
+
+/* Print @chunk's output from @begin to @chunk->outpos. */
+static int ptdump_print_chunk(struct ptdump_output *output,
+			      struct ptdump_chunk *chunk, uint64_t begin)
+{
+	char buffer[ptdump_copy_size];
+	uint64_t end;
+	FILE *stream;
+	int errcode;
+
+	if (!output || !chunk)
+		return -pte_internal;
+
+	stream = chunk->stream;
+	chunk->stream = NULL;
+	if (!stream)
+		return -pte_internal;
+
+	errcode = ptdump_flush(output);
+
+	end = chunk->outpos;
+	if ((end < begin) || ((uint64_t) (long) begin != begin) ||
+	    fseek(stream, (long) begin, SEEK_SET))
+		errcode = -pte_internal;
+
+	while (!errcode && (begin < end)) {
+		size_t size, read, written;
+
+		size = sizeof(buffer);
+		if ((end - begin) < size)
+			size = (size_t) (end - begin);
+
+		read = fread(buffer, 1, size, stream);
+		written = fwrite(buffer, 1, read, output->stream);
+		output->written += written;
+		if (!read || (written != read))
+			errcode = -pte_bad_file;
+
+		begin += read;
+	}
+
+	fclose(stream);
+
+	return errcode;
+}
+
+/* Dump the trace on @options->threads threads in parallel.
+ *
+ * We split the trace into chunks of adjacent trace segments and dump each
+ * chunk into a temporary file on its own.
+ *
+ * The main thread prints the chunks in trace order.  Between two chunks, it
+ * continues dumping itself from where the first chunk stopped until its
+ * tracking state matches one of the second chunk's checkpoints.  This is
+ * usually the second chunk's first PSB+ header.  The output is the same as
+ * when dumping the trace sequentially.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int dump_parallel(struct ptdump_output *output,
+			 const struct pt_config *config,
+			 const struct ptdump_options *options,
+			 const char *prog)
+{
+	struct pt_packet_decoder *decoder;
+	struct ptdump_parallel parallel;
+	thrd_t *threads;
+	uint32_t nthreads, idx;
+	uint64_t outpos;
+	int errcode, status, result;
+
+	if (!output || !config || !options || !prog)
+		return -pte_internal;
+
+	memset(&parallel, 0, sizeof(parallel));
+	parallel.config = config;
+	parallel.options = options;
+	parallel.prog = prog;
+
+	nthreads = options->threads;
+
+	errcode = ptdump_split_chunks(&parallel, config, options, nthreads);
+	if (errcode < 0) {
+		/* There is nothing to dump without trace segments. */
+		if (errcode == -pte_eos)
+			return 0;
+
+		return diag(output, "sync error", 0ull, errcode);
+	}
+
+	if (parallel.nchunks < nthreads)
+		nthreads = parallel.nchunks;
+
+	errcode = -pte_nomem;
+	decoder = pt_pkt_alloc_decoder(config);
+	if (!decoder)
+		goto out_chunks;
+
+	threads = malloc(nthreads * sizeof(*threads));
+	if (!threads)
+		goto out_decoder;
+
+	errcode = -pte_bad_lock;
+	if (mtx_init(&parallel.lock, mtx_plain) != thrd_success)
+		goto out_threads;
+
+	if (cnd_init(&parallel.dumped) != thrd_success)
+		goto out_lock;
+
+	for (idx = 0; idx < nthreads; ++idx) {
+		if (thrd_create(&threads[idx], ptdump_dump_thread,
+				&parallel) != thrd_success) {
+			ptdump_chunk_done(&parallel, NULL, -pte_nomem);
+			break;
+		}
+	}
+	nthreads = idx;
+
+	/* Print the chunks in trace order as they are dumped. */
+	idx = 0;
+	outpos = 0ull;
+	status = 0;
+	for (;;) {
+		struct ptdump_tracking tracking;
+		struct ptdump_chunk *chunk;
+		struct ptdump_watch watch;
+
+		chunk = &parallel.chunks[idx];
+
+		errcode = ptdump_wait_chunk(&parallel, chunk);
+		if (errcode < 0)
+			break;
+
+		errcode = ptdump_print_chunk(output, chunk, outpos);
+		if (errcode < 0)
+			break;
+
+		if (!chunk->stopped) {
+			status = chunk->status;
+			break;
+		}
+
+		memset(&watch, 0, sizeof(watch));
+		watch.end = UINT64_MAX;
+		watch.parallel = &parallel;
+		watch.next = idx + 1;
+
+		tracking = chunk->tracking;
+		output->bin = chunk->bin;
+
+		/* The chunk's dump thread just decoded a PSB packet there. */
+		errcode = pt_pkt_sync_set(decoder, chunk->stop);
+		if (errcode < 0)
+			break;
+
+		status = dump_trace(output, decoder, &tracking, options,
+				    config, &watch);
+		if (status <= 0)
+			break;
+
+		idx = watch.next;
+		outpos = watch.outpos;
+	}
+
+	/* Stop dump threads that are still working on chunks we don't need. */
+	ptdump_chunk_done(&parallel, NULL, -pte_eos);
+
+	for (idx = 0; idx < nthreads; ++idx)
+		(void) thrd_join(&threads[idx], &result);
+
+	if (errcode < 0)
+		fprintf(stderr, "%s: parallel dump failed: %s.\n", prog,
+			pt_errstr(pt_errcode(errcode)));
+	else
+		errcode = status;
+
+	cnd_destroy(&parallel.dumped);
+
+out_lock:
+	mtx_destroy(&parallel.lock);
+
+out_threads:
+	free(threads);
+
+out_decoder:
+	pt_pkt_free_decoder(decoder);
+
+out_chunks:
+	for (idx = 0; idx < parallel.nchunks; ++idx) {
+		if (parallel.chunks[idx].stream)
+			fclose(parallel.chunks[idx].stream);
+	}
+
+	free(parallel.chunks);
+
+	return errcode;
+}
+
+#endif /* defined(FEATURE_THREADS) */
+
 #if defined(FEATURE_SIDEBAND)
 
 static int ptdump_print_error(int errcode, const char *filename,
@@ -1738,6 +2819,17 @@ static int process_args(int argc, char *argv[],
 			options->no_wall_clock = 1;
 		else if (strcmp(argv[idx], "--keep-tcal-on-ovf") == 0)
 			options->keep_tcal_on_ovf = 1;
+		else if (strcmp(argv[idx], "--format=text") == 0)
+			options->binary = 0;
+		else if (strcmp(argv[idx], "--format=bin") == 0)
+			options->binary = 1;
+#if defined(FEATURE_THREADS)
+		else if (strcmp(argv[idx], "--threads") == 0) {
+			if (!get_arg_uint32(&options->threads, "--threads",
+					    argv[++idx], argv[0]))
+				return -1;
+		}
+#endif /* defined(FEATURE_THREADS) */
 #if defined(FEATURE_SIDEBAND)
 		else if ((strcmp(argv[idx], "--sb:compact") == 0) ||
 			 (strcmp(argv[idx], "--sb") == 0)) {
@@ -1777,6 +2869,7 @@ static int process_args(int argc, char *argv[],
 			 * correlation.
 			 */
 			options->track_time = 1;
+			options->has_sideband = 1;
 		} else if (strcmp(argv[idx], "--pevent:sample-type") == 0) {
 			if (!get_arg_uint64(&pevent.sample_type,
 					    "--pevent:sample-type",
@@ -1807,6 +2900,10 @@ static int process_args(int argc, char *argv[],
 					    "--pevent:kernel-start",
 					    argv[++idx], argv[0]))
 				return -1;
+#if defined(FEATURE_THREADS)
+		} else if (strcmp(argv[idx], "--pevent:prefetch") == 0) {
+			pevent.prefetch = 1;
+#endif /* defined(FEATURE_THREADS) */
 		} else if ((strcmp(argv[idx], "--pevent:sysroot") == 0) ||
 			   (strcmp(argv[idx], "--pevent:kcore") == 0) ||
 			   (strcmp(argv[idx], "--pevent:vdso-x64") == 0) ||
@@ -1878,6 +2975,7 @@ int main(int argc, char *argv[])
 {
 	struct ptdump_tracking tracking;
 	struct ptdump_options options;
+	struct ptdump_output output;
 	struct pt_config config;
 	int errcode;
 	char *ptfile;
@@ -1893,6 +2991,14 @@ int main(int argc, char *argv[])
 
 	ptdump_tracking_init(&tracking);
 
+	memset(&output, 0, sizeof(output));
+	errcode = ptdump_output_init(&output, stdout);
+	if (errcode < 0) {
+		fprintf(stderr,
+			"%s: failed to allocate output buffer.\n", argv[0]);
+		goto out;
+	}
+
 #if defined(FEATURE_SIDEBAND)
 	tracking.session = pt_sb_alloc(NULL);
 	if (!tracking.session) {
@@ -1918,6 +3024,49 @@ int main(int argc, char *argv[])
 		goto out;
 	}
 
+#if defined(FEATURE_THREADS) && defined(FEATURE_SIDEBAND)
+	/* Sideband records are printed in order with the trace, which a dump
+	 * thread can't do.
+	 */
+	if ((options.threads > 1) && options.has_sideband) {
+		fprintf(stderr, "%s: --threads does not support sideband.\n",
+			argv[0]);
+		errcode = -1;
+		goto out;
+	}
+#endif /* defined(FEATURE_THREADS) && defined(FEATURE_SIDEBAND) */
+
+	if (options.binary) {
+		char *pos;
+
+		/* The binary packet stream has no room for either. */
+		if (options.show_tcal) {
+			fprintf(stderr, "%s: --format=bin does not support "
+				"--tcal.\n", argv[0]);
+			errcode = -1;
+			goto out;
+		}
+
+#if defined(FEATURE_SIDEBAND)
+		if (options.has_sideband) {
+			fprintf(stderr, "%s: --format=bin does not support "
+				"sideband.\n", argv[0]);
+			errcode = -1;
+			goto out;
+		}
+#endif /* defined(FEATURE_SIDEBAND) */
+
+		output.binary = 1;
+
+		pos = ptdump_reserve(&output, ptdb_header_size);
+		errcode = ptdb_write_header((uint8_t *) pos,
+					    (uint8_t *) output.end);
+		if (errcode < 0)
+			goto out;
+
+		output.pos = pos + errcode;
+	}
+
 	errcode = preprocess_filename(ptfile, &pt_offset, &pt_size);
 	if (errcode < 0) {
 		fprintf(stderr, "%s: bad file %s: %s.\n", argv[0], ptfile,
@@ -1928,7 +3077,8 @@ int main(int argc, char *argv[])
 	if (config.cpu.vendor) {
 		errcode = pt_cpu_errata(&config.errata, &config.cpu);
 		if (errcode < 0)
-			diag("failed to determine errata", 0ull, errcode);
+			diag(&output, "failed to determine errata", 0ull,
+			     errcode);
 	}
 
 	errcode = load_pt(&config, ptfile, pt_offset, pt_size, argv[0]);
@@ -1936,6 +3086,9 @@ int main(int argc, char *argv[])
 		goto out;
 
 #if defined(FEATURE_SIDEBAND)
+	/* Sideband errors are printed directly to the stream. */
+	(void) ptdump_flush(&output);
+
 	errcode = pt_sb_init_decoders(tracking.session);
 	if (errcode < 0) {
 		fprintf(stderr,
@@ -1945,9 +3098,17 @@ int main(int argc, char *argv[])
 	}
 #endif /* defined(FEATURE_SIDEBAND) */
 
-	errcode = dump(&tracking, &config, &options);
+#if defined(FEATURE_THREADS)
+	if (options.threads > 1)
+		errcode = dump_parallel(&output, &config, &options, argv[0]);
+	else
+		errcode = dump(&output, &tracking, &config, &options);
+#else
+	errcode = dump(&output, &tracking, &config, &options);
+#endif /* defined(FEATURE_THREADS) */
 
 out:
+	(void) ptdump_output_fini(&output);
 	free(config.begin);
 	ptdump_tracking_fini(&tracking);
 
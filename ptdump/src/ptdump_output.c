@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptdump_output.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <stdarg.h>
+
+
+int ptdump_output_init(struct ptdump_output *output, FILE *stream)
+{
+	char *begin;
+
+	if (!output || !stream)
+		return -pte_internal;
+
+	begin = malloc(ptdump_output_size);
+	if (!begin)
+		return -pte_nomem;
+
+	output->begin = begin;
+	output->pos = begin;
+	output->end = begin + ptdump_output_size;
+	output->stream = stream;
+	output->written = 0ull;
+	output->binary = 0;
+
+	ptdb_state_init(&output->bin);
+
+	return 0;
+}
+
+int ptdump_flush(struct ptdump_output *output)
+{
+	size_t size, written;
+
+	if (!output)
+		return -pte_internal;
+
+	size = (size_t) (output->pos - output->begin);
+	if (!size)
+		return 0;
+
+	output->pos = output->begin;
+
+	written = fwrite(output->begin, 1, size, output->stream);
+	output->written += written;
+	if (written != size)
+		return -pte_bad_file;
+
+	return 0;
+}
+
+int ptdump_output_fini(struct ptdump_output *output)
+{
+	int errcode;
+
+	if (!output)
+		return -pte_internal;
+
+	errcode = ptdump_flush(output);
+
+	free(output->begin);
+	output->begin = NULL;
+	output->pos = NULL;
+	output->end = NULL;
+
+	return errcode;
+}
+
+char *ptdump_reserve(struct ptdump_output *output, size_t size)
+{
+	if ((size_t) (output->end - output->pos) < size)
+		(void) ptdump_flush(output);
+
+	return output->pos;
+}
+
+void ptdump_printf(struct ptdump_output *output, const char *format, ...)
+{
+	va_list ap;
+	size_t room;
+	char *pos;
+	int len;
+
+	pos = ptdump_reserve(output, ptdump_max_line);
+	room = (size_t) (output->end - pos);
+
+	va_start(ap, format);
+	len = vsnprintf(pos, room, format, ap);
+	va_end(ap);
+
+	if (len < 0)
+		return;
+
+	if ((size_t) len < room) {
+		output->pos = pos + len;
+		return;
+	}
+
+	/* Lines that do not fit into the output buffer bypass it. */
+	(void) ptdump_flush(output);
+
+	va_start(ap, format);
+	len = vfprintf(output->stream, format, ap);
+	va_end(ap);
+
+	if (0 < len)
+		output->written += (uint64_t) len;
+}
+
+const char ptdump_hex_digits[] = "0123456789abcdef";
+
+char *fmt_hex(char *pos, uint64_t value, int width)
+{
+	char digits[16];
+	int ndigits;
+
+	ndigits = 0;
+	do {
+		digits[ndigits++] = ptdump_hex_digits[value & 0xf];
+		value >>= 4;
+	} while (value);
+
+	if (16 < width)
+		width = 16;
+
+	for (; ndigits < width; ++ndigits)
+		digits[ndigits] = '0';
+
+	while (ndigits)
+		*pos++ = digits[--ndigits];
+
+	return pos;
+}
+
+char *fmt_str(char *pos, const char *str)
+{
+	while (*str)
+		*pos++ = *str++;
+
+	return pos;
+}
+
+void set_field(char *field, size_t size, const char *begin,
+	       const char *end)
+{
+	size_t len;
+
+	if (!size)
+		return;
+
+	len = (size_t) (end - begin);
+	if (size <= len)
+		len = size - 1;
+
+	memcpy(field, begin, len);
+	field[len] = 0;
+}
+
+void set_field_str(char *field, size_t size, const char *str)
+{
+	size_t len;
+
+	if (!size)
+		return;
+
+	for (len = 0; (len < (size - 1)) && str[len]; ++len)
+		field[len] = str[len];
+
+	field[len] = 0;
+}
+
+void set_field_hex(char *field, size_t size, uint64_t value,
+		   int width)
+{
+	char text[16];
+
+	set_field(field, size, text, fmt_hex(text, value, width));
+}
+
+char *fmt_field(char *pos, const char *field, size_t size,
+		size_t width)
+{
+	size_t len;
+
+	for (len = 0; (len < size) && field[len]; ++len)
+		*pos++ = field[len];
+
+	for (; len < width; ++len)
+		*pos++ = ' ';
+
+	return pos;
+}
+
+int ptdump_print_buffer(struct ptdump_output *output,
+			const struct ptdump_buffer *buffer, int show_offset)
+{
+	char *pos;
+
+	if (!output || !buffer)
+		return -pte_internal;
+
+	/* The fields are bounded by their size so the whole line fits. */
+	pos = ptdump_reserve(output, ptdump_max_line);
+
+	/* Make sure the first column starts at the beginning of the line - no
+	 * matter what column is first.
+	 */
+
+	if (show_offset) {
+		pos = fmt_field(pos, buffer->offset, sizeof(buffer->offset),
+				sizeof(buffer->offset));
+		*pos++ = ' ';
+	}
+
+	if (buffer->raw[0]) {
+		pos = fmt_field(pos, buffer->raw, sizeof(buffer->raw),
+				sizeof(buffer->raw));
+		*pos++ = ' ';
+	}
+
+	if (buffer->payload.standard[0])
+		pos = fmt_field(pos, buffer->opcode, sizeof(buffer->opcode),
+				sizeof(buffer->opcode));
+	else
+		pos = fmt_field(pos, buffer->opcode, sizeof(buffer->opcode),
+				0);
+
+	/* We printed at least one column.  From this point on, we don't need
+	 * the separator any longer.
+	 */
+
+	if (buffer->use_ext_payload) {
+		*pos++ = ' ';
+		pos = fmt_field(pos, buffer->payload.extended,
+				sizeof(buffer->payload.extended), 0);
+	} else if (buffer->tracking.id[0]) {
+		*pos++ = ' ';
+		pos = fmt_field(pos, buffer->payload.standard,
+				sizeof(buffer->payload),
+				sizeof(buffer->payload.standard));
+
+		*pos++ = ' ';
+		pos = fmt_field(pos, buffer->tracking.id,
+				sizeof(buffer->tracking.id),
+				sizeof(buffer->tracking.id));
+		pos = fmt_field(pos, buffer->tracking.payload,
+				sizeof(buffer->tracking.payload), 0);
+	} else if (buffer->payload.standard[0]) {
+		*pos++ = ' ';
+		pos = fmt_field(pos, buffer->payload.standard,
+				sizeof(buffer->payload), 0);
+	}
+
+	*pos++ = '\n';
+
+	output->pos = pos;
+	return 0;
+}
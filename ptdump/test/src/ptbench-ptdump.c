@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptdump_output.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#  define PTBENCH_NULL_DEVICE "NUL"
+#else
+#  define PTBENCH_NULL_DEVICE "/dev/null"
+#endif
+
+
+/* The benchmark configuration. */
+struct bench_options {
+	/* The number of lines formatted per round. */
+	uint32_t nlines;
+
+	/* The number of rounds. */
+	uint32_t nrounds;
+};
+
+enum {
+	/* The number of different packet lines we print. */
+	bench_nbuffers	= 4
+};
+
+/* The packet lines we print. */
+static struct ptdump_buffer bench_buffers[bench_nbuffers];
+
+static int usage(const char *prog)
+{
+	printf("usage: %s [<options>]\n\n", prog);
+	printf("options:\n");
+	printf("  --help|-h            this text.\n");
+	printf("  --lines <n>          format <n> lines per round.\n");
+	printf("                       (default: 1000000)\n");
+	printf("  --rounds <n>         run <n> rounds.\n");
+	printf("                       (default: 10)\n");
+
+	return 1;
+}
+
+static int parse_uint32(uint32_t *value, const char *arg)
+{
+	char *rest;
+	unsigned long val;
+
+	if (!value || !arg)
+		return -pte_internal;
+
+	errno = 0;
+	val = strtoul(arg, &rest, 0);
+	if (errno || *rest || !val || (UINT32_MAX < val))
+		return -pte_invalid;
+
+	*value = (uint32_t) val;
+	return 0;
+}
+
+/* Mimic typical ptdump output: mostly tnt and tip with the occasional tsc. */
+static void bench_mk_buffers(void)
+{
+	struct ptdump_buffer *buffer;
+
+	memset(bench_buffers, 0, sizeof(bench_buffers));
+
+	buffer = &bench_buffers[0];
+	print_field_str(buffer->opcode, "tnt.8");
+	print_field_str(buffer->payload.standard, "!!.!.");
+
+	buffer = &bench_buffers[1];
+	print_field_str(buffer->opcode, "tip");
+	print_field_str(buffer->payload.standard, "3: 00007f1234567890");
+	print_field_str(buffer->tracking.id, "ip");
+	print_field_hex(buffer->tracking.payload, 0x7f1234567890ull, 16);
+
+	buffer = &bench_buffers[2];
+	print_field_str(buffer->opcode, "tnt.64");
+	print_field_str(buffer->payload.standard, "!!!..!.!!.!!!..!");
+
+	buffer = &bench_buffers[3];
+	print_field_str(buffer->opcode, "tsc");
+	print_field_hex(buffer->payload.standard, 0x1234567890abcull, 0);
+	print_field_str(buffer->tracking.id, "tsc");
+	print_field_hex(buffer->tracking.payload, 0x1234567890abcull, 16);
+}
+
+static uint64_t bench_fmt_hex(struct ptdump_output *output, uint32_t nlines)
+{
+	uint64_t sum;
+	uint32_t line;
+
+	sum = 0ull;
+	for (line = 0; line < nlines; ++line) {
+		uint64_t value;
+		char *pos;
+
+		value = line * 0x9e3779b9ull;
+
+		pos = ptdump_reserve(output, ptdump_max_line);
+		pos = fmt_hex(pos, (uint64_t) line << 4, 16);
+		*pos++ = ' ';
+		pos = fmt_hex(pos, value, 0);
+		*pos++ = '\n';
+
+		sum += (uint64_t) (pos - output->pos);
+		output->pos = pos;
+	}
+
+	return sum;
+}
+
+static uint64_t bench_snprintf(struct ptdump_output *output, uint32_t nlines)
+{
+	uint64_t sum;
+	uint32_t line;
+
+	sum = 0ull;
+	for (line = 0; line < nlines; ++line) {
+		uint64_t value;
+		char *pos;
+		int len;
+
+		value = line * 0x9e3779b9ull;
+
+		pos = ptdump_reserve(output, ptdump_max_line);
+		len = snprintf(pos, ptdump_max_line, "%016" PRIx64 " %" PRIx64
+			       "\n", (uint64_t) line << 4, value);
+		if (len < 0)
+			continue;
+
+		sum += (uint64_t) len;
+		output->pos = pos + len;
+	}
+
+	return sum;
+}
+
+static uint64_t bench_print_buffer(struct ptdump_output *output,
+				   uint32_t nlines)
+{
+	uint64_t sum;
+	uint32_t line;
+
+	sum = 0ull;
+	for (line = 0; line < nlines; ++line) {
+		struct ptdump_buffer *buffer;
+		int errcode;
+
+		buffer = &bench_buffers[line % bench_nbuffers];
+		print_field_hex(buffer->offset, (uint64_t) line << 2, 16);
+
+		errcode = ptdump_print_buffer(output, buffer, 1);
+		if (errcode < 0)
+			return 0ull;
+
+		sum += 1ull;
+	}
+
+	return sum;
+}
+
+static uint64_t bench_printf(struct ptdump_output *output, uint32_t nlines)
+{
+	uint32_t line;
+
+	for (line = 0; line < nlines; ++line)
+		ptdump_printf(output, "[%" PRIx64 ": %s]\n",
+			      (uint64_t) line << 2, "error");
+
+	return (uint64_t) nlines;
+}
+
+static int bench_run(const char *name,
+		     uint64_t (*bench)(struct ptdump_output *, uint32_t),
+		     struct ptdump_output *output,
+		     const struct bench_options *options)
+{
+	clock_t begin, end;
+	uint64_t sum, written;
+	double seconds, nlines;
+	uint32_t round;
+	int errcode;
+
+	if (!bench || !output || !options)
+		return -pte_internal;
+
+	written = output->written;
+	sum = 0ull;
+
+	begin = clock();
+	for (round = 0; round < options->nrounds; ++round)
+		sum += bench(output, options->nlines);
+
+	errcode = ptdump_flush(output);
+	end = clock();
+
+	if (errcode < 0)
+		return errcode;
+
+	seconds = (double) (end - begin) / CLOCKS_PER_SEC;
+	nlines = (double) options->nlines * options->nrounds;
+
+	printf("%-14s %8.3f s  %8.2f ns/line  %8.2f bytes/line  "
+	       "(sum: %" PRIx64 ")\n", name, seconds,
+	       seconds ? ((seconds * 1e9) / nlines) : 0.0,
+	       (double) (output->written - written) / nlines, sum);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options options;
+	struct ptdump_output output;
+	FILE *stream;
+	int idx, errcode;
+
+	options.nlines = 1000000;
+	options.nrounds = 10;
+
+	for (idx = 1; idx < argc; ++idx) {
+		const char *arg;
+
+		arg = argv[idx];
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+			return usage(argv[0]);
+
+		if (strcmp(arg, "--lines") == 0) {
+			if (argc <= ++idx)
+				return usage(argv[0]);
+
+			errcode = parse_uint32(&options.nlines, argv[idx]);
+			if (errcode < 0)
+				return usage(argv[0]);
+
+			continue;
+		}
+
+		if (strcmp(arg, "--rounds") == 0) {
+			if (argc <= ++idx)
+				return usage(argv[0]);
+
+			errcode = parse_uint32(&options.nrounds, argv[idx]);
+			if (errcode < 0)
+				return usage(argv[0]);
+
+			continue;
+		}
+
+		fprintf(stderr, "%s: unknown option: %s.\n", argv[0], arg);
+		return 1;
+	}
+
+	/* We measure formatting and buffering, not the output device. */
+	stream = fopen(PTBENCH_NULL_DEVICE, "wb");
+	if (!stream) {
+		fprintf(stderr, "%s: failed to open %s.\n", argv[0],
+			PTBENCH_NULL_DEVICE);
+		return 1;
+	}
+
+	errcode = ptdump_output_init(&output, stream);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to allocate output: %d.\n",
+			argv[0], errcode);
+		fclose(stream);
+		return 1;
+	}
+
+	bench_mk_buffers();
+
+	printf("%" PRIu32 " lines, %" PRIu32 " rounds\n", options.nlines,
+	       options.nrounds);
+
+	errcode = bench_run("fmt_hex", bench_fmt_hex, &output, &options);
+	if (errcode >= 0)
+		errcode = bench_run("snprintf", bench_snprintf, &output,
+				    &options);
+	if (errcode >= 0)
+		errcode = bench_run("print_buffer", bench_print_buffer,
+				    &output, &options);
+	if (errcode >= 0)
+		errcode = bench_run("ptdump_printf", bench_printf, &output,
+				    &options);
+
+	(void) ptdump_output_fini(&output);
+	fclose(stream);
+
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to write output: %d.\n", argv[0],
+			errcode);
+		return 1;
+	}
+
+	return 0;
+}
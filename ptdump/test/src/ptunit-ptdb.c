@@ -0,0 +1,668 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "ptdb.h"
+
+
+/* A test fixture. */
+struct ptdb_fixture {
+	/* A memory buffer. */
+	uint8_t buffer[1024];
+
+	/* Two records:
+	 *
+	 *   record[0] is the test setup
+	 *   record[1] is the record after writing and reading record[0]
+	 */
+	struct ptdb_record record[2];
+
+	/* The write and read delta encoding states. */
+	struct ptdb_state state[2];
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct ptdb_fixture *);
+	struct ptunit_result (*fini)(struct ptdb_fixture *);
+};
+
+static struct ptunit_result dfix_init(struct ptdb_fixture *dfix)
+{
+	memset(dfix->buffer, 0xcd, sizeof(dfix->buffer));
+
+	ptdb_record_init(&dfix->record[0]);
+	ptdb_record_init(&dfix->record[1]);
+
+	ptdb_state_init(&dfix->state[0]);
+	ptdb_state_init(&dfix->state[1]);
+
+	dfix->record[0].offset = 0x1000ull;
+	dfix->record[0].packet.size = 1;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result dfix_read_write(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int size[2];
+
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	size[0] = ptdb_write(&dfix->record[0], begin, end, &dfix->state[0]);
+	ptu_int_gt(size[0], 0);
+	ptu_int_le(size[0], ptdb_max_record_size);
+
+	size[1] = ptdb_read(&dfix->record[1], begin, end, &dfix->state[1]);
+	ptu_int_gt(size[1], 0);
+
+	ptu_int_eq(size[1], size[0]);
+
+	ptu_uint_eq(dfix->record[1].offset, dfix->record[0].offset);
+	ptu_uint_eq(dfix->record[1].flags, dfix->record[0].flags);
+	ptu_uint_eq(dfix->state[1].offset, dfix->state[0].offset);
+	ptu_uint_eq(dfix->state[1].tsc, dfix->state[0].tsc);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result dfix_check_packet(struct ptdb_fixture *dfix)
+{
+	ptu_int_eq(dfix->record[1].packet.type, dfix->record[0].packet.type);
+	ptu_uint_eq(dfix->record[1].packet.size, dfix->record[0].packet.size);
+	ptu_int_eq(memcmp(&dfix->record[1].packet.payload,
+			  &dfix->record[0].packet.payload,
+			  sizeof(dfix->record[0].packet.payload)), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header(void)
+{
+	uint8_t buffer[ptdb_header_size];
+	int size;
+
+	size = ptdb_write_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(size, ptdb_header_size);
+
+	size = ptdb_read_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(size, ptdb_header_size);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_null(void)
+{
+	uint8_t buffer[ptdb_header_size];
+	int errcode;
+
+	errcode = ptdb_write_header(NULL, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_write_header(buffer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_read_header(NULL, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_read_header(buffer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_eos(void)
+{
+	uint8_t buffer[ptdb_header_size];
+	int errcode;
+
+	errcode = ptdb_write_header(buffer, buffer + sizeof(buffer) - 1);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = ptdb_write_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, ptdb_header_size);
+
+	errcode = ptdb_read_header(buffer, buffer + sizeof(buffer) - 1);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_file(void)
+{
+	uint8_t buffer[ptdb_header_size];
+	int errcode;
+
+	errcode = ptdb_write_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, ptdb_header_size);
+
+	buffer[0] = 'P';
+
+	errcode = ptdb_read_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_bad_file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_version(void)
+{
+	uint8_t buffer[ptdb_header_size];
+	int errcode;
+
+	errcode = ptdb_write_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, ptdb_header_size);
+
+	buffer[4] += 1;
+
+	errcode = ptdb_read_header(buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_not_supported);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_null(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int errcode;
+
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	errcode = ptdb_write(NULL, begin, end, &dfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_write(&dfix->record[0], NULL, end, &dfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_write(&dfix->record[0], begin, NULL, &dfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_write(&dfix->record[0], begin, end, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_null(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int errcode;
+
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	errcode = ptdb_read(NULL, begin, end, &dfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_read(&dfix->record[1], NULL, end, &dfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_read(&dfix->record[1], begin, NULL, &dfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdb_read(&dfix->record[1], begin, end, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_eos(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin;
+	int size, errcode;
+
+	dfix->record[0].packet.type = ppt_tsc;
+	dfix->record[0].packet.size = 8;
+	dfix->record[0].packet.payload.tsc.tsc = 0xa0b0c0d0e0ull;
+
+	begin = dfix->buffer;
+
+	size = ptdb_write(&dfix->record[0], begin,
+			  begin + sizeof(dfix->buffer), &dfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	ptdb_state_init(&dfix->state[0]);
+	memset(dfix->buffer, 0xcd, sizeof(dfix->buffer));
+
+	errcode = ptdb_write(&dfix->record[0], begin, begin + size - 1,
+			     &dfix->state[0]);
+	ptu_int_eq(errcode, -pte_eos);
+	ptu_uint_eq(dfix->state[0].offset, 0ull);
+	ptu_uint_eq(dfix->buffer[0], 0xcd);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_eos(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin;
+	int size, errcode;
+
+	dfix->record[0].packet.type = ppt_tip;
+	dfix->record[0].packet.size = 7;
+	dfix->record[0].packet.payload.ip.ipc = pt_ipc_sext_48;
+	dfix->record[0].packet.payload.ip.ip = 0xffffffff81000000ull;
+	dfix->record[0].flags = ptdb_last_ip;
+	dfix->record[0].last_ip = 0xffffffff81000000ull;
+
+	begin = dfix->buffer;
+
+	size = ptdb_write(&dfix->record[0], begin,
+			  begin + sizeof(dfix->buffer), &dfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	for (; size > 0; --size) {
+		errcode = ptdb_read(&dfix->record[1], begin, begin + size - 1,
+				    &dfix->state[1]);
+		ptu_int_eq(errcode, -pte_eos);
+		ptu_uint_eq(dfix->state[1].offset, 0ull);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_bad_packet(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int errcode;
+
+	dfix->record[0].packet.type = (enum pt_packet_type) 0xff;
+
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	errcode = ptdb_write(&dfix->record[0], begin, end, &dfix->state[0]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result read_bad_packet(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int size, errcode;
+
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	size = ptdb_write(&dfix->record[0], begin, end, &dfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	/* The type follows the one-byte offset delta. */
+	begin[1] = 0xff;
+
+	errcode = ptdb_read(&dfix->record[1], begin, end, &dfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result no_payload(struct ptdb_fixture *dfix,
+				       enum pt_packet_type type)
+{
+	dfix->record[0].packet.type = type;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ip(struct ptdb_fixture *dfix,
+			       enum pt_packet_type type)
+{
+	dfix->record[0].packet.type = type;
+	dfix->record[0].packet.size = 7;
+	dfix->record[0].packet.payload.ip.ipc = pt_ipc_sext_48;
+	dfix->record[0].packet.payload.ip.ip = 0x7fffa0b0c0d0ull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tnt(struct ptdb_fixture *dfix,
+				enum pt_packet_type type)
+{
+	dfix->record[0].packet.type = type;
+	dfix->record[0].packet.payload.tnt.bit_size = 47;
+	dfix->record[0].packet.payload.tnt.payload = 0x5a5a5a5a5a5aull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mode_exec(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_mode;
+	dfix->record[0].packet.size = 2;
+	dfix->record[0].packet.payload.mode.leaf = pt_mol_exec;
+	dfix->record[0].packet.payload.mode.bits.exec.csl = 1;
+	dfix->record[0].packet.payload.mode.bits.exec.csd = 0;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mode_tsx(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_mode;
+	dfix->record[0].packet.size = 2;
+	dfix->record[0].packet.payload.mode.leaf = pt_mol_tsx;
+	dfix->record[0].packet.payload.mode.bits.tsx.intx = 0;
+	dfix->record[0].packet.payload.mode.bits.tsx.abrt = 1;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pip(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_pip;
+	dfix->record[0].packet.size = 8;
+	dfix->record[0].packet.payload.pip.cr3 = 0x4200ull;
+	dfix->record[0].packet.payload.pip.nr = 1;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result vmcs(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_vmcs;
+	dfix->record[0].packet.size = 7;
+	dfix->record[0].packet.payload.vmcs.base = 0xcdcdc000ull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cbr(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_cbr;
+	dfix->record[0].packet.size = 4;
+	dfix->record[0].packet.payload.cbr.ratio = 0x38;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tsc(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_tsc;
+	dfix->record[0].packet.size = 8;
+	dfix->record[0].packet.payload.tsc.tsc = 0xffffffffffffffull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tma(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_tma;
+	dfix->record[0].packet.size = 7;
+	dfix->record[0].packet.payload.tma.ctc = 0xffff;
+	dfix->record[0].packet.payload.tma.fc = 0x1ff;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mtc(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_mtc;
+	dfix->record[0].packet.size = 2;
+	dfix->record[0].packet.payload.mtc.ctc = 0xa3;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cyc(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_cyc;
+	dfix->record[0].packet.size = 3;
+	dfix->record[0].packet.payload.cyc.value = 0x3fffull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mnt(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_mnt;
+	dfix->record[0].packet.size = 11;
+	dfix->record[0].packet.payload.mnt.payload = 0xa0b0c0d0e0f01020ull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result exstop(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_exstop;
+	dfix->record[0].packet.size = 2;
+	dfix->record[0].packet.payload.exstop.ip = 1;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result mwait(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_mwait;
+	dfix->record[0].packet.size = 10;
+	dfix->record[0].packet.payload.mwait.hints = 0xa0;
+	dfix->record[0].packet.payload.mwait.ext = 0x3;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pwre(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_pwre;
+	dfix->record[0].packet.size = 4;
+	dfix->record[0].packet.payload.pwre.state = 0xc;
+	dfix->record[0].packet.payload.pwre.sub_state = 0x3;
+	dfix->record[0].packet.payload.pwre.hw = 1;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pwrx(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_pwrx;
+	dfix->record[0].packet.size = 7;
+	dfix->record[0].packet.payload.pwrx.last = 0x3;
+	dfix->record[0].packet.payload.pwrx.deepest = 0x6;
+	dfix->record[0].packet.payload.pwrx.store = 1;
+	dfix->record[0].packet.payload.pwrx.autonomous = 1;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result ptw(struct ptdb_fixture *dfix)
+{
+	dfix->record[0].packet.type = ppt_ptw;
+	dfix->record[0].packet.size = 10;
+	dfix->record[0].packet.payload.ptw.plc = 1;
+	dfix->record[0].packet.payload.ptw.ip = 1;
+	dfix->record[0].packet.payload.ptw.payload = 0xa0b0c0d0e0f0ull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result diag(struct ptdb_fixture *dfix, int errcode)
+{
+	dfix->record[0].flags = ptdb_diag;
+	dfix->record[0].errcode = errcode;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_int_eq(dfix->record[1].errcode, errcode);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result tracking(struct ptdb_fixture *dfix)
+{
+	uint8_t *begin, *end;
+	int size;
+
+	dfix->record[0].packet.type = ppt_tip;
+	dfix->record[0].packet.size = 3;
+	dfix->record[0].packet.payload.ip.ipc = pt_ipc_update_16;
+	dfix->record[0].packet.payload.ip.ip = 0xc0d0ull;
+	dfix->record[0].flags = ptdb_last_ip | ptdb_tsc;
+	dfix->record[0].last_ip = 0x7fffa0b0c0d0ull;
+	dfix->record[0].tsc = 0x1000000ull;
+
+	ptu_test(dfix_read_write, dfix);
+	ptu_test(dfix_check_packet, dfix);
+	ptu_uint_eq(dfix->record[1].last_ip, dfix->record[0].last_ip);
+	ptu_uint_eq(dfix->record[1].tsc, dfix->record[0].tsc);
+
+	/* A second record is encoded relative to the first, even if it goes
+	 * back in the trace.
+	 */
+	begin = dfix->buffer;
+	end = begin + sizeof(dfix->buffer);
+
+	dfix->record[0].offset -= 0x10;
+	dfix->record[0].tsc += 0x20;
+	dfix->record[0].flags = ptdb_tsc;
+
+	size = ptdb_write(&dfix->record[0], begin, end, &dfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	size = ptdb_read(&dfix->record[1], begin, end, &dfix->state[1]);
+	ptu_int_gt(size, 0);
+
+	ptu_uint_eq(dfix->record[1].offset, 0xff0ull);
+	ptu_uint_eq(dfix->record[1].tsc, 0x1000020ull);
+	ptu_uint_eq(dfix->record[1].flags, ptdb_tsc);
+	ptu_uint_eq(dfix->record[1].last_ip, 0ull);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptdb_fixture dfix;
+	struct ptunit_suite suite;
+
+	dfix.init = dfix_init;
+	dfix.fini = NULL;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, header);
+	ptu_run(suite, header_null);
+	ptu_run(suite, header_eos);
+	ptu_run(suite, header_bad_file);
+	ptu_run(suite, header_bad_version);
+
+	ptu_run_f(suite, write_null, dfix);
+	ptu_run_f(suite, read_null, dfix);
+	ptu_run_f(suite, write_eos, dfix);
+	ptu_run_f(suite, read_eos, dfix);
+	ptu_run_f(suite, write_bad_packet, dfix);
+	ptu_run_f(suite, read_bad_packet, dfix);
+
+	ptu_run_fp(suite, no_payload, dfix, ppt_pad);
+	ptu_run_fp(suite, no_payload, dfix, ppt_psb);
+	ptu_run_fp(suite, no_payload, dfix, ppt_psbend);
+	ptu_run_fp(suite, no_payload, dfix, ppt_stop);
+	ptu_run_fp(suite, no_payload, dfix, ppt_ovf);
+	ptu_run_fp(suite, no_payload, dfix, ppt_unknown);
+	ptu_run_fp(suite, ip, dfix, ppt_fup);
+	ptu_run_fp(suite, ip, dfix, ppt_tip);
+	ptu_run_fp(suite, ip, dfix, ppt_tip_pge);
+	ptu_run_fp(suite, ip, dfix, ppt_tip_pgd);
+	ptu_run_fp(suite, tnt, dfix, ppt_tnt_8);
+	ptu_run_fp(suite, tnt, dfix, ppt_tnt_64);
+	ptu_run_f(suite, mode_exec, dfix);
+	ptu_run_f(suite, mode_tsx, dfix);
+	ptu_run_f(suite, pip, dfix);
+	ptu_run_f(suite, vmcs, dfix);
+	ptu_run_f(suite, cbr, dfix);
+	ptu_run_f(suite, tsc, dfix);
+	ptu_run_f(suite, tma, dfix);
+	ptu_run_f(suite, mtc, dfix);
+	ptu_run_f(suite, cyc, dfix);
+	ptu_run_f(suite, mnt, dfix);
+	ptu_run_f(suite, exstop, dfix);
+	ptu_run_f(suite, mwait, dfix);
+	ptu_run_f(suite, pwre, dfix);
+	ptu_run_f(suite, pwrx, dfix);
+	ptu_run_f(suite, ptw, dfix);
+
+	ptu_run_fp(suite, diag, dfix, 0);
+	ptu_run_fp(suite, diag, dfix, -pte_bad_opc);
+
+	ptu_run_f(suite, tracking, dfix);
+
+	return ptunit_report(&suite);
+}
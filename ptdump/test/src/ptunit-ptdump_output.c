@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "ptdump_output.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+enum {
+	/* The size of the test fixture's output buffer. */
+	pofix_size	= 32
+};
+
+/* A test fixture writing into a small output buffer. */
+struct output_fixture {
+	/* The output. */
+	struct ptdump_output output;
+
+	/* The output buffer. */
+	char buffer[pofix_size];
+
+	/* The text written to the output stream. */
+	char text[1024];
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct output_fixture *);
+	struct ptunit_result (*fini)(struct output_fixture *);
+};
+
+static struct ptunit_result pofix_init(struct output_fixture *pofix)
+{
+	memset(&pofix->output, 0, sizeof(pofix->output));
+	memset(pofix->text, 0, sizeof(pofix->text));
+
+	pofix->output.begin = pofix->buffer;
+	pofix->output.pos = pofix->buffer;
+	pofix->output.end = pofix->buffer + sizeof(pofix->buffer);
+
+	pofix->output.stream = tmpfile();
+	ptu_ptr(pofix->output.stream);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pofix_fini(struct output_fixture *pofix)
+{
+	fclose(pofix->output.stream);
+
+	return ptu_passed();
+}
+
+/* Read what has been written to the output stream into @pofix->text. */
+static struct ptunit_result pofix_read(struct output_fixture *pofix)
+{
+	size_t size;
+
+	rewind(pofix->output.stream);
+	size = fread(pofix->text, 1, sizeof(pofix->text) - 1,
+		     pofix->output.stream);
+	pofix->text[size] = 0;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fmt_hex_zero(void)
+{
+	char text[17], *end;
+
+	end = fmt_hex(text, 0ull, 0);
+	*end = 0;
+	ptu_str_eq(text, "0");
+
+	end = fmt_hex(text, 0ull, 4);
+	*end = 0;
+	ptu_str_eq(text, "0000");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fmt_hex_value(void)
+{
+	char text[17], *end;
+
+	end = fmt_hex(text, 0xcafeull, 0);
+	*end = 0;
+	ptu_str_eq(text, "cafe");
+
+	/* Values wider than @width are not truncated. */
+	end = fmt_hex(text, 0xcafeull, 2);
+	*end = 0;
+	ptu_str_eq(text, "cafe");
+
+	end = fmt_hex(text, 0xcafeull, 8);
+	*end = 0;
+	ptu_str_eq(text, "0000cafe");
+
+	end = fmt_hex(text, 0xffffffffffffffffull, 0);
+	*end = 0;
+	ptu_str_eq(text, "ffffffffffffffff");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fmt_hex_width(void)
+{
+	char text[17], *end;
+
+	/* The width is capped at 16 digits. */
+	end = fmt_hex(text, 0x1ull, 20);
+	ptu_ptr_eq(end, &text[16]);
+
+	*end = 0;
+	ptu_str_eq(text, "0000000000000001");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fmt_field_pad(void)
+{
+	char text[16], *end;
+
+	end = fmt_field(text, "abc", 4, 6);
+	*end = 0;
+	ptu_str_eq(text, "abc   ");
+
+	end = fmt_field(text, "abc", 4, 0);
+	*end = 0;
+	ptu_str_eq(text, "abc");
+
+	end = fmt_field(text, "", 4, 2);
+	*end = 0;
+	ptu_str_eq(text, "  ");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fmt_field_size(void)
+{
+	const char field[4] = { 'a', 'b', 'c', 'd' };
+	char text[16], *end;
+
+	/* A field that fills its buffer is not zero-terminated. */
+	end = fmt_field(text, field, sizeof(field), 0);
+	*end = 0;
+	ptu_str_eq(text, "abcd");
+
+	end = fmt_field(text, field, 2, 3);
+	*end = 0;
+	ptu_str_eq(text, "ab ");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result printf_buffered(struct output_fixture *pofix)
+{
+	ptdump_printf(&pofix->output, "[%x: %s]\n", 0x2a, "test");
+	ptu_ptr_eq(pofix->output.pos, pofix->buffer + 11);
+	ptu_uint_eq(pofix->output.written, 0ull);
+
+	ptu_int_eq(ptdump_flush(&pofix->output), 0);
+	ptu_ptr_eq(pofix->output.pos, pofix->buffer);
+	ptu_uint_eq(pofix->output.written, 11ull);
+
+	ptu_test(pofix_read, pofix);
+	ptu_str_eq(pofix->text, "[2a: test]\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result printf_bypass(struct output_fixture *pofix)
+{
+	const char *line;
+
+	/* The line is longer than the output buffer. */
+	line = "0123456789abcdef0123456789abcdef0123456789abcdef";
+
+	ptdump_printf(&pofix->output, "a\n");
+	ptdump_printf(&pofix->output, "%s\n", line);
+
+	/* The buffered output has been flushed before the long line. */
+	ptu_ptr_eq(pofix->output.pos, pofix->buffer);
+	ptu_uint_eq(pofix->output.written, 2ull + strlen(line) + 1ull);
+
+	ptdump_printf(&pofix->output, "b\n");
+	ptu_int_eq(ptdump_flush(&pofix->output), 0);
+
+	ptu_test(pofix_read, pofix);
+	ptu_str_eq(pofix->text, "a\n0123456789abcdef0123456789abcdef"
+		   "0123456789abcdef\nb\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result print_buffer(void)
+{
+	struct ptdump_output output;
+	struct ptdump_buffer buffer;
+	char text[ptdump_max_line + 1];
+	int errcode;
+
+	memset(&output, 0, sizeof(output));
+	output.begin = text;
+	output.pos = text;
+	output.end = text + sizeof(text);
+
+	memset(&buffer, 0, sizeof(buffer));
+	print_field_hex(buffer.offset, 0x10ull, 16);
+	print_field_str(buffer.opcode, "tip");
+	print_field_str(buffer.payload.standard, "3: ffffffff");
+
+	errcode = ptdump_print_buffer(&output, &buffer, 1);
+	ptu_int_eq(errcode, 0);
+
+	*output.pos = 0;
+	ptu_str_eq(text, "0000000000000010  tip        3: ffffffff\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result print_buffer_null(void)
+{
+	struct ptdump_output output;
+	struct ptdump_buffer buffer;
+	int errcode;
+
+	memset(&output, 0, sizeof(output));
+	memset(&buffer, 0, sizeof(buffer));
+
+	errcode = ptdump_print_buffer(NULL, &buffer, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptdump_print_buffer(&output, NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct output_fixture pofix;
+	struct ptunit_suite suite;
+
+	pofix.init = pofix_init;
+	pofix.fini = pofix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, fmt_hex_zero);
+	ptu_run(suite, fmt_hex_value);
+	ptu_run(suite, fmt_hex_width);
+	ptu_run(suite, fmt_field_pad);
+	ptu_run(suite, fmt_field_size);
+
+	ptu_run_f(suite, printf_buffered, pofix);
+	ptu_run_f(suite, printf_bypass, pofix);
+
+	ptu_run(suite, print_buffer);
+	ptu_run(suite, print_buffer_null);
+
+	return ptunit_report(&suite);
+}
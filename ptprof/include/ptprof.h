@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PTPROF_H
+#define PTPROF_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+/* The binary execution profile format.
+ *
+ * A profile counts executions of code identified by the file section it
+ * was loaded from and the offset into that section.  Unlike image section
+ * identifiers or virtual addresses, this identity is the same for all
+ * decoders of a trace, so profiles of different parts of a trace can be
+ * merged.
+ *
+ * The profile starts with an eight-byte header:
+ *
+ *   "ptpf"         the magic
+ *   version        one byte, ptprof_version
+ *   reserved       three zero bytes
+ *
+ * followed by the section table:
+ *
+ *   nsections      varint, the number of sections
+ *
+ * and one entry per section, sorted by ptprof_section_compare():
+ *
+ *   filename       the zero-terminated name of the file, empty if unknown
+ *   offset         varint, the offset into the file
+ *   size           varint, the size of the section
+ *
+ * Sections are referred to by their index into the section table.
+ *
+ * The section table is followed by records, sorted by ptprof_compare()
+ * without duplicates, and terminated by a ptprof_end record.  Each record
+ * consists of:
+ *
+ *   type           one byte, the record type (enum ptprof_type)
+ *   section        varint, the difference to the previous record's section
+ *   offset         varint, the difference to the previous record's offset
+ *                  if section is zero, the offset itself otherwise
+ *
+ * A ptprof_code record is followed by:
+ *
+ *   count          varint, the number of executions
+ *   insn           varint, the number of executed instructions
+ *   time           varint, the time spent executing the code
+ *
+ * A ptprof_edge record is followed by:
+ *
+ *   to_section     varint, the section of the edge's target
+ *   to_offset      varint, the offset of the edge's target
+ *   count          varint, the number of times the edge was taken
+ *
+ * A ptprof_end record consists of the type byte only.
+ *
+ * A varint is an unsigned integer in little-endian base 128, i.e. seven bits
+ * per byte with the most significant bit set on all but the last byte.
+ */
+
+enum {
+	/* The size of the fixed part of the profile header in bytes. */
+	ptprof_header_size		= 8,
+
+	/* The maximal size of the profile header including the size of the
+	 * section table in bytes.
+	 */
+	ptprof_max_header_size		= ptprof_header_size + 5,
+
+	/* The format version. */
+	ptprof_version			= 1,
+
+	/* The maximal size of a section table entry's filename in bytes
+	 * including the terminating zero.
+	 */
+	ptprof_max_filename_size	= 4096,
+
+	/* The maximal size of a section table entry in bytes. */
+	ptprof_max_section_size		= ptprof_max_filename_size + 20,
+
+	/* The maximal size of a record in bytes. */
+	ptprof_max_record_size		= 64
+};
+
+/* The record types. */
+enum ptprof_type {
+	/* The end of the profile. */
+	ptprof_end,
+
+	/* Executions of code starting at a given offset.
+	 *
+	 * Depending on the decoder, this is an instruction or a block of
+	 * instructions.
+	 */
+	ptprof_code,
+
+	/* Transfers of control from code at a given offset. */
+	ptprof_edge
+};
+
+/* A section table entry. */
+struct ptprof_section {
+	/* The name of the file - empty if unknown. */
+	const char *filename;
+
+	/* The offset into @filename. */
+	uint64_t offset;
+
+	/* The size of the section in bytes. */
+	uint64_t size;
+};
+
+/* A profile record. */
+struct ptprof_record {
+	/* The record type. */
+	enum ptprof_type type;
+
+	/* The section containing the code. */
+	uint32_t section;
+
+	/* The offset of the code into @section. */
+	uint64_t offset;
+
+	/* The section and offset of the edge's target.
+	 *
+	 * This is only used for ptprof_edge.
+	 */
+	uint32_t to_section;
+	uint64_t to_offset;
+
+	/* The number of executions. */
+	uint64_t count;
+
+	/* The number of executed instructions.
+	 *
+	 * This is only used for ptprof_code.
+	 */
+	uint64_t insn;
+
+	/* The time spent executing the code.
+	 *
+	 * This is only used for ptprof_code.
+	 */
+	uint64_t time;
+};
+
+static inline void ptprof_record_init(struct ptprof_record *record)
+{
+	memset(record, 0, sizeof(*record));
+}
+
+/* The delta encoding state.
+ *
+ * Records are encoded relative to their predecessor.  Reading and writing
+ * a profile each need a state that is passed to consecutive calls.
+ */
+struct ptprof_state {
+	/* The previous record's key. */
+	struct ptprof_record last;
+
+	/* The number of sections. */
+	uint32_t nsections;
+
+	/* A flag saying whether @last is valid. */
+	uint32_t have_last:1;
+
+	/* A flag saying whether the end record has been read or written. */
+	uint32_t ended:1;
+};
+
+static inline void ptprof_state_init(struct ptprof_state *state,
+				     uint32_t nsections)
+{
+	memset(state, 0, sizeof(*state));
+	state->nsections = nsections;
+}
+
+/* Compare two sections.
+ *
+ * Sections are ordered by filename, offset, and size.
+ *
+ * Returns a negative value if @lhs comes before @rhs, a positive value if
+ * @lhs comes after @rhs, and zero if both are the same section.
+ */
+extern int ptprof_section_compare(const struct ptprof_section *lhs,
+				  const struct ptprof_section *rhs);
+
+/* Compare two records by their key.
+ *
+ * Records are ordered by section, offset, type, and, for edges, by their
+ * target section and offset.  Counts are ignored.
+ *
+ * Returns a negative value if @lhs comes before @rhs, a positive value if
+ * @lhs comes after @rhs, and zero if both have the same key.
+ */
+extern int ptprof_compare(const struct ptprof_record *lhs,
+			  const struct ptprof_record *rhs);
+
+/* Write the profile header and the size of the section table.
+ *
+ * Writes the header followed by @nsections into [@begin; @end[.  At most
+ * ptprof_max_header_size bytes are written.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ * Returns -pte_eos if the header does not fit into [@begin; @end[.
+ * Returns -pte_internal if @begin or @end is NULL.
+ */
+extern int ptprof_write_header(uint8_t *begin, uint8_t *end,
+			       uint32_t nsections);
+
+/* Read the profile header and the size of the section table.
+ *
+ * Checks the header at @begin and provides the number of sections in
+ * @nsections.
+ *
+ * Returns the number of bytes read on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_file if [@begin; @end[ does not start with a header.
+ * Returns -pte_eos if the header does not fit into [@begin; @end[.
+ * Returns -pte_internal if @nsections, @begin, or @end is NULL.
+ * Returns -pte_not_supported if the format version is not supported.
+ */
+extern int ptprof_read_header(uint32_t *nsections, const uint8_t *begin,
+			      const uint8_t *end);
+
+/* Write a section table entry.
+ *
+ * Writes @section into [@begin; @end[.  At most ptprof_max_section_size
+ * bytes are written.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ * Returns -pte_eos if the entry does not fit into [@begin; @end[.
+ * Returns -pte_internal if @section, its filename, @begin, or @end is NULL.
+ * Returns -pte_invalid if @section's filename is too long.
+ */
+extern int ptprof_write_section(const struct ptprof_section *section,
+				uint8_t *begin, uint8_t *end);
+
+/* Read a section table entry.
+ *
+ * Reads one section table entry from [@begin; @end[ into @section.  The
+ * filename points into [@begin; @end[.
+ *
+ * Returns the number of bytes read on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_packet if the entry is corrupt.
+ * Returns -pte_eos if the entry does not fit into [@begin; @end[.
+ * Returns -pte_internal if @section, @begin, or @end is NULL.
+ */
+extern int ptprof_read_section(struct ptprof_section *section,
+			       const uint8_t *begin, const uint8_t *end);
+
+/* Write a record.
+ *
+ * Writes @record into [@begin; @end[ relative to @state and updates @state.
+ * At most ptprof_max_record_size bytes are written.
+ *
+ * Returns the number of bytes written on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_packet if @record's type is not supported.
+ * Returns -pte_eos if the record does not fit into [@begin; @end[.
+ * Returns -pte_internal if @record, @begin, @end, or @state is NULL.
+ * Returns -pte_invalid if @record refers to a section outside of the
+ * section table or does not come after the previous record.
+ * Returns -pte_invalid if the end record has already been written.
+ */
+extern int ptprof_write(const struct ptprof_record *record, uint8_t *begin,
+			uint8_t *end, struct ptprof_state *state);
+
+/* Read a record.
+ *
+ * Reads one record from [@begin; @end[ relative to @state into @record and
+ * updates @state.
+ *
+ * Returns the number of bytes read on success, a negative error code
+ * otherwise.
+ * Returns -pte_bad_packet if the record is corrupt, refers to a section
+ * outside of the section table, or does not come after the previous record.
+ * Returns -pte_eos if the record does not fit into [@begin; @end[.
+ * Returns -pte_eos if the end record has already been read.
+ * Returns -pte_internal if @record, @begin, @end, or @state is NULL.
+ */
+extern int ptprof_read(struct ptprof_record *record, const uint8_t *begin,
+		       const uint8_t *end, struct ptprof_state *state);
+
+#endif /* PTPROF_H */
@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptprof.h"
+
+
+static const uint8_t ptprof_magic[4] = { 'p', 't', 'p', 'f' };
+
+/* Write @value as varint at *@pos and advance *@pos.
+ *
+ * The caller makes sure there is room for ten bytes.
+ */
+static void ptprof_put_varint(uint8_t **pos, uint64_t value)
+{
+	uint8_t *out;
+
+	out = *pos;
+	while (0x80 <= value) {
+		*out++ = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+
+	*out++ = (uint8_t) value;
+	*pos = out;
+}
+
+static int ptprof_get_varint(uint64_t *value, const uint8_t **pos,
+			     const uint8_t *end)
+{
+	const uint8_t *in;
+	uint64_t result;
+	uint8_t shift;
+
+	in = *pos;
+	result = 0ull;
+	for (shift = 0; shift < 64; shift += 7) {
+		uint8_t byte;
+
+		if (end <= in)
+			return -pte_eos;
+
+		byte = *in++;
+		result |= (uint64_t) (byte & 0x7f) << shift;
+
+		if (!(byte & 0x80)) {
+			*value = result;
+			*pos = in;
+			return 0;
+		}
+	}
+
+	return -pte_bad_packet;
+}
+
+/* Read a varint section index at *@pos and advance *@pos.
+ *
+ * Returns -pte_bad_packet if the index is not smaller than @nsections.
+ */
+static int ptprof_get_section(uint32_t *section, const uint8_t **pos,
+			      const uint8_t *end, uint32_t nsections)
+{
+	uint64_t value;
+	int errcode;
+
+	errcode = ptprof_get_varint(&value, pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	if (nsections <= value)
+		return -pte_bad_packet;
+
+	*section = (uint32_t) value;
+	return 0;
+}
+
+int ptprof_section_compare(const struct ptprof_section *lhs,
+			   const struct ptprof_section *rhs)
+{
+	int cmp;
+
+	cmp = strcmp(lhs->filename, rhs->filename);
+	if (cmp)
+		return cmp;
+
+	if (lhs->offset != rhs->offset)
+		return (lhs->offset < rhs->offset) ? -1 : 1;
+
+	if (lhs->size != rhs->size)
+		return (lhs->size < rhs->size) ? -1 : 1;
+
+	return 0;
+}
+
+int ptprof_compare(const struct ptprof_record *lhs,
+		   const struct ptprof_record *rhs)
+{
+	if (lhs->section != rhs->section)
+		return (lhs->section < rhs->section) ? -1 : 1;
+
+	if (lhs->offset != rhs->offset)
+		return (lhs->offset < rhs->offset) ? -1 : 1;
+
+	if (lhs->type != rhs->type)
+		return (lhs->type < rhs->type) ? -1 : 1;
+
+	if (lhs->type != ptprof_edge)
+		return 0;
+
+	if (lhs->to_section != rhs->to_section)
+		return (lhs->to_section < rhs->to_section) ? -1 : 1;
+
+	if (lhs->to_offset != rhs->to_offset)
+		return (lhs->to_offset < rhs->to_offset) ? -1 : 1;
+
+	return 0;
+}
+
+int ptprof_write_header(uint8_t *begin, uint8_t *end, uint32_t nsections)
+{
+	uint8_t buffer[ptprof_max_header_size], *pos;
+	size_t size;
+
+	if (!begin || !end)
+		return -pte_internal;
+
+	memset(buffer, 0, ptprof_header_size);
+	memcpy(buffer, ptprof_magic, sizeof(ptprof_magic));
+	buffer[sizeof(ptprof_magic)] = ptprof_version;
+
+	pos = buffer + ptprof_header_size;
+	ptprof_put_varint(&pos, nsections);
+
+	size = (size_t) (pos - buffer);
+	if ((size_t) (end - begin) < size)
+		return -pte_eos;
+
+	memcpy(begin, buffer, size);
+
+	return (int) size;
+}
+
+int ptprof_read_header(uint32_t *nsections, const uint8_t *begin,
+		       const uint8_t *end)
+{
+	const uint8_t *pos;
+	uint64_t value;
+	int errcode;
+
+	if (!nsections || !begin || !end)
+		return -pte_internal;
+
+	if ((end - begin) < ptprof_header_size)
+		return -pte_eos;
+
+	if (memcmp(begin, ptprof_magic, sizeof(ptprof_magic)) != 0)
+		return -pte_bad_file;
+
+	if (begin[sizeof(ptprof_magic)] != ptprof_version)
+		return -pte_not_supported;
+
+	pos = begin + ptprof_header_size;
+	errcode = ptprof_get_varint(&value, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	if (UINT32_MAX < value)
+		return -pte_bad_file;
+
+	*nsections = (uint32_t) value;
+
+	return (int) (pos - begin);
+}
+
+int ptprof_write_section(const struct ptprof_section *section,
+			 uint8_t *begin, uint8_t *end)
+{
+	uint8_t buffer[20], *pos;
+	size_t length, size;
+
+	if (!section || !section->filename || !begin || !end)
+		return -pte_internal;
+
+	length = strlen(section->filename) + 1;
+	if (ptprof_max_filename_size < length)
+		return -pte_invalid;
+
+	pos = buffer;
+	ptprof_put_varint(&pos, section->offset);
+	ptprof_put_varint(&pos, section->size);
+
+	size = (size_t) (pos - buffer);
+	if ((size_t) (end - begin) < (length + size))
+		return -pte_eos;
+
+	memcpy(begin, section->filename, length);
+	memcpy(begin + length, buffer, size);
+
+	return (int) (length + size);
+}
+
+int ptprof_read_section(struct ptprof_section *section, const uint8_t *begin,
+			const uint8_t *end)
+{
+	const uint8_t *pos, *limit;
+	int errcode;
+
+	if (!section || !begin || !end)
+		return -pte_internal;
+
+	limit = end;
+	if (ptprof_max_filename_size < (end - begin))
+		limit = begin + ptprof_max_filename_size;
+
+	pos = memchr(begin, 0, (size_t) (limit - begin));
+	if (!pos)
+		return (limit == end) ? -pte_eos : -pte_bad_packet;
+
+	section->filename = (const char *) begin;
+	pos += 1;
+
+	errcode = ptprof_get_varint(&section->offset, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = ptprof_get_varint(&section->size, &pos, end);
+	if (errcode < 0)
+		return errcode;
+
+	return (int) (pos - begin);
+}
+
+int ptprof_write(const struct ptprof_record *record, uint8_t *begin,
+		 uint8_t *end, struct ptprof_state *state)
+{
+	uint8_t buffer[ptprof_max_record_size], *pos;
+	size_t size;
+
+	if (!record || !begin || !end || !state)
+		return -pte_internal;
+
+	if (state->ended)
+		return -pte_invalid;
+
+	/* We encode into a local buffer so we only need to check for room
+	 * once.
+	 */
+	pos = buffer;
+	*pos++ = (uint8_t) record->type;
+
+	switch (record->type) {
+	case ptprof_end:
+		break;
+
+	case ptprof_code:
+	case ptprof_edge:
+		if (state->nsections <= record->section)
+			return -pte_invalid;
+
+		if (state->have_last &&
+		    (ptprof_compare(record, &state->last) <= 0))
+			return -pte_invalid;
+
+		ptprof_put_varint(&pos, record->section -
+				  state->last.section);
+		ptprof_put_varint(&pos, record->section == state->last.section
+				  ? record->offset - state->last.offset
+				  : record->offset);
+
+		if (record->type == ptprof_code) {
+			ptprof_put_varint(&pos, record->count);
+			ptprof_put_varint(&pos, record->insn);
+			ptprof_put_varint(&pos, record->time);
+		} else {
+			if (state->nsections <= record->to_section)
+				return -pte_invalid;
+
+			ptprof_put_varint(&pos, record->to_section);
+			ptprof_put_varint(&pos, record->to_offset);
+			ptprof_put_varint(&pos, record->count);
+		}
+		break;
+
+	default:
+		return -pte_bad_packet;
+	}
+
+	size = (size_t) (pos - buffer);
+	if ((size_t) (end - begin) < size)
+		return -pte_eos;
+
+	memcpy(begin, buffer, size);
+
+	if (record->type == ptprof_end)
+		state->ended = 1;
+	else {
+		state->last = *record;
+		state->have_last = 1;
+	}
+
+	return (int) size;
+}
+
+int ptprof_read(struct ptprof_record *record, const uint8_t *begin,
+		const uint8_t *end, struct ptprof_state *state)
+{
+	struct ptprof_record rec;
+	const uint8_t *pos;
+	uint64_t value;
+	int errcode;
+
+	if (!record || !begin || !end || !state)
+		return -pte_internal;
+
+	if (state->ended || (end <= begin))
+		return -pte_eos;
+
+	ptprof_record_init(&rec);
+
+	pos = begin;
+	rec.type = (enum ptprof_type) *pos++;
+
+	switch (rec.type) {
+	case ptprof_end:
+		break;
+
+	case ptprof_code:
+	case ptprof_edge:
+		errcode = ptprof_get_varint(&value, &pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		if ((state->nsections <= state->last.section) ||
+		    ((state->nsections - state->last.section) <= value))
+			return -pte_bad_packet;
+
+		rec.section = state->last.section + (uint32_t) value;
+
+		errcode = ptprof_get_varint(&value, &pos, end);
+		if (errcode < 0)
+			return errcode;
+
+		if (rec.section == state->last.section) {
+			if ((UINT64_MAX - state->last.offset) < value)
+				return -pte_bad_packet;
+
+			value += state->last.offset;
+		}
+
+		rec.offset = value;
+
+		if (rec.type == ptprof_code) {
+			errcode = ptprof_get_varint(&rec.count, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = ptprof_get_varint(&rec.insn, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = ptprof_get_varint(&rec.time, &pos, end);
+			if (errcode < 0)
+				return errcode;
+		} else {
+			errcode = ptprof_get_section(&rec.to_section, &pos,
+						     end, state->nsections);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = ptprof_get_varint(&rec.to_offset, &pos, end);
+			if (errcode < 0)
+				return errcode;
+
+			errcode = ptprof_get_varint(&rec.count, &pos, end);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		if (state->have_last &&
+		    (ptprof_compare(&rec, &state->last) <= 0))
+			return -pte_bad_packet;
+
+		break;
+
+	default:
+		return -pte_bad_packet;
+	}
+
+	*record = rec;
+
+	if (rec.type == ptprof_end)
+		state->ended = 1;
+	else {
+		state->last = rec;
+		state->have_last = 1;
+	}
+
+	return (int) (pos - begin);
+}
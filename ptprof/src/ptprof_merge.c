@@ -0,0 +1,822 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_version.h"
+
+#include "intel-pt.h"
+
+#include "ptprof.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+
+
+enum {
+	/* The size of each input and of the output buffer in bytes.
+	 *
+	 * This must hold at least one section table entry.
+	 */
+	ptprof_buffer_size	= 64 * 1024
+};
+
+/* An input profile.
+ *
+ * We read each input profile in chunks of ptprof_buffer_size bytes so the
+ * memory we need does not depend on the size of the profiles.  Only the
+ * section tables are kept in memory.
+ */
+struct ptprof_input {
+	/* The file and its name. */
+	FILE *file;
+	const char *filename;
+
+	/* The buffer holding the next bytes of @file. */
+	uint8_t *buffer;
+
+	/* The unread part of @buffer. */
+	const uint8_t *pos;
+	const uint8_t *end;
+
+	/* The section table with filenames copied out of @buffer. */
+	struct ptprof_section *sections;
+	uint32_t nsections;
+
+	/* The index into the merged section table for each of @sections. */
+	uint32_t *map;
+
+	/* The record delta decoding state. */
+	struct ptprof_state state;
+
+	/* The current record with sections mapped into the merged section
+	 * table.
+	 */
+	struct ptprof_record record;
+
+	/* A flag saying whether @file has been read completely. */
+	uint32_t eof:1;
+};
+
+/* The output profile. */
+struct ptprof_output {
+	/* The file and its name - NULL if printing text to stdout. */
+	FILE *file;
+	const char *filename;
+
+	/* The buffer collecting the next bytes of @file. */
+	uint8_t *buffer;
+
+	/* The unused part of @buffer. */
+	uint8_t *pos;
+	uint8_t *end;
+
+	/* The merged section table. */
+	const struct ptprof_section **sections;
+	uint32_t nsections;
+
+	/* The record delta encoding state. */
+	struct ptprof_state state;
+};
+
+static int help(const char *prog)
+{
+	printf("usage: %s [<options>] <profile>...\n\n", prog);
+	printf("Merge binary execution profiles, e.g. written by ptxed --profile:bin, into\n");
+	printf("one profile.  Without --output, print the merged profile as text.\n\n");
+	printf("options:\n");
+	printf("  --help|-h          this text.\n");
+	printf("  --version          display version information and exit.\n");
+	printf("  --output <file>    write the merged profile to <file>.\n");
+
+	return 0;
+}
+
+static int usage(const char *prog)
+{
+	help(prog);
+
+	return 1;
+}
+
+static int version(const char *prog)
+{
+	pt_print_tool_version(prog);
+
+	return 0;
+}
+
+static int bad_option(const char *prog, const char *arg)
+{
+	fprintf(stderr, "%s: unknown option: %s.\n", prog, arg);
+
+	return 1;
+}
+
+static int no_profile(const char *prog)
+{
+	fprintf(stderr, "%s: missing profile.\n", prog);
+
+	return 1;
+}
+
+static int diag(const char *prog, const char *filename, int errcode)
+{
+	fprintf(stderr, "%s: %s: %s.\n", prog, filename,
+		pt_errstr(pt_errcode(errcode)));
+
+	return 1;
+}
+
+/* Make sure @input has at least @size bytes buffered unless it is at the end
+ * of its file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptprof_input_fill(struct ptprof_input *input, size_t size)
+{
+	size_t left, read;
+
+	if (!input)
+		return -pte_internal;
+
+	left = (size_t) (input->end - input->pos);
+	if (input->eof || (size <= left))
+		return 0;
+
+	memmove(input->buffer, input->pos, left);
+
+	read = fread(input->buffer + left, 1, ptprof_buffer_size - left,
+		     input->file);
+	if (ferror(input->file))
+		return -pte_bad_file;
+
+	if (feof(input->file))
+		input->eof = 1;
+
+	input->pos = input->buffer;
+	input->end = input->buffer + left + read;
+
+	return 0;
+}
+
+/* Read the next record of @input into @input->record.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_file if @input ends without an end record.
+ */
+static int ptprof_input_next(struct ptprof_input *input)
+{
+	struct ptprof_record *record;
+	int errcode, size;
+
+	if (!input)
+		return -pte_internal;
+
+	errcode = ptprof_input_fill(input, ptprof_max_record_size);
+	if (errcode < 0)
+		return errcode;
+
+	record = &input->record;
+	size = ptprof_read(record, input->pos, input->end, &input->state);
+	if (size < 0)
+		return (size == -pte_eos) ? -pte_bad_file : size;
+
+	input->pos += size;
+
+	if (record->type == ptprof_end)
+		return 0;
+
+	record->section = input->map[record->section];
+	if (record->type == ptprof_edge)
+		record->to_section = input->map[record->to_section];
+
+	return 0;
+}
+
+/* Open @filename and read its header and section table.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptprof_input_open(struct ptprof_input *input, const char *filename)
+{
+	uint32_t nsections, section;
+	int errcode, size;
+
+	if (!input || !filename)
+		return -pte_internal;
+
+	memset(input, 0, sizeof(*input));
+	input->filename = filename;
+
+	errno = 0;
+	input->file = fopen(filename, "rb");
+	if (!input->file)
+		return -pte_bad_file;
+
+	input->buffer = malloc(ptprof_buffer_size);
+	if (!input->buffer)
+		return -pte_nomem;
+
+	input->pos = input->buffer;
+	input->end = input->buffer;
+
+	errcode = ptprof_input_fill(input, ptprof_max_header_size);
+	if (errcode < 0)
+		return errcode;
+
+	size = ptprof_read_header(&nsections, input->pos, input->end);
+	if (size < 0)
+		return (size == -pte_eos) ? -pte_bad_file : size;
+
+	input->pos += size;
+
+	input->sections = calloc(nsections ? nsections : 1,
+				 sizeof(*input->sections));
+	if (!input->sections)
+		return -pte_nomem;
+
+	input->map = calloc(nsections ? nsections : 1, sizeof(*input->map));
+	if (!input->map)
+		return -pte_nomem;
+
+	for (section = 0; section < nsections; ++section) {
+		struct ptprof_section *psection;
+		char *copy;
+
+		errcode = ptprof_input_fill(input, ptprof_max_section_size);
+		if (errcode < 0)
+			return errcode;
+
+		psection = &input->sections[section];
+		size = ptprof_read_section(psection, input->pos, input->end);
+		if (size < 0)
+			return (size == -pte_eos) ? -pte_bad_file : size;
+
+		input->pos += size;
+
+		copy = malloc(strlen(psection->filename) + 1);
+		if (!copy)
+			return -pte_nomem;
+
+		strcpy(copy, psection->filename);
+		psection->filename = copy;
+		input->nsections = section + 1;
+
+		/* We map records into the merged section table.  This keeps
+		 * them sorted only if the section table is sorted.
+		 */
+		if (section && (ptprof_section_compare(&psection[-1],
+						       psection) >= 0))
+			return -pte_bad_file;
+	}
+
+	ptprof_state_init(&input->state, nsections);
+
+	return 0;
+}
+
+static void ptprof_input_close(struct ptprof_input *input)
+{
+	uint32_t section;
+
+	if (!input)
+		return;
+
+	if (input->sections) {
+		for (section = 0; section < input->nsections; ++section)
+			free((char *) input->sections[section].filename);
+	}
+
+	free(input->sections);
+	free(input->map);
+	free(input->buffer);
+
+	if (input->file)
+		fclose(input->file);
+}
+
+static int ptprof_section_compare_ptr(const void *lhs, const void *rhs)
+{
+	return ptprof_section_compare(*(const struct ptprof_section * const *)
+				      lhs,
+				      *(const struct ptprof_section * const *)
+				      rhs);
+}
+
+/* Merge the section tables of @inputs.
+ *
+ * On success, provides the sorted union of all section tables in @psections
+ * and its size in @pnsections and fills in each input's map.  The merged
+ * table points to the inputs' sections.  The caller is responsible for
+ * freeing @psections.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptprof_merge_sections(const struct ptprof_section ***psections,
+				 uint32_t *pnsections,
+				 struct ptprof_input *inputs, int ninputs)
+{
+	const struct ptprof_section **sections;
+	uint64_t total;
+	uint32_t nsections, section;
+	int input;
+
+	total = 0ull;
+	for (input = 0; input < ninputs; ++input)
+		total += inputs[input].nsections;
+
+	if (UINT32_MAX < total)
+		return -pte_nomem;
+
+	sections = malloc((size_t) (total ? total : 1) * sizeof(*sections));
+	if (!sections)
+		return -pte_nomem;
+
+	nsections = 0;
+	for (input = 0; input < ninputs; ++input) {
+		for (section = 0; section < inputs[input].nsections; ++section)
+			sections[nsections++] =
+				&inputs[input].sections[section];
+	}
+
+	qsort(sections, nsections, sizeof(*sections),
+	      ptprof_section_compare_ptr);
+
+	/* Remove duplicates. */
+	total = nsections;
+	nsections = 0;
+	for (section = 0; section < total; ++section) {
+		if (nsections &&
+		    (ptprof_section_compare(sections[nsections - 1],
+					    sections[section]) == 0))
+			continue;
+
+		sections[nsections++] = sections[section];
+	}
+
+	for (input = 0; input < ninputs; ++input) {
+		struct ptprof_input *in;
+
+		in = &inputs[input];
+		for (section = 0; section < in->nsections; ++section) {
+			const struct ptprof_section *key, **match;
+
+			key = &in->sections[section];
+			match = bsearch(&key, sections, nsections,
+					sizeof(*sections),
+					ptprof_section_compare_ptr);
+			if (!match) {
+				free(sections);
+				return -pte_internal;
+			}
+
+			in->map[section] = (uint32_t) (match - sections);
+		}
+	}
+
+	*psections = sections;
+	*pnsections = nsections;
+
+	return 0;
+}
+
+static int ptprof_output_flush(struct ptprof_output *output)
+{
+	size_t size, written;
+
+	if (!output)
+		return -pte_internal;
+
+	size = (size_t) (output->pos - output->buffer);
+	output->pos = output->buffer;
+
+	written = fwrite(output->buffer, 1, size, output->file);
+	if (written != size)
+		return -pte_bad_file;
+
+	return 0;
+}
+
+/* Make sure @output has room for @size bytes. */
+static int ptprof_output_reserve(struct ptprof_output *output, size_t size)
+{
+	if (!output)
+		return -pte_internal;
+
+	if (size <= (size_t) (output->end - output->pos))
+		return 0;
+
+	return ptprof_output_flush(output);
+}
+
+static int ptprof_output_header(struct ptprof_output *output)
+{
+	uint32_t section;
+	int errcode, size;
+
+	if (!output)
+		return -pte_internal;
+
+	/* There's no header when printing text. */
+	if (!output->file)
+		return 0;
+
+	size = ptprof_write_header(output->pos, output->end,
+				   output->nsections);
+	if (size < 0)
+		return size;
+
+	output->pos += size;
+
+	for (section = 0; section < output->nsections; ++section) {
+		errcode = ptprof_output_reserve(output,
+						ptprof_max_section_size);
+		if (errcode < 0)
+			return errcode;
+
+		size = ptprof_write_section(output->sections[section],
+					    output->pos, output->end);
+		if (size < 0)
+			return size;
+
+		output->pos += size;
+	}
+
+	return 0;
+}
+
+static void ptprof_print_location(const struct ptprof_output *output,
+				  uint32_t section, uint64_t offset)
+{
+	const struct ptprof_section *psection;
+
+	psection = output->sections[section];
+	if (psection->filename[0])
+		printf("%s+0x%" PRIx64, psection->filename, psection->offset);
+	else
+		printf("[unknown]");
+
+	printf(":0x%" PRIx64, offset);
+}
+
+static int ptprof_output_record(struct ptprof_output *output,
+				const struct ptprof_record *record)
+{
+	int errcode, size;
+
+	if (!output || !record)
+		return -pte_internal;
+
+	if (!output->file) {
+		switch (record->type) {
+		case ptprof_end:
+			return 0;
+
+		case ptprof_code:
+			printf("code  ");
+			ptprof_print_location(output, record->section,
+					      record->offset);
+			printf("  %" PRIu64 "  %" PRIu64 "  %" PRIu64 "\n",
+			       record->count, record->insn, record->time);
+			return 0;
+
+		case ptprof_edge:
+			printf("edge  ");
+			ptprof_print_location(output, record->section,
+					      record->offset);
+			printf("  ");
+			ptprof_print_location(output, record->to_section,
+					      record->to_offset);
+			printf("  %" PRIu64 "\n", record->count);
+			return 0;
+		}
+
+		return -pte_bad_packet;
+	}
+
+	errcode = ptprof_output_reserve(output, ptprof_max_record_size);
+	if (errcode < 0)
+		return errcode;
+
+	size = ptprof_write(record, output->pos, output->end, &output->state);
+	if (size < 0)
+		return size;
+
+	output->pos += size;
+
+	if (record->type == ptprof_end)
+		return ptprof_output_flush(output);
+
+	return 0;
+}
+
+/* Order inputs by their current record.
+ *
+ * We break ties by the input's position on the command line.
+ */
+static int ptprof_input_less(const struct ptprof_input *lhs,
+			     const struct ptprof_input *rhs)
+{
+	int cmp;
+
+	cmp = ptprof_compare(&lhs->record, &rhs->record);
+	if (cmp)
+		return cmp < 0;
+
+	return lhs < rhs;
+}
+
+/* Restore the heap property of @heap[0; @size[ below @idx. */
+static void ptprof_heap_down(struct ptprof_input **heap, size_t size,
+			     size_t idx)
+{
+	for (;;) {
+		struct ptprof_input *tmp;
+		size_t child, min;
+
+		min = idx;
+		child = (idx * 2) + 1;
+		if ((child < size) && ptprof_input_less(heap[child], heap[min]))
+			min = child;
+
+		child += 1;
+		if ((child < size) && ptprof_input_less(heap[child], heap[min]))
+			min = child;
+
+		if (min == idx)
+			break;
+
+		tmp = heap[idx];
+		heap[idx] = heap[min];
+		heap[min] = tmp;
+
+		idx = min;
+	}
+}
+
+/* Merge the records of @inputs into @output.
+ *
+ * We keep the inputs in a min-heap ordered by their current record and add
+ * up the counts of records with the same key.
+ *
+ * Returns zero on success, a negative error code otherwise.  On error,
+ * provides the failing input in @pfailed or NULL if writing @output failed.
+ */
+static int ptprof_merge_records(struct ptprof_output *output,
+				struct ptprof_input *inputs, int ninputs,
+				struct ptprof_input **pfailed)
+{
+	struct ptprof_input **heap;
+	struct ptprof_record merged;
+	size_t size, idx;
+	int errcode, input, have_merged;
+
+	if (!output || !inputs || !pfailed)
+		return -pte_internal;
+
+	*pfailed = NULL;
+
+	heap = malloc((size_t) ninputs * sizeof(*heap));
+	if (!heap)
+		return -pte_nomem;
+
+	size = 0;
+	for (input = 0; input < ninputs; ++input) {
+		errcode = ptprof_input_next(&inputs[input]);
+		if (errcode < 0) {
+			*pfailed = &inputs[input];
+			free(heap);
+			return errcode;
+		}
+
+		if (inputs[input].record.type != ptprof_end)
+			heap[size++] = &inputs[input];
+	}
+
+	for (idx = size / 2; idx > 0; --idx)
+		ptprof_heap_down(heap, size, idx - 1);
+
+	ptprof_record_init(&merged);
+	have_merged = 0;
+	errcode = 0;
+	while (size) {
+		struct ptprof_input *top;
+
+		top = heap[0];
+		if (have_merged &&
+		    (ptprof_compare(&merged, &top->record) == 0)) {
+			merged.count += top->record.count;
+			merged.insn += top->record.insn;
+			merged.time += top->record.time;
+		} else {
+			if (have_merged) {
+				errcode = ptprof_output_record(output,
+							       &merged);
+				if (errcode < 0)
+					break;
+			}
+
+			merged = top->record;
+			have_merged = 1;
+		}
+
+		errcode = ptprof_input_next(top);
+		if (errcode < 0) {
+			*pfailed = top;
+			break;
+		}
+
+		if (top->record.type == ptprof_end)
+			heap[0] = heap[--size];
+
+		ptprof_heap_down(heap, size, 0);
+	}
+
+	free(heap);
+
+	if (errcode < 0)
+		return errcode;
+
+	if (have_merged) {
+		errcode = ptprof_output_record(output, &merged);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	merged.type = ptprof_end;
+	return ptprof_output_record(output, &merged);
+}
+
+static int ptprof_merge(struct ptprof_input *inputs, int ninputs,
+			const char *outname, const char *prog)
+{
+	const struct ptprof_section **sections;
+	struct ptprof_output output;
+	struct ptprof_input *failed;
+	uint32_t nsections;
+	int errcode;
+
+	errcode = ptprof_merge_sections(&sections, &nsections, inputs,
+					ninputs);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to merge sections: %s.\n", prog,
+			pt_errstr(pt_errcode(errcode)));
+		return 1;
+	}
+
+	memset(&output, 0, sizeof(output));
+	output.filename = outname;
+	output.sections = sections;
+	output.nsections = nsections;
+	ptprof_state_init(&output.state, nsections);
+
+	if (outname) {
+		output.buffer = malloc(ptprof_buffer_size);
+		if (!output.buffer) {
+			free(sections);
+			fprintf(stderr, "%s: failed to allocate memory.\n",
+				prog);
+			return 1;
+		}
+
+		output.pos = output.buffer;
+		output.end = output.buffer + ptprof_buffer_size;
+
+		output.file = fopen(outname, "wb");
+		if (!output.file) {
+			fprintf(stderr, "%s: failed to open %s: %s.\n", prog,
+				outname, strerror(errno));
+			free(output.buffer);
+			free(sections);
+			return 1;
+		}
+	}
+
+	failed = NULL;
+	errcode = ptprof_output_header(&output);
+	if (errcode >= 0)
+		errcode = ptprof_merge_records(&output, inputs, ninputs,
+					       &failed);
+
+	if (output.file && fclose(output.file) && (errcode >= 0))
+		errcode = -pte_bad_file;
+
+	free(output.buffer);
+	free(sections);
+
+	if (errcode < 0)
+		return diag(prog, failed ? failed->filename :
+			    (outname ? outname : "stdout"), errcode);
+
+	return 0;
+}
+
+extern int main(int argc, char *argv[])
+{
+	struct ptprof_input *inputs;
+	const char *prog, *outname;
+	char *arg;
+	int errcode, ninputs, input;
+
+	(void) argc;
+	if (!argv)
+		return usage("");
+
+	prog = *argv++;
+	if (!prog)
+		return usage("");
+
+	/* We accept options anywhere on the command line.  We collect the
+	 * remaining arguments, i.e. the input profiles, at the front of @argv.
+	 */
+	outname = NULL;
+	ninputs = 0;
+	for (input = 0; argv[input]; ++input) {
+		arg = argv[input];
+
+		if (arg[0] != '-') {
+			argv[ninputs++] = arg;
+			continue;
+		}
+
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+			return help(prog);
+
+		if (strcmp(arg, "--version") == 0)
+			return version(prog);
+
+		if (strcmp(arg, "--output") == 0) {
+			outname = argv[++input];
+			if (!outname) {
+				fprintf(stderr, "%s: --output: missing "
+					"argument.\n", prog);
+				return 1;
+			}
+		} else
+			return bad_option(prog, arg);
+	}
+
+	argv[ninputs] = NULL;
+	if (!ninputs)
+		return no_profile(prog);
+
+	inputs = calloc((size_t) ninputs, sizeof(*inputs));
+	if (!inputs) {
+		fprintf(stderr, "%s: failed to allocate memory.\n", prog);
+		return 1;
+	}
+
+	errcode = 0;
+	for (input = 0; input < ninputs; ++input) {
+		errcode = ptprof_input_open(&inputs[input], argv[input]);
+		if (errcode < 0) {
+			if (!inputs[input].file)
+				fprintf(stderr, "%s: failed to open %s: %s.\n",
+					prog, argv[input], strerror(errno));
+			else
+				diag(prog, argv[input], errcode);
+
+			ninputs = input + 1;
+			break;
+		}
+	}
+
+	if (errcode >= 0)
+		errcode = ptprof_merge(inputs, ninputs, outname, prog);
+	else
+		errcode = 1;
+
+	for (input = 0; input < ninputs; ++input)
+		ptprof_input_close(&inputs[input]);
+
+	free(inputs);
+
+	return errcode;
+}
@@ -0,0 +1,784 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "ptprof.h"
+
+
+/* A test fixture. */
+struct ptprof_fixture {
+	/* A memory buffer. */
+	uint8_t buffer[1024];
+
+	/* The write and read delta encoding states. */
+	struct ptprof_state state[2];
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct ptprof_fixture *);
+	struct ptunit_result (*fini)(struct ptprof_fixture *);
+};
+
+static struct ptunit_result pfix_init(struct ptprof_fixture *pfix)
+{
+	memset(pfix->buffer, 0xcd, sizeof(pfix->buffer));
+
+	ptprof_state_init(&pfix->state[0], 4);
+	ptprof_state_init(&pfix->state[1], 4);
+
+	return ptu_passed();
+}
+
+/* Write @nrecords @records, read them back, and compare. */
+static struct ptunit_result pfix_read_write(struct ptprof_fixture *pfix,
+					    const struct ptprof_record *records,
+					    size_t nrecords)
+{
+	struct ptprof_record record;
+	uint8_t *pos, *end;
+	const uint8_t *in;
+	size_t idx;
+	int size;
+
+	pos = pfix->buffer;
+	end = pos + sizeof(pfix->buffer);
+	for (idx = 0; idx < nrecords; ++idx) {
+		size = ptprof_write(&records[idx], pos, end, &pfix->state[0]);
+		ptu_int_gt(size, 0);
+		ptu_int_le(size, ptprof_max_record_size);
+
+		pos += size;
+	}
+
+	in = pfix->buffer;
+	for (idx = 0; idx < nrecords; ++idx) {
+		size = ptprof_read(&record, in, pos, &pfix->state[1]);
+		ptu_int_gt(size, 0);
+
+		in += size;
+
+		ptu_int_eq(record.type, records[idx].type);
+		ptu_int_eq(ptprof_compare(&record, &records[idx]), 0);
+		ptu_uint_eq(record.count, records[idx].count);
+		ptu_uint_eq(record.insn, records[idx].insn);
+		ptu_uint_eq(record.time, records[idx].time);
+	}
+
+	ptu_ptr_eq(in, pos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer), 0x12345);
+	ptu_int_gt(size, ptprof_header_size);
+	ptu_int_le(size, ptprof_max_header_size);
+
+	nsections = 0;
+	size = ptprof_read_header(&nsections, buffer, buffer + size);
+	ptu_int_gt(size, ptprof_header_size);
+	ptu_uint_eq(nsections, 0x12345);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_max(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer),
+				   UINT32_MAX);
+	ptu_int_eq(size, ptprof_max_header_size);
+
+	size = ptprof_read_header(&nsections, buffer, buffer + size);
+	ptu_int_eq(size, ptprof_max_header_size);
+	ptu_uint_eq(nsections, UINT32_MAX);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_null(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int errcode;
+
+	errcode = ptprof_write_header(NULL, buffer + sizeof(buffer), 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write_header(buffer, NULL, 0);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_header(NULL, buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_header(&nsections, NULL,
+				     buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_header(&nsections, buffer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_eos(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + ptprof_header_size, 0);
+	ptu_int_eq(size, -pte_eos);
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer), 0x100);
+	ptu_int_gt(size, 0);
+
+	size = ptprof_read_header(&nsections, buffer, buffer + size - 1);
+	ptu_int_eq(size, -pte_eos);
+
+	size = ptprof_read_header(&nsections, buffer,
+				  buffer + ptprof_header_size - 1);
+	ptu_int_eq(size, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_file(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer), 0);
+	ptu_int_gt(size, 0);
+
+	buffer[0] = 'x';
+
+	size = ptprof_read_header(&nsections, buffer,
+				  buffer + sizeof(buffer));
+	ptu_int_eq(size, -pte_bad_file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_nsections(void)
+{
+	uint8_t buffer[ptprof_max_header_size + 1];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer), 0);
+	ptu_int_eq(size, ptprof_header_size + 1);
+
+	/* Encode 2^32. */
+	buffer[ptprof_header_size] = 0x80;
+	buffer[ptprof_header_size + 1] = 0x80;
+	buffer[ptprof_header_size + 2] = 0x80;
+	buffer[ptprof_header_size + 3] = 0x80;
+	buffer[ptprof_header_size + 4] = 0x10;
+
+	size = ptprof_read_header(&nsections, buffer,
+				  buffer + sizeof(buffer));
+	ptu_int_eq(size, -pte_bad_file);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result header_bad_version(void)
+{
+	uint8_t buffer[ptprof_max_header_size];
+	uint32_t nsections;
+	int size;
+
+	size = ptprof_write_header(buffer, buffer + sizeof(buffer), 0);
+	ptu_int_gt(size, 0);
+
+	buffer[4] = ptprof_version + 1;
+
+	size = ptprof_read_header(&nsections, buffer,
+				  buffer + sizeof(buffer));
+	ptu_int_eq(size, -pte_not_supported);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result section(const char *filename)
+{
+	struct ptprof_section section[2];
+	uint8_t buffer[ptprof_max_section_size];
+	int size[2];
+
+	section[0].filename = filename;
+	section[0].offset = 0x1000ull;
+	section[0].size = 0xfedcba9876543210ull;
+
+	size[0] = ptprof_write_section(&section[0], buffer,
+				       buffer + sizeof(buffer));
+	ptu_int_gt(size[0], 0);
+	ptu_int_le(size[0], ptprof_max_section_size);
+
+	size[1] = ptprof_read_section(&section[1], buffer, buffer + size[0]);
+	ptu_int_eq(size[1], size[0]);
+	ptu_str_eq(section[1].filename, filename);
+	ptu_ptr_eq(section[1].filename, buffer);
+	ptu_uint_eq(section[1].offset, section[0].offset);
+	ptu_uint_eq(section[1].size, section[0].size);
+
+	ptu_int_eq(ptprof_section_compare(&section[0], &section[1]), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result section_null(void)
+{
+	struct ptprof_section section;
+	uint8_t buffer[ptprof_max_section_size];
+	int errcode;
+
+	section.filename = NULL;
+	section.offset = 0ull;
+	section.size = 0ull;
+
+	errcode = ptprof_write_section(&section, buffer,
+				       buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	section.filename = "";
+
+	errcode = ptprof_write_section(NULL, buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write_section(&section, NULL,
+				       buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write_section(&section, buffer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_section(NULL, buffer, buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_section(&section, NULL,
+				      buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read_section(&section, buffer, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result section_eos(void)
+{
+	struct ptprof_section section;
+	uint8_t buffer[ptprof_max_section_size];
+	int size, errcode;
+
+	section.filename = "file";
+	section.offset = 0x1000ull;
+	section.size = 0x2000ull;
+
+	errcode = ptprof_write_section(&section, buffer, buffer + 5);
+	ptu_int_eq(errcode, -pte_eos);
+
+	size = ptprof_write_section(&section, buffer, buffer + sizeof(buffer));
+	ptu_int_gt(size, 0);
+
+	errcode = ptprof_read_section(&section, buffer, buffer + size - 1);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = ptprof_read_section(&section, buffer, buffer + 4);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result section_too_long(void)
+{
+	static char filename[ptprof_max_filename_size + 1];
+	struct ptprof_section section;
+	static uint8_t buffer[2 * ptprof_max_section_size];
+	int errcode;
+
+	memset(filename, 'a', sizeof(filename) - 1);
+	filename[sizeof(filename) - 1] = 0;
+
+	section.filename = filename;
+	section.offset = 0ull;
+	section.size = 0ull;
+
+	errcode = ptprof_write_section(&section, buffer,
+				       buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* A filename without terminating zero within the size limit. */
+	memset(buffer, 'a', sizeof(buffer));
+
+	errcode = ptprof_read_section(&section, buffer,
+				      buffer + sizeof(buffer));
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result section_compare(void)
+{
+	struct ptprof_section lhs, rhs;
+
+	lhs.filename = "a";
+	lhs.offset = 0x2000ull;
+	lhs.size = 0x2000ull;
+
+	rhs = lhs;
+	ptu_int_eq(ptprof_section_compare(&lhs, &rhs), 0);
+
+	rhs.filename = "b";
+	rhs.offset = 0x1000ull;
+	ptu_int_lt(ptprof_section_compare(&lhs, &rhs), 0);
+	ptu_int_gt(ptprof_section_compare(&rhs, &lhs), 0);
+
+	rhs.filename = "a";
+	ptu_int_gt(ptprof_section_compare(&lhs, &rhs), 0);
+
+	rhs.offset = lhs.offset;
+	rhs.size = 0x1000ull;
+	ptu_int_gt(ptprof_section_compare(&lhs, &rhs), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result compare(void)
+{
+	struct ptprof_record lhs, rhs;
+
+	ptprof_record_init(&lhs);
+	lhs.type = ptprof_code;
+	lhs.section = 1;
+	lhs.offset = 0x100ull;
+	lhs.count = 1ull;
+
+	rhs = lhs;
+	rhs.count = 2ull;
+	rhs.insn = 3ull;
+	ptu_int_eq(ptprof_compare(&lhs, &rhs), 0);
+
+	/* Edge targets are ignored for code. */
+	rhs.to_section = 2;
+	ptu_int_eq(ptprof_compare(&lhs, &rhs), 0);
+
+	rhs.type = ptprof_edge;
+	ptu_int_lt(ptprof_compare(&lhs, &rhs), 0);
+
+	lhs.type = ptprof_edge;
+	ptu_int_lt(ptprof_compare(&lhs, &rhs), 0);
+
+	lhs.to_section = 2;
+	lhs.to_offset = 0x10ull;
+	ptu_int_gt(ptprof_compare(&lhs, &rhs), 0);
+
+	rhs.offset = 0x101ull;
+	ptu_int_lt(ptprof_compare(&lhs, &rhs), 0);
+
+	lhs.section = 2;
+	ptu_int_gt(ptprof_compare(&lhs, &rhs), 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result code(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_code;
+	record.section = 3;
+	record.offset = 0xffffffffffffffffull;
+	record.count = 0xffffffffffffffffull;
+	record.insn = 0xffffffffffffffffull;
+	record.time = 0xffffffffffffffffull;
+
+	ptu_test(pfix_read_write, pfix, &record, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result edge(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_edge;
+	record.section = 1;
+	record.offset = 0x1000ull;
+	record.to_section = 3;
+	record.to_offset = 0x2000ull;
+	record.count = 7ull;
+
+	ptu_test(pfix_read_write, pfix, &record, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sequence(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record records[7];
+	size_t idx;
+
+	for (idx = 0; idx < sizeof(records) / sizeof(records[0]); ++idx) {
+		ptprof_record_init(&records[idx]);
+		records[idx].type = ptprof_code;
+		records[idx].count = idx + 1;
+		records[idx].insn = (idx + 1) * 3;
+		records[idx].time = idx * 100;
+	}
+
+	records[0].offset = 0x1000ull;
+
+	records[1].offset = 0x1000ull;
+	records[1].type = ptprof_edge;
+	records[1].to_section = 2;
+	records[1].to_offset = 0x40ull;
+	records[1].insn = 0ull;
+	records[1].time = 0ull;
+
+	records[2].offset = 0x1000ull;
+	records[2].type = ptprof_edge;
+	records[2].to_section = 2;
+	records[2].to_offset = 0x80ull;
+	records[2].insn = 0ull;
+	records[2].time = 0ull;
+
+	records[3].offset = 0x1010ull;
+
+	records[4].section = 2;
+	records[4].offset = 0x40ull;
+
+	records[5].section = 2;
+	records[5].offset = 0x80ull;
+
+	ptprof_record_init(&records[6]);
+	records[6].type = ptprof_end;
+
+	ptu_test(pfix_read_write, pfix, records,
+		 sizeof(records) / sizeof(records[0]));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result end(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *pos;
+	int size;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_end;
+
+	pos = pfix->buffer;
+	size = ptprof_write(&record, pos, pos + sizeof(pfix->buffer),
+			    &pfix->state[0]);
+	ptu_int_eq(size, 1);
+
+	size = ptprof_write(&record, pos + 1, pos + sizeof(pfix->buffer),
+			    &pfix->state[0]);
+	ptu_int_eq(size, -pte_invalid);
+
+	size = ptprof_read(&record, pos, pos + sizeof(pfix->buffer),
+			   &pfix->state[1]);
+	ptu_int_eq(size, 1);
+	ptu_int_eq(record.type, ptprof_end);
+
+	size = ptprof_read(&record, pos + 1, pos + sizeof(pfix->buffer),
+			   &pfix->state[1]);
+	ptu_int_eq(size, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result null(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin, *end;
+	int errcode;
+
+	ptprof_record_init(&record);
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	errcode = ptprof_write(NULL, begin, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write(&record, NULL, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write(&record, begin, NULL, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_write(&record, begin, end, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read(NULL, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read(&record, NULL, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read(&record, begin, NULL, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptprof_read(&record, begin, end, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result eos(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin;
+	int size, errcode;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_code;
+	record.offset = 0x1000ull;
+	record.count = 0x100ull;
+
+	begin = pfix->buffer;
+	errcode = ptprof_write(&record, begin, begin + 3, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_eos);
+
+	size = ptprof_write(&record, begin, begin + sizeof(pfix->buffer),
+			    &pfix->state[0]);
+	ptu_int_gt(size, 3);
+
+	errcode = ptprof_read(&record, begin, begin + size - 1,
+			      &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_eos);
+
+	errcode = ptprof_read(&record, begin, begin, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bad_type(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin, *end;
+	int errcode;
+
+	ptprof_record_init(&record);
+	record.type = (enum ptprof_type) 0x7f;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	errcode = ptprof_write(&record, begin, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	begin[0] = 0x7f;
+
+	errcode = ptprof_read(&record, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bad_section(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin, *end;
+	int errcode;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_edge;
+	record.section = 4;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	errcode = ptprof_write(&record, begin, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	record.section = 3;
+	record.to_section = 4;
+
+	errcode = ptprof_write(&record, begin, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* An edge in section 4 to section 0 at offset 0. */
+	begin[0] = ptprof_edge;
+	begin[1] = 4;
+	begin[2] = 0;
+	begin[3] = 0;
+	begin[4] = 0;
+	begin[5] = 1;
+
+	errcode = ptprof_read(&record, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	/* An edge in section 0 to section 4. */
+	begin[1] = 0;
+	begin[3] = 4;
+
+	errcode = ptprof_read(&record, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bad_order(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin, *end;
+	int size, errcode;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_edge;
+	record.section = 1;
+	record.offset = 0x1000ull;
+	record.to_offset = 0x2000ull;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = ptprof_write(&record, begin, end, &pfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	/* Duplicates are not allowed. */
+	errcode = ptprof_write(&record, begin + size, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	record.type = ptprof_code;
+	errcode = ptprof_write(&record, begin + size, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	record.type = ptprof_edge;
+	record.to_offset = 0x1000ull;
+	errcode = ptprof_write(&record, begin + size, end, &pfix->state[0]);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	/* Let's read the edge followed by a code record at the same offset,
+	 * i.e. with zero deltas.
+	 */
+	begin[size] = ptprof_code;
+	begin[size + 1] = 0;
+	begin[size + 2] = 0;
+	begin[size + 3] = 1;
+	begin[size + 4] = 1;
+	begin[size + 5] = 0;
+
+	errcode = ptprof_read(&record, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, size);
+
+	errcode = ptprof_read(&record, begin + size, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bad_offset(struct ptprof_fixture *pfix)
+{
+	struct ptprof_record record;
+	uint8_t *begin, *end;
+	int size, errcode, idx;
+
+	ptprof_record_init(&record);
+	record.type = ptprof_code;
+	record.offset = 0x1000ull;
+
+	begin = pfix->buffer;
+	end = begin + sizeof(pfix->buffer);
+
+	size = ptprof_write(&record, begin, end, &pfix->state[0]);
+	ptu_int_gt(size, 0);
+
+	/* A code record in the same section that exceeds 2^64. */
+	begin[size] = ptprof_code;
+	begin[size + 1] = 0;
+	for (idx = 2; idx < 11; ++idx)
+		begin[size + idx] = 0xff;
+	begin[size + 11] = 0x01;
+
+	errcode = ptprof_read(&record, begin, end, &pfix->state[1]);
+	ptu_int_eq(errcode, size);
+
+	errcode = ptprof_read(&record, begin + size, end, &pfix->state[1]);
+	ptu_int_eq(errcode, -pte_bad_packet);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptprof_fixture pfix;
+	struct ptunit_suite suite;
+
+	pfix.init = pfix_init;
+	pfix.fini = NULL;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, header);
+	ptu_run(suite, header_max);
+	ptu_run(suite, header_null);
+	ptu_run(suite, header_eos);
+	ptu_run(suite, header_bad_file);
+	ptu_run(suite, header_bad_nsections);
+	ptu_run(suite, header_bad_version);
+
+	ptu_run_p(suite, section, "");
+	ptu_run_p(suite, section, "/usr/lib/libc.so.6");
+	ptu_run(suite, section_null);
+	ptu_run(suite, section_eos);
+	ptu_run(suite, section_too_long);
+	ptu_run(suite, section_compare);
+
+	ptu_run(suite, compare);
+
+	ptu_run_f(suite, code, pfix);
+	ptu_run_f(suite, edge, pfix);
+	ptu_run_f(suite, sequence, pfix);
+	ptu_run_f(suite, end, pfix);
+	ptu_run_f(suite, null, pfix);
+	ptu_run_f(suite, eos, pfix);
+	ptu_run_f(suite, bad_type, pfix);
+	ptu_run_f(suite, bad_section, pfix);
+	ptu_run_f(suite, bad_order, pfix);
+	ptu_run_f(suite, bad_offset, pfix);
+
+	return ptunit_report(&suite);
+}
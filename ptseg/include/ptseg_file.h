@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PTSEG_FILE_H
+#define PTSEG_FILE_H
+
+#include <stdint.h>
+
+
+/* Determine the size of a file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_file if @filename can't be accessed.
+ * Returns -pte_internal if @size or @filename is NULL.
+ */
+extern int ptseg_file_size(uint64_t *size, const char *filename);
+
+/* Copy part of a file into a new file.
+ *
+ * Creates or truncates @dst and copies @size bytes starting at @offset in
+ * @src into it.  The copy is done inside the kernel where supported.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_file if a file can't be opened, read, or written.
+ * Returns -pte_eos if @src ends before @offset + @size.
+ * Returns -pte_internal if @dst or @src is NULL.
+ */
+extern int ptseg_copy_file(const char *dst, const char *src, uint64_t offset,
+			   uint64_t size);
+
+#endif /* PTSEG_FILE_H */
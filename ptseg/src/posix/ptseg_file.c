@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#if defined(__linux__)
+  /* For copy_file_range(). */
+#  define _GNU_SOURCE
+#endif
+
+#include "ptseg_file.h"
+
+#include "intel-pt.h"
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#  include <sys/sendfile.h>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#  if __GLIBC_PREREQ(2, 27)
+#    define PTSEG_HAVE_COPY_FILE_RANGE
+#  endif
+#endif
+
+
+enum {
+	/* The size of the buffer for copying via user space. */
+	ptseg_copy_size	= 64 * 1024,
+
+	/* The maximal number of bytes to copy in one system call. */
+	ptseg_max_chunk	= 1 << 30
+};
+
+int ptseg_file_size(uint64_t *size, const char *filename)
+{
+	struct stat buf;
+	int errcode;
+
+	if (!size || !filename)
+		return -pte_internal;
+
+	errcode = stat(filename, &buf);
+	if (errcode)
+		return -pte_bad_file;
+
+	if (buf.st_size < 0)
+		return -pte_bad_file;
+
+	*size = (uint64_t) buf.st_size;
+	return 0;
+}
+
+/* Copy @size bytes at @offset in @in to the current position in @out.
+ *
+ * Returns the number of bytes copied, which may be less than @size, or a
+ * negative error code.
+ * Returns -pte_not_supported if the kernel can't copy between @in and @out.
+ */
+static int64_t ptseg_copy_kernel(int out, int in, uint64_t offset,
+				 uint64_t size)
+{
+	size_t chunk;
+	ssize_t copied;
+
+	chunk = ptseg_max_chunk;
+	if (size < chunk)
+		chunk = (size_t) size;
+
+#if defined(PTSEG_HAVE_COPY_FILE_RANGE)
+	{
+		loff_t pos;
+
+		pos = (loff_t) offset;
+		copied = copy_file_range(in, &pos, out, NULL, chunk, 0u);
+		if (0 <= copied)
+			return (int64_t) copied;
+
+		switch (errno) {
+		case ENOSYS:
+		case EXDEV:
+		case EINVAL:
+		case EOPNOTSUPP:
+			/* Try sendfile(), instead. */
+			break;
+
+		default:
+			return -pte_bad_file;
+		}
+	}
+#endif /* defined(PTSEG_HAVE_COPY_FILE_RANGE) */
+
+#if defined(__linux__)
+	{
+		off_t pos;
+
+		pos = (off_t) offset;
+		copied = sendfile(out, in, &pos, chunk);
+		if (0 <= copied)
+			return (int64_t) copied;
+
+		switch (errno) {
+		case ENOSYS:
+		case EINVAL:
+			return -pte_not_supported;
+
+		default:
+			return -pte_bad_file;
+		}
+	}
+#else
+	(void) out;
+	(void) in;
+	(void) offset;
+	(void) copied;
+
+	return -pte_not_supported;
+#endif /* defined(__linux__) */
+}
+
+/* Copy @size bytes at @offset in @in to the current position in @out via a
+ * buffer.
+ *
+ * Returns the number of bytes copied, which may be less than @size, or a
+ * negative error code.
+ */
+static int64_t ptseg_copy_user(int out, int in, uint64_t offset,
+			       uint64_t size)
+{
+	uint8_t buffer[ptseg_copy_size], *pos;
+	size_t chunk;
+	ssize_t bytes;
+
+	chunk = sizeof(buffer);
+	if (size < chunk)
+		chunk = (size_t) size;
+
+	bytes = pread(in, buffer, chunk, (off_t) offset);
+	if (bytes < 0)
+		return -pte_bad_file;
+
+	chunk = (size_t) bytes;
+	for (pos = buffer; chunk; ) {
+		bytes = write(out, pos, chunk);
+		if (bytes <= 0)
+			return -pte_bad_file;
+
+		pos += bytes;
+		chunk -= (size_t) bytes;
+	}
+
+	return (int64_t) (pos - buffer);
+}
+
+int ptseg_copy_file(const char *dst, const char *src, uint64_t offset,
+		    uint64_t size)
+{
+	int in, out, errcode, kernel;
+
+	if (!dst || !src)
+		return -pte_internal;
+
+	in = open(src, O_RDONLY);
+	if (in == -1)
+		return -pte_bad_file;
+
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (out == -1) {
+		close(in);
+		return -pte_bad_file;
+	}
+
+	errcode = 0;
+	kernel = 1;
+	while (size) {
+		int64_t copied;
+
+		copied = -pte_not_supported;
+		if (kernel)
+			copied = ptseg_copy_kernel(out, in, offset, size);
+
+		if (copied == -pte_not_supported) {
+			kernel = 0;
+			copied = ptseg_copy_user(out, in, offset, size);
+		}
+
+		if (copied < 0) {
+			errcode = (int) copied;
+			break;
+		}
+
+		if (!copied) {
+			errcode = -pte_eos;
+			break;
+		}
+
+		offset += (uint64_t) copied;
+		size -= (uint64_t) copied;
+	}
+
+	close(in);
+
+	if (close(out) && !errcode)
+		errcode = -pte_bad_file;
+
+	return errcode;
+}
@@ -30,18 +30,150 @@
 
 #include "intel-pt.h"
 
+#include "ptseg_file.h"
+
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
 
 
+enum {
+	/* The number of packet types we count. */
+	ptseg_num_types		= ppt_ptw + 1,
+
+	/* The size of a PSB packet. */
+	ptseg_psb_size		= 16,
+
+	/* The initial size of the trace window when splitting. */
+	ptseg_window_size	= 64 * 1024
+};
+
+struct ptseg_options {
+	/* The number of threads for scanning the trace in parallel - zero or
+	 * one to scan the trace sequentially.
+	 */
+	uint32_t threads;
+
+	/* List all trace segments. */
+	uint32_t all:1;
+
+	/* Print the list in JSON format. */
+	uint32_t json:1;
+
+	/* The number of shards into which to split the trace or zero. */
+	uint32_t split;
+
+	/* The file name prefix of the shards or NULL to use the trace's. */
+	const char *prefix;
+};
+
+/* The statistics of one trace segment from one PSB to the next. */
+struct ptseg_segment {
+	/* The trace offset of the segment's PSB packet. */
+	uint64_t begin;
+
+	/* The trace offset of the next PSB packet or the end of the trace. */
+	uint64_t end;
+
+	/* The first and the last TSC packet's payload. */
+	uint64_t first_tsc, last_tsc;
+
+	/* The number of packets per packet type. */
+	uint32_t npackets[ptseg_num_types];
+
+	/* The decode error that ended the segment early or zero. */
+	int errcode;
+
+	/* The first CBR packet's payload. */
+	uint8_t cbr;
+
+	/* A flag saying whether @first_tsc and @last_tsc are valid. */
+	uint32_t has_tsc:1;
+
+	/* A flag saying whether @cbr is valid. */
+	uint32_t has_cbr:1;
+};
+
+/* The state given in a PSB+ header.
+ *
+ * For each kind of header packet, we store the last one of that kind.  An
+ * absent packet has type ppt_invalid.
+ */
+struct ptseg_header {
+	/* The trace offset of the PSB packet. */
+	uint64_t offset;
+
+	/* The header packets. */
+	struct pt_packet tsc, cbr, tma, pip, vmcs, exec, tsx, fup;
+
+	/* The decode error that ended the header early or zero. */
+	int errcode;
+
+	/* A flag saying whether there is a PSB packet at @offset. */
+	uint32_t valid:1;
+};
+
+/* A trace shard. */
+struct ptseg_shard {
+	/* The trace offset at which the shard begins. */
+	uint64_t begin;
+
+	/* The trace offset at which the next shard begins. */
+	uint64_t end;
+
+	/* The shard's first PSB+ header. */
+	struct ptseg_header header;
+};
+
+/* A chunk of trace that is scanned on its own.
+ *
+ * The chunk holds the segments whose PSB packet lies in [@begin; @end[.  The
+ * last segment extends beyond @end up to the next PSB packet.
+ */
+struct ptseg_chunk {
+	/* The trace configuration. */
+	const struct pt_config *config;
+
+	/* The trace offset at which the chunk begins. */
+	uint64_t begin;
+
+	/* The trace offset at which the next chunk begins. */
+	uint64_t end;
+
+	/* The segments in trace order. */
+	struct ptseg_segment *segments;
+
+	/* The number of @segments. */
+	uint32_t nsegments;
+
+	/* The number of @segments for which there is room. */
+	uint32_t capacity;
+
+	/* The error that stopped the scan or zero. */
+	int errcode;
+};
+
 static int help(const char *ptseg)
 {
-	printf("usage: %s [<options>] <ptfile>:<offset>\n\n", ptseg);
+	printf("usage: %s [<options>] <ptfile>:<offset>\n", ptseg);
+	printf("       %s --all [<options>] <ptfile>\n", ptseg);
+	printf("       %s --split <n> [<options>] <ptfile>\n\n", ptseg);
 	printf("options:\n");
 	printf("  --help|-h          this text.\n");
 	printf("  --version          display version information and exit.\n");
+	printf("  --all              list all trace segments with statistics.\n");
+	printf("  --json             print the --all list in JSON format.\n");
+	printf("  --split <n>        split the trace at PSB into <n> shards of about equal\n");
+	printf("                     size with a JSON manifest each.\n");
+	printf("  --prefix <prefix>  write shards to <prefix>-<i>.pt (default: <ptfile>).\n");
+#if defined(FEATURE_THREADS)
+	printf("  --threads <n>      scan the trace on <n> threads in parallel.\n");
+#endif /* defined(FEATURE_THREADS) */
 
 	return 0;
 }
@@ -295,6 +427,460 @@ static int ptseg_print_seg(const char *ptfile, uint64_t offset,
 	return 0;
 }
 
+static const char *ptseg_type_name(enum pt_packet_type type)
+{
+	switch (type) {
+	case ppt_invalid:	return "invalid";
+	case ppt_unknown:	return "unknown";
+	case ppt_pad:		return "pad";
+	case ppt_psb:		return "psb";
+	case ppt_psbend:	return "psbend";
+	case ppt_fup:		return "fup";
+	case ppt_tip:		return "tip";
+	case ppt_tip_pge:	return "tip.pge";
+	case ppt_tip_pgd:	return "tip.pgd";
+	case ppt_tnt_8:		return "tnt.8";
+	case ppt_tnt_64:	return "tnt.64";
+	case ppt_mode:		return "mode";
+	case ppt_pip:		return "pip";
+	case ppt_vmcs:		return "vmcs";
+	case ppt_cbr:		return "cbr";
+	case ppt_tsc:		return "tsc";
+	case ppt_tma:		return "tma";
+	case ppt_mtc:		return "mtc";
+	case ppt_cyc:		return "cyc";
+	case ppt_stop:		return "stop";
+	case ppt_ovf:		return "ovf";
+	case ppt_mnt:		return "mnt";
+	case ppt_exstop:	return "exstop";
+	case ppt_mwait:		return "mwait";
+	case ppt_pwre:		return "pwre";
+	case ppt_pwrx:		return "pwrx";
+	case ppt_ptw:		return "ptw";
+	}
+
+	return "unknown";
+}
+
+static void ptseg_count_packet(struct ptseg_segment *segment,
+			       const struct pt_packet *packet)
+{
+	uint32_t type;
+
+	type = (uint32_t) packet->type;
+	if (ptseg_num_types <= type)
+		type = (uint32_t) ppt_unknown;
+
+	segment->npackets[type] += 1;
+
+	switch (packet->type) {
+	case ppt_tsc:
+		if (!segment->has_tsc)
+			segment->first_tsc = packet->payload.tsc.tsc;
+
+		segment->last_tsc = packet->payload.tsc.tsc;
+		segment->has_tsc = 1;
+		break;
+
+	case ppt_cbr:
+		if (!segment->has_cbr)
+			segment->cbr = packet->payload.cbr.ratio;
+
+		segment->has_cbr = 1;
+		break;
+
+	default:
+		break;
+	}
+}
+
+/* Count the packets in [@segment->begin; @segment->end[.
+ *
+ * Offsets are relative to @base, the beginning of @decoder's trace buffer.
+ * A decode error ends the segment early and is recorded in @segment.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptseg_count_packets(struct ptseg_segment *segment,
+			       struct pt_packet_decoder *decoder,
+			       uint64_t base)
+{
+	int errcode;
+
+	errcode = pt_pkt_sync_set(decoder, segment->begin - base);
+	if (errcode < 0)
+		return errcode;
+
+	for (;;) {
+		struct pt_packet packet;
+		uint64_t offset;
+
+		errcode = pt_pkt_get_offset(decoder, &offset);
+		if (errcode < 0)
+			return errcode;
+
+		if (segment->end <= (base + offset))
+			return 0;
+
+		errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				segment->errcode = errcode;
+
+			return 0;
+		}
+
+		ptseg_count_packet(segment, &packet);
+	}
+}
+
+static struct ptseg_segment *ptseg_add_segment(struct ptseg_chunk *chunk)
+{
+	struct ptseg_segment *segment;
+
+	if (chunk->nsegments == chunk->capacity) {
+		struct ptseg_segment *grown;
+		uint32_t capacity;
+
+		capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+
+		grown = realloc(chunk->segments, capacity * sizeof(*grown));
+		if (!grown)
+			return NULL;
+
+		chunk->segments = grown;
+		chunk->capacity = capacity;
+	}
+
+	segment = &chunk->segments[chunk->nsegments++];
+	memset(segment, 0, sizeof(*segment));
+
+	return segment;
+}
+
+/* Scan the trace segments that begin in @chunk.
+ *
+ * The segment boundaries are the PSB packets found by synchronizing forward.
+ * We use a decoder on the trace from @chunk->begin onwards so we also find a
+ * PSB packet right at the beginning of the chunk.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptseg_scan_chunk(struct ptseg_chunk *chunk)
+{
+	struct pt_packet_decoder *decoder;
+	struct pt_config config;
+	uint64_t base, begin, end, size;
+	int errcode;
+
+	if (!chunk || !chunk->config)
+		return -pte_internal;
+
+	base = chunk->begin;
+	config = *chunk->config;
+	config.begin += base;
+
+	size = (uint64_t) (config.end - config.begin);
+
+	decoder = pt_pkt_alloc_decoder(&config);
+	if (!decoder)
+		return -pte_nomem;
+
+	errcode = pt_pkt_sync_forward(decoder);
+	if (errcode < 0) {
+		if (errcode == -pte_eos)
+			errcode = 0;
+
+		goto out;
+	}
+
+	errcode = pt_pkt_get_sync_offset(decoder, &begin);
+	if (errcode < 0)
+		goto out;
+
+	while ((base + begin) < chunk->end) {
+		struct ptseg_segment *segment;
+
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				break;
+
+			end = size;
+		} else {
+			errcode = pt_pkt_get_sync_offset(decoder, &end);
+			if (errcode < 0)
+				break;
+		}
+
+		segment = ptseg_add_segment(chunk);
+		if (!segment) {
+			errcode = -pte_nomem;
+			break;
+		}
+
+		segment->begin = base + begin;
+		segment->end = base + end;
+
+		errcode = ptseg_count_packets(segment, decoder, base);
+		if (errcode < 0)
+			break;
+
+		if (end == size)
+			break;
+
+		/* Continue synchronizing forward from the next PSB. */
+		errcode = pt_pkt_sync_set(decoder, end);
+		if (errcode < 0)
+			break;
+
+		begin = end;
+	}
+
+out:
+	pt_pkt_free_decoder(decoder);
+	return errcode;
+}
+
+#if defined(FEATURE_THREADS)
+
+static int ptseg_scan_thread(void *arg)
+{
+	struct ptseg_chunk *chunk;
+
+	chunk = (struct ptseg_chunk *) arg;
+	if (!chunk)
+		return -pte_internal;
+
+	chunk->errcode = ptseg_scan_chunk(chunk);
+
+	return chunk->errcode;
+}
+
+#endif /* defined(FEATURE_THREADS) */
+
+/* Scan @nchunks @chunks, in parallel if threads are supported.
+ *
+ * Each chunk's error is recorded in the chunk.
+ */
+static void ptseg_scan_chunks(struct ptseg_chunk *chunks, uint32_t nchunks)
+{
+	uint32_t idx;
+
+#if defined(FEATURE_THREADS)
+	thrd_t *threads;
+	uint32_t nthreads;
+
+	/* We scan the first chunk ourselves. */
+	threads = NULL;
+	if (1 < nchunks)
+		threads = malloc((nchunks - 1) * sizeof(*threads));
+
+	nthreads = 0;
+	if (threads) {
+		for (; nthreads < (nchunks - 1); ++nthreads) {
+			if (thrd_create(&threads[nthreads], ptseg_scan_thread,
+					&chunks[nthreads + 1]) != thrd_success)
+				break;
+		}
+	}
+
+	chunks[0].errcode = ptseg_scan_chunk(&chunks[0]);
+
+	/* Scan the chunks for which we could not create a thread. */
+	for (idx = nthreads + 1; idx < nchunks; ++idx)
+		chunks[idx].errcode = ptseg_scan_chunk(&chunks[idx]);
+
+	for (idx = 0; idx < nthreads; ++idx) {
+		int result;
+
+		(void) thrd_join(&threads[idx], &result);
+	}
+
+	free(threads);
+#else
+	for (idx = 0; idx < nchunks; ++idx)
+		chunks[idx].errcode = ptseg_scan_chunk(&chunks[idx]);
+#endif /* defined(FEATURE_THREADS) */
+}
+
+static void ptseg_print_header(void)
+{
+	printf("%-18s %-18s %-10s %-18s %-18s %-4s %-5s %s\n", "begin", "end",
+	       "size", "first-tsc", "last-tsc", "cbr", "ovf", "packets");
+}
+
+static void ptseg_print_segment(const struct ptseg_segment *segment)
+{
+	char first[19], last[19], cbr[5];
+	uint32_t type;
+
+	if (segment->has_tsc) {
+		snprintf(first, sizeof(first), "0x%" PRIx64,
+			 segment->first_tsc);
+		snprintf(last, sizeof(last), "0x%" PRIx64, segment->last_tsc);
+	} else {
+		strcpy(first, "-");
+		strcpy(last, "-");
+	}
+
+	if (segment->has_cbr)
+		snprintf(cbr, sizeof(cbr), "0x%x", segment->cbr);
+	else
+		strcpy(cbr, "-");
+
+	printf("0x%-16" PRIx64 " 0x%-16" PRIx64 " 0x%-8" PRIx64
+	       " %-18s %-18s %-4s %-5u", segment->begin, segment->end,
+	       segment->end - segment->begin, first, last, cbr,
+	       segment->npackets[ppt_ovf]);
+
+	for (type = 0; type < ptseg_num_types; ++type) {
+		if (!segment->npackets[type])
+			continue;
+
+		printf(" %s:%u", ptseg_type_name((enum pt_packet_type) type),
+		       segment->npackets[type]);
+	}
+
+	if (segment->errcode)
+		printf(" [error: %s]", pt_errstr(pt_errcode(segment->errcode)));
+
+	printf("\n");
+}
+
+static void ptseg_print_segment_json(const struct ptseg_segment *segment,
+				     const char *sep)
+{
+	const char *psep;
+	uint32_t type;
+
+	printf("%s\n  {\"begin\": %" PRIu64 ", \"end\": %" PRIu64
+	       ", \"size\": %" PRIu64, sep, segment->begin, segment->end,
+	       segment->end - segment->begin);
+
+	if (segment->has_tsc)
+		printf(", \"first_tsc\": %" PRIu64 ", \"last_tsc\": %" PRIu64,
+		       segment->first_tsc, segment->last_tsc);
+	else
+		printf(", \"first_tsc\": null, \"last_tsc\": null");
+
+	if (segment->has_cbr)
+		printf(", \"cbr\": %u", segment->cbr);
+	else
+		printf(", \"cbr\": null");
+
+	printf(", \"ovf\": %u", segment->npackets[ppt_ovf]);
+
+	if (segment->errcode)
+		printf(", \"error\": \"%s\"",
+		       pt_errstr(pt_errcode(segment->errcode)));
+	else
+		printf(", \"error\": null");
+
+	printf(", \"packets\": {");
+
+	psep = "";
+	for (type = 0; type < ptseg_num_types; ++type) {
+		if (!segment->npackets[type])
+			continue;
+
+		printf("%s\"%s\": %u", psep,
+		       ptseg_type_name((enum pt_packet_type) type),
+		       segment->npackets[type]);
+		psep = ", ";
+	}
+
+	printf("}}");
+}
+
+static int ptseg_print_all(const char *ptfile,
+			   const struct ptseg_options *options,
+			   const char *ptseg)
+{
+	struct ptseg_chunk *chunks;
+	struct pt_config config;
+	uint32_t nchunks, idx;
+	uint8_t *buffer;
+	size_t size;
+	const char *sep;
+	int errcode;
+
+	if (!options)
+		return internal_error(ptseg);
+
+	errcode = load_file(&buffer, &size, ptfile, 0ull, 0ull, ptseg);
+	if (errcode)
+		return errcode;
+
+	pt_config_init(&config);
+	config.begin = buffer;
+	config.end = buffer + size;
+
+	nchunks = options->threads ? options->threads : 1;
+	if (size < nchunks)
+		nchunks = (uint32_t) size;
+
+	chunks = calloc(nchunks, sizeof(*chunks));
+	if (!chunks) {
+		free(buffer);
+		return decode_error(ptseg, -pte_nomem);
+	}
+
+	for (idx = 0; idx < nchunks; ++idx) {
+		chunks[idx].config = &config;
+		chunks[idx].begin = (size * idx) / nchunks;
+		chunks[idx].end = (size * (idx + 1)) / nchunks;
+	}
+
+	ptseg_scan_chunks(chunks, nchunks);
+
+	errcode = 0;
+	for (idx = 0; idx < nchunks; ++idx) {
+		if (chunks[idx].errcode < 0) {
+			errcode = chunks[idx].errcode;
+			break;
+		}
+	}
+
+	if (!errcode) {
+		if (options->json)
+			printf("[");
+		else
+			ptseg_print_header();
+
+		sep = "";
+		for (idx = 0; idx < nchunks; ++idx) {
+			const struct ptseg_chunk *chunk;
+			uint32_t seg;
+
+			chunk = &chunks[idx];
+			for (seg = 0; seg < chunk->nsegments; ++seg) {
+				if (options->json) {
+					ptseg_print_segment_json(
+						&chunk->segments[seg], sep);
+					sep = ",";
+				} else
+					ptseg_print_segment(
+						&chunk->segments[seg]);
+			}
+		}
+
+		if (options->json)
+			printf("\n]\n");
+	}
+
+	for (idx = 0; idx < nchunks; ++idx)
+		free(chunks[idx].segments);
+
+	free(chunks);
+	free(buffer);
+
+	if (errcode < 0)
+		return decode_error(ptseg, errcode);
+
+	return 0;
+}
+
 static int ptseg_split_ptarg(const char **ptfile, uint64_t *ptoffset,
 			     char *ptarg, const char *ptseg)
 {
@@ -322,8 +908,460 @@ static int ptseg_split_ptarg(const char **ptfile, uint64_t *ptoffset,
 	return 0;
 }
 
+static uint64_t ptseg_sext(uint64_t val, uint8_t sign)
+{
+	uint64_t signbit, mask;
+
+	signbit = 1ull << (sign - 1);
+	mask = ~0ull << sign;
+
+	return val & signbit ? val | mask : val & ~mask;
+}
+
+/* Decode the PSB+ header at @decoder's synchronization point into @header.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if the trace ends before the header does.
+ */
+static int ptseg_read_header(struct ptseg_header *header,
+			     struct pt_packet_decoder *decoder)
+{
+	for (;;) {
+		struct pt_packet packet;
+		int errcode;
+
+		errcode = pt_pkt_next(decoder, &packet, sizeof(packet));
+		if (errcode < 0) {
+			if (errcode == -pte_eos)
+				return errcode;
+
+			header->errcode = errcode;
+			return 0;
+		}
+
+		switch (packet.type) {
+		case ppt_psbend:
+			return 0;
+
+		case ppt_tsc:
+			header->tsc = packet;
+			break;
+
+		case ppt_cbr:
+			header->cbr = packet;
+			break;
+
+		case ppt_tma:
+			header->tma = packet;
+			break;
+
+		case ppt_pip:
+			header->pip = packet;
+			break;
+
+		case ppt_vmcs:
+			header->vmcs = packet;
+			break;
+
+		case ppt_fup:
+			header->fup = packet;
+			break;
+
+		case ppt_mode:
+			switch (packet.payload.mode.leaf) {
+			case pt_mol_exec:
+				header->exec = packet;
+				break;
+
+			case pt_mol_tsx:
+				header->tsx = packet;
+				break;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+/* Find the first PSB packet at or after @offset in @ptfile and decode its
+ * PSB+ header into @header.
+ *
+ * We only load a window of the trace at a time, which we move forward while
+ * looking for the PSB packet and which we grow to hold the entire header.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no PSB packet.
+ */
+static int ptseg_find_header(struct ptseg_header *header, const char *ptfile,
+			     uint64_t fsize, uint64_t offset,
+			     const char *ptseg)
+{
+	uint64_t window;
+
+	if (!header || !ptfile)
+		return -pte_internal;
+
+	window = ptseg_window_size;
+	for (;;) {
+		struct pt_packet_decoder *decoder;
+		struct pt_config config;
+		uint64_t size, sync;
+		uint8_t *buffer;
+		size_t bsize;
+		int errcode, synced;
+
+		size = fsize - offset;
+		if (window < size)
+			size = window;
+
+		errcode = load_file(&buffer, &bsize, ptfile, offset, size,
+				    ptseg);
+		if (errcode)
+			return -pte_bad_file;
+
+		pt_config_init(&config);
+		config.begin = buffer;
+		config.end = buffer + bsize;
+
+		decoder = pt_pkt_alloc_decoder(&config);
+		if (!decoder) {
+			free(buffer);
+			return -pte_nomem;
+		}
+
+		synced = 0;
+		sync = 0ull;
+		errcode = pt_pkt_sync_forward(decoder);
+		if (errcode >= 0) {
+			synced = 1;
+
+			errcode = pt_pkt_get_sync_offset(decoder, &sync);
+			if (errcode >= 0) {
+				memset(header, 0, sizeof(*header));
+				header->offset = offset + sync;
+				header->valid = 1;
+
+				errcode = ptseg_read_header(header, decoder);
+			}
+		}
+
+		pt_pkt_free_decoder(decoder);
+		free(buffer);
+
+		if (errcode != -pte_eos)
+			return errcode;
+
+		if ((offset + size) == fsize) {
+			if (!synced)
+				return -pte_eos;
+
+			/* The trace ends inside the header. */
+			header->errcode = -pte_eos;
+			return 0;
+		}
+
+		if (synced) {
+			/* Grow the window to hold the entire header. */
+			offset += sync;
+			window *= 2;
+		} else {
+			/* Keep a PSB packet crossing the window's end. */
+			offset += size - (ptseg_psb_size - 1);
+		}
+	}
+}
+
+static void ptseg_print_json_str(FILE *file, const char *str)
+{
+	fputc('"', file);
+
+	for (; *str; ++str) {
+		unsigned char c;
+
+		c = (unsigned char) *str;
+		if ((c == '"') || (c == '\\'))
+			fprintf(file, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(file, "\\u%04x", c);
+		else
+			fputc(c, file);
+	}
+
+	fputc('"', file);
+}
+
+static int ptseg_write_manifest(const char *filename, const char *ptfile,
+				uint32_t index, const struct ptseg_shard *shard)
+{
+	const struct ptseg_header *header;
+	FILE *file;
+	int errcode;
+
+	if (!filename || !ptfile || !shard)
+		return -pte_internal;
+
+	file = fopen(filename, "w");
+	if (!file)
+		return -pte_bad_file;
+
+	header = &shard->header;
+
+	fprintf(file, "{\n  \"trace\": ");
+	ptseg_print_json_str(file, ptfile);
+	fprintf(file, ",\n  \"shard\": %u,\n", index);
+	fprintf(file, "  \"begin\": %" PRIu64 ",\n", shard->begin);
+	fprintf(file, "  \"end\": %" PRIu64 ",\n", shard->end);
+	fprintf(file, "  \"size\": %" PRIu64 ",\n", shard->end - shard->begin);
+
+	if (header->valid)
+		fprintf(file, "  \"psb\": %" PRIu64 ",\n", header->offset);
+	else
+		fprintf(file, "  \"psb\": null,\n");
+
+	if (header->tsc.type)
+		fprintf(file, "  \"tsc\": %" PRIu64 ",\n",
+			header->tsc.payload.tsc.tsc);
+	else
+		fprintf(file, "  \"tsc\": null,\n");
+
+	if (header->cbr.type)
+		fprintf(file, "  \"cbr\": %u,\n",
+			header->cbr.payload.cbr.ratio);
+	else
+		fprintf(file, "  \"cbr\": null,\n");
+
+	if (header->tma.type)
+		fprintf(file, "  \"tma\": {\"ctc\": %u, \"fc\": %u},\n",
+			header->tma.payload.tma.ctc,
+			header->tma.payload.tma.fc);
+	else
+		fprintf(file, "  \"tma\": null,\n");
+
+	if (header->pip.type)
+		fprintf(file, "  \"pip\": {\"cr3\": %" PRIu64
+			", \"nr\": %u},\n",
+			header->pip.payload.pip.cr3,
+			header->pip.payload.pip.nr);
+	else
+		fprintf(file, "  \"pip\": null,\n");
+
+	if (header->vmcs.type)
+		fprintf(file, "  \"vmcs\": %" PRIu64 ",\n",
+			header->vmcs.payload.vmcs.base);
+	else
+		fprintf(file, "  \"vmcs\": null,\n");
+
+	if (header->exec.type)
+		fprintf(file, "  \"mode.exec\": {\"csl\": %u, \"csd\": %u},\n",
+			header->exec.payload.mode.bits.exec.csl,
+			header->exec.payload.mode.bits.exec.csd);
+	else
+		fprintf(file, "  \"mode.exec\": null,\n");
+
+	if (header->tsx.type)
+		fprintf(file, "  \"mode.tsx\": {\"intx\": %u, \"abrt\": %u},\n",
+			header->tsx.payload.mode.bits.tsx.intx,
+			header->tsx.payload.mode.bits.tsx.abrt);
+	else
+		fprintf(file, "  \"mode.tsx\": null,\n");
+
+	/* The IP is suppressed or not given in full outside of PSB+. */
+	switch (header->fup.type ? header->fup.payload.ip.ipc :
+		pt_ipc_suppressed) {
+	case pt_ipc_sext_48:
+		fprintf(file, "  \"fup\": %" PRIu64 ",\n",
+			ptseg_sext(header->fup.payload.ip.ip, 48));
+		break;
+
+	case pt_ipc_full:
+		fprintf(file, "  \"fup\": %" PRIu64 ",\n",
+			header->fup.payload.ip.ip);
+		break;
+
+	default:
+		fprintf(file, "  \"fup\": null,\n");
+		break;
+	}
+
+	if (header->errcode) {
+		fprintf(file, "  \"error\": ");
+		ptseg_print_json_str(file,
+				     pt_errstr(pt_errcode(header->errcode)));
+		fprintf(file, "\n}\n");
+	} else
+		fprintf(file, "  \"error\": null\n}\n");
+
+	errcode = ferror(file) ? -pte_bad_file : 0;
+
+	if (fclose(file) && !errcode)
+		errcode = -pte_bad_file;
+
+	return errcode;
+}
+
+/* Cut @ptfile into @options->split shards of about equal size.
+ *
+ * Except for the first shard, each shard begins with a PSB packet.  The first
+ * shard begins at the beginning of the trace so the shards cover the entire
+ * trace.  There are fewer shards if there are not enough PSB packets.
+ *
+ * Each shard <prefix>-<n>.pt comes with a manifest <prefix>-<n>.json giving
+ * its location in the original trace and the state in its first PSB+ header.
+ */
+static int ptseg_split(const char *ptfile,
+		       const struct ptseg_options *options,
+		       const char *ptseg)
+{
+	struct ptseg_shard *shards;
+	uint32_t nshards, idx;
+	const char *prefix;
+	uint64_t fsize;
+	size_t length;
+	char *name;
+	int errcode;
+
+	if (!ptfile || !options || !options->split)
+		return internal_error(ptseg);
+
+	errcode = ptseg_file_size(&fsize, ptfile);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to determine size of %s.\n",
+			ptseg, ptfile);
+		return 1;
+	}
+
+	if (!fsize) {
+		fprintf(stderr, "%s: %s is empty.\n", ptseg, ptfile);
+		return 1;
+	}
+
+	prefix = options->prefix ? options->prefix : ptfile;
+
+	/* Leave room for the shard number and the file extension. */
+	length = strlen(prefix) + 32;
+	name = malloc(length);
+	shards = calloc(options->split, sizeof(*shards));
+	if (!name || !shards) {
+		free(name);
+		free(shards);
+		return decode_error(ptseg, -pte_nomem);
+	}
+
+	nshards = 0;
+	for (idx = 0; idx < options->split; ++idx) {
+		struct ptseg_header header;
+		uint64_t offset;
+
+		offset = (fsize * idx) / options->split;
+		if (nshards) {
+			const struct ptseg_header *last;
+
+			/* There are no more PSB packets. */
+			last = &shards[nshards - 1].header;
+			if (!last->valid)
+				break;
+
+			if (offset <= last->offset)
+				offset = last->offset + 1;
+
+			if (fsize <= offset)
+				break;
+		}
+
+		errcode = ptseg_find_header(&header, ptfile, fsize, offset,
+					    ptseg);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				goto out;
+
+			/* We still need a first shard without PSB. */
+			if (nshards)
+				break;
+
+			memset(&header, 0, sizeof(header));
+		}
+
+		shards[nshards].begin = nshards ? header.offset : 0ull;
+		shards[nshards].header = header;
+		nshards += 1;
+	}
+
+	for (idx = 0; idx < nshards; ++idx) {
+		struct ptseg_shard *shard;
+
+		shard = &shards[idx];
+		shard->end = ((idx + 1) < nshards) ? shards[idx + 1].begin :
+			fsize;
+
+		snprintf(name, length, "%s-%u.pt", prefix, idx);
+		errcode = ptseg_copy_file(name, ptfile, shard->begin,
+					  shard->end - shard->begin);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to write %s: %s.\n", ptseg,
+				name, pt_errstr(pt_errcode(errcode)));
+			errcode = 1;
+			goto out_free;
+		}
+
+		printf("0x%" PRIx64 "-0x%" PRIx64 " (size: 0x%" PRIx64
+		       "): %s\n", shard->begin, shard->end,
+		       shard->end - shard->begin, name);
+
+		snprintf(name, length, "%s-%u.json", prefix, idx);
+		errcode = ptseg_write_manifest(name, ptfile, idx, shard);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to write %s: %s.\n", ptseg,
+				name, pt_errstr(pt_errcode(errcode)));
+			errcode = 1;
+			goto out_free;
+		}
+	}
+
+	errcode = 0;
+
+out:
+	if (errcode < 0)
+		errcode = decode_error(ptseg, errcode);
+
+out_free:
+	free(shards);
+	free(name);
+
+	return errcode;
+}
+
+static int ptseg_get_count(uint32_t *count, const char *option,
+			   const char *arg, const char *ptseg)
+{
+	unsigned long value;
+	char *rest;
+
+	if (!count || !option)
+		return internal_error(ptseg);
+
+	if (!arg) {
+		fprintf(stderr, "%s: %s: missing argument.\n", ptseg, option);
+		return 1;
+	}
+
+	errno = 0;
+	value = strtoul(arg, &rest, 0);
+	if (errno || *rest || (UINT32_MAX < value)) {
+		fprintf(stderr, "%s: %s: bad argument: %s.\n", ptseg, option,
+			arg);
+		return 1;
+	}
+
+	*count = (uint32_t) value;
+
+	return 0;
+}
+
 extern int main(int argc, char *argv[])
 {
+	struct ptseg_options options;
 	const char *ptseg, *ptfile;
 	char *arg, *ptarg;
 	uint64_t ptoffset;
@@ -337,24 +1375,73 @@ extern int main(int argc, char *argv[])
 	if (!ptseg)
 		return usage("");
 
-	arg = *argv++;
-	if (!arg)
-		return no_ptfile(ptseg);
-
-	if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
-		return help(ptseg);
-
-	if (strcmp(arg, "--version") == 0)
-		return version(ptseg);
-
-	if (arg[0] == '-')
-		return bad_option(ptseg, arg);
+	memset(&options, 0, sizeof(options));
+	for (;;) {
+		arg = *argv++;
+		if (!arg)
+			return no_ptfile(ptseg);
+
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+			return help(ptseg);
+
+		if (strcmp(arg, "--version") == 0)
+			return version(ptseg);
+
+		if (arg[0] != '-')
+			break;
+
+		if (strcmp(arg, "--all") == 0)
+			options.all = 1;
+		else if (strcmp(arg, "--json") == 0)
+			options.json = 1;
+		else if (strcmp(arg, "--split") == 0) {
+			errcode = ptseg_get_count(&options.split, "--split",
+						  *argv++, ptseg);
+			if (errcode)
+				return errcode;
+
+			if (!options.split) {
+				fprintf(stderr, "%s: --split: need at least "
+					"one shard.\n", ptseg);
+				return 1;
+			}
+		} else if (strcmp(arg, "--prefix") == 0) {
+			options.prefix = *argv++;
+			if (!options.prefix) {
+				fprintf(stderr, "%s: --prefix: missing "
+					"argument.\n", ptseg);
+				return 1;
+			}
+		}
+#if defined(FEATURE_THREADS)
+		else if (strcmp(arg, "--threads") == 0) {
+			errcode = ptseg_get_count(&options.threads,
+						  "--threads", *argv++, ptseg);
+			if (errcode)
+				return errcode;
+		}
+#endif /* defined(FEATURE_THREADS) */
+		else
+			return bad_option(ptseg, arg);
+	}
 
 	ptarg = arg;
 	arg = *argv++;
 	if (arg)
 		return trailing_junk(ptseg, arg);
 
+	if (options.all && options.split) {
+		fprintf(stderr, "%s: specify either --all or --split.\n",
+			ptseg);
+		return 1;
+	}
+
+	if (options.all)
+		return ptseg_print_all(ptarg, &options, ptseg);
+
+	if (options.split)
+		return ptseg_split(ptarg, &options, ptseg);
+
 	ptfile = NULL;
 	ptoffset = 0ull;
 	errcode = ptseg_split_ptarg(&ptfile, &ptoffset, ptarg, ptseg);
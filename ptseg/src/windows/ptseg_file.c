@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptseg_file.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+enum {
+	/* The size of the buffer for copying. */
+	ptseg_copy_size	= 64 * 1024
+};
+
+int ptseg_file_size(uint64_t *size, const char *filename)
+{
+	struct _stat64 stat;
+	int errcode;
+
+	if (!size || !filename)
+		return -pte_internal;
+
+	errcode = _stat64(filename, &stat);
+	if (errcode)
+		return -pte_bad_file;
+
+	if (stat.st_size < 0)
+		return -pte_bad_file;
+
+	*size = (uint64_t) stat.st_size;
+	return 0;
+}
+
+int ptseg_copy_file(const char *dst, const char *src, uint64_t offset,
+		    uint64_t size)
+{
+	uint8_t buffer[ptseg_copy_size];
+	FILE *in, *out;
+	int errcode;
+
+	if (!dst || !src)
+		return -pte_internal;
+
+	if (INT64_MAX < offset)
+		return -pte_bad_file;
+
+	in = fopen(src, "rb");
+	if (!in)
+		return -pte_bad_file;
+
+	out = fopen(dst, "wb");
+	if (!out) {
+		fclose(in);
+		return -pte_bad_file;
+	}
+
+	errcode = 0;
+	if (_fseeki64(in, (__int64) offset, SEEK_SET))
+		errcode = -pte_bad_file;
+
+	while (!errcode && size) {
+		size_t chunk, read;
+
+		chunk = sizeof(buffer);
+		if (size < chunk)
+			chunk = (size_t) size;
+
+		read = fread(buffer, 1, chunk, in);
+		if (!read) {
+			errcode = ferror(in) ? -pte_bad_file : -pte_eos;
+			break;
+		}
+
+		if (fwrite(buffer, 1, read, out) != read)
+			errcode = -pte_bad_file;
+
+		size -= read;
+	}
+
+	fclose(in);
+
+	if (fclose(out) && !errcode)
+		errcode = -pte_bad_file;
+
+	return errcode;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+/* A call graph.
+ *
+ * A call graph counts the instructions executed on each call path.  A call
+ * path is the sequence of functions, identified by their entry IP and image
+ * section, that were called, starting from the function in which decoding
+ * started.
+ *
+ * The call graph follows calls and returns in the decoded trace using a shadow
+ * stack of interned call paths.  Each frame remembers where the called
+ * function returns to so returns can be matched with their calls.
+ */
+struct ptxed_callgraph;
+
+enum {
+	/* The default maximal depth of the shadow call stack. */
+	ptxed_callgraph_max_depth	= 1024
+};
+
+
+/* Allocate an empty call graph.
+ *
+ * The shadow call stack holds up to @max_depth frames.  A call beyond that
+ * drops the outer half of the stack.
+ *
+ * Returns a new call graph on success, NULL otherwise.
+ */
+extern struct ptxed_callgraph *ptxed_callgraph_alloc(uint32_t max_depth);
+
+/* Free a call graph. */
+extern void ptxed_callgraph_free(struct ptxed_callgraph *callgraph);
+
+/* Add @ninsn instructions starting at @ip in @isid to the current call path.
+ *
+ * The last instruction's class is given by @iclass.  Calls and returns
+ * change the current call path for the next instructions.  For calls, @ret
+ * gives the IP to which the called function returns.
+ *
+ * A return unwinds the shadow call stack to the frame returning to the next
+ * instruction.  If there is no such frame, the current function returns to
+ * its caller.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @callgraph is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ */
+extern int ptxed_callgraph_add(struct ptxed_callgraph *callgraph, int isid,
+			       uint64_t ip, uint32_t ninsn,
+			       enum pt_insn_class iclass, uint64_t ret);
+
+/* Update the current call path for @event.
+ *
+ * Asynchronous branches call into their destination.  Overflows and paging
+ * changes lose the call stack.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @callgraph or @event is NULL.
+ */
+extern int ptxed_callgraph_event(struct ptxed_callgraph *callgraph,
+				 const struct pt_event *event);
+
+/* Lose the call stack, e.g. when synchronizing onto the trace. */
+extern void ptxed_callgraph_reset(struct ptxed_callgraph *callgraph);
+
+/* Returns the number of times @callgraph's shadow call stack was truncated. */
+extern uint64_t
+ptxed_callgraph_truncated(const struct ptxed_callgraph *callgraph);
+
+/* Print @callgraph to @stream in folded stack format.
+ *
+ * Prints one line for each call path on which instructions were executed.
+ * The line lists the functions on the call path separated by semicolons,
+ * followed by the number of instructions.
+ *
+ * If @iscache is not NULL, it is used to name functions by their file and
+ * file offset.  Otherwise, functions are named by their IP.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @stream or @callgraph is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ */
+extern int ptxed_callgraph_print_folded(FILE *stream,
+					const struct ptxed_callgraph *callgraph,
+					struct pt_image_section_cache *iscache);
+
+#endif /* CALLGRAPH_H */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef INSN_CACHE_H
+#define INSN_CACHE_H
+
+#include "intel-pt.h"
+
+#include <xed-interface.h>
+
+#include <stdint.h>
+
+
+enum {
+	/* The size of a disassembled instruction's text including raw bytes
+	 * and the terminating zero.
+	 */
+	ptxed_insn_text_size	= 3 * pt_max_insn_size + 2 + 256
+};
+
+/* A cached decoded instruction. */
+struct ptxed_cached_insn {
+	/* The decoded instruction.
+	 *
+	 * XED may refer to the instruction bytes it decoded, so we decode
+	 * from @raw.
+	 */
+	xed_decoded_inst_t inst;
+
+	/* The instruction's IP. */
+	uint64_t ip;
+
+	/* The instruction's image section identifier. */
+	int isid;
+
+	/* The execution mode in which the instruction was decoded. */
+	enum pt_exec_mode mode;
+
+	/* The raw instruction bytes. */
+	uint8_t raw[pt_max_insn_size];
+
+	/* The number of bytes in @raw. */
+	uint8_t size;
+
+	/* A flag saying whether @inst holds the decoded instruction. */
+	uint32_t valid:1;
+
+	/* A flag saying whether @text holds the disassembled instruction. */
+	uint32_t has_text:1;
+
+	/* The disassembled instruction as it is printed. */
+	char text[ptxed_insn_text_size];
+};
+
+/* A cache of decoded instructions.
+ *
+ * Instructions are identified by their IP, image section identifier, and
+ * execution mode.  The cache is direct-mapped; a new instruction replaces
+ * the cached instruction it collides with.
+ */
+struct ptxed_insn_cache;
+
+
+/* Allocate an empty instruction cache.
+ *
+ * Returns a new instruction cache on success, NULL otherwise.
+ */
+extern struct ptxed_insn_cache *ptxed_insn_cache_alloc(void);
+
+/* Free an instruction cache. */
+extern void ptxed_insn_cache_free(struct ptxed_insn_cache *cache);
+
+/* Look up the instruction at @ip in @isid decoded in @mode.
+ *
+ * Returns the cached instruction on success, NULL if it is not cached.
+ */
+extern struct ptxed_cached_insn *
+ptxed_insn_cache_lookup(struct ptxed_insn_cache *cache, uint64_t ip, int isid,
+			enum pt_exec_mode mode);
+
+/* Provide an entry for @insn.
+ *
+ * Replaces the cached instruction @insn collides with.  The entry holds
+ * @insn's raw bytes and is neither valid nor has text.  The caller is
+ * expected to decode the instruction and set the valid flag on success.
+ *
+ * Instructions without an image section identifier and truncated
+ * instructions are not cached.  A truncated instruction's bytes come from
+ * more than one section so @isid and @ip do not identify them.  Those
+ * instructions get a scratch entry that is reused for the next such
+ * instruction.
+ *
+ * Returns the entry on success, NULL if @cache or @insn is NULL.
+ */
+extern struct ptxed_cached_insn *
+ptxed_insn_cache_insert(struct ptxed_insn_cache *cache,
+			const struct pt_insn *insn);
+
+#endif /* INSN_CACHE_H */
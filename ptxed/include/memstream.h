@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef MEMSTREAM_H
+#define MEMSTREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+
+/* An output stream that collects what is written to it in memory.
+ *
+ * The stream may refer to @text and @size so it must not be moved while it is
+ * open.
+ */
+struct ptxed_memstream {
+	/* The stream to write to - NULL if the stream is not open. */
+	FILE *file;
+
+	/* The written text and its size.
+	 *
+	 * This is managed by the stream and only valid after closing it.
+	 */
+	char *text;
+	size_t size;
+};
+
+
+/* Open @memstream for writing.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @memstream is NULL.
+ * Returns -pte_nomem if the stream can't be opened.
+ */
+extern int ptxed_memstream_open(struct ptxed_memstream *memstream);
+
+/* Close @memstream and provide what was written to it.
+ *
+ * On success, provides the written text in @text and its size in @size.  The
+ * text is not terminated.  The caller is responsible for freeing it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if an argument is NULL or @memstream is not open.
+ * Returns -pte_nomem if the written text can't be provided.
+ */
+extern int ptxed_memstream_close(struct ptxed_memstream *memstream,
+				 char **text, size_t *size);
+
+#endif /* MEMSTREAM_H */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct pt_image_section_cache;
+
+
+/* An execution profile.
+ *
+ * A profile counts how often code at a given IP in a given image section has
+ * been executed, how many instructions have been executed, and how much time
+ * has passed.
+ *
+ * Code is identified by its image section identifier (isid) and the IP of its
+ * first instruction.  Depending on the decoder, this is an instruction or a
+ * block of instructions.
+ */
+struct ptxed_profile;
+
+
+/* Allocate an empty profile.
+ *
+ * Returns a new profile on success, NULL otherwise.
+ */
+extern struct ptxed_profile *ptxed_profile_alloc(void);
+
+/* Free a profile. */
+extern void ptxed_profile_free(struct ptxed_profile *profile);
+
+/* Add one execution of @ninsn instructions starting at @ip in @isid.
+ *
+ * The execution took @time, measured in the units of the trace's time.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ */
+extern int ptxed_profile_add(struct ptxed_profile *profile, int isid,
+			     uint64_t ip, uint32_t ninsn, uint64_t time);
+
+/* Remove an execution previously added by ptxed_profile_add().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile is NULL.
+ * Returns -pte_internal if @profile does not contain @ip in @isid.
+ */
+extern int ptxed_profile_remove(struct ptxed_profile *profile, int isid,
+				uint64_t ip, uint32_t ninsn, uint64_t time);
+
+/* Add all executions in @other to @profile.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @profile or @other is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ */
+extern int ptxed_profile_merge(struct ptxed_profile *profile,
+			       const struct ptxed_profile *other);
+
+/* Print a report of @profile to @stream.
+ *
+ * Prints the code executed most often, ordered by the number of executed
+ * instructions, followed by a per-section summary.  Each table is limited to
+ * @top entries unless @top is zero.
+ *
+ * The @what string names the profiled code, e.g. "blocks" or "instructions".
+ *
+ * If @iscache is not NULL, it is used to name sections by their file.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @stream, @profile, or @what is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ */
+extern int ptxed_profile_print(FILE *stream,
+			       const struct ptxed_profile *profile,
+			       const char *what,
+			       struct pt_image_section_cache *iscache,
+			       uint64_t top);
+
+/* Write @profile to @stream in ptprof binary format.
+ *
+ * Code is identified by the file section it was loaded from and its offset
+ * into that section so profiles written by different decoders of the same
+ * trace can be merged.  Sections are looked up in @iscache.  Code in
+ * sections that cannot be found is assigned to an unnamed section at offset
+ * zero and identified by its IP.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_internal if @stream or @profile is NULL.
+ * Returns -pte_nomem if not enough memory can be allocated.
+ * Returns -pte_bad_file if writing to @stream failed.
+ */
+extern int ptxed_profile_write(FILE *stream,
+			       const struct ptxed_profile *profile,
+			       struct pt_image_section_cache *iscache);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,595 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "callgraph.h"
+#include "pt_hash.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+
+enum {
+	/* The initial size of the call path table as a power of two. */
+	ptxed_callgraph_init_bits	= 10,
+
+	/* The index of the root call path. */
+	ptxed_callgraph_root		= 0
+};
+
+/* A call path.
+ *
+ * A call path extends its parent call path by a call to the function at @ip
+ * in @isid.  The root call path is its own parent.
+ */
+struct ptxed_call_path {
+	/* The IP of the called function's entry. */
+	uint64_t ip;
+
+	/* The number of instructions executed on this call path. */
+	uint64_t insn;
+
+	/* The index of the parent call path. */
+	uint32_t parent;
+
+	/* The image section identifier of the called function's entry. */
+	int isid;
+};
+
+/* A shadow call stack frame. */
+struct ptxed_call_frame {
+	/* The IP to which the called function returns. */
+	uint64_t ret;
+
+	/* The index of the called function's call path. */
+	uint32_t path;
+};
+
+struct ptxed_callgraph {
+	/* The interned call paths indexed by their call path index. */
+	struct ptxed_call_path *path;
+
+	/* The number of call paths. */
+	uint32_t npaths;
+
+	/* The number of call paths for which there is space in @path. */
+	uint32_t capacity;
+
+	/* A hash table of call path indices plus one using open addressing.
+	 *
+	 * An entry of zero is empty.
+	 */
+	uint32_t *table;
+
+	/* The size of @table as a power of two. */
+	uint8_t bits;
+
+	/* The shadow call stack.
+	 *
+	 * The innermost frame gives the current call path.  With an empty
+	 * stack, we're in the root call path.
+	 */
+	struct ptxed_call_frame *stack;
+
+	/* The number of frames on @stack. */
+	uint32_t depth;
+
+	/* The maximal number of frames on @stack. */
+	uint32_t max_depth;
+
+	/* The number of times @stack had been truncated. */
+	uint64_t truncated;
+
+	/* The return IP of a pending call. */
+	uint64_t call_ret;
+
+	/* A flag saying that we called a function and the next instruction
+	 * is its entry.
+	 */
+	uint32_t call_pending:1;
+
+	/* A flag saying that we returned from a function and the next
+	 * instruction is the return target.
+	 */
+	uint32_t return_pending:1;
+};
+
+struct ptxed_callgraph *ptxed_callgraph_alloc(uint32_t max_depth)
+{
+	struct ptxed_callgraph *callgraph;
+
+	if (!max_depth)
+		return NULL;
+
+	callgraph = malloc(sizeof(*callgraph));
+	if (!callgraph)
+		return NULL;
+
+	memset(callgraph, 0, sizeof(*callgraph));
+
+	callgraph->max_depth = max_depth;
+	callgraph->stack = malloc(max_depth * sizeof(*callgraph->stack));
+	if (!callgraph->stack)
+		goto err;
+
+	callgraph->bits = ptxed_callgraph_init_bits;
+	callgraph->table = calloc(1ull << callgraph->bits,
+				  sizeof(*callgraph->table));
+	if (!callgraph->table)
+		goto err;
+
+	callgraph->capacity = 1u << callgraph->bits;
+	callgraph->path = malloc(callgraph->capacity *
+				 sizeof(*callgraph->path));
+	if (!callgraph->path)
+		goto err;
+
+	/* The root call path is not in @table.  We never look it up. */
+	memset(&callgraph->path[ptxed_callgraph_root], 0,
+	       sizeof(callgraph->path[ptxed_callgraph_root]));
+	callgraph->npaths = 1;
+
+	return callgraph;
+
+err:
+	free(callgraph->stack);
+	free(callgraph->table);
+	free(callgraph);
+	return NULL;
+}
+
+void ptxed_callgraph_free(struct ptxed_callgraph *callgraph)
+{
+	if (!callgraph)
+		return;
+
+	free(callgraph->path);
+	free(callgraph->table);
+	free(callgraph->stack);
+	free(callgraph);
+}
+
+static uint64_t ptxed_callgraph_hash(uint32_t parent, int isid, uint64_t ip)
+{
+	uint64_t hash;
+
+	hash = pt_hash_u64(0ull, parent);
+	hash = pt_hash_u64(hash, (uint32_t) isid);
+
+	return pt_hash_u64(hash, ip);
+}
+
+/* Find the table entry for the call to @ip in @isid from @parent or the empty
+ * entry where it belongs.
+ */
+static uint32_t *ptxed_callgraph_find(const struct ptxed_callgraph *callgraph,
+				      uint32_t parent, int isid, uint64_t ip)
+{
+	size_t idx, mask;
+
+	mask = (1ull << callgraph->bits) - 1;
+	idx = pt_hash_index(ptxed_callgraph_hash(parent, isid, ip),
+			    callgraph->bits);
+	for (;;) {
+		const struct ptxed_call_path *path;
+		uint32_t *entry;
+
+		entry = &callgraph->table[idx];
+		if (!*entry)
+			return entry;
+
+		path = &callgraph->path[*entry - 1];
+		if ((path->ip == ip) && (path->isid == isid) &&
+		    (path->parent == parent))
+			return entry;
+
+		idx = (idx + 1) & mask;
+	}
+}
+
+static int ptxed_callgraph_grow(struct ptxed_callgraph *callgraph)
+{
+	struct ptxed_call_path *path;
+	uint32_t *table, capacity, idx;
+	uint8_t bits;
+
+	bits = callgraph->bits + 1;
+	if (pt_hash_max_bits < bits)
+		return -pte_nomem;
+
+	capacity = 1u << bits;
+	path = realloc(callgraph->path, capacity * sizeof(*path));
+	if (!path)
+		return -pte_nomem;
+
+	callgraph->path = path;
+	callgraph->capacity = capacity;
+
+	table = calloc(capacity, sizeof(*table));
+	if (!table)
+		return -pte_nomem;
+
+	free(callgraph->table);
+	callgraph->table = table;
+	callgraph->bits = bits;
+
+	for (idx = 0; idx < callgraph->npaths; ++idx) {
+		if (idx == ptxed_callgraph_root)
+			continue;
+
+		path = &callgraph->path[idx];
+		*ptxed_callgraph_find(callgraph, path->parent, path->isid,
+				      path->ip) = idx + 1;
+	}
+
+	return 0;
+}
+
+/* Provide the index of the call path extending @parent by a call to @ip in
+ * @isid in @index.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_callgraph_call(struct ptxed_callgraph *callgraph,
+				uint32_t *index, uint32_t parent, int isid,
+				uint64_t ip)
+{
+	struct ptxed_call_path *path;
+	uint32_t *entry;
+
+	entry = ptxed_callgraph_find(callgraph, parent, isid, ip);
+	if (*entry) {
+		*index = *entry - 1;
+		return 0;
+	}
+
+	/* We have as much space for call paths as we have table entries. */
+	if (pt_hash_full(callgraph->npaths, callgraph->bits)) {
+		int errcode;
+
+		errcode = ptxed_callgraph_grow(callgraph);
+		if (errcode < 0)
+			return errcode;
+
+		entry = ptxed_callgraph_find(callgraph, parent, isid, ip);
+	}
+
+	path = &callgraph->path[callgraph->npaths];
+	path->ip = ip;
+	path->insn = 0ull;
+	path->parent = parent;
+	path->isid = isid;
+
+	*index = callgraph->npaths++;
+	*entry = callgraph->npaths;
+
+	return 0;
+}
+
+/* The index of the current call path. */
+static uint32_t ptxed_callgraph_current(const struct ptxed_callgraph *callgraph)
+{
+	if (!callgraph->depth)
+		return ptxed_callgraph_root;
+
+	return callgraph->stack[callgraph->depth - 1].path;
+}
+
+/* Drop the outer half of the shadow call stack.
+ *
+ * The remaining frames are moved to the bottom of the stack and their call
+ * paths are re-interned starting from the root call path.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_callgraph_truncate(struct ptxed_callgraph *callgraph)
+{
+	uint32_t parent, keep, drop, idx;
+
+	keep = callgraph->max_depth / 2;
+	drop = callgraph->depth - keep;
+
+	parent = ptxed_callgraph_root;
+	for (idx = 0; idx < keep; ++idx) {
+		const struct ptxed_call_frame *frame;
+		const struct ptxed_call_path *path;
+		uint64_t ret;
+		int errcode;
+
+		frame = &callgraph->stack[drop + idx];
+		path = &callgraph->path[frame->path];
+		ret = frame->ret;
+
+		errcode = ptxed_callgraph_call(callgraph, &parent, parent,
+					       path->isid, path->ip);
+		if (errcode < 0) {
+			callgraph->depth = idx;
+			return errcode;
+		}
+
+		callgraph->stack[idx].ret = ret;
+		callgraph->stack[idx].path = parent;
+	}
+
+	callgraph->depth = keep;
+	callgraph->truncated += 1;
+
+	return 0;
+}
+
+/* Call the function at @ip in @isid returning to @ret.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_callgraph_push(struct ptxed_callgraph *callgraph, int isid,
+				uint64_t ip, uint64_t ret)
+{
+	struct ptxed_call_frame *frame;
+	uint32_t path;
+	int errcode;
+
+	if (callgraph->depth == callgraph->max_depth) {
+		errcode = ptxed_callgraph_truncate(callgraph);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	errcode = ptxed_callgraph_call(callgraph, &path,
+				       ptxed_callgraph_current(callgraph),
+				       isid, ip);
+	if (errcode < 0)
+		return errcode;
+
+	frame = &callgraph->stack[callgraph->depth++];
+	frame->ret = ret;
+	frame->path = path;
+
+	return 0;
+}
+
+/* Return to @ip.
+ *
+ * Unwinds the shadow call stack to the innermost frame returning to @ip.  If
+ * there is none, we assume that the current function returned to its caller.
+ */
+static void ptxed_callgraph_pop(struct ptxed_callgraph *callgraph, uint64_t ip)
+{
+	uint32_t depth;
+
+	callgraph->return_pending = 0;
+
+	depth = callgraph->depth;
+	while (depth--) {
+		if (callgraph->stack[depth].ret == ip) {
+			callgraph->depth = depth;
+			return;
+		}
+	}
+
+	/* We lose track of returns beyond the function in which we started
+	 * and stay in the root call path.
+	 */
+	if (callgraph->depth)
+		callgraph->depth -= 1;
+}
+
+int ptxed_callgraph_add(struct ptxed_callgraph *callgraph, int isid,
+			uint64_t ip, uint32_t ninsn, enum pt_insn_class iclass,
+			uint64_t ret)
+{
+	if (!callgraph)
+		return -pte_internal;
+
+	if (callgraph->return_pending)
+		ptxed_callgraph_pop(callgraph, ip);
+
+	if (callgraph->call_pending) {
+		int errcode;
+
+		callgraph->call_pending = 0;
+
+		errcode = ptxed_callgraph_push(callgraph, isid, ip,
+					       callgraph->call_ret);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	callgraph->path[ptxed_callgraph_current(callgraph)].insn += ninsn;
+
+	switch (iclass) {
+	case ptic_call:
+	case ptic_far_call:
+		callgraph->call_pending = 1;
+		callgraph->call_ret = ret;
+		break;
+
+	case ptic_return:
+	case ptic_far_return:
+		callgraph->return_pending = 1;
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+int ptxed_callgraph_event(struct ptxed_callgraph *callgraph,
+			  const struct pt_event *event)
+{
+	if (!callgraph || !event)
+		return -pte_internal;
+
+	switch (event->type) {
+	case ptev_async_branch:
+		if (callgraph->return_pending)
+			ptxed_callgraph_pop(callgraph,
+					    event->variant.async_branch.from);
+
+		callgraph->call_pending = 1;
+		callgraph->call_ret = event->variant.async_branch.from;
+		break;
+
+	case ptev_disabled:
+		if (callgraph->return_pending && !event->ip_suppressed)
+			ptxed_callgraph_pop(callgraph,
+					    event->variant.disabled.ip);
+
+		/* We won't see the entry of a function that is not traced.
+		 * Tracing will resume in the caller.
+		 */
+		callgraph->call_pending = 0;
+		break;
+
+	case ptev_async_disabled:
+		if (callgraph->return_pending)
+			ptxed_callgraph_pop(callgraph,
+					    event->variant.async_disabled.at);
+
+		callgraph->call_pending = 0;
+		break;
+
+	case ptev_paging:
+	case ptev_async_paging:
+		/* Status updates repeat the current paging configuration.
+		 * Otherwise, we switched to a different address space.
+		 */
+		if (!event->status_update)
+			ptxed_callgraph_reset(callgraph);
+		break;
+
+	case ptev_overflow:
+		ptxed_callgraph_reset(callgraph);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+void ptxed_callgraph_reset(struct ptxed_callgraph *callgraph)
+{
+	if (!callgraph)
+		return;
+
+	callgraph->depth = 0;
+	callgraph->call_pending = 0;
+	callgraph->return_pending = 0;
+}
+
+uint64_t ptxed_callgraph_truncated(const struct ptxed_callgraph *callgraph)
+{
+	if (!callgraph)
+		return 0ull;
+
+	return callgraph->truncated;
+}
+
+static void ptxed_print_function(FILE *stream,
+				 const struct ptxed_call_path *path,
+				 struct pt_image_section_cache *iscache)
+{
+	const char *filename;
+	uint64_t offset, vaddr;
+	int errcode;
+
+	vaddr = 0ull;
+	errcode = -pte_bad_image;
+	if (iscache && (path->isid > 0))
+		errcode = pt_iscache_get_file(iscache, path->isid, &filename,
+					      &offset, NULL, &vaddr);
+
+	if ((errcode < 0) || (path->ip < vaddr))
+		fprintf(stream, "0x%" PRIx64, path->ip);
+	else
+		fprintf(stream, "%s+0x%" PRIx64, filename,
+			offset + (path->ip - vaddr));
+}
+
+int ptxed_callgraph_print_folded(FILE *stream,
+				 const struct ptxed_callgraph *callgraph,
+				 struct pt_image_section_cache *iscache)
+{
+	uint32_t *stack, capacity, idx;
+
+	if (!stream || !callgraph)
+		return -pte_internal;
+
+	capacity = 64;
+	stack = malloc(capacity * sizeof(*stack));
+	if (!stack)
+		return -pte_nomem;
+
+	for (idx = 0; idx < callgraph->npaths; ++idx) {
+		uint32_t depth, current;
+
+		if (!callgraph->path[idx].insn)
+			continue;
+
+		depth = 0;
+		for (current = idx; current != ptxed_callgraph_root;
+		     current = callgraph->path[current].parent) {
+			if (depth == capacity) {
+				uint32_t *grown;
+
+				grown = realloc(stack, capacity * 2 *
+						sizeof(*stack));
+				if (!grown) {
+					free(stack);
+					return -pte_nomem;
+				}
+
+				stack = grown;
+				capacity *= 2;
+			}
+
+			stack[depth++] = current;
+		}
+
+		/* We don't know which function we started in. */
+		fputs("[unknown]", stream);
+
+		while (depth) {
+			const struct ptxed_call_path *path;
+
+			path = &callgraph->path[stack[--depth]];
+
+			fputc(';', stream);
+			ptxed_print_function(stream, path, iscache);
+		}
+
+		fprintf(stream, " %" PRIu64 "\n", callgraph->path[idx].insn);
+	}
+
+	free(stack);
+
+	return 0;
+}
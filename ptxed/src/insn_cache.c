@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "insn_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The number of cached instructions as a power of two. */
+	ptxed_insn_cache_bits	= 11
+};
+
+struct ptxed_insn_cache {
+	/* The cached instructions. */
+	struct ptxed_cached_insn entry[1 << ptxed_insn_cache_bits];
+
+	/* The entry for instructions that are not cached. */
+	struct ptxed_cached_insn scratch;
+};
+
+struct ptxed_insn_cache *ptxed_insn_cache_alloc(void)
+{
+	/* All entries start out invalid. */
+	return calloc(1, sizeof(struct ptxed_insn_cache));
+}
+
+void ptxed_insn_cache_free(struct ptxed_insn_cache *cache)
+{
+	free(cache);
+}
+
+static struct ptxed_cached_insn *
+ptxed_insn_cache_entry(struct ptxed_insn_cache *cache, uint64_t ip, int isid)
+{
+	uint64_t key;
+
+	key = (ip ^ ((uint64_t) (uint32_t) isid << 40)) *
+		0x9e3779b97f4a7c15ull;
+
+	return &cache->entry[key >> (64 - ptxed_insn_cache_bits)];
+}
+
+struct ptxed_cached_insn *
+ptxed_insn_cache_lookup(struct ptxed_insn_cache *cache, uint64_t ip, int isid,
+			enum pt_exec_mode mode)
+{
+	struct ptxed_cached_insn *entry;
+
+	if (!cache || (isid <= 0))
+		return NULL;
+
+	entry = ptxed_insn_cache_entry(cache, ip, isid);
+	if (!entry->valid || (entry->ip != ip) || (entry->isid != isid) ||
+	    (entry->mode != mode))
+		return NULL;
+
+	return entry;
+}
+
+struct ptxed_cached_insn *
+ptxed_insn_cache_insert(struct ptxed_insn_cache *cache,
+			const struct pt_insn *insn)
+{
+	struct ptxed_cached_insn *entry;
+	uint8_t size;
+
+	if (!cache || !insn)
+		return NULL;
+
+	if ((insn->isid <= 0) || insn->truncated)
+		entry = &cache->scratch;
+	else
+		entry = ptxed_insn_cache_entry(cache, insn->ip, insn->isid);
+
+	size = insn->size;
+	if (sizeof(entry->raw) < size)
+		size = sizeof(entry->raw);
+
+	entry->ip = insn->ip;
+	entry->isid = insn->isid;
+	entry->mode = insn->mode;
+	entry->size = size;
+	entry->valid = 0;
+	entry->has_text = 0;
+	memcpy(entry->raw, insn->raw, size);
+
+	return entry;
+}
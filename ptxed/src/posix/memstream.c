@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "memstream.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+
+
+int ptxed_memstream_open(struct ptxed_memstream *memstream)
+{
+	if (!memstream)
+		return -pte_internal;
+
+	memstream->text = NULL;
+	memstream->size = 0;
+
+	memstream->file = open_memstream(&memstream->text, &memstream->size);
+	if (!memstream->file)
+		return -pte_nomem;
+
+	return 0;
+}
+
+int ptxed_memstream_close(struct ptxed_memstream *memstream, char **text,
+			  size_t *size)
+{
+	FILE *file;
+
+	if (!memstream || !text || !size)
+		return -pte_internal;
+
+	file = memstream->file;
+	if (!file)
+		return -pte_internal;
+
+	memstream->file = NULL;
+
+	/* The stream updates @memstream's text and size on close. */
+	if (fclose(file)) {
+		free(memstream->text);
+		memstream->text = NULL;
+
+		return -pte_nomem;
+	}
+
+	*text = memstream->text;
+	*size = memstream->size;
+
+	memstream->text = NULL;
+	memstream->size = 0;
+
+	return 0;
+}
@@ -0,0 +1,740 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "profile.h"
+#include "pt_hash.h"
+
+#include "intel-pt.h"
+
+#include "ptprof.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+
+enum {
+	/* The initial number of profile entries as a power of two. */
+	ptxed_profile_init_bits	= 10,
+
+	/* The size of the buffer for writing a binary profile in bytes.
+	 *
+	 * This must hold at least one section table entry.
+	 */
+	ptxed_profile_buffer_size	= 64 * 1024
+};
+
+/* A profile entry for code at one IP in one section. */
+struct ptxed_profile_entry {
+	/* The IP of the code's first instruction. */
+	uint64_t ip;
+
+	/* The number of times the code was executed. */
+	uint64_t count;
+
+	/* The number of instructions executed. */
+	uint64_t insn;
+
+	/* The time spent executing the code. */
+	uint64_t time;
+
+	/* The image section identifier. */
+	int isid;
+
+	/* A flag saying whether this entry is in use. */
+	uint32_t used:1;
+};
+
+struct ptxed_profile {
+	/* A hash table of entries using open addressing. */
+	struct ptxed_profile_entry *entries;
+
+	/* The number of entries in use. */
+	size_t nentries;
+
+	/* The size of @entries as a power of two. */
+	uint8_t bits;
+};
+
+struct ptxed_profile *ptxed_profile_alloc(void)
+{
+	struct ptxed_profile *profile;
+
+	profile = malloc(sizeof(*profile));
+	if (!profile)
+		return NULL;
+
+	profile->bits = ptxed_profile_init_bits;
+	profile->nentries = 0;
+	profile->entries = calloc(1ull << profile->bits,
+				  sizeof(*profile->entries));
+	if (!profile->entries) {
+		free(profile);
+		return NULL;
+	}
+
+	return profile;
+}
+
+void ptxed_profile_free(struct ptxed_profile *profile)
+{
+	if (!profile)
+		return;
+
+	free(profile->entries);
+	free(profile);
+}
+
+static uint64_t ptxed_profile_hash(int isid, uint64_t ip)
+{
+	return pt_hash_u64(pt_hash_u64(0ull, (uint32_t) isid), ip);
+}
+
+/* Find the entry for @ip in @isid or the empty slot where it belongs. */
+static struct ptxed_profile_entry *
+ptxed_profile_find(const struct ptxed_profile *profile, int isid, uint64_t ip)
+{
+	struct ptxed_profile_entry *entry;
+	size_t idx, mask;
+
+	mask = (1ull << profile->bits) - 1;
+	idx = pt_hash_index(ptxed_profile_hash(isid, ip), profile->bits);
+	for (;;) {
+		entry = &profile->entries[idx];
+		if (!entry->used)
+			return entry;
+
+		if ((entry->ip == ip) && (entry->isid == isid))
+			return entry;
+
+		idx = (idx + 1) & mask;
+	}
+}
+
+static int ptxed_profile_grow(struct ptxed_profile *profile)
+{
+	struct ptxed_profile_entry *entries, *old;
+	size_t idx, size;
+	uint8_t bits;
+
+	bits = profile->bits + 1;
+	if (pt_hash_max_bits < bits)
+		return -pte_nomem;
+
+	entries = calloc(1ull << bits, sizeof(*entries));
+	if (!entries)
+		return -pte_nomem;
+
+	old = profile->entries;
+	size = 1ull << profile->bits;
+
+	profile->entries = entries;
+	profile->bits = bits;
+
+	for (idx = 0; idx < size; ++idx) {
+		if (!old[idx].used)
+			continue;
+
+		*ptxed_profile_find(profile, old[idx].isid, old[idx].ip) =
+			old[idx];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+/* Get the entry for @ip in @isid, adding one if necessary. */
+static struct ptxed_profile_entry *
+ptxed_profile_get(struct ptxed_profile *profile, int isid, uint64_t ip)
+{
+	struct ptxed_profile_entry *entry;
+
+	entry = ptxed_profile_find(profile, isid, ip);
+	if (entry->used)
+		return entry;
+
+	if (pt_hash_full(profile->nentries, profile->bits)) {
+		if (ptxed_profile_grow(profile) < 0)
+			return NULL;
+
+		entry = ptxed_profile_find(profile, isid, ip);
+	}
+
+	entry->ip = ip;
+	entry->isid = isid;
+	entry->used = 1;
+	profile->nentries += 1;
+
+	return entry;
+}
+
+int ptxed_profile_add(struct ptxed_profile *profile, int isid, uint64_t ip,
+		      uint32_t ninsn, uint64_t time)
+{
+	struct ptxed_profile_entry *entry;
+
+	if (!profile || (isid < 0))
+		return -pte_internal;
+
+	entry = ptxed_profile_get(profile, isid, ip);
+	if (!entry)
+		return -pte_nomem;
+
+	entry->count += 1;
+	entry->insn += ninsn;
+	entry->time += time;
+
+	return 0;
+}
+
+int ptxed_profile_remove(struct ptxed_profile *profile, int isid, uint64_t ip,
+			 uint32_t ninsn, uint64_t time)
+{
+	struct ptxed_profile_entry *entry;
+
+	if (!profile)
+		return -pte_internal;
+
+	entry = ptxed_profile_find(profile, isid, ip);
+	if (!entry->used || !entry->count || (entry->insn < ninsn) ||
+	    (entry->time < time))
+		return -pte_internal;
+
+	/* We keep the entry even if it drops to zero.  We do not print such
+	 * entries.
+	 */
+	entry->count -= 1;
+	entry->insn -= ninsn;
+	entry->time -= time;
+
+	return 0;
+}
+
+int ptxed_profile_merge(struct ptxed_profile *profile,
+			const struct ptxed_profile *other)
+{
+	size_t idx, size;
+
+	if (!profile || !other)
+		return -pte_internal;
+
+	size = 1ull << other->bits;
+	for (idx = 0; idx < size; ++idx) {
+		const struct ptxed_profile_entry *src;
+		struct ptxed_profile_entry *dst;
+
+		src = &other->entries[idx];
+		if (!src->used || !src->count)
+			continue;
+
+		dst = ptxed_profile_get(profile, src->isid, src->ip);
+		if (!dst)
+			return -pte_nomem;
+
+		dst->count += src->count;
+		dst->insn += src->insn;
+		dst->time += src->time;
+	}
+
+	return 0;
+}
+
+/* Order entries by decreasing number of instructions.
+ *
+ * We break ties by section and IP to get a stable order.
+ */
+static int ptxed_profile_compare(const void *lhs, const void *rhs)
+{
+	const struct ptxed_profile_entry *left, *right;
+
+	left = *(const struct ptxed_profile_entry * const *) lhs;
+	right = *(const struct ptxed_profile_entry * const *) rhs;
+
+	if (left->insn != right->insn)
+		return (left->insn < right->insn) ? 1 : -1;
+
+	if (left->isid != right->isid)
+		return (left->isid < right->isid) ? -1 : 1;
+
+	if (left->ip != right->ip)
+		return (left->ip < right->ip) ? -1 : 1;
+
+	return 0;
+}
+
+static void ptxed_profile_print_section(FILE *stream,
+					struct pt_image_section_cache *iscache,
+					int isid)
+{
+	const char *filename;
+	uint64_t offset;
+	int errcode;
+
+	errcode = -pte_bad_image;
+	if (iscache && isid > 0)
+		errcode = pt_iscache_get_file(iscache, isid, &filename,
+					      &offset, NULL, NULL);
+
+	if (errcode < 0)
+		fprintf(stream, "%d", isid);
+	else
+		fprintf(stream, "%d  %s+0x%" PRIx64, isid, filename, offset);
+}
+
+static void ptxed_profile_print_entry(FILE *stream,
+				      const struct ptxed_profile_entry *entry,
+				      uint64_t total)
+{
+	double share;
+
+	share = total ? ((double) entry->insn * 100.0) / (double) total : 0.0;
+
+	fprintf(stream, "%16" PRIu64 "  %6.2f%%  %16" PRIu64 "  %16" PRIu64
+		"  ", entry->insn, share, entry->count, entry->time);
+}
+
+/* Summarize @entries per section.
+ *
+ * On success, provides the sections in @psections and their number in
+ * @pnsections.  The caller is responsible for freeing @psections.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_profile_sections(struct ptxed_profile_entry **psections,
+				  size_t *pnsections,
+				  struct ptxed_profile_entry * const *entries,
+				  size_t nentries)
+{
+	struct ptxed_profile_entry *sections;
+	size_t idx, nsections;
+	int max;
+
+	max = 0;
+	for (idx = 0; idx < nentries; ++idx) {
+		if (max < entries[idx]->isid)
+			max = entries[idx]->isid;
+	}
+
+	sections = calloc((size_t) max + 1, sizeof(*sections));
+	if (!sections)
+		return -pte_nomem;
+
+	for (idx = 0; idx < nentries; ++idx) {
+		const struct ptxed_profile_entry *entry;
+		struct ptxed_profile_entry *section;
+
+		entry = entries[idx];
+		section = &sections[entry->isid];
+
+		section->isid = entry->isid;
+		section->used = 1;
+		section->count += entry->count;
+		section->insn += entry->insn;
+		section->time += entry->time;
+	}
+
+	/* Compact the used sections. */
+	nsections = 0;
+	for (idx = 0; idx <= (size_t) max; ++idx) {
+		if (sections[idx].used)
+			sections[nsections++] = sections[idx];
+	}
+
+	*psections = sections;
+	*pnsections = nsections;
+
+	return 0;
+}
+
+int ptxed_profile_print(FILE *stream, const struct ptxed_profile *profile,
+			const char *what,
+			struct pt_image_section_cache *iscache, uint64_t top)
+{
+	struct ptxed_profile_entry **entries, *sections, **psections;
+	size_t idx, size, nentries, nsections;
+	uint64_t total;
+	int errcode;
+
+	if (!stream || !profile || !what)
+		return -pte_internal;
+
+	entries = malloc((profile->nentries + 1) * sizeof(*entries));
+	if (!entries)
+		return -pte_nomem;
+
+	total = 0ull;
+	nentries = 0;
+	size = 1ull << profile->bits;
+	for (idx = 0; idx < size; ++idx) {
+		struct ptxed_profile_entry *entry;
+
+		entry = &profile->entries[idx];
+		if (!entry->used || !entry->count)
+			continue;
+
+		entries[nentries++] = entry;
+		total += entry->insn;
+	}
+
+	errcode = ptxed_profile_sections(&sections, &nsections, entries,
+					 nentries);
+	if (errcode < 0) {
+		free(entries);
+		return errcode;
+	}
+
+	qsort(entries, nentries, sizeof(*entries), ptxed_profile_compare);
+
+	fprintf(stream, "%s:\n", what);
+	fprintf(stream, "%16s  %7s  %16s  %16s  %-16s  %s\n", "insn", "share",
+		"count", "time", "ip", "section");
+
+	for (idx = 0; idx < nentries; ++idx) {
+		if (top && (top <= idx))
+			break;
+
+		ptxed_profile_print_entry(stream, entries[idx], total);
+		fprintf(stream, "%016" PRIx64 "  ", entries[idx]->ip);
+		ptxed_profile_print_section(stream, iscache,
+					    entries[idx]->isid);
+		fprintf(stream, "\n");
+	}
+
+	/* We reuse @entries for sorting sections. */
+	psections = entries;
+	for (idx = 0; idx < nsections; ++idx)
+		psections[idx] = &sections[idx];
+
+	qsort(psections, nsections, sizeof(*psections),
+	      ptxed_profile_compare);
+
+	fprintf(stream, "\nsections:\n");
+	fprintf(stream, "%16s  %7s  %16s  %16s  %s\n", "insn", "share",
+		"count", "time", "section");
+
+	for (idx = 0; idx < nsections; ++idx) {
+		if (top && (top <= idx))
+			break;
+
+		ptxed_profile_print_entry(stream, psections[idx], total);
+		ptxed_profile_print_section(stream, iscache,
+					    psections[idx]->isid);
+		fprintf(stream, "\n");
+	}
+
+	free(sections);
+	free(entries);
+
+	return 0;
+}
+
+/* A section of a profile written in ptprof format. */
+struct ptxed_profile_section {
+	/* The section table entry. */
+	struct ptprof_section section;
+
+	/* The virtual address at which the section is loaded. */
+	uint64_t vaddr;
+
+	/* The index into the section table. */
+	uint32_t index;
+
+	/* A flag saying whether this section is in use. */
+	uint32_t used:1;
+};
+
+/* A buffered binary profile output stream. */
+struct ptxed_profile_output {
+	/* The stream to write to. */
+	FILE *stream;
+
+	/* The next free byte in @buffer. */
+	uint8_t *pos;
+
+	/* The bytes not yet written to @stream. */
+	uint8_t buffer[ptxed_profile_buffer_size];
+};
+
+static int ptxed_profile_flush(struct ptxed_profile_output *output)
+{
+	size_t size;
+
+	size = (size_t) (output->pos - output->buffer);
+	output->pos = output->buffer;
+
+	if (fwrite(output->buffer, 1, size, output->stream) != size)
+		return -pte_bad_file;
+
+	return 0;
+}
+
+/* Make sure @output has room for @size bytes. */
+static int ptxed_profile_reserve(struct ptxed_profile_output *output,
+				 size_t size)
+{
+	if (size <= (size_t) (output->buffer + sizeof(output->buffer) -
+			      output->pos))
+		return 0;
+
+	return ptxed_profile_flush(output);
+}
+
+static void ptxed_profile_lookup(struct ptxed_profile_section *section,
+				 struct pt_image_section_cache *iscache,
+				 int isid)
+{
+	int errcode;
+
+	errcode = -pte_bad_image;
+	if (iscache && isid > 0)
+		errcode = pt_iscache_get_file(iscache, isid,
+					      &section->section.filename,
+					      &section->section.offset,
+					      &section->section.size,
+					      &section->vaddr);
+
+	if (errcode < 0) {
+		section->section.filename = "";
+		section->section.offset = 0ull;
+		section->section.size = 0ull;
+		section->vaddr = 0ull;
+	}
+}
+
+static int ptxed_profile_section_compare(const void *lhs, const void *rhs)
+{
+	const struct ptxed_profile_section *left, *right;
+
+	left = *(const struct ptxed_profile_section * const *) lhs;
+	right = *(const struct ptxed_profile_section * const *) rhs;
+
+	return ptprof_section_compare(&left->section, &right->section);
+}
+
+static int ptxed_profile_record_compare(const void *lhs, const void *rhs)
+{
+	return ptprof_compare((const struct ptprof_record *) lhs,
+			      (const struct ptprof_record *) rhs);
+}
+
+/* Write the section table and @records to @output. */
+static int ptxed_profile_write_records(struct ptxed_profile_output *output,
+				       struct ptxed_profile_section **sections,
+				       uint32_t nsections,
+				       const struct ptprof_record *records,
+				       size_t nrecords)
+{
+	struct ptprof_record end;
+	struct ptprof_state state;
+	uint8_t *limit;
+	uint32_t section;
+	size_t idx;
+	int errcode, size;
+
+	limit = output->buffer + sizeof(output->buffer);
+
+	size = ptprof_write_header(output->pos, limit, nsections);
+	if (size < 0)
+		return size;
+
+	output->pos += size;
+
+	for (section = 0; section < nsections; ++section) {
+		errcode = ptxed_profile_reserve(output,
+						ptprof_max_section_size);
+		if (errcode < 0)
+			return errcode;
+
+		size = ptprof_write_section(&sections[section]->section,
+					    output->pos, limit);
+		if (size < 0)
+			return size;
+
+		output->pos += size;
+	}
+
+	ptprof_state_init(&state, nsections);
+	for (idx = 0; idx < nrecords; ++idx) {
+		errcode = ptxed_profile_reserve(output,
+						ptprof_max_record_size);
+		if (errcode < 0)
+			return errcode;
+
+		size = ptprof_write(&records[idx], output->pos, limit, &state);
+		if (size < 0)
+			return size;
+
+		output->pos += size;
+	}
+
+	errcode = ptxed_profile_reserve(output, ptprof_max_record_size);
+	if (errcode < 0)
+		return errcode;
+
+	ptprof_record_init(&end);
+	end.type = ptprof_end;
+
+	size = ptprof_write(&end, output->pos, limit, &state);
+	if (size < 0)
+		return size;
+
+	output->pos += size;
+
+	return ptxed_profile_flush(output);
+}
+
+int ptxed_profile_write(FILE *stream, const struct ptxed_profile *profile,
+			struct pt_image_section_cache *iscache)
+{
+	struct ptxed_profile_section *sections, **sorted;
+	struct ptxed_profile_output *output;
+	struct ptprof_record *records;
+	size_t idx, size, nrecords;
+	uint32_t nsections, nunique;
+	int max, isid, errcode;
+
+	if (!stream || !profile)
+		return -pte_internal;
+
+	max = 0;
+	size = 1ull << profile->bits;
+	for (idx = 0; idx < size; ++idx) {
+		const struct ptxed_profile_entry *entry;
+
+		entry = &profile->entries[idx];
+		if (!entry->used || !entry->count)
+			continue;
+
+		if (max < entry->isid)
+			max = entry->isid;
+	}
+
+	sections = calloc((size_t) max + 1, sizeof(*sections));
+	sorted = malloc(((size_t) max + 1) * sizeof(*sorted));
+	records = malloc((profile->nentries + 1) * sizeof(*records));
+	output = malloc(sizeof(*output));
+	if (!sections || !sorted || !records || !output) {
+		errcode = -pte_nomem;
+		goto out;
+	}
+
+	for (idx = 0; idx < size; ++idx) {
+		const struct ptxed_profile_entry *entry;
+
+		entry = &profile->entries[idx];
+		if (!entry->used || !entry->count)
+			continue;
+
+		sections[entry->isid].used = 1;
+	}
+
+	nsections = 0;
+	for (isid = 0; isid <= max; ++isid) {
+		if (!sections[isid].used)
+			continue;
+
+		ptxed_profile_lookup(&sections[isid], iscache, isid);
+		sorted[nsections++] = &sections[isid];
+	}
+
+	qsort(sorted, nsections, sizeof(*sorted),
+	      ptxed_profile_section_compare);
+
+	/* Different isids may refer to the same file section, e.g. if it is
+	 * loaded into different processes.  They share a section table entry.
+	 */
+	nunique = 0;
+	for (idx = 0; idx < nsections; ++idx) {
+		if (nunique &&
+		    (ptxed_profile_section_compare(&sorted[nunique - 1],
+						   &sorted[idx]) == 0)) {
+			sorted[idx]->index = nunique - 1;
+			continue;
+		}
+
+		sorted[idx]->index = nunique;
+		sorted[nunique++] = sorted[idx];
+	}
+
+	nrecords = 0;
+	for (idx = 0; idx < size; ++idx) {
+		const struct ptxed_profile_entry *entry;
+		const struct ptxed_profile_section *section;
+		struct ptprof_record *record;
+
+		entry = &profile->entries[idx];
+		if (!entry->used || !entry->count)
+			continue;
+
+		section = &sections[entry->isid];
+
+		record = &records[nrecords++];
+		ptprof_record_init(record);
+		record->type = ptprof_code;
+		record->section = section->index;
+		record->offset = entry->ip - section->vaddr;
+		record->count = entry->count;
+		record->insn = entry->insn;
+		record->time = entry->time;
+	}
+
+	qsort(records, nrecords, sizeof(*records),
+	      ptxed_profile_record_compare);
+
+	/* Add up records for code in sections that share an entry. */
+	size = nrecords;
+	nrecords = 0;
+	for (idx = 0; idx < size; ++idx) {
+		struct ptprof_record *last;
+
+		last = nrecords ? &records[nrecords - 1] : NULL;
+		if (last && (ptprof_compare(last, &records[idx]) == 0)) {
+			last->count += records[idx].count;
+			last->insn += records[idx].insn;
+			last->time += records[idx].time;
+			continue;
+		}
+
+		records[nrecords++] = records[idx];
+	}
+
+	output->stream = stream;
+	output->pos = output->buffer;
+
+	errcode = ptxed_profile_write_records(output, sorted, nunique,
+					      records, nrecords);
+
+out:
+	free(output);
+	free(records);
+	free(sorted);
+	free(sections);
+
+	return errcode;
+}
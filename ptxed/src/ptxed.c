@@ -30,6 +30,11 @@
 # include "load_elf.h"
 #endif /* defined(FEATURE_ELF) */
 
+#include "profile.h"
+#include "callgraph.h"
+#include "insn_cache.h"
+#include "memstream.h"
+
 #include "pt_cpu.h"
 #include "pt_version.h"
 
@@ -39,11 +44,16 @@
 #  include "libipt-sb.h"
 #endif
 
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <xed-interface.h>
 
@@ -54,6 +64,274 @@ enum ptxed_decoder_type {
 	pdt_block_decoder
 };
 
+/* An item of decoded trace - an instruction or a block. */
+struct ptxed_item {
+	/* The trace offset at which the item was decoded. */
+	uint64_t offset;
+
+	/* The IP of the item's first instruction. */
+	uint64_t ip;
+
+	/* The time it took to execute the item - only used for profiling. */
+	uint64_t time;
+
+	/* The time of the last event before the item - only used if the
+	 * item's range is timed.
+	 */
+	uint64_t event_tsc;
+
+	/* The trace's time after the item - only used if the item's range is
+	 * timed.
+	 */
+	uint64_t tsc;
+
+	/* The number of instructions in the item. */
+	uint32_t ninsn;
+
+	/* The image section identifier of the item's first instruction. */
+	int isid;
+
+	/* The decode error diagnosed at this item - zero if the item is an
+	 * instruction or a block.
+	 */
+	int errcode;
+
+	/* The position in the output stream at which the item is printed. */
+	long pos;
+};
+
+/* A growing array of items. */
+struct ptxed_items {
+	/* The items. */
+	struct ptxed_item *item;
+
+	/* The number of items. */
+	size_t nitems;
+
+	/* The number of items for which there is space in @item. */
+	size_t capacity;
+};
+
+/* A block marker to print at a given output position. */
+struct ptxed_mark {
+	/* The position in the output stream. */
+	long pos;
+
+	/* The number of the block. */
+	uint64_t block;
+};
+
+/* A growing array of block markers. */
+struct ptxed_marks {
+	/* The block markers. */
+	struct ptxed_mark *mark;
+
+	/* The number of block markers. */
+	size_t nmarks;
+
+	/* The number of block markers for which there is space in @mark. */
+	size_t capacity;
+};
+
+/* A range of trace that is decoded independently of the trace preceding it.
+ *
+ * A range starts at a PSB packet and ends where the decoder of the next range,
+ * which starts at the PSB packet at @end, takes over.
+ *
+ * The decoder reads ahead, so it may still be decoding instructions from
+ * trace preceding @end after it read the PSB+ at @end.  To find the point at
+ * which the next range's decoder takes over, we keep decoding beyond @end and
+ * compare the items we decoded against the next range's leading items.
+ */
+struct ptxed_range {
+	/* The trace offset of the range's PSB packet. */
+	uint64_t begin;
+
+	/* The trace offset of the PSB packet from which we decode up to @begin
+	 * without printing - @begin if we start decoding at @begin.
+	 *
+	 * When decoding from @begin, the trace's timing state is not yet
+	 * calibrated and the sideband has not been applied up to @begin.
+	 * Decoding the preceding trace segment takes care of both the way a
+	 * sequential decode does.
+	 */
+	uint64_t preroll;
+
+	/* The trace offset at which the range ends - zero if it extends until
+	 * the end of the trace.
+	 *
+	 * This is the offset of the next range's PSB packet.  If our decode
+	 * diverges from the next range's, we decode the next range's trace in
+	 * its place and extend the range to the next range's end.
+	 */
+	uint64_t end;
+
+	/* The next range - NULL if this is the last range.
+	 *
+	 * Other than @end, this does not change when the range is extended.
+	 */
+	const struct ptxed_range *next;
+
+	/* The leading items of the next range.
+	 *
+	 * These are the items that are decoded at the offset of its first item
+	 * and the first item beyond.
+	 */
+	struct ptxed_items lead;
+
+	/* The items that were decoded at or beyond @end. */
+	struct ptxed_items tail;
+
+	/* The output position of the range's first item - -1 if there is
+	 * none.
+	 */
+	long first;
+
+	/* The output position at which the next range takes over - -1 if it
+	 * takes over at the end of our output.
+	 */
+	long cut;
+
+	/* The index of the tail item at which the next range took over - the
+	 * number of tail items if it took over at the end of our output.
+	 *
+	 * This is only valid if @taken is set.
+	 */
+	size_t takeover;
+
+	/* The block markers to print with the range's output.
+	 *
+	 * The range does not know how many blocks precede it.  Block numbers
+	 * are relative to the range and are adjusted when printing.
+	 */
+	struct ptxed_marks marks;
+
+	/* A flag saying that we re-synchronized onto the PSB packet at @end
+	 * after an error.
+	 *
+	 * The range starting at @end takes over at its very beginning.
+	 */
+	uint32_t resync:1;
+
+	/* A flag saying that we failed to remember an item or a block
+	 * marker.
+	 */
+	uint32_t lost:1;
+
+	/* A flag saying that the next range took over.
+	 *
+	 * Otherwise, we decoded until the end of the trace or until we gave
+	 * up, as would a sequential decode, and none of the following ranges
+	 * is printed.
+	 */
+	uint32_t taken:1;
+
+	/* A flag saying that the trace's time is printed or profiled.
+	 *
+	 * The next range only takes over if it agrees with us on the time.
+	 */
+	uint32_t timed:1;
+};
+
+#if defined(FEATURE_THREADS)
+enum {
+	/* The size of decoded output at which we move it into a piece. */
+	ptxed_piece_size	= 256 * 1024,
+
+	/* The number of bytes in pieces at which the decoder waits for its
+	 * output to be printed.
+	 */
+	ptxed_output_limit	= 4 * 1024 * 1024
+};
+
+/* A piece of decoded output that is ready to be printed. */
+struct ptxed_piece {
+	/* The next piece in output order - NULL if this is the last piece. */
+	struct ptxed_piece *next;
+
+	/* The decoded output. */
+	char *text;
+
+	/* The number of bytes in @text. */
+	size_t size;
+
+	/* The output position of @text's first byte. */
+	long pos;
+
+	/* The block markers to print within @text. */
+	struct ptxed_marks marks;
+};
+
+/* Decoded output that is buffered in memory until it is printed.
+ *
+ * The decoder writes into an in-memory stream.  At item boundaries, it moves
+ * what it wrote so far into a new piece that is ready to be printed.  Unless
+ * the output is being printed, the decoder waits once it buffered
+ * ptxed_output_limit bytes.
+ *
+ * The lock protects @first, @last, @buffered, and the @printing, @closed, and
+ * @abort flags.  The remaining fields are owned by the decoder.
+ */
+struct ptxed_output {
+	/* The in-memory streams the decoder writes to.
+	 *
+	 * The decoder writes to @memstream[@current].  When moving its output
+	 * into a piece, we open the other stream before closing the current
+	 * one.
+	 */
+	struct ptxed_memstream memstream[2];
+	uint32_t current;
+
+	/* The output position of @memstream's first byte. */
+	long base;
+
+	/* The number of the range's block markers that were moved into
+	 * pieces.
+	 */
+	size_t nmarks;
+
+	/* The pieces that are ready to be printed in output order. */
+	struct ptxed_piece *first;
+	struct ptxed_piece *last;
+
+	/* The number of bytes in @first to @last. */
+	size_t buffered;
+
+	/* A flag saying that the output is being printed. */
+	uint32_t printing:1;
+
+	/* A flag saying that the decoder is done and added its last piece. */
+	uint32_t closed:1;
+
+	/* A flag saying that the output will not be printed. */
+	uint32_t abort:1;
+
+	/* The lock protecting the fields shared with the printer. */
+	mtx_t lock;
+
+	/* Signaled when a piece has been added or removed or when a flag
+	 * changed.
+	 */
+	cnd_t changed;
+};
+#endif /* defined(FEATURE_THREADS) */
+
+#if defined(FEATURE_SIDEBAND) && defined(FEATURE_PEVENT)
+/* A source of sideband. */
+struct ptxed_sb_source {
+	/* The perf event sideband decoder configuration. */
+	struct pt_sb_pevent_config config;
+
+	/* The perf.data file to load sideband from - NULL to load sideband
+	 * from the file named in @config.
+	 */
+	struct pt_sb_perf_data *pdata;
+
+	/* The cpu whose sideband in @pdata is primary - UINT32_MAX if none. */
+	uint32_t cpu;
+};
+#endif /* defined(FEATURE_SIDEBAND) && defined(FEATURE_PEVENT) */
+
 /* The decoder to use. */
 struct ptxed_decoder {
 	/* The decoder type. */
@@ -90,13 +368,102 @@ struct ptxed_decoder {
 	/* The image section cache. */
 	struct pt_image_section_cache *iscache;
 
+	/* The cache of decoded instructions. */
+	struct ptxed_insn_cache *insn_cache;
+
+	/* The stream to print the decoded trace to. */
+	FILE *stream;
+
+	/* The trace offset of the PSB packet at which to start decoding.
+	 *
+	 * This is only used if @sync_set is set.  Otherwise, we search for the
+	 * first PSB packet in the trace.
+	 */
+	uint64_t begin;
+
+	/* The range of trace to decode - NULL to decode until the end of the
+	 * trace.
+	 */
+	struct ptxed_range *range;
+
+	/* The decoder to use for decoding the leading items of the range
+	 * following @range - NULL if @range is NULL.
+	 */
+	struct ptxed_decoder *lead;
+
+	/* The profile to add decoded items to - NULL if not profiling. */
+	struct ptxed_profile *profile;
+
+	/* The call graph to add decoded items to - NULL if not tracking
+	 * calls.
+	 */
+	struct ptxed_callgraph *callgraph;
+
+#if defined(FEATURE_THREADS)
+	/* The output that @stream writes to - NULL if @stream is not
+	 * buffered in memory.
+	 */
+	struct ptxed_output *output;
+#endif /* defined(FEATURE_THREADS) */
+
+	/* A flag saying whether to start decoding at @begin. */
+	uint32_t sync_set:1;
+
 #if defined(FEATURE_SIDEBAND)
 	/* The sideband session. */
 	struct pt_sb_session *session;
 
+	/* The options for printing sideband diagnostics. */
+	const struct ptxed_options *options;
+
+	/* The sideband index from which to restore @session when starting to
+	 * decode a trace range - NULL if @session is used from the beginning.
+	 */
+	const struct pt_sb_index *sb_index;
+
+	/* The decoder whose sideband configuration to replicate when
+	 * restoring @session from @sb_index.
+	 */
+	const struct ptxed_decoder *sb_origin;
+
+	/* The image to decode with until sideband switches images - only used
+	 * with @sb_index.
+	 */
+	struct pt_image *image;
+
+	/* A flag saying whether sideband decoders have been added to
+	 * @session.
+	 */
+	uint32_t have_sb:1;
+
 #if defined(FEATURE_PEVENT)
 	/* The perf event sideband decoder configuration. */
 	struct pt_sb_pevent_config pevent;
+
+	/* The sources of the sideband decoders in @session in the order in
+	 * which they were added.
+	 */
+	struct ptxed_sb_source *sb_sources;
+
+	/* The number of @sb_sources. */
+	uint32_t nsb_sources;
+
+	/* The perf.data file providing the trace or NULL.
+	 *
+	 * The trace is mapped from this file and must not be freed.  This is
+	 * one of @perf_data_files.
+	 */
+	struct pt_sb_perf_data *perf_data;
+
+	/* The perf.data files providing sideband.
+	 *
+	 * Sideband decoders in @session reference the files' data.  They are
+	 * closed after @session has been freed.
+	 */
+	struct pt_sb_perf_data **perf_data_files;
+
+	/* The number of @perf_data_files. */
+	uint32_t nperf_data_files;
 #endif /* defined(FEATURE_PEVENT) */
 #endif /* defined(FEATURE_SIDEBAND) */
 };
@@ -107,6 +474,28 @@ struct ptxed_options {
 	/* Sideband dump flags. */
 	uint32_t sb_dump_flags;
 #endif
+	/* The number of trace segments to decode counting from the end of the
+	 * trace - zero to decode the entire trace.
+	 */
+	uint64_t last_segments;
+
+	/* The number of entries to print in each profile table - zero to
+	 * print all entries.
+	 */
+	uint64_t profile_top;
+
+	/* The file to write the profile to in binary format - NULL to print
+	 * the profile.
+	 */
+	const char *profile_bin;
+
+#if defined(FEATURE_THREADS)
+	/* The number of threads for decoding the trace in parallel - zero or
+	 * one to decode the trace sequentially.
+	 */
+	uint32_t threads;
+#endif /* defined(FEATURE_THREADS) */
+
 	/* Do not print the instruction. */
 	uint32_t dont_print_insn:1;
 
@@ -116,6 +505,12 @@ struct ptxed_options {
 	/* Print statistics (overrides quiet). */
 	uint32_t print_stats:1;
 
+	/* Print an execution profile (implies quiet). */
+	uint32_t profile:1;
+
+	/* Print call paths in folded stack format (implies quiet). */
+	uint32_t folded:1;
+
 	/* Print information about section loads and unloads. */
 	uint32_t track_image:1;
 
@@ -149,6 +544,9 @@ struct ptxed_options {
 #if defined(FEATURE_SIDEBAND)
 	/* Print sideband warnings. */
 	uint32_t print_sb_warnings:1;
+
+	/* Print the new image name on context switches. */
+	uint32_t print_sb_switch:1;
 #endif
 };
 
@@ -182,6 +580,23 @@ static int ptxed_have_decoder(const struct ptxed_decoder *decoder)
 	return decoder && decoder->variant.insn;
 }
 
+static const struct pt_config *
+ptxed_get_config(const struct ptxed_decoder *decoder)
+{
+	if (!decoder)
+		return NULL;
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		return pt_insn_get_config(decoder->variant.insn);
+
+	case pdt_block_decoder:
+		return pt_blk_get_config(decoder->variant.block);
+	}
+
+	return NULL;
+}
+
 static int ptxed_init_decoder(struct ptxed_decoder *decoder)
 {
 	if (!decoder)
@@ -189,6 +604,7 @@ static int ptxed_init_decoder(struct ptxed_decoder *decoder)
 
 	memset(decoder, 0, sizeof(*decoder));
 	decoder->type = pdt_block_decoder;
+	decoder->stream = stdout;
 
 	decoder->iscache = pt_iscache_alloc(NULL);
 	if (!decoder->iscache)
@@ -229,11 +645,41 @@ static void ptxed_free_decoder(struct ptxed_decoder *decoder)
 
 #if defined(FEATURE_SIDEBAND)
 	pt_sb_free(decoder->session);
-#endif
 
+#if defined(FEATURE_PEVENT)
+	{
+		uint32_t idx;
+
+		for (idx = 0; idx < decoder->nperf_data_files; ++idx)
+			pt_sb_perf_data_close(decoder->perf_data_files[idx]);
+
+		free(decoder->perf_data_files);
+		free(decoder->sb_sources);
+	}
+#endif /* defined(FEATURE_PEVENT) */
+#endif /* defined(FEATURE_SIDEBAND) */
+
+	ptxed_insn_cache_free(decoder->insn_cache);
+	ptxed_profile_free(decoder->profile);
+	ptxed_callgraph_free(decoder->callgraph);
 	pt_iscache_free(decoder->iscache);
 }
 
+static void ptxed_free_trace(const struct ptxed_decoder *decoder,
+			     struct pt_config *config)
+{
+	if (!decoder || !config)
+		return;
+
+#if defined(FEATURE_SIDEBAND) && defined(FEATURE_PEVENT)
+	/* Trace mapped from a perf.data file is unmapped with @decoder. */
+	if (decoder->perf_data)
+		return;
+#endif
+
+	free(config->begin);
+}
+
 static void help(const char *name)
 {
 	printf("usage: %s [<options>]\n\n", name);
@@ -248,16 +694,26 @@ static void help(const char *name)
 	printf("  --raw-insn                           print the raw bytes of each instruction.\n");
 	printf("  --check                              perform checks (expensive).\n");
 	printf("  --iscache-limit <size>               set the image section cache limit to <size> bytes.\n");
+	printf("  --iscache-share                      share sections of the same file added via different paths.\n");
 	printf("  --event:time                         print the tsc for events if available.\n");
 	printf("  --event:ip                           print the ip of events if available.\n");
 	printf("  --event:tick                         request tick events.\n");
 	printf("  --filter:addr<n>_cfg <cfg>           set IA32_RTIT_CTL.ADDRn_CFG to <cfg>.\n");
 	printf("  --filter:addr<n>_a <base>            set IA32_RTIT_ADDRn_A to <base>.\n");
 	printf("  --filter:addr<n>_b <limit>           set IA32_RTIT_ADDRn_B to <limit>.\n");
+	printf("  --last-segments <n>                  decode only the last <n> trace segments.\n");
+#if defined(FEATURE_THREADS)
+	printf("  --threads <n>                        decode trace segments on <n> threads in parallel.\n");
+#endif /* defined(FEATURE_THREADS) */
 	printf("  --stat                               print statistics (even when quiet).\n");
 	printf("                                       collects all statistics unless one or more are selected.\n");
 	printf("  --stat:insn                          collect number of instructions.\n");
 	printf("  --stat:blocks                        collect number of blocks.\n");
+	printf("  --profile                            print an execution profile (implies --quiet).\n");
+	printf("  --profile:top <n>                    print only the top <n> profile entries.\n");
+	printf("  --profile:bin <file>                 write the profile to <file> in binary format instead (implies --profile).\n");
+	printf("                                       merge binary profiles with ptprof-merge.\n");
+	printf("  --folded                             print call paths in folded stack format (implies --quiet).\n");
 #if defined(FEATURE_SIDEBAND)
 	printf("  --sb:compact | --sb                  show sideband records in compact format.\n");
 	printf("  --sb:verbose                         show sideband records in verbose format.\n");
@@ -270,6 +726,10 @@ static void help(const char *name)
 	printf("  --pevent:primary/secondary <file>[:<from>[-<to>]]\n");
 	printf("                              load a perf_event sideband stream from <file>.\n");
 	printf("                              an optional offset or range can be given.\n");
+	printf("  --pevent:perf-data <file>[:<cpu>]\n");
+	printf("                              load perf_event sideband streams for all cpus from perf.data <file>.\n");
+	printf("                              the stream for <cpu>, if given, is primary.\n");
+	printf("                              unless --pt is given, decode the trace of <cpu>.\n");
 	printf("  --pevent:sample-type <val>  set perf_event_attr.sample_type to <val> (default: 0).\n");
 	printf("  --pevent:time-zero <val>    set perf_event_mmap_page.time_zero to <val> (default: 0).\n");
 	printf("  --pevent:time-shift <val>   set perf_event_mmap_page.time_shift to <val> (default: 0).\n");
@@ -283,6 +743,9 @@ static void help(const char *name)
 	printf("  --pevent:vdso-x64 <file>    use <file> as 64-bit vdso.\n");
 	printf("  --pevent:vdso-x32 <file>    use <file> as x32 vdso.\n");
 	printf("  --pevent:vdso-ia32 <file>   use <file> as 32-bit vdso.\n");
+#if defined(FEATURE_THREADS)
+	printf("  --pevent:prefetch           parse perf_event sideband streams on a separate thread.\n");
+#endif /* defined(FEATURE_THREADS) */
 #endif /* defined(FEATURE_PEVENT) */
 #endif /* defined(FEATURE_SIDEBAND) */
 	printf("  --verbose|-v                         print various information (even when quiet).\n");
@@ -653,14 +1116,14 @@ static const char *visualize_iclass(enum pt_insn_class iclass)
 	return "undefined";
 }
 
-static void check_insn_iclass(const xed_inst_t *inst,
+static void check_insn_iclass(FILE *stream, const xed_inst_t *inst,
 			      const struct pt_insn *insn, uint64_t offset)
 {
 	xed_category_enum_t category;
 	xed_iclass_enum_t iclass;
 
 	if (!inst || !insn) {
-		printf("[internal error]\n");
+		fprintf(stream, "[internal error]\n");
 		return;
 	}
 
@@ -805,82 +1268,121 @@ static void check_insn_iclass(const xed_inst_t *inst,
 	}
 
 	/* If we get here, @insn->iclass doesn't match XED's classification. */
-	printf("[%" PRIx64 ", %" PRIx64 ": iclass error: iclass: %s, "
-	       "xed iclass: %s, category: %s]\n", offset, insn->ip,
-	       visualize_iclass(insn->iclass), xed_iclass_enum_t2str(iclass),
-	       xed_category_enum_t2str(category));
+	fprintf(stream, "[%" PRIx64 ", %" PRIx64 ": iclass error: iclass: %s, "
+		"xed iclass: %s, category: %s]\n", offset, insn->ip,
+		visualize_iclass(insn->iclass), xed_iclass_enum_t2str(iclass),
+		xed_category_enum_t2str(category));
 
 }
 
-static void check_insn_decode(xed_decoded_inst_t *inst,
-			      const struct pt_insn *insn, uint64_t offset)
+/* Decode @insn into an entry of @cache.
+ *
+ * Returns the decoded instruction on success, NULL otherwise.  In case of
+ * errors, provides XED's error code in @xederr.
+ */
+static struct ptxed_cached_insn *
+ptxed_decode_insn(struct ptxed_insn_cache *cache, const struct pt_insn *insn,
+		  xed_error_enum_t *xederr)
 {
+	struct ptxed_cached_insn *entry;
 	xed_error_enum_t errcode;
 
-	if (!inst || !insn) {
-		printf("[internal error]\n");
-		return;
+	entry = ptxed_insn_cache_insert(cache, insn);
+	if (!entry) {
+		*xederr = XED_ERROR_GENERAL_ERROR;
+		return NULL;
 	}
 
-	xed_decoded_inst_set_mode(inst, translate_mode(insn->mode),
+	xed_decoded_inst_zero(&entry->inst);
+	xed_decoded_inst_set_mode(&entry->inst, translate_mode(insn->mode),
 				  XED_ADDRESS_WIDTH_INVALID);
 
-	/* Decode the instruction (again).
-	 *
-	 * We may have decoded the instruction already for printing.  In this
-	 * case, we will decode it twice.
-	 *
-	 * The more common use-case, however, is to check the instruction class
-	 * while not printing instructions since the latter is too expensive for
-	 * regular use with long traces.
-	 */
-	errcode = xed_decode(inst, insn->raw, insn->size);
-	if (errcode != XED_ERROR_NONE) {
-		printf("[%" PRIx64 ", %" PRIx64 ": xed error: (%u) %s]\n",
-		       offset, insn->ip, errcode,
-		       xed_error_enum_t2str(errcode));
-		return;
+	errcode = xed_decode(&entry->inst, entry->raw, entry->size);
+	*xederr = errcode;
+	if (errcode != XED_ERROR_NONE)
+		return NULL;
+
+	entry->valid = 1;
+	return entry;
+}
+
+/* Decode @insn for checking it, unless it is already in @cache.
+ *
+ * Checking the instruction class while not printing instructions is the
+ * more common use-case since printing is too expensive for regular use with
+ * long traces.  When printing, we already decoded the instruction.
+ *
+ * Returns the decoded instruction on success, NULL otherwise.
+ */
+static const struct ptxed_cached_insn *
+check_insn_decode(FILE *stream, struct ptxed_insn_cache *cache,
+		  const struct pt_insn *insn, uint64_t offset)
+{
+	const struct ptxed_cached_insn *entry;
+	xed_error_enum_t errcode;
+
+	if (!insn) {
+		fprintf(stream, "[internal error]\n");
+		return NULL;
 	}
 
-	if (!xed_decoded_inst_valid(inst)) {
-		printf("[%" PRIx64 ", %" PRIx64 ": xed error: "
-		       "invalid instruction]\n", offset, insn->ip);
-		return;
+	if (!insn->truncated) {
+		entry = ptxed_insn_cache_lookup(cache, insn->ip, insn->isid,
+						insn->mode);
+		if (entry)
+			return entry;
+	}
+
+	entry = ptxed_decode_insn(cache, insn, &errcode);
+	if (!entry) {
+		fprintf(stream,
+			"[%" PRIx64 ", %" PRIx64 ": xed error: (%u) %s]\n",
+			offset, insn->ip, errcode,
+			xed_error_enum_t2str(errcode));
+		return NULL;
+	}
+
+	if (!xed_decoded_inst_valid(&entry->inst)) {
+		fprintf(stream, "[%" PRIx64 ", %" PRIx64 ": xed error: "
+			"invalid instruction]\n", offset, insn->ip);
+		return NULL;
 	}
+
+	return entry;
 }
 
-static void check_insn(const struct pt_insn *insn, uint64_t offset)
+static void check_insn(FILE *stream, struct ptxed_insn_cache *cache,
+		       const struct pt_insn *insn, uint64_t offset)
 {
-	xed_decoded_inst_t inst;
+	const struct ptxed_cached_insn *entry;
 
 	if (!insn) {
-		printf("[internal error]\n");
+		fprintf(stream, "[internal error]\n");
 		return;
 	}
 
 	if (insn->isid <= 0)
-		printf("[%" PRIx64 ", %" PRIx64 ": check error: "
-		       "bad isid]\n", offset, insn->ip);
-
-	xed_decoded_inst_zero(&inst);
-	check_insn_decode(&inst, insn, offset);
+		fprintf(stream, "[%" PRIx64 ", %" PRIx64 ": check error: "
+			"bad isid]\n", offset, insn->ip);
 
 	/* We need a valid instruction in order to do further checks.
 	 *
 	 * Invalid instructions have already been diagnosed.
 	 */
-	if (!xed_decoded_inst_valid(&inst))
+	entry = check_insn_decode(stream, cache, insn, offset);
+	if (!entry)
 		return;
 
-	check_insn_iclass(xed_decoded_inst_inst(&inst), insn, offset);
+	check_insn_iclass(stream, xed_decoded_inst_inst(&entry->inst), insn,
+			  offset);
 }
 
-static void print_raw_insn(const struct pt_insn *insn)
+static void print_raw_insn(FILE *stream, const struct pt_insn *insn)
 {
 	uint8_t length, idx;
 
 	if (!insn) {
-		printf("[internal error]");
+		fprintf(stream, "[internal error]");
 		return;
 	}
 
@@ -889,33 +1391,56 @@ static void print_raw_insn(const struct pt_insn *insn)
 		length = sizeof(insn->raw);
 
 	for (idx = 0; idx < length; ++idx)
-		printf(" %02x", insn->raw[idx]);
+		fprintf(stream, " %02x", insn->raw[idx]);
 
 	for (; idx < pt_max_insn_size; ++idx)
-		printf("   ");
+		fprintf(stream, "   ");
 }
 
-static void xed_print_insn(const xed_decoded_inst_t *inst, uint64_t ip,
-			   const struct ptxed_options *options)
+/* Disassemble @inst at @ip into @text of @size bytes as it is printed. */
+static void xed_format_insn(char *text, size_t size,
+			    const xed_decoded_inst_t *inst, uint64_t ip,
+			    const struct ptxed_options *options)
 {
 	xed_print_info_t pi;
 	char buffer[256];
 	xed_bool_t ok;
+	size_t len;
+
+	if (!text || !size)
+		return;
 
 	if (!inst || !options) {
-		printf(" [internal error]");
+		snprintf(text, size, " [internal error]");
 		return;
 	}
 
+	len = 0;
 	if (options->print_raw_insn) {
 		xed_uint_t length, i;
 
 		length = xed_decoded_inst_get_length(inst);
-		for (i = 0; i < length; ++i)
-			printf(" %02x", xed_decoded_inst_get_byte(inst, i));
+		if (pt_max_insn_size < length)
+			length = pt_max_insn_size;
+
+		for (i = 0; i < pt_max_insn_size; ++i) {
+			int printed;
+
+			if (i < length) {
+				xed_uint_t byte;
+
+				byte = xed_decoded_inst_get_byte(inst, i);
+				printed = snprintf(text + len, size - len,
+						   " %02x", byte);
+			} else
+				printed = snprintf(text + len, size - len,
+						   "   ");
 
-		for (; i < pt_max_insn_size; ++i)
-			printf("   ");
+			if ((printed < 0) || ((size - len) <= (size_t) printed))
+				return;
+
+			len += (size_t) printed;
+		}
 	}
 
 	xed_init_print_info(&pi);
@@ -929,59 +1454,79 @@ static void xed_print_insn(const xed_decoded_inst_t *inst, uint64_t ip,
 
 	ok = xed_format_generic(&pi);
 	if (!ok) {
-		printf(" [xed print error]");
+		snprintf(text + len, size - len, " [xed print error]");
+		return;
+	}
+
+	snprintf(text + len, size - len, "  %s", buffer);
+}
+
+/* Print the decoded instruction in @entry.
+ *
+ * We disassemble the instruction the first time it is printed and print the
+ * cached text afterwards.
+ */
+static void xed_print_insn(FILE *stream, struct ptxed_cached_insn *entry,
+			   const struct ptxed_options *options)
+{
+	if (!entry) {
+		fprintf(stream, " [internal error]");
 		return;
 	}
 
-	printf("  %s", buffer);
+	if (!entry->has_text) {
+		xed_format_insn(entry->text, sizeof(entry->text),
+				&entry->inst, entry->ip, options);
+		entry->has_text = 1;
+	}
+
+	fputs(entry->text, stream);
 }
 
-static void print_insn(const struct pt_insn *insn, xed_state_t *xed,
-		       const struct ptxed_options *options, uint64_t offset,
-		       uint64_t time)
+static void print_insn(FILE *stream, const struct pt_insn *insn,
+		       struct ptxed_insn_cache *cache,
+		       const struct ptxed_options *options,
+		       uint64_t offset, uint64_t time)
 {
 	if (!insn || !options) {
-		printf("[internal error]\n");
+		fprintf(stream, "[internal error]\n");
 		return;
 	}
 
 	if (options->print_offset)
-		printf("%016" PRIx64 "  ", offset);
+		fprintf(stream, "%016" PRIx64 "  ", offset);
 
 	if (options->print_time)
-		printf("%016" PRIx64 "  ", time);
+		fprintf(stream, "%016" PRIx64 "  ", time);
 
 	if (insn->speculative)
-		printf("? ");
+		fprintf(stream, "? ");
 
-	printf("%016" PRIx64, insn->ip);
+	fprintf(stream, "%016" PRIx64, insn->ip);
 
 	if (!options->dont_print_insn) {
-		xed_machine_mode_enum_t mode;
-		xed_decoded_inst_t inst;
+		struct ptxed_cached_insn *entry;
 		xed_error_enum_t errcode;
 
-		mode = translate_mode(insn->mode);
-
-		xed_state_set_machine_mode(xed, mode);
-		xed_decoded_inst_zero_set_mode(&inst, xed);
-
-		errcode = xed_decode(&inst, insn->raw, insn->size);
-		switch (errcode) {
-		case XED_ERROR_NONE:
-			xed_print_insn(&inst, insn->ip, options);
-			break;
-
-		default:
-			print_raw_insn(insn);
-
-			printf(" [xed decode error: (%u) %s]", errcode,
-			       xed_error_enum_t2str(errcode));
-			break;
+		errcode = XED_ERROR_NONE;
+		entry = NULL;
+		if (!insn->truncated)
+			entry = ptxed_insn_cache_lookup(cache, insn->ip,
+							insn->isid, insn->mode);
+		if (!entry)
+			entry = ptxed_decode_insn(cache, insn, &errcode);
+
+		if (entry)
+			xed_print_insn(stream, entry, options);
+		else {
+			print_raw_insn(stream, insn);
+
+			fprintf(stream, " [xed decode error: (%u) %s]", errcode,
+				xed_error_enum_t2str(errcode));
 		}
 	}
 
-	printf("\n");
+	fprintf(stream, "\n");
 }
 
 static const char *print_exec_mode(enum pt_exec_mode mode)
@@ -1003,203 +1548,215 @@ static const char *print_exec_mode(enum pt_exec_mode mode)
 	return "<invalid>";
 }
 
-static void print_event(const struct pt_event *event,
+static void print_event(FILE *stream, const struct pt_event *event,
 			const struct ptxed_options *options, uint64_t offset)
 {
 	if (!event || !options) {
-		printf("[internal error]\n");
+		fprintf(stream, "[internal error]\n");
 		return;
 	}
 
-	printf("[");
+	fprintf(stream, "[");
 
 	if (options->print_offset)
-		printf("%016" PRIx64 "  ", offset);
+		fprintf(stream, "%016" PRIx64 "  ", offset);
 
 	if (options->print_event_time && event->has_tsc)
-		printf("%016" PRIx64 "  ", event->tsc);
+		fprintf(stream, "%016" PRIx64 "  ", event->tsc);
 
 	switch (event->type) {
 	case ptev_enabled:
-		printf("%s", event->variant.enabled.resumed ? "resumed" :
-		       "enabled");
+		fprintf(stream, "%s", event->variant.enabled.resumed ?
+			"resumed" : "enabled");
 
 		if (options->print_event_ip)
-			printf(", ip: %016" PRIx64, event->variant.enabled.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.enabled.ip);
 		break;
 
 	case ptev_disabled:
-		printf("disabled");
+		fprintf(stream, "disabled");
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.disabled.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.disabled.ip);
 		break;
 
 	case ptev_async_disabled:
-		printf("disabled");
+		fprintf(stream, "disabled");
 
 		if (options->print_event_ip) {
-			printf(", at: %016" PRIx64,
-			       event->variant.async_disabled.at);
+			fprintf(stream, ", at: %016" PRIx64,
+				event->variant.async_disabled.at);
 
 			if (!event->ip_suppressed)
-				printf(", ip: %016" PRIx64,
-				       event->variant.async_disabled.ip);
+				fprintf(stream, ", ip: %016" PRIx64,
+					event->variant.async_disabled.ip);
 		}
 		break;
 
 	case ptev_async_branch:
-		printf("interrupt");
+		fprintf(stream, "interrupt");
 
 		if (options->print_event_ip) {
-			printf(", from: %016" PRIx64,
-			       event->variant.async_branch.from);
+			fprintf(stream, ", from: %016" PRIx64,
+				event->variant.async_branch.from);
 
 			if (!event->ip_suppressed)
-				printf(", to: %016" PRIx64,
-				       event->variant.async_branch.to);
+				fprintf(stream, ", to: %016" PRIx64,
+					event->variant.async_branch.to);
 		}
 		break;
 
 	case ptev_paging:
-		printf("paging, cr3: %016" PRIx64 "%s",
-		       event->variant.paging.cr3,
-		       event->variant.paging.non_root ? ", nr" : "");
+		fprintf(stream, "paging, cr3: %016" PRIx64 "%s",
+			event->variant.paging.cr3,
+			event->variant.paging.non_root ? ", nr" : "");
 		break;
 
 	case ptev_async_paging:
-		printf("paging, cr3: %016" PRIx64 "%s",
-		       event->variant.async_paging.cr3,
-		       event->variant.async_paging.non_root ? ", nr" : "");
+		fprintf(stream, "paging, cr3: %016" PRIx64 "%s",
+			event->variant.async_paging.cr3,
+			event->variant.async_paging.non_root ? ", nr" : "");
 
 		if (options->print_event_ip)
-			printf(", ip: %016" PRIx64,
-			       event->variant.async_paging.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.async_paging.ip);
 		break;
 
 	case ptev_overflow:
-		printf("overflow");
+		fprintf(stream, "overflow");
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.overflow.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.overflow.ip);
 		break;
 
 	case ptev_exec_mode:
-		printf("exec mode: %s",
-		       print_exec_mode(event->variant.exec_mode.mode));
+		fprintf(stream, "exec mode: %s",
+			print_exec_mode(event->variant.exec_mode.mode));
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64,
-			       event->variant.exec_mode.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.exec_mode.ip);
 		break;
 
 	case ptev_tsx:
 		if (event->variant.tsx.aborted)
-			printf("aborted");
+			fprintf(stream, "aborted");
 		else if (event->variant.tsx.speculative)
-			printf("begin transaction");
+			fprintf(stream, "begin transaction");
 		else
-			printf("committed");
+			fprintf(stream, "committed");
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.tsx.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.tsx.ip);
 		break;
 
 	case ptev_stop:
-		printf("stopped");
+		fprintf(stream, "stopped");
 		break;
 
 	case ptev_vmcs:
-		printf("vmcs, base: %016" PRIx64, event->variant.vmcs.base);
+		fprintf(stream, "vmcs, base: %016" PRIx64,
+			event->variant.vmcs.base);
 		break;
 
 	case ptev_async_vmcs:
-		printf("vmcs, base: %016" PRIx64,
-		       event->variant.async_vmcs.base);
+		fprintf(stream, "vmcs, base: %016" PRIx64,
+			event->variant.async_vmcs.base);
 
 		if (options->print_event_ip)
-			printf(", ip: %016" PRIx64,
-			       event->variant.async_vmcs.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.async_vmcs.ip);
 		break;
 
 	case ptev_exstop:
-		printf("exstop");
+		fprintf(stream, "exstop");
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.exstop.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.exstop.ip);
 		break;
 
 	case ptev_mwait:
-		printf("mwait %" PRIx32 " %" PRIx32,
-		       event->variant.mwait.hints, event->variant.mwait.ext);
+		fprintf(stream, "mwait %" PRIx32 " %" PRIx32,
+			event->variant.mwait.hints, event->variant.mwait.ext);
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.mwait.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.mwait.ip);
 		break;
 
 	case ptev_pwre:
-		printf("pwre c%u.%u", (event->variant.pwre.state + 1) & 0xf,
-		       (event->variant.pwre.sub_state + 1) & 0xf);
+		fprintf(stream, "pwre c%u.%u",
+			(event->variant.pwre.state + 1) & 0xf,
+			(event->variant.pwre.sub_state + 1) & 0xf);
 
 		if (event->variant.pwre.hw)
-			printf(" hw");
+			fprintf(stream, " hw");
 		break;
 
 
 	case ptev_pwrx:
-		printf("pwrx ");
+		fprintf(stream, "pwrx ");
 
 		if (event->variant.pwrx.interrupt)
-			printf("int: ");
+			fprintf(stream, "int: ");
 
 		if (event->variant.pwrx.store)
-			printf("st: ");
+			fprintf(stream, "st: ");
 
 		if (event->variant.pwrx.autonomous)
-			printf("hw: ");
+			fprintf(stream, "hw: ");
 
-		printf("c%u (c%u)", (event->variant.pwrx.last + 1) & 0xf,
-		       (event->variant.pwrx.deepest + 1) & 0xf);
+		fprintf(stream, "c%u (c%u)",
+			(event->variant.pwrx.last + 1) & 0xf,
+			(event->variant.pwrx.deepest + 1) & 0xf);
 		break;
 
 	case ptev_ptwrite:
-		printf("ptwrite: %" PRIx64, event->variant.ptwrite.payload);
+		fprintf(stream, "ptwrite: %" PRIx64,
+			event->variant.ptwrite.payload);
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.ptwrite.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.ptwrite.ip);
 		break;
 
 	case ptev_tick:
-		printf("tick");
+		fprintf(stream, "tick");
 
 		if (options->print_event_ip && !event->ip_suppressed)
-			printf(", ip: %016" PRIx64, event->variant.tick.ip);
+			fprintf(stream, ", ip: %016" PRIx64,
+				event->variant.tick.ip);
 		break;
 
 	case ptev_cbr:
-		printf("cbr: %x", event->variant.cbr.ratio);
+		fprintf(stream, "cbr: %x", event->variant.cbr.ratio);
 		break;
 
 	case ptev_mnt:
-		printf("mnt: %" PRIx64, event->variant.mnt.payload);
+		fprintf(stream, "mnt: %" PRIx64, event->variant.mnt.payload);
 		break;
 
 	case ptev_tip:
-		printf("tip: %" PRIx64, event->variant.tip.ip);
+		fprintf(stream, "tip: %" PRIx64, event->variant.tip.ip);
 		break;
 
 	case ptev_tnt: {
 		uint64_t index;
 
-		printf("tnt: ");
+		fprintf(stream, "tnt: ");
 		for (index = event->variant.tnt.size; index; index >>= 1)
-			printf("%s",
-			       (event->variant.tnt.bits & index) ? "!" : ".");
+			fprintf(stream, "%s",
+				(event->variant.tnt.bits & index) ? "!" : ".");
 	}
 		break;
 	}
 
-	printf("]\n");
+	fprintf(stream, "]\n");
 }
 
 static void diagnose(struct ptxed_decoder *decoder, uint64_t ip,
@@ -1222,30 +1779,41 @@ static void diagnose(struct ptxed_decoder *decoder, uint64_t ip,
 	}
 
 	if (err < 0) {
-		printf("could not determine offset: %s\n",
-		       pt_errstr(pt_errcode(err)));
-		printf("[?, %" PRIx64 ": %s: %s]\n", ip, errtype,
-		       pt_errstr(pt_errcode(errcode)));
+		fprintf(decoder->stream, "could not determine offset: %s\n",
+			pt_errstr(pt_errcode(err)));
+		fprintf(decoder->stream, "[?, %" PRIx64 ": %s: %s]\n", ip,
+			errtype, pt_errstr(pt_errcode(errcode)));
 	} else
-		printf("[%" PRIx64 ", %" PRIx64 ": %s: %s]\n", pos,
-		       ip, errtype, pt_errstr(pt_errcode(errcode)));
+		fprintf(decoder->stream, "[%" PRIx64 ", %" PRIx64 ": %s: %s]\n",
+			pos, ip, errtype, pt_errstr(pt_errcode(errcode)));
 }
 
 #if defined(FEATURE_SIDEBAND)
 
-static int ptxed_sb_event(struct ptxed_decoder *decoder,
-			  const struct pt_event *event,
-			  const struct ptxed_options *options)
+/* Apply @event to @decoder's sideband session.
+ *
+ * Sideband records are printed to @stream according to @flags.  If @stream is
+ * NULL, nothing is printed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_apply(struct ptxed_decoder *decoder,
+			  const struct pt_event *event, FILE *stream,
+			  uint32_t flags)
 {
 	struct pt_image *image;
 	int errcode;
 
-	if (!decoder || !event || !options)
+	if (!decoder || !event)
 		return -pte_internal;
 
+	/* Decoders for parallel decode without sideband have no session. */
+	if (!decoder->session)
+		return 0;
+
 	image = NULL;
 	errcode = pt_sb_event(decoder->session, &image, event, sizeof(*event),
-			      stdout, options->sb_dump_flags);
+			      stream, flags);
 	if (errcode < 0)
 		return errcode;
 
@@ -1263,757 +1831,3396 @@ static int ptxed_sb_event(struct ptxed_decoder *decoder,
 	return -pte_internal;
 }
 
-#endif /* defined(FEATURE_SIDEBAND) */
+static int ptxed_sb_event(struct ptxed_decoder *decoder,
+			  const struct pt_event *event,
+			  const struct ptxed_options *options)
+{
+	if (!decoder || !options)
+		return -pte_internal;
 
-static int drain_events_insn(struct ptxed_decoder *decoder, uint64_t *time,
-			     int status, const struct ptxed_options *options)
+	return ptxed_sb_apply(decoder, event, decoder->stream,
+			      options->sb_dump_flags);
+}
+
+static int ptxed_print_error(int errcode, const char *filename,
+			     uint64_t offset, void *priv)
 {
-	struct pt_insn_decoder *ptdec;
-	int errcode;
+	const struct ptxed_decoder *decoder;
+	const char *errstr, *severity;
 
-	if (!decoder || !time || !options)
+	decoder = (struct ptxed_decoder *) priv;
+	if (!decoder || !decoder->options)
 		return -pte_internal;
 
-	ptdec = decoder->variant.insn;
+	/* Decoders for the leading items of a trace range do not print. */
+	if (!decoder->stream)
+		return 0;
 
-	while (status & pts_event_pending) {
-		struct pt_event event;
-		uint64_t offset;
+	if (errcode >= 0 && !decoder->options->print_sb_warnings)
+		return 0;
 
-		offset = 0ull;
-		if (options->print_offset) {
-			errcode = pt_insn_get_offset(ptdec, &offset);
-			if (errcode < 0)
-				return errcode;
-		}
+	if (!filename)
+		filename = "<unknown>";
 
-		status = pt_insn_event(ptdec, &event, sizeof(event));
-		if (status < 0)
-			return status;
+	severity = errcode < 0 ? "error" : "warning";
 
-		*time = event.tsc;
+	errstr = errcode < 0
+		? pt_errstr(pt_errcode(errcode))
+		: pt_sb_errstr((enum pt_sb_error_code) errcode);
 
-		if (!options->quiet && !event.status_update)
-			print_event(&event, options, offset);
+	if (!errstr)
+		errstr = "<unknown error>";
 
-#if defined(FEATURE_SIDEBAND)
-		errcode = ptxed_sb_event(decoder, &event, options);
-		if (errcode < 0)
-			return errcode;
-#endif /* defined(FEATURE_SIDEBAND) */
-	}
+	fprintf(decoder->stream, "[%s:%016" PRIx64 " sideband %s: %s]\n",
+		filename, offset, severity, errstr);
 
-	return status;
+	return 0;
 }
 
-static void decode_insn(struct ptxed_decoder *decoder,
-			const struct ptxed_options *options,
-			struct ptxed_stats *stats)
+static int ptxed_print_switch(const struct pt_sb_context *context, void *priv)
 {
-	struct pt_insn_decoder *ptdec;
-	xed_state_t xed;
-	uint64_t offset, sync, time;
-
-	if (!decoder || !options) {
-		printf("[internal error]\n");
-		return;
-	}
-
-	xed_state_zero(&xed);
+	const struct ptxed_decoder *decoder;
+	struct pt_image *image;
+	const char *name;
 
-	ptdec = decoder->variant.insn;
-	offset = 0ull;
-	sync = 0ull;
-	time = 0ull;
-	for (;;) {
-		struct pt_insn insn;
-		int status;
+	decoder = (struct ptxed_decoder *) priv;
+	if (!decoder)
+		return -pte_internal;
 
-		/* Initialize the IP - we use it for error reporting. */
-		insn.ip = 0ull;
+	if (!decoder->stream)
+		return 0;
 
-		status = pt_insn_sync_forward(ptdec);
-		if (status < 0) {
-			uint64_t new_sync;
-			int errcode;
+	image = pt_sb_ctx_image(context);
+	if (!image)
+		return -pte_internal;
 
-			if (status == -pte_eos)
-				break;
+	name = pt_image_name(image);
+	if (!name)
+		name = "<unknown>";
 
-			diagnose(decoder, insn.ip, "sync error", status);
+	fprintf(decoder->stream, "[context: %s]\n", name);
 
-			/* Let's see if we made any progress.  If we haven't,
-			 * we likely never will.  Bail out.
-			 *
-			 * We intentionally report the error twice to indicate
-			 * that we tried to re-sync.  Maybe it even changed.
-			 */
-			errcode = pt_insn_get_offset(ptdec, &new_sync);
-			if (errcode < 0 || (new_sync <= sync))
-				break;
+	return 0;
+}
 
-			sync = new_sync;
-			continue;
-		}
+#if defined(FEATURE_PEVENT)
 
-		for (;;) {
-			status = drain_events_insn(decoder, &time, status,
-						   options);
-			if (status < 0)
-				break;
+/* Add the sideband decoders for @source to @session.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_alloc_source(struct pt_sb_session *session,
+				 const struct ptxed_sb_source *source)
+{
+	if (!source)
+		return -pte_internal;
 
-			if (status & pts_eos) {
-				if (!(status & pts_ip_suppressed) &&
-				    !options->quiet)
-					printf("[end of trace]\n");
+	if (source->pdata)
+		return pt_sb_alloc_perf_data_decoders(session, source->pdata,
+						      &source->config,
+						      source->cpu);
 
-				status = -pte_eos;
-				break;
-			}
+	return pt_sb_alloc_pevent_decoder(session, &source->config);
+}
 
-			if (options->print_offset || options->check) {
-				int errcode;
+#endif /* defined(FEATURE_PEVENT) */
 
-				errcode = pt_insn_get_offset(ptdec, &offset);
-				if (errcode < 0)
-					break;
-			}
+/* Allocate a sideband session that is set up like @origin's.
+ *
+ * The new session has the same sideband decoders in the same order and a copy
+ * of @origin's kernel image.  It has no notifiers.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_replicate(struct pt_sb_session **psession,
+			      const struct ptxed_decoder *origin)
+{
+	struct pt_sb_session *session;
+	int errcode;
 
-			status = pt_insn_next(ptdec, &insn, sizeof(insn));
-			if (status < 0) {
-				/* Even in case of errors, we may have succeeded
-				 * in decoding the current instruction.
-				 */
-				if (insn.iclass != ptic_unknown) {
-					if (!options->quiet)
-						print_insn(&insn, &xed, options,
-							   offset, time);
-					if (stats)
-						stats->insn += 1;
+	if (!psession || !origin)
+		return -pte_internal;
 
-					if (options->check)
-						check_insn(&insn, offset);
-				}
-				break;
-			}
+	session = pt_sb_alloc(origin->iscache);
+	if (!session)
+		return -pte_nomem;
 
-			if (!options->quiet)
-				print_insn(&insn, &xed, options, offset, time);
+	errcode = pt_image_copy(pt_sb_kernel_image(session),
+				pt_sb_kernel_image(origin->session));
+	if (errcode < 0)
+		goto err;
 
-			if (stats)
-				stats->insn += 1;
+#if defined(FEATURE_PEVENT)
+	{
+		uint32_t idx;
 
-			if (options->check)
-				check_insn(&insn, offset);
+		for (idx = 0; idx < origin->nsb_sources; ++idx) {
+			errcode = ptxed_sb_alloc_source(session,
+							&origin->sb_sources[idx]);
+			if (errcode < 0)
+				goto err;
 		}
+	}
+#endif /* defined(FEATURE_PEVENT) */
 
-		/* We shouldn't break out of the loop without an error. */
-		if (!status)
-			status = -pte_internal;
-
-		/* We're done when we reach the end of the trace stream. */
-		if (status == -pte_eos)
-			break;
+	*psession = session;
+	return 0;
 
-		diagnose(decoder, insn.ip, "error",  status);
-	}
+err:
+	pt_sb_free(session);
+	return errcode;
 }
 
-static int xed_next_ip(uint64_t *pip, const xed_decoded_inst_t *inst,
-		       uint64_t ip)
+/* Restore @decoder's sideband session for decoding from the PSB packet at
+ * @offset.
+ *
+ * We replace @decoder's session with a replica of @decoder's @sb_origin's
+ * session.  If @seek is non-zero, we restore it from @decoder's @sb_index at
+ * the PSB packet's time.  Otherwise, it starts from the beginning of the
+ * sideband like a sequential decode.  This leaves @decoder synchronized at
+ * @offset.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_restore(struct ptxed_decoder *decoder, uint64_t offset,
+			    int seek)
 {
-	xed_uint_t length, disp_width;
+	struct pt_sb_session *session;
+	uint64_t tsc;
+	int errcode;
 
-	if (!pip || !inst)
+	if (!decoder || !decoder->options)
 		return -pte_internal;
 
-	length = xed_decoded_inst_get_length(inst);
-	if (!length) {
-		printf("[xed error: failed to determine instruction length]\n");
-		return -pte_bad_insn;
-	}
-
-	ip += length;
+	if (!decoder->sb_index)
+		return 0;
 
-	/* If it got a branch displacement it must be a branch.
+	/* If we can't tell the time, we start from the beginning.
 	 *
-	 * This includes conditional branches for which we don't know whether
-	 * they were taken.  The next IP won't be used in this case as a
-	 * conditional branch ends a block.  The next block will start with the
-	 * correct IP.
+	 * The decoder must not use the old session's images.
 	 */
-	disp_width = xed_decoded_inst_get_branch_displacement_width(inst);
-	if (disp_width)
-		ip += (uint64_t) (int64_t)
-			xed_decoded_inst_get_branch_displacement(inst);
+	tsc = 0ull;
+	errcode = -pte_internal;
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		if ((pt_insn_sync_set(decoder->variant.insn, offset) >= 0) &&
+		    seek)
+			(void) pt_insn_time(decoder->variant.insn, &tsc, NULL,
+					    NULL);
 
-	*pip = ip;
-	return 0;
+		errcode = pt_insn_set_image(decoder->variant.insn,
+					    decoder->image);
+		break;
+
+	case pdt_block_decoder:
+		if ((pt_blk_sync_set(decoder->variant.block, offset) >= 0) &&
+		    seek)
+			(void) pt_blk_time(decoder->variant.block, &tsc, NULL,
+					   NULL);
+
+		errcode = pt_blk_set_image(decoder->variant.block,
+					   decoder->image);
+		break;
+	}
+
+	if (errcode < 0)
+		return errcode;
+
+	pt_sb_free(decoder->session);
+	decoder->session = NULL;
+
+	errcode = ptxed_sb_replicate(&session, decoder->sb_origin);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->session = session;
+
+	pt_sb_notify_error(session, ptxed_print_error, decoder);
+	if (decoder->options->print_sb_switch)
+		pt_sb_notify_switch(session, ptxed_print_switch, decoder);
+
+	errcode = pt_sb_index_restore(session, decoder->sb_index, tsc, NULL);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_sb_init_decoders(session);
 }
 
-static int block_fetch_insn(struct pt_insn *insn, const struct pt_block *block,
-			    uint64_t ip, struct pt_image_section_cache *iscache)
+#endif /* defined(FEATURE_SIDEBAND) */
+
+static int ptxed_items_add(struct ptxed_items *items,
+			   const struct ptxed_item *item)
 {
-	if (!insn || !block)
+	if (!items || !item)
 		return -pte_internal;
 
-	/* We can't read from an empty block. */
-	if (!block->ninsn)
-		return -pte_invalid;
-
-	memset(insn, 0, sizeof(*insn));
-	insn->mode = block->mode;
-	insn->isid = block->isid;
-	insn->ip = ip;
-
-	/* The last instruction in a block may be truncated. */
-	if ((ip == block->end_ip) && block->truncated) {
-		if (!block->size || (sizeof(insn->raw) < (size_t) block->size))
-			return -pte_bad_insn;
+	if (items->nitems == items->capacity) {
+		struct ptxed_item *grown;
+		size_t capacity;
 
-		insn->size = block->size;
-		memcpy(insn->raw, block->raw, insn->size);
-	} else {
-		int size;
+		capacity = items->capacity ? items->capacity * 2 : 16;
 
-		size = pt_iscache_read(iscache, insn->raw, sizeof(insn->raw),
-				       insn->isid, ip);
-		if (size < 0)
-			return size;
+		grown = realloc(items->item, capacity * sizeof(*grown));
+		if (!grown)
+			return -pte_nomem;
 
-		insn->size = (uint8_t) size;
+		items->item = grown;
+		items->capacity = capacity;
 	}
 
+	items->item[items->nitems++] = *item;
+
 	return 0;
 }
 
-static void diagnose_block(struct ptxed_decoder *decoder,
-			   const char *errtype, int errcode,
-			   const struct pt_block *block)
+/* Get the position in @decoder's output.
+ *
+ * Returns the position on success, a negative integer otherwise.
+ */
+static long ptxed_tell(const struct ptxed_decoder *decoder)
 {
-	uint64_t ip;
-	int err;
+	long pos;
 
-	if (!decoder || !block) {
-		printf("ptxed: internal error");
-		return;
+	pos = ftell(decoder->stream);
+
+#if defined(FEATURE_THREADS)
+	if (decoder->output && (0l <= pos)) {
+		if ((LONG_MAX - decoder->output->base) < pos)
+			return -1l;
+
+		pos += decoder->output->base;
 	}
+#endif /* defined(FEATURE_THREADS) */
 
-	/* Determine the IP at which to report the error.
-	 *
-	 * Depending on the type of error, the IP varies between that of the
-	 * last instruction in @block or the next instruction outside of @block.
-	 *
-	 * When the block is empty, we use the IP of the block itself,
-	 * i.e. where the first instruction should have been.
+	return pos;
+}
+
+/* Remember to print a marker for block number @block at output position @pos
+ * when printing @range's output.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_range_mark(struct ptxed_range *range, long pos,
+			    uint64_t block)
+{
+	struct ptxed_marks *marks;
+	struct ptxed_mark *mark;
+
+	if (!range || (pos < 0l))
+		return -pte_internal;
+
+	marks = &range->marks;
+	if (marks->nmarks == marks->capacity) {
+		struct ptxed_mark *grown;
+		size_t capacity;
+
+		capacity = marks->capacity ? marks->capacity * 2 : 16;
+
+		grown = realloc(marks->mark, capacity * sizeof(*grown));
+		if (!grown)
+			return -pte_nomem;
+
+		marks->mark = grown;
+		marks->capacity = capacity;
+	}
+
+	mark = &marks->mark[marks->nmarks];
+	mark->pos = pos;
+	mark->block = block;
+	marks->nmarks += 1;
+
+	return 0;
+}
+
+#if defined(FEATURE_THREADS)
+
+static void ptxed_piece_free(struct ptxed_piece *piece)
+{
+	if (!piece)
+		return;
+
+	free(piece->marks.mark);
+	free(piece->text);
+	free(piece);
+}
+
+/* Move what has been written to @output into a new piece.
+ *
+ * The piece takes @range's block markers that were added since the previous
+ * piece.  If @stream is not NULL, we continue writing into a new in-memory
+ * stream that is provided in @stream.  Otherwise, this is the last piece and
+ * @output is closed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_output_move(struct ptxed_output *output,
+			     const struct ptxed_range *range, FILE **stream)
+{
+	struct ptxed_memstream *current, *next;
+	struct ptxed_piece *piece;
+	size_t nmarks;
+	int errcode;
+
+	if (!output || !range || (range->marks.nmarks < output->nmarks) ||
+	    (1u < output->current))
+		return -pte_internal;
+
+	piece = malloc(sizeof(*piece));
+	if (!piece)
+		return -pte_nomem;
+
+	memset(piece, 0, sizeof(*piece));
+
+	nmarks = range->marks.nmarks - output->nmarks;
+	if (nmarks) {
+		struct ptxed_mark *mark;
+
+		mark = malloc(nmarks * sizeof(*mark));
+		if (!mark) {
+			free(piece);
+			return -pte_nomem;
+		}
+
+		memcpy(mark, &range->marks.mark[output->nmarks],
+		       nmarks * sizeof(*mark));
+
+		piece->marks.mark = mark;
+		piece->marks.nmarks = nmarks;
+		piece->marks.capacity = nmarks;
+	}
+
+	current = &output->memstream[output->current];
+	next = &output->memstream[!output->current];
+
+	/* We open the next stream first so we can keep writing into the current
+	 * stream if that fails.
+	 */
+	if (stream) {
+		errcode = ptxed_memstream_open(next);
+		if (errcode < 0) {
+			ptxed_piece_free(piece);
+			return errcode;
+		}
+
+		output->current = !output->current;
+		*stream = next->file;
+	}
+
+	errcode = ptxed_memstream_close(current, &piece->text, &piece->size);
+	if (errcode < 0) {
+		ptxed_piece_free(piece);
+		return errcode;
+	}
+
+	if ((size_t) (LONG_MAX - output->base) < piece->size) {
+		ptxed_piece_free(piece);
+		return -pte_overflow;
+	}
+
+	piece->pos = output->base;
+	output->base += (long) piece->size;
+	output->nmarks = range->marks.nmarks;
+
+	if (mtx_lock(&output->lock) != thrd_success) {
+		ptxed_piece_free(piece);
+		return -pte_bad_lock;
+	}
+
+	if (output->last)
+		output->last->next = piece;
+	else
+		output->first = piece;
+
+	output->last = piece;
+	output->buffered += piece->size;
+
+	/* The printer recognizes the last piece by the @closed flag. */
+	if (!stream)
+		output->closed = 1;
+
+	(void) cnd_broadcast(&output->changed);
+	(void) mtx_unlock(&output->lock);
+
+	return 0;
+}
+
+/* Move @decoder's output into a new piece once it is big enough.
+ *
+ * Unless the output is being printed, we wait for that once we buffered
+ * ptxed_output_limit bytes.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_bad_context if the output will not be printed.
+ */
+static int ptxed_output_flush(struct ptxed_decoder *decoder)
+{
+	struct ptxed_output *output;
+	long size;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	output = decoder->output;
+	if (!output)
+		return -pte_internal;
+
+	size = ftell(decoder->stream);
+	if (size < 0l)
+		return -pte_internal;
+
+	if (size < ptxed_piece_size)
+		return 0;
+
+	errcode = ptxed_output_move(output, decoder->range, &decoder->stream);
+	if (errcode < 0)
+		return errcode;
+
+	if (mtx_lock(&output->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	while (!output->printing && !output->abort &&
+	       (ptxed_output_limit < output->buffered)) {
+		if (cnd_wait(&output->changed, &output->lock) !=
+		    thrd_success) {
+			errcode = -pte_bad_lock;
+			break;
+		}
+	}
+
+	if (output->abort)
+		errcode = -pte_bad_context;
+
+	(void) mtx_unlock(&output->lock);
+
+	return errcode;
+}
+
+/* Move the remaining output into a last piece and close @output.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_output_close(struct ptxed_output *output,
+			      const struct ptxed_range *range)
+{
+	int errcode;
+
+	if (!output)
+		return -pte_internal;
+
+	errcode = 0;
+	if (output->memstream[output->current & 1u].file) {
+		errcode = ptxed_output_move(output, range, NULL);
+		if (errcode >= 0)
+			return 0;
+	}
+
+	/* We could not add a last piece.  Close @output without it. */
+	if (mtx_lock(&output->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	output->closed = 1;
+
+	(void) cnd_broadcast(&output->changed);
+	(void) mtx_unlock(&output->lock);
+
+	return errcode;
+}
+
+#endif /* defined(FEATURE_THREADS) */
+
+/* Get the offset of the PSB packet from which @decoder decodes up to its
+ * @begin without printing.
+ */
+static uint64_t ptxed_preroll(const struct ptxed_decoder *decoder)
+{
+	if (!decoder->range)
+		return decoder->begin;
+
+	return decoder->range->preroll;
+}
+
+/* Apply @event to @decoder's sideband session without printing.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_skip_event(struct ptxed_decoder *decoder,
+			    const struct pt_event *event)
+{
+#if defined(FEATURE_SIDEBAND)
+	return ptxed_sb_apply(decoder, event, NULL, 0u);
+#else
+	(void) decoder;
+	(void) event;
+
+	return 0;
+#endif
+}
+
+/* Synchronize @decoder onto the PSB packet at @begin.
+ *
+ * If @preroll lies before @begin, we synchronize onto the PSB packet at
+ * @preroll, instead, and decode up to @begin without printing.  This leaves
+ * @decoder in the state in which a sequential decode reaches @begin, provided it
+ * calibrated the trace's timing within the skipped trace.  Events in the
+ * skipped trace are applied to sideband.  If we fail to decode up to @begin, we
+ * synchronize at @begin.
+ *
+ * Provides the time of the last event in @time.
+ *
+ * Returns a non-negative pt_status_flag bit-vector on success, a negative
+ * pt_error_code otherwise.
+ */
+static int ptxed_sync_insn(struct ptxed_decoder *decoder, uint64_t preroll,
+			   uint64_t begin, uint64_t *time)
+{
+	struct pt_insn_decoder *ptdec;
+	int status;
+
+	if (!decoder || !time)
+		return -pte_internal;
+
+	ptdec = decoder->variant.insn;
+
+	if (preroll < begin) {
+		status = pt_insn_sync_set(ptdec, preroll);
+		for (;;) {
+			struct pt_insn insn;
+			uint64_t offset;
+
+			while ((status >= 0) && (status & pts_event_pending)) {
+				struct pt_event event;
+
+				status = pt_insn_event(ptdec, &event,
+						       sizeof(event));
+				if (status < 0)
+					break;
+
+				*time = event.tsc;
+
+				if (ptxed_skip_event(decoder, &event) < 0)
+					status = -pte_bad_context;
+			}
+
+			if ((status < 0) || (status & pts_eos))
+				break;
+
+			if (pt_insn_get_offset(ptdec, &offset) < 0)
+				break;
+
+			if (begin <= offset)
+				return status;
+
+			status = pt_insn_next(ptdec, &insn, sizeof(insn));
+		}
+	}
+
+	*time = 0ull;
+
+	return pt_insn_sync_set(ptdec, begin);
+}
+
+/* Synchronize @decoder onto the PSB packet at @begin.
+ *
+ * This mirrors ptxed_sync_insn() for the block decoder.
+ */
+static int ptxed_sync_block(struct ptxed_decoder *decoder, uint64_t preroll,
+			    uint64_t begin, uint64_t *time)
+{
+	struct pt_block_decoder *ptdec;
+	int status;
+
+	if (!decoder || !time)
+		return -pte_internal;
+
+	ptdec = decoder->variant.block;
+
+	if (preroll < begin) {
+		status = pt_blk_sync_set(ptdec, preroll);
+		for (;;) {
+			struct pt_block block;
+			uint64_t offset;
+
+			while ((status >= 0) && (status & pts_event_pending)) {
+				struct pt_event event;
+
+				status = pt_blk_event(ptdec, &event,
+						      sizeof(event));
+				if (status < 0)
+					break;
+
+				*time = event.tsc;
+
+				if (ptxed_skip_event(decoder, &event) < 0)
+					status = -pte_bad_context;
+			}
+
+			if ((status < 0) || (status & pts_eos))
+				break;
+
+			if (pt_blk_get_offset(ptdec, &offset) < 0)
+				break;
+
+			if (begin <= offset)
+				return status;
+
+			status = pt_blk_next(ptdec, &block, sizeof(block));
+		}
+	}
+
+	*time = 0ull;
+
+	return pt_blk_sync_set(ptdec, begin);
+}
+
+/* Add an item for the error @errcode at @ip to @lead.
+ *
+ * This mirrors ptxed_track_error().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_lead_error(struct ptxed_items *lead, uint64_t offset,
+			    uint64_t ip, int errcode)
+{
+	struct ptxed_item item;
+
+	item.offset = offset;
+	item.ip = ip;
+	item.time = 0ull;
+	item.event_tsc = 0ull;
+	item.tsc = 0ull;
+	item.ninsn = 0u;
+	item.isid = 0;
+	item.errcode = errcode;
+	item.pos = 0l;
+
+	return ptxed_items_add(lead, &item);
+}
+
+/* Decode the leading instructions of the trace segment starting at @begin.
+ *
+ * Like the range starting at @begin, we decode from @preroll without printing.
+ * This mirrors decode_insn() without printing.  We stop on the first error
+ * after adding an item for it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_lead_insn(struct ptxed_items *lead,
+			   struct ptxed_decoder *decoder, uint64_t preroll,
+			   uint64_t begin)
+{
+	struct pt_insn_decoder *ptdec;
+	struct pt_insn insn;
+	uint64_t offset, time;
+	int status;
+
+	if (!lead || !decoder)
+		return -pte_internal;
+
+	ptdec = decoder->variant.insn;
+
+	insn.ip = 0ull;
+	insn.iclass = ptic_unknown;
+
+	time = 0ull;
+	status = ptxed_sync_insn(decoder, preroll, begin, &time);
+	if (status < 0)
+		return 0;
+
+	for (;;) {
+		struct ptxed_item item;
+		int errcode;
+
+		while ((status >= 0) && (status & pts_event_pending)) {
+			struct pt_event event;
+
+			status = pt_insn_event(ptdec, &event, sizeof(event));
+			if (status < 0)
+				break;
+
+			time = event.tsc;
+
+			errcode = ptxed_skip_event(decoder, &event);
+			if (errcode < 0)
+				return 0;
+		}
+
+		if ((status < 0) || (status & pts_eos))
+			break;
+
+		errcode = pt_insn_get_offset(ptdec, &item.offset);
+		if (errcode < 0)
+			return 0;
+
+		status = pt_insn_next(ptdec, &insn, sizeof(insn));
+		if ((status < 0) && (insn.iclass == ptic_unknown))
+			break;
+
+		item.ip = insn.ip;
+		item.time = 0ull;
+		item.event_tsc = time;
+		item.tsc = 0ull;
+		item.ninsn = 1;
+		item.isid = insn.isid;
+		item.errcode = 0;
+		item.pos = 0l;
+
+		(void) pt_insn_time(ptdec, &item.tsc, NULL, NULL);
+
+		errcode = ptxed_items_add(lead, &item);
+		if (errcode < 0)
+			return errcode;
+
+		if (item.offset != lead->item[0].offset)
+			return 0;
+
+		if (status < 0)
+			break;
+	}
+
+	if ((status >= 0) || (status == -pte_eos))
+		return 0;
+
+	if (pt_insn_get_offset(ptdec, &offset) < 0)
+		return 0;
+
+	return ptxed_lead_error(lead, offset, insn.ip, status);
+}
+
+/* Decode the leading blocks of the trace segment starting at @begin.
+ *
+ * Like the range starting at @begin, we decode from @preroll without printing.
+ * This mirrors decode_block() without printing.  We stop on the first error
+ * after adding an item for it.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_lead_block(struct ptxed_items *lead,
+			    struct ptxed_decoder *decoder, uint64_t preroll,
+			    uint64_t begin)
+{
+	struct pt_block_decoder *ptdec;
+	struct pt_block block;
+	uint64_t offset, time;
+	int status;
+
+	if (!lead || !decoder)
+		return -pte_internal;
+
+	ptdec = decoder->variant.block;
+
+	block.ip = 0ull;
+	block.ninsn = 0u;
+
+	time = 0ull;
+	status = ptxed_sync_block(decoder, preroll, begin, &time);
+	if (status < 0)
+		return 0;
+
+	for (;;) {
+		struct ptxed_item item;
+		int errcode;
+
+		while ((status >= 0) && (status & pts_event_pending)) {
+			struct pt_event event;
+
+			status = pt_blk_event(ptdec, &event, sizeof(event));
+			if (status < 0)
+				break;
+
+			time = event.tsc;
+
+			errcode = ptxed_skip_event(decoder, &event);
+			if (errcode < 0)
+				return 0;
+		}
+
+		if ((status < 0) || (status & pts_eos))
+			break;
+
+		errcode = pt_blk_get_offset(ptdec, &item.offset);
+		if (errcode < 0)
+			return 0;
+
+		status = pt_blk_next(ptdec, &block, sizeof(block));
+		if ((status < 0) && !block.ninsn)
+			break;
+
+		item.ip = block.ip;
+		item.time = 0ull;
+		item.event_tsc = time;
+		item.tsc = 0ull;
+		item.ninsn = block.ninsn;
+		item.isid = block.isid;
+		item.errcode = 0;
+		item.pos = 0l;
+
+		(void) pt_blk_time(ptdec, &item.tsc, NULL, NULL);
+
+		errcode = ptxed_items_add(lead, &item);
+		if (errcode < 0)
+			return errcode;
+
+		if (item.offset != lead->item[0].offset)
+			return 0;
+
+		if (status < 0)
+			break;
+	}
+
+	if ((status >= 0) || (status == -pte_eos))
+		return 0;
+
+	if (pt_blk_get_offset(ptdec, &offset) < 0)
+		return 0;
+
+	return ptxed_lead_error(lead, offset, block.ip, status);
+}
+
+/* Decode the leading items of the range following @range. */
+static int ptxed_range_lead(struct ptxed_range *range,
+			    struct ptxed_decoder *decoder)
+{
+	const struct ptxed_range *next;
+	uint64_t preroll;
+
+	if (!range || !decoder)
+		return -pte_internal;
+
+	if (!range->end)
+		return 0;
+
+	/* The range following @range starts at its @end. */
+	next = range->next;
+	while (next && (next->begin < range->end))
+		next = next->next;
+
+	preroll = range->end;
+	if (next && (next->begin == range->end))
+		preroll = next->preroll;
+
+#if defined(FEATURE_SIDEBAND)
+	{
+		int errcode;
+
+		errcode = ptxed_sb_restore(decoder, preroll, 1);
+		if (errcode < 0)
+			return errcode;
+	}
+#endif /* defined(FEATURE_SIDEBAND) */
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		return ptxed_lead_insn(&range->lead, decoder, preroll,
+				       range->end);
+
+	case pdt_block_decoder:
+		return ptxed_lead_block(&range->lead, decoder, preroll,
+					range->end);
+	}
+
+	return -pte_internal;
+}
+
+static int ptxed_item_equal(const struct ptxed_item *lhs,
+			    const struct ptxed_item *rhs, int timed)
+{
+	if (timed && ((lhs->event_tsc != rhs->event_tsc) ||
+		      (lhs->tsc != rhs->tsc)))
+		return 0;
+
+	return (lhs->offset == rhs->offset) && (lhs->ip == rhs->ip) &&
+		(lhs->ninsn == rhs->ninsn) && (lhs->errcode == rhs->errcode);
+}
+
+/* Find the point at which the next range takes over @range.
+ *
+ * This is the first of @range's tail items from which on the tail matches
+ * the next range's leading items.  Error items must match, as well, so the
+ * next range does not take over before an error we diagnosed.  If @range is
+ * timed, the items must also agree on the time.
+ *
+ * Returns the index of that item in @range's tail, or the number of tail
+ * items if there is no such point.
+ */
+static size_t ptxed_range_takeover(const struct ptxed_range *range)
+{
+	const struct ptxed_items *lead, *tail;
+	size_t begin, idx;
+
+	lead = &range->lead;
+	tail = &range->tail;
+
+	for (begin = 0; begin < tail->nitems; ++begin) {
+		for (idx = 0; (begin + idx) < tail->nitems; ++idx) {
+			if (lead->nitems <= idx)
+				break;
+
+			if (!ptxed_item_equal(&tail->item[begin + idx],
+					      &lead->item[idx], range->timed))
+				break;
+		}
+
+		if (idx && (((begin + idx) == tail->nitems) ||
+			    (idx == lead->nitems)))
+			break;
+	}
+
+	return begin;
+}
+
+/* Let the next range take over @range at its tail item @takeover.
+ *
+ * Returns a positive integer.
+ */
+static int ptxed_range_taken(struct ptxed_range *range, size_t takeover)
+{
+	range->takeover = takeover;
+	range->taken = 1;
+
+	return 1;
+}
+
+/* Find the range following @range that contains @offset. */
+static const struct ptxed_range *
+ptxed_range_containing(const struct ptxed_range *range, uint64_t offset)
+{
+	const struct ptxed_range *next;
+
+	next = range->next;
+	if (!next)
+		return NULL;
+
+	while (next->next && (next->next->begin <= offset))
+		next = next->next;
+
+	return next;
+}
+
+/* Extend @range to the end of @next.
+ *
+ * A sequential decode continues from our decoder's state whereas the ranges
+ * up to and including @next start from their PSB packets.  We decode their
+ * trace in their place and need new leading items for the range following
+ * @next.  Their output is not printed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_range_extend(struct ptxed_range *range,
+			      const struct ptxed_range *next,
+			      struct ptxed_decoder *lead)
+{
+	if (!range || !next)
+		return -pte_internal;
+
+	range->end = next->next ? next->next->begin : 0ull;
+	range->lead.nitems = 0;
+	range->tail.nitems = 0;
+
+	return ptxed_range_lead(range, lead);
+}
+
+/* Check whether @decoder synchronized onto the end of its trace range.
+ *
+ * If we re-synchronized beyond the end of our range and the next range did
+ * not take over before, a sequential decode continues at that PSB packet.
+ * Unless a later range starts decoding there, we extend our range and
+ * continue.
+ *
+ * Returns a positive integer if we're done, zero if we continue or if
+ * @decoder decodes until the end of the trace, a negative error code
+ * otherwise.
+ */
+static int ptxed_synced_beyond(struct ptxed_decoder *decoder)
+{
+	const struct ptxed_range *next;
+	struct ptxed_range *range;
+	uint64_t sync;
+	size_t takeover;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	range = decoder->range;
+	if (!range || !range->end)
+		return 0;
+
+	errcode = -pte_internal;
+	sync = 0ull;
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		errcode = pt_insn_get_sync_offset(decoder->variant.insn, &sync);
+		break;
+
+	case pdt_block_decoder:
+		errcode = pt_blk_get_sync_offset(decoder->variant.block, &sync);
+		break;
+	}
+
+	if (errcode < 0)
+		return errcode;
+
+	if (sync < range->end)
+		return 0;
+
+	takeover = ptxed_range_takeover(range);
+	if (range->lost || (takeover < range->tail.nitems))
+		return ptxed_range_taken(range, takeover);
+
+	next = ptxed_range_containing(range, sync);
+	if (!next)
+		return -pte_internal;
+
+	/* A range that decodes the preceding trace segment without printing
+	 * does not start from the state in which we re-synchronized.
+	 */
+	if ((next->begin == sync) && (next->preroll == sync)) {
+		range->end = sync;
+		range->resync = 1;
+
+		return ptxed_range_taken(range, range->tail.nitems);
+	}
+
+	errcode = ptxed_range_extend(range, next, decoder->lead);
+	if (errcode < 0) {
+		range->lost = 1;
+		return ptxed_range_taken(range, range->tail.nitems);
+	}
+
+	return 0;
+}
+
+/* Get the current time of @decoder's trace.
+ *
+ * This is the last TSC, refined by MTC and CYC packets if enabled.  Without
+ * timing information, this is zero.
+ */
+static uint64_t ptxed_get_time(const struct ptxed_decoder *decoder)
+{
+	uint64_t tsc;
+
+	tsc = 0ull;
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		(void) pt_insn_time(decoder->variant.insn, &tsc, NULL, NULL);
+		break;
+
+	case pdt_block_decoder:
+		(void) pt_blk_time(decoder->variant.block, &tsc, NULL, NULL);
+		break;
+	}
+
+	return tsc;
+}
+
+/* Track @item in @decoder's range.
+ *
+ * Remember the output position of @decoder's first item and of items that
+ * might belong to the next range.  If our decode diverges from the next
+ * range's, we extend our range.
+ *
+ * Returns zero if the item is to be printed.
+ * Returns a positive integer if the next range took over.
+ * Returns a negative error code otherwise.
+ */
+static int ptxed_track_range(struct ptxed_decoder *decoder,
+			     struct ptxed_item *item)
+{
+	struct ptxed_range *range;
+
+	if (!decoder || !item)
+		return -pte_internal;
+
+	range = decoder->range;
+	if (!range)
+		return 0;
+
+	if (range->first < 0) {
+		range->first = ptxed_tell(decoder);
+		if (range->first < 0)
+			return -pte_internal;
+	}
+
+#if defined(FEATURE_THREADS)
+	/* Our output may be printed up to the first item that might belong to
+	 * the next range.
+	 */
+	if (decoder->output && !range->tail.nitems) {
+		int errcode;
+
+		errcode = ptxed_output_flush(decoder);
+		if (errcode < 0) {
+			/* We can't print our output.  Stop decoding. */
+			range->lost = 1;
+			return ptxed_range_taken(range, range->tail.nitems);
+		}
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	while (range->end && (range->end <= item->offset)) {
+		const struct ptxed_range *next;
+		size_t takeover;
+		int errcode;
+
+		item->pos = ptxed_tell(decoder);
+		if (item->pos < 0)
+			return -pte_internal;
+
+		errcode = ptxed_items_add(&range->tail, item);
+		if (errcode < 0)
+			return errcode;
+
+		if (range->lead.nitems &&
+		    (item->offset <= range->lead.item[0].offset))
+			break;
+
+		/* Once we're beyond the offset of the next range's first item,
+		 * the next range took over unless we diverged from it.
+		 *
+		 * If the next range has no items, we diverged from it as soon
+		 * as we decoded an item beyond our end.
+		 */
+		takeover = ptxed_range_takeover(range);
+		if (range->lost ||
+		    (range->lead.nitems && (takeover < range->tail.nitems))) {
+			/* The item is not printed. */
+			range->tail.nitems -= 1;
+			return ptxed_range_taken(range, takeover);
+		}
+
+		next = ptxed_range_containing(range, item->offset);
+		if (!next)
+			return -pte_internal;
+
+		errcode = ptxed_range_extend(range, next, decoder->lead);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+/* Track an item that is about to be printed.
+ *
+ * The item of @ninsn instructions starting at @ip in @isid was decoded at
+ * @offset.  Its last instruction's class is @iclass.  If it is a call, it
+ * returns to @ret.  The last event's time was @event_tsc and the trace's time
+ * before decoding the item was @tsc.
+ *
+ * Returns zero if the item is to be printed.
+ * Returns a positive integer if the next range took over.
+ * Returns a negative error code otherwise.
+ */
+static int ptxed_track(struct ptxed_decoder *decoder, uint64_t offset,
+		       int isid, uint64_t ip, uint32_t ninsn,
+		       enum pt_insn_class iclass, uint64_t ret,
+		       uint64_t event_tsc, uint64_t tsc)
+{
+	struct ptxed_item item;
+	int errcode;
+
+	if (!decoder)
+		return -pte_internal;
+
+	item.offset = offset;
+	item.ip = ip;
+	item.time = 0ull;
+	item.event_tsc = event_tsc;
+	item.tsc = 0ull;
+	item.ninsn = ninsn;
+	item.isid = isid;
+	item.errcode = 0;
+	item.pos = 0l;
+
+	if (decoder->profile || (decoder->range && decoder->range->timed)) {
+		uint64_t now;
+
+		now = ptxed_get_time(decoder);
+		if (decoder->profile && (tsc < now))
+			item.time = now - tsc;
+
+		item.tsc = now;
+	}
+
+	errcode = ptxed_track_range(decoder, &item);
+	if (errcode)
+		return errcode;
+
+	if (decoder->profile) {
+		errcode = ptxed_profile_add(decoder->profile, item.isid,
+					    item.ip, item.ninsn, item.time);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (decoder->callgraph) {
+		errcode = ptxed_callgraph_add(decoder->callgraph, item.isid,
+					      item.ip, item.ninsn, iclass,
+					      ret);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+/* Track an error that is about to be diagnosed.
+ *
+ * The error @errcode is diagnosed at @ip.  The next range cannot take over
+ * at an item that is followed by an error in our output unless it diagnoses
+ * the same error.
+ *
+ * Returns zero if the error is to be diagnosed.
+ * Returns a positive integer if the next range took over.
+ */
+static int ptxed_track_error(struct ptxed_decoder *decoder, uint64_t ip,
+			     int errcode)
+{
+	struct ptxed_item item;
+	int status;
+
+	if (!decoder || !decoder->range)
+		return 0;
+
+	item.offset = 0ull;
+	item.ip = ip;
+	item.time = 0ull;
+	item.event_tsc = 0ull;
+	item.tsc = 0ull;
+	item.ninsn = 0u;
+	item.isid = 0;
+	item.errcode = errcode;
+	item.pos = 0l;
+
+	status = -pte_internal;
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		status = pt_insn_get_offset(decoder->variant.insn,
+					    &item.offset);
+		break;
+
+	case pdt_block_decoder:
+		status = pt_blk_get_offset(decoder->variant.block,
+					   &item.offset);
+		break;
+	}
+
+	if (status >= 0)
+		status = ptxed_track_range(decoder, &item);
+
+	/* We diagnose the error even if we fail to track it.  The range can't
+	 * be merged with the next range, though.
+	 */
+	if (status < 0) {
+		decoder->range->lost = 1;
+		return 0;
+	}
+
+	return status;
+}
+
+static int drain_events_insn(struct ptxed_decoder *decoder, uint64_t *time,
+			     int status, const struct ptxed_options *options)
+{
+	struct pt_insn_decoder *ptdec;
+	int errcode;
+
+	if (!decoder || !time || !options)
+		return -pte_internal;
+
+	ptdec = decoder->variant.insn;
+
+	while (status & pts_event_pending) {
+		struct pt_event event;
+		uint64_t offset;
+
+		offset = 0ull;
+		if (options->print_offset) {
+			errcode = pt_insn_get_offset(ptdec, &offset);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		status = pt_insn_event(ptdec, &event, sizeof(event));
+		if (status < 0)
+			return status;
+
+		*time = event.tsc;
+
+		if (!options->quiet && !event.status_update)
+			print_event(decoder->stream, &event, options, offset);
+
+		if (decoder->callgraph) {
+			errcode = ptxed_callgraph_event(decoder->callgraph,
+							&event);
+			if (errcode < 0)
+				return errcode;
+		}
+
+#if defined(FEATURE_SIDEBAND)
+		errcode = ptxed_sb_event(decoder, &event, options);
+		if (errcode < 0)
+			return errcode;
+#endif /* defined(FEATURE_SIDEBAND) */
+	}
+
+	return status;
+}
+
+/* Find the beginning of the last @nsegs trace segments in @config.
+ *
+ * If there are fewer trace segments, provide the beginning of the oldest one.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no trace segment.
+ */
+static int find_last_segments(uint64_t *begin, const struct pt_config *config,
+			      uint64_t nsegs)
+{
+	struct pt_segment_iterator *iterator;
+	int errcode, found;
+
+	if (!begin || !config || !nsegs)
+		return -pte_internal;
+
+	iterator = pt_seg_alloc_iterator(config);
+	if (!iterator)
+		return -pte_nomem;
+
+	errcode = 0;
+	found = 0;
+	for (; nsegs; --nsegs) {
+		struct pt_segment segment;
+
+		errcode = pt_seg_prev(iterator, &segment, sizeof(segment));
+		if (errcode < 0)
+			break;
+
+		*begin = segment.begin;
+		found = 1;
+	}
+
+	pt_seg_free_iterator(iterator);
+
+	/* It is OK to run out of segments as long as we found one. */
+	if ((errcode == -pte_eos) && found)
+		errcode = 0;
+
+	return errcode;
+}
+
+static void decode_insn(struct ptxed_decoder *decoder,
+			const struct ptxed_options *options,
+			struct ptxed_stats *stats)
+{
+	struct pt_insn_decoder *ptdec;
+	uint64_t offset, sync, time, tsc;
+	int sync_set;
+
+	if (!decoder || !options) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	ptdec = decoder->variant.insn;
+	offset = 0ull;
+	sync = 0ull;
+	time = 0ull;
+	tsc = 0ull;
+	sync_set = decoder->sync_set;
+	for (;;) {
+		struct pt_insn insn;
+		int status;
+
+		/* Initialize IP and iclass - we use it for error reporting. */
+		insn.ip = 0ull;
+		insn.iclass = ptic_unknown;
+
+		if (sync_set) {
+			status = ptxed_sync_insn(decoder, ptxed_preroll(decoder),
+						 decoder->begin, &time);
+			sync_set = 0;
+		} else
+			status = pt_insn_sync_forward(ptdec);
+
+		/* Stop when we synchronized beyond our trace range.
+		 *
+		 * We ignore errors determining the offset and diagnose the
+		 * synchronization error, instead.
+		 */
+		if ((status != -pte_eos) && (ptxed_synced_beyond(decoder) > 0))
+			break;
+
+		if (status < 0) {
+			uint64_t new_sync;
+			int errcode;
+
+			if (status == -pte_eos)
+				break;
+
+			diagnose(decoder, insn.ip, "sync error", status);
+
+			/* Let's see if we made any progress.  If we haven't,
+			 * we likely never will.  Bail out.
+			 *
+			 * We intentionally report the error twice to indicate
+			 * that we tried to re-sync.  Maybe it even changed.
+			 */
+			errcode = pt_insn_get_offset(ptdec, &new_sync);
+			if (errcode < 0 || (new_sync <= sync))
+				break;
+
+			sync = new_sync;
+			continue;
+		}
+
+		/* We don't know the call stack at the synchronization point. */
+		ptxed_callgraph_reset(decoder->callgraph);
+
+		for (;;) {
+			int errcode;
+
+			status = drain_events_insn(decoder, &time, status,
+						   options);
+			if (status < 0)
+				break;
+
+			if (status & pts_eos) {
+				if (!(status & pts_ip_suppressed) &&
+				    !options->quiet)
+					fprintf(decoder->stream,
+						"[end of trace]\n");
+
+				status = -pte_eos;
+				break;
+			}
+
+			if (options->print_offset || options->check ||
+			    decoder->range) {
+				errcode = pt_insn_get_offset(ptdec, &offset);
+				if (errcode < 0)
+					break;
+			}
+
+			if (decoder->profile)
+				tsc = ptxed_get_time(decoder);
+
+			status = pt_insn_next(ptdec, &insn, sizeof(insn));
+			if (status < 0) {
+				/* Even in case of errors, we may have succeeded
+				 * in decoding the current instruction.
+				 */
+				if (insn.iclass != ptic_unknown) {
+					errcode = ptxed_track(decoder, offset,
+							      insn.isid,
+							      insn.ip, 1,
+							      insn.iclass,
+							      insn.ip +
+							      insn.size,
+							      time, tsc);
+					if (errcode) {
+						if (errcode > 0)
+							status = -pte_eos;
+						break;
+					}
+
+					if (!options->quiet)
+						print_insn(decoder->stream,
+							   &insn,
+							   decoder->insn_cache,
+							   options, offset,
+							   time);
+					if (stats)
+						stats->insn += 1;
+
+					if (options->check)
+						check_insn(decoder->stream,
+							   decoder->insn_cache,
+							   &insn, offset);
+				}
+				break;
+			}
+
+			errcode = ptxed_track(decoder, offset, insn.isid,
+					      insn.ip, 1, insn.iclass,
+					      insn.ip + insn.size, time,
+					      tsc);
+			if (errcode) {
+				status = (errcode > 0) ? -pte_eos : errcode;
+				break;
+			}
+
+			if (!options->quiet)
+				print_insn(decoder->stream, &insn,
+					   decoder->insn_cache, options,
+					   offset, time);
+
+			if (stats)
+				stats->insn += 1;
+
+			if (options->check)
+				check_insn(decoder->stream,
+					   decoder->insn_cache, &insn,
+					   offset);
+		}
+
+		/* We shouldn't break out of the loop without an error. */
+		if (!status)
+			status = -pte_internal;
+
+		/* We're done when we reach the end of the trace stream. */
+		if (status == -pte_eos)
+			break;
+
+		/* We're also done if the next range took over. */
+		if (ptxed_track_error(decoder, insn.ip, status) > 0)
+			break;
+
+		diagnose(decoder, insn.ip, "error",  status);
+	}
+}
+
+static int xed_next_ip(FILE *stream, uint64_t *pip,
+		       const xed_decoded_inst_t *inst, uint64_t ip)
+{
+	xed_uint_t length, disp_width;
+
+	if (!pip || !inst)
+		return -pte_internal;
+
+	length = xed_decoded_inst_get_length(inst);
+	if (!length) {
+		fprintf(stream, "[xed error: failed to determine "
+			"instruction length]\n");
+		return -pte_bad_insn;
+	}
+
+	ip += length;
+
+	/* If it got a branch displacement it must be a branch.
+	 *
+	 * This includes conditional branches for which we don't know whether
+	 * they were taken.  The next IP won't be used in this case as a
+	 * conditional branch ends a block.  The next block will start with the
+	 * correct IP.
+	 */
+	disp_width = xed_decoded_inst_get_branch_displacement_width(inst);
+	if (disp_width)
+		ip += (uint64_t) (int64_t)
+			xed_decoded_inst_get_branch_displacement(inst);
+
+	*pip = ip;
+	return 0;
+}
+
+static int block_fetch_insn(struct pt_insn *insn, const struct pt_block *block,
+			    uint64_t ip, struct pt_image_section_cache *iscache)
+{
+	if (!insn || !block)
+		return -pte_internal;
+
+	/* We can't read from an empty block. */
+	if (!block->ninsn)
+		return -pte_invalid;
+
+	memset(insn, 0, sizeof(*insn));
+	insn->mode = block->mode;
+	insn->isid = block->isid;
+	insn->ip = ip;
+
+	/* The last instruction in a block may be truncated. */
+	if ((ip == block->end_ip) && block->truncated) {
+		if (!block->size || (sizeof(insn->raw) < (size_t) block->size))
+			return -pte_bad_insn;
+
+		insn->size = block->size;
+		insn->truncated = 1;
+		memcpy(insn->raw, block->raw, insn->size);
+	} else {
+		int size;
+
+		size = pt_iscache_read(iscache, insn->raw, sizeof(insn->raw),
+				       insn->isid, ip);
+		if (size < 0)
+			return size;
+
+		insn->size = (uint8_t) size;
+	}
+
+	return 0;
+}
+
+/* Look up the instruction at @ip in @block in @cache.
+ *
+ * The truncated last instruction of @block is never cached.
+ *
+ * Returns the cached instruction on success, NULL if it is not cached.
+ */
+static struct ptxed_cached_insn *
+block_lookup_insn(struct ptxed_insn_cache *cache, const struct pt_block *block,
+		  uint64_t ip)
+{
+	if (!block)
+		return NULL;
+
+	if ((ip == block->end_ip) && block->truncated)
+		return NULL;
+
+	return ptxed_insn_cache_lookup(cache, ip, block->isid, block->mode);
+}
+
+/* Determine the IP to which a call at the end of @block returns.
+ *
+ * Returns the return IP if @block ends with a call and we follow calls, zero
+ * otherwise.
+ */
+static uint64_t block_return_ip(struct ptxed_decoder *decoder,
+				const struct pt_block *block)
+{
+	const struct ptxed_cached_insn *entry;
+	xed_uint_t length;
+
+	if (!decoder || !decoder->callgraph || !block)
+		return 0ull;
+
+	switch (block->iclass) {
+	case ptic_call:
+	case ptic_far_call:
+		break;
+
+	default:
+		return 0ull;
+	}
+
+	entry = block_lookup_insn(decoder->insn_cache, block, block->end_ip);
+	if (!entry) {
+		xed_error_enum_t xederrcode;
+		struct pt_insn insn;
+		int errcode;
+
+		errcode = block_fetch_insn(&insn, block, block->end_ip,
+					   decoder->iscache);
+		if (errcode < 0)
+			return 0ull;
+
+		entry = ptxed_decode_insn(decoder->insn_cache, &insn,
+					  &xederrcode);
+		if (!entry)
+			return 0ull;
+	}
+
+	length = xed_decoded_inst_get_length(&entry->inst);
+	if (!length)
+		return 0ull;
+
+	return block->end_ip + length;
+}
+
+static void diagnose_block(struct ptxed_decoder *decoder,
+			   const char *errtype, int errcode,
+			   const struct pt_block *block)
+{
+	uint64_t ip;
+	int err;
+
+	if (!decoder || !block) {
+		printf("ptxed: internal error");
+		return;
+	}
+
+	/* Determine the IP at which to report the error.
+	 *
+	 * Depending on the type of error, the IP varies between that of the
+	 * last instruction in @block or the next instruction outside of @block.
+	 *
+	 * When the block is empty, we use the IP of the block itself,
+	 * i.e. where the first instruction should have been.
+	 */
+	if (!block->ninsn)
+		ip = block->ip;
+	else {
+		ip = block->end_ip;
+
+		switch (errcode) {
+		case -pte_nomap:
+		case -pte_bad_insn: {
+			struct pt_insn insn;
+			xed_decoded_inst_t inst;
+			xed_error_enum_t xederr;
+
+			/* Decode failed when trying to fetch or decode the next
+			 * instruction.  Since indirect or conditional branches
+			 * end a block and don't cause an additional fetch, we
+			 * should be able to reach that IP from the last
+			 * instruction in @block.
+			 *
+			 * We ignore errors and fall back to the IP of the last
+			 * instruction.
+			 */
+			err = block_fetch_insn(&insn, block, ip,
+					       decoder->iscache);
+			if (err < 0)
+				break;
+
+			xed_decoded_inst_zero(&inst);
+			xed_decoded_inst_set_mode(&inst,
+						  translate_mode(insn.mode),
+						  XED_ADDRESS_WIDTH_INVALID);
+
+			xederr = xed_decode(&inst, insn.raw, insn.size);
+			if (xederr != XED_ERROR_NONE)
+				break;
+
+			(void) xed_next_ip(decoder->stream, &ip, &inst,
+					   insn.ip);
+		}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	diagnose(decoder, ip, errtype, errcode);
+}
+
+static void print_block(struct ptxed_decoder *decoder,
+			const struct pt_block *block,
+			const struct ptxed_options *options,
+			const struct ptxed_stats *stats,
+			uint64_t offset, uint64_t time)
+{
+	uint64_t ip;
+	uint16_t ninsn;
+
+	if (!block || !options) {
+		fprintf(decoder->stream, "[internal error]\n");
+		return;
+	}
+
+	if (options->track_blocks) {
+		/* Block numbers within a range are printed with the range. */
+		if (stats && decoder->range) {
+			int errcode;
+
+			errcode = ptxed_range_mark(decoder->range,
+						   ptxed_tell(decoder),
+						   stats->blocks);
+			if (errcode < 0)
+				decoder->range->lost = 1;
+		} else {
+			fprintf(decoder->stream, "[block");
+			if (stats)
+				fprintf(decoder->stream, " %" PRIx64,
+					stats->blocks);
+			fprintf(decoder->stream, "]\n");
+		}
+	}
+
+	/* There's nothing to do for empty blocks. */
+	ninsn = block->ninsn;
+	if (!ninsn)
+		return;
+
+	ip = block->ip;
+	for (;;) {
+		struct ptxed_cached_insn *entry;
+		int errcode;
+
+		if (options->print_offset)
+			fprintf(decoder->stream, "%016" PRIx64 "  ", offset);
+
+		if (options->print_time)
+			fprintf(decoder->stream, "%016" PRIx64 "  ", time);
+
+		if (block->speculative)
+			fprintf(decoder->stream, "? ");
+
+		fprintf(decoder->stream, "%016" PRIx64, ip);
+
+		entry = block_lookup_insn(decoder->insn_cache, block, ip);
+		if (!entry) {
+			xed_error_enum_t xederrcode;
+			struct pt_insn insn;
+
+			errcode = block_fetch_insn(&insn, block, ip,
+						   decoder->iscache);
+			if (errcode < 0) {
+				fprintf(decoder->stream,
+					" [fetch error: %s]\n",
+					pt_errstr(pt_errcode(errcode)));
+				break;
+			}
+
+			entry = ptxed_decode_insn(decoder->insn_cache, &insn,
+						  &xederrcode);
+			if (!entry) {
+				print_raw_insn(decoder->stream, &insn);
+
+				fprintf(decoder->stream,
+					" [xed decode error: (%u) %s]\n",
+					xederrcode,
+					xed_error_enum_t2str(xederrcode));
+				break;
+			}
+		}
+
+		if (!options->dont_print_insn)
+			xed_print_insn(decoder->stream, entry, options);
+
+		fprintf(decoder->stream, "\n");
+
+		ninsn -= 1;
+		if (!ninsn)
+			break;
+
+		errcode = xed_next_ip(decoder->stream, &ip, &entry->inst, ip);
+		if (errcode < 0) {
+			diagnose(decoder, ip, "reconstruct error", errcode);
+			break;
+		}
+	}
+
+	/* Decode should have brought us to @block->end_ip. */
+	if (ip != block->end_ip)
+		diagnose(decoder, ip, "reconstruct error", -pte_nosync);
+}
+
+static void check_block(FILE *stream, const struct pt_block *block,
+			struct pt_image_section_cache *iscache,
+			struct ptxed_insn_cache *cache, uint64_t offset)
+{
+	const struct ptxed_cached_insn *entry;
+	struct pt_insn insn;
+	uint64_t ip;
+	uint16_t ninsn;
+	int errcode;
+
+	if (!block) {
+		fprintf(stream, "[internal error]\n");
+		return;
+	}
+
+	/* There's nothing to check for an empty block. */
+	ninsn = block->ninsn;
+	if (!ninsn)
+		return;
+
+	if (block->isid <= 0)
+		fprintf(stream, "[%" PRIx64 ", %" PRIx64 ": check error: "
+			"bad isid]\n", offset, block->ip);
+
+	ip = block->ip;
+	do {
+		entry = block_lookup_insn(cache, block, ip);
+		if (!entry) {
+			errcode = block_fetch_insn(&insn, block, ip, iscache);
+			if (errcode < 0) {
+				fprintf(stream, "[%" PRIx64 ", %" PRIx64
+					": fetch error: %s]\n", offset, ip,
+					pt_errstr(pt_errcode(errcode)));
+				return;
+			}
+
+			/* We need a valid instruction in order to do further
+			 * checks.
+			 *
+			 * Invalid instructions have already been diagnosed.
+			 */
+			entry = check_insn_decode(stream, cache, &insn,
+						  offset);
+			if (!entry)
+				return;
+		}
+
+		errcode = xed_next_ip(stream, &ip, &entry->inst, ip);
+		if (errcode < 0) {
+			fprintf(stream,
+				"[%" PRIx64 ", %" PRIx64 ": error: %s]\n",
+				offset, ip, pt_errstr(pt_errcode(errcode)));
+			return;
+		}
+	} while (--ninsn);
+
+	/* We reached the end of the block.  @entry refers to the last
+	 * instruction in @block.
+	 *
+	 * Check that we reached the end IP of the block.
+	 */
+	if (entry->ip != block->end_ip) {
+		fprintf(stream,
+			"[%" PRIx64 ", %" PRIx64 ": error: did not reach end: %"
+			PRIx64 "]\n", offset, entry->ip, block->end_ip);
+	}
+
+	/* Check the last instruction's classification, if available. */
+	memset(&insn, 0, sizeof(insn));
+	insn.ip = entry->ip;
+	insn.iclass = block->iclass;
+	if (insn.iclass)
+		check_insn_iclass(stream, xed_decoded_inst_inst(&entry->inst),
+				  &insn, offset);
+}
+
+static int drain_events_block(struct ptxed_decoder *decoder, uint64_t *time,
+			      int status, const struct ptxed_options *options)
+{
+	struct pt_block_decoder *ptdec;
+	int errcode;
+
+	if (!decoder || !time || !options)
+		return -pte_internal;
+
+	ptdec = decoder->variant.block;
+
+	while (status & pts_event_pending) {
+		struct pt_event event;
+		uint64_t offset;
+
+		offset = 0ull;
+		if (options->print_offset) {
+			errcode = pt_blk_get_offset(ptdec, &offset);
+			if (errcode < 0)
+				return errcode;
+		}
+
+		status = pt_blk_event(ptdec, &event, sizeof(event));
+		if (status < 0)
+			return status;
+
+		*time = event.tsc;
+
+		if (!options->quiet && !event.status_update)
+			print_event(decoder->stream, &event, options, offset);
+
+		if (decoder->callgraph) {
+			errcode = ptxed_callgraph_event(decoder->callgraph,
+							&event);
+			if (errcode < 0)
+				return errcode;
+		}
+
+#if defined(FEATURE_SIDEBAND)
+		errcode = ptxed_sb_event(decoder, &event, options);
+		if (errcode < 0)
+			return errcode;
+#endif /* defined(FEATURE_SIDEBAND) */
+	}
+
+	return status;
+}
+
+static void decode_block(struct ptxed_decoder *decoder,
+			 const struct ptxed_options *options,
+			 struct ptxed_stats *stats)
+{
+	struct pt_image_section_cache *iscache;
+	struct pt_block_decoder *ptdec;
+	uint64_t offset, sync, time, tsc;
+	int sync_set;
+
+	if (!decoder || !options) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	iscache = decoder->iscache;
+	ptdec = decoder->variant.block;
+	offset = 0ull;
+	sync = 0ull;
+	time = 0ull;
+	tsc = 0ull;
+	sync_set = decoder->sync_set;
+	for (;;) {
+		struct pt_block block;
+		int status;
+
+		/* Initialize IP and ninsn - we use it for error reporting. */
+		block.ip = 0ull;
+		block.ninsn = 0u;
+
+		if (sync_set) {
+			status = ptxed_sync_block(decoder, ptxed_preroll(decoder),
+						  decoder->begin, &time);
+			sync_set = 0;
+		} else
+			status = pt_blk_sync_forward(ptdec);
+
+		/* Stop when we synchronized beyond our trace range.
+		 *
+		 * We ignore errors determining the offset and diagnose the
+		 * synchronization error, instead.
+		 */
+		if ((status != -pte_eos) && (ptxed_synced_beyond(decoder) > 0))
+			break;
+
+		if (status < 0) {
+			uint64_t new_sync;
+			int errcode;
+
+			if (status == -pte_eos)
+				break;
+
+			diagnose_block(decoder, "sync error", status, &block);
+
+			/* Let's see if we made any progress.  If we haven't,
+			 * we likely never will.  Bail out.
+			 *
+			 * We intentionally report the error twice to indicate
+			 * that we tried to re-sync.  Maybe it even changed.
+			 */
+			errcode = pt_blk_get_offset(ptdec, &new_sync);
+			if (errcode < 0 || (new_sync <= sync))
+				break;
+
+			sync = new_sync;
+			continue;
+		}
+
+		/* We don't know the call stack at the synchronization point. */
+		ptxed_callgraph_reset(decoder->callgraph);
+
+		for (;;) {
+			uint64_t ret;
+			int errcode;
+
+			status = drain_events_block(decoder, &time, status,
+						    options);
+			if (status < 0)
+				break;
+
+			if (status & pts_eos) {
+				if (!(status & pts_ip_suppressed) &&
+				    !options->quiet)
+					fprintf(decoder->stream,
+						"[end of trace]\n");
+
+				status = -pte_eos;
+				break;
+			}
+
+			if (options->print_offset || options->check ||
+			    decoder->range) {
+				errcode = pt_blk_get_offset(ptdec, &offset);
+				if (errcode < 0)
+					break;
+			}
+
+			if (decoder->profile)
+				tsc = ptxed_get_time(decoder);
+
+			status = pt_blk_next(ptdec, &block, sizeof(block));
+			ret = block_return_ip(decoder, &block);
+			if (status < 0) {
+				/* Even in case of errors, we may have succeeded
+				 * in decoding some instructions.
+				 */
+				if (block.ninsn) {
+					errcode = ptxed_track(decoder, offset,
+							      block.isid,
+							      block.ip,
+							      block.ninsn,
+							      block.iclass,
+							      ret, time, tsc);
+					if (errcode) {
+						if (errcode > 0)
+							status = -pte_eos;
+						break;
+					}
+
+					if (stats) {
+						stats->insn += block.ninsn;
+						stats->blocks += 1;
+					}
+
+					if (!options->quiet)
+						print_block(decoder, &block,
+							    options, stats,
+							    offset, time);
+
+					if (options->check)
+						check_block(decoder->stream,
+							    &block, iscache,
+							    decoder->insn_cache,
+							    offset);
+				}
+				break;
+			}
+
+			errcode = ptxed_track(decoder, offset, block.isid,
+					      block.ip, block.ninsn,
+					      block.iclass, ret, time, tsc);
+			if (errcode) {
+				status = (errcode > 0) ? -pte_eos : errcode;
+				break;
+			}
+
+			if (stats) {
+				stats->insn += block.ninsn;
+				stats->blocks += 1;
+			}
+
+			if (!options->quiet)
+				print_block(decoder, &block, options, stats,
+					    offset, time);
+
+			if (options->check)
+				check_block(decoder->stream, &block, iscache,
+					    decoder->insn_cache, offset);
+		}
+
+		/* We shouldn't break out of the loop without an error. */
+		if (!status)
+			status = -pte_internal;
+
+		/* We're done when we reach the end of the trace stream. */
+		if (status == -pte_eos)
+			break;
+
+		/* We're also done if the next range took over. */
+		if (ptxed_track_error(decoder, block.ip, status) > 0)
+			break;
+
+		diagnose_block(decoder, "error", status, &block);
+	}
+}
+
+static void decode(struct ptxed_decoder *decoder,
+		   const struct ptxed_options *options,
+		   struct ptxed_stats *stats)
+{
+	if (!decoder) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		decode_insn(decoder, options, stats);
+		break;
+
+	case pdt_block_decoder:
+		decode_block(decoder, options, stats);
+		break;
+	}
+}
+
+static int alloc_decoder(struct ptxed_decoder *decoder,
+			 const struct pt_config *conf, struct pt_image *image,
+			 const struct ptxed_options *options, const char *prog)
+{
+	struct pt_config config;
+	int errcode;
+
+	if (!decoder || !conf || !options || !prog)
+		return -pte_internal;
+
+	config = *conf;
+
+	switch (decoder->type) {
+	case pdt_insn_decoder:
+		config.flags = decoder->insn.flags;
+
+		decoder->variant.insn = pt_insn_alloc_decoder(&config);
+		if (!decoder->variant.insn) {
+			fprintf(stderr,
+				"%s: failed to create decoder.\n", prog);
+			return -pte_nomem;
+		}
+
+		errcode = pt_insn_set_image(decoder->variant.insn, image);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to set image.\n", prog);
+			return errcode;
+		}
+
+		break;
+
+	case pdt_block_decoder:
+		config.flags = decoder->block.flags;
+
+		decoder->variant.block = pt_blk_alloc_decoder(&config);
+		if (!decoder->variant.block) {
+			fprintf(stderr,
+				"%s: failed to create  decoder.\n", prog);
+			return -pte_nomem;
+		}
+
+		errcode = pt_blk_set_image(decoder->variant.block, image);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to set image.\n", prog);
+			return errcode;
+		}
+
+		break;
+	}
+
+	decoder->insn_cache = ptxed_insn_cache_alloc();
+	if (!decoder->insn_cache) {
+		fprintf(stderr, "%s: failed to allocate instruction cache.\n",
+			prog);
+		return -pte_nomem;
+	}
+
+	return 0;
+}
+
+/* Write @profile to @filename in binary format. */
+static int ptxed_write_profile(const char *filename,
+			       const struct ptxed_profile *profile,
+			       struct pt_image_section_cache *iscache)
+{
+	FILE *file;
+	int errcode;
+
+	file = fopen(filename, "wb");
+	if (!file)
+		return -pte_bad_file;
+
+	errcode = ptxed_profile_write(file, profile, iscache);
+	if (fclose(file) && (errcode >= 0))
+		errcode = -pte_bad_file;
+
+	return errcode;
+}
+
+static void print_stats(struct ptxed_stats *stats)
+{
+	if (!stats) {
+		printf("[internal error]\n");
+		return;
+	}
+
+	if (stats->flags & ptxed_stat_insn)
+		printf("insn: %" PRIu64 ".\n", stats->insn);
+
+	if (stats->flags & ptxed_stat_blocks)
+		printf("blocks:\t%" PRIu64 ".\n", stats->blocks);
+}
+
+#if defined(FEATURE_THREADS)
+
+enum {
+	/* The number of chunks per thread into which we split the trace for
+	 * parallel decode.
+	 *
+	 * More chunks balance the load better, fewer chunks need less decode
+	 * work at chunk boundaries.
 	 */
-	if (!block->ninsn)
-		ip = block->ip;
-	else {
-		ip = block->end_ip;
+	ptxed_chunks_per_thread	= 8,
+
+	/* The number of chunks per thread that may be decoded ahead of the
+	 * chunk that is printed next.
+	 *
+	 * Together with ptxed_output_limit, this bounds the decoded output
+	 * that is buffered in memory.
+	 */
+	ptxed_chunks_in_flight	= 2,
+
+	/* The number of TSC ticks between sideband checkpoints.
+	 *
+	 * Decode threads restore their sideband session from the closest
+	 * checkpoint before their trace and process the sideband from there.
+	 */
+	ptxed_sb_interval	= 0x1000000
+};
+
+/* A chunk of trace that is decoded on one of the decode threads.
+ *
+ * A chunk consists of one or more adjacent trace segments.
+ */
+struct ptxed_chunk {
+	/* The range of trace covered by the chunk. */
+	struct ptxed_range range;
+
+	/* The chunk's decoded output. */
+	struct ptxed_output output;
+
+	/* The statistics collected while decoding the chunk. */
+	struct ptxed_stats stats;
+
+	/* The profile collected while decoding the chunk - NULL if not
+	 * profiling.
+	 */
+	struct ptxed_profile *profile;
+};
+
+/* The state shared between the decode threads.
+ *
+ * The lock protects @next, @printed, and @errcode.  Each chunk's fields other
+ * than the ones shared via its output are owned by the thread that decodes
+ * it until it closes the chunk's output.
+ */
+struct ptxed_parallel {
+	/* The decoder configuration to use for decode threads. */
+	const struct ptxed_decoder *decoder;
+
+	/* The trace configuration. */
+	const struct pt_config *config;
+
+	/* The image to copy for each decode thread. */
+	const struct pt_image *image;
+
+	/* The options. */
+	const struct ptxed_options *options;
+
+#if defined(FEATURE_SIDEBAND)
+	/* The sideband index for restoring each decode thread's sideband
+	 * session - NULL if we don't use sideband.
+	 */
+	const struct pt_sb_index *sb_index;
+#endif
+
+	/* The program name for error messages. */
+	const char *prog;
+
+	/* The chunks in trace order. */
+	struct ptxed_chunk *chunks;
+
+	/* The number of @chunks. */
+	uint32_t nchunks;
+
+	/* The index of the next chunk to decode. */
+	uint32_t next;
+
+	/* The number of chunks that have been printed. */
+	uint32_t printed;
+
+	/* The maximal number of chunks to decode ahead of printing. */
+	uint32_t window;
+
+	/* The first error encountered by a decode thread. */
+	int errcode;
+
+	/* The lock protecting @next, @printed, and @errcode. */
+	mtx_t lock;
+
+	/* Signaled when a chunk has been claimed or an error occurred. */
+	cnd_t claimed;
+
+	/* Signaled when a chunk has been printed or an error occurred. */
+	cnd_t released;
+};
+
+/* Split the trace into chunks of adjacent trace segments.
+ *
+ * The first chunk starts at @decoder's @begin if @decoder's @sync_set flag is
+ * set and at the first PSB packet in @config, otherwise.  Chunks are at least
+ * @size bytes big, except for the last.
+ *
+ * If the trace's time is printed or profiled or if we use sideband, the other
+ * chunks are decoded from the trace segment preceding them so the trace's
+ * timing state is calibrated and the sideband is applied up to where a
+ * sequential decode would be when they begin.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_eos if there is no trace segment.
+ */
+static int ptxed_split_chunks(struct ptxed_parallel *parallel,
+			      const struct pt_config *config,
+			      const struct ptxed_decoder *decoder,
+			      uint32_t nthreads)
+{
+	struct pt_packet_decoder *pkt;
+	const struct ptxed_options *options;
+	struct ptxed_chunk *chunks;
+	uint64_t begin, preroll, last, size, offset;
+	uint32_t nchunks, capacity, idx, timed, calibrate;
+	int errcode;
+
+	if (!parallel || !config || !decoder || !nthreads)
+		return -pte_internal;
+
+	options = parallel->options;
+	if (!options)
+		return -pte_internal;
+
+	timed = options->print_time || options->print_event_time ||
+		options->profile;
+
+	calibrate = timed;
+#if defined(FEATURE_SIDEBAND)
+	if (decoder->have_sb)
+		calibrate = 1;
+#endif
+
+	pkt = pt_pkt_alloc_decoder(config);
+	if (!pkt)
+		return -pte_nomem;
+
+	if (decoder->sync_set)
+		errcode = pt_pkt_sync_set(pkt, decoder->begin);
+	else
+		errcode = pt_pkt_sync_forward(pkt);
+	if (errcode < 0)
+		goto out_pkt;
+
+	errcode = pt_pkt_get_sync_offset(pkt, &begin);
+	if (errcode < 0)
+		goto out_pkt;
+
+	size = (uint64_t) (config->end - config->begin) - begin;
+	size /= (uint64_t) nthreads * ptxed_chunks_per_thread;
+
+	chunks = NULL;
+	nchunks = 0;
+	capacity = 0;
+	preroll = begin;
+	last = begin;
+	for (;;) {
+		errcode = pt_pkt_sync_forward(pkt);
+		if (errcode < 0) {
+			if (errcode != -pte_eos)
+				break;
+
+			offset = 0ull;
+		} else {
+			errcode = pt_pkt_get_sync_offset(pkt, &offset);
+			if (errcode < 0)
+				break;
+
+			if ((offset - begin) < size) {
+				last = offset;
+				continue;
+			}
+		}
+
+		if (nchunks == capacity) {
+			struct ptxed_chunk *grown;
+
+			capacity = capacity ? capacity * 2 : nthreads;
+
+			grown = realloc(chunks, capacity * sizeof(*chunks));
+			if (!grown) {
+				errcode = -pte_nomem;
+				break;
+			}
+
+			chunks = grown;
+		}
+
+		memset(&chunks[nchunks], 0, sizeof(chunks[nchunks]));
+		chunks[nchunks].range.begin = begin;
+		chunks[nchunks].range.preroll = preroll;
+		chunks[nchunks].range.end = offset;
+		chunks[nchunks].range.first = -1l;
+		chunks[nchunks].range.cut = -1l;
+		chunks[nchunks].range.timed = timed;
+		nchunks += 1;
+
+		if (!offset) {
+			errcode = 0;
+			break;
+		}
+
+		begin = offset;
+		preroll = calibrate ? last : offset;
+		last = offset;
+	}
+
+	if (errcode < 0) {
+		free(chunks);
+		goto out_pkt;
+	}
+
+	for (idx = 1; idx < nchunks; ++idx)
+		chunks[idx - 1].range.next = &chunks[idx].range;
+
+	parallel->chunks = chunks;
+	parallel->nchunks = nchunks;
+
+out_pkt:
+	pt_pkt_free_decoder(pkt);
+	return errcode;
+}
+
+/* Find the point at which the next range takes over @range.
+ *
+ * Items from there on will be printed by the next range, so we remove them
+ * from @stats and from @profile.
+ *
+ * If the next range took over at the end of our output, there is nothing to
+ * remove.  If it did not take over at all, we decoded the remaining trace in
+ * place of the ranges following ours and extend our range until the end of
+ * the trace.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_range_finish(struct ptxed_range *range,
+			      enum ptxed_decoder_type type,
+			      struct ptxed_stats *stats,
+			      struct ptxed_profile *profile)
+{
+	const struct ptxed_items *tail;
+	size_t begin, idx;
+
+	if (!range)
+		return -pte_internal;
+
+	if (range->lost)
+		return -pte_nomem;
 
-		switch (errcode) {
-		case -pte_nomap:
-		case -pte_bad_insn: {
-			struct pt_insn insn;
-			xed_decoded_inst_t inst;
-			xed_error_enum_t xederr;
+	if (!range->taken) {
+		range->end = 0ull;
+		return 0;
+	}
 
-			/* Decode failed when trying to fetch or decode the next
-			 * instruction.  Since indirect or conditional branches
-			 * end a block and don't cause an additional fetch, we
-			 * should be able to reach that IP from the last
-			 * instruction in @block.
-			 *
-			 * We ignore errors and fall back to the IP of the last
-			 * instruction.
-			 */
-			err = block_fetch_insn(&insn, block, ip,
-					       decoder->iscache);
-			if (err < 0)
-				break;
+	tail = &range->tail;
 
-			xed_decoded_inst_zero(&inst);
-			xed_decoded_inst_set_mode(&inst,
-						  translate_mode(insn.mode),
-						  XED_ADDRESS_WIDTH_INVALID);
+	begin = range->takeover;
+	if (tail->nitems <= begin)
+		return 0;
 
-			xederr = xed_decode(&inst, insn.raw, insn.size);
-			if (xederr != XED_ERROR_NONE)
-				break;
+	range->cut = tail->item[begin].pos;
+
+	for (idx = begin; idx < tail->nitems; ++idx) {
+		const struct ptxed_item *item;
+
+		item = &tail->item[idx];
+		if (item->errcode)
+			continue;
 
-			(void) xed_next_ip(&ip, &inst, insn.ip);
+		if (stats) {
+			stats->insn -= item->ninsn;
+			if (type == pdt_block_decoder)
+				stats->blocks -= 1;
 		}
-			break;
 
-		default:
+		if (profile) {
+			int errcode;
+
+			errcode = ptxed_profile_remove(profile, item->isid,
+						       item->ip, item->ninsn,
+						       item->time);
+			if (errcode < 0)
+				return errcode;
+		}
+	}
+
+	return 0;
+}
+
+static void ptxed_range_fini(struct ptxed_range *range)
+{
+	if (!range)
+		return;
+
+	free(range->lead.item);
+	free(range->tail.item);
+	free(range->marks.mark);
+}
+
+/* Claim the next chunk to decode.
+ *
+ * Waits until the next chunk is within @parallel's window of chunks that may
+ * be decoded ahead of printing.
+ *
+ * Returns the chunk on success, NULL if there are no more chunks to decode or
+ * if another thread failed.
+ */
+static struct ptxed_chunk *ptxed_next_chunk(struct ptxed_parallel *parallel)
+{
+	struct ptxed_chunk *chunk;
+
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return NULL;
+
+	chunk = NULL;
+	while (!parallel->errcode && (parallel->next < parallel->nchunks)) {
+		if ((parallel->next - parallel->printed) < parallel->window) {
+			chunk = &parallel->chunks[parallel->next++];
+
+			(void) cnd_broadcast(&parallel->claimed);
 			break;
 		}
+
+		if (cnd_wait(&parallel->released, &parallel->lock) !=
+		    thrd_success)
+			break;
 	}
 
-	diagnose(decoder, ip, errtype, errcode);
+	(void) mtx_unlock(&parallel->lock);
+
+	return chunk;
 }
 
-static void print_block(struct ptxed_decoder *decoder,
-			const struct pt_block *block,
-			const struct ptxed_options *options,
-			const struct ptxed_stats *stats,
-			uint64_t offset, uint64_t time)
+/* Mark the next chunk printed and let decode threads proceed. */
+static int ptxed_chunk_printed(struct ptxed_parallel *parallel)
 {
-	xed_machine_mode_enum_t mode;
-	xed_state_t xed;
-	uint64_t ip;
-	uint16_t ninsn;
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return -pte_bad_lock;
 
-	if (!block || !options) {
-		printf("[internal error]\n");
+	parallel->printed += 1;
+
+	(void) cnd_broadcast(&parallel->released);
+	(void) mtx_unlock(&parallel->lock);
+
+	return 0;
+}
+
+/* Report the error @errcode and let all threads stop. */
+static void ptxed_parallel_fail(struct ptxed_parallel *parallel, int errcode)
+{
+	if (mtx_lock(&parallel->lock) != thrd_success)
 		return;
+
+	if (!parallel->errcode)
+		parallel->errcode = errcode;
+
+	(void) cnd_broadcast(&parallel->claimed);
+	(void) cnd_broadcast(&parallel->released);
+	(void) mtx_unlock(&parallel->lock);
+}
+
+/* Wait until @chunk has been claimed by a decode thread.
+ *
+ * A claimed chunk's output will be closed eventually.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_chunk_claimed(struct ptxed_parallel *parallel,
+			       const struct ptxed_chunk *chunk)
+{
+	int errcode;
+
+	if (mtx_lock(&parallel->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	while (!parallel->errcode &&
+	       (parallel->next <= (uint32_t) (chunk - parallel->chunks))) {
+		if (cnd_wait(&parallel->claimed, &parallel->lock) !=
+		    thrd_success) {
+			(void) mtx_unlock(&parallel->lock);
+			return -pte_bad_lock;
+		}
 	}
 
-	if (options->track_blocks) {
-		printf("[block");
-		if (stats)
-			printf(" %" PRIx64, stats->blocks);
-		printf("]\n");
+	errcode = parallel->errcode;
+	(void) mtx_unlock(&parallel->lock);
+
+	return errcode;
+}
+
+static int ptxed_decode_chunk(struct ptxed_parallel *parallel,
+			      struct ptxed_decoder *decoder,
+			      struct ptxed_chunk *chunk)
+{
+	const struct ptxed_options *options;
+	struct ptxed_stats *stats;
+	const char *prog;
+	int errcode;
+
+	if (!parallel || !decoder || !chunk)
+		return -pte_internal;
+
+	options = parallel->options;
+	prog = parallel->prog;
+
+	errcode = ptxed_memstream_open(&chunk->output.memstream[0]);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to open output stream: %s.\n",
+			prog, pt_errstr(pt_errcode(errcode)));
+		return errcode;
 	}
 
-	mode = translate_mode(block->mode);
-	xed_state_init2(&xed, mode, XED_ADDRESS_WIDTH_INVALID);
+	if (options->profile) {
+		chunk->profile = ptxed_profile_alloc();
+		if (!chunk->profile)
+			return -pte_nomem;
+	}
 
-	/* There's nothing to do for empty blocks. */
-	ninsn = block->ninsn;
-	if (!ninsn)
-		return;
+	stats = options->print_stats ? &chunk->stats : NULL;
+
+	errcode = ptxed_range_lead(&chunk->range, decoder->lead);
+	if (errcode < 0)
+		return errcode;
+
+	decoder->stream = chunk->output.memstream[0].file;
+	decoder->output = &chunk->output;
+	decoder->begin = chunk->range.begin;
+	decoder->range = &chunk->range;
+	decoder->profile = chunk->profile;
+
+#if defined(FEATURE_SIDEBAND)
+	/* Only the first chunk starts decoding at its PSB packet.  Like a
+	 * sequential decode, it processes the sideband from its beginning.
+	 */
+	errcode = ptxed_sb_restore(decoder, chunk->range.preroll,
+				   chunk->range.preroll < chunk->range.begin);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to restore sideband: %s.\n",
+			prog, pt_errstr(pt_errcode(errcode)));
+		return errcode;
+	}
+#endif /* defined(FEATURE_SIDEBAND) */
+
+	decode(decoder, options, stats);
+
+	return ptxed_range_finish(&chunk->range, decoder->type, stats,
+				  decoder->profile);
+}
+
+static int ptxed_decode_thread(void *arg)
+{
+	struct ptxed_parallel *parallel;
+	struct ptxed_decoder decoder, lead;
+	struct ptxed_chunk *chunk;
+	struct pt_image *image;
+	int errcode, status;
+
+	parallel = (struct ptxed_parallel *) arg;
+	if (!parallel)
+		return -pte_internal;
+
+	/* Each thread uses its own decoders on its own copy of the image.  The
+	 * image section cache is shared.
+	 *
+	 * Each decoder restores its own sideband session from the sideband
+	 * index for each range it decodes.  The sessions replicate the main
+	 * decoder's session.
+	 *
+	 * A second decoder decodes the leading items of the range following
+	 * the chunk we decode.
+	 */
+	memset(&decoder, 0, sizeof(decoder));
+	decoder.type = parallel->decoder->type;
+	decoder.block = parallel->decoder->block;
+	decoder.insn = parallel->decoder->insn;
+	decoder.iscache = parallel->decoder->iscache;
+	decoder.sync_set = 1;
+	decoder.lead = &lead;
+
+	memset(&lead, 0, sizeof(lead));
+	lead.type = decoder.type;
+	lead.block = decoder.block;
+	lead.insn = decoder.insn;
+	lead.iscache = decoder.iscache;
+
+	image = pt_image_alloc(NULL);
+	if (!image) {
+		ptxed_parallel_fail(parallel, -pte_nomem);
+		return -pte_nomem;
+	}
+
+	errcode = pt_image_copy(image, parallel->image);
+	if (errcode < 0)
+		goto out;
+
+#if defined(FEATURE_SIDEBAND)
+	decoder.options = parallel->options;
+	decoder.sb_index = parallel->sb_index;
+	decoder.sb_origin = parallel->decoder;
+	decoder.image = image;
+
+	lead.options = decoder.options;
+	lead.sb_index = decoder.sb_index;
+	lead.sb_origin = decoder.sb_origin;
+	lead.image = image;
+#endif /* defined(FEATURE_SIDEBAND) */
+
+	errcode = alloc_decoder(&decoder, parallel->config, image,
+				parallel->options, parallel->prog);
+	if (errcode < 0)
+		goto out;
+
+	errcode = alloc_decoder(&lead, parallel->config, image,
+				parallel->options, parallel->prog);
+	if (errcode < 0)
+		goto out;
 
-	ip = block->ip;
 	for (;;) {
-		struct pt_insn insn;
-		xed_decoded_inst_t inst;
-		xed_error_enum_t xederrcode;
+		chunk = ptxed_next_chunk(parallel);
+		if (!chunk)
+			break;
+
+		errcode = ptxed_decode_chunk(parallel, &decoder, chunk);
+		if (errcode < 0)
+			ptxed_parallel_fail(parallel, errcode);
+
+		/* We close the output even if we failed so the chunk's printer
+		 * does not wait for it.
+		 */
+		status = ptxed_output_close(&chunk->output, &chunk->range);
+		if ((status < 0) && (errcode >= 0)) {
+			errcode = status;
+			ptxed_parallel_fail(parallel, errcode);
+		}
+
+		if (errcode < 0)
+			break;
+	}
+
+	/* The chunks' profiles are merged when printing them. */
+	decoder.profile = NULL;
+	decoder.output = NULL;
+	decoder.stream = NULL;
+
+out:
+	if (errcode < 0)
+		ptxed_parallel_fail(parallel, errcode);
+
+	/* The image section cache is owned by the main decoder. */
+	decoder.iscache = NULL;
+	lead.iscache = NULL;
+	ptxed_free_decoder(&decoder);
+	ptxed_free_decoder(&lead);
+	pt_image_free(image);
+
+	return errcode;
+}
+
+/* Print the part of @size bytes of @text at output position @pos that lies
+ * within [@begin; @end[.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_print_text(const char *text, size_t size, long pos,
+			    long begin, long end)
+{
+	long last;
+
+	if (!text && size)
+		return -pte_internal;
+
+	last = pos + (long) size;
+	if (begin < pos)
+		begin = pos;
+
+	if (last < end)
+		end = last;
+
+	if (end <= begin)
+		return 0;
+
+	size = (size_t) (end - begin);
+	if (fwrite(text + (begin - pos), 1, size, stdout) != size)
+		return -pte_internal;
+
+	return 0;
+}
+
+/* Print the part of @piece that lies within [@begin; @end[ and its block
+ * markers.
+ *
+ * Block markers are numbered following @blocks.  Markers for blocks beyond
+ * @nblocks are not printed.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_print_piece(const struct ptxed_piece *piece, long begin,
+			     long end, uint64_t blocks, uint64_t nblocks)
+{
+	const struct ptxed_marks *marks;
+	long pos;
+	size_t idx;
+
+	if (!piece)
+		return -pte_internal;
+
+	pos = piece->pos;
+	marks = &piece->marks;
+	for (idx = 0; idx < marks->nmarks; ++idx) {
+		const struct ptxed_mark *mark;
 		int errcode;
 
-		if (options->print_offset)
-			printf("%016" PRIx64 "  ", offset);
+		mark = &marks->mark[idx];
+		if (mark->pos < begin)
+			continue;
 
-		if (options->print_time)
-			printf("%016" PRIx64 "  ", time);
+		/* Blocks beyond the chunk's blocks are printed by the next
+		 * chunk.
+		 *
+		 * Empty blocks don't print anything, so we can't tell by
+		 * their position.
+		 */
+		if (nblocks < mark->block)
+			break;
 
-		if (block->speculative)
-			printf("? ");
+		errcode = ptxed_print_text(piece->text + (pos - piece->pos),
+					   (size_t) (mark->pos - pos), pos,
+					   begin, end);
+		if (errcode < 0)
+			return errcode;
+
+		pos = mark->pos;
+
+		printf("[block %" PRIx64 "]\n", blocks + mark->block);
+	}
+
+	return ptxed_print_text(piece->text + (pos - piece->pos),
+				piece->size - (size_t) (pos - piece->pos), pos,
+				begin, end);
+}
+
+/* Print the output of @chunk and add its statistics to @stats and its profile
+ * to @profile.
+ *
+ * Unless @whole is set, the output starts with the chunk's first item.  Events
+ * preceding it have already been printed with the preceding chunk.  If @skip
+ * is set, the output is discarded.
+ *
+ * Block markers are numbered following the blocks in @stats.
+ *
+ * The output is printed while the chunk is being decoded.  Its pieces are
+ * printed as they become ready until the chunk's output is closed.
+ */
+static int ptxed_print_chunk(struct ptxed_chunk *chunk, int whole, int skip,
+			     struct ptxed_stats *stats,
+			     struct ptxed_profile *profile, const char *prog)
+{
+	struct ptxed_output *output;
+	uint64_t blocks;
+	long begin;
+	int errcode;
+
+	if (!chunk)
+		return -pte_internal;
+
+	blocks = stats ? stats->blocks : 0ull;
+	output = &chunk->output;
+	begin = -1l;
+
+	if (mtx_lock(&output->lock) != thrd_success)
+		return -pte_bad_lock;
+
+	/* The decoder does not need to wait for us, anymore. */
+	output->printing = 1;
+	(void) cnd_broadcast(&output->changed);
+
+	errcode = 0;
+	for (;;) {
+		struct ptxed_piece *piece;
+		uint64_t nblocks;
+		long end;
+		int last;
+
+		while (!output->first && !output->closed) {
+			if (cnd_wait(&output->changed, &output->lock) !=
+			    thrd_success) {
+				(void) mtx_unlock(&output->lock);
+				return -pte_bad_lock;
+			}
+		}
+
+		piece = output->first;
+		if (!piece)
+			break;
+
+		output->first = piece->next;
+		if (!output->first)
+			output->last = NULL;
+
+		output->buffered -= piece->size;
+
+		/* The last piece is added when closing the output. */
+		last = output->closed && !output->first;
+
+		(void) mtx_unlock(&output->lock);
+
+		if (!skip) {
+			/* The chunk's first item precedes its first piece. */
+			if (begin < 0l) {
+				begin = 0l;
+				if (!whole && (0l <= chunk->range.first))
+					begin = chunk->range.first;
+			}
+
+			/* We only know where the next chunk takes over and how
+			 * many blocks we decoded when we're done.
+			 */
+			end = LONG_MAX;
+			nblocks = UINT64_MAX;
+			if (last) {
+				if (0l <= chunk->range.cut)
+					end = chunk->range.cut;
+
+				nblocks = chunk->stats.blocks;
+			}
+
+			errcode = ptxed_print_piece(piece, begin, end, blocks,
+						    nblocks);
+		}
+
+		ptxed_piece_free(piece);
+
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to print decoded trace.\n",
+				prog);
+			return errcode;
+		}
+
+		if (mtx_lock(&output->lock) != thrd_success)
+			return -pte_bad_lock;
+	}
+
+	(void) mtx_unlock(&output->lock);
+
+	if (skip)
+		return 0;
+
+	if (profile && chunk->profile) {
+		errcode = ptxed_profile_merge(profile, chunk->profile);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	if (stats) {
+		stats->insn += chunk->stats.insn;
+		stats->blocks += chunk->stats.blocks;
+	}
+
+	return 0;
+}
 
-		printf("%016" PRIx64, ip);
+/* Let the decoders of @nchunks @chunks stop without printing their output. */
+static void ptxed_abort_chunks(struct ptxed_chunk *chunks, uint32_t nchunks)
+{
+	uint32_t idx;
 
-		errcode = block_fetch_insn(&insn, block, ip, decoder->iscache);
-		if (errcode < 0) {
-			printf(" [fetch error: %s]\n",
-			       pt_errstr(pt_errcode(errcode)));
-			break;
-		}
+	for (idx = 0; idx < nchunks; ++idx) {
+		struct ptxed_output *output;
 
-		xed_decoded_inst_zero_set_mode(&inst, &xed);
+		output = &chunks[idx].output;
+		if (mtx_lock(&output->lock) != thrd_success)
+			continue;
 
-		xederrcode = xed_decode(&inst, insn.raw, insn.size);
-		if (xederrcode != XED_ERROR_NONE) {
-			print_raw_insn(&insn);
+		output->abort = 1;
 
-			printf(" [xed decode error: (%u) %s]\n", xederrcode,
-			       xed_error_enum_t2str(xederrcode));
-			break;
-		}
+		(void) cnd_broadcast(&output->changed);
+		(void) mtx_unlock(&output->lock);
+	}
+}
 
-		if (!options->dont_print_insn)
-			xed_print_insn(&inst, insn.ip, options);
+/* Initialize the outputs of @nchunks @chunks.
+ *
+ * Returns the number of initialized outputs.
+ */
+static uint32_t ptxed_init_outputs(struct ptxed_chunk *chunks,
+				   uint32_t nchunks)
+{
+	uint32_t idx;
 
-		printf("\n");
+	for (idx = 0; idx < nchunks; ++idx) {
+		struct ptxed_output *output;
 
-		ninsn -= 1;
-		if (!ninsn)
+		output = &chunks[idx].output;
+		if (mtx_init(&output->lock, mtx_plain) != thrd_success)
 			break;
 
-		errcode = xed_next_ip(&ip, &inst, ip);
-		if (errcode < 0) {
-			diagnose(decoder, ip, "reconstruct error", errcode);
+		if (cnd_init(&output->changed) != thrd_success) {
+			mtx_destroy(&output->lock);
 			break;
 		}
 	}
 
-	/* Decode should have brought us to @block->end_ip. */
-	if (ip != block->end_ip)
-		diagnose(decoder, ip, "reconstruct error", -pte_nosync);
+	return idx;
 }
 
-static void check_block(const struct pt_block *block,
-			struct pt_image_section_cache *iscache,
-			uint64_t offset)
+static void ptxed_output_fini(struct ptxed_output *output)
 {
-	struct pt_insn insn;
-	xed_decoded_inst_t inst;
-	uint64_t ip;
-	uint16_t ninsn;
-	int errcode;
-
-	if (!block) {
-		printf("[internal error]\n");
-		return;
-	}
+	struct ptxed_piece *piece;
+	int idx;
 
-	/* There's nothing to check for an empty block. */
-	ninsn = block->ninsn;
-	if (!ninsn)
+	if (!output)
 		return;
 
-	if (block->isid <= 0)
-		printf("[%" PRIx64 ", %" PRIx64 ": check error: "
-		       "bad isid]\n", offset, block->ip);
+	piece = output->first;
+	while (piece) {
+		struct ptxed_piece *trash;
 
-	ip = block->ip;
-	do {
-		errcode = block_fetch_insn(&insn, block, ip, iscache);
-		if (errcode < 0) {
-			printf("[%" PRIx64 ", %" PRIx64 ": fetch error: %s]\n",
-			       offset, ip, pt_errstr(pt_errcode(errcode)));
-			return;
-		}
+		trash = piece;
+		piece = piece->next;
 
-		xed_decoded_inst_zero(&inst);
-		check_insn_decode(&inst, &insn, offset);
+		ptxed_piece_free(trash);
+	}
 
-		/* We need a valid instruction in order to do further checks.
-		 *
-		 * Invalid instructions have already been diagnosed.
-		 */
-		if (!xed_decoded_inst_valid(&inst))
-			return;
+	for (idx = 0; idx < 2; ++idx) {
+		char *text;
+		size_t size;
 
-		errcode = xed_next_ip(&ip, &inst, ip);
-		if (errcode < 0) {
-			printf("[%" PRIx64 ", %" PRIx64 ": error: %s]\n",
-			       offset, ip, pt_errstr(pt_errcode(errcode)));
-			return;
-		}
-	} while (--ninsn);
+		if (!output->memstream[idx].file)
+			continue;
 
-	/* We reached the end of the block.  Both @insn and @inst refer to the
-	 * last instruction in @block.
-	 *
-	 * Check that we reached the end IP of the block.
-	 */
-	if (insn.ip != block->end_ip) {
-		printf("[%" PRIx64 ", %" PRIx64 ": error: did not reach end: %"
-		       PRIx64 "]\n", offset, insn.ip, block->end_ip);
+		if (!ptxed_memstream_close(&output->memstream[idx], &text,
+					   &size))
+			free(text);
 	}
 
-	/* Check the last instruction's classification, if available. */
-	insn.iclass = block->iclass;
-	if (insn.iclass)
-		check_insn_iclass(xed_decoded_inst_inst(&inst), &insn, offset);
+	cnd_destroy(&output->changed);
+	mtx_destroy(&output->lock);
 }
 
-static int drain_events_block(struct ptxed_decoder *decoder, uint64_t *time,
-			      int status, const struct ptxed_options *options)
+/* Decode the trace on @options->threads threads in parallel.
+ *
+ * We split the trace into chunks of adjacent trace segments and decode each
+ * chunk on its own.  Each chunk's output is buffered in memory and printed in
+ * trace order, so the output is the same as when decoding the trace
+ * sequentially.  Decode threads stay at most a few chunks ahead of printing
+ * and buffer a bounded amount of output per chunk.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+#if defined(FEATURE_SIDEBAND)
+
+/* Build a sideband index for @decoder's sideband session.
+ *
+ * We process a replica of @decoder's session so @decoder's session remains
+ * unused.  The index is NULL if @decoder does not use sideband.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_index(struct pt_sb_index **pindex,
+			  const struct ptxed_decoder *decoder)
 {
-	struct pt_block_decoder *ptdec;
+	struct pt_sb_session *session;
 	int errcode;
 
-	if (!decoder || !time || !options)
+	if (!pindex || !decoder)
 		return -pte_internal;
 
-	ptdec = decoder->variant.block;
-
-	while (status & pts_event_pending) {
-		struct pt_event event;
-		uint64_t offset;
+	*pindex = NULL;
 
-		offset = 0ull;
-		if (options->print_offset) {
-			errcode = pt_blk_get_offset(ptdec, &offset);
-			if (errcode < 0)
-				return errcode;
-		}
+	if (!decoder->have_sb)
+		return 0;
 
-		status = pt_blk_event(ptdec, &event, sizeof(event));
-		if (status < 0)
-			return status;
+	errcode = ptxed_sb_replicate(&session, decoder);
+	if (errcode < 0)
+		return errcode;
 
-		*time = event.tsc;
+	errcode = pt_sb_index_build(pindex, session, ptxed_sb_interval);
+	pt_sb_free(session);
 
-		if (!options->quiet && !event.status_update)
-			print_event(&event, options, offset);
+	return errcode;
+}
 
-#if defined(FEATURE_SIDEBAND)
-		errcode = ptxed_sb_event(decoder, &event, options);
-		if (errcode < 0)
-			return errcode;
 #endif /* defined(FEATURE_SIDEBAND) */
-	}
 
-	return status;
-}
-
-static void decode_block(struct ptxed_decoder *decoder,
-			 const struct ptxed_options *options,
-			 struct ptxed_stats *stats)
+static int decode_parallel(const struct ptxed_decoder *decoder,
+			   const struct pt_image *image,
+			   const struct ptxed_options *options,
+			   struct ptxed_stats *stats, const char *prog)
 {
-	struct pt_image_section_cache *iscache;
-	struct pt_block_decoder *ptdec;
-	uint64_t offset, sync, time;
-
-	if (!decoder || !options) {
-		printf("[internal error]\n");
-		return;
-	}
-
-	iscache = decoder->iscache;
-	ptdec = decoder->variant.block;
-	offset = 0ull;
-	sync = 0ull;
-	time = 0ull;
-	for (;;) {
-		struct pt_block block;
-		int status;
-
-		/* Initialize IP and ninsn - we use it for error reporting. */
-		block.ip = 0ull;
-		block.ninsn = 0u;
-
-		status = pt_blk_sync_forward(ptdec);
-		if (status < 0) {
-			uint64_t new_sync;
-			int errcode;
+	const struct ptxed_chunk *prev;
+	const struct pt_config *config;
+	struct ptxed_parallel parallel;
+#if defined(FEATURE_SIDEBAND)
+	struct pt_sb_index *sb_index;
+#endif
+	thrd_t *threads;
+	uint32_t nthreads, noutputs, idx;
+	int errcode, status;
 
-			if (status == -pte_eos)
-				break;
+	if (!decoder || !options || !prog)
+		return -pte_internal;
 
-			diagnose_block(decoder, "sync error", status, &block);
+	config = ptxed_get_config(decoder);
+	if (!config)
+		return -pte_internal;
 
-			/* Let's see if we made any progress.  If we haven't,
-			 * we likely never will.  Bail out.
-			 *
-			 * We intentionally report the error twice to indicate
-			 * that we tried to re-sync.  Maybe it even changed.
-			 */
-			errcode = pt_blk_get_offset(ptdec, &new_sync);
-			if (errcode < 0 || (new_sync <= sync))
-				break;
+#if defined(FEATURE_SIDEBAND)
+	sb_index = NULL;
+#endif
 
-			sync = new_sync;
-			continue;
-		}
+	memset(&parallel, 0, sizeof(parallel));
+	parallel.decoder = decoder;
+	parallel.config = config;
+	parallel.image = image;
+	parallel.options = options;
+	parallel.prog = prog;
 
-		for (;;) {
-			status = drain_events_block(decoder, &time, status,
-						    options);
-			if (status < 0)
-				break;
+	nthreads = options->threads;
 
-			if (status & pts_eos) {
-				if (!(status & pts_ip_suppressed) &&
-				    !options->quiet)
-					printf("[end of trace]\n");
+	errcode = ptxed_split_chunks(&parallel, config, decoder, nthreads);
+	if (errcode < 0) {
+		/* There is nothing to decode without trace segments. */
+		if (errcode == -pte_eos)
+			return 0;
 
-				status = -pte_eos;
-				break;
-			}
+		fprintf(stderr, "%s: failed to split the trace: %s.\n", prog,
+			pt_errstr(pt_errcode(errcode)));
+		return errcode;
+	}
 
-			if (options->print_offset || options->check) {
-				int errcode;
+	if (parallel.nchunks < nthreads)
+		nthreads = parallel.nchunks;
 
-				errcode = pt_blk_get_offset(ptdec, &offset);
-				if (errcode < 0)
-					break;
-			}
+	parallel.window = nthreads * ptxed_chunks_in_flight;
 
-			status = pt_blk_next(ptdec, &block, sizeof(block));
-			if (status < 0) {
-				/* Even in case of errors, we may have succeeded
-				 * in decoding some instructions.
-				 */
-				if (block.ninsn) {
-					if (stats) {
-						stats->insn += block.ninsn;
-						stats->blocks += 1;
-					}
+	errcode = -pte_bad_lock;
+	noutputs = ptxed_init_outputs(parallel.chunks, parallel.nchunks);
+	if (noutputs < parallel.nchunks)
+		goto out_chunks;
 
-					if (!options->quiet)
-						print_block(decoder, &block,
-							    options, stats,
-							    offset, time);
+#if defined(FEATURE_SIDEBAND)
+	errcode = ptxed_sb_index(&sb_index, decoder);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: failed to index sideband: %s.\n", prog,
+			pt_errstr(pt_errcode(errcode)));
+		goto out_chunks;
+	}
 
-					if (options->check)
-						check_block(&block, iscache,
-							    offset);
-				}
-				break;
-			}
+	parallel.sb_index = sb_index;
+#endif /* defined(FEATURE_SIDEBAND) */
 
-			if (stats) {
-				stats->insn += block.ninsn;
-				stats->blocks += 1;
-			}
+	errcode = -pte_nomem;
+	threads = malloc(nthreads * sizeof(*threads));
+	if (!threads)
+		goto out_chunks;
 
-			if (!options->quiet)
-				print_block(decoder, &block, options, stats,
-					    offset, time);
+	errcode = -pte_bad_lock;
+	if (mtx_init(&parallel.lock, mtx_plain) != thrd_success)
+		goto out_threads;
 
-			if (options->check)
-				check_block(&block, iscache, offset);
-		}
+	if (cnd_init(&parallel.claimed) != thrd_success)
+		goto out_lock;
 
-		/* We shouldn't break out of the loop without an error. */
-		if (!status)
-			status = -pte_internal;
+	if (cnd_init(&parallel.released) != thrd_success)
+		goto out_claimed;
 
-		/* We're done when we reach the end of the trace stream. */
-		if (status == -pte_eos)
+	errcode = 0;
+	for (idx = 0; idx < nthreads; ++idx) {
+		if (thrd_create(&threads[idx], ptxed_decode_thread,
+				&parallel) != thrd_success) {
+			ptxed_parallel_fail(&parallel, -pte_nomem);
 			break;
-
-		diagnose_block(decoder, "error", status, &block);
-	}
-}
-
-static void decode(struct ptxed_decoder *decoder,
-		   const struct ptxed_options *options,
-		   struct ptxed_stats *stats)
-{
-	if (!decoder) {
-		printf("[internal error]\n");
-		return;
-	}
-
-	switch (decoder->type) {
-	case pdt_insn_decoder:
-		decode_insn(decoder, options, stats);
-		break;
-
-	case pdt_block_decoder:
-		decode_block(decoder, options, stats);
-		break;
+		}
 	}
-}
-
-static int alloc_decoder(struct ptxed_decoder *decoder,
-			 const struct pt_config *conf, struct pt_image *image,
-			 const struct ptxed_options *options, const char *prog)
-{
-	struct pt_config config;
-	int errcode;
+	nthreads = idx;
 
-	if (!decoder || !conf || !options || !prog)
-		return -pte_internal;
+	/* Print the chunks in trace order as they are decoded. */
+	prev = NULL;
+	for (idx = 0; idx < parallel.nchunks; ++idx) {
+		struct ptxed_chunk *chunk;
+		int whole, skip;
 
-	config = *conf;
+		chunk = &parallel.chunks[idx];
 
-	switch (decoder->type) {
-	case pdt_insn_decoder:
-		config.flags = decoder->insn.flags;
+		errcode = ptxed_chunk_claimed(&parallel, chunk);
+		if (errcode < 0)
+			break;
 
-		decoder->variant.insn = pt_insn_alloc_decoder(&config);
-		if (!decoder->variant.insn) {
-			fprintf(stderr,
-				"%s: failed to create decoder.\n", prog);
-			return -pte_nomem;
-		}
+		/* The previous chunk may have decoded this chunk's trace in its
+		 * place - up to the end of the trace if its range ends at zero.
+		 */
+		skip = prev && (!prev->range.end ||
+				(chunk->range.begin < prev->range.end));
 
-		errcode = pt_insn_set_image(decoder->variant.insn, image);
-		if (errcode < 0) {
-			fprintf(stderr, "%s: failed to set image.\n", prog);
-			return errcode;
-		}
+		/* Unless the previous chunk re-synchronized onto this one,
+		 * this chunk's events before its first item have already been
+		 * printed.
+		 */
+		whole = !prev || prev->range.resync;
 
-		break;
+		errcode = ptxed_print_chunk(chunk, whole, skip, stats,
+					    decoder->profile, prog);
+		if (errcode < 0)
+			break;
 
-	case pdt_block_decoder:
-		config.flags = decoder->block.flags;
+		/* The chunk's decoder reports errors before closing the
+		 * chunk's output.
+		 */
+		errcode = ptxed_chunk_claimed(&parallel, chunk);
+		if (errcode < 0)
+			break;
 
-		decoder->variant.block = pt_blk_alloc_decoder(&config);
-		if (!decoder->variant.block) {
-			fprintf(stderr,
-				"%s: failed to create  decoder.\n", prog);
-			return -pte_nomem;
-		}
+		errcode = ptxed_chunk_printed(&parallel);
+		if (errcode < 0)
+			break;
 
-		errcode = pt_blk_set_image(decoder->variant.block, image);
-		if (errcode < 0) {
-			fprintf(stderr, "%s: failed to set image.\n", prog);
-			return errcode;
-		}
+		if (!skip)
+			prev = chunk;
+	}
 
-		break;
+	if (errcode < 0) {
+		ptxed_parallel_fail(&parallel, errcode);
+		ptxed_abort_chunks(parallel.chunks, parallel.nchunks);
 	}
 
-	return 0;
-}
+	for (idx = 0; idx < nthreads; ++idx)
+		(void) thrd_join(&threads[idx], &status);
 
-static void print_stats(struct ptxed_stats *stats)
-{
-	if (!stats) {
-		printf("[internal error]\n");
-		return;
-	}
+	if (errcode < 0)
+		fprintf(stderr, "%s: parallel decode failed: %s.\n", prog,
+			pt_errstr(pt_errcode(errcode)));
 
-	if (stats->flags & ptxed_stat_insn)
-		printf("insn: %" PRIu64 ".\n", stats->insn);
+	cnd_destroy(&parallel.released);
 
-	if (stats->flags & ptxed_stat_blocks)
-		printf("blocks:\t%" PRIu64 ".\n", stats->blocks);
-}
+out_claimed:
+	cnd_destroy(&parallel.claimed);
 
-#if defined(FEATURE_SIDEBAND)
+out_lock:
+	mtx_destroy(&parallel.lock);
 
-static int ptxed_print_error(int errcode, const char *filename,
-			     uint64_t offset, void *priv)
-{
-	const struct ptxed_options *options;
-	const char *errstr, *severity;
+out_threads:
+	free(threads);
 
-	options = (struct ptxed_options *) priv;
-	if (!options)
-		return -pte_internal;
+out_chunks:
+	for (idx = 0; idx < parallel.nchunks; ++idx) {
+		if (idx < noutputs)
+			ptxed_output_fini(&parallel.chunks[idx].output);
 
-	if (errcode >= 0 && !options->print_sb_warnings)
-		return 0;
+		ptxed_profile_free(parallel.chunks[idx].profile);
+		ptxed_range_fini(&parallel.chunks[idx].range);
+	}
 
-	if (!filename)
-		filename = "<unknown>";
+	free(parallel.chunks);
 
-	severity = errcode < 0 ? "error" : "warning";
+#if defined(FEATURE_SIDEBAND)
+	pt_sb_index_free(sb_index);
+#endif
 
-	errstr = errcode < 0
-		? pt_errstr(pt_errcode(errcode))
-		: pt_sb_errstr((enum pt_sb_error_code) errcode);
+	return errcode;
+}
 
-	if (!errstr)
-		errstr = "<unknown error>";
+#endif /* defined(FEATURE_THREADS) */
 
-	printf("[%s:%016" PRIx64 " sideband %s: %s]\n", filename, offset,
-	       severity, errstr);
+#if defined(FEATURE_SIDEBAND)
 
-	return 0;
-}
+#if defined(FEATURE_PEVENT)
 
-static int ptxed_print_switch(const struct pt_sb_context *context, void *priv)
+/* Add the sideband decoders for @config to @decoder's session.
+ *
+ * If @pdata is not NULL, the sideband is loaded from @pdata and @cpu is the
+ * primary cpu, if any.  Otherwise, it is loaded from the file named in @config.
+ *
+ * We remember the sideband's source so we can replicate the session.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int ptxed_sb_add(struct ptxed_decoder *decoder,
+			const struct pt_sb_pevent_config *config,
+			struct pt_sb_perf_data *pdata, uint32_t cpu)
 {
-	struct pt_image *image;
-	const char *name;
+	struct ptxed_sb_source *sources, *source;
+	int errcode;
 
-	if (!priv)
+	if (!decoder || !config)
 		return -pte_internal;
 
-	image = pt_sb_ctx_image(context);
-	if (!image)
-		return -pte_internal;
+	sources = realloc(decoder->sb_sources,
+			  (decoder->nsb_sources + 1) * sizeof(*sources));
+	if (!sources)
+		return -pte_nomem;
 
-	name = pt_image_name(image);
-	if (!name)
-		name = "<unknown>";
+	decoder->sb_sources = sources;
+
+	source = &sources[decoder->nsb_sources];
+	source->config = *config;
+	source->pdata = pdata;
+	source->cpu = cpu;
+
+	errcode = ptxed_sb_alloc_source(decoder->session, source);
+	if (errcode < 0)
+		return errcode;
 
-	printf("[context: %s]\n", name);
+	decoder->nsb_sources += 1;
+	decoder->have_sb = 1;
 
 	return 0;
 }
 
-#if defined(FEATURE_PEVENT)
-
 static int ptxed_sb_pevent(struct ptxed_decoder *decoder, char *filename,
 			   const char *prog)
 {
@@ -2056,7 +5263,7 @@ static int ptxed_sb_pevent(struct ptxed_decoder *decoder, char *filename,
 		config.end = (size_t) fend;
 	}
 
-	errcode = pt_sb_alloc_pevent_decoder(decoder->session, &config);
+	errcode = ptxed_sb_add(decoder, &config, NULL, 0);
 	if (errcode < 0) {
 		fprintf(stderr, "%s: error loading %s: %s.\n", prog, filename,
 			pt_errstr(pt_errcode(errcode)));
@@ -2066,6 +5273,144 @@ static int ptxed_sb_pevent(struct ptxed_decoder *decoder, char *filename,
 	return 0;
 }
 
+/* Map the trace recorded on @cpu in @pdata into @config.
+ *
+ * Returns a positive integer if the trace has been mapped, zero if there is no
+ * trace for @cpu, a negative error code otherwise.
+ */
+static int ptxed_perf_data_trace(struct pt_config *config,
+				 struct pt_sb_perf_data *pdata, uint32_t cpu)
+{
+	int naux, idx;
+
+	if (!config)
+		return -pte_internal;
+
+	naux = pt_sb_perf_data_naux(pdata);
+	if (naux < 0)
+		return naux;
+
+	for (idx = 0; idx < naux; ++idx) {
+		const uint8_t *begin, *end;
+		uint32_t aux_cpu;
+		int errcode;
+
+		errcode = pt_sb_perf_data_aux(&begin, &end, &aux_cpu, pdata,
+					      (uint32_t) idx);
+		if (errcode < 0)
+			return errcode;
+
+		if (aux_cpu != cpu)
+			continue;
+
+		/* The trace decoders do not modify the trace. */
+		config->begin = (uint8_t *) begin;
+		config->end = (uint8_t *) end;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Load sideband and, if no trace has been loaded, the trace for the primary
+ * cpu from a perf.data file.
+ *
+ * Returns a positive integer if the trace has been mapped into @pt_config,
+ * zero if only sideband has been loaded, a negative error code otherwise.
+ */
+static int ptxed_sb_perf_data(struct ptxed_decoder *decoder,
+			      struct pt_config *pt_config, char *arg,
+			      const char *prog)
+{
+	struct pt_sb_pevent_config config;
+	struct pt_sb_perf_data *pdata, **files;
+	uint32_t cpu;
+	char *sep;
+	int errcode;
+
+	if (!decoder || !pt_config || !arg || !prog) {
+		fprintf(stderr, "%s: internal error.\n", prog ? prog : "?");
+		return -1;
+	}
+
+	config = decoder->pevent;
+	config.primary = 0;
+	cpu = UINT32_MAX;
+
+	sep = strrchr(arg, ':');
+	if (sep) {
+		unsigned long value;
+		char *rest;
+
+		errno = 0;
+		value = strtoul(sep + 1, &rest, 0);
+		if (errno || *rest || (rest == sep + 1) ||
+		    (UINT32_MAX <= value)) {
+			fprintf(stderr, "%s: bad cpu: %s.\n", prog, sep + 1);
+			return -1;
+		}
+
+		*sep = 0;
+
+		config.primary = 1;
+		cpu = (uint32_t) value;
+	}
+
+	errcode = pt_sb_perf_data_open(&pdata, arg);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: error loading %s: %s.\n", prog, arg,
+			pt_errstr(pt_errcode(errcode)));
+		return -1;
+	}
+
+	/* The sideband decoders reference @pdata.  We close it after freeing
+	 * the session.
+	 */
+	files = realloc(decoder->perf_data_files,
+			(decoder->nperf_data_files + 1) * sizeof(*files));
+	if (!files) {
+		fprintf(stderr, "%s: failed to allocate perf.data files.\n",
+			prog);
+		pt_sb_perf_data_close(pdata);
+		return -1;
+	}
+
+	files[decoder->nperf_data_files++] = pdata;
+	decoder->perf_data_files = files;
+
+	errcode = ptxed_sb_add(decoder, &config, pdata, cpu);
+	if (errcode < 0) {
+		fprintf(stderr, "%s: error loading %s: %s.\n", prog, arg,
+			pt_errstr(pt_errcode(errcode)));
+		return -1;
+	}
+
+	/* We decode the trace of the primary cpu unless the trace has been
+	 * given explicitly or we already got it from another perf.data file.
+	 */
+	if (!config.primary || ptxed_have_decoder(decoder) ||
+	    decoder->perf_data)
+		return 0;
+
+	errcode = ptxed_perf_data_trace(pt_config, pdata, cpu);
+	if (errcode <= 0) {
+		if (errcode < 0)
+			fprintf(stderr, "%s: error loading trace from %s: "
+				"%s.\n", prog, arg,
+				pt_errstr(pt_errcode(errcode)));
+		else
+			fprintf(stderr, "%s: no trace for cpu %u in %s.\n",
+				prog, cpu, arg);
+
+		return -1;
+	}
+
+	decoder->perf_data = pdata;
+
+	return 1;
+}
+
 #endif /* defined(FEATURE_PEVENT) */
 #endif /* defined(FEATURE_SIDEBAND) */
 
@@ -2220,7 +5565,8 @@ extern int main(int argc, char *argv[])
 	}
 
 #if defined(FEATURE_SIDEBAND)
-	pt_sb_notify_error(decoder.session, ptxed_print_error, &options);
+	decoder.options = &options;
+	pt_sb_notify_error(decoder.session, ptxed_print_error, &decoder);
 #endif
 
 	image = pt_image_alloc(NULL);
@@ -2542,6 +5888,33 @@ extern int main(int argc, char *argv[])
 
 			continue;
 		}
+		if (strcmp(arg, "--iscache-share") == 0) {
+			errcode = pt_iscache_set_share(decoder.iscache, 1);
+			if (errcode < 0) {
+				fprintf(stderr, "%s: error setting iscache "
+					"sharing: %s.\n", prog,
+					pt_errstr(pt_errcode(errcode)));
+				goto err;
+			}
+
+			continue;
+		}
+		if (strcmp(arg, "--last-segments") == 0) {
+			if (!get_arg_uint64(&options.last_segments, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+#if defined(FEATURE_THREADS)
+		if (strcmp(arg, "--threads") == 0) {
+			if (!get_arg_uint32(&options.threads, arg, argv[i++],
+					    prog))
+				goto err;
+
+			continue;
+		}
+#endif /* defined(FEATURE_THREADS) */
 		if (strcmp(arg, "--stat") == 0) {
 			options.print_stats = 1;
 			continue;
@@ -2556,6 +5929,37 @@ extern int main(int argc, char *argv[])
 			stats.flags |= ptxed_stat_blocks;
 			continue;
 		}
+		if (strcmp(arg, "--profile") == 0) {
+			options.profile = 1;
+			options.quiet = 1;
+			continue;
+		}
+		if (strcmp(arg, "--profile:top") == 0) {
+			if (!get_arg_uint64(&options.profile_top, arg,
+					    argv[i++], prog))
+				goto err;
+
+			continue;
+		}
+		if (strcmp(arg, "--profile:bin") == 0) {
+			if (argc <= i) {
+				fprintf(stderr, "%s: --profile:bin: missing "
+					"argument.\n", prog);
+				goto err;
+			}
+			options.profile_bin = argv[i++];
+			options.profile = 1;
+			options.quiet = 1;
+			continue;
+		}
+		if (strcmp(arg, "--folded") == 0) {
+			options.folded = 1;
+			options.quiet = 1;
+
+			/* We need to see calls at the end of blocks. */
+			decoder.block.flags.variant.block.end_on_call = 1;
+			continue;
+		}
 #if defined(FEATURE_SIDEBAND)
 		if ((strcmp(arg, "--sb:compact") == 0) ||
 		    (strcmp(arg, "--sb") == 0)) {
@@ -2582,7 +5986,8 @@ extern int main(int argc, char *argv[])
 		}
 		if (strcmp(arg, "--sb:switch") == 0) {
 			pt_sb_notify_switch(decoder.session, ptxed_print_switch,
-					    &options);
+					    &decoder);
+			options.print_sb_switch = 1;
 			continue;
 		}
 		if (strcmp(arg, "--sb:warn") == 0) {
@@ -2620,6 +6025,37 @@ extern int main(int argc, char *argv[])
 
 			continue;
 		}
+		if (strcmp(arg, "--pevent:perf-data") == 0) {
+			arg = argv[i++];
+			if (!arg) {
+				fprintf(stderr, "%s: --pevent:perf-data: "
+					"missing argument.\n", prog);
+				goto err;
+			}
+
+			errcode = ptxed_sb_perf_data(&decoder, &config, arg,
+						     prog);
+			if (errcode < 0)
+				goto err;
+
+			if (!errcode)
+				continue;
+
+			if (config.cpu.vendor) {
+				errcode = pt_cpu_errata(&config.errata,
+							&config.cpu);
+				if (errcode < 0)
+					printf("[0, 0: config error: %s]\n",
+					       pt_errstr(pt_errcode(errcode)));
+			}
+
+			errcode = alloc_decoder(&decoder, &config, image,
+						&options, prog);
+			if (errcode < 0)
+				goto err;
+
+			continue;
+		}
 		if (strcmp(arg, "--pevent:sample-type") == 0) {
 			if (!get_arg_uint64(&decoder.pevent.sample_type,
 					    "--pevent:sample-type",
@@ -2668,6 +6104,12 @@ extern int main(int argc, char *argv[])
 
 			continue;
 		}
+#if defined(FEATURE_THREADS)
+		if (strcmp(arg, "--pevent:prefetch") == 0) {
+			decoder.pevent.prefetch = 1;
+			continue;
+		}
+#endif /* defined(FEATURE_THREADS) */
 		if (strcmp(arg, "--pevent:sysroot") == 0) {
 			arg = argv[i++];
 			if (!arg) {
@@ -2866,6 +6308,39 @@ extern int main(int argc, char *argv[])
 		goto err;
 	}
 
+	if (options.profile) {
+		decoder.profile = ptxed_profile_alloc();
+		if (!decoder.profile) {
+			fprintf(stderr, "%s: failed to allocate profile.\n",
+				prog);
+			goto err;
+		}
+	}
+
+	if (options.folded) {
+		decoder.callgraph =
+			ptxed_callgraph_alloc(ptxed_callgraph_max_depth);
+		if (!decoder.callgraph) {
+			fprintf(stderr, "%s: failed to allocate call graph.\n",
+				prog);
+			goto err;
+		}
+	}
+
+#if defined(FEATURE_THREADS)
+	if (options.threads > 1) {
+		/* A decode thread does not know the call stack at the
+		 * beginning of its trace segments.
+		 */
+		if (options.folded) {
+			fprintf(stderr, "%s: --threads does not support "
+				"--folded.\n", prog);
+			goto err;
+		}
+
+	}
+#endif /* defined(FEATURE_THREADS) */
+
 	xed_tables_init();
 
 	/* If we didn't select any statistics, select them all depending on the
@@ -2879,7 +6354,15 @@ extern int main(int argc, char *argv[])
 	}
 
 #if defined(FEATURE_SIDEBAND)
-	errcode = pt_sb_init_decoders(decoder.session);
+	/* For parallel decode, @decoder's session only serves as template for
+	 * the decode threads' sessions, which initialize their decoders
+	 * themselves.
+	 */
+	errcode = 0;
+#if defined(FEATURE_THREADS)
+	if (options.threads <= 1)
+#endif
+		errcode = pt_sb_init_decoders(decoder.session);
 	if (errcode < 0) {
 		fprintf(stderr,
 			"%s: error initializing sideband decoders: %s.\n",
@@ -2888,20 +6371,86 @@ extern int main(int argc, char *argv[])
 	}
 #endif /* defined(FEATURE_SIDEBAND) */
 
+	if (options.last_segments) {
+		errcode = find_last_segments(&decoder.begin,
+					     ptxed_get_config(&decoder),
+					     options.last_segments);
+		if (errcode < 0 && errcode != -pte_eos) {
+			diagnose(&decoder, 0ull, "segment error", errcode);
+			goto out;
+		}
+
+		decoder.sync_set = !errcode;
+	}
+
+#if defined(FEATURE_THREADS)
+	if (options.threads > 1) {
+		errcode = decode_parallel(&decoder, image, &options,
+					  options.print_stats ? &stats : NULL,
+					  prog);
+		if (errcode < 0)
+			goto err;
+	} else
+		decode(&decoder, &options,
+		       options.print_stats ? &stats : NULL);
+#else
 	decode(&decoder, &options, options.print_stats ? &stats : NULL);
+#endif /* defined(FEATURE_THREADS) */
 
 	if (options.print_stats)
 		print_stats(&stats);
 
+	if (options.profile_bin) {
+		errcode = ptxed_write_profile(options.profile_bin,
+					      decoder.profile,
+					      decoder.iscache);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to write profile to %s: "
+				"%s.\n", prog, options.profile_bin,
+				pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+	} else if (options.profile) {
+		errcode = ptxed_profile_print(stdout, decoder.profile,
+					      decoder.type == pdt_block_decoder
+					      ? "blocks" : "instructions",
+					      decoder.iscache,
+					      options.profile_top);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to print profile: %s.\n",
+				prog, pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+	}
+
+	if (options.folded) {
+		uint64_t truncated;
+
+		errcode = ptxed_callgraph_print_folded(stdout,
+						       decoder.callgraph,
+						       decoder.iscache);
+		if (errcode < 0) {
+			fprintf(stderr, "%s: failed to print call paths: %s.\n",
+				prog, pt_errstr(pt_errcode(errcode)));
+			goto err;
+		}
+
+		truncated = ptxed_callgraph_truncated(decoder.callgraph);
+		if (truncated)
+			fprintf(stderr, "%s: truncated %" PRIu64 " call stacks "
+				"deeper than %u functions.\n", prog, truncated,
+				ptxed_callgraph_max_depth);
+	}
+
 out:
+	ptxed_free_trace(&decoder, &config);
 	ptxed_free_decoder(&decoder);
 	pt_image_free(image);
-	free(config.begin);
 	return 0;
 
 err:
+	ptxed_free_trace(&decoder, &config);
 	ptxed_free_decoder(&decoder);
 	pt_image_free(image);
-	free(config.begin);
 	return 1;
 }
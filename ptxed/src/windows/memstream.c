@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "memstream.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+
+
+/* There is no in-memory stream on Windows.  We write into a temporary file
+ * and read it back into memory on close.
+ */
+
+int ptxed_memstream_open(struct ptxed_memstream *memstream)
+{
+	if (!memstream)
+		return -pte_internal;
+
+	memstream->text = NULL;
+	memstream->size = 0;
+
+	memstream->file = tmpfile();
+	if (!memstream->file)
+		return -pte_nomem;
+
+	return 0;
+}
+
+int ptxed_memstream_close(struct ptxed_memstream *memstream, char **text,
+			  size_t *size)
+{
+	FILE *file;
+	char *buffer;
+	long fsize;
+	size_t read;
+
+	if (!memstream || !text || !size)
+		return -pte_internal;
+
+	file = memstream->file;
+	if (!file)
+		return -pte_internal;
+
+	memstream->file = NULL;
+
+	fsize = ftell(file);
+	if ((fsize < 0) || fseek(file, 0, SEEK_SET)) {
+		fclose(file);
+		return -pte_nomem;
+	}
+
+	buffer = malloc(fsize ? (size_t) fsize : 1);
+	if (!buffer) {
+		fclose(file);
+		return -pte_nomem;
+	}
+
+	read = fread(buffer, 1, (size_t) fsize, file);
+	fclose(file);
+
+	if (read != (size_t) fsize) {
+		free(buffer);
+		return -pte_nomem;
+	}
+
+	*text = buffer;
+	*size = read;
+
+	return 0;
+}
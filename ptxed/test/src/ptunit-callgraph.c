@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "callgraph.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+enum {
+	/* The maximal depth of the test fixture's shadow call stack. */
+	cgfix_max_depth	= 4
+};
+
+/* A test fixture. */
+struct callgraph_fixture {
+	/* The call graph. */
+	struct ptxed_callgraph *callgraph;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct callgraph_fixture *);
+	struct ptunit_result (*fini)(struct callgraph_fixture *);
+};
+
+static struct ptunit_result cgfix_init(struct callgraph_fixture *cgfix)
+{
+	cgfix->callgraph = ptxed_callgraph_alloc(cgfix_max_depth);
+	ptu_ptr(cgfix->callgraph);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cgfix_fini(struct callgraph_fixture *cgfix)
+{
+	ptxed_callgraph_free(cgfix->callgraph);
+
+	return ptu_passed();
+}
+
+/* Add one instruction at @ip of class @iclass returning to @ret. */
+static struct ptunit_result cgfix_add(struct callgraph_fixture *cgfix,
+				      uint64_t ip, enum pt_insn_class iclass,
+				      uint64_t ret)
+{
+	int errcode;
+
+	errcode = ptxed_callgraph_add(cgfix->callgraph, 1, ip, 1, iclass, ret);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Send @event of type @type to the call graph. */
+static struct ptunit_result cgfix_event(struct callgraph_fixture *cgfix,
+					struct pt_event *event,
+					enum pt_event_type type)
+{
+	int errcode;
+
+	event->type = type;
+
+	errcode = ptxed_callgraph_event(cgfix->callgraph, event);
+	ptu_int_eq(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Check that the call graph prints as @expected in folded stack format. */
+static struct ptunit_result cgfix_check(struct callgraph_fixture *cgfix,
+					const char *expected)
+{
+	char buffer[1024];
+	size_t size;
+	FILE *stream;
+	int errcode;
+
+	stream = tmpfile();
+	ptu_ptr(stream);
+
+	errcode = ptxed_callgraph_print_folded(stream, cgfix->callgraph, NULL);
+	rewind(stream);
+	size = fread(buffer, 1, sizeof(buffer) - 1, stream);
+	fclose(stream);
+
+	ptu_int_eq(errcode, 0);
+
+	buffer[size] = 0;
+	ptu_str_eq(buffer, expected);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_zero(void)
+{
+	ptu_null(ptxed_callgraph_alloc(0));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result null(void)
+{
+	struct pt_event event;
+	int errcode;
+
+	memset(&event, 0, sizeof(event));
+
+	errcode = ptxed_callgraph_add(NULL, 1, 0x1000ull, 1, ptic_other, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_callgraph_event(NULL, &event);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_callgraph_print_folded(NULL, NULL, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	ptu_uint_eq(ptxed_callgraph_truncated(NULL), 0ull);
+
+	ptxed_callgraph_reset(NULL);
+	ptxed_callgraph_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result event_null(struct callgraph_fixture *cgfix)
+{
+	int errcode;
+
+	errcode = ptxed_callgraph_event(cgfix->callgraph, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct callgraph_fixture *cgfix)
+{
+	ptu_test(cgfix_check, cgfix, "");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result call_return(struct callgraph_fixture *cgfix)
+{
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_call, 0xa05ull);
+	ptu_test(cgfix_add, cgfix, 0xb00ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0xa05ull, ptic_other, 0ull);
+	ptu_test(cgfix_add, cgfix, 0xa06ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0x105ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 2\n"
+		 "[unknown];0xa00 3\n"
+		 "[unknown];0xa00;0xb00 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result return_unwind(struct callgraph_fixture *cgfix)
+{
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_call, 0xa05ull);
+	ptu_test(cgfix_add, cgfix, 0xb00ull, ptic_call, 0xb05ull);
+
+	/* Return from 0xc00 directly into 0xa00, skipping 0xb00. */
+	ptu_test(cgfix_add, cgfix, 0xc00ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0xa05ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0x105ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 2\n"
+		 "[unknown];0xa00 2\n"
+		 "[unknown];0xa00;0xb00 1\n"
+		 "[unknown];0xa00;0xb00;0xc00 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result return_unknown(struct callgraph_fixture *cgfix)
+{
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+
+	/* We assume that we returned to our caller. */
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_return, 0ull);
+
+	/* We stay in the root call path on returns beyond it. */
+	ptu_test(cgfix_add, cgfix, 0x200ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0x300ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 3\n"
+		 "[unknown];0xa00 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result async_branch(struct callgraph_fixture *cgfix)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.variant.async_branch.from = 0x101ull;
+	event.variant.async_branch.to = 0x800ull;
+
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_other, 0ull);
+	ptu_test(cgfix_event, cgfix, &event, ptev_async_branch);
+	ptu_test(cgfix_add, cgfix, 0x800ull, ptic_far_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0x101ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 2\n"
+		 "[unknown];0x800 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result disabled(struct callgraph_fixture *cgfix)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.ip_suppressed = 1;
+
+	/* Tracing resumes in the caller. */
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_event, cgfix, &event, ptev_disabled);
+	ptu_test(cgfix_add, cgfix, 0x105ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix, "[unknown] 2\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result reset(struct callgraph_fixture *cgfix,
+				  enum pt_event_type type)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_other, 0ull);
+	ptu_test(cgfix_event, cgfix, &event, type);
+	ptu_test(cgfix_add, cgfix, 0xa01ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 2\n"
+		 "[unknown];0xa00 1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result status_update(struct callgraph_fixture *cgfix,
+					  enum pt_event_type type)
+{
+	struct pt_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.status_update = 1;
+
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_other, 0ull);
+	ptu_test(cgfix_event, cgfix, &event, type);
+	ptu_test(cgfix_add, cgfix, 0xa01ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 1\n"
+		 "[unknown];0xa00 2\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result max_depth(struct callgraph_fixture *cgfix)
+{
+	ptu_test(cgfix_add, cgfix, 0x100ull, ptic_call, 0x105ull);
+	ptu_test(cgfix_add, cgfix, 0xa00ull, ptic_call, 0xa05ull);
+	ptu_test(cgfix_add, cgfix, 0xb00ull, ptic_call, 0xb05ull);
+	ptu_test(cgfix_add, cgfix, 0xc00ull, ptic_call, 0xc05ull);
+	ptu_test(cgfix_add, cgfix, 0xd00ull, ptic_call, 0xd05ull);
+	ptu_uint_eq(ptxed_callgraph_truncated(cgfix->callgraph), 0ull);
+
+	/* The call to 0xe00 drops 0xa00 and 0xb00. */
+	ptu_test(cgfix_add, cgfix, 0xe00ull, ptic_return, 0ull);
+	ptu_uint_eq(ptxed_callgraph_truncated(cgfix->callgraph), 1ull);
+
+	/* We still match returns to frames we kept. */
+	ptu_test(cgfix_add, cgfix, 0xd05ull, ptic_return, 0ull);
+	ptu_test(cgfix_add, cgfix, 0xc05ull, ptic_other, 0ull);
+
+	ptu_test(cgfix_check, cgfix,
+		 "[unknown] 1\n"
+		 "[unknown];0xa00 1\n"
+		 "[unknown];0xa00;0xb00 1\n"
+		 "[unknown];0xa00;0xb00;0xc00 1\n"
+		 "[unknown];0xa00;0xb00;0xc00;0xd00 1\n"
+		 "[unknown];0xc00 1\n"
+		 "[unknown];0xc00;0xd00 1\n"
+		 "[unknown];0xc00;0xd00;0xe00 1\n");
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct callgraph_fixture cgfix;
+	struct ptunit_suite suite;
+
+	cgfix.init = cgfix_init;
+	cgfix.fini = cgfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, alloc_zero);
+	ptu_run(suite, null);
+
+	ptu_run_f(suite, event_null, cgfix);
+	ptu_run_f(suite, empty, cgfix);
+	ptu_run_f(suite, call_return, cgfix);
+	ptu_run_f(suite, return_unwind, cgfix);
+	ptu_run_f(suite, return_unknown, cgfix);
+	ptu_run_f(suite, async_branch, cgfix);
+	ptu_run_f(suite, disabled, cgfix);
+	ptu_run_fp(suite, reset, cgfix, ptev_overflow);
+	ptu_run_fp(suite, reset, cgfix, ptev_paging);
+	ptu_run_fp(suite, reset, cgfix, ptev_async_paging);
+	ptu_run_fp(suite, status_update, cgfix, ptev_paging);
+	ptu_run_fp(suite, status_update, cgfix, ptev_async_paging);
+	ptu_run_f(suite, max_depth, cgfix);
+
+	return ptunit_report(&suite);
+}
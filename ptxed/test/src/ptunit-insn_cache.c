@@ -0,0 +1,347 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "insn_cache.h"
+
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+/* A test fixture. */
+struct insn_cache_fixture {
+	/* The instruction cache. */
+	struct ptxed_insn_cache *cache;
+
+	/* An instruction to insert. */
+	struct pt_insn insn;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct insn_cache_fixture *);
+	struct ptunit_result (*fini)(struct insn_cache_fixture *);
+};
+
+static struct ptunit_result icfix_init(struct insn_cache_fixture *icfix)
+{
+	icfix->cache = ptxed_insn_cache_alloc();
+	ptu_ptr(icfix->cache);
+
+	memset(&icfix->insn, 0, sizeof(icfix->insn));
+	icfix->insn.ip = 0x1000ull;
+	icfix->insn.isid = 1;
+	icfix->insn.mode = ptem_64bit;
+	icfix->insn.size = 2;
+	icfix->insn.raw[0] = 0xeb;
+	icfix->insn.raw[1] = 0xfe;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result icfix_fini(struct insn_cache_fixture *icfix)
+{
+	ptxed_insn_cache_free(icfix->cache);
+
+	return ptu_passed();
+}
+
+/* Insert @insn and mark its entry valid, as ptxed does after decoding it. */
+static struct ptunit_result icfix_insert(struct insn_cache_fixture *icfix,
+					 const struct pt_insn *insn)
+{
+	struct ptxed_cached_insn *entry;
+
+	entry = ptxed_insn_cache_insert(icfix->cache, insn);
+	ptu_ptr(entry);
+
+	entry->valid = 1;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result null(void)
+{
+	struct ptxed_cached_insn *entry;
+	struct pt_insn insn;
+
+	memset(&insn, 0, sizeof(insn));
+
+	ptxed_insn_cache_free(NULL);
+
+	entry = ptxed_insn_cache_lookup(NULL, 0ull, 1, ptem_64bit);
+	ptu_null(entry);
+
+	entry = ptxed_insn_cache_insert(NULL, &insn);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insert_null(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	entry = ptxed_insn_cache_insert(icfix->cache, NULL);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lookup_empty(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result insert(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	entry = ptxed_insn_cache_insert(icfix->cache, &icfix->insn);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->ip, icfix->insn.ip);
+	ptu_int_eq(entry->isid, icfix->insn.isid);
+	ptu_int_eq(entry->mode, icfix->insn.mode);
+	ptu_uint_eq(entry->size, icfix->insn.size);
+	ptu_uint_eq(entry->raw[0], icfix->insn.raw[0]);
+	ptu_uint_eq(entry->raw[1], icfix->insn.raw[1]);
+	ptu_uint_eq(entry->valid, 0);
+	ptu_uint_eq(entry->has_text, 0);
+
+	/* The entry is not found until it has been decoded. */
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lookup(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->ip, icfix->insn.ip);
+	ptu_int_eq(entry->isid, icfix->insn.isid);
+	ptu_int_eq(entry->mode, icfix->insn.mode);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lookup_bad_mode(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, ptem_32bit);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lookup_bad_isid(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid + 1, icfix->insn.mode);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result lookup_bad_ip(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip + 1,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_null(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result collision(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+	struct pt_insn insn;
+	uint64_t ip;
+
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	/* Insert instructions at increasing IPs until one evicts the first.
+	 *
+	 * The cache is direct-mapped and much smaller than the range we try.
+	 */
+	insn = icfix->insn;
+	for (ip = icfix->insn.ip + 1; ip < icfix->insn.ip + 0x100000ull;
+	     ++ip) {
+		insn.ip = ip;
+		ptu_test(icfix_insert, icfix, &insn);
+
+		entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+						icfix->insn.isid,
+						icfix->insn.mode);
+		if (!entry)
+			break;
+	}
+	ptu_uint_ne(ip, icfix->insn.ip + 0x100000ull);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, insn.ip, insn.isid,
+					insn.mode);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->ip, insn.ip);
+
+	/* Inserting the first instruction again evicts the second. */
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, insn.ip, insn.isid,
+					insn.mode);
+	ptu_null(entry);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_ptr(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result scratch(struct insn_cache_fixture *icfix,
+				    int isid)
+{
+	struct ptxed_cached_insn *first, *second;
+	struct pt_insn insn;
+
+	insn = icfix->insn;
+	insn.isid = isid;
+
+	first = ptxed_insn_cache_insert(icfix->cache, &insn);
+	ptu_ptr(first);
+	ptu_int_eq(first->isid, isid);
+
+	first->valid = 1;
+
+	/* Lookups never find the scratch entry. */
+	second = ptxed_insn_cache_lookup(icfix->cache, insn.ip, insn.isid,
+					 insn.mode);
+	ptu_null(second);
+
+	/* The next such instruction reuses it. */
+	insn.ip += 0x10ull;
+
+	second = ptxed_insn_cache_insert(icfix->cache, &insn);
+	ptu_ptr_eq(second, first);
+	ptu_uint_eq(second->ip, insn.ip);
+	ptu_uint_eq(second->valid, 0);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result truncated(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+	struct pt_insn insn;
+
+	insn = icfix->insn;
+	insn.truncated = 1;
+
+	ptu_test(icfix_insert, icfix, &insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, insn.ip, insn.isid,
+					insn.mode);
+	ptu_null(entry);
+
+	/* The truncated instruction did not evict a cached instruction. */
+	ptu_test(icfix_insert, icfix, &icfix->insn);
+	ptu_test(icfix_insert, icfix, &insn);
+
+	entry = ptxed_insn_cache_lookup(icfix->cache, icfix->insn.ip,
+					icfix->insn.isid, icfix->insn.mode);
+	ptu_ptr(entry);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result clamp_size(struct insn_cache_fixture *icfix)
+{
+	struct ptxed_cached_insn *entry;
+	struct pt_insn insn;
+
+	insn = icfix->insn;
+	insn.size = 0xff;
+
+	entry = ptxed_insn_cache_insert(icfix->cache, &insn);
+	ptu_ptr(entry);
+	ptu_uint_eq(entry->size, pt_max_insn_size);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct insn_cache_fixture icfix;
+	struct ptunit_suite suite;
+
+	icfix.init = icfix_init;
+	icfix.fini = icfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, null);
+
+	ptu_run_f(suite, insert_null, icfix);
+	ptu_run_f(suite, lookup_empty, icfix);
+	ptu_run_f(suite, insert, icfix);
+	ptu_run_f(suite, lookup, icfix);
+	ptu_run_f(suite, lookup_bad_mode, icfix);
+	ptu_run_f(suite, lookup_bad_isid, icfix);
+	ptu_run_f(suite, lookup_bad_ip, icfix);
+	ptu_run_f(suite, collision, icfix);
+	ptu_run_fp(suite, scratch, icfix, 0);
+	ptu_run_fp(suite, scratch, icfix, -1);
+	ptu_run_f(suite, truncated, icfix);
+	ptu_run_f(suite, clamp_size, icfix);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "memstream.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static struct ptunit_result null(void)
+{
+	struct ptxed_memstream memstream;
+	char *text;
+	size_t size;
+	int errcode;
+
+	errcode = ptxed_memstream_open(NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	memset(&memstream, 0, sizeof(memstream));
+
+	errcode = ptxed_memstream_close(NULL, &text, &size);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_memstream_close(&memstream, NULL, &size);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_memstream_close(&memstream, &text, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result not_open(void)
+{
+	struct ptxed_memstream memstream;
+	char *text;
+	size_t size;
+	int errcode;
+
+	memset(&memstream, 0, sizeof(memstream));
+
+	errcode = ptxed_memstream_close(&memstream, &text, &size);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(void)
+{
+	struct ptxed_memstream memstream;
+	char *text;
+	size_t size;
+	int errcode;
+
+	errcode = ptxed_memstream_open(&memstream);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr(memstream.file);
+
+	text = NULL;
+	size = 1;
+	errcode = ptxed_memstream_close(&memstream, &text, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, 0);
+	ptu_null(memstream.file);
+
+	free(text);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_text(void)
+{
+	struct ptxed_memstream memstream;
+	char *text;
+	size_t size;
+	int errcode;
+
+	errcode = ptxed_memstream_open(&memstream);
+	ptu_int_eq(errcode, 0);
+
+	fprintf(memstream.file, "%s %d\n", "hello", 42);
+	fputs("world\n", memstream.file);
+
+	ptu_int_eq(ftell(memstream.file), 15);
+
+	text = NULL;
+	size = 0;
+	errcode = ptxed_memstream_close(&memstream, &text, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, 15);
+	ptu_ptr(text);
+	ptu_int_eq(memcmp(text, "hello 42\nworld\n", size), 0);
+
+	free(text);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result write_large(void)
+{
+	struct ptxed_memstream memstream;
+	char *text;
+	size_t size, idx;
+	int errcode;
+
+	errcode = ptxed_memstream_open(&memstream);
+	ptu_int_eq(errcode, 0);
+
+	for (idx = 0; idx < 100000; ++idx)
+		fputc('a' + (int) (idx % 26), memstream.file);
+
+	text = NULL;
+	size = 0;
+	errcode = ptxed_memstream_close(&memstream, &text, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, 100000);
+	ptu_ptr(text);
+
+	for (idx = 0; idx < size; ++idx) {
+		if (text[idx] != (char) ('a' + (int) (idx % 26)))
+			break;
+	}
+
+	free(text);
+
+	ptu_uint_eq(idx, size);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result reopen(void)
+{
+	struct ptxed_memstream memstream;
+	char *first, *second;
+	size_t size;
+	int errcode;
+
+	errcode = ptxed_memstream_open(&memstream);
+	ptu_int_eq(errcode, 0);
+
+	fputs("first", memstream.file);
+
+	first = NULL;
+	errcode = ptxed_memstream_close(&memstream, &first, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, 5);
+
+	errcode = ptxed_memstream_open(&memstream);
+	ptu_int_eq(errcode, 0);
+
+	fputs("second", memstream.file);
+
+	second = NULL;
+	errcode = ptxed_memstream_close(&memstream, &second, &size);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(size, 6);
+
+	/* Closing the second stream does not affect the first text. */
+	ptu_int_eq(memcmp(first, "first", 5), 0);
+	ptu_int_eq(memcmp(second, "second", 6), 0);
+
+	free(first);
+	free(second);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, null);
+	ptu_run(suite, not_open);
+	ptu_run(suite, empty);
+	ptu_run(suite, write_text);
+	ptu_run(suite, write_large);
+	ptu_run(suite, reopen);
+
+	return ptunit_report(&suite);
+}
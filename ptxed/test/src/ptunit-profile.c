@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "profile.h"
+
+#include "intel-pt.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+enum {
+	/* More entries than fit into the profile's initial hash table. */
+	pfix_nentries	= 4096
+};
+
+/* A test fixture. */
+struct profile_fixture {
+	/* The profile. */
+	struct ptxed_profile *profile;
+
+	/* A second profile to merge into @profile. */
+	struct ptxed_profile *other;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct profile_fixture *);
+	struct ptunit_result (*fini)(struct profile_fixture *);
+};
+
+static struct ptunit_result pfix_init(struct profile_fixture *pfix)
+{
+	pfix->profile = ptxed_profile_alloc();
+	ptu_ptr(pfix->profile);
+
+	pfix->other = ptxed_profile_alloc();
+	ptu_ptr(pfix->other);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pfix_fini(struct profile_fixture *pfix)
+{
+	ptxed_profile_free(pfix->other);
+	ptxed_profile_free(pfix->profile);
+
+	return ptu_passed();
+}
+
+/* Check that @profile prints as @expected. */
+static struct ptunit_result pfix_check(const struct ptxed_profile *profile,
+				       const char *expected)
+{
+	char buffer[1024];
+	size_t size;
+	FILE *stream;
+	int errcode;
+
+	stream = tmpfile();
+	ptu_ptr(stream);
+
+	errcode = ptxed_profile_print(stream, profile, "insn", NULL, 0ull);
+	rewind(stream);
+	size = fread(buffer, 1, sizeof(buffer) - 1, stream);
+	fclose(stream);
+
+	ptu_int_eq(errcode, 0);
+
+	buffer[size] = 0;
+	ptu_str_eq(buffer, expected);
+
+	return ptu_passed();
+}
+
+#define pfix_header							\
+	"insn:\n"							\
+	"            insn    share             count              time"	\
+	"  ip                section\n"
+
+#define pfix_sections							\
+	"\nsections:\n"							\
+	"            insn    share             count              time"	\
+	"  section\n"
+
+static struct ptunit_result null(void)
+{
+	struct ptxed_profile *profile;
+	int errcode;
+
+	profile = ptxed_profile_alloc();
+	ptu_ptr(profile);
+
+	errcode = ptxed_profile_add(NULL, 1, 0x1000ull, 1, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_add(profile, -1, 0x1000ull, 1, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_remove(NULL, 1, 0x1000ull, 1, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_merge(NULL, profile);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_merge(profile, NULL);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_print(NULL, profile, "insn", NULL, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_print(stdout, NULL, "insn", NULL, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_print(stdout, profile, NULL, NULL, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	ptxed_profile_free(profile);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct profile_fixture *pfix)
+{
+	ptu_check(pfix_check, pfix->profile, pfix_header pfix_sections);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 2, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->profile, 2, 0x2000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 2, 5ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(pfix_check, pfix->profile, pfix_header
+		  "               4   80.00%                 2"
+		  "                 8  0000000000001000  1\n"
+		  "               1   20.00%                 1"
+		  "                 1  0000000000002000  2\n"
+		  pfix_sections
+		  "               4   80.00%                 2"
+		  "                 8  1\n"
+		  "               1   20.00%                 1"
+		  "                 1  2\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_same_ip(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 1, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->profile, 2, 0x1000ull, 3, 0ull);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(pfix_check, pfix->profile, pfix_header
+		  "               3   75.00%                 1"
+		  "                 0  0000000000001000  2\n"
+		  "               1   25.00%                 1"
+		  "                 0  0000000000001000  1\n"
+		  pfix_sections
+		  "               3   75.00%                 1"
+		  "                 0  2\n"
+		  "               1   25.00%                 1"
+		  "                 0  1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result grow(struct profile_fixture *pfix)
+{
+	uint64_t ip;
+	int errcode;
+
+	for (ip = 0ull; ip < pfix_nentries; ++ip) {
+		errcode = ptxed_profile_add(pfix->profile, 1, ip, 1, 1ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	/* Add everything again to check that we still find all entries. */
+	for (ip = 0ull; ip < pfix_nentries; ++ip) {
+		errcode = ptxed_profile_add(pfix->profile, 1, ip, 1, 1ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	/* Remove all but the first entry. */
+	for (ip = 1ull; ip < pfix_nentries; ++ip) {
+		errcode = ptxed_profile_remove(pfix->profile, 1, ip, 1, 1ull);
+		ptu_int_eq(errcode, 0);
+
+		errcode = ptxed_profile_remove(pfix->profile, 1, ip, 1, 1ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_check(pfix_check, pfix->profile, pfix_header
+		  "               2  100.00%                 2"
+		  "                 2  0000000000000000  1\n"
+		  pfix_sections
+		  "               2  100.00%                 2"
+		  "                 2  1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result remove_entry(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 2, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x2000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x2000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	/* Entries that dropped to zero are not printed. */
+	ptu_check(pfix_check, pfix->profile, pfix_header
+		  "               2  100.00%                 1"
+		  "                 3  0000000000001000  1\n"
+		  pfix_sections
+		  "               2  100.00%                 1"
+		  "                 3  1\n");
+
+	return ptu_passed();
+}
+
+static struct ptunit_result remove_bad(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x1000ull, 1, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_remove(pfix->profile, 2, 0x1000ull, 1, 1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x1000ull, 2, 1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x1000ull, 1, 2ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x1000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_remove(pfix->profile, 1, 0x1000ull, 0, 0ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge(struct profile_fixture *pfix)
+{
+	int errcode;
+
+	errcode = ptxed_profile_add(pfix->profile, 1, 0x1000ull, 2, 3ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->other, 1, 0x1000ull, 2, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_add(pfix->other, 2, 0x2000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	/* Entries that dropped to zero are not merged. */
+	errcode = ptxed_profile_add(pfix->other, 2, 0x3000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_remove(pfix->other, 2, 0x3000ull, 1, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = ptxed_profile_merge(pfix->profile, pfix->other);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(pfix_check, pfix->profile, pfix_header
+		  "               4   80.00%                 2"
+		  "                 4  0000000000001000  1\n"
+		  "               1   20.00%                 1"
+		  "                 1  0000000000002000  2\n"
+		  pfix_sections
+		  "               4   80.00%                 2"
+		  "                 4  1\n"
+		  "               1   20.00%                 1"
+		  "                 1  2\n");
+
+	/* A merged-in zero entry cannot be removed. */
+	errcode = ptxed_profile_remove(pfix->profile, 2, 0x3000ull, 1, 1ull);
+	ptu_int_eq(errcode, -pte_internal);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_grow(struct profile_fixture *pfix)
+{
+	uint64_t ip;
+	int errcode;
+
+	for (ip = 0ull; ip < pfix_nentries; ++ip) {
+		errcode = ptxed_profile_add(pfix->other, 1, ip, 1, 0ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	errcode = ptxed_profile_merge(pfix->profile, pfix->other);
+	ptu_int_eq(errcode, 0);
+
+	/* Every entry must have been merged. */
+	for (ip = 0ull; ip < pfix_nentries; ++ip) {
+		errcode = ptxed_profile_remove(pfix->profile, 1, ip, 1, 0ull);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_check(pfix_check, pfix->profile, pfix_header pfix_sections);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct profile_fixture pfix;
+	struct ptunit_suite suite;
+
+	pfix.init = pfix_init;
+	pfix.fini = pfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, null);
+
+	ptu_run_f(suite, empty, pfix);
+	ptu_run_f(suite, add, pfix);
+	ptu_run_f(suite, add_same_ip, pfix);
+	ptu_run_f(suite, grow, pfix);
+	ptu_run_f(suite, remove_entry, pfix);
+	ptu_run_f(suite, remove_bad, pfix);
+	ptu_run_f(suite, merge, pfix);
+	ptu_run_f(suite, merge_grow, pfix);
+
+	return ptunit_report(&suite);
+}
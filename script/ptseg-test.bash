@@ -0,0 +1,234 @@
+#! /bin/bash
+#
+# Copyright (c) 2026, Intel Corporation
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+#  * Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#  * Neither the name of Intel Corporation nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# This script executes ptseg tests on ptt testfiles and checks the trace
+# segments found by ptseg against the PSB packets shown by ptdump.
+#
+# Tests with "opt:ptseg" options additionally run ptseg with those options and
+# compare its output followed by the shard manifests against the .exp(ptseg)
+# file generated by pttc.  The shards must join to the original trace.
+
+info() {
+	[[ $verbose != 0 ]] && echo -e "$@" >&2
+}
+
+run() {
+	info "$@"
+	"$@"
+}
+
+usage() {
+	cat <<EOF2
+usage: $0 [<options>] <pttfile>...
+
+options:
+  -h            this text
+  -v            print commands as they are executed
+  -g            specify the pttc command (default: pttc)
+  -d            specify the ptdump command (default: ptdump)
+  -s            specify the ptseg command (default: ptseg)
+
+  <pttfile>     annotated yasm file ending in .ptt
+EOF2
+}
+
+pttc_cmd=pttc
+ptdump_cmd=ptdump
+ptseg_cmd=ptseg
+verbose=0
+while getopts "hvg:d:s:" option; do
+	case $option in
+	h)
+		usage
+		exit 0
+		;;
+	v)
+		verbose=1
+		;;
+	g)
+		pttc_cmd=$OPTARG
+		;;
+	d)
+		ptdump_cmd=$OPTARG
+		;;
+	s)
+		ptseg_cmd=$OPTARG
+		;;
+	\?)
+		exit 1
+		;;
+	esac
+done
+
+shift $(($OPTIND-1))
+
+if [[ $# == 0 ]]; then
+	usage
+	exit 1
+fi
+
+# the exit status
+status=0
+
+fail() {
+	echo "$ptt: $@" >&2
+	status=1
+}
+
+# print the numbers given in hex (with or without 0x prefix) in decimal, one
+# per line
+to-dec() {
+	local num
+	for num in "$@"; do
+		echo $((16#${num#0x}))
+	done
+}
+
+# check that ptseg --all lists one segment per PSB starting at the PSB and
+# that the segments cover the trace from the first PSB to its end.
+check-all() {
+	local psbs begins ends size next idx
+
+	psbs=(`run "$ptdump_cmd" --no-pad "$pt" \
+		| sed -n 's/^\([0-9a-fA-F]*\)[ \t]*psb[ \t]*$/\1/p'`)
+	if [[ ${#psbs[@]} == 0 ]]; then
+		fail "no psb found by $ptdump_cmd"
+		return
+	fi
+
+	begins=(`run "$ptseg_cmd" --all "$pt" | sed 1d | awk '{ print $1 }'`)
+	ends=(`run "$ptseg_cmd" --all "$pt" | sed 1d | awk '{ print $2 }'`)
+
+	psbs=(`to-dec ${psbs[@]}`)
+	begins=(`to-dec ${begins[@]}`)
+	ends=(`to-dec ${ends[@]}`)
+
+	if [[ "${psbs[*]}" != "${begins[*]}" ]]; then
+		fail "ptseg --all segments begin at ${begins[*]}," \
+		     "ptdump shows psb at ${psbs[*]}"
+		return
+	fi
+
+	# the json list must agree
+	begins=(`run "$ptseg_cmd" --all --json "$pt" \
+		| sed -n 's/.*"begin": \([0-9]*\),.*/\1/p'`)
+
+	if [[ "${psbs[*]}" != "${begins[*]}" ]]; then
+		fail "ptseg --all --json segments begin at ${begins[*]}," \
+		     "ptdump shows psb at ${psbs[*]}"
+		return
+	fi
+
+	size=$((`wc -c < "$pt"`))
+	for ((idx = 0; idx < ${#ends[@]}; ++idx)); do
+		next=${psbs[$((idx + 1))]:-$size}
+		if [[ ${ends[$idx]} != $next ]]; then
+			fail "ptseg --all segment $idx ends at ${ends[$idx]}," \
+			     "expected $next"
+		fi
+	done
+}
+
+# print the ptseg options given in the ptt file
+ptt-ptseg-opts() {
+	sed -n 's/[ \t]*;[ \t]*opt:ptseg[ \t][ \t]*\(.*\)[ \t]*/\1/p' "$1"
+}
+
+# check ptseg --split and its manifests against the expected output and check
+# that the shards join to the trace.
+check-split() {
+	local opts exp out shards shard joined
+
+	opts=`ptt-ptseg-opts "$ptt"`
+	if [[ -z $opts ]]; then
+		return
+	fi
+
+	exp=$base-ptseg.exp
+	out=$base-ptseg.out
+	if [[ ! -f $exp ]]; then
+		fail "$exp not generated by $pttc_cmd"
+		return
+	fi
+
+	run "$ptseg_cmd" $opts "$pt" > "$out"
+	ret=$?
+	if [[ $ret != 0 ]]; then
+		fail "$ptseg_cmd $opts failed with $ret"
+		return
+	fi
+
+	shards=(`sed -n 's/^0x[0-9a-f]*-0x[0-9a-f]* (size: 0x[0-9a-f]*): //p' \
+		"$out"`)
+	if [[ ${#shards[@]} == 0 ]]; then
+		fail "$ptseg_cmd $opts wrote no shards"
+		return
+	fi
+
+	for shard in "${shards[@]}"; do
+		cat "${shard%.pt}.json" >> "$out"
+	done
+
+	run diff -ub "$exp" "$out"
+	if [[ $? != 0 ]]; then
+		fail "$ptseg_cmd $opts output differs from $exp"
+	fi
+
+	joined=$base-ptseg-joined.pt
+	cat "${shards[@]}" > "$joined"
+	run cmp "$pt" "$joined"
+	if [[ $? != 0 ]]; then
+		fail "$ptseg_cmd $opts shards do not join to $pt"
+	fi
+}
+
+run-ptseg-test() {
+	info "\n# run-ptseg-test $@"
+
+	ptt="$1"
+	base=`basename "${ptt%%.ptt}"`
+
+	# the trace file generated by pttc
+	pt=$base.pt
+
+	run "$pttc_cmd" "$ptt" > /dev/null
+	ret=$?
+	if [[ $ret != 0 ]]; then
+		fail "$pttc_cmd failed with $ret"
+		return
+	fi
+
+	check-all
+	check-split
+}
+
+for ptt in "$@"; do
+	run-ptseg-test "$ptt"
+done
+
+exit $status
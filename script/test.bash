@@ -135,6 +135,10 @@ ptt-ptxed-opts() {
 	sed -n 's/[ \t]*;[ \t]*opt:ptxed[ \t][ \t]*\(.*\)[ \t]*/\1/p' "$1"
 }
 
+ptt-ptxed-fails() {
+	grep -q '^[ \t]*;[ \t]*fail:ptxed[ \t]*$' "$1"
+}
+
 run-ptt-test() {
 	info "\n# run-ptt-test $@"
 
@@ -213,7 +217,17 @@ run-ptt-test() {
 			fi
 			local opts=`ptt-ptxed-opts "$ptt"`
 			opts+=" --no-inst --check"
-			run "$ptxed_cmd" $ptxed_arg --raw $bin:$addr $cpu $opts --pt $pt $sb > $out
+			if ptt-ptxed-fails "$ptt"; then
+				# ptxed is expected to fail - its diagnostics are
+				# part of the output
+				run "$ptxed_cmd" $ptxed_arg --raw $bin:$addr $cpu $opts --pt $pt $sb 2>&1 \
+					| sed "s#^$ptxed_cmd:#ptxed:#" > $out
+				if [[ ${PIPESTATUS[0]} == 0 ]]; then
+					echo "$ptt: $ptxed_cmd did not fail" >> $out
+				fi
+			else
+				run "$ptxed_cmd" $ptxed_arg --raw $bin:$addr $cpu $opts --pt $pt $sb > $out
+			fi
 			;;
 		ptdump)
 			local opts=`ptt-ptdump-opts "$ptt"`
@@ -0,0 +1,228 @@
+#! /bin/bash
+#
+# Copyright (c) 2026, Intel Corporation
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+#  * Redistributions of source code must retain the above copyright notice,
+#    this list of conditions and the following disclaimer.
+#  * Redistributions in binary form must reproduce the above copyright notice,
+#    this list of conditions and the following disclaimer in the documentation
+#    and/or other materials provided with the distribution.
+#  * Neither the name of Intel Corporation nor the names of its contributors
+#    may be used to endorse or promote products derived from this software
+#    without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+#
+# This script decodes the trace of ptt testfiles with ptxed sequentially and
+# on multiple threads and checks that the output is the same.
+
+info() {
+	[[ $verbose != 0 ]] && echo -e "$@" >&2
+}
+
+run() {
+	info "$@"
+	"$@"
+}
+
+asm2addr() {
+	local line
+	line=`grep -i ^org "$1"`
+	[[ $? != 0 ]] && return $?
+	echo $line | sed "s/org *//"
+}
+
+usage() {
+	cat <<EOF2
+usage: $0 [<options>] <pttfile>...
+
+options:
+  -h            this text
+  -v            print commands as they are executed
+  -g            specify the pttc command (default: pttc)
+  -x            specify the ptxed command (default: ptxed)
+  -n n[,n]      comma-separated list of thread counts (default: 2,4)
+
+  <pttfile>     annotated yasm file ending in .ptt
+EOF2
+}
+
+pttc_cmd=pttc
+ptxed_cmd=ptxed
+nthreads="2 4"
+verbose=0
+while getopts "hvg:x:n:" option; do
+	case $option in
+	h)
+		usage
+		exit 0
+		;;
+	v)
+		verbose=1
+		;;
+	g)
+		pttc_cmd=$OPTARG
+		;;
+	x)
+		ptxed_cmd=$OPTARG
+		;;
+	n)
+		nthreads=`echo $OPTARG | sed "s/,/ /g"`
+		;;
+	\?)
+		exit 1
+		;;
+	esac
+done
+
+shift $(($OPTIND-1))
+
+if [[ $# == 0 ]]; then
+	usage
+	exit 1
+fi
+
+# the ptxed options to compare the sequential and the parallel decode with
+modes=(
+	""
+	"--insn-decoder"
+	"--block:show-blocks"
+	"--block:show-blocks --stat"
+	"--check"
+	"--stat --quiet"
+	"--insn-decoder --stat --quiet"
+	"--profile"
+	"--block:end-on-call --profile"
+	"--insn-decoder --profile --quiet"
+	"--time --event:time"
+	"--insn-decoder --time"
+)
+
+# the exit status
+status=0
+
+fail() {
+	echo "$ptt: $@" >&2
+	status=1
+}
+
+ptt-ptxed-opts() {
+	sed -n 's/[ \t]*;[ \t]*opt:ptxed[ \t][ \t]*\(.*\)[ \t]*/\1/p' "$1"
+}
+
+ptt-cpus() {
+	sed -n 's/[ \t]*;[ \t]*cpu[ \t][ \t]*\(.*\)[ \t]*/\1/p' "$1"
+}
+
+run-threads-test() {
+	info "\n# run-threads-test $@"
+
+	ptt="$1"
+	cpu="$2"
+	base=`basename "${ptt%%.ptt}"`
+
+	if [[ -n "$cpu" ]]; then
+		cpu="--cpu $cpu"
+	fi
+
+	# the following are the files that are generated by pttc
+	pt=$base.pt
+	bin=$base.bin
+
+	files=`run "$pttc_cmd" $cpu "$ptt"`
+	ret=$?
+	if [[ $ret != 0 ]]; then
+		fail "$pttc_cmd $cpu failed with $ret"
+		return
+	fi
+
+	# the sideband files are named after the ptxed options to load them
+	local sb=""
+	for file in $files; do
+		case $file in
+		*.sb)
+			sb_base=${file%.sb}
+			sb_part=${sb_base#$base-}
+			sb_prefix=${sb_part%%,*}
+			sb_options=${sb_part#$sb_prefix}
+			sb_prio=${sb_prefix##*-}
+			sb_prefix2=${sb_prefix%-$sb_prio}
+			sb_format=${sb_prefix2##*-}
+
+			sb+=`echo $sb_options | sed -e "s/,/ --$sb_format:/g" -e "s/=/ /g"`
+			sb+=" --$sb_format:$sb_prio $file"
+			;;
+		esac
+	done
+
+	addr=`asm2addr "$ptt"`
+	if [[ $? != 0 ]]; then
+		fail "org directive not found in test file"
+		return
+	fi
+
+	local opts=`ptt-ptxed-opts "$ptt"`
+	local serial=$base-serial.out
+	local parallel=$base-threads.out
+	local mode n sstat pstat
+
+	for mode in "${modes[@]}"; do
+		run "$ptxed_cmd" --raw $bin:$addr $cpu $opts $sb $mode \
+			--pt $pt > $serial 2>&1
+		sstat=$?
+
+		for n in $nthreads; do
+			run "$ptxed_cmd" --raw $bin:$addr $cpu $opts $sb \
+				$mode --threads $n --pt $pt > $parallel 2>&1
+			pstat=$?
+
+			# some options are not supported with --threads
+			if grep -q "does not support" $parallel; then
+				info "$ptt: skipping '$mode' with --threads $n"
+				continue
+			fi
+
+			if [[ $sstat != $pstat ]]; then
+				fail "'$cpu $mode' exit status $pstat with" \
+				     "--threads $n, $sstat without"
+			fi
+
+			if ! run diff -u $serial $parallel; then
+				fail "'$cpu $mode' output differs with" \
+				     "--threads $n"
+			fi
+		done
+	done
+}
+
+run-threads-tests() {
+	local ptt="$1"
+	local cpu
+
+	# run the test without any cpu settings and for each cpu directive in
+	# the pttfile.
+	run-threads-test "$ptt"
+
+	for cpu in `ptt-cpus "$ptt"`; do
+		run-threads-test "$ptt" $cpu
+	done
+}
+
+for ptt in "$@"; do
+	run-threads-tests "$ptt"
+done
+
+exit $status
@@ -29,9 +29,14 @@
 #ifndef PT_SB_CONTEXT_H
 #define PT_SB_CONTEXT_H
 
+#include "pt_hash.h"
+
 #include <stdint.h>
 
 struct pt_image;
+struct pt_image_pool;
+struct pt_sb_session;
+struct pt_sb_path;
 
 
 /* The ABI of the process. */
@@ -43,16 +48,13 @@ enum pt_sb_abi {
 };
 
 struct pt_sb_context {
-	/* The next context in a linear list of process contexts.
-	 *
-	 * I do not expect more than a few processes per tracing session.  And
-	 * if we had many processes, we'd also have trace spanning many context
-	 * switches and sideband decode won't be the bottleneck.
+	/* The node in the sideband tracing session's context hash table -
+	 * keyed by @pid.
 	 *
 	 * This field is owned by the sideband tracing session to which this
 	 * context belongs.
 	 */
-	struct pt_sb_context *next;
+	struct pt_hash_node node;
 
 	/* The memory image of that process.
 	 *
@@ -87,13 +89,26 @@ struct pt_sb_context {
 /* Allocate a context.
  *
  * Allocate a context and an image.  The optional @name argument is given to the
- * context's image.
+ * context's image.  The image is allocated from the optional @pool.
  *
  * The context's use-count is initialized to one.  Use pt_sb_ctx_put() to free
  * the returned context and its image.
  *
  * Returns a non-NULL context or NULL when out of memory.
  */
-extern struct pt_sb_context *pt_sb_ctx_alloc(const char *name);
+extern struct pt_sb_context *pt_sb_ctx_alloc(const char *name,
+					     struct pt_image_pool *pool);
+
+/* Map a section of a cached file into a context's image.
+ *
+ * Same as pt_sb_ctx_mmap() but looks up the image section identifier in
+ * @session's path cache and adds it on a miss.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_ctx_mmap_path(struct pt_sb_session *session,
+			       struct pt_sb_context *context,
+			       const struct pt_sb_path *path, uint64_t offset,
+			       uint64_t size, uint64_t vaddr);
 
 #endif /* PT_SB_CONTEXT_H */
@@ -30,18 +30,34 @@
 #define PT_SB_DECODER_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 
 /* An Intel PT sideband decoder. */
 struct pt_sb_decoder {
 	/* The next Intel PT sideband decoder in a linear list of Intel PT
-	 * sideband decoders ordered by @tsc (ascending).
+	 * sideband decoders.
 	 */
 	struct pt_sb_decoder *next;
 
 	/* The timestamp of the next sideband record. */
 	uint64_t tsc;
 
+	/* The sequence number of the decoder's most recent insertion into the
+	 * session's decoder heap.
+	 *
+	 * Among decoders with equal @tsc, the most recently inserted decoder
+	 * comes first.
+	 */
+	uint64_t seq;
+
+	/* The position at which the decoder has been added to its session.
+	 *
+	 * This identifies corresponding decoders in sessions that have been
+	 * set up identically.
+	 */
+	uint32_t id;
+
 	/* Decoder functions provided by the decoder supplier:
 	 *
 	 * - fetch the next sideband record.
@@ -59,11 +75,46 @@ struct pt_sb_decoder {
 	/* - destroy the decoder's private data. */
 	void (*dtor)(void *priv);
 
+	/* - save the decoder's state for a checkpoint (optional). */
+	int (*save)(struct pt_sb_session *session, void **state, void *priv);
+
+	/* - restore the decoder's state from a checkpoint (optional). */
+	int (*restore)(struct pt_sb_session *session, const void *state,
+		       void *priv);
+
+	/* - free a saved state (optional). */
+	void (*free_state)(void *state);
+
 	/* Decoder-specific private data. */
 	void *priv;
 
+	/* The next Intel PT sideband decoder in the session's list of decoders
+	 * that requested the next event.
+	 */
+	struct pt_sb_decoder *next_request;
+
 	/* A flag saying whether this is a primary or secondary decoder. */
 	uint32_t primary:1;
+
+	/* A flag saying whether the decoder requests events explicitly.
+	 *
+	 * If clear, the decoder is presented all events.
+	 */
+	uint32_t on_request:1;
+
+	/* A flag saying whether the decoder is on the session's list of
+	 * decoders that requested the next event.
+	 */
+	uint32_t requested:1;
+
+	/* A flag saying whether the decoder has been removed.
+	 *
+	 * Removed decoders may still be on the session's list of decoders that
+	 * requested the next event or in the session's decoder heap.  They are
+	 * skipped and moved to the session's list of removed decoders when
+	 * they are found.
+	 */
+	uint32_t removed:1;
 };
 
 #endif /* PT_SB_DECODER_H */
@@ -30,6 +30,7 @@
 #define PT_SB_FILE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 
 /* Load a file section.
@@ -44,4 +45,62 @@
 extern int pt_sb_file_load(void **buffer, size_t *size, const char *filename,
 			   size_t begin, size_t end);
 
+
+/* A read-only view of a file section. */
+struct pt_sb_file_mapping {
+	/* The memory containing the file section.
+	 *
+	 * This is either a file mapping or a heap allocation, depending on
+	 * @mapped.
+	 */
+	void *base;
+
+	/* The size of @base in bytes. */
+	size_t size;
+
+	/* The begin and end of the requested file section inside @base. */
+	const uint8_t *begin, *end;
+
+	/* A flag saying whether @base was mapped or allocated. */
+	uint32_t mapped:1;
+};
+
+/* Map a file section.
+ *
+ * Maps the contents of @file from @begin to @end read-only into memory.  If
+ * @end is zero, maps from @begin until the end of @file.
+ *
+ * Falls back to loading the file section into an allocated buffer if the file
+ * cannot be mapped.
+ *
+ * On success, provides the file section in @mapping.  The caller is
+ * responsible for releasing it using pt_sb_file_unmap().
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_file_map(struct pt_sb_file_mapping *mapping,
+			  const char *filename, size_t begin, size_t end);
+
+/* Release a file section mapped by pt_sb_file_map().
+ *
+ * Does nothing if @mapping is NULL or empty.
+ */
+extern void pt_sb_file_unmap(struct pt_sb_file_mapping *mapping);
+
+
+/* The following functions are implemented per operating system. */
+
+/* Map a file section using the operating system's file mapping facility.
+ *
+ * Same as pt_sb_file_map() but does not fall back to loading the file section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ * Returns -pte_not_supported if the file section cannot be mapped.
+ */
+extern int pt_sb_file_mmap(struct pt_sb_file_mapping *mapping,
+			   const char *filename, size_t begin, size_t end);
+
+/* Release a file mapping created by pt_sb_file_mmap(). */
+extern void pt_sb_file_munmap(struct pt_sb_file_mapping *mapping);
+
 #endif /* PT_SB_FILE_H */
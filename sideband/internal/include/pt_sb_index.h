@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SB_INDEX_H
+#define PT_SB_INDEX_H
+
+#include "pt_sb_context.h"
+
+#include <stdint.h>
+
+struct pt_image;
+struct pt_image_pool;
+
+
+/* A process context at a checkpoint. */
+struct pt_sb_checkpoint_context {
+	/* The context's memory image.
+	 *
+	 * It shares the sections of the context's image at the time the
+	 * checkpoint was taken.  The context's image copies them on its
+	 * next change.
+	 */
+	struct pt_image *image;
+
+	/* The ABI of the process. */
+	enum pt_sb_abi abi;
+
+	/* The process id. */
+	uint32_t pid;
+};
+
+/* A sideband decoder's state at a checkpoint. */
+struct pt_sb_checkpoint_decoder {
+	/* The state provided by the decoder's @save callback. */
+	void *state;
+
+	/* The decoder's function for freeing @state. */
+	void (*free_state)(void *state);
+
+	/* The decoder's position in its session. */
+	uint32_t id;
+};
+
+/* A checkpoint of a tracing session. */
+struct pt_sb_checkpoint {
+	/* The timestamp at which the checkpoint was taken.
+	 *
+	 * All sideband records up to and including this timestamp have been
+	 * applied.
+	 */
+	uint64_t tsc;
+
+	/* The kernel image. */
+	struct pt_image *kernel;
+
+	/* The process contexts in no particular order. */
+	struct pt_sb_checkpoint_context *contexts;
+
+	/* The sideband decoders ordered by their @id. */
+	struct pt_sb_checkpoint_decoder *decoders;
+
+	/* The number of @contexts and @decoders, respectively. */
+	uint32_t ncontexts;
+	uint32_t ndecoders;
+};
+
+struct pt_sb_index {
+	/* The number of decoders in the indexed session. */
+	uint32_t ndecoders;
+
+	/* The checkpoints ordered by their @tsc. */
+	struct pt_sb_checkpoint *checkpoints;
+
+	/* The number of @checkpoints. */
+	uint32_t ncheckpoints;
+
+	/* The capacity of @checkpoints. */
+	uint32_t capacity;
+
+	/* The pool for checkpoint images.
+	 *
+	 * Checkpoint images do not use the session's pool so an index does
+	 * not occupy slots in it.  They share the session images' section
+	 * lists, which hold their own pool references.
+	 */
+	struct pt_image_pool *pool;
+};
+
+#endif /* PT_SB_INDEX_H */
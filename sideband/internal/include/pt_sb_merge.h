@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SB_MERGE_H
+#define PT_SB_MERGE_H
+
+#include "libipt-sb.h"
+
+#include "intel-pt.h"
+
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif /* defined(FEATURE_THREADS) */
+
+#include <stdint.h>
+
+
+enum {
+	/* The default number of records in a trace stream's ring. */
+	pt_sb_merge_capacity	= 256
+};
+
+/* A decoded block, event, or error.
+ *
+ * Nothing follows a trace stream's last record.  A last ptsm_error record with
+ * error code -pte_eos marks the end of a trace stream and is not provided.
+ */
+struct pt_sb_merge_record {
+	/* The type of the record. */
+	enum pt_sb_merge_type type;
+
+	/* The error code for ptsm_error records. */
+	int errcode;
+
+	/* The time by which the record is ordered. */
+	uint64_t tsc;
+
+	/* The trace offset at which the record has been decoded. */
+	uint64_t offset;
+
+	/* A flag saying whether this is the last record of its stream. */
+	uint32_t last:1;
+
+	/* The decoded block or event depending on @type. */
+	union {
+		struct pt_block block;
+		struct pt_event event;
+	} variant;
+};
+
+/* A trace stream.
+ *
+ * Records are decoded into a bounded ring.  The producer decodes records at
+ * @tail; the merge consumes records at @head.  Both indices grow
+ * monotonically and are masked when accessing @ring.
+ *
+ * When decoding on a separate thread, the producer owns the free slots and the
+ * consumer owns the published slots, like the perf event sideband prefetch
+ * ring.  The lock only protects @head, @tail, @stop, and @exited.
+ *
+ * Once the decoder thread exited, the consumer owns all slots.
+ */
+struct pt_sb_merge_stream {
+	/* The block decoder for this trace stream. */
+	struct pt_block_decoder *decoder;
+
+	/* The optional tracing session providing memory images. */
+	struct pt_sb_session *session;
+
+	/* The index of this stream and its cpu. */
+	uint32_t index;
+	uint32_t cpu;
+
+	/* The producer's decode state:
+	 *
+	 * - the decoder's status flags or a negative error code if the
+	 *   decoder needs to synchronize.
+	 *
+	 * - an error to report after the partial block preceding it.
+	 *
+	 * - the time of the last record.
+	 *
+	 * - the offset of the last synchronization to detect that we are no
+	 *   longer making progress.
+	 *
+	 * - whether we reached the end of the trace.
+	 */
+	int status;
+	int errcode;
+	uint64_t tsc;
+	uint64_t sync;
+	uint32_t done:1;
+
+	/* The ring of decoded records and its size minus one. */
+	struct pt_sb_merge_record *ring;
+	uint32_t mask;
+
+	/* The number of records to decode or to consume before publishing
+	 * them to the respective other side.
+	 */
+	uint32_t batch;
+
+	/* The index of the first record not yet released by the consumer. */
+	uint32_t head;
+
+	/* The index of the first record not yet published by the producer. */
+	uint32_t tail;
+
+	/* The consumer's index of the next record to consume and the number
+	 * of published records available to it.
+	 */
+	uint32_t next;
+	uint32_t available;
+
+#if defined(FEATURE_THREADS)
+	/* A flag saying whether the decoder thread has been started. */
+	uint32_t started:1;
+
+	/* A flag telling the decoder thread to terminate. */
+	uint32_t stop:1;
+
+	/* The decoder thread's status and a flag saying whether it exited.
+	 *
+	 * This is not a bit-field as it is written by the decoder thread.
+	 */
+	int exit_status;
+	uint32_t exited;
+
+	/* The lock protecting @head, @tail, @stop, and @exited. */
+	mtx_t lock;
+
+	/* Signaled when records are published and when slots are released,
+	 * respectively.
+	 */
+	cnd_t published;
+	cnd_t released;
+
+	/* The decoder thread. */
+	thrd_t thread;
+#endif /* defined(FEATURE_THREADS) */
+};
+
+struct pt_sb_merge {
+	/* The trace streams in the order in which they were added. */
+	struct pt_sb_merge_stream **streams;
+
+	/* The number of @streams. */
+	uint32_t nstreams;
+
+	/* The trace streams that have not ended, yet, as binary min-heap
+	 * ordered by the time of their next record.
+	 */
+	struct pt_sb_merge_stream **heap;
+
+	/* The number of streams in @heap. */
+	uint32_t nheap;
+
+	/* The number of records in each stream's ring.
+	 *
+	 * This is a power of two.
+	 */
+	uint32_t capacity;
+
+	/* The number of records to decode or to consume before publishing
+	 * them to the respective other side.
+	 */
+	uint32_t batch;
+
+	/* A flag saying whether to decode streams on separate threads. */
+	uint32_t threads:1;
+
+	/* A flag saying whether decoding has started. */
+	uint32_t started:1;
+
+	/* A flag saying whether the record at the top of @heap has been
+	 * provided and is to be consumed on the next call.
+	 */
+	uint32_t pending:1;
+};
+
+#endif /* PT_SB_MERGE_H */
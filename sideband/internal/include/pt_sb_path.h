@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SB_PATH_H
+#define PT_SB_PATH_H
+
+#include "pt_sb_context.h"
+#include "pt_hash.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* A file referenced in sideband records. */
+struct pt_sb_path {
+	/* The hash table node - keyed by the sysroot and filename. */
+	struct pt_hash_node node;
+
+	/* The resolved path.
+	 *
+	 * This is the sysroot followed by the filename given in the sideband
+	 * record.
+	 */
+	char *path;
+
+	/* The length of the sysroot prefix in @path. */
+	size_t prefix;
+
+	/* The ABI of the file if @has_abi is set. */
+	enum pt_sb_abi abi;
+
+	/* A flag saying whether we already determined @abi.
+	 *
+	 * Files that cannot be opened or that are not ELF files have an
+	 * unknown ABI.
+	 */
+	uint32_t has_abi:1;
+};
+
+/* A file section in the image section cache. */
+struct pt_sb_path_section {
+	/* The hash table node - keyed by @path, @offset, @size, and @vaddr. */
+	struct pt_hash_node node;
+
+	/* The file containing the section. */
+	const struct pt_sb_path *path;
+
+	/* The offset and size of the section in @path. */
+	uint64_t offset;
+	uint64_t size;
+
+	/* The virtual address at which the section is loaded. */
+	uint64_t vaddr;
+
+	/* The section's image section identifier. */
+	int isid;
+};
+
+/* A cache of files referenced in sideband records.
+ *
+ * Processes map the same few files over and over again.  This caches the
+ * result of resolving filenames and of determining their ABI as well as the
+ * image section identifiers of their sections so repeated mappings need
+ * neither file I/O nor a search of the image section cache.
+ *
+ * Image section identifiers are only valid as long as the image section cache
+ * is not cleared.  Users validate them before use.
+ */
+struct pt_sb_path_cache {
+	/* The cached paths. */
+	struct pt_hash_table paths;
+
+	/* The cached image sections. */
+	struct pt_hash_table sections;
+};
+
+
+/* Initialize/finalize a sideband path cache. */
+extern void pt_sb_path_cache_init(struct pt_sb_path_cache *cache);
+extern void pt_sb_path_cache_fini(struct pt_sb_path_cache *cache);
+
+/* Get the cached path for a file.
+ *
+ * Looks up @filename relative to @sysroot in @cache and adds it if it is not
+ * found.  The @sysroot argument may be NULL.
+ *
+ * On success, provides the path in @path.  It remains valid as long as @cache.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_path_get(struct pt_sb_path **path,
+			  struct pt_sb_path_cache *cache, const char *sysroot,
+			  const char *filename);
+
+/* Find the image section identifier of a cached section.
+ *
+ * Returns a positive isid if @cache contains a section of @size bytes at
+ * @offset in @path loaded at @vaddr.
+ * Returns zero if no such section is found.
+ * Returns a negative error code otherwise.
+ */
+extern int pt_sb_path_find_isid(const struct pt_sb_path_cache *cache,
+				const struct pt_sb_path *path, uint64_t offset,
+				uint64_t size, uint64_t vaddr);
+
+/* Add an image section identifier to the cache.
+ *
+ * Remembers @isid for a section of @size bytes at @offset in @path loaded at
+ * @vaddr.  This replaces a previously remembered isid for that section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+extern int pt_sb_path_add_isid(struct pt_sb_path_cache *cache,
+			       const struct pt_sb_path *path, uint64_t offset,
+			       uint64_t size, uint64_t vaddr, int isid);
+
+#endif /* PT_SB_PATH_H */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PT_SB_PERF_DATA_H
+#define PT_SB_PERF_DATA_H
+
+#include "pt_sb_file.h"
+
+#include "pevent.h"
+
+#include <stdint.h>
+
+
+/* The trace in an AUXTRACE record. */
+struct pt_sb_perf_data_chunk {
+	/* The trace in the mapped perf.data file. */
+	const uint8_t *begin, *end;
+
+	/* The AUX area mmap index of the trace buffer. */
+	uint32_t idx;
+};
+
+/* The records of one cpu in a perf.data file's data section. */
+struct pt_sb_perf_data_cpu {
+	/* The offsets of the records from the beginning of the data section
+	 * in ascending order.
+	 */
+	uint64_t *offsets;
+
+	/* The number of @offsets and the capacity of @offsets. */
+	uint32_t noffsets, coffsets;
+
+	/* The cpu or UINT32_MAX for records that are not associated with a
+	 * cpu.
+	 */
+	uint32_t cpu;
+};
+
+/* An AUX area trace buffer. */
+struct pt_sb_perf_data_aux {
+	/* The trace.
+	 *
+	 * This is NULL until requested if the trace is split over several
+	 * chunks.
+	 */
+	const uint8_t *begin, *end;
+
+	/* The concatenated trace of several chunks or NULL. */
+	uint8_t *buffer;
+
+	/* The total size of the trace in bytes. */
+	uint64_t size;
+
+	/* The AUX area mmap index. */
+	uint32_t idx;
+
+	/* The cpu on which the trace has been recorded or UINT32_MAX. */
+	uint32_t cpu;
+
+	/* The number of chunks in this buffer. */
+	uint32_t nchunks;
+};
+
+struct pt_sb_perf_data {
+	/* The perf.data filename.
+	 *
+	 * This is a copy of the filename provided by the user when opening
+	 * the file.
+	 */
+	char *filename;
+
+	/* The mapped perf.data file. */
+	struct pt_sb_file_mapping mapping;
+
+	/* The parsed perf.data file. */
+	struct pev_file file;
+
+	/* The data section as file offsets. */
+	size_t begin, end;
+
+	/* The cpus with records in the data section in ascending order.
+	 *
+	 * Records without a cpu are collected last.  Records synthesized by
+	 * perf are not collected.
+	 */
+	struct pt_sb_perf_data_cpu *cpus;
+
+	/* The number of @cpus. */
+	uint32_t ncpus;
+
+	/* The trace chunks in file order. */
+	struct pt_sb_perf_data_chunk *chunks;
+
+	/* The number of @chunks and the capacity of @chunks. */
+	uint32_t nchunks, cchunks;
+
+	/* The trace buffers in ascending order of their index. */
+	struct pt_sb_perf_data_aux *aux;
+
+	/* The number of @aux. */
+	uint32_t naux;
+};
+
+#endif /* PT_SB_PERF_DATA_H */
@@ -29,8 +29,17 @@
 #ifndef PT_SB_PEVENT_H
 #define PT_SB_PEVENT_H
 
+#include "pt_sb_file.h"
+
 #include "pevent.h"
 
+#if defined(FEATURE_THREADS)
+#  include <threads.h>
+#endif /* defined(FEATURE_THREADS) */
+
+struct pt_sb_session;
+struct pt_sb_pevent_config;
+
 
 /* The estimated code location. */
 enum pt_sb_pevent_loc {
@@ -50,6 +59,118 @@ enum pt_sb_pevent_loc {
 	ploc_likely_in_user
 };
 
+#if defined(FEATURE_THREADS)
+
+/* A pre-decoded perf event record. */
+struct pt_sb_pevent_record {
+	/* The perf event record.
+	 *
+	 * It points into the sideband data in memory, which outlives the
+	 * prefetch thread.
+	 */
+	struct pev_event event;
+
+	/* The position of @event in the sideband data. */
+	const uint8_t *pos;
+
+	/* The size of @event in bytes on success, a negative error code
+	 * otherwise.
+	 *
+	 * The prefetch thread stops after the first error.
+	 */
+	int status;
+};
+
+enum {
+	/* The number of records in the prefetch ring. */
+	pt_sb_pevent_prefetch_size	= 256,
+
+	/* The number of records to parse or to consume before publishing
+	 * them to the respective other side.
+	 */
+	pt_sb_pevent_prefetch_batch	= 64
+};
+
+/* A bounded ring of records parsed ahead on a separate thread.
+ *
+ * The prefetch thread produces records at @tail; the sideband decoder
+ * consumes records at @head.  Both indices grow monotonically and are
+ * reduced modulo the ring size when accessing @ring.
+ *
+ * The producer owns the free slots and the consumer owns the published
+ * slots so neither needs the lock while working on a slot.  The lock only
+ * protects @head, @tail, and @stop.
+ */
+struct pt_sb_pevent_prefetch {
+	/* The pre-decoded records. */
+	struct pt_sb_pevent_record ring[pt_sb_pevent_prefetch_size];
+
+	/* The index of the first record not yet released by the consumer. */
+	uint32_t head;
+
+	/* The index of the first record not yet published by the producer. */
+	uint32_t tail;
+
+	/* The consumer's index of the next record to consume and the number
+	 * of published records available to it.
+	 *
+	 * Only the consumer accesses these fields.
+	 */
+	uint32_t next;
+	uint32_t available;
+
+	/* The prefetch thread's exit status.
+	 *
+	 * This is only valid if @exited is set.
+	 */
+	int exit_status;
+
+	/* A flag saying that the prefetch thread exited.
+	 *
+	 * The prefetch thread does not access the ring after setting it.
+	 */
+	uint32_t exited;
+
+	/* A flag telling the prefetch thread to terminate. */
+	uint32_t stop:1;
+
+	/* The lock protecting @head, @tail, @exit_status, @exited, and
+	 * @stop.
+	 */
+	mtx_t lock;
+
+	/* Signaled when records are published and when slots are released,
+	 * respectively.
+	 */
+	cnd_t published;
+	cnd_t released;
+
+	/* The prefetch thread. */
+	thrd_t thread;
+};
+
+#endif /* defined(FEATURE_THREADS) */
+
+/* The state of a perf event sideband decoder at a checkpoint. */
+struct pt_sb_pevent_state {
+	/* The offset of the next record to fetch from the beginning of the
+	 * sideband data.
+	 */
+	uint64_t offset;
+
+	/* The pid of the current process context. */
+	uint32_t pid;
+
+	/* The pid of the next process context. */
+	uint32_t next_pid;
+
+	/* A flag saying whether there is a current process context. */
+	uint32_t has_context:1;
+
+	/* A flag saying whether there is a pending context switch. */
+	uint32_t has_next_context:1;
+};
+
 /* A Linux perf event decoder's private data. */
 struct pt_sb_pevent_priv {
 	/* The sideband filename for printing.
@@ -96,8 +217,15 @@ struct pt_sb_pevent_priv {
 	 */
 	char *vdso_ia32;
 
+	/* The mapped sideband file.
+	 *
+	 * This is empty if @perf_data is set.  The sideband data is then
+	 * owned by the perf.data file.
+	 */
+	struct pt_sb_file_mapping mapping;
+
 	/* The begin and end of the sideband data in memory. */
-	uint8_t *begin, *end;
+	const uint8_t *begin, *end;
 
 	/* The position of the current and the next record in the sideband
 	 * buffer.
@@ -110,9 +238,18 @@ struct pt_sb_pevent_priv {
 	/* The libpevent configuration. */
 	struct pev_config pev;
 
+	/* The libpevent reader plan compiled from @pev. */
+	struct pev_plan plan;
+
 	/* The current perf event record. */
 	struct pev_event event;
 
+	/* The records parsed ahead on a separate thread.
+	 *
+	 * This is NULL if records are parsed on demand.
+	 */
+	struct pt_sb_pevent_prefetch *prefetch;
+
 	/* The current process context.
 	 *
 	 * This is NULL if there is no current context.
@@ -147,9 +284,58 @@ struct pt_sb_pevent_priv {
 
 	/* The current code location estimated from previous events. */
 	enum pt_sb_pevent_loc location;
+
+	/* A flag saying whether this is a primary decoder.
+	 *
+	 * Primary decoders track the code location and postpone context
+	 * switches, which requires them to see every event.
+	 */
+	uint32_t primary:1;
+
+	/* A flag saying whether the sideband data is the data section of a
+	 * perf.data file.
+	 *
+	 * It interleaves the records of all cpus with records synthesized by
+	 * perf and with the AUX area trace.  We skip all records but those
+	 * for @cpu.
+	 */
+	uint32_t perf_data:1;
+
+	/* The cpu whose records to read from a perf.data file.
+	 *
+	 * This is UINT32_MAX for records that are not associated with a cpu.
+	 */
+	uint32_t cpu;
+
+	/* The offsets of @cpu's records from @begin in ascending order.
+	 *
+	 * This is NULL unless @perf_data is set.  It allows going directly
+	 * to the next of our records instead of reading the records of all
+	 * other cpus.  The offsets are owned by the perf.data file.
+	 */
+	const uint64_t *offsets;
+
+	/* The number of @offsets. */
+	uint32_t noffsets;
 };
 
 extern int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
 			     const struct pt_sb_pevent_config *config);
 
+/* Allocate a perf event sideband decoder for a perf.data file.
+ *
+ * Like pt_sb_alloc_pevent_decoder() but the decoder reads the perf.data data
+ * section in [@begin; @end) and only reads the records of @cpu.  Those records
+ * are located at the @noffsets @offsets from @begin.
+ *
+ * The data section and @offsets are not copied.  They must remain valid until
+ * the decoder is freed.
+ */
+extern int
+pt_sb_alloc_perf_data_decoder(struct pt_sb_session *session,
+			      const struct pt_sb_pevent_config *config,
+			      uint32_t cpu, const uint8_t *begin,
+			      const uint8_t *end, const uint64_t *offsets,
+			      uint32_t noffsets);
+
 #endif /* PT_SB_PEVENT_H */
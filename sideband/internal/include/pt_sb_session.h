@@ -29,6 +29,8 @@
 #ifndef PT_SB_SESSION_H
 #define PT_SB_SESSION_H
 
+#include "pt_sb_path.h"
+
 #include "libipt-sb.h"
 
 struct pt_image_section_cache;
@@ -44,8 +46,8 @@ struct pt_sb_session {
 	 */
 	struct pt_image_section_cache *iscache;
 
-	/* A linear list of contexts in no particular order. */
-	struct pt_sb_context *contexts;
+	/* A hash table of contexts keyed by pid. */
+	struct pt_hash_table contexts;
 
 	/* The kernel memory image.
 	 *
@@ -56,8 +58,35 @@ struct pt_sb_session {
 	 */
 	struct pt_image *kernel;
 
-	/* A list of sideband decoders ordered by their @tsc (ascending). */
-	struct pt_sb_decoder *decoders;
+	/* A cache of files referenced in sideband records.
+	 *
+	 * It is shared by all sideband decoders in this session.
+	 */
+	struct pt_sb_path_cache paths;
+
+	/* The pool from which the kernel and process images are allocated.
+	 *
+	 * Each image holds a reference to the pool so contexts may outlive the
+	 * session.  Using a single pool allows images to share sections.
+	 */
+	struct pt_image_pool *pool;
+
+	/* A binary min-heap of sideband decoders ordered by their @tsc and, for
+	 * equal @tsc, by their @seq (descending).
+	 */
+	struct pt_sb_decoder **decoders;
+
+	/* The number of decoders in @decoders. */
+	uint32_t ndecoders;
+
+	/* The capacity of @decoders. */
+	uint32_t decoders_size;
+
+	/* The next decoder sequence number. */
+	uint64_t seq;
+
+	/* The number of decoders that have been added to this session. */
+	uint32_t nallocated;
 
 	/* A list of newly added sideband decoders in no particular order.
 	 *
@@ -79,6 +108,16 @@ struct pt_sb_session {
 	 */
 	struct pt_sb_decoder *removed;
 
+	/* A list of sideband decoders that requested the next event in no
+	 * particular order.
+	 *
+	 * The list is linked via the decoders' @next_request field.
+	 */
+	struct pt_sb_decoder *requests;
+
+	/* The sideband decoder whose callback is currently running. */
+	struct pt_sb_decoder *current;
+
 	/* An optional callback function to be called on sideband decode errors
 	 * and warnings.
 	 */
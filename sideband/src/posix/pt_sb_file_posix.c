@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sb_file.h"
+
+#include "intel-pt.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+int pt_sb_file_mmap(struct pt_sb_file_mapping *mapping, const char *filename,
+		    size_t begin, size_t end)
+{
+	struct stat stat;
+	uint64_t fsize, offset, size, adjustment;
+	uint8_t *base;
+	long page_size;
+	int fd, errcode;
+
+	if (!mapping || !filename)
+		return -pte_internal;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return -pte_bad_file;
+
+	errcode = fstat(fd, &stat);
+	if (errcode) {
+		errcode = -pte_bad_file;
+		goto out_fd;
+	}
+
+	/* Leave special files and empty sections to the generic code. */
+	errcode = -pte_not_supported;
+	if (!S_ISREG(stat.st_mode) || (stat.st_size <= 0))
+		goto out_fd;
+
+	fsize = (uint64_t) stat.st_size;
+	if (fsize <= begin)
+		goto out_fd;
+
+	if (!end || fsize < end)
+		end = (size_t) fsize;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	if (page_size <= 0)
+		goto out_fd;
+
+	adjustment = begin % (uint64_t) page_size;
+	offset = begin - adjustment;
+	size = (end - begin) + adjustment;
+
+	if (SIZE_MAX < size)
+		goto out_fd;
+
+	base = mmap(NULL, (size_t) size, PROT_READ, MAP_SHARED, fd,
+		    (off_t) offset);
+	if (base == MAP_FAILED)
+		goto out_fd;
+
+	/* We parse the sideband front to back.  This is only a hint. */
+	(void) posix_madvise(base, (size_t) size, POSIX_MADV_SEQUENTIAL);
+
+	mapping->base = base;
+	mapping->size = (size_t) size;
+	mapping->begin = base + adjustment;
+	mapping->end = base + size;
+	mapping->mapped = 1;
+
+	/* The mapping remains valid after closing the file. */
+	close(fd);
+	return 0;
+
+out_fd:
+	close(fd);
+	return errcode;
+}
+
+void pt_sb_file_munmap(struct pt_sb_file_mapping *mapping)
+{
+	if (!mapping)
+		return;
+
+	munmap(mapping->base, mapping->size);
+}
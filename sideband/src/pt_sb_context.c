@@ -35,15 +35,20 @@
 #include <stdlib.h>
 
 
-struct pt_sb_context *pt_sb_ctx_alloc(const char *name)
+struct pt_sb_context *pt_sb_ctx_alloc(const char *name,
+				      struct pt_image_pool *pool)
 {
 	struct pt_sb_context *context;
 	struct pt_image *image;
 
-	image = pt_image_alloc(name);
+	image = pt_image_alloc_pooled(name, pool);
 	if (!image)
 		return NULL;
 
+	/* The pool only provides slots for libipt's image objects.  Contexts
+	 * are created once per process and may outlive the session, so we
+	 * allocate them from the heap.
+	 */
 	context = malloc(sizeof(*context));
 	if (!context) {
 		pt_image_free(image);
@@ -135,6 +140,73 @@ int pt_sb_ctx_mmap(struct pt_sb_session *session, struct pt_sb_context *context,
 	return pt_image_add_cached(image, iscache, isid, NULL);
 }
 
+/* Check that @isid still identifies a section of at most @size bytes at
+ * @offset loaded at @vaddr in @iscache.
+ *
+ * The section may be smaller than requested if it had been truncated to the
+ * file size.
+ */
+static int pt_sb_ctx_check_isid(struct pt_image_section_cache *iscache,
+				int isid, uint64_t offset, uint64_t size,
+				uint64_t vaddr)
+{
+	uint64_t soffset, ssize, svaddr;
+	int errcode;
+
+	errcode = pt_iscache_get_file(iscache, isid, NULL, &soffset, &ssize,
+				      &svaddr);
+	if (errcode < 0)
+		return 0;
+
+	return (soffset == offset) && (ssize <= size) && (svaddr == vaddr);
+}
+
+int pt_sb_ctx_mmap_path(struct pt_sb_session *session,
+			struct pt_sb_context *context,
+			const struct pt_sb_path *path, uint64_t offset,
+			uint64_t size, uint64_t vaddr)
+{
+	struct pt_image_section_cache *iscache;
+	struct pt_image *image;
+	int isid;
+
+	if (!session || !path)
+		return -pte_internal;
+
+	image = pt_sb_ctx_image(context);
+	if (!image)
+		return -pte_internal;
+
+	iscache = pt_sb_iscache(session);
+	if (!iscache)
+		return pt_image_add_file(image, path->path, offset, size, NULL,
+					 vaddr);
+
+	isid = pt_sb_path_find_isid(&session->paths, path, offset, size,
+				    vaddr);
+	if (isid < 0)
+		return isid;
+
+	/* A cached isid goes stale if the image section cache forgets the
+	 * section.  We add the section again in that case.
+	 */
+	if (isid && !pt_sb_ctx_check_isid(iscache, isid, offset, size, vaddr))
+		isid = 0;
+
+	if (!isid) {
+		isid = pt_iscache_add_file(iscache, path->path, offset, size,
+					   vaddr);
+		if (isid < 0)
+			return isid;
+
+		/* We can do without caching @isid. */
+		(void) pt_sb_path_add_isid(&session->paths, path, offset, size,
+					   vaddr, isid);
+	}
+
+	return pt_image_add_cached(image, iscache, isid, NULL);
+}
+
 int pt_sb_ctx_switch_to(struct pt_image **pimage, struct pt_sb_session *session,
 			const struct pt_sb_context *context)
 {
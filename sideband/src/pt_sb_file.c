@@ -32,6 +32,7 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "intel-pt.h"
 
@@ -97,3 +98,50 @@ out_file:
 	fclose(file);
 	return -pte_bad_file;
 }
+
+int pt_sb_file_map(struct pt_sb_file_mapping *mapping, const char *filename,
+		   size_t begin, size_t end)
+{
+	void *buffer;
+	size_t size;
+	int errcode;
+
+	if (!mapping || !filename)
+		return -pte_invalid;
+
+	if (end && end <= begin)
+		return -pte_invalid;
+
+	memset(mapping, 0, sizeof(*mapping));
+
+	errcode = pt_sb_file_mmap(mapping, filename, begin, end);
+	if (errcode != -pte_not_supported)
+		return errcode;
+
+	buffer = NULL;
+	size = 0;
+	errcode = pt_sb_file_load(&buffer, &size, filename, begin, end);
+	if (errcode < 0)
+		return errcode;
+
+	mapping->base = buffer;
+	mapping->size = size;
+	mapping->begin = (const uint8_t *) buffer;
+	mapping->end = (const uint8_t *) buffer + size;
+	mapping->mapped = 0;
+
+	return 0;
+}
+
+void pt_sb_file_unmap(struct pt_sb_file_mapping *mapping)
+{
+	if (!mapping || !mapping->base)
+		return;
+
+	if (mapping->mapped)
+		pt_sb_file_munmap(mapping);
+	else
+		free(mapping->base);
+
+	memset(mapping, 0, sizeof(*mapping));
+}
@@ -0,0 +1,594 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sb_index.h"
+#include "pt_sb_session.h"
+#include "pt_sb_context.h"
+#include "pt_sb_decoder.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static void pt_sb_checkpoint_fini(struct pt_sb_checkpoint *checkpoint)
+{
+	uint32_t idx;
+
+	if (!checkpoint)
+		return;
+
+	for (idx = 0; idx < checkpoint->ncontexts; ++idx)
+		pt_image_free(checkpoint->contexts[idx].image);
+
+	for (idx = 0; idx < checkpoint->ndecoders; ++idx) {
+		struct pt_sb_checkpoint_decoder *decoder;
+
+		decoder = &checkpoint->decoders[idx];
+		if (decoder->free_state)
+			decoder->free_state(decoder->state);
+	}
+
+	free(checkpoint->contexts);
+	free(checkpoint->decoders);
+	pt_image_free(checkpoint->kernel);
+}
+
+/* Provide a new image from @pool in @pimage that shares @src's sections.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_checkpoint_share(struct pt_image **pimage,
+				  struct pt_image *src,
+				  struct pt_image_pool *pool)
+{
+	struct pt_image *image;
+	int errcode;
+
+	if (!pimage || !src)
+		return -pte_internal;
+
+	image = pt_image_alloc_pooled(pt_image_name(src), pool);
+	if (!image)
+		return -pte_nomem;
+
+	errcode = pt_image_share(image, src);
+	if (errcode < 0) {
+		pt_image_free(image);
+		return errcode;
+	}
+
+	*pimage = image;
+
+	return 0;
+}
+
+static int pt_sb_checkpoint_save_contexts(struct pt_sb_checkpoint *checkpoint,
+					  struct pt_sb_session *session,
+					  struct pt_image_pool *pool)
+{
+	struct pt_sb_checkpoint_context *saved;
+	struct pt_sb_checkpoint_context *contexts;
+	const struct pt_hash_table *table;
+	size_t bucket, nbuckets;
+	uint32_t ncontexts;
+
+	if (!checkpoint || !session || !pool)
+		return -pte_internal;
+
+	table = &session->contexts;
+	if (!table->nnodes)
+		return 0;
+
+	if (UINT32_MAX < table->nnodes)
+		return -pte_overflow;
+
+	contexts = calloc((size_t) table->nnodes, sizeof(*contexts));
+	if (!contexts)
+		return -pte_nomem;
+
+	checkpoint->contexts = contexts;
+
+	ncontexts = 0;
+	nbuckets = (size_t) 1 << table->bits;
+	for (bucket = 0; bucket < nbuckets; ++bucket) {
+		const struct pt_hash_node *node;
+
+		for (node = table->buckets[bucket]; node; node = node->next) {
+			const struct pt_sb_context *context;
+			int errcode;
+
+			if (table->nnodes <= ncontexts)
+				return -pte_internal;
+
+			/* The node is the first field in struct
+			 * pt_sb_context.
+			 */
+			context = (const struct pt_sb_context *) node;
+
+			saved = &contexts[ncontexts];
+
+			errcode = pt_sb_checkpoint_share(&saved->image,
+							 context->image, pool);
+			if (errcode < 0)
+				return errcode;
+
+			saved->abi = context->abi;
+			saved->pid = context->pid;
+
+			checkpoint->ncontexts = ++ncontexts;
+		}
+	}
+
+	return 0;
+}
+
+static int pt_sb_checkpoint_save_decoder(struct pt_sb_checkpoint *checkpoint,
+					 struct pt_sb_session *session,
+					 struct pt_sb_decoder *decoder)
+{
+	struct pt_sb_checkpoint_decoder *saved;
+	void *state;
+	int errcode;
+
+	if (!checkpoint || !session || !decoder)
+		return -pte_internal;
+
+	if (!decoder->save)
+		return -pte_bad_config;
+
+	if (session->nallocated <= checkpoint->ndecoders)
+		return -pte_internal;
+
+	state = NULL;
+
+	session->current = decoder;
+	errcode = decoder->save(session, &state, decoder->priv);
+	session->current = NULL;
+
+	if (errcode < 0)
+		return errcode;
+
+	saved = &checkpoint->decoders[checkpoint->ndecoders++];
+	saved->state = state;
+	saved->free_state = decoder->free_state;
+	saved->id = decoder->id;
+
+	return 0;
+}
+
+static int pt_sb_checkpoint_save_list(struct pt_sb_checkpoint *checkpoint,
+				      struct pt_sb_session *session,
+				      struct pt_sb_decoder *decoder)
+{
+	for (; decoder; decoder = decoder->next) {
+		int errcode;
+
+		errcode = pt_sb_checkpoint_save_decoder(checkpoint, session,
+							decoder);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+static int pt_sb_checkpoint_cmp(const void *lhs, const void *rhs)
+{
+	const struct pt_sb_checkpoint_decoder *ldec, *rdec;
+
+	ldec = (const struct pt_sb_checkpoint_decoder *) lhs;
+	rdec = (const struct pt_sb_checkpoint_decoder *) rhs;
+
+	if (ldec->id < rdec->id)
+		return -1;
+
+	return (rdec->id < ldec->id) ? 1 : 0;
+}
+
+static int pt_sb_checkpoint_save_decoders(struct pt_sb_checkpoint *checkpoint,
+					  struct pt_sb_session *session)
+{
+	uint32_t idx;
+	int errcode;
+
+	if (!checkpoint || !session)
+		return -pte_internal;
+
+	/* Every decoder is either in the heap or on the list of retired or
+	 * removed decoders.  We save removed decoders, as well, so restored
+	 * sessions run into the same errors.
+	 */
+	if (!session->nallocated)
+		return 0;
+
+	checkpoint->decoders = calloc(session->nallocated,
+				      sizeof(*checkpoint->decoders));
+	if (!checkpoint->decoders)
+		return -pte_nomem;
+
+	for (idx = 0; idx < session->ndecoders; ++idx) {
+		errcode = pt_sb_checkpoint_save_decoder(checkpoint, session,
+							session->decoders[idx]);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	errcode = pt_sb_checkpoint_save_list(checkpoint, session,
+					     session->retired);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_checkpoint_save_list(checkpoint, session,
+					     session->removed);
+	if (errcode < 0)
+		return errcode;
+
+	qsort(checkpoint->decoders, checkpoint->ndecoders,
+	      sizeof(*checkpoint->decoders), pt_sb_checkpoint_cmp);
+
+	return 0;
+}
+
+static int pt_sb_checkpoint_save(struct pt_sb_checkpoint *checkpoint,
+				 struct pt_sb_session *session,
+				 struct pt_image_pool *pool, uint64_t tsc)
+{
+	int errcode;
+
+	if (!checkpoint || !session || !pool)
+		return -pte_internal;
+
+	memset(checkpoint, 0, sizeof(*checkpoint));
+	checkpoint->tsc = tsc;
+
+	errcode = pt_sb_checkpoint_share(&checkpoint->kernel, session->kernel,
+					 pool);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_checkpoint_save_contexts(checkpoint, session, pool);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_sb_checkpoint_save_decoders(checkpoint, session);
+}
+
+static int pt_sb_index_add(struct pt_sb_index *index,
+			   struct pt_sb_session *session, uint64_t tsc)
+{
+	struct pt_sb_checkpoint *checkpoint;
+	int errcode;
+
+	if (!index)
+		return -pte_internal;
+
+	if (index->capacity <= index->ncheckpoints) {
+		struct pt_sb_checkpoint *checkpoints;
+		uint32_t capacity;
+
+		if ((INT_MAX / 2) < index->capacity)
+			return -pte_nomem;
+
+		capacity = index->capacity ? (index->capacity * 2) : 64;
+		checkpoints = realloc(index->checkpoints,
+				      capacity * sizeof(*checkpoints));
+		if (!checkpoints)
+			return -pte_nomem;
+
+		index->checkpoints = checkpoints;
+		index->capacity = capacity;
+	}
+
+	checkpoint = &index->checkpoints[index->ncheckpoints];
+
+	errcode = pt_sb_checkpoint_save(checkpoint, session, index->pool, tsc);
+	if (errcode < 0) {
+		pt_sb_checkpoint_fini(checkpoint);
+		return errcode;
+	}
+
+	index->ncheckpoints += 1;
+
+	return 0;
+}
+
+static int pt_sb_index_check_list(const struct pt_sb_decoder *decoder)
+{
+	for (; decoder; decoder = decoder->next) {
+		if (!decoder->save || !decoder->restore)
+			return -pte_bad_config;
+	}
+
+	return 0;
+}
+
+int pt_sb_index_build(struct pt_sb_index **pindex,
+		      struct pt_sb_session *session, uint64_t interval)
+{
+	struct pt_sb_index *index;
+	struct pt_image *image;
+	struct pt_event event;
+	uint64_t tsc;
+	uint32_t idx;
+	int errcode;
+
+	if (!pindex || !session || !interval)
+		return -pte_invalid;
+
+	for (idx = 0; idx < session->ndecoders; ++idx) {
+		const struct pt_sb_decoder *decoder;
+
+		decoder = session->decoders[idx];
+		if (!decoder->save || !decoder->restore)
+			return -pte_bad_config;
+	}
+
+	errcode = pt_sb_index_check_list(session->waiting);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_index_check_list(session->retired);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_init_decoders(session);
+	if (errcode < 0)
+		return errcode;
+
+	index = malloc(sizeof(*index));
+	if (!index)
+		return -pte_nomem;
+
+	memset(index, 0, sizeof(*index));
+	index->ndecoders = session->nallocated;
+
+	index->pool = pt_image_pool_alloc();
+	if (!index->pool) {
+		free(index);
+		return -pte_nomem;
+	}
+
+	/* We drive the session with timing events that do not tell anything
+	 * about the code location.  Primary decoders will apply postponed
+	 * context switches right away so there are none pending at the
+	 * checkpoint.
+	 */
+	memset(&event, 0, sizeof(event));
+	event.type = ptev_cbr;
+	event.has_tsc = 1;
+
+	image = pt_sb_kernel_image(session);
+
+	tsc = 0ull;
+	while (session->ndecoders) {
+		uint64_t next;
+
+		/* Skip intervals without sideband records. */
+		next = session->decoders[0]->tsc;
+		if ((UINT64_MAX - interval) < tsc)
+			tsc = UINT64_MAX;
+		else
+			tsc += interval;
+
+		if (tsc < next)
+			tsc = next;
+
+		event.tsc = tsc;
+
+		errcode = pt_sb_event(session, &image, &event, sizeof(event),
+				      NULL, 0);
+		if (errcode < 0)
+			goto err;
+
+		errcode = pt_sb_index_add(index, session, tsc);
+		if (errcode < 0)
+			goto err;
+
+		if (tsc == UINT64_MAX)
+			break;
+	}
+
+	*pindex = index;
+
+	return 0;
+
+err:
+	pt_sb_index_free(index);
+	return errcode;
+}
+
+void pt_sb_index_free(struct pt_sb_index *index)
+{
+	uint32_t idx;
+
+	if (!index)
+		return;
+
+	for (idx = 0; idx < index->ncheckpoints; ++idx)
+		pt_sb_checkpoint_fini(&index->checkpoints[idx]);
+
+	free(index->checkpoints);
+	pt_image_pool_free(index->pool);
+	free(index);
+}
+
+int pt_sb_index_size(const struct pt_sb_index *index)
+{
+	if (!index)
+		return -pte_invalid;
+
+	return (int) index->ncheckpoints;
+}
+
+/* Find the last checkpoint in @index at or before @tsc.
+ *
+ * Returns a pointer to the checkpoint on success, NULL otherwise.
+ */
+static const struct pt_sb_checkpoint *
+pt_sb_index_find(const struct pt_sb_index *index, uint64_t tsc)
+{
+	uint32_t begin, end;
+
+	begin = 0;
+	end = index->ncheckpoints;
+	while (begin < end) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (tsc < index->checkpoints[mid].tsc)
+			end = mid;
+		else
+			begin = mid + 1;
+	}
+
+	if (!begin)
+		return NULL;
+
+	return &index->checkpoints[begin - 1];
+}
+
+static const struct pt_sb_checkpoint_decoder *
+pt_sb_checkpoint_find_decoder(const struct pt_sb_checkpoint *checkpoint,
+			      uint32_t id)
+{
+	struct pt_sb_checkpoint_decoder key;
+
+	memset(&key, 0, sizeof(key));
+	key.id = id;
+
+	return bsearch(&key, checkpoint->decoders, checkpoint->ndecoders,
+		       sizeof(*checkpoint->decoders), pt_sb_checkpoint_cmp);
+}
+
+static int pt_sb_restore_contexts(struct pt_sb_session *session,
+				  const struct pt_sb_checkpoint *checkpoint)
+{
+	uint32_t idx;
+	int errcode;
+
+	if (!session || !checkpoint)
+		return -pte_internal;
+
+	errcode = pt_image_share(session->kernel, checkpoint->kernel);
+	if (errcode < 0)
+		return errcode;
+
+	for (idx = 0; idx < checkpoint->ncontexts; ++idx) {
+		const struct pt_sb_checkpoint_context *saved;
+		struct pt_sb_context *context;
+
+		saved = &checkpoint->contexts[idx];
+
+		context = NULL;
+		errcode = pt_sb_get_context_by_pid(&context, session,
+						   saved->pid);
+		if (errcode < 0)
+			return errcode;
+
+		errcode = pt_image_share(context->image, saved->image);
+		if (errcode < 0)
+			return errcode;
+
+		context->abi = saved->abi;
+	}
+
+	return 0;
+}
+
+static int pt_sb_restore_decoders(struct pt_sb_session *session,
+				  const struct pt_sb_checkpoint *checkpoint)
+{
+	struct pt_sb_decoder *decoder;
+
+	if (!session || !checkpoint)
+		return -pte_internal;
+
+	for (decoder = session->waiting; decoder; decoder = decoder->next) {
+		const struct pt_sb_checkpoint_decoder *saved;
+		int errcode;
+
+		saved = pt_sb_checkpoint_find_decoder(checkpoint, decoder->id);
+		if (!saved || !decoder->restore)
+			return -pte_bad_context;
+
+		session->current = decoder;
+		errcode = decoder->restore(session, saved->state,
+					   decoder->priv);
+		session->current = NULL;
+
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+int pt_sb_index_restore(struct pt_sb_session *session,
+			const struct pt_sb_index *index, uint64_t tsc,
+			uint64_t *ptsc)
+{
+	const struct pt_sb_checkpoint *checkpoint;
+	int errcode;
+
+	if (!session || !index)
+		return -pte_invalid;
+
+	if (ptsc)
+		*ptsc = 0ull;
+
+	/* The session must not have been used.  We restore into a clean
+	 * state.
+	 */
+	if (session->ndecoders || session->retired || session->removed ||
+	    session->contexts.nnodes)
+		return -pte_bad_context;
+
+	if (session->nallocated != index->ndecoders)
+		return -pte_bad_context;
+
+	checkpoint = pt_sb_index_find(index, tsc);
+	if (!checkpoint)
+		return 0;
+
+	errcode = pt_sb_restore_contexts(session, checkpoint);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_restore_decoders(session, checkpoint);
+	if (errcode < 0)
+		return errcode;
+
+	if (ptsc)
+		*ptsc = checkpoint->tsc;
+
+	return 0;
+}
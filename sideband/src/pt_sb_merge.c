@@ -0,0 +1,986 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sb_merge.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Provide the time of the next record of @stream.
+ *
+ * Takes @event's timestamp if @event is not NULL and has one and the
+ * decoder's time, otherwise.
+ *
+ * The time does not go backwards.
+ */
+static uint64_t pt_sb_merge_time(struct pt_sb_merge_stream *stream,
+				 const struct pt_event *event)
+{
+	uint64_t tsc;
+	int errcode;
+
+	if (event && event->has_tsc) {
+		tsc = event->tsc;
+		errcode = 0;
+	} else
+		errcode = pt_blk_time(stream->decoder, &tsc, NULL, NULL);
+
+	/* Relative time can't be correlated with other streams. */
+	if (!errcode && (stream->tsc < tsc))
+		stream->tsc = tsc;
+
+	return stream->tsc;
+}
+
+static void pt_sb_merge_error(struct pt_sb_merge_record *record,
+			      struct pt_sb_merge_stream *stream, int errcode)
+{
+	uint64_t offset;
+	int status;
+
+	status = pt_blk_get_offset(stream->decoder, &offset);
+	if (status < 0)
+		offset = 0ull;
+
+	record->type = ptsm_error;
+	record->errcode = errcode;
+	record->offset = offset;
+	record->tsc = stream->tsc;
+	record->last = 0;
+}
+
+/* Apply @event to @stream's tracing session.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_apply(struct pt_sb_merge_stream *stream,
+			     const struct pt_event *event)
+{
+	struct pt_image *image;
+	int errcode;
+
+	if (!stream->session)
+		return 0;
+
+	image = NULL;
+	errcode = pt_sb_event(stream->session, &image, event, sizeof(*event),
+			      NULL, 0);
+	if (errcode < 0)
+		return errcode;
+
+	if (!image)
+		return 0;
+
+	return pt_blk_set_image(stream->decoder, image);
+}
+
+/* Decode the next record of @stream into @record.
+ *
+ * Decode errors are reported as ptsm_error records, after which we
+ * re-synchronize.  We give up when synchronizing does not make progress.  At
+ * the end of the trace, we provide a ptsm_error record with -pte_eos.
+ */
+static void pt_sb_merge_decode(struct pt_sb_merge_record *record,
+			       struct pt_sb_merge_stream *stream)
+{
+	struct pt_block_decoder *decoder;
+	struct pt_block *block;
+	int status, errcode;
+
+	decoder = stream->decoder;
+
+	/* Report the error that ended the last block. */
+	errcode = stream->errcode;
+	if (errcode) {
+		stream->errcode = 0;
+
+		pt_sb_merge_error(record, stream, errcode);
+		return;
+	}
+
+	for (;;) {
+		if (stream->done) {
+			pt_sb_merge_error(record, stream, -pte_eos);
+			record->last = 1;
+			return;
+		}
+
+		status = stream->status;
+		if (status < 0) {
+			uint64_t offset;
+
+			status = pt_blk_sync_forward(decoder);
+			if (status < 0) {
+				if (status == -pte_eos) {
+					stream->done = 1;
+					continue;
+				}
+
+				/* Let's see if we made any progress.  If we
+				 * haven't, we likely never will.
+				 */
+				errcode = pt_blk_get_offset(decoder, &offset);
+				if ((errcode < 0) || (offset <= stream->sync))
+					stream->done = 1;
+				else
+					stream->sync = offset;
+
+				pt_sb_merge_error(record, stream, status);
+				return;
+			}
+
+			stream->status = status;
+		}
+
+		if (status & pts_event_pending) {
+			struct pt_event *event;
+
+			event = &record->variant.event;
+
+			errcode = pt_blk_get_offset(decoder, &record->offset);
+			if (errcode < 0)
+				record->offset = 0ull;
+
+			status = pt_blk_event(decoder, event, sizeof(*event));
+			if (status < 0) {
+				stream->status = -pte_nosync;
+
+				pt_sb_merge_error(record, stream, status);
+				return;
+			}
+
+			stream->status = status;
+			stream->errcode = pt_sb_merge_apply(stream, event);
+
+			record->type = ptsm_event;
+			record->errcode = 0;
+			record->tsc = pt_sb_merge_time(stream, event);
+			record->last = 0;
+			return;
+		}
+
+		if (status & pts_eos) {
+			stream->done = 1;
+			continue;
+		}
+
+		block = &record->variant.block;
+
+		/* Initialize IP and ninsn - we use it for error reporting. */
+		block->ip = 0ull;
+		block->ninsn = 0u;
+
+		errcode = pt_blk_get_offset(decoder, &record->offset);
+		if (errcode < 0)
+			record->offset = 0ull;
+
+		status = pt_blk_next(decoder, block, sizeof(*block));
+		if (status < 0) {
+			if (status == -pte_eos)
+				stream->done = 1;
+			else
+				stream->status = -pte_nosync;
+
+			/* Even in case of errors, we may have succeeded in
+			 * decoding some instructions.
+			 */
+			if (!block->ninsn) {
+				if (status == -pte_eos)
+					continue;
+
+				pt_sb_merge_error(record, stream, status);
+				return;
+			}
+
+			if (status != -pte_eos)
+				stream->errcode = status;
+		} else {
+			stream->status = status;
+
+			/* There's nothing to report for empty blocks. */
+			if (!block->ninsn)
+				continue;
+		}
+
+		record->type = ptsm_block;
+		record->errcode = 0;
+		record->tsc = pt_sb_merge_time(stream, NULL);
+		record->last = 0;
+		return;
+	}
+}
+
+/* Check whether @record is the last record of its trace stream. */
+static inline int pt_sb_merge_is_last(const struct pt_sb_merge_record *record)
+{
+	return record->last;
+}
+
+/* Check whether @record ends its trace stream without providing anything. */
+static inline int pt_sb_merge_is_end(const struct pt_sb_merge_record *record)
+{
+	return record->last && (record->type == ptsm_error) &&
+		(record->errcode == -pte_eos);
+}
+
+/* Decode up to @count records into @stream's ring starting at @tail.
+ *
+ * Stops after the end of the trace stream.
+ *
+ * Returns the number of decoded records.
+ */
+static uint32_t pt_sb_merge_fill(struct pt_sb_merge_stream *stream,
+				 uint32_t tail, uint32_t count)
+{
+	uint32_t idx;
+
+	for (idx = 0; idx < count;) {
+		struct pt_sb_merge_record *record;
+
+		record = &stream->ring[(tail + idx) & stream->mask];
+
+		pt_sb_merge_decode(record, stream);
+		idx += 1;
+
+		if (pt_sb_merge_is_last(record))
+			break;
+	}
+
+	return idx;
+}
+
+
+#if defined(FEATURE_THREADS)
+
+static int pt_sb_merge_lock(struct pt_sb_merge_stream *stream)
+{
+	int errcode;
+
+	errcode = mtx_lock(&stream->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+static int pt_sb_merge_unlock(struct pt_sb_merge_stream *stream)
+{
+	int errcode;
+
+	errcode = mtx_unlock(&stream->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+/* Wait for free slots in @stream's ring.
+ *
+ * On success, provides the index of the first free slot in @tail and the
+ * number of free slots in @free.  Sets @free to zero if the decoder thread
+ * shall terminate.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_reserve(uint32_t *tail, uint32_t *free,
+			       struct pt_sb_merge_stream *stream)
+{
+	uint32_t used, size;
+	int errcode;
+
+	errcode = pt_sb_merge_lock(stream);
+	if (errcode < 0)
+		return errcode;
+
+	size = stream->mask + 1;
+	for (;;) {
+		if (stream->stop) {
+			*free = 0;
+			break;
+		}
+
+		used = stream->tail - stream->head;
+		if (used < size) {
+			*tail = stream->tail;
+			*free = size - used;
+			break;
+		}
+
+		errcode = cnd_wait(&stream->released, &stream->lock);
+		if (errcode != thrd_success) {
+			(void) pt_sb_merge_unlock(stream);
+			return -pte_bad_lock;
+		}
+	}
+
+	return pt_sb_merge_unlock(stream);
+}
+
+/* Publish records up to @tail in @stream's ring to the consumer.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_publish(struct pt_sb_merge_stream *stream,
+			       uint32_t tail)
+{
+	int errcode;
+
+	errcode = pt_sb_merge_lock(stream);
+	if (errcode < 0)
+		return errcode;
+
+	stream->tail = tail;
+
+	errcode = cnd_signal(&stream->published);
+	if (errcode != thrd_success) {
+		(void) pt_sb_merge_unlock(stream);
+		return -pte_bad_lock;
+	}
+
+	return pt_sb_merge_unlock(stream);
+}
+
+/* Decode @stream ahead of the merge in batches until the end of the trace
+ * stream or until we are asked to terminate.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_produce(struct pt_sb_merge_stream *stream)
+{
+	for (;;) {
+		const struct pt_sb_merge_record *last;
+		uint32_t tail, free, count;
+		int errcode;
+
+		errcode = pt_sb_merge_reserve(&tail, &free, stream);
+		if (errcode < 0)
+			return errcode;
+
+		if (!free)
+			return 0;
+
+		if (stream->batch < free)
+			free = stream->batch;
+
+		count = pt_sb_merge_fill(stream, tail, free);
+		last = &stream->ring[(tail + count - 1) & stream->mask];
+
+		/* The consumer does not modify published records.  We may
+		 * still look at the last one.
+		 */
+		errcode = pt_sb_merge_publish(stream, tail + count);
+		if (errcode < 0)
+			return errcode;
+
+		if (pt_sb_merge_is_last(last))
+			return 0;
+	}
+}
+
+/* Tell the consumer that the decoder thread exited with @status.
+ *
+ * The decoder thread does not touch @stream after this.
+ */
+static void pt_sb_merge_exit(struct pt_sb_merge_stream *stream, int status)
+{
+	int errcode;
+
+	/* If we can't lock, neither can the consumer.  It will not wait. */
+	errcode = pt_sb_merge_lock(stream);
+	if (errcode < 0)
+		return;
+
+	stream->exit_status = status;
+	stream->exited = 1;
+
+	(void) cnd_broadcast(&stream->published);
+	(void) pt_sb_merge_unlock(stream);
+}
+
+/* The decoder thread.
+ *
+ * Decodes @arg's trace stream ahead of the merge.
+ */
+static int pt_sb_merge_thread(void *arg)
+{
+	struct pt_sb_merge_stream *stream;
+	int status;
+
+	stream = (struct pt_sb_merge_stream *) arg;
+	if (!stream)
+		return -pte_internal;
+
+	status = pt_sb_merge_produce(stream);
+	pt_sb_merge_exit(stream, status);
+
+	return status;
+}
+
+/* Release consumed records and wait for published records.
+ *
+ * If the decoder thread exited without publishing the last record of the
+ * trace stream, ends the trace stream with a ptsm_error record carrying the
+ * thread's exit status.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_sync(struct pt_sb_merge_stream *stream, int wait)
+{
+	int errcode;
+
+	errcode = pt_sb_merge_lock(stream);
+	if (errcode < 0)
+		return errcode;
+
+	stream->head = stream->next;
+
+	errcode = cnd_signal(&stream->released);
+	if (errcode != thrd_success) {
+		(void) pt_sb_merge_unlock(stream);
+		return -pte_bad_lock;
+	}
+
+	while (wait && (stream->tail == stream->next) && !stream->exited) {
+		errcode = cnd_wait(&stream->published, &stream->lock);
+		if (errcode != thrd_success) {
+			(void) pt_sb_merge_unlock(stream);
+			return -pte_bad_lock;
+		}
+	}
+
+	/* We consumed all records and we own the ring.  The decoder thread
+	 * only exits without error after publishing the last record.
+	 */
+	if (wait && (stream->tail == stream->next)) {
+		struct pt_sb_merge_record *record;
+
+		errcode = stream->exit_status;
+		if (errcode >= 0)
+			errcode = -pte_internal;
+
+		record = &stream->ring[stream->tail & stream->mask];
+		pt_sb_merge_error(record, stream, errcode);
+		record->last = 1;
+
+		stream->tail += 1;
+	}
+
+	stream->available = stream->tail - stream->next;
+
+	return pt_sb_merge_unlock(stream);
+}
+
+static int pt_sb_merge_start_thread(struct pt_sb_merge_stream *stream)
+{
+	int errcode;
+
+	errcode = mtx_init(&stream->lock, mtx_plain);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	errcode = cnd_init(&stream->published);
+	if (errcode != thrd_success)
+		goto out_lock;
+
+	errcode = cnd_init(&stream->released);
+	if (errcode != thrd_success)
+		goto out_published;
+
+	/* @started shares its storage with @stop.  Set it before the decoder
+	 * thread may look at @stop.
+	 */
+	stream->started = 1;
+	stream->stop = 0;
+	stream->exited = 0;
+	stream->exit_status = 0;
+
+	errcode = thrd_create(&stream->thread, pt_sb_merge_thread, stream);
+	if (errcode != thrd_success)
+		goto out_released;
+
+	return 0;
+
+out_released:
+	stream->started = 0;
+	cnd_destroy(&stream->released);
+
+out_published:
+	cnd_destroy(&stream->published);
+
+out_lock:
+	mtx_destroy(&stream->lock);
+
+	return -pte_bad_lock;
+}
+
+static void pt_sb_merge_stop_thread(struct pt_sb_merge_stream *stream)
+{
+	int errcode;
+
+	if (!stream->started)
+		return;
+
+	errcode = pt_sb_merge_lock(stream);
+	if (!errcode) {
+		stream->stop = 1;
+
+		(void) cnd_broadcast(&stream->released);
+		(void) pt_sb_merge_unlock(stream);
+	}
+
+	(void) thrd_join(&stream->thread, NULL);
+
+	cnd_destroy(&stream->released);
+	cnd_destroy(&stream->published);
+	mtx_destroy(&stream->lock);
+
+	stream->started = 0;
+}
+
+#endif /* defined(FEATURE_THREADS) */
+
+/* Make @stream's next record available to the consumer.
+ *
+ * Returns a pointer to the record on success, NULL otherwise.
+ */
+static const struct pt_sb_merge_record *
+pt_sb_merge_peek(struct pt_sb_merge_stream *stream)
+{
+	if (!stream->available) {
+#if defined(FEATURE_THREADS)
+		if (stream->started) {
+			int errcode;
+
+			errcode = pt_sb_merge_sync(stream, 1);
+			if (errcode < 0)
+				return NULL;
+		} else
+#endif /* defined(FEATURE_THREADS) */
+		{
+			uint32_t count;
+
+			stream->head = stream->next;
+			count = pt_sb_merge_fill(stream, stream->tail,
+						 stream->batch);
+
+			stream->tail += count;
+			stream->available = count;
+		}
+
+		if (!stream->available)
+			return NULL;
+	}
+
+	return &stream->ring[stream->next & stream->mask];
+}
+
+/* Consume @stream's next record.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_consume(struct pt_sb_merge_stream *stream)
+{
+	if (!stream->available)
+		return -pte_internal;
+
+	stream->next += 1;
+	stream->available -= 1;
+
+#if defined(FEATURE_THREADS)
+	/* Let the decoder thread refill the ring while we're consuming the
+	 * rest of our records.
+	 */
+	if (stream->started &&
+	    (stream->batch <= (stream->next - stream->head)))
+		return pt_sb_merge_sync(stream, 0);
+#endif /* defined(FEATURE_THREADS) */
+
+	return 0;
+}
+
+/* Check whether stream @lhs comes before stream @rhs in the merge heap.
+ *
+ * Streams are ordered by the time of their next record.  For equal time, the
+ * stream that was added first comes first.
+ */
+static inline int pt_sb_merge_before(const struct pt_sb_merge_stream *lhs,
+				     const struct pt_sb_merge_stream *rhs)
+{
+	uint64_t ltsc, rtsc;
+
+	ltsc = lhs->ring[lhs->next & lhs->mask].tsc;
+	rtsc = rhs->ring[rhs->next & rhs->mask].tsc;
+	if (ltsc != rtsc)
+		return ltsc < rtsc;
+
+	return lhs->index < rhs->index;
+}
+
+static void pt_sb_merge_sift_up(struct pt_sb_merge_stream **heap, uint32_t idx)
+{
+	struct pt_sb_merge_stream *stream;
+
+	stream = heap[idx];
+	while (idx) {
+		uint32_t parent;
+
+		parent = (idx - 1) / 2;
+		if (!pt_sb_merge_before(stream, heap[parent]))
+			break;
+
+		heap[idx] = heap[parent];
+		idx = parent;
+	}
+
+	heap[idx] = stream;
+}
+
+static void pt_sb_merge_sift_down(struct pt_sb_merge_stream **heap,
+				  uint32_t size, uint32_t idx)
+{
+	struct pt_sb_merge_stream *stream;
+
+	stream = heap[idx];
+	for (;;) {
+		uint32_t child;
+
+		child = (2 * idx) + 1;
+		if (size <= child)
+			break;
+
+		if (((child + 1) < size) &&
+		    pt_sb_merge_before(heap[child + 1], heap[child]))
+			child += 1;
+
+		if (!pt_sb_merge_before(heap[child], stream))
+			break;
+
+		heap[idx] = heap[child];
+		idx = child;
+	}
+
+	heap[idx] = stream;
+}
+
+/* Undo a partial pt_sb_merge_start().
+ *
+ * Stops all decoder threads.  Records that have already been decoded remain
+ * in their stream's ring for the next start.
+ */
+static void pt_sb_merge_reset(struct pt_sb_merge *merge)
+{
+#if defined(FEATURE_THREADS)
+	uint32_t idx;
+
+	for (idx = 0; idx < merge->nstreams; ++idx)
+		pt_sb_merge_stop_thread(merge->streams[idx]);
+#endif /* defined(FEATURE_THREADS) */
+
+	merge->nheap = 0;
+	merge->started = 0;
+}
+
+/* Start decoding all trace streams and fill the merge heap.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_merge_start(struct pt_sb_merge *merge)
+{
+	uint32_t idx;
+
+	merge->started = 1;
+
+#if defined(FEATURE_THREADS)
+	if (merge->threads) {
+		for (idx = 0; idx < merge->nstreams; ++idx) {
+			int errcode;
+
+			errcode = pt_sb_merge_start_thread(merge->streams[idx]);
+			if (errcode < 0) {
+				pt_sb_merge_reset(merge);
+				return errcode;
+			}
+		}
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	for (idx = 0; idx < merge->nstreams; ++idx) {
+		const struct pt_sb_merge_record *record;
+		struct pt_sb_merge_stream *stream;
+
+		stream = merge->streams[idx];
+
+		record = pt_sb_merge_peek(stream);
+		if (!record) {
+			pt_sb_merge_reset(merge);
+			return -pte_bad_lock;
+		}
+
+		if (pt_sb_merge_is_end(record))
+			continue;
+
+		merge->heap[merge->nheap] = stream;
+		pt_sb_merge_sift_up(merge->heap, merge->nheap);
+		merge->nheap += 1;
+	}
+
+	return 0;
+}
+
+struct pt_sb_merge *pt_sb_merge_alloc(const struct pt_sb_merge_config *config)
+{
+	struct pt_sb_merge *merge;
+	uint32_t capacity;
+
+	if (!config)
+		return NULL;
+
+	/* This is the first version - we need all the fields. */
+	if (config->size < sizeof(*config))
+		return NULL;
+
+	capacity = config->capacity;
+	if (!capacity)
+		capacity = pt_sb_merge_capacity;
+
+	if ((UINT32_MAX / 2) < capacity)
+		return NULL;
+
+	/* We need a power of two for masking our ring indices. */
+	while (capacity & (capacity - 1))
+		capacity += capacity & -capacity;
+
+	merge = malloc(sizeof(*merge));
+	if (!merge)
+		return NULL;
+
+	memset(merge, 0, sizeof(*merge));
+	merge->capacity = capacity;
+	merge->batch = capacity / 4 ? capacity / 4 : 1;
+	merge->threads = config->threads ? 1 : 0;
+
+	return merge;
+}
+
+void pt_sb_merge_free(struct pt_sb_merge *merge)
+{
+	uint32_t idx;
+
+	if (!merge)
+		return;
+
+	for (idx = 0; idx < merge->nstreams; ++idx) {
+		struct pt_sb_merge_stream *stream;
+
+		stream = merge->streams[idx];
+
+#if defined(FEATURE_THREADS)
+		/* Stop decoding before we free the decoder. */
+		pt_sb_merge_stop_thread(stream);
+#endif /* defined(FEATURE_THREADS) */
+
+		pt_blk_free_decoder(stream->decoder);
+		free(stream->ring);
+		free(stream);
+	}
+
+	free(merge->streams);
+	free(merge->heap);
+	free(merge);
+}
+
+int pt_sb_merge_add_stream(struct pt_sb_merge *merge,
+			   const struct pt_config *config,
+			   struct pt_image *image,
+			   struct pt_sb_session *session, uint32_t cpu)
+{
+	struct pt_sb_merge_stream *stream, **streams, **heap;
+	uint32_t nstreams;
+	int errcode;
+
+	if (!merge || !config)
+		return -pte_invalid;
+
+	if (merge->started)
+		return -pte_bad_context;
+
+	nstreams = merge->nstreams;
+	if (INT32_MAX <= nstreams)
+		return -pte_nomem;
+
+	streams = realloc(merge->streams, (nstreams + 1) * sizeof(*streams));
+	if (!streams)
+		return -pte_nomem;
+
+	merge->streams = streams;
+
+	heap = realloc(merge->heap, (nstreams + 1) * sizeof(*heap));
+	if (!heap)
+		return -pte_nomem;
+
+	merge->heap = heap;
+
+	stream = malloc(sizeof(*stream));
+	if (!stream)
+		return -pte_nomem;
+
+	memset(stream, 0, sizeof(*stream));
+	stream->session = session;
+	stream->index = nstreams;
+	stream->cpu = cpu;
+	stream->status = -pte_nosync;
+	stream->mask = merge->capacity - 1;
+	stream->batch = merge->batch;
+
+	stream->ring = malloc(merge->capacity * sizeof(*stream->ring));
+	if (!stream->ring) {
+		free(stream);
+		return -pte_nomem;
+	}
+
+	stream->decoder = pt_blk_alloc_decoder(config);
+	if (!stream->decoder) {
+		errcode = -pte_nomem;
+		goto err;
+	}
+
+	if (image) {
+		errcode = pt_blk_set_image(stream->decoder, image);
+		if (errcode < 0)
+			goto err;
+	}
+
+	streams[nstreams] = stream;
+	merge->nstreams = nstreams + 1;
+
+	return (int) nstreams;
+
+err:
+	pt_blk_free_decoder(stream->decoder);
+	free(stream->ring);
+	free(stream);
+
+	return errcode;
+}
+
+int pt_sb_merge_next(struct pt_sb_merge *merge, struct pt_sb_merge_item *uitem,
+		     size_t size)
+{
+	const struct pt_sb_merge_record *record;
+	struct pt_sb_merge_stream *stream;
+	struct pt_sb_merge_item item;
+
+	if (!merge || !uitem)
+		return -pte_invalid;
+
+	if (!merge->started) {
+		int errcode;
+
+		errcode = pt_sb_merge_start(merge);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* Consume the record we provided last time and order its stream by
+	 * its next record.
+	 */
+	if (merge->pending) {
+		int errcode, end;
+
+		merge->pending = 0;
+
+		if (!merge->nheap)
+			return -pte_internal;
+
+		stream = merge->heap[0];
+		record = &stream->ring[stream->next & stream->mask];
+
+		/* Nothing follows the last record of a trace stream. */
+		end = pt_sb_merge_is_last(record);
+
+		errcode = pt_sb_merge_consume(stream);
+		if (errcode < 0)
+			return errcode;
+
+		if (!end) {
+			record = pt_sb_merge_peek(stream);
+			if (!record)
+				return -pte_bad_lock;
+
+			end = pt_sb_merge_is_end(record);
+		}
+
+		if (end) {
+			merge->nheap -= 1;
+			merge->heap[0] = merge->heap[merge->nheap];
+		}
+
+		if (merge->nheap)
+			pt_sb_merge_sift_down(merge->heap, merge->nheap, 0);
+	}
+
+	if (!merge->nheap)
+		return -pte_eos;
+
+	stream = merge->heap[0];
+	record = &stream->ring[stream->next & stream->mask];
+
+	memset(&item, 0, sizeof(item));
+	item.type = record->type;
+	item.stream = stream->index;
+	item.cpu = stream->cpu;
+	item.errcode = record->errcode;
+	item.tsc = record->tsc;
+	item.offset = record->offset;
+
+	switch (record->type) {
+	case ptsm_block:
+		item.variant.block = &record->variant.block;
+		break;
+
+	case ptsm_event:
+		item.variant.event = &record->variant.event;
+		break;
+
+	case ptsm_error:
+		break;
+	}
+
+	merge->pending = 1;
+
+	if (sizeof(item) < size)
+		size = sizeof(item);
+
+	memcpy(uitem, &item, size);
+
+	return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pt_sb_path.h"
+
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static uint64_t pt_sb_path_hash(const char *sysroot, const char *filename)
+{
+	uint64_t hash;
+
+	hash = 0ull;
+	if (sysroot)
+		hash = pt_hash_str(hash, sysroot);
+
+	return pt_hash_str(hash, filename);
+}
+
+static uint64_t pt_sb_path_section_hash(const struct pt_sb_path *path,
+					uint64_t offset, uint64_t size,
+					uint64_t vaddr)
+{
+	uint64_t hash;
+
+	hash = path->node.hash;
+	hash = pt_hash_u64(hash, offset);
+	hash = pt_hash_u64(hash, size);
+	hash = pt_hash_u64(hash, vaddr);
+
+	return hash;
+}
+
+static void pt_sb_path_free(struct pt_hash_node *node)
+{
+	struct pt_sb_path *path;
+
+	/* The node is the first field in struct pt_sb_path. */
+	path = (struct pt_sb_path *) node;
+	if (!path)
+		return;
+
+	free(path->path);
+	free(path);
+}
+
+static void pt_sb_path_free_section(struct pt_hash_node *node)
+{
+	/* The node is the first field in struct pt_sb_path_section. */
+	free(node);
+}
+
+void pt_sb_path_cache_init(struct pt_sb_path_cache *cache)
+{
+	if (!cache)
+		return;
+
+	pt_hash_table_init(&cache->paths);
+	pt_hash_table_init(&cache->sections);
+}
+
+void pt_sb_path_cache_fini(struct pt_sb_path_cache *cache)
+{
+	if (!cache)
+		return;
+
+	pt_hash_table_fini(&cache->sections, pt_sb_path_free_section);
+	pt_hash_table_fini(&cache->paths, pt_sb_path_free);
+}
+
+static int pt_sb_path_match(const struct pt_sb_path *path,
+			    const char *sysroot, size_t prefix,
+			    const char *filename)
+{
+	if (path->prefix != prefix)
+		return 0;
+
+	if (prefix && (memcmp(path->path, sysroot, prefix) != 0))
+		return 0;
+
+	return strcmp(path->path + prefix, filename) == 0;
+}
+
+int pt_sb_path_get(struct pt_sb_path **ppath, struct pt_sb_path_cache *cache,
+		   const char *sysroot, const char *filename)
+{
+	struct pt_hash_node *node;
+	struct pt_sb_path *path;
+	size_t prefix, length;
+	uint64_t hash;
+	int errcode;
+
+	if (!ppath || !cache || !filename)
+		return -pte_internal;
+
+	prefix = sysroot ? strlen(sysroot) : 0;
+	hash = pt_sb_path_hash(sysroot, filename);
+
+	for (node = pt_hash_table_first(&cache->paths, hash); node;
+	     node = node->next) {
+		if (node->hash != hash)
+			continue;
+
+		path = (struct pt_sb_path *) node;
+		if (!pt_sb_path_match(path, sysroot, prefix, filename))
+			continue;
+
+		*ppath = path;
+		return 0;
+	}
+
+	length = strlen(filename);
+	if ((SIZE_MAX - prefix) <= length)
+		return -pte_overflow;
+
+	path = malloc(sizeof(*path));
+	if (!path)
+		return -pte_nomem;
+
+	memset(path, 0, sizeof(*path));
+
+	path->path = malloc(prefix + length + 1);
+	if (!path->path) {
+		free(path);
+		return -pte_nomem;
+	}
+
+	if (prefix)
+		memcpy(path->path, sysroot, prefix);
+
+	memcpy(path->path + prefix, filename, length + 1);
+
+	path->node.hash = hash;
+	path->prefix = prefix;
+
+	errcode = pt_hash_table_insert(&cache->paths, &path->node);
+	if (errcode < 0) {
+		pt_sb_path_free(&path->node);
+		return errcode;
+	}
+
+	*ppath = path;
+	return 0;
+}
+
+/* Find the cached section of @size bytes at @offset in @path loaded at @vaddr.
+ *
+ * Returns NULL if no such section is found.
+ */
+static struct pt_sb_path_section *
+pt_sb_path_find_section(const struct pt_sb_path_cache *cache,
+			const struct pt_sb_path *path, uint64_t offset,
+			uint64_t size, uint64_t vaddr)
+{
+	struct pt_hash_node *node;
+	uint64_t hash;
+
+	hash = pt_sb_path_section_hash(path, offset, size, vaddr);
+	for (node = pt_hash_table_first(&cache->sections, hash); node;
+	     node = node->next) {
+		struct pt_sb_path_section *section;
+
+		if (node->hash != hash)
+			continue;
+
+		section = (struct pt_sb_path_section *) node;
+		if ((section->path == path) && (section->offset == offset) &&
+		    (section->size == size) && (section->vaddr == vaddr))
+			return section;
+	}
+
+	return NULL;
+}
+
+int pt_sb_path_find_isid(const struct pt_sb_path_cache *cache,
+			 const struct pt_sb_path *path, uint64_t offset,
+			 uint64_t size, uint64_t vaddr)
+{
+	const struct pt_sb_path_section *section;
+
+	if (!cache || !path)
+		return -pte_internal;
+
+	section = pt_sb_path_find_section(cache, path, offset, size, vaddr);
+	if (!section)
+		return 0;
+
+	return section->isid;
+}
+
+int pt_sb_path_add_isid(struct pt_sb_path_cache *cache,
+			const struct pt_sb_path *path, uint64_t offset,
+			uint64_t size, uint64_t vaddr, int isid)
+{
+	struct pt_sb_path_section *section;
+	int errcode;
+
+	if (!cache || !path || (isid <= 0))
+		return -pte_internal;
+
+	section = pt_sb_path_find_section(cache, path, offset, size, vaddr);
+	if (section) {
+		section->isid = isid;
+		return 0;
+	}
+
+	section = malloc(sizeof(*section));
+	if (!section)
+		return -pte_nomem;
+
+	memset(section, 0, sizeof(*section));
+	section->node.hash = pt_sb_path_section_hash(path, offset, size,
+						     vaddr);
+	section->path = path;
+	section->offset = offset;
+	section->size = size;
+	section->vaddr = vaddr;
+	section->isid = isid;
+
+	errcode = pt_hash_table_insert(&cache->sections, &section->node);
+	if (errcode < 0) {
+		free(section);
+		return errcode;
+	}
+
+	return 0;
+}
@@ -0,0 +1,571 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "libipt-sb.h"
+
+#include "intel-pt.h"
+
+
+#ifndef FEATURE_PEVENT
+
+int pt_sb_perf_data_open(struct pt_sb_perf_data **pdata, const char *filename)
+{
+	(void) pdata;
+	(void) filename;
+
+	return -pte_not_supported;
+}
+
+void pt_sb_perf_data_close(struct pt_sb_perf_data *pdata)
+{
+	(void) pdata;
+}
+
+int pt_sb_perf_data_config(struct pt_sb_pevent_config *config,
+			   const struct pt_sb_perf_data *pdata)
+{
+	(void) config;
+	(void) pdata;
+
+	return -pte_not_supported;
+}
+
+int pt_sb_alloc_perf_data_decoders(struct pt_sb_session *session,
+				   const struct pt_sb_perf_data *pdata,
+				   const struct pt_sb_pevent_config *config,
+				   uint32_t cpu)
+{
+	(void) session;
+	(void) pdata;
+	(void) config;
+	(void) cpu;
+
+	return -pte_not_supported;
+}
+
+int pt_sb_perf_data_naux(const struct pt_sb_perf_data *pdata)
+{
+	(void) pdata;
+
+	return -pte_not_supported;
+}
+
+int pt_sb_perf_data_aux(const uint8_t **begin, const uint8_t **end,
+			uint32_t *cpu, struct pt_sb_perf_data *pdata,
+			uint32_t index)
+{
+	(void) begin;
+	(void) end;
+	(void) cpu;
+	(void) pdata;
+	(void) index;
+
+	return -pte_not_supported;
+}
+
+#else /* FEATURE_PEVENT */
+
+#include "pt_sb_perf_data.h"
+#include "pt_sb_pevent.h"
+#include "pt_sb_file.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+static void pt_sb_perf_data_fini(struct pt_sb_perf_data *pdata)
+{
+	uint32_t idx;
+
+	if (!pdata)
+		return;
+
+	for (idx = 0; idx < pdata->naux; ++idx)
+		free(pdata->aux[idx].buffer);
+
+	for (idx = 0; idx < pdata->ncpus; ++idx)
+		free(pdata->cpus[idx].offsets);
+
+	free(pdata->aux);
+	free(pdata->chunks);
+	free(pdata->cpus);
+	free(pdata->filename);
+
+	pt_sb_file_unmap(&pdata->mapping);
+}
+
+/* Find or add @cpu in @pdata's cpus.
+ *
+ * Returns a pointer to the cpu on success, NULL otherwise.
+ */
+static struct pt_sb_perf_data_cpu *
+pt_sb_perf_data_get_cpu(struct pt_sb_perf_data *pdata, uint32_t cpu)
+{
+	struct pt_sb_perf_data_cpu *cpus;
+	uint32_t ncpus, lo, hi;
+
+	if (!pdata)
+		return NULL;
+
+	cpus = pdata->cpus;
+	ncpus = pdata->ncpus;
+
+	/* Most records are for a cpu we've already seen. */
+	lo = 0;
+	hi = ncpus;
+	while (lo < hi) {
+		uint32_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (cpus[mid].cpu == cpu)
+			return &cpus[mid];
+
+		if (cpus[mid].cpu < cpu)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	cpus = realloc(cpus, (ncpus + 1) * sizeof(*cpus));
+	if (!cpus)
+		return NULL;
+
+	memmove(&cpus[lo + 1], &cpus[lo], (ncpus - lo) * sizeof(*cpus));
+	memset(&cpus[lo], 0, sizeof(cpus[lo]));
+	cpus[lo].cpu = cpu;
+
+	pdata->cpus = cpus;
+	pdata->ncpus = ncpus + 1;
+
+	return &cpus[lo];
+}
+
+/* Add the record at @pos for @cpu to @pdata's cpus.
+ *
+ * A NULL @cpu means that the record is not associated with a cpu.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_perf_data_add_record(struct pt_sb_perf_data *pdata,
+				      const uint32_t *cpu, const uint8_t *pos)
+{
+	struct pt_sb_perf_data_cpu *record_cpu;
+	uint64_t *offsets;
+	uint32_t noffsets;
+
+	if (!pdata || !pos)
+		return -pte_internal;
+
+	record_cpu = pt_sb_perf_data_get_cpu(pdata, cpu ? *cpu : UINT32_MAX);
+	if (!record_cpu)
+		return -pte_nomem;
+
+	noffsets = record_cpu->noffsets;
+	offsets = record_cpu->offsets;
+	if (record_cpu->coffsets <= noffsets) {
+		uint32_t capacity;
+
+		capacity = record_cpu->coffsets ? record_cpu->coffsets * 2 : 64;
+		if (capacity <= noffsets)
+			return -pte_nomem;
+
+		offsets = realloc(offsets, capacity * sizeof(*offsets));
+		if (!offsets)
+			return -pte_nomem;
+
+		record_cpu->offsets = offsets;
+		record_cpu->coffsets = capacity;
+	}
+
+	offsets[noffsets] = (uint64_t) (pos - pdata->file.begin);
+	record_cpu->noffsets = noffsets + 1;
+
+	return 0;
+}
+
+/* Find or add the trace buffer for AUX area mmap @idx.
+ *
+ * Returns a pointer to the trace buffer on success, NULL otherwise.
+ */
+static struct pt_sb_perf_data_aux *
+pt_sb_perf_data_get_aux(struct pt_sb_perf_data *pdata, uint32_t idx,
+			uint32_t cpu)
+{
+	struct pt_sb_perf_data_aux *aux;
+	uint32_t naux, lo, hi;
+
+	if (!pdata)
+		return NULL;
+
+	aux = pdata->aux;
+	naux = pdata->naux;
+
+	lo = 0;
+	hi = naux;
+	while (lo < hi) {
+		uint32_t mid;
+
+		mid = lo + ((hi - lo) / 2);
+		if (aux[mid].idx == idx)
+			return &aux[mid];
+
+		if (aux[mid].idx < idx)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	aux = realloc(aux, (naux + 1) * sizeof(*aux));
+	if (!aux)
+		return NULL;
+
+	memmove(&aux[lo + 1], &aux[lo], (naux - lo) * sizeof(*aux));
+	memset(&aux[lo], 0, sizeof(aux[lo]));
+	aux[lo].idx = idx;
+	aux[lo].cpu = cpu;
+
+	pdata->aux = aux;
+	pdata->naux = naux + 1;
+
+	return &aux[lo];
+}
+
+/* Add the trace in the AUXTRACE record @auxtrace to @pdata.
+ *
+ * The trace ends at @end.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_perf_data_add_chunk(struct pt_sb_perf_data *pdata,
+				     const struct pev_record_auxtrace *auxtrace,
+				     const uint8_t *end)
+{
+	struct pt_sb_perf_data_chunk *chunks, *chunk;
+	struct pt_sb_perf_data_aux *aux;
+	uint32_t nchunks;
+
+	if (!pdata || !auxtrace || !end)
+		return -pte_internal;
+
+	nchunks = pdata->nchunks;
+	chunks = pdata->chunks;
+	if (pdata->cchunks <= nchunks) {
+		uint32_t capacity;
+
+		capacity = pdata->cchunks ? pdata->cchunks * 2 : 64;
+		if (capacity <= nchunks)
+			return -pte_nomem;
+
+		chunks = realloc(chunks, capacity * sizeof(*chunks));
+		if (!chunks)
+			return -pte_nomem;
+
+		pdata->chunks = chunks;
+		pdata->cchunks = capacity;
+	}
+
+	aux = pt_sb_perf_data_get_aux(pdata, auxtrace->idx, auxtrace->cpu);
+	if (!aux)
+		return -pte_nomem;
+
+	chunk = &chunks[nchunks];
+	chunk->begin = end - auxtrace->size;
+	chunk->end = end;
+	chunk->idx = auxtrace->idx;
+
+	pdata->nchunks = nchunks + 1;
+
+	/* We provide a single chunk directly and concatenate several chunks
+	 * on request.
+	 */
+	if (!aux->nchunks) {
+		aux->begin = chunk->begin;
+		aux->end = chunk->end;
+	} else {
+		aux->begin = NULL;
+		aux->end = NULL;
+	}
+
+	aux->size += auxtrace->size;
+	aux->nchunks += 1;
+
+	return 0;
+}
+
+/* Collect the cpus and the trace in @pdata's data section.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_perf_data_scan(struct pt_sb_perf_data *pdata)
+{
+	const uint8_t *pos, *end;
+	int size;
+
+	if (!pdata)
+		return -pte_internal;
+
+	end = pdata->file.end;
+	for (pos = pdata->file.begin; pos < end; pos += size) {
+		struct pev_event event;
+		int errcode;
+
+		size = pev_read(&event, pos, end, &pdata->file.config);
+		if (size < 0)
+			return size;
+
+		if (!size)
+			return -pte_bad_packet;
+
+		switch (event.type) {
+		case PEV_RECORD_AUXTRACE: {
+			const struct pev_record_auxtrace *auxtrace;
+
+			auxtrace = event.record.auxtrace;
+
+			errcode = pt_sb_perf_data_add_chunk(pdata, auxtrace,
+							    pos + size);
+		}
+			break;
+
+		default:
+			/* Records synthesized by perf do not carry samples and
+			 * are skipped by the sideband decoders.
+			 */
+			if (PEV_RECORD_USER_TYPE_START <= event.type)
+				continue;
+
+			errcode = pt_sb_perf_data_add_record(pdata,
+							     event.sample.cpu,
+							     pos);
+			break;
+		}
+
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+int pt_sb_perf_data_open(struct pt_sb_perf_data **ppdata, const char *filename)
+{
+	struct pt_sb_perf_data *pdata;
+	size_t size;
+	int errcode;
+
+	if (!ppdata || !filename)
+		return -pte_invalid;
+
+	pdata = malloc(sizeof(*pdata));
+	if (!pdata)
+		return -pte_nomem;
+
+	memset(pdata, 0, sizeof(*pdata));
+
+	errcode = pt_sb_file_map(&pdata->mapping, filename, 0, 0);
+	if (errcode < 0) {
+		free(pdata);
+		return errcode;
+	}
+
+	errcode = pev_file_init(&pdata->file, pdata->mapping.begin,
+				pdata->mapping.end);
+	if (errcode < 0)
+		goto err;
+
+	pdata->begin = (size_t) (pdata->file.begin - pdata->mapping.begin);
+	pdata->end = (size_t) (pdata->file.end - pdata->mapping.begin);
+
+	size = strlen(filename) + 1;
+	pdata->filename = malloc(size);
+	if (!pdata->filename) {
+		errcode = -pte_nomem;
+		goto err;
+	}
+
+	memcpy(pdata->filename, filename, size);
+
+	errcode = pt_sb_perf_data_scan(pdata);
+	if (errcode < 0)
+		goto err;
+
+	*ppdata = pdata;
+	return 0;
+
+err:
+	pt_sb_perf_data_fini(pdata);
+	free(pdata);
+
+	return errcode;
+}
+
+void pt_sb_perf_data_close(struct pt_sb_perf_data *pdata)
+{
+	pt_sb_perf_data_fini(pdata);
+	free(pdata);
+}
+
+int pt_sb_perf_data_config(struct pt_sb_pevent_config *config,
+			   const struct pt_sb_perf_data *pdata)
+{
+	if (!config || !pdata)
+		return -pte_invalid;
+
+	config->filename = pdata->filename;
+	config->begin = pdata->begin;
+	config->end = pdata->end;
+	config->sample_type = pdata->file.config.sample_type;
+	config->time_shift = pdata->file.config.time_shift;
+	config->time_mult = pdata->file.config.time_mult;
+	config->time_zero = pdata->file.config.time_zero;
+
+	return 0;
+}
+
+int pt_sb_alloc_perf_data_decoders(struct pt_sb_session *session,
+				   const struct pt_sb_perf_data *pdata,
+				   const struct pt_sb_pevent_config *config,
+				   uint32_t cpu)
+{
+	struct pt_sb_pevent_config pev;
+	uint32_t idx, primary;
+	int errcode;
+
+	if (!session || !pdata || !config)
+		return -pte_invalid;
+
+	if (config->size < sizeof(pev))
+		return -pte_invalid;
+
+	pev = *config;
+	pev.size = sizeof(pev);
+
+	errcode = pt_sb_perf_data_config(&pev, pdata);
+	if (errcode < 0)
+		return errcode;
+
+	primary = config->primary;
+	for (idx = 0; idx < pdata->ncpus; ++idx) {
+		const struct pt_sb_perf_data_cpu *record_cpu;
+
+		record_cpu = &pdata->cpus[idx];
+
+		pev.primary = (primary && (record_cpu->cpu == cpu)) ? 1 : 0;
+
+		errcode = pt_sb_alloc_perf_data_decoder(session, &pev,
+							record_cpu->cpu,
+							pdata->file.begin,
+							pdata->file.end,
+							record_cpu->offsets,
+							record_cpu->noffsets);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	return 0;
+}
+
+int pt_sb_perf_data_naux(const struct pt_sb_perf_data *pdata)
+{
+	if (!pdata)
+		return -pte_invalid;
+
+	return (int) pdata->naux;
+}
+
+/* Concatenate the trace chunks of @aux.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_perf_data_concat(struct pt_sb_perf_data_aux *aux,
+				  const struct pt_sb_perf_data *pdata)
+{
+	uint8_t *buffer, *pos;
+	uint32_t idx;
+
+	if (!aux || !pdata)
+		return -pte_internal;
+
+	if (SIZE_MAX <= aux->size)
+		return -pte_nomem;
+
+	/* Avoid a zero-sized allocation for empty chunks. */
+	buffer = malloc((size_t) aux->size + 1);
+	if (!buffer)
+		return -pte_nomem;
+
+	pos = buffer;
+	for (idx = 0; idx < pdata->nchunks; ++idx) {
+		const struct pt_sb_perf_data_chunk *chunk;
+		size_t size;
+
+		chunk = &pdata->chunks[idx];
+		if (chunk->idx != aux->idx)
+			continue;
+
+		size = (size_t) (chunk->end - chunk->begin);
+		memcpy(pos, chunk->begin, size);
+		pos += size;
+	}
+
+	aux->buffer = buffer;
+	aux->begin = buffer;
+	aux->end = pos;
+
+	return 0;
+}
+
+int pt_sb_perf_data_aux(const uint8_t **begin, const uint8_t **end,
+			uint32_t *cpu, struct pt_sb_perf_data *pdata,
+			uint32_t index)
+{
+	struct pt_sb_perf_data_aux *aux;
+
+	if (!begin || !end || !cpu || !pdata)
+		return -pte_invalid;
+
+	if (pdata->naux <= index)
+		return -pte_invalid;
+
+	aux = &pdata->aux[index];
+	if (!aux->begin) {
+		int errcode;
+
+		errcode = pt_sb_perf_data_concat(aux, pdata);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	*begin = aux->begin;
+	*end = aux->end;
+	*cpu = aux->cpu;
+
+	return 0;
+}
+
+#endif /* FEATURE_PEVENT */
@@ -54,10 +54,6 @@ int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
 #include <stdlib.h>
 #include <string.h>
 
-#if defined(_MSC_VER) && (_MSC_VER < 1900)
-#  define snprintf _snprintf_c
-#endif
-
 
 #ifndef FEATURE_ELF
 
@@ -163,29 +159,36 @@ static int pt_sb_pevent_error(const struct pt_sb_session *session, int errcode,
 }
 
 static int pt_sb_pevent_track_abi(struct pt_sb_context *context,
-				  const char *filename)
+				  struct pt_sb_path *path)
 {
-	FILE *file;
-	int abi;
-
-	if (!context || !filename)
+	if (!context || !path)
 		return -pte_internal;
 
 	if (context->abi)
 		return 0;
 
-	file = fopen(filename, "rb");
-	if (!file)
-		return 0;
+	/* We determine the ABI of each file only once. */
+	if (!path->has_abi) {
+		FILE *file;
+		int abi;
+
+		abi = pt_sb_abi_unknown;
 
-	abi = elf_get_abi(file);
+		file = fopen(path->path, "rb");
+		if (file) {
+			abi = elf_get_abi(file);
 
-	fclose(file);
+			fclose(file);
 
-	if (abi < 0)
-		return abi;
+			if (abi < 0)
+				return abi;
+		}
+
+		path->abi = (enum pt_sb_abi) abi;
+		path->has_abi = 1;
+	}
 
-	context->abi = (enum pt_sb_abi) abi;
+	context->abi = path->abi;
 
 	return 0;
 }
@@ -201,40 +204,569 @@ static int pt_sb_pevent_find_vdso(const char **pvdso,
 
 	vdso = NULL;
 
-	switch (context->abi) {
-	case pt_sb_abi_unknown:
-		break;
+	switch (context->abi) {
+	case pt_sb_abi_unknown:
+		break;
+
+	case pt_sb_abi_x64:
+		vdso = priv->vdso_x64;
+		break;
+
+	case pt_sb_abi_x32:
+		vdso = priv->vdso_x32;
+		break;
+
+	case pt_sb_abi_ia32:
+		vdso = priv->vdso_ia32;
+		break;
+	}
+
+	if (!vdso)
+		return -pte_bad_config;
+
+	*pvdso = vdso;
+
+	return 0;
+}
+
+/* Check whether @event is meant for @priv in a perf.data file. */
+static int pt_sb_pevent_is_ours(const struct pev_event *event,
+				const struct pt_sb_pevent_priv *priv)
+{
+	uint32_t cpu;
+
+	/* Records synthesized by perf are of no interest to us. */
+	if (PEV_RECORD_USER_TYPE_START <= event->type)
+		return 0;
+
+	cpu = event->sample.cpu ? *event->sample.cpu : UINT32_MAX;
+
+	return cpu == priv->cpu;
+}
+
+/* Find the first of @priv's records at or after @pos in a perf.data file.
+ *
+ * Returns a pointer to the record or to the end of the sideband data.
+ */
+static const uint8_t *
+pt_sb_pevent_next_record(const uint8_t *pos,
+			 const struct pt_sb_pevent_priv *priv)
+{
+	uint64_t offset;
+	uint32_t begin, end;
+
+	offset = (uint64_t) (pos - priv->begin);
+
+	begin = 0;
+	end = priv->noffsets;
+	while (begin < end) {
+		uint32_t mid;
+
+		mid = begin + ((end - begin) / 2);
+		if (priv->offsets[mid] < offset)
+			begin = mid + 1;
+		else
+			end = mid;
+	}
+
+	if (priv->noffsets <= begin)
+		return priv->end;
+
+	return priv->begin + priv->offsets[begin];
+}
+
+/* Read the next perf event record at or after @ppos into @event.
+ *
+ * Skips records not meant for @priv and updates @ppos to point to the record
+ * that has been read or to the position of the error.
+ *
+ * This only reads from @priv's read-only configuration so it may be called
+ * from the prefetch thread.
+ *
+ * Returns the size of the record in bytes on success, a negative error code
+ * otherwise.
+ */
+static int pt_sb_pevent_read(struct pev_event *event, const uint8_t **ppos,
+			     const struct pt_sb_pevent_priv *priv)
+{
+	const uint8_t *pos;
+	uint64_t tsc, offset;
+	int size;
+
+	if (!event || !ppos || !priv)
+		return -pte_internal;
+
+	pos = *ppos;
+	if (priv->offsets)
+		pos = pt_sb_pevent_next_record(pos, priv);
+
+	for (;; pos += size) {
+		size = pev_read_plan(event, pos, priv->end, &priv->plan);
+		if (size < 0)
+			break;
+
+		/* We would not make progress skipping an empty record. */
+		if (!size) {
+			size = -pte_bad_packet;
+			break;
+		}
+
+		if (!priv->perf_data || pt_sb_pevent_is_ours(event, priv))
+			break;
+	}
+
+	*ppos = pos;
+	if (size < 0)
+		return size;
+
+	/* If we don't have a time sample, there's nothing to adjust. */
+	if (!event->sample.time)
+		return size;
+
+	/* Subtract a pre-defined offset to cause sideband events from this
+	 * channel to be applied a little earlier.
+	 *
+	 * We don't want @tsc to wrap around when subtracting @offset, though.
+	 * This would suddenly push the event very far out and essentially block
+	 * this sideband channel.
+	 *
+	 * On the other hand, we want to allow 'negative' offsets.  And for
+	 * those, we want to avoid wrapping around in the other direction.
+	 */
+	offset = priv->tsc_offset;
+	tsc = event->sample.tsc;
+	if (offset <= tsc)
+		tsc -= offset;
+	else {
+		if (0ll <= (int64_t) offset)
+			tsc = 0ull;
+		else {
+			if (tsc <= offset)
+				tsc -= offset;
+			else
+				tsc = UINT64_MAX;
+		}
+	}
+
+	/* We update the event record's timestamp, as well, so we will print the
+	 * updated tsc and apply the event at the right time.
+	 *
+	 * Note that we only update our copy of the record, not the sideband
+	 * stream.
+	 */
+	event->sample.tsc = tsc;
+
+	return size;
+}
+
+#if defined(FEATURE_THREADS)
+
+static int pt_sb_pevent_prefetch_lock(struct pt_sb_pevent_prefetch *prefetch)
+{
+	int errcode;
+
+	if (!prefetch)
+		return -pte_internal;
+
+	errcode = mtx_lock(&prefetch->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+static int
+pt_sb_pevent_prefetch_unlock(struct pt_sb_pevent_prefetch *prefetch)
+{
+	int errcode;
+
+	if (!prefetch)
+		return -pte_internal;
+
+	errcode = mtx_unlock(&prefetch->lock);
+	if (errcode != thrd_success)
+		return -pte_bad_lock;
+
+	return 0;
+}
+
+/* Wait for free slots in @prefetch's ring.
+ *
+ * On success, provides the index of the first free slot in @tail and the
+ * number of free slots in @free.  Sets @free to zero if the prefetch thread
+ * shall terminate.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_prefetch_reserve(uint32_t *tail, uint32_t *free,
+					 struct pt_sb_pevent_prefetch *prefetch)
+{
+	uint32_t used;
+	int errcode;
+
+	if (!tail || !free || !prefetch)
+		return -pte_internal;
+
+	errcode = pt_sb_pevent_prefetch_lock(prefetch);
+	if (errcode < 0)
+		return errcode;
+
+	for (;;) {
+		if (prefetch->stop) {
+			*free = 0;
+			break;
+		}
+
+		used = prefetch->tail - prefetch->head;
+		if (used < pt_sb_pevent_prefetch_size) {
+			*tail = prefetch->tail;
+			*free = pt_sb_pevent_prefetch_size - used;
+			break;
+		}
+
+		errcode = cnd_wait(&prefetch->released, &prefetch->lock);
+		if (errcode != thrd_success) {
+			(void) pt_sb_pevent_prefetch_unlock(prefetch);
+			return -pte_bad_lock;
+		}
+	}
+
+	return pt_sb_pevent_prefetch_unlock(prefetch);
+}
+
+/* Publish records up to @tail in @prefetch's ring to the consumer.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_prefetch_publish(struct pt_sb_pevent_prefetch *prefetch,
+					 uint32_t tail)
+{
+	int errcode;
+
+	errcode = pt_sb_pevent_prefetch_lock(prefetch);
+	if (errcode < 0)
+		return errcode;
+
+	prefetch->tail = tail;
+
+	errcode = cnd_signal(&prefetch->published);
+	if (errcode != thrd_success) {
+		(void) pt_sb_pevent_prefetch_unlock(prefetch);
+		return -pte_bad_lock;
+	}
+
+	return pt_sb_pevent_prefetch_unlock(prefetch);
+}
+
+/* Parse @priv's sideband records ahead of the sideband decoder in batches
+ * until we encounter the first error, including the end of the sideband data,
+ * or until we are asked to terminate.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_prefetch_produce(struct pt_sb_pevent_prefetch *prefetch,
+					 const struct pt_sb_pevent_priv *priv)
+{
+	const uint8_t *pos;
+
+	pos = priv->next;
+	for (;;) {
+		uint32_t tail, free, count;
+		int errcode, status;
+
+		errcode = pt_sb_pevent_prefetch_reserve(&tail, &free, prefetch);
+		if (errcode < 0)
+			return errcode;
+
+		if (!free)
+			return 0;
+
+		if (pt_sb_pevent_prefetch_batch < free)
+			free = pt_sb_pevent_prefetch_batch;
+
+		status = 0;
+		for (count = 0; count < free;) {
+			struct pt_sb_pevent_record *record;
+
+			record = &prefetch->ring[(tail + count) %
+						 pt_sb_pevent_prefetch_size];
+
+			status = pt_sb_pevent_read(&record->event, &pos, priv);
+
+			record->pos = pos;
+			record->status = status;
+
+			count += 1;
+
+			if (status < 0)
+				break;
+
+			pos += status;
+		}
+
+		errcode = pt_sb_pevent_prefetch_publish(prefetch, tail + count);
+		if (errcode < 0)
+			return errcode;
+
+		if (status < 0)
+			return 0;
+	}
+}
+
+/* Tell the consumer that the prefetch thread exited with @status.
+ *
+ * The prefetch thread does not touch @prefetch after this.
+ */
+static void pt_sb_pevent_prefetch_exit(struct pt_sb_pevent_prefetch *prefetch,
+				       int status)
+{
+	int errcode;
+
+	/* If we can't lock, neither can the consumer.  It will not wait. */
+	errcode = pt_sb_pevent_prefetch_lock(prefetch);
+	if (errcode < 0)
+		return;
+
+	prefetch->exit_status = status;
+	prefetch->exited = 1;
+
+	(void) cnd_broadcast(&prefetch->published);
+	(void) pt_sb_pevent_prefetch_unlock(prefetch);
+}
+
+/* The prefetch thread.
+ *
+ * Parses @arg's sideband records ahead of the sideband decoder.
+ */
+static int pt_sb_pevent_prefetch_thread(void *arg)
+{
+	struct pt_sb_pevent_prefetch *prefetch;
+	struct pt_sb_pevent_priv *priv;
+	int status;
+
+	priv = (struct pt_sb_pevent_priv *) arg;
+	if (!priv)
+		return -pte_internal;
+
+	prefetch = priv->prefetch;
+	if (!prefetch)
+		return -pte_internal;
+
+	status = pt_sb_pevent_prefetch_produce(prefetch, priv);
+	pt_sb_pevent_prefetch_exit(prefetch, status);
+
+	return status;
+}
+
+/* Release consumed records and wait for published records.
+ *
+ * If the prefetch thread exited without publishing an error record, adds an
+ * error record at @pos carrying the thread's exit status.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_prefetch_sync(struct pt_sb_pevent_prefetch *prefetch,
+				      const uint8_t *pos, int wait)
+{
+	int errcode;
+
+	errcode = pt_sb_pevent_prefetch_lock(prefetch);
+	if (errcode < 0)
+		return errcode;
+
+	prefetch->head = prefetch->next;
+
+	errcode = cnd_signal(&prefetch->released);
+	if (errcode != thrd_success) {
+		(void) pt_sb_pevent_prefetch_unlock(prefetch);
+		return -pte_bad_lock;
+	}
+
+	while (wait && (prefetch->tail == prefetch->next) &&
+	       !prefetch->exited) {
+		errcode = cnd_wait(&prefetch->published, &prefetch->lock);
+		if (errcode != thrd_success) {
+			(void) pt_sb_pevent_prefetch_unlock(prefetch);
+			return -pte_bad_lock;
+		}
+	}
+
+	/* We consumed all records and we own the ring.  The prefetch thread
+	 * only exits without error after publishing an error record.
+	 */
+	if (wait && (prefetch->tail == prefetch->next)) {
+		struct pt_sb_pevent_record *record;
+
+		errcode = prefetch->exit_status;
+		if (errcode >= 0)
+			errcode = -pte_internal;
+
+		record = &prefetch->ring[prefetch->tail %
+					 pt_sb_pevent_prefetch_size];
+		record->pos = pos;
+		record->status = errcode;
+
+		prefetch->tail += 1;
+	}
+
+	prefetch->available = prefetch->tail - prefetch->next;
+
+	return pt_sb_pevent_prefetch_unlock(prefetch);
+}
+
+static int pt_sb_pevent_prefetch_fetch(uint64_t *ptsc,
+				       struct pt_sb_pevent_priv *priv)
+{
+	const struct pt_sb_pevent_record *record;
+	struct pt_sb_pevent_prefetch *prefetch;
+	int errcode;
+
+	if (!ptsc || !priv)
+		return -pte_internal;
+
+	prefetch = priv->prefetch;
+	if (!prefetch)
+		return -pte_internal;
+
+	if (!prefetch->available) {
+		errcode = pt_sb_pevent_prefetch_sync(prefetch, priv->next, 1);
+		if (errcode < 0)
+			return errcode;
+
+		if (!prefetch->available)
+			return -pte_internal;
+	}
+
+	record = &prefetch->ring[prefetch->next % pt_sb_pevent_prefetch_size];
+
+	/* Consume the current record early so we get the offset right when
+	 * diagnosing fetch errors.
+	 *
+	 * The prefetch thread stopped after an error.  We leave the record in
+	 * place and report the same error again if asked to fetch again.
+	 */
+	priv->current = record->pos;
+	if (record->status < 0)
+		return record->status;
+
+	priv->event = record->event;
+	priv->next = record->pos + record->status;
+
+	prefetch->next += 1;
+	prefetch->available -= 1;
+
+	/* If we don't have a time sample, set @ptsc to zero to process the
+	 * record immediately.
+	 */
+	if (!priv->event.sample.time)
+		*ptsc = 0ull;
+	else
+		*ptsc = priv->event.sample.tsc;
+
+	/* Let the prefetch thread refill the ring while we're consuming the
+	 * rest of our records.
+	 */
+	if (pt_sb_pevent_prefetch_batch <= (prefetch->next - prefetch->head))
+		return pt_sb_pevent_prefetch_sync(prefetch, priv->next, 0);
+
+	return 0;
+}
+
+static int pt_sb_pevent_prefetch_start(struct pt_sb_pevent_priv *priv)
+{
+	struct pt_sb_pevent_prefetch *prefetch;
+	int errcode;
+
+	if (!priv)
+		return -pte_internal;
+
+	prefetch = malloc(sizeof(*prefetch));
+	if (!prefetch)
+		return -pte_nomem;
+
+	memset(prefetch, 0, sizeof(*prefetch));
+
+	errcode = mtx_init(&prefetch->lock, mtx_plain);
+	if (errcode != thrd_success)
+		goto out_mem;
+
+	errcode = cnd_init(&prefetch->published);
+	if (errcode != thrd_success)
+		goto out_lock;
+
+	errcode = cnd_init(&prefetch->released);
+	if (errcode != thrd_success)
+		goto out_published;
+
+	priv->prefetch = prefetch;
+
+	errcode = thrd_create(&prefetch->thread, pt_sb_pevent_prefetch_thread,
+			      priv);
+	if (errcode != thrd_success) {
+		priv->prefetch = NULL;
+		goto out_released;
+	}
+
+	return 0;
+
+out_released:
+	cnd_destroy(&prefetch->released);
+
+out_published:
+	cnd_destroy(&prefetch->published);
+
+out_lock:
+	mtx_destroy(&prefetch->lock);
+
+out_mem:
+	free(prefetch);
+	return -pte_bad_lock;
+}
+
+static void pt_sb_pevent_prefetch_stop(struct pt_sb_pevent_priv *priv)
+{
+	struct pt_sb_pevent_prefetch *prefetch;
+	int errcode;
+
+	if (!priv)
+		return;
 
-	case pt_sb_abi_x64:
-		vdso = priv->vdso_x64;
-		break;
+	prefetch = priv->prefetch;
+	if (!prefetch)
+		return;
 
-	case pt_sb_abi_x32:
-		vdso = priv->vdso_x32;
-		break;
+	errcode = pt_sb_pevent_prefetch_lock(prefetch);
+	if (!errcode) {
+		prefetch->stop = 1;
 
-	case pt_sb_abi_ia32:
-		vdso = priv->vdso_ia32;
-		break;
+		(void) cnd_broadcast(&prefetch->released);
+		(void) pt_sb_pevent_prefetch_unlock(prefetch);
 	}
 
-	if (!vdso)
-		return -pte_bad_config;
+	(void) thrd_join(&prefetch->thread, NULL);
 
-	*pvdso = vdso;
+	cnd_destroy(&prefetch->released);
+	cnd_destroy(&prefetch->published);
+	mtx_destroy(&prefetch->lock);
+	free(prefetch);
 
-	return 0;
+	priv->prefetch = NULL;
 }
 
-static void pt_sb_pevent_dtor(void *priv_arg)
+#endif /* defined(FEATURE_THREADS) */
+
+static void pt_sb_pevent_fini(struct pt_sb_pevent_priv *priv)
 {
-	struct pt_sb_pevent_priv *priv;
 	struct pt_sb_context *context;
 
-	priv = (struct pt_sb_pevent_priv *) priv_arg;
 	if (!priv)
 		return;
 
+#if defined(FEATURE_THREADS)
+	/* Stop prefetching before we release the sideband data. */
+	pt_sb_pevent_prefetch_stop(priv);
+#endif /* defined(FEATURE_THREADS) */
+
 	context = priv->next_context;
 	if (context)
 		pt_sb_ctx_put(context);
@@ -248,7 +780,18 @@ static void pt_sb_pevent_dtor(void *priv_arg)
 	free(priv->vdso_x64);
 	free(priv->vdso_x32);
 	free(priv->vdso_ia32);
-	free(priv->begin);
+	pt_sb_file_unmap(&priv->mapping);
+}
+
+static void pt_sb_pevent_dtor(void *priv_arg)
+{
+	struct pt_sb_pevent_priv *priv;
+
+	priv = (struct pt_sb_pevent_priv *) priv_arg;
+	if (!priv)
+		return;
+
+	pt_sb_pevent_fini(priv);
 	free(priv);
 }
 
@@ -281,15 +824,20 @@ static int pt_sb_pevent_init_path(char **dst, const char *src)
 	return 0;
 }
 
-int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
-		      const struct pt_sb_pevent_config *config)
+/* Initialize @priv from @config for the sideband data in [@begin; @end).
+ *
+ * The sideband data is not owned by @priv.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
+static int pt_sb_pevent_init_data(struct pt_sb_pevent_priv *priv,
+				  const struct pt_sb_pevent_config *config,
+				  const uint8_t *begin, const uint8_t *end)
 {
 	const char *filename;
-	size_t size;
-	void *buffer;
 	int errcode;
 
-	if (!priv || !config)
+	if (!priv || !config || !begin || (end < begin))
 		return -pte_internal;
 
 	/* This is the first version - we need all the fields. */
@@ -300,45 +848,40 @@ int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
 	if (!filename)
 		return -pte_invalid;
 
-	buffer = NULL;
-	size = 0;
-	errcode = pt_sb_file_load(&buffer, &size, filename,
-				  config->begin, config->end);
-	if (errcode < 0)
-		return errcode;
-
 	memset(priv, 0, sizeof(*priv));
-	priv->begin = (uint8_t *) buffer;
-	priv->end = (uint8_t *) buffer + size;
-	priv->next = (uint8_t *) buffer;
+
+	priv->begin = begin;
+	priv->end = end;
+	priv->next = begin;
+	priv->primary = config->primary ? 1 : 0;
 
 	errcode = pt_sb_pevent_init_path(&priv->filename, filename);
 	if (errcode < 0) {
-		pt_sb_pevent_dtor(priv);
+		pt_sb_pevent_fini(priv);
 		return errcode;
 	}
 
 	errcode = pt_sb_pevent_init_path(&priv->sysroot, config->sysroot);
 	if (errcode < 0) {
-		pt_sb_pevent_dtor(priv);
+		pt_sb_pevent_fini(priv);
 		return errcode;
 	}
 
 	errcode = pt_sb_pevent_init_path(&priv->vdso_x64, config->vdso_x64);
 	if (errcode < 0) {
-		pt_sb_pevent_dtor(priv);
+		pt_sb_pevent_fini(priv);
 		return errcode;
 	}
 
 	errcode = pt_sb_pevent_init_path(&priv->vdso_x32, config->vdso_x32);
 	if (errcode < 0) {
-		pt_sb_pevent_dtor(priv);
+		pt_sb_pevent_fini(priv);
 		return errcode;
 	}
 
 	errcode = pt_sb_pevent_init_path(&priv->vdso_ia32, config->vdso_ia32);
 	if (errcode < 0) {
-		pt_sb_pevent_dtor(priv);
+		pt_sb_pevent_fini(priv);
 		return errcode;
 	}
 
@@ -348,9 +891,49 @@ int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
 	priv->pev.time_mult = config->time_mult;
 	priv->pev.time_zero = config->time_zero;
 
+	errcode = pev_plan_init(&priv->plan, &priv->pev);
+	if (errcode < 0) {
+		pt_sb_pevent_fini(priv);
+		return errcode;
+	}
+
 	priv->kernel_start = config->kernel_start;
 	priv->tsc_offset = config->tsc_offset;
 	priv->location = ploc_unknown;
+	priv->cpu = UINT32_MAX;
+
+	return 0;
+}
+
+int pt_sb_pevent_init(struct pt_sb_pevent_priv *priv,
+		      const struct pt_sb_pevent_config *config)
+{
+	struct pt_sb_file_mapping mapping;
+	int errcode;
+
+	if (!priv || !config)
+		return -pte_internal;
+
+	/* This is the first version - we need all the fields. */
+	if (config->size < sizeof(*config))
+		return -pte_invalid;
+
+	if (!config->filename)
+		return -pte_invalid;
+
+	errcode = pt_sb_file_map(&mapping, config->filename, config->begin,
+				 config->end);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_pevent_init_data(priv, config, mapping.begin,
+					 mapping.end);
+	if (errcode < 0) {
+		pt_sb_file_unmap(&mapping);
+		return errcode;
+	}
+
+	priv->mapping = mapping;
 
 	return 0;
 }
@@ -359,21 +942,24 @@ static int pt_sb_pevent_fetch(uint64_t *ptsc, struct pt_sb_pevent_priv *priv)
 {
 	struct pev_event *event;
 	const uint8_t *pos;
-	uint64_t tsc, offset;
 	int size;
 
 	if (!ptsc || !priv)
 		return -pte_internal;
 
+#if defined(FEATURE_THREADS)
+	if (priv->prefetch)
+		return pt_sb_pevent_prefetch_fetch(ptsc, priv);
+#endif /* defined(FEATURE_THREADS) */
+
 	pos = priv->next;
 	event = &priv->event;
 
 	/* Consume the current record early so we get the offset right when
 	 * diagnosing fetch errors.
 	 */
+	size = pt_sb_pevent_read(event, &pos, priv);
 	priv->current = pos;
-
-	size = pev_read(event, pos, priv->end, &priv->pev);
 	if (size < 0)
 		return size;
 
@@ -382,43 +968,10 @@ static int pt_sb_pevent_fetch(uint64_t *ptsc, struct pt_sb_pevent_priv *priv)
 	/* If we don't have a time sample, set @ptsc to zero to process the
 	 * record immediately.
 	 */
-	if (!event->sample.time) {
+	if (!event->sample.time)
 		*ptsc = 0ull;
-		return 0;
-	}
-
-	/* Subtract a pre-defined offset to cause sideband events from this
-	 * channel to be applied a little earlier.
-	 *
-	 * We don't want @tsc to wrap around when subtracting @offset, though.
-	 * This would suddenly push the event very far out and essentially block
-	 * this sideband channel.
-	 *
-	 * On the other hand, we want to allow 'negative' offsets.  And for
-	 * those, we want to avoid wrapping around in the other direction.
-	 */
-	offset = priv->tsc_offset;
-	tsc = event->sample.tsc;
-	if (offset <= tsc)
-		tsc -= offset;
-	else {
-		if (0ll <= (int64_t) offset)
-			tsc = 0ull;
-		else {
-			if (tsc <= offset)
-				tsc -= offset;
-			else
-				tsc = UINT64_MAX;
-		}
-	}
-
-	/* We update the event record's timestamp, as well, so we will print the
-	 * updated tsc and apply the event at the right time.
-	 *
-	 * Note that we only update our copy in @priv, not the sideband stream.
-	 */
-	event->sample.tsc = tsc;
-	*ptsc = tsc;
+	else
+		*ptsc = event->sample.tsc;
 
 	return 0;
 }
@@ -1097,8 +1650,13 @@ static int pt_sb_pevent_fork(struct pt_sb_session *session,
 	if (!pimage || !image)
 		return -pte_internal;
 
-	/* Initialize the child's image with its parent's. */
-	return pt_image_copy(image, pimage);
+	/* Initialize the child's image with its parent's.
+	 *
+	 * The parent's image already contains the kernel sections.  The two
+	 * images share their sections until either of them is modified.  A
+	 * child that exec's right away never needs its own copy.
+	 */
+	return pt_image_share(image, pimage);
 }
 
 static int pt_sb_pevent_exec(struct pt_sb_session *session,
@@ -1179,11 +1737,11 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 			    uint64_t size, uint64_t vaddr)
 {
 	struct pt_sb_context *context;
+	struct pt_sb_path *path;
 	const char *sysroot;
-	char buffer[FILENAME_MAX];
 	int errcode;
 
-	if (!priv || !filename)
+	if (!session || !priv || !filename)
 		return -pte_internal;
 
 	/* Get the context for this process. */
@@ -1210,6 +1768,9 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 			if (errcode != 0)
 				return pt_sb_pevent_error(session, errcode,
 							  priv);
+
+			/* The vdso files are given with their full path. */
+			sysroot = NULL;
 		} else
 			return pt_sb_pevent_error(session, ptse_section_lost,
 						  priv);
@@ -1232,22 +1793,24 @@ static int pt_sb_pevent_map(struct pt_sb_session *session,
 		 * We will likely fail with -pte_nomap later on.
 		 */
 		return pt_sb_pevent_error(session, ptse_section_lost, priv);
-
-	} else if (sysroot) {
-		/* Prepend the sysroot to normal files. */
-		errcode = snprintf(buffer, sizeof(buffer), "%s%s", sysroot,
-				   filename);
-		if (errcode < 0)
-			return -pte_overflow;
-
-		filename = buffer;
 	}
 
-	errcode = pt_sb_pevent_track_abi(context, filename);
+	/* Prepend the sysroot to normal files.
+	 *
+	 * We cache the result as well as everything we learn about the file
+	 * since processes tend to map the same files over and over again.
+	 */
+	path = NULL;
+	errcode = pt_sb_path_get(&path, &session->paths, sysroot, filename);
+	if (errcode < 0)
+		return errcode;
+
+	errcode = pt_sb_pevent_track_abi(context, path);
 	if (errcode < 0)
 		return errcode;
 
-	return pt_sb_ctx_mmap(session, context, filename, offset, size, vaddr);
+	return pt_sb_ctx_mmap_path(session, context, path, offset, size,
+				   vaddr);
 }
 
 static int pt_sb_pevent_mmap(struct pt_sb_session *session,
@@ -1645,15 +2208,157 @@ static int pt_sb_pevent_apply(struct pt_sb_session *session,
 	return 0;
 }
 
+static int pt_sb_pevent_save(struct pt_sb_pevent_state *state,
+			     const struct pt_sb_pevent_priv *priv)
+{
+	const struct pt_sb_context *context;
+	const uint8_t *pos;
+
+	if (!state || !priv)
+		return -pte_internal;
+
+	memset(state, 0, sizeof(*state));
+
+	/* The current record has been fetched but not applied, yet.  We will
+	 * fetch it again after restoring.
+	 */
+	pos = priv->current;
+	if (!pos)
+		pos = priv->next;
+
+	state->offset = (uint64_t) (pos - priv->begin);
+
+	context = priv->context;
+	if (context) {
+		state->pid = context->pid;
+		state->has_context = 1;
+	}
+
+	context = priv->next_context;
+	if (context) {
+		state->next_pid = context->pid;
+		state->has_next_context = 1;
+	}
+
+	return 0;
+}
+
+static int pt_sb_pevent_seek(struct pt_sb_pevent_priv *priv, uint64_t offset)
+{
+	if (!priv)
+		return -pte_internal;
+
+	if ((uint64_t) (priv->end - priv->begin) < offset)
+		return -pte_bad_context;
+
+#if defined(FEATURE_THREADS)
+	/* Restart prefetching at the new position. */
+	if (priv->prefetch) {
+		pt_sb_pevent_prefetch_stop(priv);
+
+		priv->current = NULL;
+		priv->next = priv->begin + offset;
+
+		return pt_sb_pevent_prefetch_start(priv);
+	}
+#endif /* defined(FEATURE_THREADS) */
+
+	priv->current = NULL;
+	priv->next = priv->begin + offset;
+
+	return 0;
+}
+
+static int pt_sb_pevent_restore(struct pt_sb_session *session,
+				const struct pt_sb_pevent_state *state,
+				struct pt_sb_pevent_priv *priv)
+{
+	struct pt_sb_context *context;
+	uint32_t pid;
+	int errcode;
+
+	if (!state || !priv)
+		return -pte_internal;
+
+	errcode = pt_sb_pevent_seek(priv, state->offset);
+	if (errcode < 0)
+		return errcode;
+
+	priv->location = ploc_unknown;
+
+	errcode = pt_sb_pevent_cancel_context_switch(priv);
+	if (errcode < 0)
+		return errcode;
+
+	context = priv->context;
+	if (context) {
+		priv->context = NULL;
+
+		errcode = pt_sb_ctx_put(context);
+		if (errcode < 0)
+			return errcode;
+	}
+
+	/* The user's image does not reflect our current context, yet.  We
+	 * switch to it on the first event unless another context switch is
+	 * pending, anyway.
+	 */
+	if (state->has_next_context)
+		pid = state->next_pid;
+	else if (state->has_context)
+		pid = state->pid;
+	else
+		return 0;
+
+	context = NULL;
+	errcode = pt_sb_get_context_by_pid(&context, session, pid);
+	if (errcode < 0)
+		return errcode;
+
+	return pt_sb_pevent_prepare_context_switch(priv, context);
+}
+
+/* Request the next event if @priv needs it.
+ *
+ * Secondary decoders never postpone anything.  They only need to see events
+ * for applying their sideband records, which doesn't require a request.
+ *
+ * Primary decoders postpone context switches until a suitable location in the
+ * trace.  A switch may become pending at any event and we need the location
+ * of the event before to place it, so they need to see every event until they
+ * signal the end of their sideband trace.
+ */
+static int pt_sb_pevent_request(struct pt_sb_session *session,
+				const struct pt_sb_pevent_priv *priv)
+{
+	if (!priv)
+		return -pte_internal;
+
+	if (!priv->primary)
+		return 0;
+
+	return pt_sb_request_event(session);
+}
+
 static int pt_sb_pevent_fetch_callback(struct pt_sb_session *session,
 				       uint64_t *tsc, void *priv)
 {
-	int errcode;
+	int errcode, status;
 
 	errcode = pt_sb_pevent_fetch(tsc, (struct pt_sb_pevent_priv *) priv);
-	if ((errcode < 0) && (errcode != -pte_eos))
+	if ((errcode < 0) && (errcode != -pte_eos)) {
 		pt_sb_pevent_error(session, errcode,
 				   (struct pt_sb_pevent_priv *) priv);
+		return errcode;
+	}
+
+	/* We may still have a postponed context switch at the end of the
+	 * sideband trace.
+	 */
+	status = pt_sb_pevent_request(session,
+				      (struct pt_sb_pevent_priv *) priv);
+	if (status < 0)
+		return status;
 
 	return errcode;
 }
@@ -1684,11 +2389,60 @@ static int pt_sb_pevent_apply_callback(struct pt_sb_session *session,
 		return pt_sb_pevent_error(session, errcode,
 					  (struct pt_sb_pevent_priv *) priv);
 
+	if (errcode < 0)
+		return errcode;
+
+	return pt_sb_pevent_request(session,
+				    (struct pt_sb_pevent_priv *) priv);
+}
+
+static int pt_sb_pevent_save_callback(struct pt_sb_session *session,
+				      void **pstate, void *priv)
+{
+	struct pt_sb_pevent_state *state;
+	int errcode;
+
+	(void) session;
+
+	if (!pstate)
+		return -pte_internal;
+
+	state = malloc(sizeof(*state));
+	if (!state)
+		return -pte_nomem;
+
+	errcode = pt_sb_pevent_save(state, (struct pt_sb_pevent_priv *) priv);
+	if (errcode < 0) {
+		free(state);
+		return errcode;
+	}
+
+	*pstate = state;
+
+	return 0;
+}
+
+static int pt_sb_pevent_restore_callback(struct pt_sb_session *session,
+					 const void *state, void *priv)
+{
+	int errcode;
+
+	errcode = pt_sb_pevent_restore(session,
+				       (const struct pt_sb_pevent_state *)
+				       state,
+				       (struct pt_sb_pevent_priv *) priv);
+	if (errcode < 0)
+		(void) pt_sb_pevent_error(session, errcode,
+					  (struct pt_sb_pevent_priv *) priv);
+
 	return errcode;
 }
 
-int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
-			       const struct pt_sb_pevent_config *pev)
+static int pt_sb_pevent_alloc(struct pt_sb_session *session,
+			      const struct pt_sb_pevent_config *pev,
+			      int perf_data, uint32_t cpu,
+			      const uint8_t *begin, const uint8_t *end,
+			      const uint64_t *offsets, uint32_t noffsets)
 {
 	struct pt_sb_decoder_config config;
 	struct pt_sb_pevent_priv *priv;
@@ -1701,25 +2455,68 @@ int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
 	if (!priv)
 		return -pte_nomem;
 
-	errcode = pt_sb_pevent_init(priv, pev);
+	if (perf_data)
+		errcode = pt_sb_pevent_init_data(priv, pev, begin, end);
+	else
+		errcode = pt_sb_pevent_init(priv, pev);
 	if (errcode < 0) {
 		free(priv);
 		return errcode;
 	}
 
+	priv->perf_data = perf_data ? 1 : 0;
+	priv->cpu = cpu;
+	priv->offsets = offsets;
+	priv->noffsets = noffsets;
+
+#if defined(FEATURE_THREADS)
+	if (pev->prefetch) {
+		errcode = pt_sb_pevent_prefetch_start(priv);
+		if (errcode < 0) {
+			pt_sb_pevent_dtor(priv);
+			return errcode;
+		}
+	}
+#endif /* defined(FEATURE_THREADS) */
+
 	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
 	config.fetch = pt_sb_pevent_fetch_callback;
 	config.apply = pt_sb_pevent_apply_callback;
 	config.print = pt_sb_pevent_print_callback;
 	config.dtor = pt_sb_pevent_dtor;
+	config.save = pt_sb_pevent_save_callback;
+	config.restore = pt_sb_pevent_restore_callback;
+	config.free_state = free;
 	config.priv = priv;
 	config.primary = pev->primary;
+	config.on_request = 1;
 
 	errcode = pt_sb_alloc_decoder(session, &config);
 	if (errcode < 0)
-		free(priv);
+		pt_sb_pevent_dtor(priv);
 
 	return errcode;
 }
 
+int pt_sb_alloc_pevent_decoder(struct pt_sb_session *session,
+			       const struct pt_sb_pevent_config *config)
+{
+	return pt_sb_pevent_alloc(session, config, 0, UINT32_MAX, NULL, NULL,
+				  NULL, 0);
+}
+
+int pt_sb_alloc_perf_data_decoder(struct pt_sb_session *session,
+				  const struct pt_sb_pevent_config *config,
+				  uint32_t cpu, const uint8_t *begin,
+				  const uint8_t *end, const uint64_t *offsets,
+				  uint32_t noffsets)
+{
+	if (!begin || !offsets)
+		return -pte_internal;
+
+	return pt_sb_pevent_alloc(session, config, 1, cpu, begin, end, offsets,
+				  noffsets);
+}
+
 #endif /* FEATURE_PEVENT */
@@ -44,14 +44,25 @@
 struct pt_sb_session *pt_sb_alloc(struct pt_image_section_cache *iscache)
 {
 	struct pt_sb_session *session;
+	struct pt_image_pool *pool;
 	struct pt_image *kernel;
 
-	kernel = pt_image_alloc("kernel");
-	if (!kernel)
+	pool = pt_image_pool_alloc();
+	if (!pool)
 		return NULL;
 
+	/* The kernel image uses the same pool as process images so they can
+	 * share its sections.
+	 */
+	kernel = pt_image_alloc_pooled("kernel", pool);
+	if (!kernel) {
+		pt_image_pool_free(pool);
+		return NULL;
+	}
+
 	session = malloc(sizeof(*session));
 	if (!session) {
+		pt_image_pool_free(pool);
 		pt_image_free(kernel);
 		return NULL;
 	}
@@ -59,6 +70,10 @@ struct pt_sb_session *pt_sb_alloc(struct pt_image_section_cache *iscache)
 	memset(session, 0, sizeof(*session));
 	session->iscache = iscache;
 	session->kernel = kernel;
+	session->pool = pool;
+
+	pt_hash_table_init(&session->contexts);
+	pt_sb_path_cache_init(&session->paths);
 
 	return session;
 }
@@ -89,29 +104,32 @@ static void pt_sb_free_decoder_list(struct pt_sb_decoder *list)
 	}
 }
 
+static void pt_sb_put_context(struct pt_hash_node *node)
+{
+	/* The node is the first field in struct pt_sb_context. */
+	(void) pt_sb_ctx_put((struct pt_sb_context *) node);
+}
+
 void pt_sb_free(struct pt_sb_session *session)
 {
-	struct pt_sb_context *context;
+	uint32_t idx;
 
 	if (!session)
 		return;
 
-	pt_sb_free_decoder_list(session->decoders);
+	for (idx = 0; idx < session->ndecoders; ++idx)
+		pt_sb_free_decoder(session->decoders[idx]);
+
+	free(session->decoders);
+
 	pt_sb_free_decoder_list(session->waiting);
 	pt_sb_free_decoder_list(session->retired);
 	pt_sb_free_decoder_list(session->removed);
 
-	context = session->contexts;
-	while (context) {
-		struct pt_sb_context *trash;
-
-		trash = context;
-		context = trash->next;
-
-		(void) pt_sb_ctx_put(trash);
-	}
-
+	pt_hash_table_fini(&session->contexts, pt_sb_put_context);
+	pt_sb_path_cache_fini(&session->paths);
 	pt_image_free(session->kernel);
+	pt_image_pool_free(session->pool);
 
 	free(session);
 }
@@ -132,6 +150,11 @@ struct pt_image *pt_sb_kernel_image(struct pt_sb_session *session)
 	return session->kernel;
 }
 
+static uint64_t pt_sb_ctx_hash(uint32_t pid)
+{
+	return pt_hash_u64(0ull, pid);
+}
+
 static int pt_sb_add_context_by_pid(struct pt_sb_context **pcontext,
 				    struct pt_sb_session *session, uint32_t pid)
 {
@@ -150,20 +173,25 @@ static int pt_sb_add_context_by_pid(struct pt_sb_context **pcontext,
 	memset(iname, 0, sizeof(iname));
 	(void) snprintf(iname, sizeof(iname), "pid-%x", pid);
 
-	context = pt_sb_ctx_alloc(iname);
+	context = pt_sb_ctx_alloc(iname, session->pool);
 	if (!context)
 		return -pte_nomem;
 
-	errcode = pt_image_copy(context->image, kernel);
+	errcode = pt_image_share(context->image, kernel);
 	if (errcode < 0) {
 		(void) pt_sb_ctx_put(context);
 		return errcode;
 	}
 
-	context->next = session->contexts;
+	context->node.hash = pt_sb_ctx_hash(pid);
 	context->pid = pid;
 
-	session->contexts = context;
+	errcode = pt_hash_table_insert(&session->contexts, &context->node);
+	if (errcode < 0) {
+		(void) pt_sb_ctx_put(context);
+		return errcode;
+	}
+
 	*pcontext = context;
 
 	return 0;
@@ -190,41 +218,43 @@ int pt_sb_get_context_by_pid(struct pt_sb_context **context,
 int pt_sb_find_context_by_pid(struct pt_sb_context **pcontext,
 			      struct pt_sb_session *session, uint32_t pid)
 {
-	struct pt_sb_context *ctx;
+	struct pt_hash_node *node;
+	uint64_t hash;
 
 	if (!pcontext || !session)
 		return -pte_invalid;
 
-	for (ctx = session->contexts; ctx; ctx = ctx->next) {
-		if (ctx->pid == pid)
+	*pcontext = NULL;
+
+	hash = pt_sb_ctx_hash(pid);
+	for (node = pt_hash_table_first(&session->contexts, hash); node;
+	     node = node->next) {
+		struct pt_sb_context *ctx;
+
+		/* The node is the first field in struct pt_sb_context. */
+		ctx = (struct pt_sb_context *) node;
+		if (ctx->pid == pid) {
+			*pcontext = ctx;
 			break;
+		}
 	}
 
-	*pcontext = ctx;
-
 	return 0;
 }
 
 int pt_sb_remove_context(struct pt_sb_session *session,
 			 struct pt_sb_context *context)
 {
-	struct pt_sb_context **pnext, *ctx;
+	int errcode;
 
 	if (!session || !context)
 		return -pte_invalid;
 
-	pnext = &session->contexts;
-	for (ctx = *pnext; ctx; pnext = &ctx->next, ctx = *pnext) {
-		if (ctx == context)
-			break;
-	}
-
-	if (!ctx)
+	errcode = pt_hash_table_remove(&session->contexts, &context->node);
+	if (errcode < 0)
 		return -pte_nosync;
 
-	*pnext = ctx->next;
-
-	return pt_sb_ctx_put(ctx);
+	return pt_sb_ctx_put(context);
 }
 
 int pt_sb_alloc_decoder(struct pt_sb_session *session,
@@ -247,53 +277,207 @@ int pt_sb_alloc_decoder(struct pt_sb_session *session,
 	decoder->dtor = config->dtor;
 	decoder->priv = config->priv;
 	decoder->primary = config->primary;
+	decoder->on_request = config->on_request;
+	decoder->id = session->nallocated++;
+
+	/* Checkpoint support has been added later; older configurations do
+	 * not provide those callbacks.
+	 */
+	if (offsetof(struct pt_sb_decoder_config, free_state) +
+	    sizeof(config->free_state) <= config->size) {
+		decoder->save = config->save;
+		decoder->restore = config->restore;
+		decoder->free_state = config->free_state;
+	}
 
 	session->waiting = decoder;
 
 	return 0;
 }
 
-/* Add a new decoder to a list of decoders.
+/* Add @decoder to @session's list of decoders that requested the next event.
+ */
+static void pt_sb_request(struct pt_sb_session *session,
+			  struct pt_sb_decoder *decoder)
+{
+	if (decoder->requested)
+		return;
+
+	decoder->next_request = session->requests;
+	decoder->requested = 1;
+
+	session->requests = decoder;
+}
+
+int pt_sb_request_event(struct pt_sb_session *session)
+{
+	if (!session || !session->current)
+		return -pte_invalid;
+
+	pt_sb_request(session, session->current);
+
+	return 0;
+}
+
+/* Remove @decoder from @session.
  *
- * Decoders in @list are ordered by their @tsc (ascending) and @list does not
- * contain @decoder.  Find the right place for @decoder at add it to @list.
+ * The caller has taken @decoder out of @session's decoder heap and lists.
+ * The @decoder may still be on @session's list of decoders that requested the
+ * next event.
+ */
+static void pt_sb_discard_decoder(struct pt_sb_session *session,
+				  struct pt_sb_decoder *decoder)
+{
+	decoder->removed = 1;
+	decoder->next = session->removed;
+	session->removed = decoder;
+}
+
+/* Check whether decoder @lhs comes before decoder @rhs in the decoder heap.
+ *
+ * Decoders are ordered by their @tsc.  For equal @tsc, the decoder that was
+ * inserted last comes first.
+ */
+static inline int pt_sb_decoder_before(const struct pt_sb_decoder *lhs,
+				       const struct pt_sb_decoder *rhs)
+{
+	if (lhs->tsc != rhs->tsc)
+		return lhs->tsc < rhs->tsc;
+
+	return rhs->seq < lhs->seq;
+}
+
+static void pt_sb_heap_sift_up(struct pt_sb_decoder **heap, uint32_t idx)
+{
+	struct pt_sb_decoder *decoder;
+
+	decoder = heap[idx];
+	while (idx) {
+		uint32_t parent;
+
+		parent = (idx - 1) / 2;
+		if (!pt_sb_decoder_before(decoder, heap[parent]))
+			break;
+
+		heap[idx] = heap[parent];
+		idx = parent;
+	}
+
+	heap[idx] = decoder;
+}
+
+static void pt_sb_heap_sift_down(struct pt_sb_decoder **heap, uint32_t size,
+				 uint32_t idx)
+{
+	struct pt_sb_decoder *decoder;
+
+	decoder = heap[idx];
+	for (;;) {
+		uint32_t child;
+
+		child = (2 * idx) + 1;
+		if (size <= child)
+			break;
+
+		if (((child + 1) < size) &&
+		    pt_sb_decoder_before(heap[child + 1], heap[child]))
+			child += 1;
+
+		if (!pt_sb_decoder_before(heap[child], decoder))
+			break;
+
+		heap[idx] = heap[child];
+		idx = child;
+	}
+
+	heap[idx] = decoder;
+}
+
+/* Add a new decoder to @session's decoder heap.
+ *
+ * The heap does not contain @decoder.
  *
  * Returns zero on success, a negative error code otherwise.
  */
-static int pt_sb_add_decoder(struct pt_sb_decoder **list,
+static int pt_sb_add_decoder(struct pt_sb_session *session,
 			     struct pt_sb_decoder *decoder)
 {
-	struct pt_sb_decoder *cand;
-	uint64_t tsc;
+	struct pt_sb_decoder **heap;
+	uint32_t size;
 
-	if (!list || !decoder || decoder->next)
+	if (!session || !decoder || decoder->next)
 		return -pte_internal;
 
-	tsc = decoder->tsc;
-	for (cand = *list; cand; list = &cand->next, cand = *list) {
-		if (tsc <= cand->tsc)
-			break;
+	heap = session->decoders;
+	size = session->ndecoders;
+	if (session->decoders_size <= size) {
+		uint32_t capacity;
+
+		capacity = size ? (size * 2) : 16;
+		if (capacity <= size)
+			return -pte_nomem;
+
+		heap = realloc(heap, capacity * sizeof(*heap));
+		if (!heap)
+			return -pte_nomem;
+
+		session->decoders = heap;
+		session->decoders_size = capacity;
 	}
 
-	decoder->next = cand;
-	*list = decoder;
+	decoder->seq = session->seq++;
+
+	heap[size] = decoder;
+	session->ndecoders = size + 1;
+
+	pt_sb_heap_sift_up(heap, size);
 
 	return 0;
 }
 
+/* Remove the decoder at @idx from @session's decoder heap.
+ *
+ * Returns the removed decoder.
+ */
+static struct pt_sb_decoder *pt_sb_heap_remove(struct pt_sb_session *session,
+					       uint32_t idx)
+{
+	struct pt_sb_decoder **heap, *decoder;
+	uint32_t size;
+
+	heap = session->decoders;
+	size = session->ndecoders - 1;
+
+	decoder = heap[idx];
+	heap[idx] = heap[size];
+	session->ndecoders = size;
+
+	if (idx < size) {
+		pt_sb_heap_sift_up(heap, idx);
+		pt_sb_heap_sift_down(heap, size, idx);
+	}
+
+	return decoder;
+}
+
 static int pt_sb_fetch(struct pt_sb_session *session,
 		       struct pt_sb_decoder *decoder)
 {
 	int (*fetch)(struct pt_sb_session *, uint64_t *, void *);
+	int status;
 
-	if (!decoder)
+	if (!session || !decoder)
 		return -pte_internal;
 
 	fetch = decoder->fetch;
 	if (!fetch)
 		return -pte_bad_config;
 
-	return fetch(session, &decoder->tsc, decoder->priv);
+	session->current = decoder;
+	status = fetch(session, &decoder->tsc, decoder->priv);
+	session->current = NULL;
+
+	return status;
 }
 
 static int pt_sb_print(struct pt_sb_session *session,
@@ -319,7 +503,9 @@ static int pt_sb_apply(struct pt_sb_session *session, struct pt_image **image,
 	int (*apply)(struct pt_sb_session *, struct pt_image **,
 		     const struct pt_event *, void *);
 
-	if (!decoder || !event)
+	int status;
+
+	if (!session || !decoder || !event)
 		return -pte_internal;
 
 	apply = decoder->apply;
@@ -329,7 +515,14 @@ static int pt_sb_apply(struct pt_sb_session *session, struct pt_image **image,
 	if (!decoder->primary)
 		image = NULL;
 
-	return apply(session, image, event, decoder->priv);
+	session->current = decoder;
+	status = apply(session, image, event, decoder->priv);
+	session->current = NULL;
+
+	if ((status >= 0) && !decoder->on_request)
+		pt_sb_request(session, decoder);
+
+	return status;
 }
 
 int pt_sb_init_decoders(struct pt_sb_session *session)
@@ -347,16 +540,33 @@ int pt_sb_init_decoders(struct pt_sb_session *session)
 		decoder->next = NULL;
 
 		errcode = pt_sb_fetch(session, decoder);
-		if (errcode < 0) {
+		if (errcode == -pte_eos) {
+			/* A decoder restored from a checkpoint may run out of
+			 * sideband immediately but still have a postponed
+			 * effect pending.
+			 */
+			decoder->next = session->retired;
+			session->retired = decoder;
+
+			if (!decoder->on_request)
+				pt_sb_request(session, decoder);
+		} else if (errcode < 0) {
 			/* Fetch errors remove @decoder.  In this case, they
 			 * prevent it from being added in the first place.
 			 */
-			pt_sb_free_decoder(decoder);
+			pt_sb_discard_decoder(session, decoder);
 		} else {
-			errcode = pt_sb_add_decoder(&session->decoders,
-						    decoder);
-			if (errcode < 0)
+			errcode = pt_sb_add_decoder(session, decoder);
+			if (errcode < 0) {
+				pt_sb_discard_decoder(session, decoder);
 				return errcode;
+			}
+
+			/* Decoders that don't request events explicitly are
+			 * presented all events.
+			 */
+			if (!decoder->on_request)
+				pt_sb_request(session, decoder);
 		}
 
 		decoder = session->waiting;
@@ -395,34 +605,42 @@ static int pt_sb_event_from_user(struct pt_event *event,
 	return 0;
 }
 
+/* Present @event to all decoders that requested it.
+ *
+ * Decoders may request the next event again while being presented @event.
+ *
+ * Decoders that fail to apply @event are marked removed.  They remain in the
+ * decoder heap or in the list of retired decoders until they are found there.
+ *
+ * Returns zero on success, a negative error code otherwise.
+ */
 static int pt_sb_event_present(struct pt_sb_session *session,
 			       struct pt_image **image,
-			       struct pt_sb_decoder **pnext,
 			       const struct pt_event *event)
 {
 	struct pt_sb_decoder *decoder;
-	int errcode;
 
-	if (!session || !pnext)
+	if (!session)
 		return -pte_internal;
 
-	decoder = *pnext;
+	decoder = session->requests;
+	session->requests = NULL;
+
 	while (decoder) {
-		errcode = pt_sb_apply(session, image, decoder, event);
-		if (errcode < 0) {
-			struct pt_sb_decoder *trash;
+		struct pt_sb_decoder *next;
+		int errcode;
 
-			trash = decoder;
-			decoder = trash->next;
-			*pnext = decoder;
+		next = decoder->next_request;
+		decoder->next_request = NULL;
+		decoder->requested = 0;
 
-			trash->next = session->removed;
-			session->removed = trash;
-			continue;
+		if (!decoder->removed) {
+			errcode = pt_sb_apply(session, image, decoder, event);
+			if (errcode < 0)
+				decoder->removed = 1;
 		}
 
-		pnext = &decoder->next;
-		decoder = *pnext;
+		decoder = next;
 	}
 
 	return 0;
@@ -446,15 +664,13 @@ int pt_sb_event(struct pt_sb_session *session, struct pt_image **image,
 	/* In the initial round, we present the event to all decoders with
 	 * records for a smaller or equal timestamp.
 	 *
-	 * We only need to look at the first decoder.  We remove it from the
-	 * list and ask it to apply the event.  Then, we ask it to fetch the
-	 * next record and re-add it to the list according to that next record's
-	 * timestamp.
+	 * We only need to look at the top of the heap.  We remove it from the
+	 * heap and ask it to apply the event.  Then, we ask it to fetch the
+	 * next record and re-add it to the heap according to that next
+	 * record's timestamp.
 	 */
-	for (;;) {
-		decoder = session->decoders;
-		if (!decoder)
-			break;
+	while (session->ndecoders) {
+		decoder = session->decoders[0];
 
 		/* We don't check @event.has_tsc to support sideband
 		 * correlation based on relative (non-wall clock) time.
@@ -462,22 +678,23 @@ int pt_sb_event(struct pt_sb_session *session, struct pt_image **image,
 		if (event.tsc < decoder->tsc)
 			break;
 
-		session->decoders = decoder->next;
-		decoder->next = NULL;
+		decoder = pt_sb_heap_remove(session, 0);
+		if (decoder->removed) {
+			pt_sb_discard_decoder(session, decoder);
+			continue;
+		}
 
 		if (stream) {
 			errcode = pt_sb_print(session, decoder, stream, flags);
 			if (errcode < 0) {
-				decoder->next = session->removed;
-				session->removed = decoder;
+				pt_sb_discard_decoder(session, decoder);
 				continue;
 			}
 		}
 
 		errcode = pt_sb_apply(session, image, decoder, &event);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_discard_decoder(session, decoder);
 			continue;
 		}
 
@@ -486,30 +703,27 @@ int pt_sb_event(struct pt_sb_session *session, struct pt_image **image,
 			if (errcode == -pte_eos) {
 				decoder->next = session->retired;
 				session->retired = decoder;
-			} else {
-				decoder->next = session->removed;
-				session->removed = decoder;
-			}
+			} else
+				pt_sb_discard_decoder(session, decoder);
 
 			continue;
 		}
 
-		errcode = pt_sb_add_decoder(&session->decoders, decoder);
-		if (errcode < 0)
+		errcode = pt_sb_add_decoder(session, decoder);
+		if (errcode < 0) {
+			pt_sb_discard_decoder(session, decoder);
 			return errcode;
+		}
 	}
 
-	/* In the second round, we present the event to all decoders.
+	/* In the second round, we present the event to all decoders that
+	 * requested it.
 	 *
 	 * This allows decoders to postpone actions until an appropriate event,
-	 * e.g entry into or exit from the kernel.
+	 * e.g entry into or exit from the kernel.  Decoders that don't request
+	 * events explicitly request every event.
 	 */
-	errcode = pt_sb_event_present(session, image, &session->decoders,
-				      &event);
-	if (errcode < 0)
-		return errcode;
-
-	return pt_sb_event_present(session, image, &session->retired, &event);
+	return pt_sb_event_present(session, image, &event);
 }
 
 int pt_sb_dump(struct pt_sb_session *session, FILE *stream, uint32_t flags,
@@ -521,34 +735,35 @@ int pt_sb_dump(struct pt_sb_session *session, FILE *stream, uint32_t flags,
 	if (!session || !stream)
 		return -pte_invalid;
 
-	for (;;) {
-		decoder = session->decoders;
-		if (!decoder)
-			break;
+	while (session->ndecoders) {
+		decoder = session->decoders[0];
 
 		if (tsc < decoder->tsc)
 			break;
 
-		session->decoders = decoder->next;
-		decoder->next = NULL;
+		decoder = pt_sb_heap_remove(session, 0);
+		if (decoder->removed) {
+			pt_sb_discard_decoder(session, decoder);
+			continue;
+		}
 
 		errcode = pt_sb_print(session, decoder, stream, flags);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_discard_decoder(session, decoder);
 			continue;
 		}
 
 		errcode = pt_sb_fetch(session, decoder);
 		if (errcode < 0) {
-			decoder->next = session->removed;
-			session->removed = decoder;
+			pt_sb_discard_decoder(session, decoder);
 			continue;
 		}
 
-		errcode = pt_sb_add_decoder(&session->decoders, decoder);
-		if (errcode < 0)
+		errcode = pt_sb_add_decoder(session, decoder);
+		if (errcode < 0) {
+			pt_sb_discard_decoder(session, decoder);
 			return errcode;
+		}
 	}
 
 	return 0;
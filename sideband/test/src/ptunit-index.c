@@ -0,0 +1,635 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The file that test sections are loaded from.
+ *
+ * We use the test executable, which is guaranteed to exist.
+ */
+static const char *sbi_filename;
+
+/* A test sideband record.
+ *
+ * Applying the record maps a small section of @sbi_filename into the image
+ * of process @pid or into the kernel image if @pid is zero.
+ *
+ * Each record uses a unique @cr3 so we can tell which records have been
+ * applied to an image.
+ */
+struct sbi_record {
+	/* The record's timestamp. */
+	uint64_t tsc;
+
+	/* The process id or zero for the kernel. */
+	uint32_t pid;
+
+	/* The address space and virtual address of the mapped section. */
+	uint64_t cr3;
+	uint64_t vaddr;
+};
+
+static const struct sbi_record sbi_records_a[] = {
+	{ 5ull, 1, 0x1a000ull, 0x1000ull },
+	{ 12ull, 2, 0x2a000ull, 0x2000ull },
+	{ 25ull, 1, 0x3a000ull, 0x3000ull },
+	{ 40ull, 3, 0x4a000ull, 0x4000ull }
+};
+
+static const struct sbi_record sbi_records_b[] = {
+	{ 7ull, 0, 0x1b000ull, 0xffff0000ull },
+	{ 12ull, 1, 0x2b000ull, 0x5000ull },
+	{ 21ull, 0, 0x3b000ull, 0xffff1000ull },
+	{ 33ull, 2, 0x4b000ull, 0x6000ull }
+};
+
+/* The process ids used in the above records plus one that is never used. */
+static const uint32_t sbi_pids[] = { 1, 2, 3, 4 };
+
+/* A test sideband decoder. */
+struct sbi_decoder {
+	/* The sideband records. */
+	const struct sbi_record *records;
+
+	/* The number of @records. */
+	uint32_t nrecords;
+
+	/* The index of the next record to fetch. */
+	uint32_t next;
+
+	/* The index of the fetched record to apply next. */
+	uint32_t current;
+
+	/* A flag saying whether @current is valid. */
+	uint32_t has_current:1;
+};
+
+static int sbi_fetch(struct pt_sb_session *session, uint64_t *tsc, void *priv)
+{
+	struct sbi_decoder *decoder;
+
+	(void) session;
+
+	decoder = (struct sbi_decoder *) priv;
+	if (!decoder || !tsc)
+		return -pte_internal;
+
+	if (decoder->nrecords <= decoder->next)
+		return -pte_eos;
+
+	decoder->current = decoder->next++;
+	decoder->has_current = 1;
+
+	*tsc = decoder->records[decoder->current].tsc;
+
+	return 0;
+}
+
+static int sbi_apply(struct pt_sb_session *session, struct pt_image **image,
+		     const struct pt_event *event, void *priv)
+{
+	const struct sbi_record *record;
+	struct sbi_decoder *decoder;
+	struct pt_image *target;
+	struct pt_asid asid;
+	int errcode;
+
+	(void) image;
+	(void) event;
+
+	decoder = (struct sbi_decoder *) priv;
+	if (!decoder || !decoder->has_current)
+		return -pte_internal;
+
+	record = &decoder->records[decoder->current];
+	decoder->has_current = 0;
+
+	if (record->pid) {
+		struct pt_sb_context *context;
+
+		context = NULL;
+		errcode = pt_sb_get_context_by_pid(&context, session,
+						   record->pid);
+		if (errcode < 0)
+			return errcode;
+
+		target = pt_sb_ctx_image(context);
+	} else
+		target = pt_sb_kernel_image(session);
+
+	pt_asid_init(&asid);
+	asid.cr3 = record->cr3;
+
+	return pt_image_add_file(target, sbi_filename, 0ull, 0x10ull, &asid,
+				 record->vaddr);
+}
+
+static int sbi_save(struct pt_sb_session *session, void **pstate, void *priv)
+{
+	const struct sbi_decoder *decoder;
+	uint32_t *state;
+
+	(void) session;
+
+	decoder = (const struct sbi_decoder *) priv;
+	if (!decoder || !pstate)
+		return -pte_internal;
+
+	state = malloc(sizeof(*state));
+	if (!state)
+		return -pte_nomem;
+
+	/* A fetched but not yet applied record will be fetched again. */
+	*state = decoder->has_current ? decoder->current : decoder->next;
+	*pstate = state;
+
+	return 0;
+}
+
+static int sbi_restore(struct pt_sb_session *session, const void *state,
+		       void *priv)
+{
+	struct sbi_decoder *decoder;
+
+	(void) session;
+
+	decoder = (struct sbi_decoder *) priv;
+	if (!decoder || !state)
+		return -pte_internal;
+
+	decoder->next = *(const uint32_t *) state;
+	decoder->has_current = 0;
+
+	return 0;
+}
+
+static void sbi_dtor(void *priv)
+{
+	free(priv);
+}
+
+static int sbi_alloc_decoder(struct pt_sb_session *session,
+			     const struct sbi_record *records,
+			     uint32_t nrecords, int checkpoints)
+{
+	struct pt_sb_decoder_config config;
+	struct sbi_decoder *decoder;
+	int errcode;
+
+	decoder = malloc(sizeof(*decoder));
+	if (!decoder)
+		return -pte_nomem;
+
+	memset(decoder, 0, sizeof(*decoder));
+	decoder->records = records;
+	decoder->nrecords = nrecords;
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.fetch = sbi_fetch;
+	config.apply = sbi_apply;
+	config.dtor = sbi_dtor;
+	config.priv = decoder;
+	config.on_request = 1;
+
+	if (checkpoints) {
+		config.save = sbi_save;
+		config.restore = sbi_restore;
+		config.free_state = free;
+	}
+
+	errcode = pt_sb_alloc_decoder(session, &config);
+	if (errcode < 0)
+		free(decoder);
+
+	return errcode;
+}
+
+/* Allocate a session with the test sideband decoders. */
+static struct pt_sb_session *sbi_alloc_session(void)
+{
+	struct pt_sb_session *session;
+	int errcode;
+
+	session = pt_sb_alloc(NULL);
+	if (!session)
+		return NULL;
+
+	errcode = sbi_alloc_decoder(session, sbi_records_a,
+				    sizeof(sbi_records_a) /
+				    sizeof(*sbi_records_a), 1);
+	if (errcode < 0) {
+		pt_sb_free(session);
+		return NULL;
+	}
+
+	errcode = sbi_alloc_decoder(session, sbi_records_b,
+				    sizeof(sbi_records_b) /
+				    sizeof(*sbi_records_b), 1);
+	if (errcode < 0) {
+		pt_sb_free(session);
+		return NULL;
+	}
+
+	return session;
+}
+
+/* Apply all sideband records up to and including @tsc. */
+static int sbi_apply_to(struct pt_sb_session *session, uint64_t tsc)
+{
+	struct pt_image *image;
+	struct pt_event event;
+	int errcode;
+
+	errcode = pt_sb_init_decoders(session);
+	if (errcode < 0)
+		return errcode;
+
+	memset(&event, 0, sizeof(event));
+	event.type = ptev_cbr;
+	event.has_tsc = 1;
+	event.tsc = tsc;
+
+	image = pt_sb_kernel_image(session);
+
+	return pt_sb_event(session, &image, &event, sizeof(event), NULL, 0);
+}
+
+/* Build an index from a session that is freed right away.
+ *
+ * The index must not depend on the session it was built from.
+ */
+static int sbi_build(struct pt_sb_index **index, uint64_t interval)
+{
+	struct pt_sb_session *session;
+	int errcode;
+
+	session = sbi_alloc_session();
+	if (!session)
+		return -pte_nomem;
+
+	errcode = pt_sb_index_build(index, session, interval);
+	pt_sb_free(session);
+
+	return errcode;
+}
+
+/* Check that @image and @expected contain the same test sections.
+ *
+ * This removes the test sections from both images.
+ */
+static struct ptunit_result sbi_check_records(struct pt_image *image,
+					      struct pt_image *expected,
+					      const struct sbi_record *records,
+					      uint32_t nrecords)
+{
+	uint32_t idx;
+
+	for (idx = 0; idx < nrecords; ++idx) {
+		struct pt_asid asid;
+		int status;
+
+		pt_asid_init(&asid);
+		asid.cr3 = records[idx].cr3;
+
+		status = pt_image_remove_by_asid(expected, &asid);
+		ptu_int_ge(status, 0);
+		ptu_int_eq(pt_image_remove_by_asid(image, &asid), status);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sbi_check_image(struct pt_image *image,
+					    struct pt_image *expected)
+{
+	ptu_ptr(image);
+	ptu_ptr(expected);
+
+	ptu_check(sbi_check_records, image, expected, sbi_records_a,
+		  sizeof(sbi_records_a) / sizeof(*sbi_records_a));
+	ptu_check(sbi_check_records, image, expected, sbi_records_b,
+		  sizeof(sbi_records_b) / sizeof(*sbi_records_b));
+
+	return ptu_passed();
+}
+
+/* Check that @session matches @expected. */
+static struct ptunit_result sbi_check_session(struct pt_sb_session *session,
+					      struct pt_sb_session *expected)
+{
+	uint32_t idx;
+
+	ptu_check(sbi_check_image, pt_sb_kernel_image(session),
+		  pt_sb_kernel_image(expected));
+
+	for (idx = 0; idx < sizeof(sbi_pids) / sizeof(*sbi_pids); ++idx) {
+		struct pt_sb_context *context, *ectx;
+		int errcode;
+
+		context = NULL;
+		errcode = pt_sb_find_context_by_pid(&context, session,
+						    sbi_pids[idx]);
+		ptu_int_eq(errcode, 0);
+
+		ectx = NULL;
+		errcode = pt_sb_find_context_by_pid(&ectx, expected,
+						    sbi_pids[idx]);
+		ptu_int_eq(errcode, 0);
+
+		if (!ectx) {
+			ptu_null(context);
+			continue;
+		}
+
+		ptu_ptr(context);
+		ptu_check(sbi_check_image, pt_sb_ctx_image(context),
+			  pt_sb_ctx_image(ectx));
+	}
+
+	return ptu_passed();
+}
+
+/* Restore a session from @index at @tsc and compare it with a session that
+ * applied all sideband records up to @tsc.
+ */
+static struct ptunit_result sbi_check_restore(const struct pt_sb_index *index,
+					      uint64_t tsc, uint64_t ctsc)
+{
+	struct pt_sb_session *session, *expected;
+	uint64_t rtsc;
+	int errcode;
+
+	session = sbi_alloc_session();
+	ptu_ptr(session);
+
+	expected = sbi_alloc_session();
+	ptu_ptr(expected);
+
+	rtsc = 0xffull;
+	errcode = pt_sb_index_restore(session, index, tsc, &rtsc);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(rtsc, ctsc);
+
+	errcode = sbi_apply_to(session, tsc);
+	ptu_int_eq(errcode, 0);
+
+	errcode = sbi_apply_to(expected, tsc);
+	ptu_int_eq(errcode, 0);
+
+	ptu_check(sbi_check_session, session, expected);
+
+	pt_sb_free(session);
+	pt_sb_free(expected);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result build_null(void)
+{
+	struct pt_sb_session *session;
+	struct pt_sb_index *index;
+	int errcode;
+
+	session = sbi_alloc_session();
+	ptu_ptr(session);
+
+	errcode = pt_sb_index_build(NULL, session, 1ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_index_build(&index, NULL, 1ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_index_build(&index, session, 0ull);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	pt_sb_free(session);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result build_bad_config(void)
+{
+	struct pt_sb_session *session;
+	struct pt_sb_index *index;
+	int errcode;
+
+	session = sbi_alloc_session();
+	ptu_ptr(session);
+
+	errcode = sbi_alloc_decoder(session, sbi_records_a,
+				    sizeof(sbi_records_a) /
+				    sizeof(*sbi_records_a), 0);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_index_build(&index, session, 1ull);
+	ptu_int_eq(errcode, -pte_bad_config);
+
+	pt_sb_free(session);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result size_null(void)
+{
+	ptu_int_eq(pt_sb_index_size(NULL), -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore_null(void)
+{
+	struct pt_sb_session *session;
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, 10ull);
+	ptu_int_eq(errcode, 0);
+
+	session = sbi_alloc_session();
+	ptu_ptr(session);
+
+	errcode = pt_sb_index_restore(NULL, index, 0ull, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_index_restore(session, NULL, 0ull, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	pt_sb_free(session);
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore_used(void)
+{
+	struct pt_sb_session *session;
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, 10ull);
+	ptu_int_eq(errcode, 0);
+
+	session = sbi_alloc_session();
+	ptu_ptr(session);
+
+	errcode = sbi_apply_to(session, 20ull);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_index_restore(session, index, 20ull, NULL);
+	ptu_int_eq(errcode, -pte_bad_context);
+
+	pt_sb_free(session);
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore_mismatch(void)
+{
+	struct pt_sb_session *session;
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, 10ull);
+	ptu_int_eq(errcode, 0);
+
+	session = pt_sb_alloc(NULL);
+	ptu_ptr(session);
+
+	errcode = sbi_alloc_decoder(session, sbi_records_a,
+				    sizeof(sbi_records_a) /
+				    sizeof(*sbi_records_a), 1);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_index_restore(session, index, 20ull, NULL);
+	ptu_int_eq(errcode, -pte_bad_context);
+
+	pt_sb_free(session);
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore(void)
+{
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, 10ull);
+	ptu_int_eq(errcode, 0);
+
+	/* The interval skips ahead to the next record so we get checkpoints
+	 * at 10, 20, 30, and 40.
+	 */
+	ptu_int_eq(pt_sb_index_size(index), 4);
+
+	ptu_check(sbi_check_restore, index, 0ull, 0ull);
+	ptu_check(sbi_check_restore, index, 5ull, 0ull);
+	ptu_check(sbi_check_restore, index, 10ull, 10ull);
+	ptu_check(sbi_check_restore, index, 12ull, 10ull);
+	ptu_check(sbi_check_restore, index, 20ull, 20ull);
+	ptu_check(sbi_check_restore, index, 25ull, 20ull);
+	ptu_check(sbi_check_restore, index, 33ull, 30ull);
+	ptu_check(sbi_check_restore, index, 39ull, 30ull);
+	ptu_check(sbi_check_restore, index, 40ull, 40ull);
+	ptu_check(sbi_check_restore, index, 100ull, 40ull);
+
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore_each(void)
+{
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, 1ull);
+	ptu_int_eq(errcode, 0);
+
+	/* We get one checkpoint per distinct record timestamp. */
+	ptu_int_eq(pt_sb_index_size(index), 7);
+
+	ptu_check(sbi_check_restore, index, 4ull, 0ull);
+	ptu_check(sbi_check_restore, index, 5ull, 5ull);
+	ptu_check(sbi_check_restore, index, 11ull, 7ull);
+	ptu_check(sbi_check_restore, index, 12ull, 12ull);
+	ptu_check(sbi_check_restore, index, 24ull, 21ull);
+	ptu_check(sbi_check_restore, index, 40ull, 40ull);
+
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result restore_max(void)
+{
+	struct pt_sb_index *index;
+	int errcode;
+
+	errcode = sbi_build(&index, UINT64_MAX);
+	ptu_int_eq(errcode, 0);
+
+	ptu_int_eq(pt_sb_index_size(index), 1);
+
+	ptu_check(sbi_check_restore, index, 40ull, 0ull);
+	ptu_check(sbi_check_restore, index, UINT64_MAX, UINT64_MAX);
+
+	pt_sb_index_free(index);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct ptunit_suite suite;
+
+	sbi_filename = argv[0];
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, build_null);
+	ptu_run(suite, build_bad_config);
+	ptu_run(suite, size_null);
+	ptu_run(suite, restore_null);
+	ptu_run(suite, restore_used);
+	ptu_run(suite, restore_mismatch);
+	ptu_run(suite, restore);
+	ptu_run(suite, restore_each);
+	ptu_run(suite, restore_max);
+
+	return ptunit_report(&suite);
+}
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "ptunit.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+
+#include <string.h>
+
+
+enum {
+	/* The maximal number of trace streams. */
+	sbm_max_streams = 3,
+
+	/* The maximal number of timing packets per trace stream. */
+	sbm_max_timing = 8,
+
+	/* The size of each trace stream's buffer. */
+	sbm_trace_size = 256,
+
+	/* A small ring capacity so the rings wrap around. */
+	sbm_capacity = 4
+};
+
+/* A test trace stream.
+ *
+ * The trace starts with a PSB+ at the first timestamp and then gives a TSC
+ * and CBR packet pair for each further timestamp.  Each CBR packet results in
+ * a ptev_cbr event.  We use the CBR's ratio to number the events.
+ */
+struct sbm_stream {
+	/* The timestamps. */
+	uint64_t tsc[sbm_max_timing];
+
+	/* The number of timestamps. */
+	uint32_t ntsc;
+};
+
+/* The test fixture. */
+struct sbm_fixture {
+	/* The trace streams. */
+	struct sbm_stream stream[sbm_max_streams];
+
+	/* The trace buffers. */
+	uint8_t trace[sbm_max_streams][sbm_trace_size];
+
+	/* The trace configurations. */
+	struct pt_config config[sbm_max_streams];
+
+	/* The number of trace streams. */
+	uint32_t nstreams;
+
+	/* The multi-stream trace decoder. */
+	struct pt_sb_merge *merge;
+
+	/* Whether to decode trace streams on separate threads. */
+	int threads;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct sbm_fixture *);
+	struct ptunit_result (*fini)(struct sbm_fixture *);
+};
+
+static struct ptunit_result sbm_init(struct sbm_fixture *sfix)
+{
+	struct pt_sb_merge_config config;
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.capacity = sbm_capacity;
+	config.threads = sfix->threads ? 1 : 0;
+
+	sfix->nstreams = 0;
+	sfix->merge = pt_sb_merge_alloc(&config);
+	ptu_ptr(sfix->merge);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sbm_fini(struct sbm_fixture *sfix)
+{
+	pt_sb_merge_free(sfix->merge);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sbm_encode(struct pt_encoder *encoder,
+				       enum pt_packet_type type,
+				       uint64_t payload)
+{
+	struct pt_packet packet;
+	int errcode;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+
+	switch (type) {
+	case ppt_tsc:
+		packet.payload.tsc.tsc = payload;
+		break;
+
+	case ppt_cbr:
+		packet.payload.cbr.ratio = (uint8_t) payload;
+		break;
+
+	default:
+		break;
+	}
+
+	errcode = pt_enc_next(encoder, &packet);
+	ptu_int_gt(errcode, 0);
+
+	return ptu_passed();
+}
+
+/* Add a trace stream with timestamps @tsc[0..@ntsc).
+ *
+ * A trace stream without timestamps has no PSB and hence no records.
+ */
+static struct ptunit_result sbm_add(struct sbm_fixture *sfix,
+				    const uint64_t *tsc, uint32_t ntsc)
+{
+	struct pt_encoder *encoder;
+	struct pt_config *config;
+	uint64_t offset;
+	uint32_t idx;
+	int errcode;
+
+	ptu_uint_lt(sfix->nstreams, sbm_max_streams);
+	ptu_uint_le(ntsc, sbm_max_timing);
+
+	idx = sfix->nstreams;
+	config = &sfix->config[idx];
+
+	pt_config_init(config);
+	config->begin = sfix->trace[idx];
+	config->end = sfix->trace[idx] + sbm_trace_size;
+
+	encoder = pt_alloc_encoder(config);
+	ptu_ptr(encoder);
+
+	if (ntsc) {
+		ptu_check(sbm_encode, encoder, ppt_psb, 0ull);
+		ptu_check(sbm_encode, encoder, ppt_tsc, tsc[0]);
+		ptu_check(sbm_encode, encoder, ppt_cbr, 1ull);
+		ptu_check(sbm_encode, encoder, ppt_psbend, 0ull);
+	} else
+		ptu_check(sbm_encode, encoder, ppt_pad, 0ull);
+
+	for (idx = 1; idx < ntsc; ++idx) {
+		ptu_check(sbm_encode, encoder, ppt_tsc, tsc[idx]);
+		ptu_check(sbm_encode, encoder, ppt_cbr, idx + 1ull);
+	}
+
+	errcode = pt_enc_get_offset(encoder, &offset);
+	ptu_int_eq(errcode, 0);
+
+	pt_free_encoder(encoder);
+
+	config->end = config->begin + offset;
+
+	idx = sfix->nstreams;
+	memcpy(sfix->stream[idx].tsc, tsc, ntsc * sizeof(*tsc));
+	sfix->stream[idx].ntsc = ntsc;
+
+	errcode = pt_sb_merge_add_stream(sfix->merge, config, NULL, NULL,
+					 idx + 10);
+	ptu_int_eq(errcode, (int) idx);
+
+	sfix->nstreams += 1;
+
+	return ptu_passed();
+}
+
+/* Merge all trace streams and check the order of items.
+ *
+ * We expect a ptev_cbr event per timestamp in each trace stream.  Other
+ * events are allowed but must be ordered, as well.
+ */
+static struct ptunit_result sbm_check(struct sbm_fixture *sfix)
+{
+	struct pt_sb_merge_item item, last;
+	uint32_t ncbr[sbm_max_streams], idx;
+	int errcode;
+
+	memset(ncbr, 0, sizeof(ncbr));
+	memset(&last, 0, sizeof(last));
+
+	for (;;) {
+		const struct sbm_stream *stream;
+		const struct pt_event *event;
+
+		errcode = pt_sb_merge_next(sfix->merge, &item, sizeof(item));
+		if (errcode == -pte_eos)
+			break;
+
+		ptu_int_eq(errcode, 0);
+		ptu_uint_lt(item.stream, sfix->nstreams);
+		ptu_uint_eq(item.cpu, item.stream + 10);
+
+		/* The items are ordered by time and then by stream. */
+		ptu_uint_ge(item.tsc, last.tsc);
+		if (item.tsc == last.tsc)
+			ptu_uint_ge(item.stream, last.stream);
+
+		last = item;
+
+		ptu_int_eq(item.type, ptsm_event);
+
+		event = item.variant.event;
+		ptu_ptr(event);
+
+		if (event->type != ptev_cbr)
+			continue;
+
+		/* The events of a trace stream are in order. */
+		stream = &sfix->stream[item.stream];
+		idx = ncbr[item.stream]++;
+
+		ptu_uint_lt(idx, stream->ntsc);
+		ptu_uint_eq(event->variant.cbr.ratio, idx + 1);
+		ptu_uint_eq(item.tsc, stream->tsc[idx]);
+	}
+
+	for (idx = 0; idx < sfix->nstreams; ++idx)
+		ptu_uint_eq(ncbr[idx], sfix->stream[idx].ntsc);
+
+	/* We remain at the end. */
+	errcode = pt_sb_merge_next(sfix->merge, &item, sizeof(item));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result alloc_null(void)
+{
+	struct pt_sb_merge_config config;
+
+	ptu_null(pt_sb_merge_alloc(NULL));
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config) - 1;
+
+	ptu_null(pt_sb_merge_alloc(&config));
+
+	return ptu_passed();
+}
+
+static struct ptunit_result free_null(void)
+{
+	pt_sb_merge_free(NULL);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_null(struct sbm_fixture *sfix)
+{
+	struct pt_config config;
+	int errcode;
+
+	pt_config_init(&config);
+
+	errcode = pt_sb_merge_add_stream(NULL, &config, NULL, NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_merge_add_stream(sfix->merge, NULL, NULL, NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result add_started(struct sbm_fixture *sfix)
+{
+	static const uint64_t tsc[] = { 1ull };
+	struct pt_sb_merge_item item;
+	int errcode;
+
+	ptu_check(sbm_add, sfix, tsc, 1);
+
+	errcode = pt_sb_merge_next(sfix->merge, &item, sizeof(item));
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_merge_add_stream(sfix->merge, &sfix->config[0], NULL,
+					 NULL, 0);
+	ptu_int_eq(errcode, -pte_bad_context);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next_null(struct sbm_fixture *sfix)
+{
+	struct pt_sb_merge_item item;
+	int errcode;
+
+	errcode = pt_sb_merge_next(NULL, &item, sizeof(item));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_merge_next(sfix->merge, NULL, sizeof(item));
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result next_none(struct sbm_fixture *sfix)
+{
+	struct pt_sb_merge_item item;
+	int errcode;
+
+	errcode = pt_sb_merge_next(sfix->merge, &item, sizeof(item));
+	ptu_int_eq(errcode, -pte_eos);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_empty(struct sbm_fixture *sfix)
+{
+	ptu_check(sbm_add, sfix, NULL, 0);
+	ptu_check(sbm_add, sfix, NULL, 0);
+	ptu_check(sbm_check, sfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_one(struct sbm_fixture *sfix)
+{
+	static const uint64_t tsc[] = {
+		1ull, 2ull, 3ull, 5ull, 8ull, 13ull, 21ull, 34ull
+	};
+
+	ptu_check(sbm_add, sfix, tsc, 8);
+	ptu_check(sbm_check, sfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_interleaved(struct sbm_fixture *sfix)
+{
+	static const uint64_t tsc0[] = { 10ull, 20ull, 30ull, 40ull, 50ull };
+	static const uint64_t tsc1[] = {
+		15ull, 25ull, 35ull, 45ull, 55ull, 65ull, 75ull
+	};
+	static const uint64_t tsc2[] = { 5ull, 60ull, 70ull };
+
+	ptu_check(sbm_add, sfix, tsc0, 5);
+	ptu_check(sbm_add, sfix, tsc1, 7);
+	ptu_check(sbm_add, sfix, tsc2, 3);
+	ptu_check(sbm_check, sfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_ties(struct sbm_fixture *sfix)
+{
+	static const uint64_t tsc0[] = { 30ull, 30ull, 40ull, 50ull };
+	static const uint64_t tsc1[] = { 10ull, 30ull, 40ull, 40ull, 50ull };
+	static const uint64_t tsc2[] = { 10ull, 10ull, 30ull, 50ull };
+
+	ptu_check(sbm_add, sfix, tsc0, 4);
+	ptu_check(sbm_add, sfix, tsc1, 5);
+	ptu_check(sbm_add, sfix, tsc2, 4);
+	ptu_check(sbm_check, sfix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result merge_ended(struct sbm_fixture *sfix)
+{
+	static const uint64_t tsc0[] = { 10ull };
+	static const uint64_t tsc2[] = {
+		5ull, 15ull, 25ull, 35ull, 45ull, 55ull, 65ull, 75ull
+	};
+
+	ptu_check(sbm_add, sfix, tsc0, 1);
+	ptu_check(sbm_add, sfix, NULL, 0);
+	ptu_check(sbm_add, sfix, tsc2, 8);
+	ptu_check(sbm_check, sfix);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct sbm_fixture sfix, tfix;
+	struct ptunit_suite suite;
+
+	memset(&sfix, 0, sizeof(sfix));
+	sfix.init = sbm_init;
+	sfix.fini = sbm_fini;
+
+	tfix = sfix;
+	tfix.threads = 1;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run(suite, alloc_null);
+	ptu_run(suite, free_null);
+	ptu_run_f(suite, add_null, sfix);
+	ptu_run_f(suite, add_started, sfix);
+	ptu_run_f(suite, add_started, tfix);
+	ptu_run_f(suite, next_null, sfix);
+	ptu_run_f(suite, next_none, sfix);
+	ptu_run_f(suite, next_none, tfix);
+
+	ptu_run_f(suite, merge_empty, sfix);
+	ptu_run_f(suite, merge_empty, tfix);
+	ptu_run_f(suite, merge_one, sfix);
+	ptu_run_f(suite, merge_one, tfix);
+	ptu_run_f(suite, merge_interleaved, sfix);
+	ptu_run_f(suite, merge_interleaved, tfix);
+	ptu_run_f(suite, merge_ties, sfix);
+	ptu_run_f(suite, merge_ties, tfix);
+	ptu_run_f(suite, merge_ended, sfix);
+	ptu_run_f(suite, merge_ended, tfix);
+
+	return ptunit_report(&suite);
+}
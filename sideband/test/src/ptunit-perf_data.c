@@ -0,0 +1,488 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+#include "ptunit_mkfile.h"
+
+#include "pt_sb_perf_data.h"
+#include "pt_sb_pevent.h"
+#include "pt_sb_session.h"
+#include "pt_sb_decoder.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+#include "pevent.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The number of cpus with records. */
+	pdfix_ncpus		= 2,
+
+	/* The maximal number of records per cpu. */
+	pdfix_max_records	= 4,
+
+	/* The size of the perf.data file buffer. */
+	pdfix_file_size		= 1024
+};
+
+/* The sample_type of the recorded event. */
+static const uint64_t pdfix_sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME |
+	PERF_SAMPLE_CPU;
+
+/* The AUX area trace of two buffers, one per cpu.
+ *
+ * The first buffer is split into two AUXTRACE records.  Perf pads the trace
+ * in each AUXTRACE record to eight bytes.
+ */
+static const uint8_t pdfix_aux0[] = {
+	0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82
+};
+static const uint8_t pdfix_aux0_more[] = {
+	0x99, 0x00, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00
+};
+static const uint8_t pdfix_aux1[] = {
+	0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82,
+	0x02, 0x82, 0x02, 0x82, 0x02, 0x82, 0x02, 0x82
+};
+
+/* A test fixture providing a perf.data file with records and AUX area trace
+ * for two cpus.
+ */
+struct perf_data_fixture {
+	/* The perf.data file contents. */
+	uint8_t buffer[pdfix_file_size];
+
+	/* The end of the data section in @buffer. */
+	uint8_t *pos;
+
+	/* The begin of the data section in @buffer. */
+	uint8_t *data;
+
+	/* The libpevent configuration for writing records. */
+	struct pev_config config;
+
+	/* The expected record offsets per cpu from the data section. */
+	uint64_t offsets[pdfix_ncpus][pdfix_max_records];
+
+	/* The number of @offsets per cpu. */
+	uint32_t noffsets[pdfix_ncpus];
+
+	/* The perf.data file. */
+	FILE *file;
+	char *name;
+
+	/* The opened perf.data file. */
+	struct pt_sb_perf_data *pdata;
+
+	/* The sideband session. */
+	struct pt_sb_session *session;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct perf_data_fixture *);
+	struct ptunit_result (*fini)(struct perf_data_fixture *);
+};
+
+/* Write @event for @cpu at the end of the data section. */
+static struct ptunit_result pdfix_write(struct perf_data_fixture *pdfix,
+					struct pev_event *event, uint32_t cpu)
+{
+	uint32_t pid, tid;
+	uint64_t time;
+	int size;
+
+	pid = 1;
+	tid = 1;
+	time = 0ull;
+
+	event->sample.pid = &pid;
+	event->sample.tid = &tid;
+	event->sample.time = &time;
+	event->sample.cpu = &cpu;
+
+	if (cpu < pdfix_ncpus) {
+		uint32_t noffsets;
+
+		noffsets = pdfix->noffsets[cpu]++;
+		ptu_uint_lt(noffsets, pdfix_max_records);
+
+		pdfix->offsets[cpu][noffsets] =
+			(uint64_t) (pdfix->pos - pdfix->data);
+	}
+
+	size = pev_write(event, pdfix->pos, pdfix->buffer +
+			 sizeof(pdfix->buffer), &pdfix->config);
+	ptu_int_gt(size, 0);
+
+	pdfix->pos += size;
+
+	return ptu_passed();
+}
+
+/* Write an ITRACE_START record for @cpu. */
+static struct ptunit_result pdfix_itrace_start(struct perf_data_fixture *pdfix,
+					       uint32_t cpu)
+{
+	struct pev_record_itrace_start itrace_start;
+	struct pev_event event;
+
+	memset(&itrace_start, 0, sizeof(itrace_start));
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_ITRACE_START;
+	event.record.itrace_start = &itrace_start;
+
+	ptu_test(pdfix_write, pdfix, &event, cpu);
+
+	return ptu_passed();
+}
+
+/* Write a record synthesized by perf of @type. */
+static struct ptunit_result pdfix_user(struct perf_data_fixture *pdfix,
+				       uint32_t type)
+{
+	struct pev_record_time_conv time_conv;
+	struct pev_event event;
+
+	memset(&time_conv, 0, sizeof(time_conv));
+	time_conv.time_mult = 1;
+
+	pev_event_init(&event);
+	event.type = type;
+	event.record.time_conv = &time_conv;
+
+	ptu_test(pdfix_write, pdfix, &event, UINT32_MAX);
+
+	return ptu_passed();
+}
+
+/* Write an AUXTRACE record for AUX area mmap @idx on @cpu with @size bytes of
+ * @trace.
+ */
+static struct ptunit_result pdfix_auxtrace(struct perf_data_fixture *pdfix,
+					   uint32_t idx, uint32_t cpu,
+					   const uint8_t *trace, size_t size)
+{
+	struct pev_record_auxtrace auxtrace;
+	struct pev_event event;
+
+	memset(&auxtrace, 0, sizeof(auxtrace));
+	auxtrace.size = size;
+	auxtrace.idx = idx;
+	auxtrace.cpu = cpu;
+
+	pev_event_init(&event);
+	event.type = PEV_RECORD_AUXTRACE;
+	event.record.auxtrace = &auxtrace;
+
+	ptu_test(pdfix_write, pdfix, &event, UINT32_MAX);
+
+	ptu_uint_le(size, (size_t) (pdfix->buffer + sizeof(pdfix->buffer) -
+				    pdfix->pos));
+
+	memcpy(pdfix->pos, trace, size);
+	pdfix->pos += size;
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pdfix_init(struct perf_data_fixture *pdfix)
+{
+	struct pev_file_header *header;
+	struct {
+		struct perf_event_attr attr;
+		struct pev_file_section ids;
+	} *attrs;
+	size_t size, offset;
+	int errcode;
+
+	memset(pdfix->buffer, 0, sizeof(pdfix->buffer));
+	memset(pdfix->offsets, 0, sizeof(pdfix->offsets));
+	memset(pdfix->noffsets, 0, sizeof(pdfix->noffsets));
+	pdfix->file = NULL;
+	pdfix->name = NULL;
+	pdfix->pdata = NULL;
+
+	pdfix->session = pt_sb_alloc(NULL);
+	ptu_ptr(pdfix->session);
+
+	pev_config_init(&pdfix->config);
+	pdfix->config.sample_type = pdfix_sample_type;
+
+	header = (struct pev_file_header *) pdfix->buffer;
+	attrs = (void *) (pdfix->buffer + sizeof(*header));
+
+	header->magic = PEV_FILE_MAGIC;
+	header->size = sizeof(*header);
+	header->attr_size = sizeof(*attrs);
+	header->attrs.offset = sizeof(*header);
+	header->attrs.size = sizeof(*attrs);
+
+	attrs->attr.size = sizeof(attrs->attr);
+	attrs->attr.sample_type = pdfix_sample_type;
+	attrs->attr.sample_id_all = 1;
+
+	/* Perf event records are eight-byte aligned in the file. */
+	offset = (sizeof(*header) + sizeof(*attrs) + 7) & ~(size_t) 7;
+
+	pdfix->data = pdfix->buffer + offset;
+	pdfix->pos = pdfix->data;
+
+	/* The records of both cpus and their trace are interleaved with
+	 * records synthesized by perf.
+	 */
+	ptu_test(pdfix_user, pdfix, PEV_RECORD_TIME_CONV);
+	ptu_test(pdfix_itrace_start, pdfix, 0);
+	ptu_test(pdfix_auxtrace, pdfix, 0, 0, pdfix_aux0, sizeof(pdfix_aux0));
+	ptu_test(pdfix_itrace_start, pdfix, 1);
+	ptu_test(pdfix_user, pdfix, PEV_RECORD_FINISHED_ROUND);
+	ptu_test(pdfix_auxtrace, pdfix, 1, 1, pdfix_aux1, sizeof(pdfix_aux1));
+	ptu_test(pdfix_itrace_start, pdfix, 0);
+	ptu_test(pdfix_auxtrace, pdfix, 0, 0, pdfix_aux0_more,
+		 sizeof(pdfix_aux0_more));
+	ptu_test(pdfix_itrace_start, pdfix, 1);
+
+	header->data.offset = (uint64_t) (pdfix->data - pdfix->buffer);
+	header->data.size = (uint64_t) (pdfix->pos - pdfix->data);
+
+	errcode = ptunit_mkfile(&pdfix->file, &pdfix->name, "wb");
+	ptu_int_eq(errcode, 0);
+
+	size = (size_t) (pdfix->pos - pdfix->buffer);
+	ptu_uint_eq(fwrite(pdfix->buffer, 1, size, pdfix->file), size);
+
+	errcode = fflush(pdfix->file);
+	ptu_int_eq(errcode, 0);
+
+	errcode = pt_sb_perf_data_open(&pdfix->pdata, pdfix->name);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr(pdfix->pdata);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pdfix_fini(struct perf_data_fixture *pdfix)
+{
+	/* The decoders reference the perf.data file. */
+	pt_sb_free(pdfix->session);
+	pt_sb_perf_data_close(pdfix->pdata);
+
+	if (pdfix->file) {
+		fclose(pdfix->file);
+		(void) remove(pdfix->name);
+	}
+
+	free(pdfix->name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result cpus(struct perf_data_fixture *pdfix)
+{
+	const struct pt_sb_perf_data *pdata;
+	uint32_t cpu;
+
+	pdata = pdfix->pdata;
+
+	ptu_uint_eq(pdata->ncpus, pdfix_ncpus);
+
+	for (cpu = 0; cpu < pdfix_ncpus; ++cpu) {
+		const struct pt_sb_perf_data_cpu *record_cpu;
+		uint32_t idx;
+
+		record_cpu = &pdata->cpus[cpu];
+		ptu_uint_eq(record_cpu->cpu, cpu);
+		ptu_uint_eq(record_cpu->noffsets, pdfix->noffsets[cpu]);
+
+		for (idx = 0; idx < record_cpu->noffsets; ++idx)
+			ptu_uint_eq(record_cpu->offsets[idx],
+				    pdfix->offsets[cpu][idx]);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result aux(struct perf_data_fixture *pdfix)
+{
+	const uint8_t *begin, *end;
+	uint32_t cpu;
+	int naux, errcode;
+
+	naux = pt_sb_perf_data_naux(pdfix->pdata);
+	ptu_int_eq(naux, 2);
+
+	/* The first buffer is concatenated from two AUXTRACE records. */
+	errcode = pt_sb_perf_data_aux(&begin, &end, &cpu, pdfix->pdata, 0);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cpu, 0);
+	ptu_uint_eq((size_t) (end - begin),
+		    sizeof(pdfix_aux0) + sizeof(pdfix_aux0_more));
+	ptu_int_eq(memcmp(begin, pdfix_aux0, sizeof(pdfix_aux0)), 0);
+	ptu_int_eq(memcmp(begin + sizeof(pdfix_aux0), pdfix_aux0_more,
+			  sizeof(pdfix_aux0_more)), 0);
+
+	/* The second buffer is provided from the mapped file. */
+	errcode = pt_sb_perf_data_aux(&begin, &end, &cpu, pdfix->pdata, 1);
+	ptu_int_eq(errcode, 0);
+	ptu_uint_eq(cpu, 1);
+	ptu_uint_eq((size_t) (end - begin), sizeof(pdfix_aux1));
+	ptu_int_eq(memcmp(begin, pdfix_aux1, sizeof(pdfix_aux1)), 0);
+	ptu_ptr_eq(pdfix->pdata->file.begin, pdfix->pdata->mapping.begin +
+		   (pdfix->data - pdfix->buffer));
+	ptu_int_eq(begin < pdfix->pdata->file.end, 1);
+	ptu_int_eq(pdfix->pdata->file.begin <= begin, 1);
+
+	errcode = pt_sb_perf_data_aux(&begin, &end, &cpu, pdfix->pdata, 2);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result decoders(struct perf_data_fixture *pdfix,
+				     uint32_t primary)
+{
+	struct pt_sb_pevent_config config;
+	const struct pt_sb_perf_data *pdata;
+	const struct pt_sb_decoder *decoder;
+	uint32_t ndecoders;
+	int errcode;
+
+	pdata = pdfix->pdata;
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.primary = 1;
+
+	errcode = pt_sb_alloc_perf_data_decoders(pdfix->session, pdata,
+						 &config, primary);
+	ptu_int_eq(errcode, 0);
+
+	ndecoders = 0;
+	for (decoder = pdfix->session->waiting; decoder;
+	     decoder = decoder->next) {
+		const struct pt_sb_pevent_priv *priv;
+		const struct pt_sb_perf_data_cpu *record_cpu;
+
+		priv = (const struct pt_sb_pevent_priv *) decoder->priv;
+		ptu_ptr(priv);
+		ptu_uint_eq(priv->perf_data, 1);
+		ptu_uint_lt(priv->cpu, pdfix_ncpus);
+		ptu_uint_eq(priv->primary, priv->cpu == primary ? 1 : 0);
+
+		/* Each decoder reads the data section of the mapped perf.data
+		 * file instead of a mapping of its own.
+		 */
+		ptu_null(priv->mapping.base);
+		ptu_ptr_eq(priv->begin, pdata->file.begin);
+		ptu_ptr_eq(priv->end, pdata->file.end);
+
+		/* Each decoder uses its cpu's record offsets. */
+		record_cpu = &pdata->cpus[priv->cpu];
+		ptu_ptr_eq(priv->offsets, record_cpu->offsets);
+		ptu_uint_eq(priv->noffsets, record_cpu->noffsets);
+
+		ndecoders += 1;
+	}
+
+	ptu_uint_eq(ndecoders, pdfix_ncpus);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result null(struct perf_data_fixture *pdfix)
+{
+	struct pt_sb_pevent_config config;
+	const uint8_t *begin, *end;
+	uint32_t cpu;
+	int errcode;
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+
+	errcode = pt_sb_perf_data_open(NULL, pdfix->name);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_open(&pdfix->pdata, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_config(NULL, pdfix->pdata);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_config(&config, NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_alloc_perf_data_decoders(NULL, pdfix->pdata, &config,
+						 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_alloc_perf_data_decoders(pdfix->session, NULL,
+						 &config, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_alloc_perf_data_decoders(pdfix->session, pdfix->pdata,
+						 NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_naux(NULL);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_aux(NULL, &end, &cpu, pdfix->pdata, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_aux(&begin, NULL, &cpu, pdfix->pdata, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_aux(&begin, &end, NULL, pdfix->pdata, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	errcode = pt_sb_perf_data_aux(&begin, &end, &cpu, NULL, 0);
+	ptu_int_eq(errcode, -pte_invalid);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct perf_data_fixture pdfix;
+	struct ptunit_suite suite;
+
+	pdfix.init = pdfix_init;
+	pdfix.fini = pdfix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, null, pdfix);
+	ptu_run_f(suite, cpus, pdfix);
+	ptu_run_f(suite, aux, pdfix);
+	ptu_run_fp(suite, decoders, pdfix, 0);
+	ptu_run_fp(suite, decoders, pdfix, 1);
+
+	return ptunit_report(&suite);
+}
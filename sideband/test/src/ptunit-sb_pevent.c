@@ -0,0 +1,670 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "ptunit.h"
+#include "ptunit_mkfile.h"
+
+#include "pt_sb_pevent.h"
+#include "pt_sb_session.h"
+#include "pt_sb_decoder.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+#include "pevent.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+enum {
+	/* The number of records in the sideband file.
+	 *
+	 * This wraps the prefetch ring several times.
+	 */
+	pefix_nrecords		= 4 * pt_sb_pevent_prefetch_size - 3,
+
+	/* The size of the sideband file buffer. */
+	pefix_file_size		= pefix_nrecords * 64,
+
+	/* The number of sessions: one fetching records on demand and one
+	 * prefetching them.
+	 */
+	pefix_nsessions		= 2
+};
+
+/* The sample_type of the recorded event. */
+static const uint64_t pefix_sample_type = PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+
+/* The start of the kernel address space and a user and a kernel address. */
+static const uint64_t pefix_kernel_start = 0xffffffff80000000ull;
+static const uint64_t pefix_user_ip = 0x1000ull;
+static const uint64_t pefix_kernel_ip = 0xffffffff81000000ull;
+
+/* A test fixture providing a sideband file with ITRACE_START records for
+ * identical perf event sideband decoders with and without prefetching.
+ */
+struct pevent_fixture {
+	/* The sideband file contents. */
+	uint8_t buffer[pefix_file_size];
+
+	/* The end of the sideband records in @buffer. */
+	uint8_t *pos;
+
+	/* The libpevent configuration for writing records. */
+	struct pev_config config;
+
+	/* The record offsets in @buffer. */
+	uint64_t offsets[pefix_nrecords];
+
+	/* The sideband file. */
+	FILE *file;
+	char *name;
+
+	/* The sideband sessions - the second one prefetches records. */
+	struct pt_sb_session *session[pefix_nsessions];
+
+	/* The perf event sideband decoder in each session. */
+	struct pt_sb_decoder *decoder[pefix_nsessions];
+
+	/* A flag saying whether to allocate primary decoders. */
+	uint32_t primary:1;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct pevent_fixture *);
+	struct ptunit_result (*fini)(struct pevent_fixture *);
+};
+
+/* Write the ITRACE_START record @idx at the end of the sideband records.
+ *
+ * The record's timestamp and pid are derived from @idx.
+ */
+static struct ptunit_result pefix_write(struct pevent_fixture *pefix,
+					uint32_t idx)
+{
+	struct pev_record_itrace_start itrace_start;
+	struct pev_event event;
+	uint64_t time;
+	int size;
+
+	memset(&itrace_start, 0, sizeof(itrace_start));
+	itrace_start.pid = idx;
+	itrace_start.tid = idx;
+
+	time = (uint64_t) idx + 1ull;
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_ITRACE_START;
+	event.record.itrace_start = &itrace_start;
+	event.sample.pid = &itrace_start.pid;
+	event.sample.tid = &itrace_start.tid;
+	event.sample.time = &time;
+
+	pefix->offsets[idx] = (uint64_t) (pefix->pos - pefix->buffer);
+
+	size = pev_write(&event, pefix->pos, pefix->buffer +
+			 sizeof(pefix->buffer), &pefix->config);
+	ptu_int_gt(size, 0);
+
+	pefix->pos += size;
+
+	return ptu_passed();
+}
+
+/* Write a PERF_RECORD_SWITCH switch-in record to @pid at @time at the end of
+ * the sideband records.
+ */
+static struct ptunit_result pefix_write_switch(struct pevent_fixture *pefix,
+					       uint32_t pid, uint64_t time)
+{
+	struct pev_event event;
+	int size;
+
+	pev_event_init(&event);
+	event.type = PERF_RECORD_SWITCH;
+	event.sample.pid = &pid;
+	event.sample.tid = &pid;
+	event.sample.time = &time;
+
+	size = pev_write(&event, pefix->pos, pefix->buffer +
+			 sizeof(pefix->buffer), &pefix->config);
+	ptu_int_gt(size, 0);
+
+	pefix->pos += size;
+
+	return ptu_passed();
+}
+
+/* Write the sideband file and allocate a perf event sideband decoder for
+ * [0; @end) of it in each session.
+ *
+ * An @end of zero reads the entire file.
+ */
+static struct ptunit_result pefix_open(struct pevent_fixture *pefix,
+				       size_t end)
+{
+	struct pt_sb_pevent_config config;
+	size_t size;
+	int errcode, idx;
+
+	errcode = ptunit_mkfile(&pefix->file, &pefix->name, "wb");
+	ptu_int_eq(errcode, 0);
+
+	size = (size_t) (pefix->pos - pefix->buffer);
+	ptu_uint_eq(fwrite(pefix->buffer, 1, size, pefix->file), size);
+
+	errcode = fflush(pefix->file);
+	ptu_int_eq(errcode, 0);
+
+	memset(&config, 0, sizeof(config));
+	config.size = sizeof(config);
+	config.filename = pefix->name;
+	config.end = end;
+	config.sample_type = pefix_sample_type;
+	config.time_mult = 1;
+	config.kernel_start = pefix_kernel_start;
+	config.primary = pefix->primary;
+
+	for (idx = 0; idx < pefix_nsessions; ++idx) {
+		struct pt_sb_session *session;
+		struct pt_sb_decoder *decoder;
+
+		config.prefetch = idx ? 1 : 0;
+
+		session = pefix->session[idx];
+		errcode = pt_sb_alloc_pevent_decoder(session, &config);
+		ptu_int_eq(errcode, 0);
+
+		decoder = session->waiting;
+		ptu_ptr(decoder);
+		ptu_ptr(decoder->priv);
+
+		pefix->decoder[idx] = decoder;
+	}
+
+#if defined(FEATURE_THREADS)
+	ptu_null(((struct pt_sb_pevent_priv *) pefix->decoder[0]->priv)
+		 ->prefetch);
+	ptu_ptr(((struct pt_sb_pevent_priv *) pefix->decoder[1]->priv)
+		->prefetch);
+#endif /* defined(FEATURE_THREADS) */
+
+	return ptu_passed();
+}
+
+/* Fetch the next record in each session.
+ *
+ * Both decoders must agree on the fetch status and on the fetched record.
+ * Provides the fetch status in @status.  On success, the fetched record must
+ * be record @idx.  On error, the error must be diagnosed at record @idx.
+ */
+static struct ptunit_result pefix_fetch(struct pevent_fixture *pefix,
+					int *status, uint32_t idx)
+{
+	const struct pt_sb_pevent_priv *priv[pefix_nsessions];
+	uint64_t tsc[pefix_nsessions], next;
+	int errcode[pefix_nsessions], sidx;
+
+	ptu_uint_lt(idx, pefix_nrecords);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_decoder *decoder;
+
+		decoder = pefix->decoder[sidx];
+		ptu_ptr(decoder);
+
+		tsc[sidx] = 0ull;
+		errcode[sidx] = decoder->fetch(pefix->session[sidx],
+					       &tsc[sidx], decoder->priv);
+
+		priv[sidx] = (const struct pt_sb_pevent_priv *) decoder->priv;
+		ptu_ptr(priv[sidx]->current);
+		ptu_uint_eq((uint64_t) (priv[sidx]->current -
+					priv[sidx]->begin),
+			    pefix->offsets[idx]);
+	}
+
+	ptu_int_eq(errcode[1], errcode[0]);
+
+	*status = errcode[0];
+	if (errcode[0] < 0)
+		return ptu_passed();
+
+	next = (uint64_t) (pefix->pos - pefix->buffer);
+	if (idx + 1 < pefix_nrecords)
+		next = pefix->offsets[idx + 1];
+
+	ptu_uint_eq(tsc[0], (uint64_t) idx + 1ull);
+	ptu_uint_eq(tsc[1], tsc[0]);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		const struct pev_event *event;
+
+		event = &priv[sidx]->event;
+		ptu_uint_eq(event->type, PERF_RECORD_ITRACE_START);
+		ptu_ptr(event->record.itrace_start);
+		ptu_uint_eq(event->record.itrace_start->pid, idx);
+		ptu_uint_eq((uint64_t) (priv[sidx]->next - priv[sidx]->begin),
+			    next);
+	}
+
+	return ptu_passed();
+}
+
+/* Fetch records @begin to @end (not included) in each session. */
+static struct ptunit_result pefix_fetch_range(struct pevent_fixture *pefix,
+					      uint32_t begin, uint32_t end)
+{
+	uint32_t idx;
+	int status;
+
+	for (idx = begin; idx < end; ++idx) {
+		ptu_test(pefix_fetch, pefix, &status, idx);
+		ptu_int_eq(status, 0);
+	}
+
+	return ptu_passed();
+}
+
+/* Check that both sessions report the end of the sideband stream and keep
+ * reporting it.
+ */
+static struct ptunit_result pefix_fetch_eos(struct pevent_fixture *pefix)
+{
+	int sidx, pass;
+
+	for (pass = 0; pass < 2; ++pass) {
+		for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+			const struct pt_sb_pevent_priv *priv;
+			struct pt_sb_decoder *decoder;
+			uint64_t tsc;
+			int errcode;
+
+			decoder = pefix->decoder[sidx];
+			errcode = decoder->fetch(pefix->session[sidx], &tsc,
+						 decoder->priv);
+			ptu_int_eq(errcode, -pte_eos);
+
+			priv = (const struct pt_sb_pevent_priv *)
+				decoder->priv;
+			ptu_ptr_eq(priv->current, priv->end);
+		}
+	}
+
+	return ptu_passed();
+}
+
+/* The original apply callback and the number of calls to it. */
+static int (*pefix_apply)(struct pt_sb_session *, struct pt_image **,
+			  const struct pt_event *, void *);
+static uint32_t pefix_napply;
+
+static int pefix_count_apply(struct pt_sb_session *session,
+			     struct pt_image **image,
+			     const struct pt_event *event, void *priv)
+{
+	pefix_napply += 1;
+
+	return pefix_apply(session, image, event, priv);
+}
+
+/* Present @count tip events to @ip at @tsc to session @sidx. */
+static struct ptunit_result pefix_event(struct pevent_fixture *pefix,
+					int sidx, struct pt_image **image,
+					uint64_t tsc, uint64_t ip, uint32_t count)
+{
+	struct pt_event event;
+	int errcode;
+
+	memset(&event, 0, sizeof(event));
+	event.type = ptev_tip;
+	event.has_tsc = 1;
+	event.tsc = tsc;
+	event.variant.tip.ip = ip;
+
+	for (; count; --count) {
+		errcode = pt_sb_event(pefix->session[sidx], image, &event,
+				      sizeof(event), NULL, 0);
+		ptu_int_eq(errcode, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pefix_init(struct pevent_fixture *pefix)
+{
+	uint32_t idx;
+	int sidx;
+
+	memset(pefix->buffer, 0, sizeof(pefix->buffer));
+	memset(pefix->offsets, 0, sizeof(pefix->offsets));
+	pefix->pos = pefix->buffer;
+	pefix->file = NULL;
+	pefix->name = NULL;
+	pefix->primary = 0;
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		pefix->decoder[sidx] = NULL;
+		pefix->session[sidx] = pt_sb_alloc(NULL);
+		ptu_ptr(pefix->session[sidx]);
+	}
+
+	pev_config_init(&pefix->config);
+	pefix->config.sample_type = pefix_sample_type;
+	pefix->config.time_mult = 1;
+
+	for (idx = 0; idx < pefix_nrecords; ++idx)
+		ptu_test(pefix_write, pefix, idx);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result pefix_fini(struct pevent_fixture *pefix)
+{
+	int sidx;
+
+	/* Freeing the sessions stops the prefetch thread. */
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx)
+		pt_sb_free(pefix->session[sidx]);
+
+	if (pefix->file) {
+		fclose(pefix->file);
+		(void) remove(pefix->name);
+	}
+
+	free(pefix->name);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result fetch(struct pevent_fixture *pefix)
+{
+	ptu_test(pefix_open, pefix, 0);
+	ptu_test(pefix_fetch_range, pefix, 0, pefix_nrecords);
+	ptu_test(pefix_fetch_eos, pefix);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result truncated(struct pevent_fixture *pefix)
+{
+	uint64_t begin, end;
+	uint32_t last;
+	int status, pass;
+
+	/* Cut the last record in half. */
+	last = pefix_nrecords - 1;
+	begin = pefix->offsets[last];
+	end = (uint64_t) (pefix->pos - pefix->buffer);
+
+	ptu_test(pefix_open, pefix, (size_t) (begin + ((end - begin) / 2)));
+	ptu_test(pefix_fetch_range, pefix, 0, last);
+
+	/* The error is reported at the truncated record and it is reported
+	 * again if we try to fetch again.
+	 */
+	for (pass = 0; pass < 2; ++pass) {
+		ptu_test(pefix_fetch, pefix, &status, last);
+		ptu_int_lt(status, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result bad_record(struct pevent_fixture *pefix,
+				       uint32_t bad)
+{
+	struct perf_event_header *header;
+	int status, pass;
+
+	ptu_uint_lt(bad, pefix_nrecords);
+
+	/* An empty record stops the decode. */
+	header = (struct perf_event_header *)
+		(pefix->buffer + pefix->offsets[bad]);
+	header->size = 0;
+
+	ptu_test(pefix_open, pefix, 0);
+	ptu_test(pefix_fetch_range, pefix, 0, bad);
+
+	for (pass = 0; pass < 2; ++pass) {
+		ptu_test(pefix_fetch, pefix, &status, bad);
+		ptu_int_lt(status, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result save_restore(struct pevent_fixture *pefix)
+{
+	void *first[pefix_nsessions], *second[pefix_nsessions];
+	uint32_t mid, late;
+	int sidx, errcode;
+
+	/* Save while the prefetch thread waits for us to consume records from
+	 * a full ring and again after a few ring wraps.
+	 */
+	mid = pt_sb_pevent_prefetch_batch / 2;
+	late = 2 * pt_sb_pevent_prefetch_size + pt_sb_pevent_prefetch_batch;
+
+	ptu_test(pefix_open, pefix, 0);
+	ptu_test(pefix_fetch_range, pefix, 0, mid + 1);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_decoder *decoder;
+
+		decoder = pefix->decoder[sidx];
+		first[sidx] = NULL;
+		errcode = decoder->save(pefix->session[sidx], &first[sidx],
+					decoder->priv);
+		ptu_int_eq(errcode, 0);
+		ptu_ptr(first[sidx]);
+
+		/* We fetch the current record again after restoring. */
+		ptu_uint_eq(((const struct pt_sb_pevent_state *)
+			     first[sidx])->offset, pefix->offsets[mid]);
+	}
+
+	ptu_test(pefix_fetch_range, pefix, mid + 1, late + 1);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_decoder *decoder;
+
+		decoder = pefix->decoder[sidx];
+		second[sidx] = NULL;
+		errcode = decoder->save(pefix->session[sidx], &second[sidx],
+					decoder->priv);
+		ptu_int_eq(errcode, 0);
+		ptu_ptr(second[sidx]);
+	}
+
+	/* Seek backwards while the prefetch thread is running. */
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_decoder *decoder;
+
+		decoder = pefix->decoder[sidx];
+		errcode = decoder->restore(pefix->session[sidx], first[sidx],
+					   decoder->priv);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(pefix_fetch_range, pefix, mid, pefix_nrecords);
+	ptu_test(pefix_fetch_eos, pefix);
+
+	/* Seek forwards after the prefetch thread reached the end. */
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_decoder *decoder;
+
+		decoder = pefix->decoder[sidx];
+		errcode = decoder->restore(pefix->session[sidx], second[sidx],
+					   decoder->priv);
+		ptu_int_eq(errcode, 0);
+	}
+
+	ptu_test(pefix_fetch_range, pefix, late, pefix_nrecords);
+	ptu_test(pefix_fetch_eos, pefix);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		pefix->decoder[sidx]->free_state(first[sidx]);
+		pefix->decoder[sidx]->free_state(second[sidx]);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result primary(struct pevent_fixture *pefix)
+{
+	uint32_t idx, napply;
+	int sidx, errcode;
+
+	/* Each ITRACE_START record switches contexts right away so the
+	 * decoder never has a context switch pending.
+	 */
+	pefix->primary = 1;
+	ptu_test(pefix_open, pefix, 0);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_session *session;
+		struct pt_sb_decoder *decoder;
+		struct pt_image *image;
+
+		session = pefix->session[sidx];
+		decoder = pefix->decoder[sidx];
+
+		pefix_apply = decoder->apply;
+		pefix_napply = 0;
+		decoder->apply = pefix_count_apply;
+
+		errcode = pt_sb_init_decoders(session);
+		ptu_int_eq(errcode, 0);
+
+		/* A primary decoder tracks the code location so it is
+		 * presented every event, including events before its first
+		 * record is due.
+		 */
+		image = NULL;
+		ptu_test(pefix_event, pefix, sidx, &image, 0ull,
+			 pefix_user_ip, 1000);
+		ptu_uint_eq(pefix_napply, 1000);
+		ptu_null(image);
+
+		/* The event that makes a record due is presented once for
+		 * applying the record and once for tracking the location.
+		 */
+		napply = pefix_napply;
+		for (idx = 0; idx < pefix_nrecords - 1; ++idx) {
+			ptu_test(pefix_event, pefix, sidx, &image,
+				 (uint64_t) idx + 1ull, pefix_user_ip, 10);
+			napply += 11;
+			ptu_uint_eq(pefix_napply, napply);
+			ptu_ptr(image);
+		}
+
+		/* It signals the end of its sideband trace at the event that
+		 * makes its last record due and is not presented further
+		 * events.
+		 */
+		ptu_test(pefix_event, pefix, sidx, &image,
+			 (uint64_t) pefix_nrecords, pefix_user_ip, 1000);
+		ptu_uint_eq(pefix_napply, napply + 2);
+		ptu_null(session->requests);
+		ptu_int_ne(decoder->removed, 0);
+	}
+
+	return ptu_passed();
+}
+
+static struct ptunit_result postponed_switch(struct pevent_fixture *pefix)
+{
+	int sidx, errcode;
+
+	/* Start tracing in the context of pid 0 and switch to pid 1 later. */
+	pefix->pos = pefix->buffer;
+	ptu_test(pefix_write, pefix, 0);
+	ptu_test(pefix_write_switch, pefix, 1, 3ull);
+
+	pefix->primary = 1;
+	ptu_test(pefix_open, pefix, 0);
+
+	for (sidx = 0; sidx < pefix_nsessions; ++sidx) {
+		struct pt_sb_session *session;
+		struct pt_image *image, *start;
+
+		session = pefix->session[sidx];
+
+		errcode = pt_sb_init_decoders(session);
+		ptu_int_eq(errcode, 0);
+
+		image = NULL;
+		ptu_test(pefix_event, pefix, sidx, &image, 1ull,
+			 pefix_user_ip, 1);
+		ptu_ptr(image);
+
+		start = image;
+
+		ptu_test(pefix_event, pefix, sidx, &image, 2ull,
+			 pefix_user_ip, 10);
+		ptu_ptr_eq(image, start);
+
+		/* The switch is postponed while we remain in user space. */
+		ptu_test(pefix_event, pefix, sidx, &image, 3ull,
+			 pefix_user_ip, 10);
+		ptu_ptr_eq(image, start);
+
+		/* It is applied when we enter the kernel. */
+		ptu_test(pefix_event, pefix, sidx, &image, 3ull,
+			 pefix_kernel_ip, 1);
+		ptu_ptr(image);
+		ptu_ptr_ne(image, start);
+	}
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct pevent_fixture pefix;
+	struct ptunit_suite suite;
+
+	pefix.init = pefix_init;
+	pefix.fini = pefix_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, fetch, pefix);
+	ptu_run_f(suite, truncated, pefix);
+	ptu_run_fp(suite, bad_record, pefix, 0);
+	ptu_run_fp(suite, bad_record, pefix, pt_sb_pevent_prefetch_batch);
+	ptu_run_fp(suite, bad_record, pefix,
+		   pt_sb_pevent_prefetch_size + pt_sb_pevent_prefetch_batch / 2);
+	ptu_run_f(suite, save_restore, pefix);
+	ptu_run_f(suite, primary, pefix);
+	ptu_run_f(suite, postponed_switch, pefix);
+
+	return ptunit_report(&suite);
+}
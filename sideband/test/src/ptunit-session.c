@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2026, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *  * Neither the name of Intel Corporation nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ptunit.h"
+
+#include "pt_sb_session.h"
+#include "pt_sb_context.h"
+
+#include "libipt-sb.h"
+#include "intel-pt.h"
+
+
+enum {
+	/* The number of contexts to add.
+	 *
+	 * This is more than fit into the initial hash table.
+	 */
+	sbs_ncontexts	= 1024,
+
+	/* The maximal acceptable length of a hash chain. */
+	sbs_max_chain	= 8
+};
+
+/* A test fixture. */
+struct session_fixture {
+	/* The sideband session. */
+	struct pt_sb_session *session;
+
+	/* The test fixture initialization and finalization functions. */
+	struct ptunit_result (*init)(struct session_fixture *);
+	struct ptunit_result (*fini)(struct session_fixture *);
+};
+
+static struct ptunit_result sbs_init(struct session_fixture *sbs)
+{
+	sbs->session = pt_sb_alloc(NULL);
+	ptu_ptr(sbs->session);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result sbs_fini(struct session_fixture *sbs)
+{
+	pt_sb_free(sbs->session);
+
+	return ptu_passed();
+}
+
+/* Add a context for each of @npids pids starting at @base in steps of
+ * @stride.
+ */
+static struct ptunit_result sbs_add(struct session_fixture *sbs,
+				    uint32_t base, uint32_t stride,
+				    uint32_t npids)
+{
+	uint32_t idx;
+
+	for (idx = 0; idx < npids; ++idx) {
+		struct pt_sb_context *context;
+		uint32_t pid;
+		int errcode;
+
+		pid = base + (idx * stride);
+
+		context = NULL;
+		errcode = pt_sb_get_context_by_pid(&context, sbs->session, pid);
+		ptu_int_eq(errcode, 0);
+		ptu_ptr(context);
+		ptu_uint_eq(context->pid, pid);
+	}
+
+	return ptu_passed();
+}
+
+/* Check that we find a context for each of @npids pids starting at @base in
+ * steps of @stride.
+ */
+static struct ptunit_result sbs_find(struct session_fixture *sbs,
+				     uint32_t base, uint32_t stride,
+				     uint32_t npids)
+{
+	uint32_t idx;
+
+	for (idx = 0; idx < npids; ++idx) {
+		struct pt_sb_context *context;
+		uint32_t pid;
+		int errcode;
+
+		pid = base + (idx * stride);
+
+		context = NULL;
+		errcode = pt_sb_find_context_by_pid(&context, sbs->session,
+						    pid);
+		ptu_int_eq(errcode, 0);
+		ptu_ptr(context);
+		ptu_uint_eq(context->pid, pid);
+	}
+
+	return ptu_passed();
+}
+
+/* Check the hash table's structure and that no chain is too long. */
+static struct ptunit_result sbs_check(struct session_fixture *sbs)
+{
+	const struct pt_hash_table *table;
+	uint64_t bucket, nbuckets, ncontexts;
+
+	table = &sbs->session->contexts;
+	ptu_uint_ne(table->bits, 0);
+	ptu_ptr(table->buckets);
+
+	/* Keep the load factor below 3/4. */
+	nbuckets = 1ull << table->bits;
+	ptu_uint_lt(table->nnodes * 4, nbuckets * 3);
+
+	ncontexts = 0;
+	for (bucket = 0; bucket < nbuckets; ++bucket) {
+		const struct pt_hash_node *node;
+		uint32_t length;
+
+		length = 0;
+		for (node = table->buckets[bucket]; node; node = node->next)
+			length += 1;
+
+		ptu_uint_le(length, sbs_max_chain);
+
+		ncontexts += length;
+	}
+
+	ptu_uint_eq(ncontexts, table->nnodes);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result empty(struct session_fixture *sbs)
+{
+	struct pt_sb_context *context;
+	int errcode;
+
+	context = (struct pt_sb_context *) sbs;
+	errcode = pt_sb_find_context_by_pid(&context, sbs->session, 1);
+	ptu_int_eq(errcode, 0);
+	ptu_null(context);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result get_twice(struct session_fixture *sbs)
+{
+	struct pt_sb_context *first, *second;
+	int errcode;
+
+	first = NULL;
+	errcode = pt_sb_get_context_by_pid(&first, sbs->session, 1);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr(first);
+
+	second = NULL;
+	errcode = pt_sb_get_context_by_pid(&second, sbs->session, 1);
+	ptu_int_eq(errcode, 0);
+	ptu_ptr_eq(second, first);
+	ptu_uint_eq(sbs->session->contexts.nnodes, 1);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result distribute(struct session_fixture *sbs,
+				       uint32_t stride)
+{
+	ptu_check(sbs_add, sbs, stride, stride, sbs_ncontexts);
+	ptu_check(sbs_check, sbs);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result rehash(struct session_fixture *sbs)
+{
+	uint32_t nbuckets;
+	uint8_t bits;
+
+	ptu_check(sbs_add, sbs, 1, 1, 1);
+
+	bits = sbs->session->contexts.bits;
+	ptu_uint_ne(bits, 0);
+
+	nbuckets = 1u << bits;
+	ptu_check(sbs_add, sbs, 2, 1, nbuckets);
+
+	/* The table grew and we still find all contexts. */
+	ptu_uint_gt(sbs->session->contexts.bits, bits);
+	ptu_check(sbs_find, sbs, 1, 1, nbuckets + 1);
+	ptu_check(sbs_check, sbs);
+
+	return ptu_passed();
+}
+
+static struct ptunit_result remove_all(struct session_fixture *sbs)
+{
+	uint32_t pid;
+
+	ptu_check(sbs_add, sbs, 1, 3, sbs_ncontexts);
+
+	for (pid = 1; pid < 1 + (3 * sbs_ncontexts); pid += 3) {
+		struct pt_sb_context *context;
+		int errcode;
+
+		context = NULL;
+		errcode = pt_sb_find_context_by_pid(&context, sbs->session,
+						    pid);
+		ptu_int_eq(errcode, 0);
+		ptu_ptr(context);
+
+		errcode = pt_sb_remove_context(sbs->session, context);
+		ptu_int_eq(errcode, 0);
+
+		errcode = pt_sb_find_context_by_pid(&context, sbs->session,
+						    pid);
+		ptu_int_eq(errcode, 0);
+		ptu_null(context);
+	}
+
+	ptu_uint_eq(sbs->session->contexts.nnodes, 0);
+	ptu_check(sbs_check, sbs);
+
+	return ptu_passed();
+}
+
+int main(int argc, char **argv)
+{
+	struct session_fixture sbs;
+	struct ptunit_suite suite;
+
+	sbs.init = sbs_init;
+	sbs.fini = sbs_fini;
+
+	suite = ptunit_mk_suite(argc, argv);
+
+	ptu_run_f(suite, empty, sbs);
+	ptu_run_f(suite, get_twice, sbs);
+	ptu_run_fp(suite, distribute, sbs, 1);
+	ptu_run_fp(suite, distribute, sbs, 2);
+	ptu_run_fp(suite, distribute, sbs, 64);
+	ptu_run_fp(suite, distribute, sbs, 4096);
+	ptu_run_fp(suite, distribute, sbs, 0x10000);
+	ptu_run_f(suite, rehash, sbs);
+	ptu_run_f(suite, remove_all, sbs);
+
+	return ptunit_report(&suite);
+}